@@ -10,7 +10,8 @@ def CppExtension(name, sources):
         name,
         sources=sources,
         language="c++",
-        extra_compile_args=["-std=c++11", "-Werror=return-type", "-Werror=narrowing"],
+        extra_compile_args=["-std=c++11", "-Werror=return-type", "-Werror=narrowing", "-pthread"],
+        extra_link_args=["-pthread"],
         undef_macros=["NDEBUG"],
     )
 
@@ -22,28 +23,48 @@ extensions = [
             "whatshap/core.pyx",
             "src/pedigree.cpp",
             "src/pedigreedptable.cpp",
+            "src/transmissionkernel.cpp",
+            "src/columnarena.cpp",
+            "src/instrumentation.cpp",
             "src/pedigreecolumncostcomputer.cpp",
-            "src/columnindexingiterator.cpp",
+            "src/pedigreecolumncostengine.cpp",
             "src/columnindexingscheme.cpp",
             "src/entry.cpp",
             "src/graycodes.cpp",
             "src/read.cpp",
             "src/readset.cpp",
             "src/columniterator.cpp",
+            "src/columnreadindex.cpp",
+            "src/packedcolumns.cpp",
             "src/indexset.cpp",
             "src/genotype.cpp",
             "src/binomial.cpp",
             "src/pedigreepartitions.cpp",
+            "src/pedigreetopology.cpp",
+            "src/checkpointpolicy.cpp",
+            "src/stringpool.cpp",
+            "src/readselection.cpp",
+            "src/readmerger.cpp",
+            "src/phasingcomparison.cpp",
+            "src/readclouds.cpp",
+            "src/vcfrewriter.cpp",
+            "src/alleledetector.cpp",
+            "src/pileupcounter.cpp",
+            "src/editdistance.cpp",
+            "src/referencesequence.cpp",
             "src/phredgenotypelikelihoods.cpp",
+            "src/phredprobabilities.cpp",
             "src/genotyper.cpp",
             "src/genotypedistribution.cpp",
             "src/genotypedptable.cpp",
             "src/genotypecolumncostcomputer.cpp",
             "src/backwardcolumniterator.cpp",
             "src/transitionprobabilitycomputer.cpp",
+            "src/geneticmap.cpp",
             "src/hapchat/basictypes.cpp",
             "src/hapchat/balancedcombinations.cpp",
             "src/hapchat/binomialcoefficient.cpp",
+            "src/hapchat/backtracetable.cpp",
             "src/hapchat/hapchatcore.cpp",
             "src/hapchat/hapchatcolumniterator.cpp",
             "src/polyphase/clustereditingsolution.cpp",
@@ -53,13 +74,15 @@ extensions = [
             "src/polyphase/staticsparsegraph.cpp",
             "src/polyphase/switchflipcalculator.cpp",
             "src/polyphase/trianglesparsematrix.cpp",
+            "src/polyphase/readscoreindex.cpp",
             "src/polyphase/readscoring.cpp",
             "src/polyphase/haplothreader.cpp",
+            "src/polyphase/threadingpreprocessor.cpp",
+            "src/polyphase/blockphaser.cpp",
         ],
     ),
     CppExtension("whatshap.priorityqueue", sources=["whatshap/priorityqueue.pyx"]),
-    CppExtension("whatshap.align", sources=["whatshap/align.pyx"]),
-    CppExtension("whatshap._variants", sources=["whatshap/_variants.pyx"]),
+    CppExtension("whatshap.align", sources=["whatshap/align.pyx", "src/editdistance.cpp"]),
 ]
 
 
@@ -90,7 +113,6 @@ else:
     install_requires = [
         "pysam>=0.18.0",
         "pyfaidx>=0.5.5.2",
-        "networkx",
         "biopython>=1.73",  # pyfaidx needs this for reading bgzipped FASTA files
         "scipy",
         "xopen>=1.2.0",
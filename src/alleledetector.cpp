@@ -0,0 +1,329 @@
+#include <cassert>
+#include <climits>
+#include <cstdlib>
+#include <algorithm>
+#include <stdexcept>
+
+#include "alleledetector.h"
+
+using namespace std;
+
+namespace {
+	/** Processes one CIGAR operation while computing the length of a CIGAR prefix that
+	 *  spans reference_bases on the reference (see prefix_length()).
+	 *  @return true if the prefix is complete.
+	 */
+	bool prefix_step(int op, int length, int reference_bases, int& ref_pos, int& query_pos) {
+		switch (op) {
+		case 0: case 7: case 8: // M, =, X
+			ref_pos += length;
+			query_pos += length;
+			if (ref_pos >= reference_bases) {
+				query_pos += reference_bases - ref_pos;
+				ref_pos = reference_bases;
+				return true;
+			}
+			return false;
+		case 2: // D
+			ref_pos += length;
+			if (ref_pos >= reference_bases) {
+				ref_pos = reference_bases;
+				return true;
+			}
+			return false;
+		case 1: // I
+			query_pos += length;
+			return false;
+		case 4: case 5: // soft or hard clipping
+			return false;
+		case 3: // N: always stop at reference skips
+			ref_pos = reference_bases;
+			return true;
+		default:
+			throw std::runtime_error("AlleleDetector: unknown CIGAR operator");
+		}
+	}
+
+	/** Given a prefix of length reference_bases relative to the reference, determines how long
+	 *  the corresponding prefix of the query is. The CIGAR is given by the operation cigar[i]
+	 *  with length first_length (omitted if 0) followed by cigar[i+step], cigar[i+2*step], ...
+	 *  (step is 1 or -1). If the CIGAR does not cover reference_bases, ref_bases is set to the
+	 *  number of bases it covers. Positions within or at the end of an insertion are reported as
+	 *  the beginning of the insertion, and reference skips are treated as the end of the read.
+	 */
+	void prefix_length(const AlleleDetector::cigar_t& cigar, size_t i, int first_length, int step, int reference_bases, int* ref_bases, int* query_bases) {
+		int ref_pos = 0;
+		int query_pos = 0;
+		bool done = first_length > 0 && prefix_step(cigar[i].first, first_length, reference_bases, ref_pos, query_pos);
+		for (long k = (long)i + step; !done && k >= 0 && k < (long)cigar.size(); k += step) {
+			done = prefix_step(cigar[k].first, cigar[k].second, reference_bases, ref_pos, query_pos);
+		}
+		*ref_bases = ref_pos;
+		*query_bases = query_pos;
+	}
+}
+
+
+AlleleDetector::AlleleDetector(const vector<int>& positions, const vector<string>& reference_alleles, const vector<string>& alternative_alleles, shared_ptr<const ReferenceSequence> reference, unsigned int overhang, bool use_affine, int gap_start, int gap_extend, int default_mismatch) :
+	positions(positions),
+	reference_alleles(reference_alleles),
+	alternative_alleles(alternative_alleles),
+	reference(reference),
+	overhang(overhang),
+	use_affine(use_affine),
+	gap_start(gap_start),
+	gap_extend(gap_extend),
+	default_mismatch(default_mismatch)
+{
+	if (!reference) {
+		throw std::invalid_argument("AlleleDetector: no reference given");
+	}
+	if ((positions.size() != reference_alleles.size()) || (positions.size() != alternative_alleles.size())) {
+		throw std::invalid_argument("AlleleDetector: number of positions and alleles differ");
+	}
+}
+
+
+size_t AlleleDetector::size() const {
+	return positions.size();
+}
+
+
+size_t AlleleDetector::detect(Read* read, int reference_start, const cigar_t& cigar, const string& query_sequence, size_t first) {
+	assert(read != nullptr);
+	size_t n = positions.size();
+	size_t j = first;
+	int ref_pos = reference_start;
+	int query_pos = 0;
+	size_t detected = 0;
+	int allele, quality;
+
+	// Skip variants that are located to the left of the read
+	while (j < n && positions[j] < ref_pos) {
+		j += 1;
+	}
+	// Alignments are usually sorted by position, so cached realignments of earlier variants
+	// are not needed anymore
+	cache.erase(cache.begin(), cache.lower_bound(j));
+	// Iterate over the CIGAR (defining the alignment) and the variants in lockstep
+	for (size_t i = 0; i < cigar.size(); ++i) {
+		int op = cigar[i].first;
+		int length = cigar[i].second;
+		switch (op) {
+		case 0: case 7: case 8: // M, =, X
+			// all variants in this matching region
+			for (; j < n && positions[j] < ref_pos + length; ++j) {
+				assert(positions[j] >= ref_pos);
+				int consumed = positions[j] - ref_pos;
+				if (realign(j, cigar, i, consumed, query_pos + consumed, query_sequence, &allele, &quality)) {
+					read->addVariant(positions[j], allele, quality);
+					detected += 1;
+				}
+			}
+			query_pos += length;
+			ref_pos += length;
+			break;
+		case 1: // I
+			if (j < n && positions[j] == ref_pos) {
+				if (realign(j, cigar, i, 0, query_pos, query_sequence, &allele, &quality)) {
+					read->addVariant(positions[j], allele, quality);
+					detected += 1;
+				}
+				j += 1;
+			}
+			query_pos += length;
+			break;
+		case 2: // D
+			// all variants in this deleted region
+			for (; j < n && positions[j] < ref_pos + length; ++j) {
+				assert(positions[j] >= ref_pos);
+				if (realign(j, cigar, i, positions[j] - ref_pos, query_pos, query_sequence, &allele, &quality)) {
+					read->addVariant(positions[j], allele, quality);
+					detected += 1;
+				}
+			}
+			ref_pos += length;
+			break;
+		case 3: // N: variants in skipped regions are not covered
+			while (j < n && positions[j] < ref_pos + length) {
+				j += 1;
+			}
+			ref_pos += length;
+			break;
+		case 4: // S
+			query_pos += length;
+			break;
+		case 5: case 6: // H, P
+			break;
+		default:
+			throw std::invalid_argument("Unsupported CIGAR operation: " + to_string(op));
+		}
+	}
+	return detected;
+}
+
+
+bool AlleleDetector::realign(size_t j, const cigar_t& cigar, size_t i, int consumed, int query_pos, const string& query_sequence, int* allele, int* quality) {
+	const string& reference_allele = reference_alleles[j];
+	const string& alternative_allele = alternative_alleles[j];
+	// Do not process symbolic alleles like <DEL>, <DUP>, etc.
+	if (!alternative_allele.empty() && alternative_allele[0] == '<') {
+		return false;
+	}
+	int position = positions[j];
+	assert(consumed <= cigar[i].second);
+
+	// split the CIGAR at the variant and extend the alignment to both sides
+	int left_ref_bases, left_query_bases, right_ref_bases, right_query_bases;
+	prefix_length(cigar, i, consumed, -1, overhang, &left_ref_bases, &left_query_bases);
+	prefix_length(cigar, i, cigar[i].second - consumed, 1, (int)reference_allele.size() + overhang, &right_ref_bases, &right_query_bases);
+
+	long ref_start = (long)position - left_ref_bases;
+	long ref_end = (long)position + right_ref_bases;
+	if ((ref_start < 0) || (ref_end > (long)reference->size())) {
+		throw std::runtime_error("AlleleDetector: alignment extends beyond the reference");
+	}
+	long query_start = min((long)query_sequence.size(), max(0L, (long)query_pos - left_query_bases));
+	long query_end = min((long)query_sequence.size(), (long)query_pos + right_query_bases);
+	const char* query = query_sequence.data() + query_start;
+	size_t query_length = max(0L, query_end - query_start);
+
+	// Reads from the same haplotype often give the same query window
+	vector<cached_realignment_t>& cached = cache[j];
+	for (const cached_realignment_t& entry : cached) {
+		if ((entry.ref_start == ref_start) && (entry.ref_end == ref_end) && (entry.query.compare(0, entry.query.size(), query, query_length) == 0)) {
+			cache_stats.hits += 1;
+			*allele = entry.allele;
+			*quality = entry.quality;
+			return entry.decided;
+		}
+	}
+	cache_stats.misses += 1;
+
+	reference_window.clear();
+	reference->append(ref_start, ref_end, reference_window);
+	alternative.clear();
+	alternative.append(reference_window, 0, position - ref_start);
+	alternative += alternative_allele;
+	if ((long)position + (long)reference_allele.size() < ref_end) {
+		alternative.append(reference_window, position + reference_allele.size() - ref_start, string::npos);
+	}
+	const char* ref = reference_window.data();
+	size_t ref_length = reference_window.size();
+
+	int distance_ref, distance_alt;
+	if (use_affine) {
+		distance_ref = edit_distance_affine_gap(query, query_length, ref, ref_length);
+		distance_alt = edit_distance_affine_gap(query, query_length, alternative.data(), alternative.size());
+		*quality = abs(distance_ref - distance_alt);
+	} else {
+		distance_ref = edit_distance(query, query_length, ref, ref_length);
+		distance_alt = edit_distance(query, query_length, alternative.data(), alternative.size());
+		*quality = 30;
+	}
+	// cannot decide if both alleles are equally good
+	bool decided = distance_ref != distance_alt;
+	*allele = (distance_ref < distance_alt) ? 0 : 1;
+	if (cached.size() < MAX_CACHED_WINDOWS) {
+		cached.push_back(cached_realignment_t(ref_start, ref_end, string(query, query_length), decided, *allele, *quality));
+	}
+	return decided;
+}
+
+
+realignment_cache_stats_t AlleleDetector::get_cache_stats() const {
+	return cache_stats;
+}
+
+
+int AlleleDetector::edit_distance(const char* s, size_t m, const char* t, size_t n) {
+	return unit_cost.compute(s, m, t, n);
+}
+
+
+int AlleleDetector::edit_distance_affine_gap(const char* query, size_t m, const char* ref, size_t n) {
+	while (m > 0 && n > 0 && query[0] == ref[0]) {
+		query += 1;
+		ref += 1;
+		m -= 1;
+		n -= 1;
+	}
+	while (m > 0 && n > 0 && query[m-1] == ref[n-1]) {
+		m -= 1;
+		n -= 1;
+	}
+	// Start with a narrow band and widen it until the result is guaranteed to be optimal:
+	// Any alignment leaving the band contains at least |n-m| + 2*band + 2 gap positions, each
+	// of which costs at least min(gap_start, gap_extend).
+	long long min_gap_cost = min(gap_start, gap_extend);
+	long long length_difference = (m > n) ? (m - n) : (n - m);
+	for (size_t band = INITIAL_BAND; ; band *= 2) {
+		float distance = banded_affine_gap(query, m, ref, n, band);
+		if ((band >= max(m, n)) || ((min_gap_cost > 0) && (distance <= (length_difference + 2 * (long long)band + 2) * min_gap_cost))) {
+			return (int)(long long)distance;
+		}
+	}
+}
+
+
+float AlleleDetector::banded_affine_gap(const char* query, size_t m, const char* ref, size_t n, size_t band) {
+	// Costs are computed in single precision as in whatshap.align.edit_distance_affine_gap,
+	// which makes a difference for the (float) infinity below. Cells outside of the band
+	// are infinite.
+	const float infinity = INT_MAX;
+	const float mismatch_cost = default_mismatch;
+	// the band consists of all cells (i, j) with lowest_diagonal <= j - i <= highest_diagonal
+	long lowest_diagonal = min(0L, (long)n - (long)m) - (long)band;
+	long highest_diagonal = max(0L, (long)n - (long)m) + (long)band;
+
+	// three DP tables (match, gap in ref, gap in query), stored column-wise
+	a.resize(m + 1);
+	b.resize(m + 1);
+	c.resize(m + 1);
+	a[0] = b[0] = c[0] = 0;
+	size_t end = min((long)m, -lowest_diagonal);
+	for (size_t i = 1; i <= m; ++i) {
+		a[i] = infinity;
+		b[i] = (i <= end) ? gap_start + ((int)i - 1) * gap_extend : infinity;
+		c[i] = infinity;
+	}
+	for (size_t j = 1; j <= n; ++j) {
+		size_t start = max(0L, (long)j - highest_diagonal);
+		end = min((long)m, (long)j - lowest_diagonal);
+		// values of column j-1 in row i-1 and of column j in row i-1
+		float prev_a, prev_b, prev_c, up_a, up_b, up_c;
+		size_t i = start;
+		if (start == 0) {
+			prev_a = a[0];
+			prev_b = b[0];
+			prev_c = c[0];
+			a[0] = infinity;
+			b[0] = infinity;
+			c[0] = gap_start + ((int)j - 1) * gap_extend;
+			up_a = a[0];
+			up_b = b[0];
+			up_c = c[0];
+			i = 1;
+		} else {
+			prev_a = a[start-1];
+			prev_b = b[start-1];
+			prev_c = c[start-1];
+			up_a = up_b = up_c = infinity;
+			// row start-1 leaves the band
+			a[start-1] = b[start-1] = c[start-1] = infinity;
+		}
+		for (; i <= end; ++i) {
+			float m_c = (query[i-1] == ref[j-1]) ? 0.0f : mismatch_cost;
+			float c_a = min(prev_a, min(prev_b, prev_c)) + m_c;
+			float c_b = min(up_a + gap_start, min(up_b + gap_extend, up_c + gap_start));
+			float c_c = min(a[i] + gap_start, min(b[i] + gap_start, c[i] + gap_extend));
+			prev_a = a[i];
+			prev_b = b[i];
+			prev_c = c[i];
+			a[i] = up_a = c_a;
+			b[i] = up_b = c_b;
+			c[i] = up_c = c_c;
+		}
+	}
+	return min(a[m], min(b[m], c[m]));
+}
@@ -0,0 +1,113 @@
+#ifndef ALLELE_DETECTOR_H
+#define ALLELE_DETECTOR_H
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <map>
+#include <memory>
+
+#include "read.h"
+#include "editdistance.h"
+#include "referencesequence.h"
+
+/** Number of realignments answered from (hits) and not found in (misses) the cache of an AlleleDetector. */
+typedef struct realignment_cache_stats_t {
+	size_t hits;
+	size_t misses;
+	realignment_cache_stats_t() : hits(0), misses(0) {}
+} realignment_cache_stats_t;
+
+/** Detects the alleles of variants in aligned reads by realigning the read to the
+ *  reference and to the alternative allele of each variant it covers (Python:
+ *  ReadSetReader with a reference). The variants and the reference sequence of one
+ *  chromosome are given once; then, detect() can be called for all alignments on that
+ *  chromosome. The outcome of realigning a query window to the alleles of a variant is cached
+ *  such that reads of the same haplotype need not be realigned again. Scratch buffers for the
+ *  alignments are reused across calls, so an AlleleDetector must not be used from several
+ *  threads at the same time.
+ */
+class AlleleDetector {
+public:
+	/** CIGAR as a list of (operation, length) pairs, using the BAM operation codes MIDNSHP=X (0-8). */
+	typedef std::vector<std::pair<int,int> > cigar_t;
+
+	/** Constructor.
+	 *  @param positions Variant positions (0-based, sorted).
+	 *  @param overhang Extend the alignment by this many bases to the left and right of a variant.
+	 *  @param use_affine If true, alignments use affine gap costs (gap_start, gap_extend) and
+	 *                    default_mismatch as mismatch cost, and the quality of a detected allele is
+	 *                    the difference in costs. Otherwise, unit costs are used and all qualities are 30.
+	 */
+	AlleleDetector(const std::vector<int>& positions, const std::vector<std::string>& reference_alleles, const std::vector<std::string>& alternative_alleles, std::shared_ptr<const ReferenceSequence> reference, unsigned int overhang, bool use_affine, int gap_start, int gap_extend, int default_mismatch);
+
+	/** Adds the alleles of all variants (starting at index first) covered by the given
+	 *  alignment to read. Variants for which both alleles align equally well are skipped,
+	 *  as are symbolic alternative alleles (such as <DEL>).
+	 *  @return Number of variants added to read.
+	 */
+	size_t detect(Read* read, int reference_start, const cigar_t& cigar, const std::string& query_sequence, size_t first = 0);
+
+	/** Returns the number of variants. */
+	size_t size() const;
+
+	realignment_cache_stats_t get_cache_stats() const;
+
+	/** Unit cost edit distance of the given strings. */
+	int edit_distance(const char* s, size_t m, const char* t, size_t n);
+
+	/** Edit distance with affine gap costs (Gotoh), using the mismatch cost given in the constructor.
+	 *  Only a band around the diagonal is computed, which is widened as long as an alignment
+	 *  outside of it could be cheaper. The result is the same as for the full DP table.
+	 */
+	int edit_distance_affine_gap(const char* query, size_t m, const char* ref, size_t n);
+
+private:
+	/** Maximum number of distinct query windows cached per variant. */
+	static const size_t MAX_CACHED_WINDOWS = 16;
+	/** Band width (in diagonals on each side) the affine gap alignment starts with. */
+	static const size_t INITIAL_BAND = 4;
+
+	std::vector<int> positions;
+	std::vector<std::string> reference_alleles;
+	std::vector<std::string> alternative_alleles;
+	std::shared_ptr<const ReferenceSequence> reference;
+	int overhang;
+	bool use_affine;
+	int gap_start;
+	int gap_extend;
+	int default_mismatch;
+
+	typedef struct cached_realignment_t {
+		long ref_start;
+		long ref_end;
+		std::string query;
+		bool decided;
+		int allele;
+		int quality;
+		cached_realignment_t(long ref_start, long ref_end, const std::string& query, bool decided, int allele, int quality) :
+			ref_start(ref_start), ref_end(ref_end), query(query), decided(decided), allele(allele), quality(quality) {}
+	} cached_realignment_t;
+	// realignments of each variant (by index), for variants that may be covered by later alignments
+	std::map<size_t, std::vector<cached_realignment_t> > cache;
+	realignment_cache_stats_t cache_stats;
+
+	// reused buffers
+	std::string reference_window;
+	std::string alternative;
+	EditDistance unit_cost;
+	std::vector<float> a;
+	std::vector<float> b;
+	std::vector<float> c;
+
+	/** Affine gap cost alignment restricted to the diagonals -band - max(0, m-n), ..., band + max(0, n-m). */
+	float banded_affine_gap(const char* query, size_t m, const char* ref, size_t n, size_t band);
+
+	/** Realigns the query to both alleles of variant j, which is at query position query_pos.
+	 *  The variant lies within cigar[i], after the first consumed operations of it.
+	 *  @return true and sets allele and quality if one allele aligns better than the other.
+	 */
+	bool realign(size_t j, const cigar_t& cigar, size_t i, int consumed, int query_pos, const std::string& query_sequence, int* allele, int* quality);
+};
+
+#endif
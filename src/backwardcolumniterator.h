@@ -3,16 +3,19 @@
 
 #include <vector>
 #include <memory>
-#include <list>
 
 #include "entry.h"
 #include "readset.h"
+#include "columnreadindex.h"
 
 // TODO create column iterator superclass and subclasses to iterate forwards and backwards
 
 class BackwardColumnIterator {
 public:
 	BackwardColumnIterator(const ReadSet& set, const std::vector<unsigned int>* positions = nullptr);
+	/** Creates an iterator over the columns given by an existing index for the same ReadSet,
+	 *  which can be shared with other (forward or backward) iterators. */
+	BackwardColumnIterator(const ReadSet& set, std::shared_ptr<const ColumnReadIndex> index);
 	~BackwardColumnIterator();
 	/** Returns the total number of columns, i.e. the number of columns
 	 *  that will be returned by get_next. */
@@ -25,27 +28,16 @@ public:
 	std::unique_ptr<std::vector<const Entry*> > get_next();
 	const std::vector<unsigned int>* get_positions();
 	/** Moves iterator such that next call to get_next() will return
-	 *  column k. */
+	 *  column k. Takes constant time. */
 	void jump_to_column(int k);
+	std::shared_ptr<const ColumnReadIndex> get_index();
 
 private:
-	typedef struct active_read_t {
-		size_t read_index;
-		size_t active_entry;
-		active_read_t(size_t read_index) : read_index(read_index), active_entry(0) {}
-		active_read_t(size_t read_index, size_t active_entry) : read_index(read_index), active_entry(active_entry) {}
-	} active_read_t;
-
 	const ReadSet& set;
-	/** The number of columns already written. */
+	/** Index of the column to be returned next. */
 	int n;
-	std::list<active_read_t> active_reads;
+	std::shared_ptr<const ColumnReadIndex> index;
 	std::vector<Entry*> blank_entries;
-	std::vector<unsigned int>* positions;
-	// first_reads[k] is the index of the first read (i.e. lowest index) active at column k,
-	// in case no read is active in column k, then first_reads[k] is the index of the first read
-	// that will become active after column k.
-	std::vector<size_t> first_reads;
 };
 
 #endif
@@ -0,0 +1,582 @@
+/** Micro and macro benchmarks of the C++ core on synthetic read sets.
+ *
+ *  Every benchmark is run on one or more parameter sets (number of variants, coverage per
+ *  individual, read length in variants, ploidy and pedigree size). Each case runs in a child
+ *  process, such that its peak resident memory can be reported separately. Throughput is given
+ *  in columns, rows (DP rows or iterated entries) and edges (read pairs) per second, based on
+ *  the fastest of all repetitions.
+ *
+ *  Usage: benchmarks [--filter SUBSTRING] [--repetitions N] [--threads N] [--seed N]
+ *                    [--variants N] [--coverage N] [--read-length N] [--ploidy N]
+ *                    [--individuals N] [--json FILE] [--no-fork] [--list]
+ *
+ *  The parameter options replace the respective parameter of all default cases. With --json,
+ *  the results are also written as JSON to the given file ("-" for standard output, in which
+ *  case the table goes to standard error).
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../columniterator.h"
+#include "../genotype.h"
+#include "../genotypedptable.h"
+#include "../pedigree.h"
+#include "../pedigreedptable.h"
+#include "../phredgenotypelikelihoods.h"
+#include "../read.h"
+#include "../readset.h"
+#include "../polyphase/clustereditingsolver.h"
+#include "../polyphase/haplothreader.h"
+#include "../polyphase/readscoring.h"
+#include "../polyphase/threadingpreprocessor.h"
+#include "../polyphase/trianglesparsematrix.h"
+// HapChatCore has no header and is included as its implementation, as in cpp.pxd
+#include "../hapchat/hapchatcore.cpp"
+
+using namespace std;
+
+namespace {
+
+typedef struct parameters_t {
+	unsigned int variants;
+	unsigned int coverage;
+	unsigned int read_length;
+	unsigned int ploidy;
+	unsigned int individuals;
+	unsigned int threads;
+	unsigned int seed;
+} parameters_t;
+
+
+/** Amount of work done by one run of a benchmark case, and the peak memory of its DP columns
+ *  (if known). */
+typedef struct work_t {
+	uint64_t columns;
+	uint64_t rows;
+	uint64_t edges;
+	uint64_t column_bytes;
+} work_t;
+
+
+/** Result of all repetitions of a case, sent from the child process to the parent. */
+typedef struct result_t {
+	bool ok;
+	double min_seconds;
+	double median_seconds;
+	double mean_seconds;
+	work_t work;
+	uint64_t peak_rss_bytes;
+} result_t;
+
+
+/** A prepared benchmark case: run() is timed, everything done before it is not. */
+typedef struct benchmark_case_t {
+	function<void()> run;
+	work_t work;
+} benchmark_case_t;
+
+
+typedef void (*setup_function_t)(const parameters_t& parameters, benchmark_case_t* benchmark_case);
+
+
+/** Reads drawn from the haplotypes of a pedigree in which individuals 0 and 1 are the parents
+ *  of all further individuals. Each read covers read_length consecutive variants, and the reads
+ *  of an individual are evenly spaced such that each variant is covered by coverage reads.
+ *  Alleles are wrong with probability 0.05 and have a uniform quality between 10 and 40.
+ */
+class SyntheticData {
+public:
+	SyntheticData(const parameters_t& parameters) : parameters(parameters), reads(new ReadSet()) {
+		if ((parameters.individuals > 1) && (parameters.ploidy != 2)) {
+			throw std::invalid_argument("Pedigrees with more than one individual must be diploid");
+		}
+		if ((parameters.variants == 0) || (parameters.coverage == 0) || (parameters.read_length == 0)) {
+			throw std::invalid_argument("Number of variants, coverage and read length must be positive");
+		}
+		mt19937 rng(parameters.seed);
+		for (unsigned int v = 0; v < parameters.variants; ++v) {
+			positions.push_back(1000 + 100 * v);
+		}
+		haplotypes.resize(parameters.individuals);
+		for (unsigned int individual = 0; individual < parameters.individuals; ++individual) {
+			for (unsigned int h = 0; h < parameters.ploidy; ++h) {
+				vector<int> haplotype(parameters.variants);
+				if (individual < 2) {
+					for (int& allele : haplotype) allele = rng() % 2;
+				} else {
+					// no recombination: one haplotype from the mother (0), one from the father (1)
+					haplotype = haplotypes[h][rng() % 2];
+				}
+				haplotypes[individual].push_back(haplotype);
+			}
+		}
+		bernoulli_distribution error(0.05);
+		unsigned int read_id = 0;
+		for (unsigned int individual = 0; individual < parameters.individuals; ++individual) {
+			for (uint64_t j = 0; ; ++j) {
+				uint64_t start = j * parameters.read_length / parameters.coverage;
+				if (start >= parameters.variants) break;
+				const vector<int>& haplotype = haplotypes[individual][rng() % parameters.ploidy];
+				Read* read = new Read("read" + to_string(read_id++), 60, 0, individual);
+				uint64_t end = min<uint64_t>(start + parameters.read_length, parameters.variants);
+				for (uint64_t v = start; v < end; ++v) {
+					int allele = error(rng) ? 1 - haplotype[v] : haplotype[v];
+					read->addVariant(positions[v], allele, 10 + rng() % 31);
+				}
+				reads->add(read);
+			}
+		}
+		reads->sort();
+	}
+
+	/** Pedigree with the given genotypes (from the haplotypes) or, if unknown_genotypes is set,
+	 *  empty genotypes and uniform genotype likelihoods, as used for genotyping. */
+	unique_ptr<Pedigree> create_pedigree(bool unknown_genotypes) const {
+		unique_ptr<Pedigree> pedigree(new Pedigree());
+		for (unsigned int individual = 0; individual < parameters.individuals; ++individual) {
+			vector<Genotype*> genotypes;
+			vector<PhredGenotypeLikelihoods*> genotype_likelihoods;
+			for (unsigned int v = 0; v < parameters.variants; ++v) {
+				if (unknown_genotypes) {
+					genotypes.push_back(new Genotype());
+					genotype_likelihoods.push_back(new PhredGenotypeLikelihoods({1.0/3, 1.0/3, 1.0/3}, 2));
+				} else {
+					genotypes.push_back(new Genotype(get_alleles(individual, v)));
+					genotype_likelihoods.push_back(nullptr);
+				}
+			}
+			pedigree->addIndividual(individual, genotypes, genotype_likelihoods);
+		}
+		for (unsigned int child = 2; child < parameters.individuals; ++child) {
+			pedigree->addRelationship(1, 0, child);
+		}
+		return pedigree;
+	}
+
+	/** Maps each allele to its multiplicity in the genotype, for each variant of individual 0. */
+	vector<unordered_map<uint32_t, uint32_t>> get_allele_counts() const {
+		vector<unordered_map<uint32_t, uint32_t>> result(parameters.variants);
+		for (unsigned int v = 0; v < parameters.variants; ++v) {
+			for (uint32_t allele : get_alleles(0, v)) {
+				result[v][allele] += 1;
+			}
+		}
+		return result;
+	}
+
+	const parameters_t parameters;
+	vector<unsigned int> positions;
+	// haplotypes[individual][haplotype][variant]
+	vector<vector<vector<int>>> haplotypes;
+	unique_ptr<ReadSet> reads;
+
+private:
+	vector<uint32_t> get_alleles(unsigned int individual, unsigned int variant) const {
+		vector<uint32_t> alleles;
+		for (const vector<int>& haplotype : haplotypes[individual]) {
+			alleles.push_back(haplotype[variant]);
+		}
+		return alleles;
+	}
+};
+
+
+/** Number of columns and of DP rows (bipartitions of the reads in a column, times the
+ *  transmission configurations of the trios) of the read set. */
+work_t count_dp_rows(const SyntheticData& data) {
+	work_t work = {0, 0, 0, 0};
+	unsigned int trios = data.parameters.individuals > 2 ? data.parameters.individuals - 2 : 0;
+	ColumnIterator iterator(*data.reads);
+	while (iterator.has_next()) {
+		unique_ptr<vector<const Entry*>> column = iterator.get_next();
+		work.columns += 1;
+		work.rows += (((uint64_t)1) << column->size()) << (2 * trios);
+	}
+	return work;
+}
+
+
+TriangleSparseMatrix score_reads(const SyntheticData& data) {
+	TriangleSparseMatrix matrix;
+	ReadScoring().scoreReadsetGlobal(&matrix, data.reads.get(), 2, data.parameters.ploidy, data.parameters.threads);
+	return matrix;
+}
+
+
+vector<vector<uint32_t>> cluster_reads(TriangleSparseMatrix matrix, unsigned int threads) {
+	ClusterEditingSolution solution = ClusterEditingSolver(matrix, false, threads).run();
+	vector<vector<uint32_t>> clusters;
+	for (unsigned int i = 0; i < solution.getNumClusters(); ++i) {
+		clusters.push_back(solution.getCluster(i));
+	}
+	return clusters;
+}
+
+
+void setup_column_iterator(const parameters_t& parameters, benchmark_case_t* benchmark_case) {
+	shared_ptr<SyntheticData> data(new SyntheticData(parameters));
+	benchmark_case->run = [data, benchmark_case]() {
+		ColumnIterator iterator(*data->reads);
+		work_t work = {0, 0, 0, 0};
+		while (iterator.has_next()) {
+			work.columns += 1;
+			work.rows += iterator.get_next()->size();
+		}
+		benchmark_case->work = work;
+	};
+}
+
+
+void setup_pedigree_dp(const parameters_t& parameters, benchmark_case_t* benchmark_case) {
+	shared_ptr<SyntheticData> data(new SyntheticData(parameters));
+	shared_ptr<Pedigree> pedigree(data->create_pedigree(false));
+	benchmark_case->work = count_dp_rows(*data);
+	benchmark_case->run = [data, pedigree, parameters, benchmark_case]() {
+		vector<unsigned int> recombination_costs(parameters.variants, 10);
+		PedigreeDPTable table(data->reads.get(), recombination_costs, pedigree.get(), false, nullptr, parameters.threads);
+		vector<ReadSet*> super_reads;
+		for (unsigned int i = 0; i < parameters.individuals; ++i) {
+			super_reads.push_back(new ReadSet());
+		}
+		vector<unsigned int> transmission_vector;
+		table.get_super_reads(&super_reads, &transmission_vector);
+		for (ReadSet* read_set : super_reads) {
+			delete read_set;
+		}
+		benchmark_case->work.column_bytes = table.get_peak_memory();
+	};
+}
+
+
+void setup_genotype_dp(const parameters_t& parameters, benchmark_case_t* benchmark_case) {
+	shared_ptr<SyntheticData> data(new SyntheticData(parameters));
+	shared_ptr<Pedigree> pedigree(data->create_pedigree(true));
+	benchmark_case->work = count_dp_rows(*data);
+	benchmark_case->run = [data, pedigree, parameters]() {
+		vector<unsigned int> recombination_costs(parameters.variants, 10);
+		GenotypeDPTable<long double> table(data->reads.get(), recombination_costs, pedigree.get());
+		table.get_genotype_likelihoods(0, 0);
+	};
+}
+
+
+void setup_hapchat(const parameters_t& parameters, benchmark_case_t* benchmark_case) {
+	if (parameters.individuals != 1) {
+		throw std::invalid_argument("HapChat phases a single individual");
+	}
+	shared_ptr<SyntheticData> data(new SyntheticData(parameters));
+	// HapChat only computes the rows with few corrections, so only columns are reported
+	benchmark_case->work.columns = count_dp_rows(*data).columns;
+	benchmark_case->run = [data]() {
+		HapChatCore core(data->reads.get());
+		core.get_optimal_cost();
+	};
+}
+
+
+void setup_read_scoring(const parameters_t& parameters, benchmark_case_t* benchmark_case) {
+	shared_ptr<SyntheticData> data(new SyntheticData(parameters));
+	benchmark_case->work.columns = parameters.variants;
+	benchmark_case->run = [data, benchmark_case]() {
+		benchmark_case->work.edges = score_reads(*data).size();
+	};
+}
+
+
+void setup_cluster_editing(const parameters_t& parameters, benchmark_case_t* benchmark_case) {
+	SyntheticData data(parameters);
+	shared_ptr<TriangleSparseMatrix> matrix(new TriangleSparseMatrix(score_reads(data)));
+	benchmark_case->work.edges = matrix->size();
+	benchmark_case->run = [matrix, parameters]() {
+		cluster_reads(*matrix, parameters.threads);
+	};
+}
+
+
+void setup_haplo_threader(const parameters_t& parameters, benchmark_case_t* benchmark_case) {
+	if (parameters.individuals != 1) {
+		throw std::invalid_argument("Threading phases a single individual");
+	}
+	shared_ptr<SyntheticData> data(new SyntheticData(parameters));
+	vector<vector<uint32_t>> clusters = cluster_reads(score_reads(*data), parameters.threads);
+	shared_ptr<ThreadingPreprocessor> preprocessor(new ThreadingPreprocessor(data->reads.get(), clusters, parameters.ploidy));
+	shared_ptr<vector<unordered_map<uint32_t, uint32_t>>> genotypes(new vector<unordered_map<uint32_t, uint32_t>>(data->get_allele_counts()));
+	benchmark_case->work.columns = preprocessor->getNumPositions();
+	benchmark_case->run = [preprocessor, genotypes, parameters]() {
+		// as in whatshap.threading.create_haplothreader
+		uint32_t row_limit = parameters.ploidy > 6 ? 16 * (1u << parameters.ploidy) : 0;
+		HaploThreader threader(parameters.ploidy, 32.0, 8.0, true, row_limit, 0, 0, parameters.threads);
+		threader.computePaths(*preprocessor, *genotypes);
+	};
+}
+
+
+typedef struct benchmark_t {
+	const char* name;
+	setup_function_t setup;
+	// default cases, threads and seed are set from the command line
+	vector<parameters_t> cases;
+} benchmark_t;
+
+
+vector<benchmark_t> get_benchmarks() {
+	// variants, coverage, read length, ploidy, individuals
+	return {
+		{"column_iterator", setup_column_iterator, {{50000, 30, 10, 2, 1, 0, 0}}},
+		{"pedigree_dp", setup_pedigree_dp, {{5000, 12, 8, 2, 1, 0, 0}, {1500, 4, 8, 2, 3, 0, 0}}},
+		{"genotype_dp", setup_genotype_dp, {{5000, 8, 8, 2, 1, 0, 0}, {200, 3, 8, 2, 3, 0, 0}}},
+		{"hapchat", setup_hapchat, {{3000, 12, 8, 2, 1, 0, 0}}},
+		{"read_scoring", setup_read_scoring, {{2000, 40, 30, 4, 1, 0, 0}}},
+		{"cluster_editing", setup_cluster_editing, {{2000, 40, 30, 4, 1, 0, 0}}},
+		{"haplo_threader", setup_haplo_threader, {{2000, 40, 30, 4, 1, 0, 0}}},
+	};
+}
+
+
+string case_name(const benchmark_t& benchmark, const parameters_t& p) {
+	ostringstream name;
+	name << benchmark.name << "/variants:" << p.variants << "/coverage:" << p.coverage << "/read_length:" << p.read_length
+		<< "/ploidy:" << p.ploidy << "/individuals:" << p.individuals << "/threads:" << p.threads;
+	return name.str();
+}
+
+
+result_t run_case(const benchmark_t& benchmark, const parameters_t& parameters, unsigned int repetitions) {
+	result_t result;
+	result.ok = false;
+	benchmark_case_t benchmark_case;
+	benchmark_case.work = {0, 0, 0, 0};
+	benchmark.setup(parameters, &benchmark_case);
+	vector<double> seconds;
+	for (unsigned int i = 0; i < repetitions; ++i) {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		benchmark_case.run();
+		seconds.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+	}
+	sort(seconds.begin(), seconds.end());
+	result.ok = true;
+	result.min_seconds = seconds.front();
+	result.median_seconds = seconds[seconds.size() / 2];
+	result.mean_seconds = 0.0;
+	for (double s : seconds) result.mean_seconds += s / seconds.size();
+	result.work = benchmark_case.work;
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	result.peak_rss_bytes = usage.ru_maxrss;
+#else
+	result.peak_rss_bytes = ((uint64_t)usage.ru_maxrss) * 1024;
+#endif
+	return result;
+}
+
+
+/** Runs the case in a child process, such that peak_rss_bytes only covers this case. */
+result_t run_case_in_child(const benchmark_t& benchmark, const parameters_t& parameters, unsigned int repetitions) {
+	result_t result;
+	memset(&result, 0, sizeof(result));
+	int fds[2];
+	if (pipe(fds) != 0) {
+		throw std::runtime_error("Cannot create pipe");
+	}
+	fflush(stdout);
+	fflush(stderr);
+	pid_t pid = fork();
+	if (pid < 0) {
+		throw std::runtime_error("Cannot fork");
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		try {
+			result = run_case(benchmark, parameters, repetitions);
+		} catch (const std::exception& e) {
+			cerr << case_name(benchmark, parameters) << ": " << e.what() << endl;
+		}
+		ssize_t written = write(fds[1], &result, sizeof(result));
+		_exit(written == (ssize_t)sizeof(result) ? 0 : 1);
+	}
+	close(fds[1]);
+	size_t received = 0;
+	while (received < sizeof(result)) {
+		ssize_t n = read(fds[0], ((char*)&result) + received, sizeof(result) - received);
+		if (n <= 0) break;
+		received += n;
+	}
+	close(fds[0]);
+	int status = 0;
+	waitpid(pid, &status, 0);
+	if ((received < sizeof(result)) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+		result.ok = false;
+	}
+	return result;
+}
+
+
+double per_second(uint64_t amount, double seconds) {
+	return seconds > 0.0 ? amount / seconds : 0.0;
+}
+
+
+void write_json(ostream& out, const vector<string>& names, const vector<parameters_t>& parameters, const vector<result_t>& results, unsigned int repetitions) {
+	char date[64];
+	time_t now = time(nullptr);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+	out.precision(10);
+	out << "{\n  \"context\": {\"date\": \"" << date << "\", \"repetitions\": " << repetitions << "},\n  \"benchmarks\": [";
+	for (size_t i = 0; i < results.size(); ++i) {
+		const parameters_t& p = parameters[i];
+		const result_t& r = results[i];
+		out << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << names[i] << "\", \"benchmark\": \"" << names[i].substr(0, names[i].find('/')) << "\""
+			<< ", \"variants\": " << p.variants << ", \"coverage\": " << p.coverage << ", \"read_length\": " << p.read_length
+			<< ", \"ploidy\": " << p.ploidy << ", \"individuals\": " << p.individuals << ", \"threads\": " << p.threads
+			<< ", \"ok\": " << (r.ok ? "true" : "false");
+		if (r.ok) {
+			out << ", \"min_seconds\": " << r.min_seconds << ", \"median_seconds\": " << r.median_seconds << ", \"mean_seconds\": " << r.mean_seconds
+				<< ", \"columns\": " << r.work.columns << ", \"rows\": " << r.work.rows << ", \"edges\": " << r.work.edges
+				<< ", \"columns_per_second\": " << per_second(r.work.columns, r.min_seconds)
+				<< ", \"rows_per_second\": " << per_second(r.work.rows, r.min_seconds)
+				<< ", \"edges_per_second\": " << per_second(r.work.edges, r.min_seconds)
+				<< ", \"column_bytes\": " << r.work.column_bytes << ", \"peak_rss_bytes\": " << r.peak_rss_bytes;
+		}
+		out << "}";
+	}
+	out << "\n  ]\n}\n";
+}
+
+
+void usage() {
+	cerr << "Usage: benchmarks [--filter SUBSTRING] [--repetitions N] [--threads N] [--seed N]\n"
+		<< "                  [--variants N] [--coverage N] [--read-length N] [--ploidy N]\n"
+		<< "                  [--individuals N] [--json FILE] [--no-fork] [--list]" << endl;
+}
+
+}
+
+
+int main(int argc, char* argv[]) {
+	string filter;
+	string json_path;
+	unsigned int repetitions = 3;
+	unsigned int threads = 1;
+	unsigned int seed = 1;
+	bool fork_cases = true;
+	bool list_only = false;
+	unordered_map<string, unsigned int> overrides;
+	for (int i = 1; i < argc; ++i) {
+		string option(argv[i]);
+		if (option == "--no-fork") {
+			fork_cases = false;
+			continue;
+		}
+		if (option == "--list") {
+			list_only = true;
+			continue;
+		}
+		if ((option == "-h") || (option == "--help")) {
+			usage();
+			return 0;
+		}
+		if (i + 1 >= argc) {
+			usage();
+			return 2;
+		}
+		string value(argv[++i]);
+		if (option == "--filter") {
+			filter = value;
+		} else if (option == "--json") {
+			json_path = value;
+		} else if ((option == "--repetitions") || (option == "--threads") || (option == "--seed") || (option == "--variants")
+				|| (option == "--coverage") || (option == "--read-length") || (option == "--ploidy") || (option == "--individuals")) {
+			unsigned int number = strtoul(value.c_str(), nullptr, 10);
+			if (option == "--repetitions") repetitions = max(number, 1u);
+			else if (option == "--threads") threads = max(number, 1u);
+			else if (option == "--seed") seed = number;
+			else overrides[option] = number;
+		} else {
+			usage();
+			return 2;
+		}
+	}
+
+	vector<string> names;
+	vector<parameters_t> all_parameters;
+	vector<result_t> results;
+	ostream& table = (json_path == "-") ? cerr : cout;
+	char line[256];
+	if (!list_only) {
+		snprintf(line, sizeof(line), "%-90s %12s %14s %14s %14s %12s", "benchmark", "seconds", "columns/s", "rows/s", "edges/s", "peak RSS MB");
+		table << line << endl;
+	}
+	bool failed = false;
+	for (const benchmark_t& benchmark : get_benchmarks()) {
+		for (parameters_t parameters : benchmark.cases) {
+			if (overrides.count("--variants")) parameters.variants = overrides["--variants"];
+			if (overrides.count("--coverage")) parameters.coverage = overrides["--coverage"];
+			if (overrides.count("--read-length")) parameters.read_length = overrides["--read-length"];
+			if (overrides.count("--ploidy")) parameters.ploidy = overrides["--ploidy"];
+			if (overrides.count("--individuals")) parameters.individuals = overrides["--individuals"];
+			parameters.threads = threads;
+			parameters.seed = seed;
+			string name = case_name(benchmark, parameters);
+			if (name.find(filter) == string::npos) continue;
+			if (list_only) {
+				cout << name << endl;
+				continue;
+			}
+			result_t result;
+			memset(&result, 0, sizeof(result));
+			if (fork_cases) {
+				result = run_case_in_child(benchmark, parameters, repetitions);
+			} else {
+				try {
+					result = run_case(benchmark, parameters, repetitions);
+				} catch (const std::exception& e) {
+					cerr << name << ": " << e.what() << endl;
+					result.ok = false;
+				}
+			}
+			if (result.ok) {
+				snprintf(line, sizeof(line), "%-90s %12.4f %14.4g %14.4g %14.4g %12.1f", name.c_str(), result.min_seconds,
+					per_second(result.work.columns, result.min_seconds), per_second(result.work.rows, result.min_seconds),
+					per_second(result.work.edges, result.min_seconds), result.peak_rss_bytes / 1e6);
+			} else {
+				snprintf(line, sizeof(line), "%-90s %12s", name.c_str(), "FAILED");
+				failed = true;
+			}
+			table << line << endl;
+			names.push_back(name);
+			all_parameters.push_back(parameters);
+			results.push_back(result);
+		}
+	}
+	if (!json_path.empty() && !list_only) {
+		if (json_path == "-") {
+			write_json(cout, names, all_parameters, results, repetitions);
+		} else {
+			ofstream out(json_path);
+			write_json(out, names, all_parameters, results, repetitions);
+		}
+	}
+	return failed ? 1 : 0;
+}
@@ -1,13 +1,50 @@
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
 #include "binomial.h"
 
+namespace {
+	// all coefficients with n < TABLE_SIZE fit into an int (binomial(34, 17) does not)
+	const int TABLE_SIZE = 34;
+
+	int compute_binomial_coefficient(int n, int k) {
+		if (k < 0 || n < 0 || n < k) return 0;
+		if (k > n-k) k = n-k;
+
+		// result is binomial(n, i) after step i, which never exceeds the final result
+		uint64_t result = 1;
+		for (int i = 0; i < k; i++){
+			if (result > std::numeric_limits<uint64_t>::max() / (n-i)) {
+				throw std::overflow_error("binomial_coefficient: result does not fit into an int");
+			}
+			result *= (n-i);
+			result /= (i+1);
+		}
+		if (result > (uint64_t)std::numeric_limits<int>::max()) {
+			throw std::overflow_error("binomial_coefficient: result does not fit into an int");
+		}
+		return (int)result;
+	}
+
+	std::array<std::array<int, TABLE_SIZE>, TABLE_SIZE> precompute_binomial_coefficients() {
+		std::array<std::array<int, TABLE_SIZE>, TABLE_SIZE> table;
+		for (int n = 0; n < TABLE_SIZE; n++) {
+			for (int k = 0; k < TABLE_SIZE; k++) {
+				table[n][k] = compute_binomial_coefficient(n, k);
+			}
+		}
+		return table;
+	}
+}
+
 int binomial_coefficient(int n, int k){
 	if (k < 0 || n < 0 || n < k) return 0;
-	int result = 1;
-	if (k > n-k) k = n-k;
-
-	for (int i = 0; i < k; i++){
-		result *= (n-i);
-		result /= (i+1);
+	if (n < TABLE_SIZE) {
+		// coefficients for all n, k < TABLE_SIZE, which covers all genotype indices of supported ploidies
+		static const std::array<std::array<int, TABLE_SIZE>, TABLE_SIZE> binomial_table = precompute_binomial_coefficients();
+		return binomial_table[n][k];
 	}
-	return result;
+	return compute_binomial_coefficient(n, k);
 }
@@ -4,6 +4,8 @@
 /**
 * Computes the Binomial Coefficient. 
 * Use implementation here: https://www.geeksforgeeks.org/space-and-time-efficient-binomial-coefficient
+* Values for small n are looked up in a table that is computed once.
+* Throws std::overflow_error if the result does not fit into an int.
 */
 
 int binomial_coefficient(int n, int k);
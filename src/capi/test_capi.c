@@ -0,0 +1,100 @@
+/* Tests of the C API on a small diploid example. Returns a nonzero exit status on failure. */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "whatshap.h"
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			fprintf(stderr, "%s:%d: check failed: %s (%s)\n", __FILE__, __LINE__, #condition, whatshap_last_error()); \
+			++failures; \
+		} \
+	} while (0)
+
+#define VARIANTS 3
+
+static const unsigned int positions[VARIANTS] = {100, 200, 300};
+static const unsigned int recombination_costs[VARIANTS] = {10, 10, 10};
+static const int genotypes[2 * VARIANTS] = {0, 1, 0, 1, 0, 1};
+
+/* Checks that the haplotypes are 0,0,1 and 1,1,0 (in any order). */
+static void check_diploid_haplotypes(const int* haplotypes) {
+	static const int expected[VARIANTS] = {0, 0, 1};
+	int first = haplotypes[0];
+	int v;
+	CHECK((first == 0) || (first == 1));
+	for (v = 0; v < VARIANTS; ++v) {
+		CHECK(haplotypes[v] == (expected[v] ^ first));
+		CHECK(haplotypes[VARIANTS + v] == (1 - (expected[v] ^ first)));
+	}
+}
+
+int main(void) {
+	/* the last read has no variant at the given positions */
+	const size_t variant_offsets[] = {0, 2, 4, 6, 8, 9};
+	const unsigned int read_positions[] = {100, 200, 300, 200, 100, 200, 200, 300, 400};
+	const int alleles[] = {0, 0, 1, 0, 1, 1, 1, 0, 1};
+	const unsigned int qualities[] = {20, 20, 20, 20, 20, 20, 20, 20, 20};
+	const unsigned int unsorted[] = {200, 100};
+	whatshap_readset_t* readset = NULL;
+	whatshap_pedigree_t* pedigree = NULL;
+	int haplotypes[2 * VARIANTS];
+	int read_partition[5];
+	int block_starts[VARIANTS];
+	unsigned int cost = 0;
+	double likelihoods[3 * VARIANTS];
+	int v;
+
+	CHECK(whatshap_api_version() == WHATSHAP_API_VERSION);
+	CHECK(whatshap_readset_create(5, variant_offsets, read_positions, alleles, qualities, NULL, NULL, &readset) == WHATSHAP_OK);
+	CHECK(whatshap_readset_size(readset) == 5);
+	CHECK(whatshap_pedigree_create(VARIANTS, &pedigree) == WHATSHAP_OK);
+	CHECK(whatshap_pedigree_add_individual(pedigree, 0, genotypes, NULL) == WHATSHAP_OK);
+	CHECK(whatshap_pedigree_size(pedigree) == 1);
+
+	CHECK(whatshap_phase(readset, pedigree, positions, recombination_costs, 0, 1, WHATSHAP_CHECKPOINT_AUTO, 0,
+		haplotypes, NULL, read_partition, &cost) == WHATSHAP_OK);
+	check_diploid_haplotypes(haplotypes);
+	CHECK(cost == 0);
+	/* reads given in the order 2, 1 are assigned to haplotypes in the order of their alleles */
+	CHECK(read_partition[0] != read_partition[2]);
+	CHECK(read_partition[1] == read_partition[0]);
+	CHECK(read_partition[3] == read_partition[2]);
+	CHECK(read_partition[4] == -1);
+
+	CHECK(whatshap_phase_hapchat(readset, VARIANTS, positions, haplotypes, &cost) == WHATSHAP_OK);
+	check_diploid_haplotypes(haplotypes);
+	CHECK(cost == 0);
+
+	CHECK(whatshap_polyphase(readset, VARIANTS, positions, 2, (const unsigned int*)genotypes, 1, 1, 1, 4, 1,
+		haplotypes, block_starts) == WHATSHAP_OK);
+	for (v = 0; v < VARIANTS; ++v) {
+		CHECK(haplotypes[v] + haplotypes[VARIANTS + v] == 1);
+	}
+
+	CHECK(whatshap_genotype(readset, pedigree, positions, recombination_costs, 1, 1, WHATSHAP_CHECKPOINT_AUTO, 0,
+		likelihoods) == WHATSHAP_OK);
+	for (v = 0; v < VARIANTS; ++v) {
+		CHECK(fabs(likelihoods[3*v] + likelihoods[3*v + 1] + likelihoods[3*v + 2] - 1.0) < 1e-9);
+		/* every variant is covered by reads with both alleles */
+		CHECK(likelihoods[3*v + 1] > 0.5);
+	}
+
+	CHECK(whatshap_phase(readset, pedigree, unsorted, recombination_costs, 0, 1, WHATSHAP_CHECKPOINT_AUTO, 0,
+		haplotypes, NULL, NULL, NULL) == WHATSHAP_ERROR_INVALID_ARGUMENT);
+	CHECK(strstr(whatshap_last_error(), "sorted") != NULL);
+	CHECK(whatshap_pedigree_add_trio(pedigree, 1, 2, 0) == WHATSHAP_ERROR_INVALID_ARGUMENT);
+
+	whatshap_pedigree_free(pedigree);
+	whatshap_readset_free(readset);
+	if (failures > 0) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	return 0;
+}
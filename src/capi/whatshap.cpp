@@ -0,0 +1,562 @@
+/** Implementation of the C API declared in whatshap.h. Each function checks its arguments,
+ *  converts them into the types of the C++ core and translates exceptions into status codes.
+ */
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "whatshap.h"
+#include "../genotype.h"
+#include "../genotypedptable.h"
+#include "../pedigree.h"
+#include "../pedigreedptable.h"
+#include "../phredgenotypelikelihoods.h"
+#include "../read.h"
+#include "../readset.h"
+#include "../polyphase/blockphaser.h"
+#include "../polyphase/readscoring.h"
+// HapChatCore has no header and is included as its implementation, as in cpp.pxd
+#include "../hapchat/hapchatcore.cpp"
+
+using namespace std;
+
+struct whatshap_readset {
+	// sorted by position
+	ReadSet reads;
+	// index of every read of reads in the input of whatshap_readset_create
+	vector<size_t> input_index;
+};
+
+struct whatshap_pedigree {
+	size_t variant_count;
+	vector<unsigned int> sample_ids;
+	// for each individual, two alleles per variant (empty if all are unknown)
+	vector<vector<int> > genotypes;
+	// for each individual, three likelihoods per variant (empty if none were given)
+	vector<vector<double> > genotype_likelihoods;
+	// father, mother and child of each trio
+	vector<array<unsigned int, 3> > trios;
+};
+
+namespace {
+
+thread_local string last_error;
+
+/** Runs f and translates exceptions into status codes, storing the error message. */
+template <typename Function>
+whatshap_status_t guarded(Function f) {
+	last_error.clear();
+	try {
+		f();
+		return WHATSHAP_OK;
+	} catch (const std::invalid_argument& e) {
+		last_error = e.what();
+		return WHATSHAP_ERROR_INVALID_ARGUMENT;
+	} catch (const std::bad_alloc&) {
+		last_error = "out of memory";
+		return WHATSHAP_ERROR_OUT_OF_MEMORY;
+	} catch (const std::exception& e) {
+		last_error = e.what();
+		return WHATSHAP_ERROR_FAILED;
+	}
+}
+
+void require(bool condition, const string& message) {
+	if (!condition) {
+		throw std::invalid_argument(message);
+	}
+}
+
+/** Checks that positions are sorted and distinct and returns the index of every position. */
+unordered_map<unsigned int, size_t> index_positions(size_t variant_count, const unsigned int* positions) {
+	require((positions != nullptr) || (variant_count == 0), "positions must not be NULL");
+	unordered_map<unsigned int, size_t> index;
+	index.reserve(variant_count);
+	for (size_t v = 0; v < variant_count; ++v) {
+		require((v == 0) || (positions[v-1] < positions[v]), "positions must be sorted and distinct");
+		index[positions[v]] = v;
+	}
+	return index;
+}
+
+/** Returns the indices of the variants covered by at least one read, in ascending order. */
+vector<size_t> covered_variants(const ReadSet& reads, const unordered_map<unsigned int, size_t>& index) {
+	vector<bool> covered(index.size(), false);
+	for (size_t i = 0; i < reads.size(); ++i) {
+		const Read* read = reads.get(i);
+		for (int j = 0; j < read->getVariantCount(); ++j) {
+			auto it = index.find(read->getPosition(j));
+			if (it != index.end()) {
+				covered[it->second] = true;
+			}
+		}
+	}
+	vector<size_t> variants;
+	for (size_t v = 0; v < covered.size(); ++v) {
+		if (covered[v]) {
+			variants.push_back(v);
+		}
+	}
+	return variants;
+}
+
+/** Checks that all variants of the reads are biallelic. */
+void require_biallelic(const ReadSet& reads) {
+	for (size_t i = 0; i < reads.size(); ++i) {
+		const Read* read = reads.get(i);
+		for (int j = 0; j < read->getVariantCount(); ++j) {
+			require(read->getAllele(j) <= 1, "only alleles 0 and 1 are supported");
+		}
+	}
+}
+
+/** Returns a sorted copy of the reads that only contains their variants at the given positions
+ *  and omits reads without such variants. If origin is given, it receives the index in reads
+ *  of every read of the copy. */
+unique_ptr<ReadSet> restrict_reads(const ReadSet& reads, const unordered_map<unsigned int, size_t>& index, vector<size_t>* origin = nullptr) {
+	unique_ptr<ReadSet> result(new ReadSet());
+	for (size_t i = 0; i < reads.size(); ++i) {
+		const Read* read = reads.get(i);
+		unique_ptr<Read> restricted(new Read(read->getName(), read->getMapqs()[0], read->getSourceID(), read->getSampleID(), read->getReferenceStart(), read->getBXTag()));
+		for (int j = 0; j < read->getVariantCount(); ++j) {
+			if (index.count(read->getPosition(j)) > 0) {
+				restricted->addVariant(read->getPosition(j), read->getAllele(j), read->getVariantQuality(j));
+			}
+		}
+		if (restricted->getVariantCount() > 0) {
+			restricted->setID(i);
+			result->add(restricted.release());
+		}
+	}
+	// reads may start at other variants than before
+	result->sort();
+	if (origin != nullptr) {
+		origin->clear();
+		for (size_t i = 0; i < result->size(); ++i) {
+			origin->push_back(result->get(i)->getID());
+		}
+	}
+	result->reassignReadIds();
+	return result;
+}
+
+/** Creates a Pedigree with the genotypes of the given variants. Individuals without genotype
+ *  likelihoods get uniform ones if uniform_priors is set (GenotypeDPTable needs priors). */
+unique_ptr<Pedigree> build_pedigree(const whatshap_pedigree& pedigree, const vector<size_t>& variants, bool uniform_priors = false) {
+	unique_ptr<Pedigree> result(new Pedigree());
+	for (size_t i = 0; i < pedigree.sample_ids.size(); ++i) {
+		vector<Genotype*> genotypes;
+		vector<PhredGenotypeLikelihoods*> genotype_likelihoods;
+		for (size_t v : variants) {
+			const vector<int>& alleles = pedigree.genotypes[i];
+			if (alleles.empty() || (alleles[2*v] < 0) || (alleles[2*v+1] < 0)) {
+				genotypes.push_back(new Genotype());
+			} else {
+				genotypes.push_back(new Genotype(vector<uint32_t>{(uint32_t)alleles[2*v], (uint32_t)alleles[2*v+1]}));
+			}
+			const vector<double>& likelihoods = pedigree.genotype_likelihoods[i];
+			if (likelihoods.empty()) {
+				genotype_likelihoods.push_back(uniform_priors ? new PhredGenotypeLikelihoods(vector<double>(3, 1.0 / 3.0), 2) : nullptr);
+			} else {
+				genotype_likelihoods.push_back(new PhredGenotypeLikelihoods(vector<double>(likelihoods.begin() + 3*v, likelihoods.begin() + 3*v + 3), 2));
+			}
+		}
+		result->addIndividual(pedigree.sample_ids[i], genotypes, genotype_likelihoods);
+	}
+	for (const array<unsigned int, 3>& trio : pedigree.trios) {
+		result->addRelationship(trio[0], trio[1], trio[2]);
+	}
+	return result;
+}
+
+/** Checks that all reads belong to individuals of the pedigree. */
+void require_samples(const ReadSet& reads, const whatshap_pedigree& pedigree) {
+	for (size_t i = 0; i < reads.size(); ++i) {
+		unsigned int sample_id = reads.get(i)->getSampleID();
+		require(find(pedigree.sample_ids.begin(), pedigree.sample_ids.end(), sample_id) != pedigree.sample_ids.end(),
+			"read of sample " + to_string(sample_id) + ", which is not in the pedigree");
+	}
+}
+
+/** Returns the allele of a phased variant, or -1 if there is none. */
+int phased_allele(int allele) {
+	return ((allele == Entry::REF_ALLELE) || (allele == Entry::ALT_ALLELE)) ? allele : -1;
+}
+
+/** Splits the reads into one read set per block, where block b consists of the variants
+ *  block_starts[b], ..., block_starts[b+1]-1 (indices into variant_positions). Reads that span
+ *  several blocks are split, as split_readset in whatshap/cli/polyphase.py does. */
+vector<unique_ptr<ReadSet> > split_reads(const ReadSet& reads, const vector<unsigned int>& variant_positions, const vector<uint32_t>& block_starts) {
+	unordered_map<unsigned int, size_t> variant_block;
+	for (size_t b = 0; b + 1 < block_starts.size(); ++b) {
+		for (size_t v = block_starts[b]; v < block_starts[b+1]; ++v) {
+			variant_block[variant_positions[v]] = b;
+		}
+	}
+	vector<unique_ptr<ReadSet> > blocks;
+	for (size_t b = 0; b + 1 < block_starts.size(); ++b) {
+		blocks.emplace_back(new ReadSet());
+	}
+	for (size_t i = 0; i < reads.size(); ++i) {
+		const Read* read = reads.get(i);
+		size_t first = variant_block.at(read->firstPosition());
+		if (first == variant_block.at(read->lastPosition())) {
+			blocks[first]->add(new Read(*read));
+			continue;
+		}
+		size_t block = first;
+		unique_ptr<Read> slice(new Read(read->getName(), read->getMapqs()[0], read->getSourceID(), read->getSampleID(), read->getReferenceStart(), read->getBXTag()));
+		for (int j = 0; j < read->getVariantCount(); ++j) {
+			size_t variant_block_index = variant_block.at(read->getPosition(j));
+			if (variant_block_index != block) {
+				blocks[block]->add(slice.release());
+				block = variant_block_index;
+				slice.reset(new Read(to_string(block) + "_" + read->getName(), read->getMapqs()[0], read->getSourceID(), read->getSampleID(), read->getReferenceStart(), read->getBXTag()));
+			}
+			slice->addVariant(read->getPosition(j), read->getAllele(j), read->getVariantQuality(j));
+		}
+		blocks[block]->add(slice.release());
+	}
+	return blocks;
+}
+
+}
+
+int whatshap_api_version(void) {
+	return WHATSHAP_API_VERSION;
+}
+
+const char* whatshap_last_error(void) {
+	return last_error.c_str();
+}
+
+whatshap_status_t whatshap_readset_create(size_t read_count, const size_t* variant_offsets,
+	const unsigned int* positions, const int* alleles, const unsigned int* qualities,
+	const unsigned int* sample_ids, const int* mapqs, whatshap_readset_t** readset)
+{
+	return guarded([&] () {
+		require(readset != nullptr, "readset must not be NULL");
+		*readset = nullptr;
+		require((variant_offsets != nullptr) || (read_count == 0), "variant_offsets must not be NULL");
+		require(((positions != nullptr) && (alleles != nullptr) && (qualities != nullptr)) || (read_count == 0),
+			"positions, alleles and qualities must not be NULL");
+		unique_ptr<whatshap_readset> result(new whatshap_readset());
+		for (size_t i = 0; i < read_count; ++i) {
+			require(variant_offsets[i] < variant_offsets[i+1], "read " + to_string(i) + " has no variants");
+			int sample_id = (sample_ids != nullptr) ? sample_ids[i] : 0;
+			int mapq = (mapqs != nullptr) ? mapqs[i] : 0;
+			unique_ptr<Read> read(new Read("read" + to_string(i), mapq, 0, sample_id));
+			for (size_t j = variant_offsets[i]; j < variant_offsets[i+1]; ++j) {
+				require(alleles[j] >= 0, "alleles must not be negative");
+				read->addVariant(positions[j], alleles[j], qualities[j]);
+			}
+			read->sortVariants();
+			// remember the input order, which sorting the reads changes
+			read->setID(i);
+			result->reads.add(read.release());
+		}
+		result->reads.sort();
+		result->input_index.resize(read_count);
+		for (size_t i = 0; i < read_count; ++i) {
+			result->input_index[i] = result->reads.get(i)->getID();
+		}
+		result->reads.reassignReadIds();
+		*readset = result.release();
+	});
+}
+
+void whatshap_readset_free(whatshap_readset_t* readset) {
+	delete readset;
+}
+
+size_t whatshap_readset_size(const whatshap_readset_t* readset) {
+	return readset->reads.size();
+}
+
+whatshap_status_t whatshap_pedigree_create(size_t variant_count, whatshap_pedigree_t** pedigree) {
+	return guarded([&] () {
+		require(pedigree != nullptr, "pedigree must not be NULL");
+		*pedigree = new whatshap_pedigree();
+		(*pedigree)->variant_count = variant_count;
+	});
+}
+
+void whatshap_pedigree_free(whatshap_pedigree_t* pedigree) {
+	delete pedigree;
+}
+
+whatshap_status_t whatshap_pedigree_add_individual(whatshap_pedigree_t* pedigree, unsigned int sample_id,
+	const int* genotypes, const double* genotype_likelihoods)
+{
+	return guarded([&] () {
+		require(pedigree != nullptr, "pedigree must not be NULL");
+		require(find(pedigree->sample_ids.begin(), pedigree->sample_ids.end(), sample_id) == pedigree->sample_ids.end(),
+			"individual " + to_string(sample_id) + " has already been added");
+		size_t n = pedigree->variant_count;
+		vector<int> alleles;
+		if (genotypes != nullptr) {
+			alleles.assign(genotypes, genotypes + 2*n);
+		}
+		vector<double> likelihoods;
+		if (genotype_likelihoods != nullptr) {
+			likelihoods.assign(genotype_likelihoods, genotype_likelihoods + 3*n);
+		}
+		pedigree->sample_ids.push_back(sample_id);
+		pedigree->genotypes.push_back(move(alleles));
+		pedigree->genotype_likelihoods.push_back(move(likelihoods));
+	});
+}
+
+whatshap_status_t whatshap_pedigree_add_trio(whatshap_pedigree_t* pedigree, unsigned int father_sample_id,
+	unsigned int mother_sample_id, unsigned int child_sample_id)
+{
+	return guarded([&] () {
+		require(pedigree != nullptr, "pedigree must not be NULL");
+		for (unsigned int sample_id : {father_sample_id, mother_sample_id, child_sample_id}) {
+			require(find(pedigree->sample_ids.begin(), pedigree->sample_ids.end(), sample_id) != pedigree->sample_ids.end(),
+				"individual " + to_string(sample_id) + " has not been added");
+		}
+		pedigree->trios.push_back({{father_sample_id, mother_sample_id, child_sample_id}});
+	});
+}
+
+size_t whatshap_pedigree_size(const whatshap_pedigree_t* pedigree) {
+	return pedigree->sample_ids.size();
+}
+
+whatshap_status_t whatshap_phase(const whatshap_readset_t* readset, const whatshap_pedigree_t* pedigree,
+	const unsigned int* positions, const unsigned int* recombination_costs, int distrust_genotypes,
+	unsigned int threads, whatshap_checkpoint_policy_t checkpoint_policy, size_t memory_limit,
+	int* haplotypes, unsigned int* transmission_values, int* read_partition, unsigned int* cost)
+{
+	return guarded([&] () {
+		require((readset != nullptr) && (pedigree != nullptr), "readset and pedigree must not be NULL");
+		size_t variant_count = pedigree->variant_count;
+		require((recombination_costs != nullptr) || (variant_count == 0), "recombination_costs must not be NULL");
+		require(haplotypes != nullptr, "haplotypes must not be NULL");
+		require(threads > 0, "threads must be positive");
+		unordered_map<unsigned int, size_t> index = index_positions(variant_count, positions);
+		vector<size_t> origin;
+		unique_ptr<ReadSet> reads = restrict_reads(readset->reads, index, &origin);
+		require_biallelic(*reads);
+		require_samples(*reads, *pedigree);
+
+		size_t individual_count = pedigree->sample_ids.size();
+		fill(haplotypes, haplotypes + 2 * individual_count * variant_count, -1);
+		if (transmission_values != nullptr) {
+			fill(transmission_values, transmission_values + variant_count, 0);
+		}
+		vector<size_t> variants = covered_variants(*reads, index);
+		vector<unsigned int> column_positions;
+		vector<unsigned int> column_costs;
+		for (size_t v : variants) {
+			column_positions.push_back(positions[v]);
+			column_costs.push_back(recombination_costs[v]);
+		}
+		unique_ptr<Pedigree> dp_pedigree = build_pedigree(*pedigree, variants);
+		PedigreeDPTable table(reads.get(), column_costs, dp_pedigree.get(), distrust_genotypes != 0, &column_positions, threads, (checkpoint_policy_t)checkpoint_policy, memory_limit);
+
+		for (size_t c = 0; c < table.get_column_count(); ++c) {
+			unsigned int transmission_value = 0;
+			vector<PedigreeColumnCostComputer::phased_variant_t> column = table.get_phased_column(c, &transmission_value);
+			size_t v = variants[c];
+			for (size_t i = 0; i < individual_count; ++i) {
+				haplotypes[2*i*variant_count + v] = phased_allele(column[i].allele0);
+				haplotypes[(2*i + 1)*variant_count + v] = phased_allele(column[i].allele1);
+			}
+			if (transmission_values != nullptr) {
+				transmission_values[v] = transmission_value;
+			}
+		}
+		if (read_partition != nullptr) {
+			fill(read_partition, read_partition + readset->reads.size(), -1);
+			unique_ptr<vector<bool> > partitioning(table.get_optimal_partitioning());
+			for (size_t i = 0; i < reads->size(); ++i) {
+				read_partition[readset->input_index[origin[i]]] = partitioning->at(i) ? 1 : 0;
+			}
+		}
+		if (cost != nullptr) {
+			*cost = table.get_optimal_score();
+		}
+	});
+}
+
+whatshap_status_t whatshap_genotype(const whatshap_readset_t* readset, const whatshap_pedigree_t* pedigree,
+	const unsigned int* positions, const unsigned int* recombination_costs, int double_precision, int concurrent,
+	whatshap_checkpoint_policy_t checkpoint_policy, size_t memory_limit, double* likelihoods)
+{
+	return guarded([&] () {
+		require((readset != nullptr) && (pedigree != nullptr), "readset and pedigree must not be NULL");
+		size_t variant_count = pedigree->variant_count;
+		require((recombination_costs != nullptr) || (variant_count == 0), "recombination_costs must not be NULL");
+		require(likelihoods != nullptr, "likelihoods must not be NULL");
+		unordered_map<unsigned int, size_t> index = index_positions(variant_count, positions);
+		unique_ptr<ReadSet> reads = restrict_reads(readset->reads, index);
+		require_biallelic(*reads);
+		require_samples(*reads, *pedigree);
+
+		// variants without reads keep their priors
+		size_t individual_count = pedigree->sample_ids.size();
+		for (size_t i = 0; i < individual_count; ++i) {
+			const vector<double>& priors = pedigree->genotype_likelihoods[i];
+			for (size_t v = 0; v < variant_count; ++v) {
+				double* out = likelihoods + 3 * (i * variant_count + v);
+				if (priors.empty()) {
+					fill(out, out + 3, 1.0 / 3.0);
+				} else {
+					double sum = priors[3*v] + priors[3*v+1] + priors[3*v+2];
+					for (size_t g = 0; g < 3; ++g) {
+						out[g] = priors[3*v+g] / sum;
+					}
+				}
+			}
+		}
+		vector<size_t> variants = covered_variants(*reads, index);
+		vector<unsigned int> column_positions;
+		vector<unsigned int> column_costs;
+		for (size_t v : variants) {
+			column_positions.push_back(positions[v]);
+			column_costs.push_back(recombination_costs[v]);
+		}
+		unique_ptr<Pedigree> dp_pedigree = build_pedigree(*pedigree, variants, true);
+
+		auto store = [&] (size_t i, size_t c, const vector<long double>& column_likelihoods) {
+			double* out = likelihoods + 3 * (i * variant_count + variants[c]);
+			for (size_t g = 0; g < 3; ++g) {
+				out[g] = column_likelihoods[g];
+			}
+		};
+		if (double_precision) {
+			GenotypeDPTable<double> table(reads.get(), column_costs, dp_pedigree.get(), &column_positions, (checkpoint_policy_t)checkpoint_policy, memory_limit, concurrent != 0);
+			for (size_t i = 0; i < individual_count; ++i) {
+				for (size_t c = 0; c < variants.size(); ++c) {
+					store(i, c, table.get_genotype_likelihoods(pedigree->sample_ids[i], c));
+				}
+			}
+		} else {
+			GenotypeDPTable<long double> table(reads.get(), column_costs, dp_pedigree.get(), &column_positions, (checkpoint_policy_t)checkpoint_policy, memory_limit, concurrent != 0);
+			for (size_t i = 0; i < individual_count; ++i) {
+				for (size_t c = 0; c < variants.size(); ++c) {
+					store(i, c, table.get_genotype_likelihoods(pedigree->sample_ids[i], c));
+				}
+			}
+		}
+	});
+}
+
+whatshap_status_t whatshap_phase_hapchat(const whatshap_readset_t* readset, size_t variant_count,
+	const unsigned int* positions, int* haplotypes, unsigned int* cost)
+{
+	return guarded([&] () {
+		require(readset != nullptr, "readset must not be NULL");
+		require(haplotypes != nullptr, "haplotypes must not be NULL");
+		unordered_map<unsigned int, size_t> index = index_positions(variant_count, positions);
+		unique_ptr<ReadSet> reads = restrict_reads(readset->reads, index);
+		require_biallelic(*reads);
+
+		fill(haplotypes, haplotypes + 2 * variant_count, -1);
+		HapChatCore core(reads.get());
+		vector<unique_ptr<ReadSet> > superreads;
+		vector<ReadSet*> superread_pointers;
+		for (int i = 0; i < core.get_length(); ++i) {
+			superreads.emplace_back(new ReadSet());
+			superread_pointers.push_back(superreads.back().get());
+		}
+		core.get_super_reads(&superread_pointers);
+		for (const unique_ptr<ReadSet>& superread_set : superreads) {
+			for (size_t h = 0; h < min<size_t>(2, superread_set->size()); ++h) {
+				const Read* superread = superread_set->get(h);
+				for (int j = 0; j < superread->getVariantCount(); ++j) {
+					auto it = index.find(superread->getPosition(j));
+					if (it != index.end()) {
+						haplotypes[h * variant_count + it->second] = phased_allele(superread->getAllele(j));
+					}
+				}
+			}
+		}
+		if (cost != nullptr) {
+			*cost = core.get_optimal_cost();
+		}
+	});
+}
+
+whatshap_status_t whatshap_polyphase(const whatshap_readset_t* readset, size_t variant_count,
+	const unsigned int* positions, unsigned int ploidy, const unsigned int* genotypes, unsigned int min_overlap,
+	int bundle_edges, unsigned int refinements, unsigned int block_cut_sensitivity, unsigned int threads,
+	int* haplotypes, int* block_starts)
+{
+	return guarded([&] () {
+		require(readset != nullptr, "readset must not be NULL");
+		require((genotypes != nullptr) || (variant_count == 0), "genotypes must not be NULL");
+		require(haplotypes != nullptr, "haplotypes must not be NULL");
+		require(ploidy >= 2, "ploidy must be at least 2");
+		require(block_cut_sensitivity <= 5, "block_cut_sensitivity must be between 0 and 5");
+		require(threads > 0, "threads must be positive");
+		unordered_map<unsigned int, size_t> index = index_positions(variant_count, positions);
+
+		fill(haplotypes, haplotypes + ploidy * variant_count, -1);
+		if (block_starts != nullptr) {
+			fill(block_starts, block_starts + variant_count, -1);
+		}
+		unique_ptr<ReadSet> reads = restrict_reads(readset->reads, index);
+		vector<size_t> variants = covered_variants(*reads, index);
+		if (variants.empty()) {
+			return;
+		}
+		vector<unsigned int> variant_positions;
+		for (size_t v : variants) {
+			variant_positions.push_back(positions[v]);
+		}
+
+		// split the variants into blocks with weak linkage, as phase_single_individual does
+		vector<uint32_t> starts = {0};
+		if (block_cut_sensitivity > 0) {
+			starts = ReadScoring().computeLinkageBasedBlockStarts(reads.get(), ploidy, block_cut_sensitivity == 1);
+		}
+		starts.push_back(variants.size());
+		vector<unique_ptr<ReadSet> > blocks = split_reads(*reads, variant_positions, starts);
+		vector<ReadSet*> block_pointers;
+		vector<vector<unordered_map<uint32_t, uint32_t> > > genotype_slices;
+		for (size_t b = 0; b < blocks.size(); ++b) {
+			block_pointers.push_back(blocks[b].get());
+			genotype_slices.emplace_back();
+			for (size_t k = starts[b]; k < starts[b+1]; ++k) {
+				unordered_map<uint32_t, uint32_t> allele_count;
+				for (size_t h = 0; h < ploidy; ++h) {
+					allele_count[genotypes[variants[k] * ploidy + h]] += 1;
+				}
+				genotype_slices.back().push_back(allele_count);
+			}
+		}
+		BlockPhaser phaser(ploidy, min_overlap, bundle_edges != 0, refinements, block_cut_sensitivity, 0, 0, threads);
+		vector<BlockPhasingResult> results = phaser.phaseBlocks(block_pointers, genotype_slices);
+
+		// haplotypes are strings with one allele (or 'n') per variant
+		for (size_t b = 0; b < results.size(); ++b) {
+			for (size_t h = 0; h < ploidy; ++h) {
+				const string& haplotype = results[b].haplotypes[h];
+				for (size_t k = starts[b]; (k < starts[b+1]) && (k - starts[b] < haplotype.size()); ++k) {
+					char allele = haplotype[k - starts[b]];
+					if ((allele >= '0') && (allele <= '9')) {
+						haplotypes[h * variant_count + variants[k]] = allele - '0';
+					}
+				}
+			}
+			if (block_starts != nullptr) {
+				vector<Position> cuts = results[b].cutPositions;
+				cuts.push_back(starts[b+1] - starts[b]);
+				for (size_t j = 0; j + 1 < cuts.size(); ++j) {
+					for (size_t k = starts[b] + cuts[j]; k < starts[b] + cuts[j+1]; ++k) {
+						block_starts[variants[k]] = variants[starts[b] + cuts[j]];
+					}
+				}
+			}
+		}
+	});
+}
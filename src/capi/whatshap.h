@@ -0,0 +1,162 @@
+/** C API of libwhatshap, which runs the algorithms of the C++ core without Python.
+ *
+ *  Read sets are built from flat arrays and the results are written into buffers provided by
+ *  the caller. All functions return WHATSHAP_OK on success and another whatshap_status_t
+ *  otherwise, in which case whatshap_last_error() describes the problem and the output buffers
+ *  may have been partially written.
+ *
+ *  Variants are identified by their positions. Every phasing and genotyping function takes
+ *  a sorted list of distinct positions and writes one result per position and haplotype (or
+ *  individual). Variants of reads at other positions are ignored. Positions that are not
+ *  covered by any read are reported as unphased (allele -1).
+ *
+ *  Alleles are 0 (reference), 1, 2, ...; only whatshap_polyphase() supports alleles other than
+ *  0 and 1. Functions may be called from several threads at the same time, and read sets and
+ *  pedigrees may be shared by such calls as long as they are not modified meanwhile.
+ */
+#ifndef WHATSHAP_C_API_H
+#define WHATSHAP_C_API_H
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#define WHATSHAP_API __declspec(dllexport)
+#else
+#define WHATSHAP_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Version of this API. It is increased whenever a function is added; existing functions keep
+ *  their signatures and behavior. */
+#define WHATSHAP_API_VERSION 1
+
+typedef enum {
+	WHATSHAP_OK = 0,
+	/** An argument is out of range or inconsistent with the others. */
+	WHATSHAP_ERROR_INVALID_ARGUMENT = 1,
+	WHATSHAP_ERROR_OUT_OF_MEMORY = 2,
+	/** The algorithm failed, e.g. because the coverage exceeds what HapChat supports. */
+	WHATSHAP_ERROR_FAILED = 3
+} whatshap_status_t;
+
+/** Determines which DP columns are kept in memory, see checkpointpolicy.h. */
+typedef enum {
+	WHATSHAP_CHECKPOINT_AUTO = 0,
+	WHATSHAP_CHECKPOINT_ALL = 1,
+	WHATSHAP_CHECKPOINT_SQRT = 2,
+	WHATSHAP_CHECKPOINT_LOG = 3
+} whatshap_checkpoint_policy_t;
+
+typedef struct whatshap_readset whatshap_readset_t;
+typedef struct whatshap_pedigree whatshap_pedigree_t;
+
+/** Returns WHATSHAP_API_VERSION of the library, which may be newer than the header. */
+WHATSHAP_API int whatshap_api_version(void);
+
+/** Returns a description of the last error in the calling thread (empty if there was none).
+ *  The string remains valid until the next call of an API function in the same thread. */
+WHATSHAP_API const char* whatshap_last_error(void);
+
+/** Creates a read set. Read i consists of the variants variant_offsets[i], ...,
+ *  variant_offsets[i+1]-1, given by their positions, alleles and phred scaled qualities.
+ *  Variants of a read may be given in any order, but each read needs at least one.
+ *
+ *  @param sample_ids Sample (individual) of every read, or NULL if all reads belong to sample 0.
+ *  @param mapqs Mapping quality of every read, or NULL.
+ *  @param readset Receives the read set, which must be freed with whatshap_readset_free().
+ */
+WHATSHAP_API whatshap_status_t whatshap_readset_create(size_t read_count, const size_t* variant_offsets,
+	const unsigned int* positions, const int* alleles, const unsigned int* qualities,
+	const unsigned int* sample_ids, const int* mapqs, whatshap_readset_t** readset);
+
+WHATSHAP_API void whatshap_readset_free(whatshap_readset_t* readset);
+
+/** Returns the number of reads. */
+WHATSHAP_API size_t whatshap_readset_size(const whatshap_readset_t* readset);
+
+/** Creates an empty pedigree for variant_count variants, which must be freed with
+ *  whatshap_pedigree_free(). */
+WHATSHAP_API whatshap_status_t whatshap_pedigree_create(size_t variant_count, whatshap_pedigree_t** pedigree);
+
+WHATSHAP_API void whatshap_pedigree_free(whatshap_pedigree_t* pedigree);
+
+/** Adds an individual (whose reads have the given sample id) to the pedigree. Individuals are
+ *  indexed in the order in which they are added.
+ *
+ *  @param genotypes Two alleles per variant (in any order), -1 if the genotype is unknown.
+ *                   NULL if all genotypes are unknown (for genotyping).
+ *  @param genotype_likelihoods Probabilities of the genotypes 0/0, 0/1 and 1/1 for each variant,
+ *                   or NULL. Used as priors by whatshap_genotype() and as costs of changing the
+ *                   genotypes by whatshap_phase() with distrust_genotypes.
+ */
+WHATSHAP_API whatshap_status_t whatshap_pedigree_add_individual(whatshap_pedigree_t* pedigree, unsigned int sample_id,
+	const int* genotypes, const double* genotype_likelihoods);
+
+/** Adds a trio of individuals that have been added before. */
+WHATSHAP_API whatshap_status_t whatshap_pedigree_add_trio(whatshap_pedigree_t* pedigree, unsigned int father_sample_id,
+	unsigned int mother_sample_id, unsigned int child_sample_id);
+
+/** Returns the number of individuals. */
+WHATSHAP_API size_t whatshap_pedigree_size(const whatshap_pedigree_t* pedigree);
+
+/** Phases the individuals of a pedigree by solving the (weighted) minimum error correction
+ *  problem with PedigreeDPTable, as "whatshap phase" does.
+ *
+ *  @param positions The variant_count positions of the pedigree, sorted.
+ *  @param recombination_costs Phred scaled cost of a recombination between a variant and the
+ *                   previous one, for each variant.
+ *  @param haplotypes Receives 2 * variant_count alleles per individual: haplotypes[(2*i + h) * variant_count + v]
+ *                   is the allele of haplotype h of individual i at variant v, -1 if unphased.
+ *  @param transmission_values Receives the transmission value of every variant (or NULL).
+ *  @param read_partition Receives the haplotype (0 or 1) assigned to every read, in the order in
+ *                   which they were given to whatshap_readset_create(), -1 for reads without
+ *                   variants at the given positions (or NULL).
+ *  @param cost Receives the optimal cost (or NULL).
+ */
+WHATSHAP_API whatshap_status_t whatshap_phase(const whatshap_readset_t* readset, const whatshap_pedigree_t* pedigree,
+	const unsigned int* positions, const unsigned int* recombination_costs, int distrust_genotypes,
+	unsigned int threads, whatshap_checkpoint_policy_t checkpoint_policy, size_t memory_limit,
+	int* haplotypes, unsigned int* transmission_values, int* read_partition, unsigned int* cost);
+
+/** Computes genotype likelihoods of all individuals of a pedigree with GenotypeDPTable, as
+ *  "whatshap genotype" does. Positions and recombination costs are as for whatshap_phase().
+ *
+ *  @param double_precision If nonzero, compute in double instead of long double (faster).
+ *  @param concurrent If nonzero, run the forward and the backward pass on two threads.
+ *  @param likelihoods Receives 3 * variant_count values per individual: likelihoods[(i * variant_count + v) * 3 + g]
+ *                   is the probability of genotype g (0/0, 0/1, 1/1) of individual i at variant v.
+ *                   Variants not covered by any read get the prior likelihoods (uniform if none).
+ */
+WHATSHAP_API whatshap_status_t whatshap_genotype(const whatshap_readset_t* readset, const whatshap_pedigree_t* pedigree,
+	const unsigned int* positions, const unsigned int* recombination_costs, int double_precision, int concurrent,
+	whatshap_checkpoint_policy_t checkpoint_policy, size_t memory_limit, double* likelihoods);
+
+/** Phases a single individual with HapChat, as "whatshap phase --algorithm hapchat" does.
+ *
+ *  @param haplotypes Receives 2 * variant_count alleles: haplotypes[h * variant_count + v], -1 if unphased.
+ *  @param cost Receives the optimal cost (or NULL).
+ */
+WHATSHAP_API whatshap_status_t whatshap_phase_hapchat(const whatshap_readset_t* readset, size_t variant_count,
+	const unsigned int* positions, int* haplotypes, unsigned int* cost);
+
+/** Phases a polyploid individual (read scoring, cluster editing and threading), as
+ *  "whatshap polyphase" does. The parameters correspond to its options.
+ *
+ *  @param genotypes ploidy alleles per variant.
+ *  @param haplotypes Receives ploidy * variant_count alleles: haplotypes[h * variant_count + v], -1 if unphased.
+ *  @param block_starts Receives, for every variant, the index of the first variant of its phasing
+ *                   block, -1 if unphased (or NULL).
+ */
+WHATSHAP_API whatshap_status_t whatshap_polyphase(const whatshap_readset_t* readset, size_t variant_count,
+	const unsigned int* positions, unsigned int ploidy, const unsigned int* genotypes, unsigned int min_overlap,
+	int bundle_edges, unsigned int refinements, unsigned int block_cut_sensitivity, unsigned int threads,
+	int* haplotypes, int* block_starts);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
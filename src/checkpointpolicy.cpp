@@ -0,0 +1,44 @@
+#include <cmath>
+#include <algorithm>
+
+#include "checkpointpolicy.h"
+
+using namespace std;
+
+checkpoint_policy_t choose_checkpoint_policy(const vector<size_t>& column_memory, size_t memory_limit) {
+	size_t column_count = column_memory.size();
+	size_t k = (size_t)sqrt(column_count);
+	size_t all_memory = 0;
+	size_t sqrt_memory = 0;
+	size_t largest_column = 0;
+	for (size_t column_index=0; column_index<column_count; ++column_index) {
+		size_t memory = column_memory[column_index];
+		all_memory += memory;
+		largest_column = std::max(largest_column, memory);
+		if ((k <= 1) || (column_index % k == 0)) {
+			sqrt_memory += memory;
+		}
+	}
+	// when restoring columns, up to k columns between two checkpoints are recomputed at once
+	sqrt_memory += k * largest_column;
+	if (all_memory <= memory_limit) {
+		return CHECKPOINT_ALL;
+	}
+	if (sqrt_memory <= memory_limit) {
+		return CHECKPOINT_SQRT;
+	}
+	return CHECKPOINT_LOG;
+}
+
+
+void mark_checkpoints(long first, long last, vector<bool>* keep) {
+	// recursively bisect the remaining interval
+	long checkpoint = first;
+	while (last - checkpoint > 1) {
+		checkpoint += (last - checkpoint) / 2;
+		keep->at(checkpoint) = true;
+	}
+	if (last > first) {
+		keep->at(last) = true;
+	}
+}
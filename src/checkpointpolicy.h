@@ -0,0 +1,28 @@
+#ifndef CHECKPOINT_POLICY_H
+#define CHECKPOINT_POLICY_H
+
+#include <vector>
+#include <cstddef>
+
+/** Determines which DP columns are kept in memory while a DP table is computed in one direction.
+ *  Columns not kept are recomputed from the closest kept column when they are needed again
+ *  (during the backtrace of PedigreeDPTable or the forward pass of GenotypeDPTable).
+ *  - CHECKPOINT_ALL: keep all columns, no recomputation
+ *  - CHECKPOINT_SQRT: keep every sqrt(n)-th column, each column is recomputed at most once
+ *  - CHECKPOINT_LOG: keep O(log(n)) columns chosen by recursive bisection, at the cost of
+ *    recomputing each column O(log(n)) times
+ *  - CHECKPOINT_AUTO: use the least recomputation that fits within a given memory limit
+ */
+typedef enum { CHECKPOINT_AUTO = 0, CHECKPOINT_ALL = 1, CHECKPOINT_SQRT = 2, CHECKPOINT_LOG = 3 } checkpoint_policy_t;
+
+/** Picks a checkpoint policy (never CHECKPOINT_AUTO) given the number of bytes needed to store
+ *  each of the columns and the memory limit (in bytes). With CHECKPOINT_SQRT, the columns
+ *  whose index is a multiple of sqrt(n) are assumed to be kept. */
+checkpoint_policy_t choose_checkpoint_policy(const std::vector<size_t>& column_memory, size_t memory_limit);
+
+/** Marks the columns in (first, last] to be kept when computing them in order from first+1 to last,
+ *  given that column first has been kept (or first == -1), such that subsequently restoring
+ *  columns last, last-1, ... needs O(log(n)) recomputations each. */
+void mark_checkpoints(long first, long last, std::vector<bool>* keep);
+
+#endif
@@ -0,0 +1,32 @@
+#include "columnarena.h"
+
+using namespace std;
+
+namespace {
+	template <typename Matrix>
+	void add_stats(column_arena_stats_t* total) {
+		const column_arena_stats_t& stats = ColumnArena<Matrix>::instance().get_stats();
+		total->acquired += stats.acquired;
+		total->reused += stats.reused;
+		total->allocated += stats.allocated;
+		total->retained_bytes += stats.retained_bytes;
+	}
+}
+
+
+column_arena_stats_t get_column_arena_stats() {
+	column_arena_stats_t total;
+	add_stats<Vector2D<unsigned int> >(&total);
+	add_stats<Vector2D<long double> >(&total);
+	add_stats<Vector2D<double> >(&total);
+	add_stats<PackedVector2D>(&total);
+	return total;
+}
+
+
+void clear_column_arenas() {
+	ColumnArena<Vector2D<unsigned int> >::instance().clear();
+	ColumnArena<Vector2D<long double> >::instance().clear();
+	ColumnArena<Vector2D<double> >::instance().clear();
+	ColumnArena<PackedVector2D>::instance().clear();
+}
@@ -0,0 +1,118 @@
+#ifndef COLUMN_ARENA_H
+#define COLUMN_ARENA_H
+
+#include <vector>
+#include <memory>
+#include <utility>
+
+#include "vector2d.h"
+#include "packedvector2d.h"
+
+/** Statistics on the use of column arenas. */
+typedef struct column_arena_stats_t {
+	// number of columns handed out
+	size_t acquired;
+	// number of columns handed out that reused a pooled buffer without reallocation
+	size_t reused;
+	// number of columns handed out that required memory to be allocated
+	size_t allocated;
+	// number of bytes currently kept in the pools
+	size_t retained_bytes;
+	column_arena_stats_t() : acquired(0), reused(0), allocated(0), retained_bytes(0) {};
+} column_arena_stats_t;
+
+
+/** Pool of DP columns (Vector2D or PackedVector2D) that have been released by a DP table
+ *  and can be handed out again without going back to the global allocator. This makes
+ *  recomputation during the backtrace and DP tables built one after another (e.g. for
+ *  subsequent chromosomes) reuse the same buffers.
+ *
+ *  There is one arena per thread and column type, obtained through instance(). Matrix
+ *  must provide reset(...) (with the same arguments as the constructor) and capacity().
+ */
+template <typename Matrix>
+class ColumnArena {
+public:
+	/** Maximum number of columns and bytes kept in the pool; columns released beyond that are freed. */
+	static const size_t MAX_POOLED_COLUMNS = 64;
+	static const size_t MAX_POOLED_BYTES = ((size_t)1) << 27;
+
+	static ColumnArena& instance() {
+		static thread_local ColumnArena arena;
+		return arena;
+	}
+
+	/** Returns a column constructed with the given arguments. Ownership is transferred to the
+	 *  caller, who should give it back using release(). */
+	template <typename... Args>
+	Matrix* acquire(Args&&... args) {
+		stats.acquired += 1;
+		if (pool.empty()) {
+			stats.allocated += 1;
+			return new Matrix(std::forward<Args>(args)...);
+		}
+		// most recently released column first, as it is likely to have the right size
+		Matrix* m = pool.back().release();
+		pool.pop_back();
+		size_t capacity = m->capacity();
+		stats.retained_bytes -= capacity;
+		m->reset(std::forward<Args>(args)...);
+		if (m->capacity() == capacity) {
+			stats.reused += 1;
+		} else {
+			stats.allocated += 1;
+		}
+		return m;
+	}
+
+	/** Returns the given column (which may be null) to the pool. */
+	void release(Matrix* m) {
+		if (m == nullptr) return;
+		if ((pool.size() >= MAX_POOLED_COLUMNS) || (stats.retained_bytes + m->capacity() > MAX_POOLED_BYTES)) {
+			delete m;
+			return;
+		}
+		stats.retained_bytes += m->capacity();
+		pool.emplace_back(m);
+	}
+
+	/** Frees all pooled columns. */
+	void clear() {
+		pool.clear();
+		stats.retained_bytes = 0;
+	}
+
+	const column_arena_stats_t& get_stats() const {
+		return stats;
+	}
+
+private:
+	ColumnArena() {}
+	ColumnArena(const ColumnArena&) = delete;
+	ColumnArena& operator=(const ColumnArena&) = delete;
+
+	std::vector<std::unique_ptr<Matrix> > pool;
+	column_arena_stats_t stats;
+};
+
+
+/** Deleter for std::unique_ptr that returns columns to the arena of the calling thread. */
+template <typename Matrix>
+struct column_arena_deleter {
+	void operator()(Matrix* m) const {
+		ColumnArena<Matrix>::instance().release(m);
+	}
+};
+
+template <typename Matrix>
+using arena_column_ptr = std::unique_ptr<Matrix, column_arena_deleter<Matrix> >;
+
+
+/** Returns the statistics summed over the arenas of all column types used by the DP tables
+ *  in the calling thread. */
+column_arena_stats_t get_column_arena_stats();
+
+/** Frees all pooled columns of the calling thread. */
+void clear_column_arenas();
+
+#endif
@@ -1,49 +1,123 @@
 #ifndef COLUMN_INDEXING_ITERATOR_H
 #define COLUMN_INDEXING_ITERATOR_H
 
-#include "graycodes.h"
+#include <cassert>
+#include <cstdint>
 
-class ColumnIndexingScheme;
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+#include "columnindexingscheme.h"
 
+/** Iterates over the rows of a DP column in the order of the (binary reflected) Gray codes,
+ *  such that consecutive partitionings differ in exactly one bit. The k-th row has index
+ *  k^(k>>1), and the bit changed by moving to it is the lowest set bit of k (as in GrayCodes).
+ *  All methods are inlined, since both DP tables call them for every row of every column.
+ */
 class ColumnIndexingIterator {
 private:
-	const ColumnIndexingScheme* parent;
-	GrayCodes* graycodes;
+	uint64_t first_rank;
+	uint64_t end_rank;
+	uint64_t next_rank;
 	unsigned int index;
 	unsigned int forward_projection;
+	unsigned int backward_projection_mask;
+	unsigned int read_count;
+	// bits of the reads that are also in the next column, and for each read, the bit it flips
+	// in the forward projection (or 0), see ColumnIndexingScheme::set_next_column
+	unsigned int forward_projection_bits;
+	const unsigned int* forward_projection_flips;
 
 public:
-	ColumnIndexingIterator(const ColumnIndexingScheme* parent);
-	virtual ~ColumnIndexingIterator();
+	ColumnIndexingIterator(const ColumnIndexingScheme* parent) : ColumnIndexingIterator(parent, 0, parent->column_size()) {}
 
-	bool has_next();
+	/** Iterate only over the rows with Gray code ranks first_rank, ..., end_rank-1. */
+	ColumnIndexingIterator(const ColumnIndexingScheme* parent, unsigned int first_rank, unsigned int end_rank) :
+		first_rank(first_rank),
+		end_rank(end_rank),
+		next_rank(first_rank),
+		index(-1),
+		forward_projection(0),
+		backward_projection_mask((((unsigned int)1) << parent->backward_projection_width) - 1),
+		read_count(parent->read_ids.size()),
+		forward_projection_bits(parent->forward_projection_bits),
+		forward_projection_flips(parent->forward_projection_flips.empty() ? nullptr : parent->forward_projection_flips.data())
+	{
+		assert(parent != 0);
+		assert(first_rank <= end_rank);
+		assert(end_rank <= (((uint64_t)1) << read_count));
+	}
+
+	bool has_next() const {
+		return next_rank < end_rank;
+	}
 
 	/** Move to next index (i.e. DP table row).
 	  *
 	  *  @param bit_changed If not null, and only one bit in the
 	  *  partitioning (as retrieved by get_partition) is changed by this
 	  *  call to advance, then the index of this bit is written to the
-	  *  referenced variable; if not, -1 is written.
+	  *  referenced variable; if not (i.e. in the first iteration), -1 is written.
 	  */
-	void advance(int* bit_changed = 0);
+	void advance(int* bit_changed = 0) {
+		assert(has_next());
+		uint64_t k = next_rank++;
+		index = (unsigned int)(k ^ (k >> 1));
+		int changed = -1;
+		if (k == first_rank) {
+			forward_projection = index_forward_projection(index);
+		} else {
+			changed = __builtin_ctzll(k);
+			if (forward_projection_flips != nullptr) {
+				forward_projection ^= forward_projection_flips[changed];
+			}
+		}
+		if (bit_changed != 0) {
+			*bit_changed = changed;
+		}
+	}
 
 	/** Index of the projection of the current read set onto the intersection between current and next read set. */
-	unsigned int get_forward_projection();
+	unsigned int get_forward_projection() const {
+		return forward_projection;
+	}
 
 	/** Index of the projection of the current read set onto the intersection between previous and the current read set. */
-	unsigned int get_backward_projection();
+	unsigned int get_backward_projection() const {
+		return index & backward_projection_mask;
+	}
 
 	/** Row index in the DP table (within the current column). */
-	unsigned int get_index();
+	unsigned int get_index() const {
+		return index;
+	}
 
 	/** Bit-wise representation of the partitioning corresponding to the current index. */
-	unsigned int get_partition();
+	unsigned int get_partition() const {
+		return index;
+	}
 
 	/** get index's backward projection (given index i), so that we don't have to iterate up to it, just to get it */
-	unsigned int index_backward_projection(unsigned int i);
+	unsigned int index_backward_projection(unsigned int i) const {
+		assert(i < (((unsigned int)1) << read_count));
+		return i & backward_projection_mask;
+	}
 
-	/** get index's forward projection */
-	unsigned int index_forward_projection(unsigned int i);
+	/** get index's forward projection, i.e. the bits of i that belong to reads in the next column,
+	 *  packed together (a parallel bit extract) */
+	unsigned int index_forward_projection(unsigned int i) const {
+		assert(i < (((unsigned int)1) << read_count));
+#if defined(__BMI2__)
+		return _pext_u32(i, forward_projection_bits);
+#else
+		unsigned int result = 0;
+		for (unsigned int bits = i & forward_projection_bits; bits != 0; bits &= bits - 1) {
+			result |= forward_projection_flips[__builtin_ctz(bits)];
+		}
+		return result;
+#endif
+	}
 };
 
 #endif
@@ -14,6 +14,7 @@ ColumnIndexingScheme::ColumnIndexingScheme(const ColumnIndexingScheme* previous_
 		}
 	}
 	this->forward_projection_mask = 0;
+	this->forward_projection_bits = 0;
 	this->backward_projection_width = 0;
 	this->forward_projection_width = 0;
 	if (previous_column != 0) {
@@ -39,7 +40,7 @@ ColumnIndexingScheme::~ColumnIndexingScheme() {
 }
 
 
-unsigned int ColumnIndexingScheme::column_size() {
+unsigned int ColumnIndexingScheme::column_size() const {
 	return ((unsigned int)1) << read_ids.size();
 }
 
@@ -65,12 +66,16 @@ void ColumnIndexingScheme::set_next_column(const ColumnIndexingScheme* next_colu
 	if (forward_projection_mask != 0) delete forward_projection_mask;
 	forward_projection_width = 0;
 	forward_projection_mask = new vector<unsigned int>(read_ids.size(),-1);
+	forward_projection_bits = 0;
+	forward_projection_flips.assign(read_ids.size(), 0);
 	int i = 0;
 	int j = 0;
 	int n = 0;
 	while ((i<next_column->read_ids.size()) && (j<read_ids.size())) {
 		if (next_column->read_ids[i] == read_ids[j]) {
 			forward_projection_mask->at(j) = n;
+			forward_projection_bits |= ((unsigned int)1) << j;
+			forward_projection_flips[j] = ((unsigned int)1) << n;
 			n += 1;
 			i += 1;
 			j += 1;
@@ -90,6 +95,11 @@ unique_ptr<ColumnIndexingIterator> ColumnIndexingScheme::get_iterator() {
 }
 
 
+unique_ptr<ColumnIndexingIterator> ColumnIndexingScheme::get_iterator(unsigned int first_rank, unsigned int end_rank) {
+	return unique_ptr<ColumnIndexingIterator>(new ColumnIndexingIterator(this, first_rank, end_rank));
+}
+
+
 const vector<unsigned int> * ColumnIndexingScheme::get_read_ids() {
 	return &(this->read_ids);
 }
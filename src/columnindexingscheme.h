@@ -14,6 +14,10 @@ private:
 	unsigned int backward_projection_width;
 	unsigned int forward_projection_width;
 	std::vector<unsigned int>* forward_projection_mask;
+	// bit j is set if read j is also in the next column
+	unsigned int forward_projection_bits;
+	// for every read, the bit that it sets in the forward projection (or 0 if not in the next column)
+	std::vector<unsigned int> forward_projection_flips;
 
 public:
 
@@ -30,7 +34,11 @@ public:
 
 	std::unique_ptr<ColumnIndexingIterator> get_iterator();
 
-	unsigned int column_size();
+	/** Returns an iterator over the rows with Gray code ranks first_rank, ..., end_rank-1.
+	 *  Splitting [0, column_size()) into ranges allows to process a column in independent chunks. */
+	std::unique_ptr<ColumnIndexingIterator> get_iterator(unsigned int first_rank, unsigned int end_rank);
+
+	unsigned int column_size() const;
 
 	unsigned int forward_projection_size();
  
@@ -0,0 +1,88 @@
+#include <cassert>
+#include <stdexcept>
+#include <memory>
+
+#include "columnreadindex.h"
+
+using namespace std;
+
+namespace {
+	typedef struct active_read_t {
+		size_t read_index;
+		size_t active_entry;
+		active_read_t(size_t read_index) : read_index(read_index), active_entry(0) {}
+	} active_read_t;
+}
+
+
+const unsigned int ColumnReadIndex::NO_ENTRY;
+
+
+ColumnReadIndex::ColumnReadIndex(const ReadSet& set, const vector<unsigned int>* positions) : read_count(set.size()) {
+	if (positions == nullptr) {
+		unique_ptr<vector<unsigned int> > all_positions(set.get_positions());
+		this->positions = *all_positions;
+	} else {
+		this->positions = *positions;
+	}
+
+	int pos = 0;
+	for (size_t i=0; i<set.size(); ++i) {
+		const Read* read = set.get(i);
+		if (read->firstPosition() < pos) {
+			throw std::runtime_error("ColumnIterator: reads in ReadSet are not sorted.");
+		}
+		if (!read->isSorted()) {
+			throw std::runtime_error("ColumnIterator: encountered read with unsorted variants.");
+		}
+		pos = read->firstPosition();
+	}
+
+	// sweep over all columns, keeping track of active reads (in the order of the ReadSet)
+	vector<active_read_t> active_reads;
+	size_t next_read_index = 0;
+	offsets.reserve(this->positions.size() + 1);
+	offsets.push_back(0);
+	for (size_t k=0; k<this->positions.size(); ++k) {
+		int next_pos = this->positions[k];
+		// check which of the current reads remain active
+		size_t kept = 0;
+		for (size_t j=0; j<active_reads.size(); ++j) {
+			active_read_t& active_read = active_reads[j];
+			const Read* read = set.get(active_read.read_index);
+			if (read->lastPosition() < next_pos) {
+				continue;
+			}
+			while (read->getPosition(active_read.active_entry) < next_pos) {
+				active_read.active_entry += 1;
+				assert(active_read.active_entry < (size_t)read->getVariantCount());
+			}
+			active_reads[kept++] = active_read;
+		}
+		active_reads.resize(kept, active_read_t(0));
+
+		// check which new reads become active
+		while (next_read_index < set.size()) {
+			int read_start = set.get(next_read_index)->firstPosition();
+			if (read_start == next_pos) {
+				active_reads.push_back(active_read_t(next_read_index));
+				next_read_index += 1;
+			} else {
+				assert(read_start > next_pos);
+				break;
+			}
+		}
+
+		// record active reads and whether they cover the current position
+		for (const active_read_t& active_read : active_reads) {
+			const Read* read = set.get(active_read.read_index);
+			read_indices.push_back(active_read.read_index);
+			if (read->getPosition(active_read.active_entry) == next_pos) {
+				entry_indices.push_back(active_read.active_entry);
+			} else {
+				entry_indices.push_back(NO_ENTRY);
+			}
+		}
+		offsets.push_back(read_indices.size());
+	}
+}
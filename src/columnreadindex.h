@@ -0,0 +1,70 @@
+#ifndef COLUMN_READ_INDEX_H
+#define COLUMN_READ_INDEX_H
+
+#include <vector>
+#include <limits>
+#include <cassert>
+
+#include "readset.h"
+
+/** Random-access index from columns to the reads active in them, computed once for a ReadSet.
+ *  For each column k, it stores the reads active in column k (i.e. first position <= positions[k]
+ *  <= last position) in the order in which they appear in the ReadSet, together with the index
+ *  of the read's entry at positions[k], or NO_ENTRY if the read spans, but does not cover
+ *  positions[k]. Slots of all columns are stored back to back (CSR layout), such that the
+ *  active reads of any column can be obtained in O(number of active reads).
+ *
+ *  Only read and entry indices are stored, such that the index stays valid when read ids are
+ *  reassigned, as long as the ReadSet is not otherwise modified.
+ */
+class ColumnReadIndex {
+public:
+	static const unsigned int NO_ENTRY = std::numeric_limits<unsigned int>::max();
+
+	/** Constructor.
+	 *  @param positions Positions to work on. If 0, then all positions given in set will be used.
+	 *                   Caller retains ownership.
+	 */
+	ColumnReadIndex(const ReadSet& set, const std::vector<unsigned int>* positions = nullptr);
+
+	unsigned int get_column_count() const {
+		return positions.size();
+	}
+
+	unsigned int get_read_count() const {
+		return read_count;
+	}
+
+	const std::vector<unsigned int>* get_positions() const {
+		return &positions;
+	}
+
+	/** Returns the number of reads active in column k. */
+	size_t column_size(size_t k) const {
+		assert(k < positions.size());
+		return offsets[k+1] - offsets[k];
+	}
+
+	/** Returns the index (in the ReadSet) of the i-th read active in column k. */
+	unsigned int get_read_index(size_t k, size_t i) const {
+		assert(i < column_size(k));
+		return read_indices[offsets[k] + i];
+	}
+
+	/** Returns the index of the entry of the i-th read active in column k at
+	 *  positions[k], or NO_ENTRY if the read has no such entry. */
+	unsigned int get_entry_index(size_t k, size_t i) const {
+		assert(i < column_size(k));
+		return entry_indices[offsets[k] + i];
+	}
+
+private:
+	unsigned int read_count;
+	std::vector<unsigned int> positions;
+	// slots of column k have indices offsets[k], ..., offsets[k+1]-1
+	std::vector<size_t> offsets;
+	std::vector<unsigned int> read_indices;
+	std::vector<unsigned int> entry_indices;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <cassert>
+
+#include "editdistance.h"
+
+using namespace std;
+
+EditDistance::EditDistance() : peq(256, 0) {
+}
+
+
+int EditDistance::compute(const char* s, size_t m, const char* t, size_t n, int maxdiff) {
+	// Return early if string lengths are too different
+	long length_difference = (m > n) ? (m - n) : (n - m);
+	if ((maxdiff != -1) && (length_difference > maxdiff)) {
+		return length_difference;
+	}
+
+	// Skip identical prefixes and suffixes
+	while (m > 0 && n > 0 && s[0] == t[0]) {
+		s += 1;
+		t += 1;
+		m -= 1;
+		n -= 1;
+	}
+	while (m > 0 && n > 0 && s[m-1] == t[n-1]) {
+		m -= 1;
+		n -= 1;
+	}
+
+	// The shorter string is the pattern whose characters correspond to the bits of a column.
+	if (m > n) {
+		swap(s, t);
+		swap(m, n);
+	}
+	if (m == 0) {
+		return n;
+	}
+	size_t blocks = (m + 63) / 64;
+	if (peq.size() < 256 * blocks) {
+		peq.resize(256 * blocks, 0);
+	}
+	for (size_t i = 0; i < m; ++i) {
+		peq[(unsigned char)s[i] * blocks + i / 64] |= uint64_t(1) << (i % 64);
+	}
+	// Column 0 is 0, 1, ..., m
+	pv.assign(blocks, ~uint64_t(0));
+	mv.assign(blocks, 0);
+	// Bits above the pattern length in the last word do not influence lower bits.
+	const uint64_t last_bit = uint64_t(1) << ((m - 1) % 64);
+	long score = m;
+	for (size_t j = 0; j < n; ++j) {
+		const uint64_t* eqs = &peq[(unsigned char)t[j] * blocks];
+		// horizontal delta entering the current word from above; the first row is 0, 1, ..., n
+		int hin = 1;
+		for (size_t b = 0; b < blocks; ++b) {
+			uint64_t vp = pv[b];
+			uint64_t vm = mv[b];
+			uint64_t eq = eqs[b];
+			uint64_t hin_negative = (hin < 0) ? 1 : 0;
+			uint64_t hin_positive = (hin > 0) ? 1 : 0;
+			uint64_t xv = eq | vm;
+			eq |= hin_negative;
+			uint64_t xh = (((eq & vp) + vp) ^ vp) | eq;
+			uint64_t hp = vm | ~(xh | vp);
+			uint64_t hm = vp & xh;
+			if (b + 1 < blocks) {
+				hin = (int)(hp >> 63) - (int)(hm >> 63);
+			} else {
+				score += ((hp & last_bit) != 0) - ((hm & last_bit) != 0);
+			}
+			hp = (hp << 1) | hin_positive;
+			hm = (hm << 1) | hin_negative;
+			pv[b] = hm | ~(xv | hp);
+			mv[b] = hp & xv;
+		}
+		// Each of the remaining columns decreases the distance by at most one.
+		if ((maxdiff != -1) && (score - (long)(n - 1 - j) > maxdiff)) {
+			score -= n - 1 - j;
+			break;
+		}
+	}
+	for (size_t i = 0; i < m; ++i) {
+		peq[(unsigned char)s[i] * blocks + i / 64] = 0;
+	}
+	return score;
+}
@@ -0,0 +1,35 @@
+#ifndef EDIT_DISTANCE_H
+#define EDIT_DISTANCE_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/** Computes unit cost edit distances (the number of insertions, deletions and mismatches
+ *  needed to transform one string into the other) using the bit-parallel algorithm by Myers
+ *  (1999) in the formulation by Hyyrö (2003), which processes 64 cells of a DP column at once
+ *  and uses several words for strings longer than 64 characters.
+ *  Buffers are reused across calls, so a single object must not be used from several
+ *  threads at the same time.
+ */
+class EditDistance {
+public:
+	EditDistance();
+
+	/** Returns the edit distance between s and t.
+	 *  If maxdiff is not -1, the true edit distance is returned if and only if it is maxdiff or
+	 *  less. Otherwise, a value is returned that is guaranteed to be greater than maxdiff, but
+	 *  which is not necessarily the true edit distance.
+	 */
+	int compute(const char* s, size_t m, const char* t, size_t n, int maxdiff = -1);
+
+private:
+	// for each character c, bit i of word peq[c * blocks + b] is set if the character at position 64*b + i is c;
+	// all words are zero between calls
+	std::vector<uint64_t> peq;
+	// vertical deltas (+1, -1) of the current column
+	std::vector<uint64_t> pv;
+	std::vector<uint64_t> mv;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+#include "geneticmap.h"
+
+using namespace std;
+
+constexpr double GeneticMap::MINIMUM_DISTANCE;
+
+GeneticMap::GeneticMap(const vector<unsigned int>& positions, const vector<double>& cumulative_distances) :
+	positions(positions),
+	cumulative_distances(cumulative_distances)
+{
+	if (positions.empty()) {
+		throw invalid_argument("Genetic map must not be empty");
+	}
+	if (positions.size() != cumulative_distances.size()) {
+		throw invalid_argument("Genetic map needs one cumulative distance per position");
+	}
+	if (!is_sorted(positions.begin(), positions.end())) {
+		throw invalid_argument("Positions of the genetic map must be sorted");
+	}
+}
+
+
+size_t GeneticMap::size() const {
+	return positions.size();
+}
+
+
+double GeneticMap::get_cumulative_distance(unsigned int position) const {
+	// j: first entry at or after position, i: last entry at or before position
+	size_t j = lower_bound(positions.begin(), positions.end(), position) - positions.begin();
+	size_t i = upper_bound(positions.begin(), positions.end(), position) - positions.begin();
+	if (j == positions.size()) {
+		// beyond the map: extrapolate using the average recombination rate
+		double average_rate = cumulative_distances.back() / positions.back();
+		return cumulative_distances.back() + (double)(position - positions.back()) * average_rate;
+	}
+	if (i == 0) {
+		// before the map: interpolate between (0, 0) and the first entry
+		return (double)position * cumulative_distances[j] / (double)positions[j];
+	}
+	i -= 1;
+	if (positions[i] == positions[j]) {
+		return cumulative_distances[i];
+	}
+	// interpolation in the same order of operations as in whatshap.pedigree
+	return cumulative_distances[i] + ((double)(position - positions[i]) * (cumulative_distances[j] - cumulative_distances[i]) / (double)(positions[j] - positions[i]));
+}
+
+
+vector<unsigned int> GeneticMap::compute_recombination_costs(const vector<unsigned int>& positions) const {
+	vector<unsigned int> result;
+	result.reserve(positions.size());
+	double previous_distance = 0.0;
+	for (size_t k = 0; k < positions.size(); ++k) {
+		double distance = get_cumulative_distance(positions[k]);
+		if (k == 0) {
+			result.push_back(0);
+		} else {
+			double d = max(distance - previous_distance, MINIMUM_DISTANCE);
+			// rounds half to even, as round() in Python
+			result.push_back((unsigned int)nearbyint(centimorgan_to_phred(d)));
+		}
+		previous_distance = distance;
+	}
+	return result;
+}
+
+
+double GeneticMap::centimorgan_to_phred(double distance) {
+	assert(distance > 0);
+	if (distance < MINIMUM_DISTANCE) {
+		return -10 * (log10(distance) - 2);
+	}
+	double p = (1.0 - exp(-(2.0 * distance) / 100)) / 2.0;
+	return -10 * log10(p);
+}
@@ -0,0 +1,37 @@
+#ifndef GENETIC_MAP_H
+#define GENETIC_MAP_H
+
+#include <vector>
+
+/** Genetic map of one chromosome: cumulative genetic distances (in cM) at a sorted list of
+ *  positions. Distances at other positions are interpolated linearly (or, beyond the last
+ *  position, extrapolated using the average recombination rate of the chromosome).
+ */
+class GeneticMap {
+public:
+	/** Constructor. Positions must be sorted; throws std::invalid_argument otherwise, if the
+	 *  map is empty or if both vectors have different lengths. */
+	GeneticMap(const std::vector<unsigned int>& positions, const std::vector<double>& cumulative_distances);
+
+	size_t size() const;
+
+	/** Returns the cumulative genetic distance from the start of the chromosome to position. */
+	double get_cumulative_distance(unsigned int position) const;
+
+	/** Returns the recombination costs (phred-scaled recombination probabilities) between
+	 *  consecutive positions: result[i] is the cost between positions[i-1] and positions[i]
+	 *  (result[0] = 0). Distances below MINIMUM_DISTANCE are taken to be MINIMUM_DISTANCE.
+	 */
+	std::vector<unsigned int> compute_recombination_costs(const std::vector<unsigned int>& positions) const;
+
+	/** Converts a genetic distance (in cM, must be positive) to a phred-scaled recombination probability. */
+	static double centimorgan_to_phred(double distance);
+
+	static constexpr double MINIMUM_DISTANCE = 1e-10;
+
+private:
+	std::vector<unsigned int> positions;
+	std::vector<double> cumulative_distances;
+};
+
+#endif
@@ -9,16 +9,23 @@
 #include <utility>
 #include <array>
 #include "entry.h"
+#include "packedcolumns.h"
 #include "pedigree.h"
 #include "pedigreepartitions.h"
 #include "columnindexingiterator.h"
+#include "phredprobabilities.h"
 
 
+/** Computes the local costs (read likelihoods) of one column of the genotyping DP for all
+ *  allele assignments of a given transmission value. Float is the numeric type used by the
+ *  DP table (see GenotypeDPTable).
+ */
+template <typename Float = long double>
 class GenotypeColumnCostComputer
 {
 private:
   // the corresponding matrix column of reads
-  const std::vector<const Entry*>& column;
+  PackedColumn column;
   // the corresponding column index
   size_t column_index;
   const std::vector<unsigned int>& read_marks;
@@ -27,18 +34,20 @@ private:
   // corresponding pedigree
   const Pedigree* pedigree;
   // stores the current costs of the partitions (for both alleles 0 and 1) = Z_j
-  std::vector<std::array<long double, 2>> cost_partition;
+  std::vector<std::array<Float, 2>> cost_partition;
   // the pedigree partitions
   const PedigreePartitions& pedigree_partitions;
+  // probabilities of the phred scores of the entries
+  const PhredProbabilities<Float>& phred_probabilities;
 
 public:
-  GenotypeColumnCostComputer(const std::vector<const Entry*>& column, size_t column_index, const std::vector<unsigned int>& read_marks, const Pedigree* pedigree, const PedigreePartitions& pedigree_partitions);
+  GenotypeColumnCostComputer(const PackedColumn& column, size_t column_index, const std::vector<unsigned int>& read_marks, const Pedigree* pedigree, const PedigreePartitions& pedigree_partitions);
   // set partitioning to the given one
   void set_partitioning(unsigned int p);
   // update the partitioning by flipping read corresponding to the given bit
   void update_partitioning(int bit_to_flip);
   // returns the local cost for a given allele assignment prod_j Z_j
-  long double get_cost(unsigned int allele_assignment);
+  Float get_cost(unsigned int allele_assignment);
 
 };
 
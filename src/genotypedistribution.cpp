@@ -59,6 +59,16 @@ double GenotypeDistribution::errorProbability() const {
 }
 
 
+void GenotypeDistribution::multiply(const array<double, 3>& factors) {
+	double sum = 0.0;
+	for (int i=0; i<3; ++i) {
+		distribution[i] *= factors[i];
+		sum += distribution[i];
+	}
+	for (int i=0; i<3; ++i) distribution[i] /= sum;
+}
+
+
 GenotypeDistribution operator*(const GenotypeDistribution& d1, const GenotypeDistribution& d2) {
 	vector<double> d(d1.distribution);
 	double sum = 0.0;
@@ -1,6 +1,7 @@
 #ifndef GENOTYPEDISTRIBUTION_H
 #define GENOTYPEDISTRIBUTION_H
 
+#include <array>
 #include <vector>
 
 #include "phredgenotypelikelihoods.h"
@@ -18,6 +19,10 @@ public:
 		return distribution[genotype];
 	}
 
+	/** Multiplies the probability of each genotype by the given factor and normalizes the
+	 *  result, like operator* does, but without creating new distributions. */
+	void multiply(const std::array<double, 3>& factors);
+
 	/** Normalize distribution such that it sums to one. */
 	void normalize();
 
@@ -6,33 +6,62 @@
 #include <algorithm>
 #include <cmath>
 #include <vector>
+#include <thread>
+#include <exception>
+#include <functional>
 
 #include "genotypecolumncostcomputer.h"
 #include "genotypedptable.h"
 #include "columnindexingiterator.h"
 #include "transitionprobabilitycomputer.h"
+#include "instrumentation.h"
 
 using namespace std;
 
-GenotypeDPTable::GenotypeDPTable(ReadSet* read_set, const vector<unsigned int>& recombcost, const Pedigree* pedigree, const vector<unsigned int>* positions)
+namespace {
+
+// runs left on the calling thread and right on a second thread, and waits for both to finish
+void run_on_two_threads(const function<void()>& left, const function<void()>& right)
+{
+    exception_ptr error;
+    thread worker([&] () {
+        try {
+            right();
+        } catch (...) {
+            error = current_exception();
+        }
+    });
+    try {
+        left();
+    } catch (...) {
+        worker.join();
+        throw;
+    }
+    worker.join();
+    if (error) {
+        rethrow_exception(error);
+    }
+}
+
+}
+
+template <typename Float>
+GenotypeDPTable<Float>::GenotypeDPTable(ReadSet* read_set, const vector<unsigned int>& recombcost, const Pedigree* pedigree, const vector<unsigned int>* positions, checkpoint_policy_t checkpoint_policy, size_t memory_limit, bool concurrent)
     :read_set(read_set),
      recombcost(recombcost),
      pedigree(pedigree),
-     input_column_iterator(*read_set, positions),
-     backward_input_column_iterator(*read_set, positions),
-     transition_probability_table(input_column_iterator.get_column_count(),nullptr),
-     scaling_parameters(input_column_iterator.get_column_count(),-1.0L)
+     checkpoint_policy(checkpoint_policy),
+     memory_limit(memory_limit),
+     concurrent(concurrent),
+     topology(get_pedigree_topology(*pedigree)),
+     pedigree_partitions(topology->get_partitions())
 {
-   genotype_likelihood_table = Vector2D<genotype_likelihood_t>(pedigree->size(),input_column_iterator.get_column_count(),genotype_likelihood_t());
    read_set->reassignReadIds();
-
-   assert(input_column_iterator.get_column_count() == backward_input_column_iterator.get_column_count());
-
-   // create all pedigree partitions
-   for(size_t i = 0; i < pow(4,pedigree->triple_count()); ++i)
-   {
-       pedigree_partitions.push_back(new PedigreePartitions(*pedigree,i));
-   }
+   input_columns.reset(new PackedColumns(*read_set, positions));
+   size_t column_count = input_columns->get_column_count();
+   transition_probability_table.assign(column_count, nullptr);
+   scaling_parameters.assign(column_count, -1.0);
+   genotype_likelihood_table = Vector2D<genotype_likelihood_t>(pedigree->size(),column_count,genotype_likelihood_t());
 
    // translate all individual ids to individual indices
    for(size_t i = 0; i<read_set->size(); ++i)
@@ -42,161 +71,334 @@ GenotypeDPTable::GenotypeDPTable(ReadSet* read_set, const vector<unsigned int>&
 
    //compute forward and backward probabilities
    compute_index();
-   compute_backward_prob();
-   compute_forward_prob();
-
+   if (this->checkpoint_policy == CHECKPOINT_AUTO) {
+       vector<size_t> memory(column_count);
+       for (size_t column_index = 0; column_index < column_count; ++column_index) {
+           memory[column_index] = column_memory(column_index);
+       }
+       this->checkpoint_policy = choose_checkpoint_policy(memory, memory_limit);
+   }
+   if (concurrent && (column_count >= 2)) {
+       compute_concurrently();
+   } else {
+       compute_backward_prob();
+       compute_forward_prob();
+   }
 }
 
-GenotypeDPTable::~GenotypeDPTable()
+template <typename Float>
+GenotypeDPTable<Float>::~GenotypeDPTable()
 {
-    init(forward_projection_column_table,0);
-    init(backward_projection_column_table, 0);
+    release(forward_projection_column_table,0);
+    release(backward_projection_column_table, 0);
     init(indexers,0);
-    init(pedigree_partitions,0);
     init(transition_probability_table,0);
 }
 
-void GenotypeDPTable::clear_forward_table()
+template <typename Float>
+void GenotypeDPTable<Float>::clear_forward_table()
 {
-    size_t column_count = input_column_iterator.get_column_count();
-    init(forward_projection_column_table, 1);
+    release(forward_projection_column_table, 1);
 }
 
-void GenotypeDPTable::clear_backward_table()
+template <typename Float>
+void GenotypeDPTable<Float>::clear_backward_table()
 {
-    size_t column_count = input_column_iterator.get_column_count();
-    init(backward_projection_column_table, column_count);
-}
-
-unique_ptr<vector<unsigned int> > GenotypeDPTable::extract_read_ids(const vector<const Entry *>& entries) {
-    unique_ptr<vector<unsigned int> > read_ids(new vector<unsigned int>());
-    for (size_t i=0; i<entries.size(); ++i) {
-        read_ids->push_back(entries[i]->get_read_id());
-    }
-    return read_ids;
+    size_t column_count = input_columns->get_column_count();
+    release(backward_projection_column_table, column_count);
 }
 
-void GenotypeDPTable::compute_index(){
-    size_t column_count = input_column_iterator.get_column_count();
+template <typename Float>
+void GenotypeDPTable<Float>::compute_index(){
+    size_t column_count = input_columns->get_column_count();
     if(column_count == 0) return;
     init(indexers, column_count);
-    // do one forward pass to get the indexers (that are needed in forward and backward pass)
-    input_column_iterator.jump_to_column(0);
-    unique_ptr<vector<const Entry*> > current_input_column;
-    unique_ptr<vector<const Entry*> > next_input_column;
-    next_input_column = input_column_iterator.get_next();
-    unique_ptr<vector<unsigned int> > next_read_ids = extract_read_ids(*next_input_column);
-    ColumnIndexingScheme* next_indexer = new ColumnIndexingScheme(0, *next_read_ids);
-    indexers[0] = next_indexer;
-    unsigned int transmission_configurations = pow(4, pedigree->triple_count());
-    transition_probability_table[0] = new TransitionProbabilityComputer(0, recombcost[0], pedigree, pedigree_partitions);
-
-    for(size_t column_index=0; column_index < input_column_iterator.get_column_count(); ++column_index){
-        // make former next column the current one
-        current_input_column = std::move(next_input_column);
-        unique_ptr<vector<unsigned int> > current_read_ids = std::move(next_read_ids);
-        ColumnIndexingScheme* current_indexer = next_indexer;
-
-        if (input_column_iterator.has_next()){
-            next_input_column = input_column_iterator.get_next();
-            next_read_ids = extract_read_ids(*next_input_column);
-            next_indexer = new ColumnIndexingScheme(current_indexer,*next_read_ids);
-
-            current_indexer->set_next_column(next_indexer);
-            indexers[column_index+1] = next_indexer;
-            transition_probability_table[column_index+1] = new TransitionProbabilityComputer(column_index+1, recombcost[column_index+1], pedigree, pedigree_partitions);
-        } else {
-            assert(next_input_column.get() == 0);
-            assert(next_read_ids.get() == 0);
-            next_indexer = 0;
+    // create the indexers (that are needed in forward and backward pass)
+    for(size_t column_index=0; column_index < column_count; ++column_index){
+        ColumnIndexingScheme* previous_indexer = (column_index > 0) ? indexers[column_index-1] : nullptr;
+        indexers[column_index] = new ColumnIndexingScheme(previous_indexer, input_columns->get_column(column_index).get_read_ids());
+        if (previous_indexer != nullptr) {
+            previous_indexer->set_next_column(indexers[column_index]);
         }
+        transition_probability_table[column_index] = new TransitionProbabilityComputer<Float>(column_index, recombcost[column_index], pedigree, pedigree_partitions);
     }
 }
 
-void GenotypeDPTable::compute_backward_prob()
+template <typename Float>
+void GenotypeDPTable<Float>::compute_backward_prob(size_t first_column)
 {
+    instrumentation::ScopedTimer timer(GENOTYPE_BACKWARD_NS);
     clear_backward_table();
-    unsigned int column_count = backward_input_column_iterator.get_column_count();
+    unsigned int column_count = input_columns->get_column_count();
 
     // if no reads are in the read set, nothing to do
-    if(backward_input_column_iterator.get_column_count() == 0){
+    if(column_count == 0){
         return;
     }
 
-    // do backward pass, start at rightmost column
-    backward_input_column_iterator.jump_to_column(column_count-1);
-
-    // get the next column (which is left of current one)
-    unique_ptr<vector<const Entry*> > current_input_column;
-    unique_ptr<vector<const Entry*> > next_input_column = backward_input_column_iterator.get_next();
-    unique_ptr<vector<unsigned int> > next_read_ids = extract_read_ids(*next_input_column);
-
-    // backward pass: create sparse table
-    size_t k = (size_t)sqrt(column_count);
-    for(int column_index=column_count-1; column_index >= 0; --column_index){
-        // make former next column the current one
-        current_input_column = std::move(next_input_column);
-        unique_ptr<vector<unsigned int> > current_read_ids = std::move(next_read_ids);
-        // peek ahead and get the next column
-        if (backward_input_column_iterator.has_next()){
-            next_input_column = backward_input_column_iterator.get_next();
-        } else {
-            assert(next_input_column.get() == 0);
-            assert(next_read_ids.get() == 0);
+    // determine which backward projection columns to keep during the backward pass
+    vector<bool> keep(column_count, true);
+    if (checkpoint_policy == CHECKPOINT_SQRT) {
+        // store values at every sqrt(#columns)-th position
+        size_t k = (size_t)sqrt(column_count);
+        if (k > 1) {
+            for (size_t column_index = 0; column_index < column_count; ++column_index) {
+                keep[column_index] = (column_index % k) == 0;
+            }
         }
+    } else if (checkpoint_policy == CHECKPOINT_LOG) {
+        // columns are computed from right to left, so bisect in reverse order
+        vector<bool> keep_reversed(column_count, false);
+        mark_checkpoints(-1, (long)column_count - 2, &keep_reversed);
+        for (size_t column_index = 0; column_index + 1 < column_count; ++column_index) {
+            keep[column_index] = keep_reversed[column_count - 2 - column_index];
+        }
+    }
 
+    // backward pass: start at rightmost column and create sparse table
+    for(int column_index=column_count-1; column_index >= (int)first_column; --column_index){
         // compute the backward probabilities
-        compute_backward_column(column_index,std::move(current_input_column));
+        compute_backward_column(column_index);
 
         // check whether to delete the previous column
-        if ((k>1) && (column_index < column_count-1) && (((column_index+1)%k) != 0)) {
-            delete backward_projection_column_table[column_index+1];
+        if ((column_index < column_count-1) && !keep[column_index+1]) {
+            ColumnArena<Vector2D<Float> >::instance().release(backward_projection_column_table[column_index+1]);
             backward_projection_column_table[column_index+1] = nullptr;
         }
     }
 }
 
-void GenotypeDPTable::compute_forward_prob()
+template <typename Float>
+size_t GenotypeDPTable<Float>::column_memory(size_t column_index)
+{
+    // there is no projection column right of the last column
+    if (column_index + 1 >= indexers.size()) {
+        return 0;
+    }
+    size_t transmission_configurations = pow(4, pedigree->triple_count());
+    return sizeof(Float) * indexers[column_index]->forward_projection_size() * transmission_configurations;
+}
+
+template <typename Float>
+void GenotypeDPTable<Float>::restore_backward_column(size_t column_index)
+{
+    size_t column_count = input_columns->get_column_count();
+    assert(column_index + 1 < column_count);
+    if (backward_projection_column_table[column_index] != nullptr) {
+        return;
+    }
+    // find closest stored column to the right (or start from the rightmost column)
+    size_t first = column_index + 1;
+    while ((first + 1 < column_count) && (backward_projection_column_table[first] == nullptr)) {
+        ++first;
+    }
+    // columns first-1, ..., column_index are computed in this order
+    vector<bool> keep_reversed(column_count, true);
+    if (checkpoint_policy == CHECKPOINT_LOG) {
+        keep_reversed.assign(column_count, false);
+        mark_checkpoints((long)column_count - 2 - (long)first, (long)(column_count - 2 - column_index), &keep_reversed);
+    }
+    instrumentation::add(GENOTYPE_RECOMPUTED_COLUMNS, first - column_index);
+    for (size_t i = first; i > column_index; --i) {
+        compute_backward_column(i);
+        if ((i < first) && !keep_reversed[column_count - 2 - i]) {
+            ColumnArena<Vector2D<Float> >::instance().release(backward_projection_column_table[i]);
+            backward_projection_column_table[i] = nullptr;
+        }
+    }
+    assert(backward_projection_column_table[column_index] != nullptr);
+}
+
+template <typename Float>
+void GenotypeDPTable<Float>::compute_forward_prob()
 {
+    instrumentation::ScopedTimer timer(GENOTYPE_FORWARD_NS);
     clear_forward_table();
 
     // if no reads are in read set, nothing to compute
-    if (input_column_iterator.get_column_count() == 0) {
+    if (input_columns->get_column_count() == 0) {
+        return;
+    }
+
+    // forward pass: start at leftmost column (= 0th column)
+    for (size_t column_index=0; column_index<input_columns->get_column_count(); ++column_index) {
+        // compute forward probabilities for the current column
+        Vector2D<Float>* current_projection_column = compute_forward_column(column_index, forward_projection_column_table[0]);
+        // store the computed projection column (in case there is one)
+        if (current_projection_column != nullptr) {
+            ColumnArena<Vector2D<Float> >::instance().release(forward_projection_column_table[0]);
+            forward_projection_column_table[0] = current_projection_column;
+        }
+    }
+}
+
+template <typename Float>
+void GenotypeDPTable<Float>::compute_concurrently()
+{
+    size_t column_count = input_columns->get_column_count();
+    // the forward pass covers columns 0, ..., middle-1 first, the backward pass the others
+    size_t middle = column_count / 2;
+    release(forward_projection_column_table, column_count);
+    clear_backward_table();
+
+    // determine which forward projection columns to keep, such that they can be restored in
+    // reverse order; the one between the two halves is always kept
+    vector<bool> keep_forward(middle, true);
+    if (checkpoint_policy == CHECKPOINT_SQRT) {
+        size_t k = (size_t)sqrt(middle);
+        if (k > 1) {
+            for (size_t column_index = 0; column_index < middle; ++column_index) {
+                keep_forward[column_index] = (column_index % k) == 0;
+            }
+        }
+    } else if (checkpoint_policy == CHECKPOINT_LOG) {
+        keep_forward.assign(middle, false);
+        mark_checkpoints(-1, (long)middle - 1, &keep_forward);
+    }
+    keep_forward[middle - 1] = true;
+
+    // first half: forward projections of the left half and backward probabilities of the right half
+    run_on_two_threads(
+        [&] () {
+            instrumentation::ScopedTimer timer(GENOTYPE_FORWARD_NS);
+            for (size_t column_index = 0; column_index < middle; ++column_index) {
+                const Vector2D<Float>* previous_projection_column = (column_index > 0) ? forward_projection_column_table[column_index-1] : nullptr;
+                forward_projection_column_table[column_index] = compute_forward_projection(column_index, previous_projection_column);
+                if ((column_index > 0) && !keep_forward[column_index-1]) {
+                    ColumnArena<Vector2D<Float> >::instance().release(forward_projection_column_table[column_index-1]);
+                    forward_projection_column_table[column_index-1] = nullptr;
+                }
+            }
+        },
+        [&] () {
+            compute_backward_prob(middle);
+        }
+    );
+
+    // second half: each pass continues into the other half, where both sides of a column are
+    // available as soon as it is reached. The two threads use disjoint columns of all tables.
+    // The forward probabilities are scaled differently from the sequential computation, but
+    // the likelihoods of each column are normalized, so that the scaling cancels out.
+    run_on_two_threads(
+        [&] () {
+            instrumentation::ScopedTimer timer(GENOTYPE_BACKWARD_NS);
+            for (size_t column_index = middle; column_index-- > 0; ) {
+                if (column_index > 0) {
+                    restore_forward_column(column_index-1, keep_forward);
+                }
+                compute_backward_column(column_index, true);
+                ColumnArena<Vector2D<Float> >::instance().release(backward_projection_column_table[column_index]);
+                backward_projection_column_table[column_index] = nullptr;
+                if (column_index > 0) {
+                    ColumnArena<Vector2D<Float> >::instance().release(forward_projection_column_table[column_index-1]);
+                    forward_projection_column_table[column_index-1] = nullptr;
+                }
+            }
+        },
+        [&] () {
+            instrumentation::ScopedTimer timer(GENOTYPE_FORWARD_NS);
+            for (size_t column_index = middle; column_index < column_count; ++column_index) {
+                forward_projection_column_table[column_index] = compute_forward_column(column_index, forward_projection_column_table[column_index-1]);
+                ColumnArena<Vector2D<Float> >::instance().release(forward_projection_column_table[column_index-1]);
+                forward_projection_column_table[column_index-1] = nullptr;
+            }
+        }
+    );
+}
+
+template <typename Float>
+void GenotypeDPTable<Float>::restore_forward_column(size_t column_index, const vector<bool>& keep)
+{
+    if (forward_projection_column_table[column_index] != nullptr) {
         return;
     }
+    // find closest stored column to the left (or start from the leftmost column)
+    long last_stored = (long)column_index - 1;
+    while ((last_stored >= 0) && (forward_projection_column_table[last_stored] == nullptr)) {
+        --last_stored;
+    }
+    // columns last_stored+1, ..., column_index are computed in this order
+    vector<bool> keep_restored(keep.size(), true);
+    if (checkpoint_policy == CHECKPOINT_LOG) {
+        keep_restored.assign(keep.size(), false);
+        mark_checkpoints(last_stored, (long)column_index, &keep_restored);
+    }
+    instrumentation::add(GENOTYPE_RECOMPUTED_COLUMNS, column_index - last_stored);
+    for (size_t i = last_stored + 1; i <= column_index; ++i) {
+        const Vector2D<Float>* previous_projection_column = (i > 0) ? forward_projection_column_table[i-1] : nullptr;
+        forward_projection_column_table[i] = compute_forward_projection(i, previous_projection_column);
+        if ((i > 0) && ((long)i - 1 > last_stored) && !keep_restored[i-1]) {
+            ColumnArena<Vector2D<Float> >::instance().release(forward_projection_column_table[i-1]);
+            forward_projection_column_table[i-1] = nullptr;
+        }
+    }
+    assert(forward_projection_column_table[column_index] != nullptr);
+}
+
+template <typename Float>
+Vector2D<Float>* GenotypeDPTable<Float>::compute_forward_projection(size_t column_index, const Vector2D<Float>* previous_projection_column)
+{
+    assert(column_index + 1 < input_columns->get_column_count());
+    assert((column_index == 0) || (previous_projection_column != nullptr));
+
+    ColumnIndexingScheme* current_indexer = indexers[column_index];
+    unsigned int transmission_configurations = pow(4, pedigree->triple_count());
+    PackedColumn current_input_column = input_columns->get_column(column_index);
+
+    Vector2D<Float>* current_projection_column = ColumnArena<Vector2D<Float> >::instance().acquire(current_indexer->forward_projection_size(),transmission_configurations,0.0);
+
+    // create column cost computer for each transmission vector
+    vector<GenotypeColumnCostComputer<Float> > cost_computers;
+    cost_computers.reserve(transmission_configurations);
+    for(unsigned int i = 0; i < transmission_configurations; ++i){
+        cost_computers.emplace_back(current_input_column, column_index, read_sources, pedigree, *pedigree_partitions[i]);
+    }
 
-    // start at leftmost column (= 0th column)
-    input_column_iterator.jump_to_column(0);
-    // store current and next column
-    unique_ptr<vector<const Entry *> > current_input_column;
-    unique_ptr<vector<const Entry *> > next_input_column;
-    // get the next column ahead of time
-    next_input_column = input_column_iterator.get_next();
-    unique_ptr<vector<unsigned int> > next_read_ids = extract_read_ids(*next_input_column);
-
-    // forward pass: create a sparse table, storing values at every sqrt(#columns)-th position
-    size_t k = (size_t)sqrt(input_column_iterator.get_column_count());
-    for (size_t column_index=0; column_index<input_column_iterator.get_column_count(); ++column_index) {
-        // make former next column the current one
-        current_input_column = std::move(next_input_column);
-        unique_ptr<vector<unsigned int> > current_read_ids = std::move(next_read_ids);
-        // peek ahead and get the next column
-        if (input_column_iterator.has_next()) {
-            next_input_column = input_column_iterator.get_next();
-            next_read_ids = extract_read_ids(*next_input_column);
+    Float scaling_sum = 0.0;
+
+    // iterate over all bipartitions
+    unique_ptr<ColumnIndexingIterator> iterator = current_indexer->get_iterator();
+    while (iterator->has_next()) {
+        int bit_changed = -1;
+        iterator->advance(&bit_changed);
+        if (bit_changed >= 0) {
+            for(auto& cost_computer : cost_computers) {
+                cost_computer.update_partitioning(bit_changed);
+            }
         } else {
-            assert(next_input_column.get() == 0);
-            assert(next_read_ids.get() == 0);
+            for(auto& cost_computer : cost_computers) {
+               cost_computer.set_partitioning(iterator->get_partition());
+            }
         }
 
-        // compute forward probabilities for the current column
-        compute_forward_column(column_index,std::move(current_input_column));
+        size_t backward_projection_index = (column_index > 0) ? iterator->get_backward_projection() : 0;
+        size_t forward_projection_index = iterator->get_forward_projection();
+
+        for(size_t i = 0; i < transmission_configurations; ++i){
+            // sum of previous values (alpha_i-1 * transition_prob)
+            Float sum_prev_values = 1.0;
+            if(column_index > 0){
+                sum_prev_values = 0.0;
+                for(size_t j = 0; j < transmission_configurations; ++j){
+                    sum_prev_values += previous_projection_column->at(backward_projection_index,j) * transition_probability_table[column_index]->get_prob_transmission(j,i);
+                }
+            }
+            unsigned int number_of_allele_assignments = 1<<pedigree_partitions[i]->count();
+            for(unsigned int a = 0; a < number_of_allele_assignments; ++a){
+                Float forward_probability = sum_prev_values * cost_computers[i].get_cost(a) * transition_probability_table[column_index]->get_prob_allele_assignment(i,a);
+                current_projection_column->at(forward_projection_index, i) += forward_probability;
+                scaling_sum += forward_probability;
+            }
+        }
     }
+    current_projection_column->divide_entries_by(scaling_sum);
+    return current_projection_column;
 }
 
-void GenotypeDPTable::compute_backward_column(size_t column_index, unique_ptr<vector<const Entry*>> current_input_column)
+template <typename Float>
+void GenotypeDPTable<Float>::compute_backward_column(size_t column_index, bool compute_likelihoods)
 {
-   assert(column_index < backward_input_column_iterator.get_column_count());
+   assert(column_index < input_columns->get_column_count());
 
    // check if column already exists
    if(column_index > 0){
@@ -209,34 +411,46 @@ void GenotypeDPTable::compute_backward_column(size_t column_index, unique_ptr<ve
    // number of transmission values
    unsigned int transmission_configurations = pow(4, pedigree->triple_count());
 
-   // if current input column was not provided, create it
-   if(current_input_column.get() == nullptr) {
-       backward_input_column_iterator.jump_to_column(column_index);
-       current_input_column = backward_input_column_iterator.get_next();
-   }
+   PackedColumn current_input_column = input_columns->get_column(column_index);
 
    // obtain previous projection column (same index as current column!)
-   Vector2D<long double>* previous_projection_column = nullptr;
+   Vector2D<Float>* previous_projection_column = nullptr;
    // check if there is a projection column
-   if(column_index < backward_input_column_iterator.get_column_count()-1){
+   if(column_index < input_columns->get_column_count()-1){
        previous_projection_column = backward_projection_column_table[column_index];
    }
 
    // initialize the new projection column (= current index -1)
-   Vector2D<long double>* current_projection_column = nullptr;
+   Vector2D<Float>* current_projection_column = nullptr;
    if(column_index > 0){
-       current_projection_column = new Vector2D<long double>(indexers[column_index-1]->forward_projection_size(),transmission_configurations,0.0L);
+       current_projection_column = ColumnArena<Vector2D<Float> >::instance().acquire(indexers[column_index-1]->forward_projection_size(),transmission_configurations,0.0);
    }
 
    // create column cost computer for each transmission vector
-   vector<GenotypeColumnCostComputer> cost_computers;
+   vector<GenotypeColumnCostComputer<Float> > cost_computers;
    cost_computers.reserve(transmission_configurations);
    for(unsigned int i = 0; i < transmission_configurations; ++i){
-       cost_computers.emplace_back(*current_input_column, column_index, read_sources, pedigree, *pedigree_partitions[i]);
+       cost_computers.emplace_back(current_input_column, column_index, read_sources, pedigree, *pedigree_partitions[i]);
    }
 
    // for scaled version of forward backward alg, keep track of the sum of backward
-   long double scaling_sum = 0.0L;
+   Float scaling_sum = 0.0;
+
+   // forward projection column and sum of alpha*beta, used for the genotype likelihoods
+   const Vector2D<Float>* forward_probabilities = nullptr;
+   Float normalization = 0.0;
+   size_t individual_count = pedigree->size();
+   if (compute_likelihoods) {
+       if (column_index > 0) {
+           forward_probabilities = forward_projection_column_table[column_index-1];
+           assert(forward_probabilities != nullptr);
+       }
+       if (instrumentation::is_enabled()) {
+           instrumentation::add(GENOTYPE_COLUMNS, 1);
+           instrumentation::record_max(GENOTYPE_MAX_COLUMN_SIZE, current_indexer->column_size());
+           instrumentation::add(GENOTYPE_COLUMN_BYTES, column_memory(column_index));
+       }
+   }
 
    // iterate over all bipartitions
    unique_ptr<ColumnIndexingIterator> iterator = current_indexer->get_iterator();
@@ -256,7 +470,7 @@ void GenotypeDPTable::compute_backward_column(size_t column_index, unique_ptr<ve
        }
 
        // Determine index in forward projection column from where to fetch the current cost
-       long double backward_prob = 1.0L;
+       Float backward_prob = 1.0;
 
        // iterate over all transmission configurations
        for(size_t i = 0; i < transmission_configurations; ++i){
@@ -265,30 +479,53 @@ void GenotypeDPTable::compute_backward_column(size_t column_index, unique_ptr<ve
 
            // get entry from forward projection column (which is equal to current backward prob. for all genotypes)
            size_t forward_projection_index = 0;
-           if (column_index + 1 < backward_input_column_iterator.get_column_count()) {
+           if (column_index + 1 < input_columns->get_column_count()) {
                forward_projection_index = iterator->get_forward_projection();
                backward_prob = previous_projection_column->at(forward_projection_index,i);
            }
 
            size_t backward_projection_index = iterator->get_backward_projection();
+
+           // sum of previous values (alpha_i-1 * transition_prob), only needed for the likelihoods
+           Float sum_prev_values = 1.0;
+           if (forward_probabilities != nullptr) {
+               sum_prev_values = 0.0;
+               for(size_t j = 0; j < transmission_configurations; ++j){
+                   sum_prev_values += forward_probabilities->at(backward_projection_index,j) * transition_probability_table[column_index]->get_prob_transmission(j,i);
+               }
+           }
+
            // sum up entries in backward projection column
            for(unsigned int a = 0; a < number_of_allele_assignments; ++a){
                if(column_index > 0){
-                   long double local_cost = cost_computers[i].get_cost(a);
+                   Float local_cost = cost_computers[i].get_cost(a);
                    for(size_t j = 0; j < transmission_configurations; ++j){
-                       long double transition_prob = transition_probability_table[column_index]->get_prob_transmission(j,i) * transition_probability_table[column_index]->get_prob_allele_assignment(i,a);
+                       Float transition_prob = transition_probability_table[column_index]->get_prob_transmission(j,i) * transition_probability_table[column_index]->get_prob_allele_assignment(i,a);
                        current_projection_column->at(backward_projection_index, j) += backward_prob * local_cost * transition_prob;
                    }
                }
+               if (compute_likelihoods) {
+                   // the betas are not scaled by scaling_sum, which cancels out in the normalization
+                   const vector<unsigned int>& assignment_genotypes = pedigree_partitions[i]->get_assignment_genotypes();
+                   Float forward_backward = sum_prev_values * cost_computers[i].get_cost(a) * transition_probability_table[column_index]->get_prob_allele_assignment(i,a) * backward_prob;
+                   normalization += forward_backward;
+                   for (size_t individuals_index = 0; individuals_index < individual_count; ++individuals_index) {
+                       genotype_likelihood_table.at(individuals_index,column_index).likelihoods[assignment_genotypes[a * individual_count + individuals_index]] += forward_backward;
+                   }
+               }
                scaling_sum += backward_prob;
            }
        }
    }
 
-   // go through (old) projection column to scale the values -> when we lookup betas later, they will sum up to 1
-   if(previous_projection_column != 0){
-       previous_projection_column->divide_entries_by(scaling_sum);
+   if (compute_likelihoods) {
+       for(size_t individuals_index = 0; individuals_index < individual_count; ++individuals_index){
+           genotype_likelihood_table.at(individuals_index,column_index).divide_likelihoods_by(normalization);
+       }
    }
+
+   // scale the new projection column; the previous one (which is used as input when recomputing
+   // columns) is only scaled by scaling_sum where its betas are looked up in the forward pass
    if(current_projection_column != 0){
        current_projection_column->divide_entries_by(scaling_sum);
        backward_projection_column_table[column_index-1] = current_projection_column;
@@ -297,9 +534,10 @@ void GenotypeDPTable::compute_backward_column(size_t column_index, unique_ptr<ve
 }
 
 // given the current matrix column, compute the forward probability table
-void GenotypeDPTable::compute_forward_column(size_t column_index, unique_ptr<vector<const Entry*>> current_input_column)
+template <typename Float>
+Vector2D<Float>* GenotypeDPTable<Float>::compute_forward_column(size_t column_index, Vector2D<Float>* previous_projection_column)
 {
-    assert(column_index < input_column_iterator.get_column_count());
+    assert(column_index < input_columns->get_column_count());
 
     ColumnIndexingScheme* current_indexer = indexers[column_index];
     assert(current_indexer != nullptr);
@@ -307,54 +545,44 @@ void GenotypeDPTable::compute_forward_column(size_t column_index, unique_ptr<vec
     // compute the number of different transmission vectors
     unsigned int transmission_configurations = pow(4, pedigree->triple_count());
 
-    // if the current input column was not provided, then create it
-    if(current_input_column.get() == nullptr) {
-        input_column_iterator.jump_to_column(column_index);
-        current_input_column = input_column_iterator.get_next();
+    if (instrumentation::is_enabled()) {
+        instrumentation::add(GENOTYPE_COLUMNS, 1);
+        instrumentation::record_max(GENOTYPE_MAX_COLUMN_SIZE, current_indexer->column_size());
+        instrumentation::add(GENOTYPE_COLUMN_BYTES, column_memory(column_index));
     }
 
-    // obtain previous projection column (which is assumed to have already been computed)
-    Vector2D<long double>* previous_projection_column = nullptr;
-    if (column_index > 0) {
-        previous_projection_column = forward_projection_column_table[0];
-        assert(previous_projection_column != nullptr);
-    }
+    PackedColumn current_input_column = input_columns->get_column(column_index);
+
+    // the previous projection column is assumed to have already been computed
+    assert((column_index == 0) || (previous_projection_column != nullptr));
 
     // obtain the backward projection table, from where to get the backward probabilities
-    size_t k = (size_t)sqrt(input_column_iterator.get_column_count());
-    Vector2D<long double>* backward_probabilities = nullptr;
-    if(column_index + 1 < input_column_iterator.get_column_count()){
-        backward_probabilities = backward_projection_column_table[column_index];
+    Vector2D<Float>* backward_probabilities = nullptr;
+    if(column_index + 1 < input_columns->get_column_count()){
         // if column is not stored, recompute it
-        if(backward_probabilities == nullptr){
-            // compute index of next column that has been stored
-            size_t next = std::min((unsigned int) ( ((column_index + k) / k) * k ), input_column_iterator.get_column_count()-1);
-            for(size_t i = next; i > column_index; --i){
-                compute_backward_column(i);
-            }
-
-            // last column just computed still needs to be scaled
-            backward_projection_column_table[column_index]->divide_entries_by(scaling_parameters[column_index]);
-        }
+        restore_backward_column(column_index);
         backward_probabilities = backward_projection_column_table[column_index];
         assert(backward_probabilities != nullptr);
+        // scale the values -> the betas looked up below sum up to 1
+        backward_probabilities->divide_entries_by(scaling_parameters[column_index]);
     }
 
     // initialize the new projection column (2D: has entry for every bipartition and transmission value)
-    Vector2D<long double>* current_projection_column = nullptr;
-    if(column_index + 1 < input_column_iterator.get_column_count()){
-        current_projection_column = new Vector2D<long double>(current_indexer->forward_projection_size(),transmission_configurations,0.0L);
+    Vector2D<Float>* current_projection_column = nullptr;
+    if(column_index + 1 < input_columns->get_column_count()){
+        current_projection_column = ColumnArena<Vector2D<Float> >::instance().acquire(current_indexer->forward_projection_size(),transmission_configurations,0.0);
     }
 
     // create column cost computer for each transmission vector
-    vector<GenotypeColumnCostComputer> cost_computers;
+    vector<GenotypeColumnCostComputer<Float> > cost_computers;
     cost_computers.reserve(transmission_configurations);
     for(unsigned int i = 0; i < transmission_configurations; ++i){
-        cost_computers.emplace_back(*current_input_column, column_index, read_sources, pedigree, *pedigree_partitions[i]);
+        cost_computers.emplace_back(current_input_column, column_index, read_sources, pedigree, *pedigree_partitions[i]);
     }
 
     // sum of alpha*beta, used to normalize the likelihoods
-    long double normalization = 0.0L;
+    Float normalization = 0.0;
+    size_t individual_count = pedigree->size();
 
     // iterate over all bipartitions
     unique_ptr<ColumnIndexingIterator> iterator = current_indexer->get_iterator();
@@ -382,37 +610,35 @@ void GenotypeDPTable::compute_forward_column(size_t column_index, unique_ptr<vec
         // iterate over all transmission vectors
         for(size_t i = 0; i < transmission_configurations; ++i){
             // keep track of sum of previous values (alpha_i-1 * transition_prob)
-            long double sum_prev_values = 0.0L;
+            Float sum_prev_values = 0.0;
             unsigned int number_of_allele_assignments = 1<<pedigree_partitions[i]->count();
+            // genotype index of each individual under each allele assignment
+            const vector<unsigned int>& assignment_genotypes = pedigree_partitions[i]->get_assignment_genotypes();
             if(column_index > 0){
                 for(size_t j = 0; j < transmission_configurations; ++j){
                     // add product of previous cost * transition_probability
                     sum_prev_values += ((previous_projection_column->at(backward_projection_index,j)) * (transition_probability_table[column_index]->get_prob_transmission(j,i)) );
                 }
             } else {
-                sum_prev_values = 1.0L;
+                sum_prev_values = 1.0;
             }
 
             // iterate over all allele assignments
             for(unsigned int a = 0; a < number_of_allele_assignments; ++a){
                 // get already computed backward probability from table
-                long double backward_probability = 1.0L;
+                Float backward_probability = 1.0;
                 if(backward_probabilities != nullptr){
                     size_t forward_projection_index = iterator->get_forward_projection();
                     backward_probability = backward_probabilities->at(forward_projection_index,i);
                 }
 
-                long double forward_probability = ( sum_prev_values * cost_computers[i].get_cost(a) * (transition_probability_table[column_index]->get_prob_allele_assignment(i,a)) ) / scaling_parameters[column_index];
-                long double forward_backward = forward_probability * backward_probability;
+                Float forward_probability = ( sum_prev_values * cost_computers[i].get_cost(a) * (transition_probability_table[column_index]->get_prob_allele_assignment(i,a)) ) / scaling_parameters[column_index];
+                Float forward_backward = forward_probability * backward_probability;
                 normalization += forward_backward;
 
                 // marginalize over all genotypes
-                for (size_t individuals_index = 0; individuals_index < pedigree->size(); ++individuals_index) {
-                    unsigned int partition0 = pedigree_partitions[i]->haplotype_to_partition(individuals_index,0);
-                    unsigned int partition1 = pedigree_partitions[i]->haplotype_to_partition(individuals_index,1);
-                    unsigned int allele0 = (a >> partition0) & 1;
-                    unsigned int allele1 = (a >> partition1) & 1;
-                    genotype_likelihood_table.at(individuals_index,column_index).likelihoods[allele0 + allele1] += forward_backward;
+                for (size_t individuals_index = 0; individuals_index < individual_count; ++individuals_index) {
+                    genotype_likelihood_table.at(individuals_index,column_index).likelihoods[assignment_genotypes[a * individual_count + individuals_index]] += forward_backward;
                 }
 
                 // set forward projections
@@ -423,15 +649,9 @@ void GenotypeDPTable::compute_forward_column(size_t column_index, unique_ptr<vec
         }
     }
 
-    // store the computed projection column (in case there is one)
-    if(current_projection_column != 0){
-        delete forward_projection_column_table[0];
-        forward_projection_column_table[0] = current_projection_column;
-    }
-
     // we can remove the backward-probability column
     if(backward_projection_column_table[column_index] != nullptr){
-        delete backward_projection_column_table[column_index];
+        ColumnArena<Vector2D<Float> >::instance().release(backward_projection_column_table[column_index]);
         backward_projection_column_table[column_index] = nullptr;
     }
 
@@ -439,13 +659,25 @@ void GenotypeDPTable::compute_forward_column(size_t column_index, unique_ptr<vec
     for(size_t individuals_index = 0; individuals_index < pedigree->size(); ++individuals_index){
         genotype_likelihood_table.at(individuals_index,column_index).divide_likelihoods_by(normalization);
     }
+    return current_projection_column;
 }
 
-vector<long double> GenotypeDPTable::get_genotype_likelihoods(unsigned int individual_id, unsigned int position)
+template <typename Float>
+checkpoint_policy_t GenotypeDPTable<Float>::get_checkpoint_policy()
+{
+    return checkpoint_policy;
+}
+
+template <typename Float>
+vector<long double> GenotypeDPTable<Float>::get_genotype_likelihoods(unsigned int individual_id, unsigned int position)
 {
     assert(pedigree->id_to_index(individual_id) < genotype_likelihood_table.get_size0());
-    assert(position < input_column_iterator.get_column_count());
+    assert(position < input_columns->get_column_count());
 
-    return genotype_likelihood_table.at(pedigree->id_to_index(individual_id),position).likelihoods;
+    const vector<Float>& likelihoods = genotype_likelihood_table.at(pedigree->id_to_index(individual_id),position).likelihoods;
+    return vector<long double>(likelihoods.begin(), likelihoods.end());
 
 }
+
+template class GenotypeDPTable<long double>;
+template class GenotypeDPTable<double>;
@@ -6,16 +6,24 @@
 #include <memory>
 
 #include "columnindexingscheme.h"
-#include "columniterator.h"
 #include "entry.h"
 #include "read.h"
 #include "readset.h"
 #include "pedigree.h"
 #include "pedigreepartitions.h"
+#include "pedigreetopology.h"
 #include "vector2d.h"
-#include "backwardcolumniterator.h"
+#include "columnarena.h"
+#include "packedcolumns.h"
+#include "checkpointpolicy.h"
 #include "transitionprobabilitycomputer.h"
 
+/** Forward-backward algorithm computing genotype likelihoods for all individuals of a pedigree.
+ *  Float is the numeric type used for all probabilities of the DP. Columns are scaled to sum
+ *  up to one, such that double is sufficient to avoid underflows in practice; long double
+ *  (the default) gives the most precise likelihoods, double is faster.
+ */
+template <typename Float = long double>
 class GenotypeDPTable
 {
 private:
@@ -23,19 +31,19 @@ private:
   // stores genotype likelihoods for a given individual and a given position
   struct genotype_likelihood_t {
     // stores likelihoods in this order: 0/0, 1/0, 1/1
-    std::vector<long double> likelihoods;
+    std::vector<Float> likelihoods;
     size_t ind_id;
     size_t position;
-    genotype_likelihood_t():likelihoods(3,0.0L),ind_id(0),position(0){}
-    genotype_likelihood_t(long double abs, long double het, long double hom, size_t ind_id, size_t pos) :likelihoods(3,0.0L),ind_id(ind_id),position(pos)
+    genotype_likelihood_t():likelihoods(3,0.0),ind_id(0),position(0){}
+    genotype_likelihood_t(Float abs, Float het, Float hom, size_t ind_id, size_t pos) :likelihoods(3,0.0),ind_id(ind_id),position(pos)
     {
       likelihoods[0] = abs;
       likelihoods[1] = het;
       likelihoods[2] = hom;
     }
     // divide likelihoods by given value
-    void divide_likelihoods_by(long double& val){
-      std::transform(likelihoods.begin(), likelihoods.end(), likelihoods.begin(), std::bind2nd(std::divides<long double>(), val));
+    void divide_likelihoods_by(Float& val){
+      std::transform(likelihoods.begin(), likelihoods.end(), likelihoods.begin(), std::bind2nd(std::divides<Float>(), val));
     }
 
     friend inline std::ostream& operator<<(std::ostream& out, const genotype_likelihood_t& g){
@@ -52,46 +60,71 @@ private:
   const std::vector<unsigned int>& recombcost;
   // the pedigree containing all the individuals
   const Pedigree* pedigree;
-  std::vector<PedigreePartitions*> pedigree_partitions;
+  // checkpoint policy for backward columns in effect (never CHECKPOINT_AUTO after construction)
+  checkpoint_policy_t checkpoint_policy;
+  // memory limit (in bytes) used to choose a policy if CHECKPOINT_AUTO was requested
+  size_t memory_limit;
+  // whether the forward and the backward pass run at the same time (see compute_concurrently)
+  bool concurrent;
+  // pedigree partitions for all transmission values, shared by all DP tables for pedigrees of the same topology
+  std::shared_ptr<const PedigreeTopology> topology;
+  const std::vector<PedigreePartitions*>& pedigree_partitions;
   // indexing schemes
   std::vector<ColumnIndexingScheme*> indexers;
-  // projection_column_table[c] contains the projection column between columns c and c+1
-  std::vector<Vector2D<long double>* > forward_projection_column_table;
-  std::vector<Vector2D<long double>* > backward_projection_column_table;
+  // projection_column_table[c] contains the projection column between columns c and c+1;
+  // backward projection columns are stored scaled by the scaling parameter of column c+1 only.
+  // The sequential forward pass only keeps the last forward projection column (at index 0).
+  std::vector<Vector2D<Float>* > forward_projection_column_table;
+  std::vector<Vector2D<Float>* > backward_projection_column_table;
   // genotype likelihoods for each individual at each position
   Vector2D<genotype_likelihood_t> genotype_likelihood_table;
-  //iterator used to iterate the columns of the input matrix (forward)
-  ColumnIterator input_column_iterator;
-  // iterator used to iterate the columns of the input matrix (backward)
-  BackwardColumnIterator backward_input_column_iterator;
+  // all columns of the input matrix, used by both forward and backward pass
+  std::unique_ptr<PackedColumns> input_columns;
   // stores the transmission probability computers for each column
-  std::vector<TransitionProbabilityComputer*> transition_probability_table;
+  std::vector<TransitionProbabilityComputer<Float>*> transition_probability_table;
   // scaling parameters
-  std::vector<long double> scaling_parameters;
+  std::vector<Float> scaling_parameters;
 
-  // helper to pull read ids out of read column
-  std::unique_ptr<std::vector<unsigned int> > extract_read_ids(const std::vector<const Entry *>& entries);
   // initializes all members associated with the DP table
   void clear_forward_table();
   void clear_backward_table();
   // forward pass: computes the forward probabilities
   void compute_forward_prob();
-  // backward pass: computes the backward probabilities
-  void compute_backward_prob();
+  // backward pass: computes the backward probabilities of columns first_column, ..., column_count-1
+  void compute_backward_prob(size_t first_column = 0);
+  // computes the forward pass on the left half and the backward pass on the right half of the
+  // columns at the same time, then continues both passes into the other half on the same threads
+  void compute_concurrently();
   // computes the index for each column
   void compute_index();
+  // returns the number of bytes needed to store the backward projection column between columns c and c+1
+  size_t column_memory(size_t column_index);
+  // makes sure the backward projection column between columns c and c+1 exists by recomputing it
+  // starting from the closest stored column to the right
+  void restore_backward_column(size_t column_index);
 
-  // computes column of forward probabilities of given index, assuming previous column was already computed (from left to right)
-  void compute_forward_column(size_t column_index, std::unique_ptr<std::vector<const Entry*>> current_input_column = nullptr);
+  // makes sure the forward projection column between columns c and c+1 exists by recomputing it
+  // starting from the closest stored column to the left (only used by compute_concurrently)
+  void restore_forward_column(size_t column_index, const std::vector<bool>& keep);
 
-  // computes column of backward probabilities of given index, assuming previous column was already computed (from right to left)
-  void compute_backward_column(size_t column_index, std::unique_ptr<std::vector<const Entry*>> current_input_column = nullptr);
+  // computes column of forward probabilities and the genotype likelihoods of given index, given the previous
+  // forward projection column (from left to right); returns the new forward projection column (if any)
+  Vector2D<Float>* compute_forward_column(size_t column_index, Vector2D<Float>* previous_projection_column);
+
+  // computes the forward projection column between columns c and c+1 given the previous one, without
+  // backward probabilities, scaled to sum up to one
+  Vector2D<Float>* compute_forward_projection(size_t column_index, const Vector2D<Float>* previous_projection_column);
+
+  // computes column of backward probabilities of given index, assuming previous column was already computed (from right to left);
+  // if compute_likelihoods is set, also computes the genotype likelihoods of the column from the stored
+  // forward projection column between columns c-1 and c
+  void compute_backward_column(size_t column_index, bool compute_likelihoods = false);
 
   // returns the number of bits set
   static size_t popcount(size_t x);
 
   // given two transmission vectors and their length, compute probability of changing from t1 to t2
-  long double compute_transition_prob(size_t t1, size_t t2, size_t length, unsigned int r);
+  Float compute_transition_prob(size_t t1, size_t t2, size_t length, unsigned int r);
 
   // used to initialize/clear tables
   template<class T>
@@ -105,6 +138,16 @@ private:
     v.assign(size,nullptr);
   }
 
+  // used to initialize/clear tables of columns obtained from the column arena
+  template<class T>
+  void release(std::vector<T*>& v, size_t size)
+  {
+    for(size_t i=0; i<v.size(); ++i) {
+        ColumnArena<T>::instance().release(v[i]);
+    }
+    v.assign(size,nullptr);
+  }
+
 public:
   /** Constructor
    * @param read_set   DP table is constructed for the given reads. Ownership is retained by caller.
@@ -113,11 +156,19 @@ public:
    * @param pedigree the pedigree giving individuals and their relationships
    * @param positions positions to work on. If 0, all positions given in the read_set are used.
    * 		      caller retains ownership.
+   * @param checkpoint_policy Determines which columns are stored during the backward pass (see checkpoint_policy_t).
+   *                          Results do not depend on it.
+   * @param memory_limit Memory (in bytes) available for stored columns, only used with CHECKPOINT_AUTO.
+   * @param concurrent If true, the forward and the backward pass run on two threads at the same time and meet in the
+   *                   middle. The likelihoods agree with those of the sequential computation up to rounding errors.
    */
-  GenotypeDPTable(ReadSet* read_set, const std::vector<unsigned int>& recombcost, const Pedigree* pedigree, const std::vector<unsigned int>* positions = nullptr);
+  GenotypeDPTable(ReadSet* read_set, const std::vector<unsigned int>& recombcost, const Pedigree* pedigree, const std::vector<unsigned int>* positions = nullptr, checkpoint_policy_t checkpoint_policy = CHECKPOINT_SQRT, size_t memory_limit = 0, bool concurrent = false);
   ~GenotypeDPTable();
 
-  // returns the computed genotype likelihoods for a given individual and a given SNP position
+  // returns the checkpoint policy that has been used (if CHECKPOINT_AUTO was requested, the chosen one)
+  checkpoint_policy_t get_checkpoint_policy();
+
+  // returns the computed genotype likelihoods for a given individual and a given SNP position (independent of Float)
   std::vector<long double> get_genotype_likelihoods(unsigned int individual, unsigned int position);
 
 };
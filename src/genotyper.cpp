@@ -2,14 +2,96 @@
 #include <iostream>
 #include <cassert>
 #include <math.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <exception>
+#include <thread>
 
-#include "columniterator.h"
+#include "packedcolumns.h"
 #include "genotypedistribution.h"
+#include "phredprobabilities.h"
 
 #include "genotyper.h"
 
 using namespace std;
 
+namespace {
+	/** Factors by which an entry with a given phred score multiplies the genotype distribution
+	 *  (hom. ref., het., hom. alt.) of its variant, if it shows the reference (ref) or the
+	 *  alternative allele (alt). Precomputed for phred scores below PhredProbabilities::TABLE_SIZE. */
+	class EntryGenotypeFactors {
+	public:
+		typedef std::array<double, 3> factors_t;
+
+		static const EntryGenotypeFactors& get() {
+			static const EntryGenotypeFactors factors;
+			return factors;
+		}
+
+		factors_t ref(unsigned int phred_score) const {
+			return (phred_score < TABLE_SIZE) ? ref_factors[phred_score] : compute(phred_score, true);
+		}
+
+		factors_t alt(unsigned int phred_score) const {
+			return (phred_score < TABLE_SIZE) ? alt_factors[phred_score] : compute(phred_score, false);
+		}
+
+	private:
+		static const unsigned int TABLE_SIZE = PhredProbabilities<double>::TABLE_SIZE;
+
+		alignas(64) std::array<factors_t, TABLE_SIZE> ref_factors;
+		alignas(64) std::array<factors_t, TABLE_SIZE> alt_factors;
+
+		EntryGenotypeFactors() {
+			for (unsigned int q = 0; q < TABLE_SIZE; ++q) {
+				ref_factors[q] = compute(q, true);
+				alt_factors[q] = compute(q, false);
+			}
+		}
+
+		static factors_t compute(unsigned int phred_score, bool ref) {
+			double p_wrong = max(0.05, PhredProbabilities<double>::get().error(phred_score));
+			if (ref) {
+				return factors_t{{2.0/3.0-1.0/3.0*p_wrong, 1.0/3.0, 1.0/3.0*p_wrong}};
+			}
+			return factors_t{{1.0/3.0*p_wrong, 1.0/3.0, 2.0/3.0-1.0/3.0*p_wrong}};
+		}
+	};
+
+
+	/** Computes the genotype distribution at each of the given positions from the reads in readset. */
+	void compute_genotype_distributions(const ReadSet& readset, const vector<unsigned int>* positions, GenotypeDistribution* distributions) {
+		const EntryGenotypeFactors& factors = EntryGenotypeFactors::get();
+		PackedColumns columns(readset, positions);
+		for (size_t column_index = 0; column_index < columns.get_column_count(); ++column_index) {
+			PackedColumn column = columns.get_column(column_index);
+			GenotypeDistribution distribution;
+			for (size_t i = 0; i < column.size(); ++i) {
+				switch (column.get_allele_type(i)) {
+					case Entry::REF_ALLELE:
+						distribution.multiply(factors.ref(column.get_phred_score(i)));
+						break;
+					case Entry::ALT_ALLELE:
+						distribution.multiply(factors.alt(column.get_phred_score(i)));
+						break;
+					default:
+						break;
+				}
+			}
+			distribution.normalize();
+			distributions[column_index] = distribution;
+		}
+	}
+
+	Genotype likeliest_genotype(const GenotypeDistribution& distribution) {
+		if (distribution.errorProbability() < 0.1) {
+			return Genotype(distribution.likeliestGenotype(), Genotype::DIPLOID);
+		}
+		return Genotype();
+	}
+}
+
 void compute_genotypes(const ReadSet& readset, std::vector<Genotype>* genotypes, std::vector<GenotypeDistribution>* genotype_likelihoods, std::vector<unsigned int>* positions) {
 	assert(genotypes != nullptr);
 	assert(genotype_likelihoods != nullptr);
@@ -19,39 +101,64 @@ void compute_genotypes(const ReadSet& readset, std::vector<Genotype>* genotypes,
 		positions = readset.get_positions();
 		assert(positions != nullptr);
 	}
-	ColumnIterator column_iterator(readset, positions);
-	size_t column_index = 0;
-	while (column_iterator.has_next()) {
-// 		cerr << "  working in column " << column_index << ", position " << positions->at(column_index) << endl;
-		std::unique_ptr<std::vector<const Entry*> > column = column_iterator.get_next();
-		GenotypeDistribution distribution;
-		for (const Entry* e : *column) {
-// 			cerr << "    " << (*e) << endl;
-			double p_wrong = max(0.05, pow(10.0,-((double)e->get_phred_score())/10.0));
-			switch (e->get_allele_type()) {
-				case Entry::REF_ALLELE:
-					distribution = distribution * GenotypeDistribution(2.0/3.0-1.0/3.0*p_wrong, 1.0/3.0, 1.0/3.0*p_wrong);
-					break;
-				case Entry::ALT_ALLELE:
-					distribution = distribution * GenotypeDistribution(1.0/3.0*p_wrong, 1.0/3.0, 2.0/3.0-1.0/3.0*p_wrong);
-					break;
-				default:
-					break;
+	genotype_likelihoods->resize(positions->size());
+	compute_genotype_distributions(readset, positions, genotype_likelihoods->data());
+	for (const GenotypeDistribution& distribution : *genotype_likelihoods) {
+		genotypes->push_back(likeliest_genotype(distribution));
+	}
+	assert(genotypes->size() == positions->size());
+	delete positions;
+}
+
+void compute_genotypes_batch(const std::vector<ReadSet*>& readsets, const std::vector<unsigned int>& positions, std::vector<double>* genotype_likelihoods, std::vector<Genotype>* genotypes, unsigned int threads) {
+	assert(genotype_likelihoods != nullptr);
+	size_t position_count = positions.size();
+	genotype_likelihoods->assign(readsets.size() * position_count * 3, 0.0);
+	if (genotypes != nullptr) {
+		genotypes->assign(readsets.size() * position_count, Genotype());
+	}
+
+	// read sets are handed out one at a time, since their sizes may differ a lot
+	atomic<size_t> next_readset(0);
+	auto work = [&]() {
+		vector<GenotypeDistribution> distributions(position_count);
+		for (size_t i = next_readset++; i < readsets.size(); i = next_readset++) {
+			compute_genotype_distributions(*readsets[i], &positions, distributions.data());
+			for (size_t j = 0; j < position_count; ++j) {
+				for (size_t g = 0; g < 3; ++g) {
+					genotype_likelihoods->at((i * position_count + j) * 3 + g) = distributions[j].probabilityOf(g);
+				}
+				if (genotypes != nullptr) {
+					genotypes->at(i * position_count + j) = likeliest_genotype(distributions[j]);
+				}
 			}
-			
 		}
-		distribution.normalize();
-		Genotype genotype;
-		if (distribution.errorProbability() < 0.1) {
-			genotype = Genotype(distribution.likeliestGenotype(), Genotype::DIPLOID);
+	};
+
+	threads = std::max(1u, std::min(threads, (unsigned int)readsets.size()));
+	if (threads == 1) {
+		work();
+		return;
+	}
+	vector<thread> workers;
+	vector<exception_ptr> errors(threads);
+	for (unsigned int t = 0; t < threads; ++t) {
+		workers.emplace_back([&, t]() {
+			try {
+				work();
+			} catch (...) {
+				errors[t] = current_exception();
+			}
+		});
+	}
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	for (auto& error : errors) {
+		if (error) {
+			rethrow_exception(error);
 		}
-		genotypes->push_back(genotype);
-		genotype_likelihoods->push_back(distribution);
-// 		cerr << "  --> GT=" << genotype << ", GL=" << distribution << endl;
-		++column_index;
 	}
-	assert(genotypes->size() == positions->size());
-	delete positions;
 }
 
 void compute_polyploid_genotypes(const ReadSet& readset, size_t ploidy, std::vector<Genotype>* genotypes, std::vector<unsigned int>* positions){
@@ -61,15 +168,23 @@ void compute_polyploid_genotypes(const ReadSet& readset, size_t ploidy, std::vec
 		positions = readset.get_positions();
 		assert(positions != nullptr);
 	}
-	ColumnIterator column_iterator(readset, positions);
-	size_t column_index = 0;
-	while (column_iterator.has_next()) {
-		column_index += 1;
-		std::unique_ptr<std::vector<const Entry*> > column = column_iterator.get_next();
+
+	// genotypes with 0, ..., ploidy alternative alleles
+	vector<Genotype> genotype_table;
+	for (size_t num_alts = 0; num_alts <= ploidy; ++num_alts) {
+		std::vector<uint32_t> geno_alleles(num_alts, 1);
+		geno_alleles.resize(ploidy, 0);
+		genotype_table.push_back(Genotype(geno_alleles));
+	}
+
+	PackedColumns columns(readset, positions);
+	genotypes->reserve(columns.get_column_count());
+	for (size_t column_index = 0; column_index < columns.get_column_count(); ++column_index) {
+		PackedColumn column = columns.get_column(column_index);
 		size_t ref_count = 0;
 		size_t alt_count = 0;
-		for (const Entry* e : *column) {
-			switch (e->get_allele_type()){
+		for (size_t i = 0; i < column.size(); ++i) {
+			switch (column.get_allele_type(i)){
 				case Entry::REF_ALLELE:
 					ref_count += 1;
 					break;
@@ -81,7 +196,7 @@ void compute_polyploid_genotypes(const ReadSet& readset, size_t ploidy, std::vec
 			}
 		}
 		// TODO: Respect genotype likelihoods
-		
+
 		// determine the genotype
 		size_t total_alleles = ref_count + alt_count;
 		if (total_alleles == 0) {
@@ -89,21 +204,10 @@ void compute_polyploid_genotypes(const ReadSet& readset, size_t ploidy, std::vec
 		} else {
 			double alt_frac = alt_count / (double) (total_alleles);
 			uint32_t num_alts = (uint32_t)(ploidy*alt_frac+1/(2*ploidy));
-			
-			std::vector<uint32_t> geno_alleles;
-			for (size_t j = 0; j < num_alts; ++j){
-				geno_alleles.push_back(1);
-			}
-			for (size_t j = num_alts; j < ploidy; ++j){
-				geno_alleles.push_back(0);
-			}
-			
-			assert(geno_alleles.size() == ploidy);
-			Genotype genotype(geno_alleles);
-			genotypes->push_back(genotype);
+			assert(num_alts <= ploidy);
+			genotypes->push_back(genotype_table[num_alts]);
 		}
 	}
-	cout << genotypes->size() << " " << positions->size() << column_index << endl;
 	assert(genotypes->size() == positions->size());
 	delete positions;
 }
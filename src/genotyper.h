@@ -13,6 +13,18 @@
  */
 void compute_genotypes(const ReadSet& readset, std::vector<Genotype>* genotypes, std::vector<GenotypeDistribution>* genotype_likelihoods, std::vector<unsigned int>* positions = nullptr);
 
+/** Computes genotypes and genotype likelihoods for several read sets (e.g. one per sample) at the same
+ *  positions, as done by compute_genotypes for each of them. Read sets are processed in parallel.
+ *  @param readsets Read sets to genotype; they are not modified. Each must be sorted.
+ *  @param genotype_likelihoods Resized to readsets.size() * positions.size() * 3. The probability of
+ *                              genotype g (0/0, 0/1, 1/1) at position j for read set i is stored at
+ *                              index (i * positions.size() + j) * 3 + g.
+ *  @param genotypes If not null, resized to readsets.size() * positions.size(); the genotype at position j
+ *                   for read set i is stored at index i * positions.size() + j.
+ *  @param threads Number of threads. Results do not depend on it.
+ */
+void compute_genotypes_batch(const std::vector<ReadSet*>& readsets, const std::vector<unsigned int>& positions, std::vector<double>* genotype_likelihoods, std::vector<Genotype>* genotypes = nullptr, unsigned int threads = 1);
+
 
 /** Uses a simple genotyping procedure to re-type polyploid variants based on the fraction of ref/alt alleles present.
  * @param genotypes Vector is cleared and one value from {0,...,ploidy} is added for each variant in the readset.
@@ -6,38 +6,33 @@
 
 using namespace std;
 
-GrayCodes::GrayCodes(int length) {
-	//cout << "length is : " << length << endl;
-	//cout << "max is : " << numeric_limits<GrayCodes::int_t>::digits << endl;
+GrayCodes::GrayCodes(int length) : GrayCodes(length, 0, ((uint64_t)1) << length) {
+}
+
+
+GrayCodes::GrayCodes(int length, uint64_t first_rank, uint64_t end_rank) {
 	assert(length <= numeric_limits<GrayCodes::int_t>::digits);
+	assert(first_rank <= end_rank);
+	assert(end_rank <= (((uint64_t)1) << length));
 	this->length = length;
-	this->s = ~((int_t)0);
-	this->c = 0;
-	this->i = -1;
-	this->changed_bit = -1;
+	this->first_rank = first_rank;
+	this->end_rank = end_rank;
+	this->next_rank = first_rank;
 }
 
 
 bool GrayCodes::has_next() {
-	return i < length;
+	return next_rank < end_rank;
 }
 
 
 GrayCodes::int_t GrayCodes::get_next(int* changed_bit) {
-	GrayCodes::int_t result = c;
+	assert(has_next());
+	uint64_t k = next_rank;
 	if (changed_bit != 0) {
-		*changed_bit = this->changed_bit;
+		*changed_bit = (k == first_rank) ? -1 : __builtin_ctzll(k);
 	}
-	i = 0;
-	while (i<length) {
-		int_t mask = ((GrayCodes::int_t)1) << i;
-		if (((c&mask) ^ (s&mask)) != 0) {
-			c = c ^ mask;
-			this->changed_bit = i;
-			break;
-		}
-		s = s ^ mask;
-		i += 1;
-	}
-	return result;
+	next_rank += 1;
+	return (GrayCodes::int_t)(k ^ (k >> 1));
 }
+
@@ -2,9 +2,14 @@
 #define GRAYCODES_H
 
 #include <iostream>
+#include <cstdint>
 
-/** A class to generate Gray codes. 
-  * Implementation is based on
+/** A class to generate (binary reflected) Gray codes.
+  * The k-th Gray code is given by k^(k>>1) and the bit that changes between
+  * the (k-1)-th and the k-th code is the lowest set bit of k. This closed form
+  * allows to generate any contiguous subrange of the sequence, which is used to
+  * split a DP column into independent chunks. The full sequence is identical
+  * to the one generated by the algorithm from
   * "An Algorithm for Gray Codes", S. Mossige, Computing (18), pp. 89-92, 1977.
   */
 class GrayCodes {
@@ -13,19 +18,22 @@ class GrayCodes {
 
 		GrayCodes(int length);
 
+		/** Generate the subsequence of Gray codes with ranks first_rank, ..., end_rank-1. */
+		GrayCodes(int length, uint64_t first_rank, uint64_t end_rank);
+
 		bool has_next();
 
 		/** Return the next Gray code.
 		  * @param changed_bit If not null, the index of the changed bit is
-		  *                    returned via this variable.
+		  *                    returned via this variable. For the first code
+		  *                    of a (sub)sequence, -1 is returned.
 		  */
 		int_t get_next(int* changed_bit = 0);
 	private:
 		int length;
-		int i;
-		int_t s;
-		int_t c;
-		int changed_bit;
+		uint64_t first_rank;
+		uint64_t end_rank;
+		uint64_t next_rank;
 };
 
 #endif
@@ -0,0 +1,146 @@
+/*
+
+  Distributed under the MIT license.
+
+  You should have received a copy of the MIT license along with this
+  program.
+
+*/
+
+#include <cassert>
+
+#include "backtracetable.h"
+
+using namespace std;
+
+// layout of an entry: back index in bits 0-31, jump + 1 in bits 32-61,
+// the flags in bits 62 and 63 (the empty entry is 0, i.e., jump is -1)
+#define JUMP_SHIFT 32
+#define JUMP_MASK ((uint64_t(1) << 30) - 1)
+#define HAPLOTYPES_BIT (uint64_t(1) << 62)
+#define NEW_BLOCK_BIT (uint64_t(1) << 63)
+
+
+void BacktraceTable::add_column(const Counter j, const vector<Counter> & sizes) {
+
+  if(has_column(j))
+    return;
+
+  if(columns_.empty())
+    first_ = j;
+  assert(j == first_ + columns_.size());
+
+  columns_.push_back(column_t());
+  column_t & col = columns_.back();
+  col.offsets.resize(sizes.size() + 1, 0);
+  for(size_t q = 0; q < sizes.size(); ++q) {
+    col.offsets[q + 1] = col.offsets[q] + sizes[q];
+  }
+  col.entries.resize(col.offsets.back(), 0);
+}
+
+
+bool BacktraceTable::has_column(const Counter j) const {
+
+  return !columns_.empty() && (j >= first_) && (j < first_ + columns_.size());
+}
+
+
+Counter BacktraceTable::distances(const Counter j) const {
+
+  return column(j).offsets.size() - 1;
+}
+
+
+Counter BacktraceTable::size(const Counter j, const Counter q) const {
+
+  const column_t & col = column(j);
+  assert(q + 1 < col.offsets.size());
+  return col.offsets[q + 1] - col.offsets[q];
+}
+
+
+void BacktraceTable::resize(const Counter j, const Counter q, const Counter size) {
+
+  column_t & col = columns_[j - first_];
+  const Counter old_size = this->size(j, q);
+  if(size <= old_size)
+    return;
+
+  col.entries.insert(col.entries.begin() + col.offsets[q + 1], size - old_size, 0);
+  for(size_t i = q + 1; i < col.offsets.size(); ++i) {
+    col.offsets[i] += size - old_size;
+  }
+}
+
+
+void BacktraceTable::set(const Counter j, const Counter q, const Counter index,
+			 const Pointer jump, const Counter back_index,
+			 const bool haplotypes, const bool new_block) {
+
+  assert(index < size(j, q));
+  assert(((uint64_t)(jump + 1) & ~JUMP_MASK) == 0);
+
+  column_t & col = columns_[j - first_];
+  col.entries[col.offsets[q] + index] =
+    (uint64_t)back_index |
+    ((uint64_t)(jump + 1) << JUMP_SHIFT) |
+    (haplotypes ? HAPLOTYPES_BIT : 0) |
+    (new_block ? NEW_BLOCK_BIT : 0);
+}
+
+
+Backtrace1 BacktraceTable::get(const Counter j, const Counter q, const Counter index) const {
+
+  const uint64_t e = entry(j, q, index);
+  Backtrace1 back;
+  back.jump = (Pointer)((e >> JUMP_SHIFT) & JUMP_MASK) - 1;
+  back.index = (Counter)(e & 0xFFFFFFFFu);
+  return back;
+}
+
+
+bool BacktraceTable::get_haplotypes(const Counter j, const Counter q, const Counter index) const {
+
+  return (entry(j, q, index) & HAPLOTYPES_BIT) != 0;
+}
+
+
+bool BacktraceTable::get_new_block(const Counter j, const Counter q, const Counter index) const {
+
+  return (entry(j, q, index) & NEW_BLOCK_BIT) != 0;
+}
+
+
+void BacktraceTable::remove_before(const Counter j) {
+
+  while(!columns_.empty() && first_ < j) {
+    columns_.pop_front();
+    ++first_;
+  }
+}
+
+
+size_t BacktraceTable::get_memory() const {
+
+  size_t memory = 0;
+  for(deque<column_t>::const_iterator it = columns_.begin(); it != columns_.end(); ++it) {
+    memory += it->entries.size() * sizeof(uint64_t);
+  }
+  return memory;
+}
+
+
+const BacktraceTable::column_t & BacktraceTable::column(const Counter j) const {
+
+  assert(has_column(j));
+  return columns_[j - first_];
+}
+
+
+uint64_t BacktraceTable::entry(const Counter j, const Counter q, const Counter index) const {
+
+  assert(index < size(j, q));
+  const column_t & col = column(j);
+  return col.entries[col.offsets[q] + index];
+}
@@ -0,0 +1,77 @@
+/*
+
+  Distributed under the MIT license.
+
+  You should have received a copy of the MIT license along with this
+  program.
+
+*/
+
+#ifndef _BACKTRACE_TABLE_H_
+#define _BACKTRACE_TABLE_H_
+
+#include <deque>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+#include "basictypes.h"
+
+// Backtrace entries of the HapChat DP for a range of consecutive columns.
+// For column j, distance q (to the next heterozygous column) and the index
+// of a mask, an entry holds the jump to the previous heterozygous column,
+// the index of its mask and two flags (haplotypes, new block), packed into
+// a single 64-bit word. The entries of a column are stored contiguously.
+class BacktraceTable {
+
+ public :
+
+  // adds column j, which must follow the last column (or be the first),
+  // with sizes[q] empty entries for distance q; does nothing if the
+  // column is already present
+  void add_column(const Counter j, const std::vector<Counter> & sizes);
+
+  // whether column j is present
+  bool has_column(const Counter j) const;
+
+  // number of distances of column j
+  Counter distances(const Counter j) const;
+
+  // number of entries of column j for distance q
+  Counter size(const Counter j, const Counter q) const;
+
+  // grows the entries of column j for distance q to the given size
+  void resize(const Counter j, const Counter q, const Counter size);
+
+  void set(const Counter j, const Counter q, const Counter index,
+	   const Pointer jump, const Counter back_index,
+	   const bool haplotypes, const bool new_block);
+
+  Backtrace1 get(const Counter j, const Counter q, const Counter index) const;
+  bool get_haplotypes(const Counter j, const Counter q, const Counter index) const;
+  bool get_new_block(const Counter j, const Counter q, const Counter index) const;
+
+  // removes all columns before column j
+  void remove_before(const Counter j);
+
+  // number of bytes used by the entries
+  size_t get_memory() const;
+
+ private :
+
+  struct column_t {
+    // entries for distance q start at offsets[q] (one more offset than distances)
+    std::vector<size_t> offsets;
+    std::vector<uint64_t> entries;
+  };
+
+  // column first_ is columns_[0]
+  Counter first_;
+  std::deque<column_t> columns_;
+
+  const column_t & column(const Counter j) const;
+  uint64_t entry(const Counter j, const Counter q, const Counter index) const;
+
+};
+
+#endif // _BACKTRACE_TABLE_H_
@@ -15,10 +15,12 @@
 using namespace std;
 
 
-BalancedCombinations::BalancedCombinations() : generator() {}
+template <typename BitColumn>
+BalancedCombinations<BitColumn>::BalancedCombinations() : generator() {}
 
 
-void BalancedCombinations::initialize(const Counter n, const Counter k,
+template <typename BitColumn>
+void BalancedCombinations<BitColumn>::initialize(const Counter n, const Counter k,
 				      const BitColumn & col, const double r) {
 
   n_ = n;
@@ -52,13 +54,15 @@ void BalancedCombinations::initialize(const Counter n, const Counter k,
 }
 
 
-bool BalancedCombinations::has_next() {
+template <typename BitColumn>
+bool BalancedCombinations<BitColumn>::has_next() {
 
   return has_next_;
 }
 
 
-void BalancedCombinations::next() {
+template <typename BitColumn>
+void BalancedCombinations<BitColumn>::next() {
 
   make_current();
   s_ = false;
@@ -66,7 +70,8 @@ void BalancedCombinations::next() {
 }
 
 
-void BalancedCombinations::get_combination(BitColumn & result) {
+template <typename BitColumn>
+void BalancedCombinations<BitColumn>::get_combination(BitColumn & result) {
 
   result.reset();
   result |= current_;
@@ -77,7 +82,8 @@ void BalancedCombinations::get_combination(BitColumn & result) {
 /**********************************************************************/
 
 
-void BalancedCombinations::build_mapping() {
+template <typename BitColumn>
+void BalancedCombinations<BitColumn>::build_mapping() {
 
   map.clear();
   map.resize(2);
@@ -91,7 +97,8 @@ void BalancedCombinations::build_mapping() {
 }
 
 
-void BalancedCombinations::initialize_arrays() {
+template <typename BitColumn>
+void BalancedCombinations<BitColumn>::initialize_arrays() {
 
   c.clear();
 
@@ -107,7 +114,8 @@ void BalancedCombinations::initialize_arrays() {
 }
 
 
-void BalancedCombinations::retrieve_c0() {
+template <typename BitColumn>
+void BalancedCombinations<BitColumn>::retrieve_c0() {
 
   if(c[0][i_].empty()) {
 
@@ -123,7 +131,8 @@ void BalancedCombinations::retrieve_c0() {
 }
 
 
-void BalancedCombinations::retrieve_c1() {
+template <typename BitColumn>
+void BalancedCombinations<BitColumn>::retrieve_c1() {
 
   if(c[1][j_].empty()) {
 
@@ -139,7 +148,8 @@ void BalancedCombinations::retrieve_c1() {
 }
 
 
-void BalancedCombinations::make_current() {
+template <typename BitColumn>
+void BalancedCombinations<BitColumn>::make_current() {
 
   current_.reset();
 
@@ -155,7 +165,8 @@ void BalancedCombinations::make_current() {
 }
 
 
-void BalancedCombinations::try_next() {
+template <typename BitColumn>
+void BalancedCombinations<BitColumn>::try_next() {
 
   // loop with switch, advancing exactly once each call to function
   while(t_ <= k_) {
@@ -195,3 +206,8 @@ void BalancedCombinations::try_next() {
 
   has_next_ = false; // the end
 }
+
+
+template class BalancedCombinations<BitColumn64>;
+template class BalancedCombinations<BitColumn128>;
+template class BalancedCombinations<BitColumn256>;
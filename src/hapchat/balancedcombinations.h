@@ -15,6 +15,7 @@
 #include "basictypes.h"
 #include "combinations.h"
 
+template <typename BitColumn>
 class BalancedCombinations {
 
  public :
@@ -63,7 +64,7 @@ class BalancedCombinations {
   void initialize_arrays();
 
   // retrieve a C_B0, C_B1 array (building it should it be empty)
-  Combinations generator;
+  Combinations<BitColumn> generator;
   BitColumn comb;
   void retrieve_c0();
   void retrieve_c1();
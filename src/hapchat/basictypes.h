@@ -17,11 +17,15 @@
 #include <vector>
 #include <iostream>
 #include <limits>
+#include <cstddef>
+#include <strings.h>
 
 #include "../entry.h"
 #include "../readset.h"
 
-#define MAX_COVERAGE 64
+// Columns are represented by bit columns of 64, 128 or 256 bits,
+// whichever is the smallest that fits the coverage of a block
+#define MAX_COVERAGE 256
 #define MAX_CORRECTIONS 63
 
 typedef unsigned int Counter;
@@ -29,7 +33,9 @@ typedef unsigned int Counter;
 #define MAX_COUNTER std::numeric_limits<Counter>::max()
 
 typedef int Pointer;
-typedef std::bitset<MAX_COVERAGE> BitColumn;
+typedef std::bitset<64> BitColumn64;
+typedef std::bitset<128> BitColumn128;
+typedef std::bitset<256> BitColumn256;
 typedef std::vector<Entry> Column;
 typedef std::vector<Column> Block;
 
@@ -52,6 +58,27 @@ struct EntryRead {
 typedef std::vector<EntryRead> Fragment;
 
 
+// Position (starting from 1) of the lowest set bit of a bit column,
+// or 0 if no bit is set (as ffsl for a single word)
+template <size_t N>
+inline int first_set_bit(const std::bitset<N> &column)
+{
+  const std::bitset<N> word(std::numeric_limits<unsigned long long>::max());
+  for(size_t shift = 0; shift < N; shift += 64) {
+    const unsigned long long bits = ((column >> shift) & word).to_ullong();
+    if(bits != 0)
+      return shift + ffsll(bits);
+  }
+  return 0;
+}
+
+inline int first_set_bit(const BitColumn64 &column)
+{
+  return ffsl(column.to_ulong());
+}
+
+
+template <typename BitColumn>
 struct constants_t
 {
 
@@ -9,11 +9,17 @@
 
 */
 
+#include <mutex>
+
 #include "binomialcoefficient.h"
 
 std::vector<std::vector<unsigned int> > BinomialCoefficient::btable;
 std::vector<std::vector<unsigned int> > BinomialCoefficient::ctable;
 
+namespace {
+  std::once_flag tables_initialized;
+}
+
 void
 BinomialCoefficient::initialize_binomial_coefficients(const unsigned int n,
                                               const unsigned int k) {
@@ -34,41 +40,13 @@ BinomialCoefficient::initialize_binomial_coefficients(const unsigned int n,
   ctable.resize(n+1, std::vector<unsigned int>(n + 1, 0));
   for (unsigned int i = 0; i <= n; i++) {
     for (unsigned int j = 0; j <= k; j++) {
-      for(unsigned int x = 0; x <= j; x++) {
-        ctable[i][j] += btable[i][x];
-      }
+      ctable[i][j] = btable[i][j] + ((j > 0) ? ctable[i][j - 1] : 0);
     }
   }
 }
 
 
-unsigned int BinomialCoefficient::indexof(std::bitset<MAX_COVERAGE> comb) {
-
-  int k = 0;
-  int c_k = 0;
-  int temp = 0;
-  int result = 0;
-
-  while(comb.any()) {
-    temp = ffsl(comb.to_ulong());
-    c_k += temp;
-    k++;
-    result += BinomialCoefficient::binomial_coefficient(c_k - 1, k);
-    comb >>= (temp);
-  }
-
-  return result;
-}
-
-
-unsigned int BinomialCoefficient::cumulative_indexof(std::bitset<MAX_COVERAGE> comb, const unsigned int n_elements) {
-
-  unsigned int k = comb.count();
-  unsigned int result = indexof(comb);
-
-  for(unsigned int i = 0; i < k; i++) {
-    result += BinomialCoefficient::binomial_coefficient(n_elements, i);
-  }
+void BinomialCoefficient::initialize() {
 
-  return result;
+  std::call_once(tables_initialized, initialize_binomial_coefficients, MAX_COVERAGE, MAX_COVERAGE);
 }
@@ -28,6 +28,10 @@ class BinomialCoefficient {
   static void
     initialize_binomial_coefficients(const unsigned int n, const unsigned int k);
 
+  // fills the tables for up to MAX_COVERAGE elements once per process,
+  // such that they can be shared by HapChat instances in several threads
+  static void initialize();
+
 //Note: if k > n the result is equal to 0
   static unsigned int
     binomial_coefficient(const unsigned int n, const unsigned int k) {
@@ -41,10 +45,38 @@ class BinomialCoefficient {
   }
 
   // index of comb in the binomial coefficients
-  static unsigned int indexof(std::bitset<MAX_COVERAGE> comb);
+  template <size_t N>
+  static unsigned int indexof(std::bitset<N> comb) {
+
+    int k = 0;
+    int c_k = 0;
+    int temp = 0;
+    int result = 0;
+
+    while(comb.any()) {
+      temp = first_set_bit(comb);
+      c_k += temp;
+      k++;
+      result += BinomialCoefficient::binomial_coefficient(c_k - 1, k);
+      comb >>= (temp);
+    }
+
+    return result;
+  }
 
   // index of comb in the cumulative binomial coeffients
-  static unsigned int cumulative_indexof(std::bitset<MAX_COVERAGE> comb, const unsigned int n_elements);
+  template <size_t N>
+  static unsigned int cumulative_indexof(std::bitset<N> comb, const unsigned int n_elements) {
+
+    unsigned int k = comb.count();
+    unsigned int result = indexof(comb);
+
+    for(unsigned int i = 0; i < k; i++) {
+      result += BinomialCoefficient::binomial_coefficient(n_elements, i);
+    }
+
+    return result;
+  }
 
 };
 
@@ -23,6 +23,9 @@
 
 using namespace std;
 
+// Enumerates combinations as bit columns (one of the BitColumn types of
+// basictypes.h)
+template <typename BitColumn>
 class Combinations {
 
 public:
@@ -105,7 +108,7 @@ public:
   }
 
 
-  void get_combination(bitset<MAX_COVERAGE> &result)
+  void get_combination(BitColumn &result)
   {
     result.reset();
     result |= this->result;
@@ -118,7 +121,7 @@ public:
   }
 
 
-  unsigned int indexof(bitset<MAX_COVERAGE> comb)
+  unsigned int indexof(BitColumn comb)
   {
     int k = 0;
     int c_k = 0;
@@ -127,7 +130,7 @@ public:
     //binomial_coefficient(32, 32);
     while(comb.any())
       {
-        temp = ffsl(comb.to_ulong());
+        temp = first_set_bit(comb);
         c_k += temp;
         k++;
         result += BinomialCoefficient::binomial_coefficient(c_k - 1, k);
@@ -139,7 +142,7 @@ public:
   }
 
 
-  unsigned int cumulative_indexof(bitset<MAX_COVERAGE> comb, const unsigned int n_elements)
+  unsigned int cumulative_indexof(BitColumn comb, const unsigned int n_elements)
   {
     unsigned int k = comb.count();
     unsigned int result = indexof(comb);
@@ -152,7 +155,7 @@ public:
 
 
   void combinationof(const unsigned int index, const unsigned int n_elements,
-                     const unsigned int k, bitset<MAX_COVERAGE> &result)
+                     const unsigned int k, BitColumn &result)
   {
     unsigned int iterator = n_elements - 1;
     unsigned int counter = k;
@@ -174,7 +177,7 @@ public:
 
 
   void cumulative_combinationof(const unsigned int index, const unsigned int n_elements,
-                                const unsigned int max_k, bitset<MAX_COVERAGE> &result)
+                                const unsigned int max_k, BitColumn &result)
   {
     unsigned int position = BinomialCoefficient::binomial_coefficient(n_elements, 0);
     int counter = max_k - 1;
@@ -193,7 +196,7 @@ public:
   }
 
 
-  void start_from(bitset<MAX_COVERAGE> comb, const unsigned int n_elements)
+  void start_from(BitColumn comb, const unsigned int n_elements)
   {
     int counter = 0;
     int sum = 0;
@@ -205,7 +208,7 @@ public:
           
     while(comb.any())
       {
-        temp = ffsl(comb.to_ulong());
+        temp = first_set_bit(comb);
         sum += temp;
         comb>>=(temp);
         this->combination[counter] = sum - 1;
@@ -233,7 +236,7 @@ public:
   }
 
 
-  void cumulative_start_from(bitset<MAX_COVERAGE> comb, const unsigned int n_elements, 
+  void cumulative_start_from(BitColumn comb, const unsigned int n_elements, 
                              const unsigned int max_k)
   {
     start_from(comb, n_elements);
@@ -261,8 +264,8 @@ private:
   unsigned int count;
   bool end; 
   vector<int> combination;
-  bitset<MAX_COVERAGE> result;
-  bitset<MAX_COVERAGE> ending_mask;
+  BitColumn result;
+  BitColumn ending_mask;
   int j;
   int x;
   bool cumulative;
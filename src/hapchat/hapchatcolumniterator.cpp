@@ -18,10 +18,11 @@
 #include <fstream>
 #include <vector>
 #include <ios>
+#include <memory>
 
 //include Readset/HapChat libraries
 #include "../readset.h"
-#include "../columniterator.h"
+#include "../packedcolumns.h"
 #include "basictypes.h"
 #include "../entry.h"
 
@@ -36,7 +37,10 @@ class HapChatColumnIterator {
 
 private: 
 
-  ColumnIterator* iterator;
+  // columns of the current block, shared between copies of this iterator
+  shared_ptr<PackedColumns> columns;
+  // index of the next column to be returned
+  unsigned int next_column;
   bool end;
   blocker vblock;
   unsigned int blockn;
@@ -48,7 +52,8 @@ public:
   //standard constructor
   HapChatColumnIterator(ReadSet* read_set){
     readset=read_set;
-    iterator=new ColumnIterator(*readset);
+    columns=make_shared<PackedColumns>(*readset);
+    next_column=0;
     end=false;
     vblock=blocker();
     set_block(readset);
@@ -61,7 +66,7 @@ public:
     blockn=-1;
     bool overflag;
     unsigned int readn;
-    readn=iterator->get_read_count();
+    readn=columns->get_read_count();
     unsigned int minn,maxx;
 
     for(unsigned int i=0;i<readn;i++){
@@ -115,7 +120,8 @@ public:
 
     readset->reassignReadIds();
     readset->sort();
-    this->iterator=new ColumnIterator(*readset);
+    this->columns=make_shared<PackedColumns>(*readset);
+    this->next_column=0;
     return true;
   }
 
@@ -124,15 +130,12 @@ public:
   Column get_column(){
 
     if(has_next()){
-      unique_ptr<vector<const Entry *> > next;
-      //if(iterator->it.has_next()) { cout <<"has next" << endl; } // sanity check
-			
-      next= iterator->get_next();
-      vector<const Entry*>* p=next.release();
+      PackedColumn next=columns->get_column(next_column++);
       Column column;
-      
-      for(unsigned int i=0;i<p->size();i++){
-	column.push_back(*p->at(i));
+      column.reserve(next.size());
+
+      for(unsigned int i=0;i<next.size();i++){
+	column.emplace_back(next.get_read_id(i), next.get_allele_type(i), next.get_phred_score(i));
       }
 
       return column;
@@ -146,14 +149,14 @@ public:
   //return true if there is other column
   bool has_next(){
 
-    return iterator->has_next();
+    return next_column<columns->get_column_count();
   }
 
 
   //set the pointer to the first column
   void reset(){
 
-    iterator->jump_to_column(0);
+    next_column=0;
     end=false;
   }
 
@@ -172,14 +175,25 @@ public:
 	
   const vector <unsigned int> get_positions(){
 
-    iterator=new ColumnIterator(*readset);
-    return *iterator->get_positions();
+    unique_ptr<vector<unsigned int> > positions(readset->get_positions());
+    return *positions;
   }
 
 
   unsigned int column_count(){
 
-    return iterator->get_column_count();    
+    return columns->get_column_count();    
+  }
+
+
+  //return the largest number of entries in a column of the current block
+  unsigned int max_coverage(){
+
+    size_t coverage=0;
+    for(unsigned int i=0;i<columns->get_column_count();i++){
+      coverage=std::max(coverage,columns->get_column(i).size());
+    }
+    return coverage;
   }
 
 
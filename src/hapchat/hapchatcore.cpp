@@ -19,11 +19,14 @@
 #include <cassert>
 #include <iostream>
 #include <stdexcept>
+#include <functional>
+#include <utility>
 
 #include "basictypes.h"
 #include "binomialcoefficient.h"
 #include "combinations.h"
 #include "balancedcombinations.h"
+#include "backtracetable.h"
 #include "hapchatcolumniterator.cpp"
 
 // Log messages with DEBUG priority and higher
@@ -32,6 +35,51 @@
 // Include log facilities. It should the last include!!
 #include "log.h"
 
+// State of the DP that is needed to compute the next column: the last
+// columns of the input and their costs. A copy is a checkpoint from
+// which the DP can be resumed.
+template <typename BitColumn>
+struct dp_window_t {
+
+  HapChatColumnIterator hap;
+  vector<Column> input;
+  Pointer input_pointer;
+  vector<vector<Pointer> > back_indexer;
+  vector<vector<Pointer> > forw_indexer;
+  vector<BitColumn> pos_gaps;
+  vector<Counter> num_pos_gaps;
+  vector<Counter> k_j;
+  vector<Counter> homo_cost;
+  vector<Cost> homo_weight;
+  vector<vector<vector<Cost> > > prevision;
+  Pointer prevision_pointer;
+  vector<Cost> OPT;
+  Pointer OPT_pointer;
+  Counter step;
+  double k_j_inc;
+  bool re_run_k;
+  bool solution_existence;
+  Counter cov_j;
+
+  dp_window_t(const HapChatColumnIterator &hap)
+    : hap(hap), input_pointer(0), prevision_pointer(0), OPT_pointer(0), step(0),
+      k_j_inc(0), re_run_k(false), solution_existence(true), cov_j(0) { }
+};
+
+// Results of the DP for each column that are needed by the backtrace
+struct dp_columns_t {
+
+  vector<bool> is_homozygous;
+  vector<bool> homo_haplotypes;
+  vector<Backtrace1> best_heterozygous1;
+  vector<bool> best_heterozygous2_haplotypes;
+  vector<bool> best_heterozygous2_new_block;
+
+  dp_columns_t(const Counter num_col)
+    : is_homozygous(num_col), homo_haplotypes(num_col), best_heterozygous1(num_col),
+      best_heterozygous2_haplotypes(num_col), best_heterozygous2_new_block(num_col) { }
+};
+
 class HapChatCore{
 
 private:
@@ -50,6 +98,9 @@ private:
   unsigned int balancecov_;
   double balanceratio_;
 
+  // number of corrections allowed in a column, by coverage
+  vector<Counter> ks_;
+
 public:	
 
   HapChatCore(ReadSet* read_set)
@@ -118,8 +169,6 @@ void run_core()
 
   //Counter threshold_coverage = 30;
 
-  const constants_t constants;
-  
   INFO("Parameters:");
   INFO("Discard weights? " << (unweighted_?"True":"False"));
   INFO("Error rate: " << errorrate_);
@@ -137,8 +186,8 @@ void run_core()
   //Initializing the starting parameters: no competitive section
 
   //Pre-compute binomial values
-  BinomialCoefficient::initialize_binomial_coefficients(MAX_COVERAGE, MAX_COVERAGE);
-  computeK(MAX_COVERAGE, alpha_, errorrate_);
+  BinomialCoefficient::initialize();
+  initialize_k();
 
   Counter step = 0;
   Cost OPT = 0;
@@ -157,8 +206,20 @@ void run_core()
   vector<bool> haplotype1(hap.column_count());
   vector<bool> haplotype2(hap.column_count());
 
-  if(hap.column_count() > 0)
-    dp(constants, haplotype1, haplotype2, step, OPT, MAX_COV, MAX_L, MAX_K, MAX_GAPS, hap);
+  //The bit columns need to hold the largest column of the block
+  if(hap.column_count() > 0) {
+    const Counter coverage = hap.max_coverage();
+    INFO("Maximum coverage: " << coverage);
+    if(coverage <= 64) {
+      dp(constants_t<BitColumn64>(), haplotype1, haplotype2, step, OPT, MAX_COV, MAX_L, MAX_K, MAX_GAPS, hap);
+    } else if(coverage <= 128) {
+      dp(constants_t<BitColumn128>(), haplotype1, haplotype2, step, OPT, MAX_COV, MAX_L, MAX_K, MAX_GAPS, hap);
+    } else if(coverage <= MAX_COVERAGE) {
+      dp(constants_t<BitColumn256>(), haplotype1, haplotype2, step, OPT, MAX_COV, MAX_L, MAX_K, MAX_GAPS, hap);
+    } else {
+      throw std::runtime_error("HapChat supports a coverage of at most " + std::to_string(MAX_COVERAGE) + ", but found a column with coverage " + std::to_string(coverage));
+    }
+  }
 
   counter_columns = hap.column_count();
 
@@ -209,12 +270,14 @@ bool check_end(HapChatColumnIterator hap, const vector<Column> &input, const Poi
 }
 
  
-void complement_mask(BitColumn &mask, const Counter &length, const constants_t &constants)
+template <typename BitColumn>
+void complement_mask(BitColumn &mask, const Counter &length, const constants_t<BitColumn> &constants)
 {
   mask ^= (constants.ones<<length).flip();
 }
 
  
+template <typename BitColumn>
 string column_to_string(const BitColumn &mask, const unsigned int &len) {
   string str = mask.to_string();
   reverse(str.begin(), str.end());
@@ -299,7 +362,8 @@ void write_haplotypes(const vector<vector<char> > &haplotype_blocks1, const vect
 }
 
 
-void dp(const constants_t &constants,
+template <typename BitColumn>
+void dp(const constants_t<BitColumn> &constants,
         vector<bool> &haplotype1, vector<bool> &haplotype2, Counter &step_global, Cost &OPT_global,
         Counter &MAX_COV_global, Counter &MAX_L_global, Counter &MAX_K_global,
         Counter &MAX_GAPS_global, HapChatColumnIterator hap)
@@ -330,67 +394,148 @@ void dp(const constants_t &constants,
   //.:: ALLOCATION MEMORY
 
   DEBUG(">> Starting allocation of memory");
+  dp_columns_t columns(num_col);
+  dp_window_t<BitColumn> window(hap);
+  initialize_window(window, columns, MAX_COV, MAX_L, MAX_K, sum_successive_L);
+
+  //The backtrace entries are only kept from the last checkpoint on. The
+  //window is saved every sqrt(num_col) columns, from which the entries
+  //of earlier columns are recomputed (once) during the backtrace.
+  const Counter interval = max(static_cast<Counter>(sqrt(num_col)), static_cast<Counter>(1));
+  vector<pair<dp_window_t<BitColumn>, BacktraceTable> > checkpoints;
+  BacktraceTable backtrace;
+  backtrace.add_column(0, scheme_backtrace[0]);
+  checkpoints.push_back(make_pair(window, backtrace));
+
+  DEBUG(">> Completed allocation of memory");
+
+  //DP
+
+  forward(constants, window, backtrace, columns, scheme_backtrace, MAX_L, num_col, interval,
+          &checkpoints, step_global);
+
+  if(window.solution_existence) {
+    DEBUG("*** SUCCESS ***");
+    DEBUG("> Optimal block cost:  " << window.OPT[window.OPT_pointer]);
+    OPT_global += window.OPT[window.OPT_pointer];
+    DEBUG("===> Optimal global cost:  " << OPT_global);
+
+    //Columns up to segment_end are recomputed from the checkpoint before them
+    Counter segment_end = (checkpoints.size() - 1) * interval;
+    std::function<const BacktraceTable&(Counter)> backtrace_of = [&](Counter j) -> const BacktraceTable& {
+      if(j <= segment_end) {
+        const size_t i = (j - 1) / interval;
+        window = checkpoints[i].first;
+        backtrace = checkpoints[i].second;
+        checkpoints.erase(checkpoints.begin() + i + 1, checkpoints.end());
+        Counter step_recomputed = window.step;
+        forward(constants, window, backtrace, columns, scheme_backtrace, MAX_L, (i + 1) * interval,
+                interval, static_cast<vector<pair<dp_window_t<BitColumn>, BacktraceTable> >*>(NULL),
+                step_recomputed);
+        segment_end = i * interval;
+      }
+      return backtrace;
+    };
+
+    reconstruct_haplotypes(num_col, columns, backtrace_of, haplotype1, haplotype2);
+
+  } else {
+    INFO("*** NO SOLUTION ***");
+    INFO("<<>> No feasible solution exists with these parameters -- alpha = " << alpha_ << " and error rate = " << errorrate_);
+    INFO("<<>> The last not feasible column is:  " << window.step << "  with coverage = " << window.cov_j << " and k = " << window.k_j[window.input_pointer]);
+    throw std::runtime_error("HapChat found no feasible solution for column " + std::to_string(window.step) + " with coverage " + std::to_string(window.cov_j));
+  }
+}
+
+
+//Allocates the window and computes the base case (column 0)
+template <typename BitColumn>
+void initialize_window(dp_window_t<BitColumn> &window, dp_columns_t &columns,
+                       const Counter MAX_COV, const Counter MAX_L, const Counter MAX_K,
+                       const vector<Counter> &sum_successive_L)
+{
+  HapChatColumnIterator &hap = window.hap;
+  vector<Column> &input = window.input;
+  Pointer &input_pointer = window.input_pointer;
+  vector<vector<Pointer> > &back_indexer = window.back_indexer;
+  vector<vector<Pointer> > &forw_indexer = window.forw_indexer;
+  vector<BitColumn> &pos_gaps = window.pos_gaps;
+  vector<Counter> &num_pos_gaps = window.num_pos_gaps;
+  vector<Counter> &k_j = window.k_j;
+  vector<Counter> &homo_cost = window.homo_cost;
+  vector<Cost> &homo_weight = window.homo_weight;
+  vector<vector<vector<Cost> > > &prevision = window.prevision;
+  Pointer &prevision_pointer = window.prevision_pointer;
+  vector<Cost> &OPT = window.OPT;
+  Pointer &OPT_pointer = window.OPT_pointer;
+  Counter &step = window.step;
+  double &k_j_inc = window.k_j_inc;
+  bool &re_run_k = window.re_run_k;
+  bool &solution_existence = window.solution_existence;
+  Counter &cov_j = window.cov_j;
+  vector<bool> &homo_haplotypes = columns.homo_haplotypes;
+
   //Allocation of memory for input window
-  vector<Column> input(2 * (MAX_L - 1) + 1,
-                       Column(MAX_COV,
-                              Entry(-1, Entry::BLANK, 0)));
-  Pointer input_pointer = 0;
+  input.assign(2 * (MAX_L - 1) + 1,
+               Column(MAX_COV,
+                      Entry(-1, Entry::BLANK, 0)));
+  input_pointer = 0;
   TRACE("-->> input allocated");
 
 
   //Allocation of memory for backward indexer
   //The index in j of the shared elements between p and j
-  vector<vector<Pointer> > back_indexer(2 * (MAX_L - 1) + 1,
-                                      vector<Pointer>(MAX_COV,
-                                                      -1));
+  back_indexer.assign(2 * (MAX_L - 1) + 1,
+                      vector<Pointer>(MAX_COV,
+                                      -1));
   //Equal to indexer_pointer
   TRACE("-->> back indexer allocated");
 
   //Allocation of memory for forward indexer
   //The index in p of the shared elements between p and j
-  vector<vector<Pointer> > forw_indexer(2 * (MAX_L - 1) + 1,
-                                      vector<Pointer>(MAX_COV,
-                                                      -1));
+  forw_indexer.assign(2 * (MAX_L - 1) + 1,
+                      vector<Pointer>(MAX_COV,
+                                      -1));
   const Pointer indexer_pointer = MAX_L - 1;
   TRACE("-->> forw indexer allocated");
 
   //Allocation of memory for pos_gaps
   //The considered gaps are the ones in the column with the lower index
-  vector<BitColumn> pos_gaps(2 * (MAX_L - 1) + 1);
+  pos_gaps.assign(2 * (MAX_L - 1) + 1, BitColumn());
   //Equal to indexer_pointer
   TRACE("-->> pos_gaps allocated");
 
   //Allocation of memory for num_pos_gaps
   //The considered gaps are the ones in the column with the lower index
-  vector<Counter> num_pos_gaps(2 * (MAX_L - 1) + 1);
+  num_pos_gaps.assign(2 * (MAX_L - 1) + 1, 0);
   //Equal to indexer_pointer
   TRACE("-->> num_pos_gaps allocated");
 
 
   //Allocation of memory for vector of k_j
-  vector<Counter> k_j(2 * (MAX_L - 1) + 1,
-                      MAX_K);
+  k_j.assign(2 * (MAX_L - 1) + 1,
+             MAX_K);
   //its pointer is equal to input_pointer
   TRACE("-->> k_j allocated");
 
   //Allocation of memory for homozigous costs
-  vector<Counter> homo_cost(2 * (MAX_L - 1) + 1,
-                            MAX_COUNTER);
+  homo_cost.assign(2 * (MAX_L - 1) + 1,
+                   MAX_COUNTER);
   //its pointer is equal to input_pointer
   TRACE("-->> homo_cost allocated");
 
   //Allocation of memory for homozigous weights
-  vector<Cost> homo_weight(2 * (MAX_L - 1) + 1,
-                           Cost::INFTY);
+  homo_weight.assign(2 * (MAX_L - 1) + 1,
+                     Cost::INFTY);
   //its pointer is equal to input_pointer
   TRACE("-->> homo_weight allocated");
 
   //Allocation of memory for prevision matrix
   //[Destinatary of prevision][Who make the prevision][Indexof(mask of who makes prevision on common fragments)]
 
-  vector<vector<vector<Cost> > > prevision(MAX_L,
-                                           vector<vector<Cost> > (MAX_L,
-                                                                  vector<Cost>(0)));
+  prevision.assign(MAX_L,
+                   vector<vector<Cost> > (MAX_L,
+                                          vector<Cost>(0)));
 
   for(unsigned int j = 0; j < MAX_L; j++) {
     for(unsigned int q = 0; q < MAX_L; q++) {
@@ -398,50 +543,19 @@ void dp(const constants_t &constants,
                              Cost::INFTY);
     }
   }
-  Pointer prevision_pointer = 0;
+  prevision_pointer = 0;
   TRACE("-->> prevision allocated");
 
   //Allocation of memory for OPT vector
-  vector<Cost> OPT(MAX_L + 1,
-                   Cost::INFTY);        //+ 1 since I need OPT[j - L]
-  Pointer OPT_pointer = 0;
+  OPT.assign(MAX_L + 1,
+             Cost::INFTY);        //+ 1 since I need OPT[j - L]
+  OPT_pointer = 0;
   TRACE("-->> OPT allocated");
 
-  //Allocation of memory for backtrace column
-  vector<vector<vector<Backtrace1> > > backtrace_table1(num_col);
-  vector<vector<vector<bool> > > backtrace_table2_haplotypes(num_col);
-  vector<vector<vector<bool> > > backtrace_table2_new_block(num_col);
-
-  for(unsigned int j = 0; j < num_col; j++) {
-      backtrace_table1[j].resize(scheme_backtrace[j].size());
-      DEBUG("j: " << j << " scheme[j] size: " << scheme_backtrace[j].size());
-      backtrace_table2_haplotypes[j].resize(scheme_backtrace[j].size());
-      backtrace_table2_new_block[j].resize(scheme_backtrace[j].size());
-      for(unsigned int q = 0; q < backtrace_table1[j].size(); q++) {
-          backtrace_table1[j][q].resize(scheme_backtrace[j][q]);
-          DEBUG("j: " << j << " q: " << q << " scheme[j] size: " << scheme_backtrace[j][q]);
-          backtrace_table2_haplotypes[j][q].resize(scheme_backtrace[j][q]);
-          backtrace_table2_new_block[j][q].resize(scheme_backtrace[j][q]);
-      }
-  }
-  TRACE("-->> Backtrace table allocated");
-
-
-  vector<bool> is_homozygous(num_col);
-  vector<bool> homo_haplotypes(num_col);
-  vector<Backtrace1> best_heterozygous1(num_col);
-  vector<bool> best_heterozygous2_haplotypes(num_col);
-  vector<bool> best_heterozygous2_new_block(num_col);
-
-
-  DEBUG(">> Completed allocation of memory");
-
   //INITIALIZATION
 
-  Combinations generator;
-  BalancedCombinations balanced_generator;
   hap.reset();
-  Counter step = 0;
+  step = 0;
   Column column;
 
   //Place the first and the next L columns in the positions of input data structure
@@ -474,26 +588,11 @@ void dp(const constants_t &constants,
   //  .::: BASE CASE :::.
   DEBUG(".:: Basic Step: " << step);
 
-  BitColumn colj;
-  BitColumn gaps_mask;
-  BitColumn proj;
-  BitColumn mask;
-  BitColumn comb_no_gaps;
-  BitColumn comb_gaps;
   Cost current_cost(Cost::INFTY);
-  Cost current_best(Cost::INFTY);
-  Counter cov_j(0);
-  Counter num_gaps(0);
   bool feasibility;
   bool has_successive;
-  bool solution_existence(true);
-  Counter temp_jump(-1);
-  Counter temp_index(0);
-  bool temp_haplotypes(false);
-  bool temp_new_block(false);
-
-  BitColumn cut_mask;
-  BitColumn mask_qj;
+  cov_j = 0;
+  solution_existence = true;
 
   //Base case for OPT
   OPT[OPT_pointer] = 0;
@@ -528,16 +627,76 @@ void dp(const constants_t &constants,
   } while (has_successive);
 
   // INC-K
-  double k_j_inc = k_j[input_pointer];
-  bool re_run_k = false;
+  k_j_inc = k_j[input_pointer];
+  re_run_k = false;
 
   DEBUG("-->> Basic case completed  -- current_cost: " << current_cost);
+}
 
-  //DP
-  
-  //For all the columns
 
-  while(!check_end(hap, input, next(input_pointer, input.size(), 1), re_run_k))// INC-K && solution_existence)
+//Computes the columns after the last column of the window up to
+//last_step (or the last column), adding their entries to backtrace. If
+//checkpoints is given, the window is saved every interval columns and
+//only the entries after the last checkpoint are kept.
+template <typename BitColumn>
+void forward(const constants_t<BitColumn> &constants, dp_window_t<BitColumn> &window,
+             BacktraceTable &backtrace, dp_columns_t &columns,
+             const vector<vector<Counter> > &scheme_backtrace, const Counter MAX_L,
+             const Counter last_step, const Counter interval,
+             vector<pair<dp_window_t<BitColumn>, BacktraceTable> > *checkpoints,
+             Counter &step_global)
+{
+  HapChatColumnIterator &hap = window.hap;
+  vector<Column> &input = window.input;
+  Pointer &input_pointer = window.input_pointer;
+  vector<vector<Pointer> > &back_indexer = window.back_indexer;
+  vector<vector<Pointer> > &forw_indexer = window.forw_indexer;
+  vector<BitColumn> &pos_gaps = window.pos_gaps;
+  vector<Counter> &num_pos_gaps = window.num_pos_gaps;
+  vector<Counter> &k_j = window.k_j;
+  vector<Counter> &homo_cost = window.homo_cost;
+  vector<Cost> &homo_weight = window.homo_weight;
+  vector<vector<vector<Cost> > > &prevision = window.prevision;
+  Pointer &prevision_pointer = window.prevision_pointer;
+  vector<Cost> &OPT = window.OPT;
+  Pointer &OPT_pointer = window.OPT_pointer;
+  Counter &step = window.step;
+  double &k_j_inc = window.k_j_inc;
+  bool &re_run_k = window.re_run_k;
+  bool &solution_existence = window.solution_existence;
+  Counter &cov_j = window.cov_j;
+  vector<bool> &is_homozygous = columns.is_homozygous;
+  vector<bool> &homo_haplotypes = columns.homo_haplotypes;
+  vector<Backtrace1> &best_heterozygous1 = columns.best_heterozygous1;
+  vector<bool> &best_heterozygous2_haplotypes = columns.best_heterozygous2_haplotypes;
+  vector<bool> &best_heterozygous2_new_block = columns.best_heterozygous2_new_block;
+  const Pointer indexer_pointer = MAX_L - 1;
+
+  Combinations<BitColumn> generator;
+  BalancedCombinations<BitColumn> balanced_generator;
+  Column column;
+
+  BitColumn colj;
+  BitColumn gaps_mask;
+  BitColumn proj;
+  BitColumn mask;
+  BitColumn comb_no_gaps;
+  BitColumn comb_gaps;
+  Cost current_cost(Cost::INFTY);
+  Cost current_best(Cost::INFTY);
+  Counter num_gaps(0);
+  bool feasibility;
+  bool has_successive;
+  Counter temp_jump(-1);
+  Counter temp_index(0);
+  bool temp_haplotypes(false);
+  bool temp_new_block(false);
+
+  BitColumn cut_mask;
+  BitColumn mask_qj;
+
+  while(!check_end(hap, input, next(input_pointer, input.size(), 1), re_run_k) && // INC-K && solution_existence)
+        (re_run_k || step < last_step))
     {
       current_best = Cost::INFTY;
       solution_existence = false;
@@ -547,6 +706,7 @@ void dp(const constants_t &constants,
       temp_new_block = false;
       step++;
       step_global++;
+      backtrace.add_column(step, scheme_backtrace[step]);
       DEBUG("STARTING STEP:  " << step);
 
       // >>>>>>>>>>>>>>>>>>>>>> UPDATE DATA STRUCTURE <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -647,11 +807,9 @@ void dp(const constants_t &constants,
                 DEBUG("Resize new_prevision_pointer[" << new_prevision_pointer << "][" << i << "] to " << combinations);
                 prevision[new_prevision_pointer][i].resize(combinations);
             }
-	    if(re_run_k && i < backtrace_table1[step].size() && backtrace_table1[step][i].size() < combinations) {
+	    if(re_run_k && i < backtrace.distances(step) && backtrace.size(step, i) < combinations) {
                 DEBUG("Resize backtrace tables[" << step << "][" << i << "] to " << combinations);
-                backtrace_table1[step][i].resize(combinations);
-                backtrace_table2_haplotypes[step][i].resize(combinations);
-                backtrace_table2_new_block[step][i].resize(combinations);
+                backtrace.resize(step, i, combinations);
             }
 
           fill(prevision[new_prevision_pointer][i].begin(),
@@ -793,7 +951,7 @@ void dp(const constants_t &constants,
 
                       temp_jump = q;
                       temp_index = index;
-                      temp_haplotypes = backtrace_table2_haplotypes[step - q][q][index];
+                      temp_haplotypes = backtrace.get_haplotypes(step - q, q, index);
                       temp_new_block = false;
                     }
                     TRACE("-->> Temporary current cost: " << current_cost);
@@ -816,7 +974,7 @@ void dp(const constants_t &constants,
 
                       temp_jump = q;
                       temp_index = index;
-                      temp_haplotypes = !backtrace_table2_haplotypes[step - q][q][index];
+                      temp_haplotypes = !backtrace.get_haplotypes(step - q, q, index);
                       temp_new_block = false;
                     }
                     TRACE("-->> Temporary current cost: " << current_cost);
@@ -883,10 +1041,7 @@ void dp(const constants_t &constants,
                 Cost& temp = prevision[new_prevision_pointer][p][index];
                 if(current_cost < temp) {
                     temp = current_cost;
-                    backtrace_table1[step][p][index].jump = temp_jump;
-                    backtrace_table1[step][p][index].index = temp_index;
-                    backtrace_table2_haplotypes[step][p][index] = temp_haplotypes;
-                    backtrace_table2_new_block[step][p][index] = temp_new_block;
+                    backtrace.set(step, p, index, temp_jump, temp_index, temp_haplotypes, temp_new_block);
                 }
                 TRACE("USCITO:  ");
                 p++;
@@ -926,7 +1081,7 @@ void dp(const constants_t &constants,
         }
 
       if (step_global % 500 == 0) {
-        INFO(".:: Step: " << step_global << "  ==>  OPT: " << OPT[OPT_pointer] + OPT_global);
+        INFO(".:: Step: " << step_global << "  ==>  OPT: " << OPT[OPT_pointer]);
       } else {
         DEBUG(".:: Step: " << step_global << "  ==>  OPT: " << OPT[OPT_pointer]);
       }
@@ -951,26 +1106,15 @@ void dp(const constants_t &constants,
           step_global--;
           re_run_k = true;
       }
-    }
 
-	
-  if(solution_existence) {
-    DEBUG("*** SUCCESS ***");
-    DEBUG("> Optimal block cost:  " << OPT[OPT_pointer]);
-    OPT_global += OPT[OPT_pointer];
-    DEBUG("===> Optimal global cost:  " << OPT_global);
-
-    reconstruct_haplotypes(backtrace_table1, backtrace_table2_haplotypes, backtrace_table2_new_block,
-                           is_homozygous, homo_haplotypes,
-                           best_heterozygous1, best_heterozygous2_haplotypes, best_heterozygous2_new_block,
-                           haplotype1, haplotype2);
-
-  } else {
-    INFO("*** NO SOLUTION ***");
-    INFO("<<>> No feasible solution exists with these parameters -- alpha = " << alpha_ << " and error rate = " << errorrate_);
-    INFO("<<>> The last not feasible column is:  " << step << "  with coverage = " << cov_j << " and k = " << k_j[input_pointer]);
-    exit(EXIT_FAILURE);
-  }
+      //Save the window and the entries read by the next columns
+      if(!re_run_k && checkpoints != NULL && step % interval == 0) {
+        if(step + 2 > MAX_L) {
+          backtrace.remove_before(step + 2 - MAX_L);
+        }
+        checkpoints->push_back(make_pair(window, backtrace));
+      }
+    }
 }
 
 
@@ -1017,8 +1161,7 @@ void computeInputParams(Counter &num_cols, Counter &MAX_COV, Counter &MAX_L,
           } else if (current_column[i].get_allele_type() == Entry::ALT_ALLELE) {
             ++count_minor;
           } else {
-            cerr << "ERROR: read invalid entry of type: " << current_column[i].get_allele_type() << endl;
-            exit(EXIT_FAILURE);
+            throw std::runtime_error("HapChat read an invalid entry of type " + std::to_string(current_column[i].get_allele_type()));
           }
         } else {
           ++count_gaps;
@@ -1099,6 +1242,7 @@ void computeInputParams(Counter &num_cols, Counter &MAX_COV, Counter &MAX_L,
 
 
 //XXX: Can I leave parameter q and pass as parameter just one column of forw_indexer and back_indexer??????????
+template <typename BitColumn>
 void intersect(const Column &colQ, const Column &colJ, const Pointer &q,
                vector<vector<Pointer> > &forw_indexer, vector<vector<Pointer> > &back_indexer,
                vector<BitColumn> &pos_gaps, vector<Counter> &num_pos_gaps, const bool &q_is_back)
@@ -1149,6 +1293,7 @@ void intersect(const Column &colQ, const Column &colJ, const Pointer &q,
 }
 
 
+template <typename BitColumn>
 void represent_column(const Column &column, BitColumn &result, Counter &cov,
                       BitColumn &gaps_mask, Counter &num_gaps)
 {
@@ -1167,6 +1312,7 @@ void represent_column(const Column &column, BitColumn &result, Counter &cov,
 }
 
 
+template <typename BitColumn>
 void make_mask(BitColumn &mask, const BitColumn &mask_gaps, const unsigned int &cov,
                const BitColumn &comb_gaps, const BitColumn &comb_no_gaps)
 {
@@ -1194,6 +1340,7 @@ void make_mask(BitColumn &mask, const BitColumn &mask_gaps, const unsigned int &
 
   somewhat the inverse of 'make_mask' above
 */
+template <typename BitColumn>
 void project(BitColumn & projection, const BitColumn & col, const BitColumn & mask_out, const unsigned int & cov) {
 
   projection.reset();
@@ -1209,6 +1356,7 @@ void project(BitColumn & projection, const BitColumn & col, const BitColumn & ma
 }
 
 
+template <typename BitColumn>
 unsigned int compute_index_of(const BitColumn &mask, const unsigned int &cov, const unsigned int &num_gaps,
                               const BitColumn &pos_gaps)
 {
@@ -1236,6 +1384,7 @@ unsigned int compute_index_of(const BitColumn &mask, const unsigned int &cov, co
 }
 
 
+template <typename BitColumn>
 void cut(const BitColumn &in_col, BitColumn &cut_mask, const vector<Pointer> &indexer, Counter &active_pj)
 {
   active_pj = 0;
@@ -1251,6 +1400,7 @@ void cut(const BitColumn &in_col, BitColumn &cut_mask, const vector<Pointer> &in
 }
 
 
+template <typename BitColumn>
 void extract_common_mask(const Column &column_q, const Pointer &q_pointer,
                          const Column &column_j, const BitColumn &mask_colj,
                          const vector<vector<Pointer> > &back_indexer,
@@ -1387,6 +1537,7 @@ void insert_col_and_update(vector<Column> &input, vector<Counter> &k_j, vector <
 }
 
 
+template <typename BitColumn>
 void compute_weight_mask(const BitColumn &mask, const Column &column, Cost &weight_mask) {
   BitColumn comb(mask);
   weight_mask = 0;
@@ -1396,7 +1547,7 @@ void compute_weight_mask(const BitColumn &mask, const Column &column, Cost &weig
 
   while(comb.any())
     {
-      temp = ffsl(comb.to_ulong());
+      temp = first_set_bit(comb);
       pos += temp;
       //i_column += temp - 1;
       weight_mask += column[pos - 1].get_phred_score();
@@ -1407,17 +1558,17 @@ void compute_weight_mask(const BitColumn &mask, const Column &column, Cost &weig
 }
 
 
-void reconstruct_haplotypes(const vector<vector<vector<Backtrace1> > > &backtrace_table1,
-                            const vector<vector<vector<bool> > > &backtrace_table2_haplotypes,
-                            const vector<vector<vector<bool> > > &backtrace_table2_new_block,
-                            const vector<bool> &is_homozygous,
-                            const vector<bool> &homo_haplotypes,
-                            const vector<Backtrace1> &best_heterozygous1,
-                            const vector<bool> &best_heterozygous2_haplotypes,
-                            const vector<bool> &best_heterozygous2_new_block,
+void reconstruct_haplotypes(const Counter num_col, const dp_columns_t &columns,
+                            const std::function<const BacktraceTable&(Counter)> &backtrace_of,
                             vector<bool> &haplotype1, vector<bool> &haplotype2) {
 
-  Counter col = backtrace_table1.size() - 1;
+  const vector<bool> &is_homozygous = columns.is_homozygous;
+  const vector<bool> &homo_haplotypes = columns.homo_haplotypes;
+  const vector<Backtrace1> &best_heterozygous1 = columns.best_heterozygous1;
+  const vector<bool> &best_heterozygous2_haplotypes = columns.best_heterozygous2_haplotypes;
+  const vector<bool> &best_heterozygous2_new_block = columns.best_heterozygous2_new_block;
+
+  Counter col = num_col - 1;
   haplotype1.resize(col);
   haplotype2.resize(col);
 	
@@ -1465,9 +1616,10 @@ void reconstruct_haplotypes(const vector<vector<vector<Backtrace1> > > &backtrac
         flag = false;
       } else {
         flag = true;
-        back2_haplotypes = backtrace_table2_haplotypes[col][back1.jump][back1.index];
-        back2_new_block = backtrace_table2_new_block[col][back1.jump][back1.index];
-        back1 = backtrace_table1[col][back1.jump][back1.index];
+        const BacktraceTable &backtrace = backtrace_of(col);
+        back2_haplotypes = backtrace.get_haplotypes(col, back1.jump, back1.index);
+        back2_new_block = backtrace.get_new_block(col, back1.jump, back1.index);
+        back1 = backtrace.get(col, back1.jump, back1.index);
       }
 
     }
@@ -1475,28 +1627,38 @@ void reconstruct_haplotypes(const vector<vector<vector<Backtrace1> > > &backtrac
 }
 
 
-Counter computeK(const Counter &cov, const double &alpha=0.0, const double &error_rate=0.0)
+//The smallest k such that the probability of more than k errors in a
+//column is at most alpha
+void initialize_k()
 {
-  static bool computed = false;
-  static vector<Counter> ks(cov + 1, 0);
-
-  if (!computed) {
-    for(Counter i = 1; i < ks.size(); ++i) {
-      Counter k = 0;
+  ks_.assign(MAX_COVERAGE + 1, 0);
+
+  //Binomial coefficients as doubles, which (unlike the unsigned ones)
+  //do not overflow for the coverages of wider bit columns
+  vector<double> binomials(1, 1.0);
+  for(Counter i = 1; i < ks_.size(); ++i) {
+    for(Counter x = i - 1; x > 0; --x) {
+      binomials[x] += binomials[x - 1];
+    }
+    binomials.push_back(1.0);
 
-      double cumulative =  pow(1.0 - error_rate, i);
+    Counter k = 0;
 
-      while(!(1.0 - cumulative <= alpha) && (k < i)) {
-        ++k;
-        cumulative += (double)BinomialCoefficient::binomial_coefficient(i, k) * pow(error_rate, k) * pow(1.0 - error_rate, i - k);
-      }
+    double cumulative =  pow(1.0 - errorrate_, i);
 
-      ks[i] = k;
+    while(!(1.0 - cumulative <= alpha_) && (k < i)) {
+      ++k;
+      cumulative += binomials[k] * pow(errorrate_, k) * pow(1.0 - errorrate_, i - k);
     }
-    computed = true;
+
+    ks_[i] = k;
   }
+}
+
 
-  return ks[cov];
+Counter computeK(const Counter &cov)
+{
+  return ks_[cov];
 }
 
 
@@ -0,0 +1,71 @@
+#include <stdexcept>
+
+#include "instrumentation.h"
+
+using namespace std;
+
+namespace instrumentation {
+	atomic<bool> enabled(false);
+	atomic<uint64_t> counters[INSTRUMENTATION_COUNTER_COUNT];
+}
+
+namespace {
+	// in the order of instrumentation_counter_t
+	const char* const COUNTER_NAMES[INSTRUMENTATION_COUNTER_COUNT] = {
+		"pedigree_columns",
+		"pedigree_recomputed_columns",
+		"pedigree_max_column_size",
+		"pedigree_column_bytes",
+		"pedigree_forward_ns",
+		"pedigree_backtrace_ns",
+		"genotype_columns",
+		"genotype_recomputed_columns",
+		"genotype_max_column_size",
+		"genotype_column_bytes",
+		"genotype_backward_ns",
+		"genotype_forward_ns",
+		"cluster_editing_runs",
+		"cluster_editing_nodes",
+		"cluster_editing_ns",
+		"threading_positions",
+		"threading_ns",
+	};
+}
+
+
+void set_instrumentation_enabled(bool enabled) {
+	instrumentation::enabled.store(enabled);
+}
+
+
+bool is_instrumentation_enabled() {
+	return instrumentation::is_enabled();
+}
+
+
+void reset_instrumentation() {
+	for (atomic<uint64_t>& counter : instrumentation::counters) {
+		counter.store(0);
+	}
+}
+
+
+size_t instrumentation_counter_count() {
+	return INSTRUMENTATION_COUNTER_COUNT;
+}
+
+
+const char* instrumentation_counter_name(size_t counter) {
+	if (counter >= INSTRUMENTATION_COUNTER_COUNT) {
+		throw std::out_of_range("Invalid instrumentation counter");
+	}
+	return COUNTER_NAMES[counter];
+}
+
+
+uint64_t get_instrumentation_counter(size_t counter) {
+	if (counter >= INSTRUMENTATION_COUNTER_COUNT) {
+		throw std::out_of_range("Invalid instrumentation counter");
+	}
+	return instrumentation::counters[counter].load();
+}
@@ -0,0 +1,99 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/** Counters and timers of the hot paths of the core algorithms. Counters whose name contains
+ *  "_max_" hold maxima, all others are sums. Times are in nanoseconds and summed over threads.
+ */
+typedef enum instrumentation_counter_t {
+	// PedigreeDPTable: computed columns, columns computed again during the backtrace,
+	// largest number of bipartitions in a column, bytes of the DP and stored columns,
+	// time spent in the forward pass and the backtrace
+	PEDIGREE_COLUMNS,
+	PEDIGREE_RECOMPUTED_COLUMNS,
+	PEDIGREE_MAX_COLUMN_SIZE,
+	PEDIGREE_COLUMN_BYTES,
+	PEDIGREE_FORWARD_NS,
+	PEDIGREE_BACKTRACE_NS,
+	// GenotypeDPTable: the same for the forward-backward algorithm (the backward columns are
+	// recomputed during the forward pass)
+	GENOTYPE_COLUMNS,
+	GENOTYPE_RECOMPUTED_COLUMNS,
+	GENOTYPE_MAX_COLUMN_SIZE,
+	GENOTYPE_COLUMN_BYTES,
+	GENOTYPE_BACKWARD_NS,
+	GENOTYPE_FORWARD_NS,
+	// ClusterEditingSolver::run: calls, nodes of the graphs and time
+	CLUSTER_EDITING_RUNS,
+	CLUSTER_EDITING_NODES,
+	CLUSTER_EDITING_NS,
+	// HaploThreader::computePaths: threaded variants and time
+	THREADING_POSITIONS,
+	THREADING_NS,
+	INSTRUMENTATION_COUNTER_COUNT
+} instrumentation_counter_t;
+
+
+namespace instrumentation {
+	extern std::atomic<bool> enabled;
+	extern std::atomic<uint64_t> counters[INSTRUMENTATION_COUNTER_COUNT];
+
+	inline bool is_enabled() {
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	/** Adds the given value to a counter (if instrumentation is enabled). */
+	inline void add(instrumentation_counter_t counter, uint64_t value) {
+		if (!is_enabled()) return;
+		counters[counter].fetch_add(value, std::memory_order_relaxed);
+	}
+
+	/** Raises a counter to the given value (if instrumentation is enabled). */
+	inline void record_max(instrumentation_counter_t counter, uint64_t value) {
+		if (!is_enabled()) return;
+		uint64_t current = counters[counter].load(std::memory_order_relaxed);
+		while ((current < value) && !counters[counter].compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+	}
+
+	/** Adds the time between its construction and destruction to a counter. The clock is only read
+	 *  if instrumentation is enabled at construction. */
+	class ScopedTimer {
+	public:
+		ScopedTimer(instrumentation_counter_t counter) : counter(counter), active(is_enabled()) {
+			if (active) start = std::chrono::steady_clock::now();
+		}
+
+		~ScopedTimer() {
+			if (!active) return;
+			std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+			counters[counter].fetch_add(elapsed.count(), std::memory_order_relaxed);
+		}
+
+	private:
+		ScopedTimer(const ScopedTimer&) = delete;
+		ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+		instrumentation_counter_t counter;
+		bool active;
+		std::chrono::steady_clock::time_point start;
+	};
+}
+
+
+/** Enables or disables instrumentation (disabled by default) for all threads. */
+void set_instrumentation_enabled(bool enabled);
+bool is_instrumentation_enabled();
+
+/** Sets all counters to zero. */
+void reset_instrumentation();
+
+/** Number of counters, and name and current value of the counter with the given index. */
+size_t instrumentation_counter_count();
+const char* instrumentation_counter_name(size_t counter);
+uint64_t get_instrumentation_counter(size_t counter);
+
+#endif
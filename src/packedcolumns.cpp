@@ -0,0 +1,75 @@
+#include <cassert>
+
+#include "packedcolumns.h"
+
+using namespace std;
+
+PackedColumns::PackedColumns(const ReadSet& set, const vector<unsigned int>* positions) :
+	PackedColumns(set, ColumnReadIndex(set, positions))
+{
+}
+
+
+PackedColumns::PackedColumns(const ReadSet& set, const ColumnReadIndex& index) :
+	read_count(index.get_read_count()),
+	positions(*index.get_positions())
+{
+	offsets.reserve(positions.size() + 1);
+	offsets.push_back(0);
+	for (size_t k=0; k<positions.size(); ++k) {
+		for (size_t i=0; i<index.column_size(k); ++i) {
+			const Read* read = set.get(index.get_read_index(k, i));
+			unsigned int entry_index = index.get_entry_index(k, i);
+			if (entry_index != ColumnReadIndex::NO_ENTRY) {
+				const Entry* entry = read->getEntry(entry_index);
+				add_entry(entry->get_read_id(), entry->get_allele_type(), entry->get_phred_score());
+			} else {
+				add_entry(read->getID(), Entry::BLANK, 0);
+			}
+		}
+		offsets.push_back(read_ids.size());
+	}
+}
+
+
+void PackedColumns::add_entry(unsigned int read_id, Entry::allele_t allele, unsigned int phred_score) {
+	size_t k = read_ids.size();
+	if (k % 32 == 0) {
+		alleles.push_back(0);
+	}
+	alleles.back() |= ((uint64_t)allele & 3) << (2 * (k % 32));
+	read_ids.push_back(read_id);
+	phred_scores.push_back(phred_score);
+}
+
+
+unsigned int PackedColumns::get_column_count() const {
+	return positions.size();
+}
+
+
+unsigned int PackedColumns::get_read_count() const {
+	return read_count;
+}
+
+
+size_t PackedColumns::get_entry_count() const {
+	return read_ids.size();
+}
+
+
+const vector<unsigned int>* PackedColumns::get_positions() const {
+	return &positions;
+}
+
+
+PackedColumn PackedColumns::get_column(size_t k) const {
+	assert(k < positions.size());
+	PackedColumn column;
+	column.first = offsets[k];
+	column.size_ = offsets[k+1] - offsets[k];
+	column.read_ids = read_ids.data() + offsets[k];
+	column.phred_scores = phred_scores.data() + offsets[k];
+	column.alleles = alleles.data();
+	return column;
+}
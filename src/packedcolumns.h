@@ -0,0 +1,106 @@
+#ifndef PACKED_COLUMNS_H
+#define PACKED_COLUMNS_H
+
+#include <vector>
+#include <cstdint>
+#include <cassert>
+
+#include "entry.h"
+#include "readset.h"
+#include "columnreadindex.h"
+
+class PackedColumns;
+
+/** Read-only view on one column of a PackedColumns object. Entries are accessed by their
+ *  index within the column (which corresponds to the bit index used by ColumnIndexingScheme).
+ *  The view remains valid as long as the PackedColumns object it was obtained from.
+ */
+class PackedColumn {
+public:
+	PackedColumn() : first(0), size_(0), read_ids(nullptr), phred_scores(nullptr), alleles(nullptr) {}
+
+	size_t size() const {
+		return size_;
+	}
+
+	unsigned int get_read_id(size_t i) const {
+		assert(i < size_);
+		return read_ids[i];
+	}
+
+	Entry::allele_t get_allele_type(size_t i) const {
+		assert(i < size_);
+		size_t k = first + i;
+		return (Entry::allele_t)((alleles[k / 32] >> (2 * (k % 32))) & 3);
+	}
+
+	unsigned int get_phred_score(size_t i) const {
+		assert(i < size_);
+		return phred_scores[i];
+	}
+
+	/** Returns the read ids of all entries in this column (in order). */
+	std::vector<unsigned int> get_read_ids() const {
+		return std::vector<unsigned int>(read_ids, read_ids + size_);
+	}
+
+private:
+	friend class PackedColumns;
+	// index of the first entry of this column in the PackedColumns object
+	size_t first;
+	size_t size_;
+	const unsigned int* read_ids;
+	const unsigned int* phred_scores;
+	const uint64_t* alleles;
+};
+
+
+/** All columns of a ReadSet stored in a flat structure-of-arrays layout: read ids,
+ *  phred scores and 2-bit allele types of all entries, column after column. This is
+ *  built once for the whole ReadSet such that columns can be accessed in any order,
+ *  without pointer chasing, and without allocating memory per column.
+ *
+ *  Column k contains one entry for each read active in column k (i.e. its first
+ *  position <= positions[k] <= its last position), in the order in which the
+ *  reads appear in the ReadSet. Reads that span, but do not cover positions[k] contribute
+ *  a BLANK entry. This is the same content and order as given by ColumnReadIndex and
+ *  produced by ColumnIterator.
+ */
+class PackedColumns {
+public:
+	/** Constructor.
+	 *  @param positions Positions to work on. If 0, then all positions given in set will be used.
+	 *                   Caller retains ownership.
+	 */
+	PackedColumns(const ReadSet& set, const std::vector<unsigned int>* positions = nullptr);
+
+	/** Builds the columns given by an existing index for the same ReadSet. */
+	PackedColumns(const ReadSet& set, const ColumnReadIndex& index);
+
+	/** Returns the total number of columns. */
+	unsigned int get_column_count() const;
+
+	/** Returns the total number of reads. */
+	unsigned int get_read_count() const;
+
+	/** Returns the total number of entries in all columns. */
+	size_t get_entry_count() const;
+
+	const std::vector<unsigned int>* get_positions() const;
+
+	PackedColumn get_column(size_t k) const;
+
+private:
+	unsigned int read_count;
+	std::vector<unsigned int> positions;
+	// entries of column k have indices offsets[k], ..., offsets[k+1]-1
+	std::vector<size_t> offsets;
+	std::vector<unsigned int> read_ids;
+	std::vector<unsigned int> phred_scores;
+	// 32 allele types (2 bits each) per word
+	std::vector<uint64_t> alleles;
+
+	void add_entry(unsigned int read_id, Entry::allele_t allele, unsigned int phred_score);
+};
+
+#endif
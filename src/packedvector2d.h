@@ -0,0 +1,99 @@
+#ifndef PACKED_VECTOR_2D_H
+#define PACKED_VECTOR_2D_H
+
+#include <vector>
+#include <cstdint>
+#include <cassert>
+
+/** Two-dimensional array of unsigned integers, each stored using a fixed number of bits.
+ *  Entries are packed back to back into 64-bit words (an entry may span two words).
+ *  With a width of zero bits, no memory is used and all entries are 0.
+ */
+class PackedVector2D {
+public:
+	PackedVector2D(size_t size0, size_t size1, unsigned int bits) :
+		size0(size0),
+		size1(size1),
+		bits(bits),
+		mask((bits == 0) ? 0 : (~((uint64_t)0)) >> (64 - bits)),
+		v((size0*size1*bits + 63) / 64, 0)
+	{
+		assert(bits <= 32);
+	}
+
+	unsigned int at(size_t index0, size_t index1) const {
+		if (bits == 0) return 0;
+		size_t offset = (index0*size1 + index1) * bits;
+		size_t word = offset / 64;
+		unsigned int shift = offset % 64;
+		uint64_t value = v[word] >> shift;
+		if (shift + bits > 64) {
+			value |= v[word+1] << (64 - shift);
+		}
+		return value & mask;
+	}
+
+	void set(size_t index0, size_t index1, unsigned int value) {
+		assert((value & mask) == value);
+		if (bits == 0) return;
+		size_t offset = (index0*size1 + index1) * bits;
+		size_t word = offset / 64;
+		unsigned int shift = offset % 64;
+		v[word] = (v[word] & ~(mask << shift)) | (((uint64_t)value) << shift);
+		if (shift + bits > 64) {
+			unsigned int spilled = 64 - shift;
+			v[word+1] = (v[word+1] & ~(mask >> spilled)) | (((uint64_t)value) >> spilled);
+		}
+	}
+
+	/** Changes dimensions and bit width and sets all entries to 0. Memory is only
+	 *  reallocated if the new size exceeds the capacity. */
+	void reset(size_t size0, size_t size1, unsigned int bits) {
+		assert(bits <= 32);
+		this->size0 = size0;
+		this->size1 = size1;
+		this->bits = bits;
+		this->mask = (bits == 0) ? 0 : (~((uint64_t)0)) >> (64 - bits);
+		v.assign((size0*size1*bits + 63) / 64, 0);
+	}
+
+	/** Returns the number of bytes allocated for the entries. */
+	size_t capacity() const {
+		return v.capacity() * sizeof(uint64_t);
+	}
+
+	size_t get_size0() const {
+		return size0;
+	}
+
+	size_t get_size1() const {
+		return size1;
+	}
+
+	unsigned int get_bits() const {
+		return bits;
+	}
+
+	/** Returns the number of bytes used to store the entries. */
+	size_t memory() const {
+		return v.size() * sizeof(uint64_t);
+	}
+
+	/** Returns the number of bits needed to store all values in [0, n). */
+	static unsigned int bits_needed(uint64_t n) {
+		unsigned int bits = 0;
+		while ((bits < 64) && ((((uint64_t)1) << bits) < n)) {
+			++bits;
+		}
+		return bits;
+	}
+
+private:
+	size_t size0;
+	size_t size1;
+	unsigned int bits;
+	uint64_t mask;
+	std::vector<uint64_t> v;
+};
+
+#endif
@@ -11,7 +11,7 @@
 
 using namespace std;
 
-PedigreeColumnCostComputer::PedigreeColumnCostComputer(const std::vector <const Entry *>&column, size_t column_index, const std::vector <unsigned int>& read_marks, const Pedigree* pedigree, const PedigreePartitions& pedigree_partitions, bool distrust_genotypes):
+PedigreeColumnCostComputer::PedigreeColumnCostComputer(const PackedColumn& column, size_t column_index, const std::vector <unsigned int>& read_marks, const Pedigree* pedigree, const PedigreePartitions& pedigree_partitions, bool distrust_genotypes):
 	column(column),
 	column_index(column_index),
 	read_marks(read_marks),
@@ -20,32 +20,35 @@ PedigreeColumnCostComputer::PedigreeColumnCostComputer(const std::vector <const
 	cost_partition(pedigree_partitions.count(), {0,0}),
 	pedigree_partitions(pedigree_partitions)
 {
-	// Enumerate all possible assignments of alleles to haplotypes and 
-	// store those that are compatible with genotypes.
-	for (unsigned int i = 0; i < (1<<pedigree_partitions.count()); ++i) {
-		bool genotypes_compatible = true;
-		unsigned int cost = 0;
+	if (!distrust_genotypes) {
+		// allele assignments compatible with genotypes are shared by all columns with the same genotypes
+		vector<const Genotype*> genotypes;
 		for (size_t individuals_index = 0; individuals_index < pedigree->size(); ++individuals_index) {
-			unsigned int partition0 = pedigree_partitions.haplotype_to_partition(individuals_index,0);
-			unsigned int partition1 = pedigree_partitions.haplotype_to_partition(individuals_index,1);
-			unsigned int allele0 = (i >> partition0) & 1;
-			unsigned int allele1 = (i >> partition1) & 1;
-			Genotype genotype(vector<unsigned int>{allele0,allele1});
-			if (distrust_genotypes) {
-				const PhredGenotypeLikelihoods* gls = pedigree->get_genotype_likelihoods(individuals_index, column_index);
-				assert(gls != nullptr);
-				cost += gls->get(genotype);
-			} else {
-				const Genotype* true_genotype = pedigree->get_genotype(individuals_index, column_index);
-				if (genotype != (*true_genotype)) {
-					genotypes_compatible = false;
-					break;
-				}
-			}
+			genotypes.push_back(pedigree->get_genotype(individuals_index, column_index));
+		}
+		for (unsigned int assignment : pedigree_partitions.get_compatible_assignments(genotypes)) {
+			allele_assignments.push_back(allele_assignment_t(assignment, 0));
 		}
-		if (genotypes_compatible) {
-			allele_assignments.push_back(allele_assignment_t(i,cost));
+		return;
+	}
+	// With untrusted genotypes, all assignments are allowed at the cost of the implied genotype.
+	// genotype_costs[i][a0 + 2*a1] is the cost of the genotype with alleles a0/a1 for individual i.
+	vector<array<double, 4>> genotype_costs(pedigree->size());
+	for (size_t individuals_index = 0; individuals_index < pedigree->size(); ++individuals_index) {
+		const PhredGenotypeLikelihoods* gls = pedigree->get_genotype_likelihoods(individuals_index, column_index);
+		assert(gls != nullptr);
+		for (unsigned int alleles = 0; alleles < 4; ++alleles) {
+			genotype_costs[individuals_index][alleles] = gls->get(Genotype(vector<unsigned int>{alleles & 1, alleles >> 1}));
+		}
+	}
+	for (unsigned int i = 0; i < (1u << pedigree_partitions.count()); ++i) {
+		unsigned int cost = 0;
+		for (size_t individuals_index = 0; individuals_index < pedigree->size(); ++individuals_index) {
+			unsigned int allele0 = (i >> pedigree_partitions.haplotype_to_partition(individuals_index,0)) & 1;
+			unsigned int allele1 = (i >> pedigree_partitions.haplotype_to_partition(individuals_index,1)) & 1;
+			cost += genotype_costs[individuals_index][allele0 + 2*allele1];
 		}
+		allele_assignments.push_back(allele_assignment_t(i,cost));
 	}
 }
 
@@ -53,18 +56,17 @@ PedigreeColumnCostComputer::PedigreeColumnCostComputer(const std::vector <const
 void PedigreeColumnCostComputer::set_partitioning(unsigned int partitioning) {
 	cost_partition.assign(pedigree_partitions.count(), {0,0});
 
-	partitioning = partitioning;
-	for (vector < const Entry * >::const_iterator it = column.begin(); it != column.end(); ++it) {
-		auto & entry = **it;
+	this->partitioning = partitioning;
+	for (size_t i = 0; i < column.size(); ++i) {
 		bool  entry_in_partition1 = (partitioning & ((unsigned int) 1)) == 0;
-		unsigned int    ind_id = read_marks[entry.get_read_id()];
-		switch (entry.get_allele_type()) {
+		unsigned int    ind_id = read_marks[column.get_read_id(i)];
+		switch (column.get_allele_type(i)) {
 
 		case Entry::REF_ALLELE:
-			(entry_in_partition1 ? cost_partition[pedigree_partitions.haplotype_to_partition(ind_id,0)] :cost_partition[pedigree_partitions.haplotype_to_partition(ind_id,1)])[1] += entry.get_phred_score();
+			(entry_in_partition1 ? cost_partition[pedigree_partitions.haplotype_to_partition(ind_id,0)] :cost_partition[pedigree_partitions.haplotype_to_partition(ind_id,1)])[1] += column.get_phred_score(i);
 			break;
 		case Entry::ALT_ALLELE:
-			(entry_in_partition1 ? cost_partition[pedigree_partitions.haplotype_to_partition(ind_id,0)] :cost_partition[pedigree_partitions.haplotype_to_partition(ind_id,1)])[0] += entry.get_phred_score();
+			(entry_in_partition1 ? cost_partition[pedigree_partitions.haplotype_to_partition(ind_id,0)] :cost_partition[pedigree_partitions.haplotype_to_partition(ind_id,1)])[0] += column.get_phred_score(i);
 			break;
 		case Entry::BLANK:
 			break;
@@ -77,18 +79,16 @@ void PedigreeColumnCostComputer::set_partitioning(unsigned int partitioning) {
 
 
 void PedigreeColumnCostComputer::update_partitioning(int bit_to_flip) {
-	const Entry & entry = *column[bit_to_flip];
+	unsigned int phred_score = column.get_phred_score(bit_to_flip);
 	partitioning = partitioning ^ (((unsigned int) 1) << bit_to_flip);
 	bool entry_in_partition1 = (partitioning & (((unsigned int) 1) << bit_to_flip)) == 0;
-	unsigned int ind_id = read_marks[entry.get_read_id()];
-	switch (entry.get_allele_type()) {
+	unsigned int ind_id = read_marks[column.get_read_id(bit_to_flip)];
+	switch (column.get_allele_type(bit_to_flip)) {
 	case Entry::REF_ALLELE:
-		(entry_in_partition1 ? cost_partition[pedigree_partitions.haplotype_to_partition(ind_id,1)] : cost_partition[pedigree_partitions.haplotype_to_partition(ind_id,0)])[1] -= entry.get_phred_score();
-		(entry_in_partition1 ? cost_partition[pedigree_partitions.haplotype_to_partition(ind_id,0)] :  cost_partition[pedigree_partitions.haplotype_to_partition(ind_id,1)])[1] += entry.get_phred_score();
+		move_cost(ind_id, entry_in_partition1 ? 1 : 0, 1, phred_score);
 		break;
 	case Entry::ALT_ALLELE:
-		(entry_in_partition1 ? cost_partition[pedigree_partitions.haplotype_to_partition(ind_id,1)] : cost_partition[pedigree_partitions.haplotype_to_partition(ind_id,0)])[0] -= entry.get_phred_score();
-		(entry_in_partition1 ? cost_partition[pedigree_partitions.haplotype_to_partition(ind_id,0)] :  cost_partition[pedigree_partitions.haplotype_to_partition(ind_id,1)])[0] += entry.get_phred_score();
+		move_cost(ind_id, entry_in_partition1 ? 1 : 0, 0, phred_score);
 		break;
     case Entry::BLANK:
 		break;
@@ -98,6 +98,25 @@ void PedigreeColumnCostComputer::update_partitioning(int bit_to_flip) {
 }
 
 
+void PedigreeColumnCostComputer::set_haplotype_costs(const vector<array<unsigned int, 2>>& haplotype_costs) {
+	assert(haplotype_costs.size() == 2 * pedigree->size());
+	cost_partition.assign(pedigree_partitions.count(), {0,0});
+	for (size_t individuals_index = 0; individuals_index < pedigree->size(); ++individuals_index) {
+		for (size_t haplotype = 0; haplotype < 2; ++haplotype) {
+			array<unsigned int, 2>& partition_cost = cost_partition[pedigree_partitions.haplotype_to_partition(individuals_index, haplotype)];
+			partition_cost[0] += haplotype_costs[2*individuals_index + haplotype][0];
+			partition_cost[1] += haplotype_costs[2*individuals_index + haplotype][1];
+		}
+	}
+}
+
+
+void PedigreeColumnCostComputer::move_cost(size_t individual_index, unsigned int from_haplotype, unsigned int allele, unsigned int cost) {
+	cost_partition[pedigree_partitions.haplotype_to_partition(individual_index, from_haplotype)][allele] -= cost;
+	cost_partition[pedigree_partitions.haplotype_to_partition(individual_index, 1 - from_haplotype)][allele] += cost;
+}
+
+
 unsigned int PedigreeColumnCostComputer::get_cost() {
 	unsigned int best_cost = numeric_limits < unsigned int >::max();
 	for (const allele_assignment_t& a : allele_assignments) {
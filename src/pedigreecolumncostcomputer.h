@@ -9,6 +9,7 @@
 #include <utility>
 #include <array>
 #include "entry.h"
+#include "packedcolumns.h"
 #include "pedigree.h"
 #include "pedigreepartitions.h"
 #include "columnindexingiterator.h"
@@ -17,7 +18,7 @@
   
 class PedigreeColumnCostComputer {
 private:
-	const std::vector<const Entry*>& column;
+	PackedColumn column;
 	size_t column_index;
 	const std::vector<unsigned int>& read_marks;  
 	unsigned int partitioning;
@@ -37,12 +38,20 @@ private:
   
 public:
   
-	PedigreeColumnCostComputer(const std::vector<const Entry*>& column, size_t column_index, const std::vector<unsigned int>& read_marks, const Pedigree* pedigree, const PedigreePartitions& pedigree_partitions, bool distrust_genotypes);
+	PedigreeColumnCostComputer(const PackedColumn& column, size_t column_index, const std::vector<unsigned int>& read_marks, const Pedigree* pedigree, const PedigreePartitions& pedigree_partitions, bool distrust_genotypes);
 
 	void set_partitioning(unsigned int partitioning);
 
 	void update_partitioning(int bit_to_flip);
 
+	/** Sets the costs of all pedigree partitions from costs given per haplotype: haplotype_costs[2*i+h][a]
+	 *  is the cost of assigning allele a to haplotype h of the individual with index i. Used by
+	 *  PedigreeColumnCostEngine, which tracks these costs for all transmission values at once. */
+	void set_haplotype_costs(const std::vector<std::array<unsigned int, 2>>& haplotype_costs);
+
+	/** Moves the given cost for allele from haplotype from_haplotype of the given individual to its other haplotype. */
+	void move_cost(size_t individual_index, unsigned int from_haplotype, unsigned int allele, unsigned int cost);
+
 	std::vector<unsigned int> compute_roots(std::vector<Pedigree::triple_entry_t> triples);
 
 	unsigned int get_cost();
@@ -0,0 +1,96 @@
+#include <cassert>
+#include <limits>
+
+#include "pedigreecolumncostengine.h"
+
+using namespace std;
+
+PedigreeColumnCostEngine::PedigreeColumnCostEngine(const PackedColumn& column, size_t column_index, const vector<unsigned int>& read_marks, const Pedigree* pedigree, const vector<PedigreePartitions*>& pedigree_partitions, const vector<unsigned int>& transmission_values, bool distrust_genotypes) :
+	column(column),
+	read_marks(read_marks),
+	pedigree(pedigree),
+	partitioning(0),
+	haplotype_costs(2 * pedigree->size(), {0,0}),
+	transmission_values(transmission_values),
+	transmission_configurations(pedigree_partitions.size())
+{
+	cost_computers.reserve(transmission_values.size());
+	for (unsigned int transmission_value : transmission_values) {
+		assert(transmission_value < pedigree_partitions.size());
+		cost_computers.emplace_back(column, column_index, read_marks, pedigree, *pedigree_partitions[transmission_value], distrust_genotypes);
+	}
+}
+
+
+void PedigreeColumnCostEngine::set_partitioning(unsigned int partitioning) {
+	haplotype_costs.assign(2 * pedigree->size(), {0,0});
+	this->partitioning = partitioning;
+	for (size_t i = 0; i < column.size(); ++i, partitioning = partitioning >> 1) {
+		unsigned int haplotype = partitioning & 1;
+		unsigned int ind_id = read_marks[column.get_read_id(i)];
+		switch (column.get_allele_type(i)) {
+		case Entry::REF_ALLELE:
+			haplotype_costs[2*ind_id + haplotype][1] += column.get_phred_score(i);
+			break;
+		case Entry::ALT_ALLELE:
+			haplotype_costs[2*ind_id + haplotype][0] += column.get_phred_score(i);
+			break;
+		case Entry::BLANK:
+			break;
+		default:
+			assert(false);
+		}
+	}
+	for (auto& cost_computer : cost_computers) {
+		cost_computer.set_haplotype_costs(haplotype_costs);
+	}
+}
+
+
+void PedigreeColumnCostEngine::update_partitioning(int bit_to_flip) {
+	partitioning = partitioning ^ (((unsigned int) 1) << bit_to_flip);
+	unsigned int allele;
+	switch (column.get_allele_type(bit_to_flip)) {
+	case Entry::REF_ALLELE:
+		allele = 1;
+		break;
+	case Entry::ALT_ALLELE:
+		allele = 0;
+		break;
+	case Entry::BLANK:
+		return;
+	default:
+		assert(false);
+		return;
+	}
+	unsigned int phred_score = column.get_phred_score(bit_to_flip);
+	unsigned int ind_id = read_marks[column.get_read_id(bit_to_flip)];
+	// haplotype the entry has been moved to
+	unsigned int haplotype = (partitioning >> bit_to_flip) & 1;
+	haplotype_costs[2*ind_id + 1 - haplotype][allele] -= phred_score;
+	haplotype_costs[2*ind_id + haplotype][allele] += phred_score;
+	for (auto& cost_computer : cost_computers) {
+		cost_computer.move_cost(ind_id, 1 - haplotype, allele, phred_score);
+	}
+}
+
+
+void PedigreeColumnCostEngine::get_costs(unsigned int* costs) {
+	if (computes_all_costs()) {
+		for (size_t i = 0; i < cost_computers.size(); ++i) {
+			costs[i] = cost_computers[i].get_cost();
+		}
+		return;
+	}
+	for (size_t i = 0; i < transmission_configurations; ++i) {
+		costs[i] = numeric_limits<unsigned int>::max();
+	}
+	for (size_t k = 0; k < cost_computers.size(); ++k) {
+		costs[transmission_values[k]] = cost_computers[k].get_cost();
+	}
+}
+
+
+bool PedigreeColumnCostEngine::computes_all_costs() const {
+	return transmission_values.size() == transmission_configurations;
+}
@@ -0,0 +1,52 @@
+#ifndef PEDIGREE_COLUMN_COST_ENGINE_H
+#define PEDIGREE_COLUMN_COST_ENGINE_H
+
+#include <array>
+#include <vector>
+
+#include "packedcolumns.h"
+#include "pedigree.h"
+#include "pedigreepartitions.h"
+#include "pedigreecolumncostcomputer.h"
+
+/** Computes the costs of a bipartition of one column for all transmission values at once.
+ *
+ *  A read's contribution to the costs only depends on the haplotype of its individual it is
+ *  assigned to; only the mapping of haplotypes to pedigree partitions depends on the transmission
+ *  value. Therefore, the allele costs of all haplotypes are tracked once and changes are passed on
+ *  to one PedigreeColumnCostComputer per transmission value, instead of each of them reading the
+ *  input column on its own.
+ */
+class PedigreeColumnCostEngine {
+public:
+	/** Constructor.
+	 *  @param pedigree_partitions Pedigree partitions for all transmission values.
+	 *  @param transmission_values Transmission values for which costs are computed; the cost of
+	 *  all others is taken to be infinite (e.g. because they are incompatible with the genotypes).
+	 */
+	PedigreeColumnCostEngine(const PackedColumn& column, size_t column_index, const std::vector<unsigned int>& read_marks, const Pedigree* pedigree, const std::vector<PedigreePartitions*>& pedigree_partitions, const std::vector<unsigned int>& transmission_values, bool distrust_genotypes);
+
+	void set_partitioning(unsigned int partitioning);
+
+	void update_partitioning(int bit_to_flip);
+
+	/** Writes the cost of the current partitioning for each transmission value to costs. */
+	void get_costs(unsigned int* costs);
+
+	/** Returns whether all transmission values have been given to the constructor. */
+	bool computes_all_costs() const;
+
+private:
+	PackedColumn column;
+	const std::vector<unsigned int>& read_marks;
+	const Pedigree* pedigree;
+	unsigned int partitioning;
+	// haplotype_costs[2*i+h][a] is the cost of assigning allele a to haplotype h of individual i
+	std::vector<std::array<unsigned int, 2>> haplotype_costs;
+	// cost_computers[k] computes the cost of transmission value transmission_values[k]
+	std::vector<PedigreeColumnCostComputer> cost_computers;
+	std::vector<unsigned int> transmission_values;
+	size_t transmission_configurations;
+};
+
+#endif
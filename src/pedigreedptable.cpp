@@ -6,26 +6,75 @@
 #include <algorithm>
 #include <cmath>
 #include <vector>
+#include <thread>
+#include <exception>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <cstring>
 
 #include "pedigreecolumncostcomputer.h"
+#include "pedigreecolumncostengine.h"
 #include "pedigreedptable.h"
+#include "transmissionkernel.h"
+#include "instrumentation.h"
 
 using namespace std;
 
-PedigreeDPTable::PedigreeDPTable(ReadSet* read_set, const vector<unsigned int>& recombcost, const Pedigree* pedigree, bool distrust_genotypes, const vector<unsigned int>* positions) :
+// DP columns are only split among threads if each thread gets at least this many bipartitions
+static const unsigned int MIN_ROWS_PER_THREAD = 1u << 12;
+
+// costs (or indices) for all transmission values of a DP row, in a fixed-size array if their
+// number N is known at compile time (N > 0)
+template <unsigned int N>
+struct transmission_costs_t {
+	std::array<unsigned int, N> values;
+	transmission_costs_t(unsigned int) {}
+	unsigned int* data() { return values.data(); }
+	unsigned int operator[](unsigned int i) const { return values[i]; }
+};
+
+template <>
+struct transmission_costs_t<0> {
+	std::vector<unsigned int> values;
+	transmission_costs_t(unsigned int configurations) : values(configurations) {}
+	unsigned int* data() { return values.data(); }
+	unsigned int operator[](unsigned int i) const { return values[i]; }
+};
+
+// adds a value to a column key (using the finalizer of splitmix64)
+static uint64_t mix_key(uint64_t key, uint64_t value) {
+	uint64_t x = key ^ (value + 0x9e3779b97f4a7c15ULL + (key << 6) + (key >> 2));
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+PedigreeDPTable::PedigreeDPTable(ReadSet* read_set, const vector<unsigned int>& recombcost, const Pedigree* pedigree, bool distrust_genotypes, const vector<unsigned int>* positions, unsigned int threads, checkpoint_policy_t checkpoint_policy, size_t memory_limit, bool incremental, PedigreeDPTable* previous) :
 	read_set(read_set),
 	recombcost(recombcost),
 	pedigree(pedigree),
 	distrust_genotypes(distrust_genotypes),
+	threads(threads),
+	checkpoint_policy(checkpoint_policy),
+	memory_limit(memory_limit),
+	incremental(incremental),
+	topology(get_pedigree_topology(*pedigree)),
+	pedigree_partitions(topology->get_partitions()),
 	optimal_score(0u),
 	optimal_score_index(0u),
-	input_column_iterator(*read_set, positions)
+	computed_columns(0)
 {
 	read_set->reassignReadIds();
-
-	// create all pedigree partitions
-	for (size_t i=0; i<std::pow(4, pedigree->triple_count()); ++i) {
-		pedigree_partitions.push_back(new PedigreePartitions(*pedigree, i));
+	input_columns.reset(new PackedColumns(*read_set, positions));
+
+	// pick the row kernel once for the whole table
+	transmission_configurations = 1u << (2 * pedigree->triple_count());
+	switch (transmission_configurations) {
+		case 1: column_rows_kernel = &PedigreeDPTable::compute_column_rows_impl<1>; break;
+		case 4: column_rows_kernel = &PedigreeDPTable::compute_column_rows_impl<4>; break;
+		case 16: column_rows_kernel = &PedigreeDPTable::compute_column_rows_impl<16>; break;
+		default: column_rows_kernel = &PedigreeDPTable::compute_column_rows_impl<0>;
 	}
 
 	// translate all individual ids to individual indices
@@ -33,47 +82,33 @@ PedigreeDPTable::PedigreeDPTable(ReadSet* read_set, const vector<unsigned int>&
 		read_sources.push_back(pedigree->id_to_index(read_set->get(i)->getSampleID()));
 	}
 
-	compute_table();
+	compute_column_keys();
+	compute_feasible_transmission_values();
+	compute_table(previous);
 }
 
 
 PedigreeDPTable::~PedigreeDPTable() {
-	init(projection_column_table, 0);
-	init(index_backtrace_table, 0);
-	init(transmission_backtrace_table, 0);
+	release(projection_column_table, 0);
+	release(index_backtrace_table, 0);
+	release(transmission_backtrace_table, 0);
 	init(indexers, 0);
-	init(pedigree_partitions, 0);
-}
-
-
-unique_ptr<vector<unsigned int> > PedigreeDPTable::extract_read_ids(const vector<const Entry *>& entries) {
-	unique_ptr<vector<unsigned int> > read_ids(new vector<unsigned int>());
-	for (size_t i=0; i<entries.size(); ++i) {
-		read_ids->push_back(entries[i]->get_read_id());
-	}
-	return read_ids;
-}
-
-
-size_t PedigreeDPTable::popcount(size_t x) {
-	unsigned int count = 0;
-	for (;x; x >>= 1) {
-		count += x & 1;
-	}
-	return count;
 }
 
 
 void PedigreeDPTable::clear_table() {
-	size_t column_count = input_column_iterator.get_column_count();
+	size_t column_count = input_columns->get_column_count();
 
-	init(projection_column_table, column_count);
-	init(index_backtrace_table, column_count);
-	init(transmission_backtrace_table, column_count);
+	release(projection_column_table, column_count);
+	release(index_backtrace_table, column_count);
+	release(transmission_backtrace_table, column_count);
 	init(indexers, column_count);
 
 	index_path.clear();
 
+	stored_memory = 0;
+	peak_memory = 0;
+
 	optimal_score = numeric_limits<unsigned int>::max();
 	optimal_score_index = 0;
 	optimal_transmission_value = 0;
@@ -81,76 +116,257 @@ void PedigreeDPTable::clear_table() {
 }
 
 
-void PedigreeDPTable::compute_table() {
+void PedigreeDPTable::compute_column_keys() {
+	size_t column_count = input_columns->get_column_count();
+	column_keys.assign(column_count, 0);
+	for (size_t column_index = 0; column_index < column_count; ++column_index) {
+		PackedColumn column = input_columns->get_column(column_index);
+		vector<unsigned int> previous_reads;
+		vector<unsigned int> next_reads;
+		if (column_index > 0) {
+			previous_reads = input_columns->get_column(column_index - 1).get_read_ids();
+		}
+		if (column_index + 1 < column_count) {
+			next_reads = input_columns->get_column(column_index + 1).get_read_ids();
+		}
+
+		uint64_t key = mix_key(0, input_columns->get_positions()->at(column_index));
+		key = mix_key(key, recombcost[column_index]);
+		for (size_t individuals_index = 0; individuals_index < pedigree->size(); ++individuals_index) {
+			if (distrust_genotypes) {
+				const PhredGenotypeLikelihoods* gls = pedigree->get_genotype_likelihoods(individuals_index, column_index);
+				if (gls == nullptr) {
+					key = mix_key(key, numeric_limits<uint64_t>::max());
+					continue;
+				}
+				for (double gl : gls->as_vector()) {
+					uint64_t bits;
+					memcpy(&bits, &gl, sizeof(bits));
+					key = mix_key(key, bits);
+				}
+			} else {
+				const Genotype* genotype = pedigree->get_genotype(individuals_index, column_index);
+				key = mix_key(key, genotype == nullptr ? numeric_limits<uint64_t>::max() : genotype->get_index());
+			}
+		}
+		// read ids within a column are ascending, so links to the neighboring columns can be found by binary search
+		for (size_t i = 0; i < column.size(); ++i) {
+			unsigned int read_id = column.get_read_id(i);
+			uint64_t in_previous = binary_search(previous_reads.begin(), previous_reads.end(), read_id);
+			uint64_t in_next = binary_search(next_reads.begin(), next_reads.end(), read_id);
+			key = mix_key(key, read_sources[read_id]);
+			key = mix_key(key, ((uint64_t)column.get_allele_type(i) << 2) | (in_previous << 1) | in_next);
+			key = mix_key(key, column.get_phred_score(i));
+		}
+		column_keys[column_index] = key;
+	}
+}
+
+
+void PedigreeDPTable::compute_feasible_transmission_values() {
+	size_t column_count = input_columns->get_column_count();
+	all_transmission_values.resize(transmission_configurations);
+	for (unsigned int i = 0; i < transmission_configurations; ++i) {
+		all_transmission_values[i] = i;
+	}
+	feasible_transmission_values.assign(column_count, all_transmission_values);
+	if (distrust_genotypes) {
+		return;
+	}
+	vector<const Genotype*> genotypes(pedigree->size());
+	for (size_t column_index = 0; column_index < column_count; ++column_index) {
+		for (size_t individuals_index = 0; individuals_index < pedigree->size(); ++individuals_index) {
+			genotypes[individuals_index] = pedigree->get_genotype(individuals_index, column_index);
+		}
+		vector<unsigned int>& feasible = feasible_transmission_values[column_index];
+		feasible.clear();
+		for (unsigned int i = 0; i < transmission_configurations; ++i) {
+			if (!pedigree_partitions[i]->get_compatible_assignments(genotypes).empty()) {
+				feasible.push_back(i);
+			}
+		}
+	}
+}
+
+
+bool PedigreeDPTable::can_reuse(const PedigreeDPTable& previous) const {
+	return (previous.topology == topology)
+		&& (previous.distrust_genotypes == distrust_genotypes)
+		&& !previous.column_keys.empty()
+		&& (previous.index_path.size() == previous.column_keys.size());
+}
+
+
+void PedigreeDPTable::compute_table(PedigreeDPTable* previous) {
 	clear_table();
 
 	// empty read-set, nothing to phase, so MEC score is 0
-	if (input_column_iterator.get_column_count() == 0) {
+	size_t column_count = input_columns->get_column_count();
+	if (column_count == 0) {
 		optimal_score = 0;
 		optimal_score_index = 0;
 		return;
 	}
 
-	input_column_iterator.jump_to_column(0);
-	unique_ptr<vector<const Entry *> > current_input_column;
-	unique_ptr<vector<const Entry *> > next_input_column;
-	// get the next column ahead of time
-	next_input_column = input_column_iterator.get_next();
-	unique_ptr<vector<unsigned int> > next_read_ids = extract_read_ids(*next_input_column);
-	ColumnIndexingScheme* next_indexer = new ColumnIndexingScheme(0, *next_read_ids);
-	indexers[0] = next_indexer;
-
-	// forward pass: create a sparse table, storing values at every sqrt(#columns)-th position,
-	size_t k = (size_t)sqrt(input_column_iterator.get_column_count());
-	for (size_t column_index=0; column_index<input_column_iterator.get_column_count(); ++column_index) {
-		// make former next column the current one
-		current_input_column = std::move(next_input_column);
-		unique_ptr<vector<unsigned int> > current_read_ids = std::move(next_read_ids);
-
-		ColumnIndexingScheme* current_indexer = next_indexer;
-		// peek ahead and get the next column
-		if (input_column_iterator.has_next()) {
-			next_input_column = input_column_iterator.get_next();
-			next_read_ids = extract_read_ids(*next_input_column);
-			next_indexer = new ColumnIndexingScheme(current_indexer,*next_read_ids);
-			current_indexer->set_next_column(next_indexer);
-			indexers[column_index + 1] = next_indexer;
-		} else {
-			assert(next_input_column.get() == 0);
-			assert(next_read_ids.get() == 0);
-			next_indexer = 0;
+	// create indexing schemes for all columns ahead of time
+	for (size_t column_index=0; column_index<column_count; ++column_index) {
+		ColumnIndexingScheme* previous_indexer = (column_index > 0) ? indexers[column_index-1] : nullptr;
+		indexers[column_index] = new ColumnIndexingScheme(previous_indexer, input_columns->get_column(column_index).get_read_ids());
+		if (previous_indexer != nullptr) {
+			previous_indexer->set_next_column(indexers[column_index]);
+		}
+	}
+
+	if (checkpoint_policy == CHECKPOINT_AUTO) {
+		vector<size_t> memory(column_count);
+		for (size_t column_index=0; column_index<column_count; ++column_index) {
+			memory[column_index] = column_memory(column_index);
+		}
+		checkpoint_policy = choose_checkpoint_policy(memory, memory_limit);
+	}
+
+	compute_component_starts((previous == nullptr) && !incremental);
+
+	// determine which columns to keep during the forward pass (separately for each component)
+	vector<bool> keep(column_count, true);
+	if (checkpoint_policy == CHECKPOINT_LOG) {
+		keep.assign(column_count, false);
+	}
+	for (size_t c = 0; c < component_starts.size(); ++c) {
+		size_t first = component_starts[c];
+		size_t end = (c + 1 < component_starts.size()) ? component_starts[c+1] : column_count;
+		if (checkpoint_policy == CHECKPOINT_SQRT) {
+			// store values at every sqrt(#columns)-th position
+			size_t k = (size_t)sqrt(end - first);
+			if (k > 1) {
+				for (size_t column_index=first; column_index<end; ++column_index) {
+					keep[column_index] = ((column_index - first) % k) == 0;
+				}
+			}
+		} else if (checkpoint_policy == CHECKPOINT_LOG) {
+			mark_checkpoints((long)first - 1, (long)end - 2, &keep);
+		}
+	}
+
+	// Find the longest prefix and suffix of columns that agree with the previous table. The projection
+	// columns of the prefix are the same in both tables. In the suffix, column c of this table corresponds to
+	// column c - shift of the previous table.
+	size_t prefix = 0;
+	size_t suffix = 0;
+	long shift = 0;
+	if ((previous != nullptr) && can_reuse(*previous)) {
+		size_t previous_count = previous->column_keys.size();
+		shift = (long)column_count - (long)previous_count;
+		while ((prefix < min(column_count, previous_count)) && (column_keys[prefix] == previous->column_keys[prefix])) {
+			++prefix;
+		}
+		while ((suffix < min(column_count, previous_count) - prefix) && (column_keys[column_count - 1 - suffix] == previous->column_keys[previous_count - 1 - suffix])) {
+			++suffix;
+		}
+	} else {
+		previous = nullptr;
+	}
+
+	// nothing has changed: take over all results
+	if ((previous != nullptr) && (prefix == column_count) && (shift == 0)) {
+		for (size_t column_index=0; column_index<column_count; ++column_index) {
+			if (incremental) {
+				take_over_column(previous, column_index, column_index, 0);
+			}
+			previous->delete_column(column_index);
+		}
+		optimal_score = previous->optimal_score;
+		optimal_score_index = previous->optimal_score_index;
+		optimal_transmission_value = previous->optimal_transmission_value;
+		previous_transmission_value = previous->previous_transmission_value;
+		index_path = previous->index_path;
+		return;
+	}
+
+	// take over the stored columns of the prefix and keep the stored columns of the suffix for comparison
+	vector<Vector2D<unsigned int>*> suffix_projections(column_count, nullptr);
+	if (previous != nullptr) {
+		for (size_t column_index=0; column_index<prefix; ++column_index) {
+			if (previous->projection_column_table[column_index] != nullptr) {
+				take_over_column(previous, column_index, column_index, 0);
+				keep[column_index] = true;
+			}
+		}
+		for (size_t column_index=column_count-suffix; column_index+1<column_count; ++column_index) {
+			suffix_projections[column_index] = previous->projection_column_table[column_index - shift];
 		}
+	}
 
-		compute_column(column_index, std::move(current_input_column));
+	// first column, whose costs equal the ones of the previous table up to a constant (if any)
+	size_t converged_column = column_count;
+	int64_t offset = 0;
+	{
+		instrumentation::ScopedTimer timer(PEDIGREE_FORWARD_NS);
+		if (previous == nullptr) {
+			compute_components(keep);
+		} else {
+			// forward pass, starting after the prefix
+			size_t first_column = prefix;
+			if (first_column > 0) {
+				restore_column(first_column - 1);
+			}
+			for (size_t column_index=first_column; column_index<column_count; ++column_index) {
+				compute_column(column_index, threads);
+				// determine whether to delete previous column (to save space)
+				if ((column_index > 0) && !keep[column_index-1]) {
+					delete_column(column_index-1);
+				}
+				if ((suffix_projections[column_index] != nullptr) && equal_up_to_offset(*projection_column_table[column_index], *suffix_projections[column_index], &offset)) {
+					converged_column = column_index;
+					keep[column_index] = true;
+					break;
+				}
+			}
+		}
+	}
 
-		// determine whether to delete previous column (to save space)
-		if ((k>1) && (column_index > 0) && (((column_index-1)%k) != 0)) {
-			delete index_backtrace_table[column_index-1];
-			delete transmission_backtrace_table[column_index-1];
-			delete projection_column_table[column_index-1];
-			index_backtrace_table[column_index-1] = nullptr;
-			transmission_backtrace_table[column_index-1] = nullptr;
-			projection_column_table[column_index-1] = nullptr;
+	// all following columns are the previous ones plus the offset, and so is the optimal score
+	if (converged_column < column_count) {
+		for (size_t column_index=converged_column+1; column_index+1<column_count; ++column_index) {
+			if (previous->projection_column_table[column_index - shift] != nullptr) {
+				take_over_column(previous, column_index - shift, column_index, offset);
+				keep[column_index] = true;
+			}
 		}
+		optimal_score = (unsigned int)((int64_t)previous->optimal_score + offset);
+		optimal_score_index = previous->optimal_score_index;
+		optimal_transmission_value = previous->optimal_transmission_value;
+		previous_transmission_value = previous->previous_transmission_value;
 	}
 
 	// perform a backtrace to get optimal path
+	instrumentation::ScopedTimer backtrace_timer(PEDIGREE_BACKTRACE_NS);
 	index_path.assign(indexers.size(), index_and_inheritance_t());
 	index_and_inheritance_t v;
 	unsigned int prev_inheritance_value = previous_transmission_value;
 	v.index = optimal_score_index;
 	v.inheritance_value = optimal_transmission_value;
 	index_path[indexers.size()-1] = v;
-	for(size_t i = indexers.size()-1; i > 0; --i) { // backtrack through table
-		// ensure that index_backtrace_table[i-1] and transmission_backtrace_table[i-1] exist
-		if (projection_column_table[i-1] == nullptr) {
-			// compute index of last previous column that has been stored
-			size_t j = (i-1) / k * k;
-			assert(projection_column_table[j] != nullptr);
-			for (j=j+1; j<i; ++j) {
-				compute_column(j);
-			}
+	size_t i = indexers.size()-1;
+	if (converged_column + 1 < column_count) {
+		// the backtrace through the columns after the converged one is the same as in the previous table
+		for (size_t column_index=converged_column+1; column_index<column_count; ++column_index) {
+			index_path[column_index] = previous->index_path[column_index - shift];
+		}
+		v = index_path[converged_column+1];
+		prev_inheritance_value = previous->index_path[converged_column - shift].inheritance_value;
+		i = converged_column + 1;
+	}
+	for(; i > 0; --i) { // backtrack through table
+		// once the backtrace reaches the previous optimal path in the prefix, it stays on it
+		if ((previous != nullptr) && (i < prefix)
+			&& (v.index == previous->index_path[i].index) && (v.inheritance_value == previous->index_path[i].inheritance_value)
+			&& (prev_inheritance_value == previous->index_path[i-1].inheritance_value)) {
+			copy(previous->index_path.begin(), previous->index_path.begin() + i, index_path.begin());
+			break;
 		}
+		// ensure that index_backtrace_table[i-1] and transmission_backtrace_table[i-1] exist
+		restore_column(i-1);
 		// compute index and transmission value for the current column
 		unique_ptr<ColumnIndexingIterator> iterator = indexers[i]->get_iterator();
 		unsigned int backtrace_index = iterator->index_backward_projection(v.index);
@@ -159,23 +375,243 @@ void PedigreeDPTable::compute_table() {
 		prev_inheritance_value = transmission_backtrace_table[i-1]->at(backtrace_index, v.inheritance_value);
 		index_path[i-1] = v;
 		// free parts of the DP table no longer needed
-		if (i%k == 0) {
-			for (size_t j=i; (j<i+k) && (j<input_column_iterator.get_column_count()-1); ++j) {
-				assert(projection_column_table[j] != nullptr);
-				delete index_backtrace_table[j];
-				delete transmission_backtrace_table[j];
-				delete projection_column_table[j];
-				index_backtrace_table[j] = nullptr;
-				transmission_backtrace_table[j] = nullptr;
-				projection_column_table[j] = nullptr;
+		if (!incremental || !keep[i-1]) {
+			delete_column(i-1);
+		}
+	}
+
+	// free all columns, except for the kept ones of an incremental table
+	for (size_t column_index=0; column_index<column_count; ++column_index) {
+		if (!incremental || !keep[column_index]) {
+			delete_column(column_index);
+		}
+	}
+
+	// columns of the previous table not taken over are not needed anymore
+	if (previous != nullptr) {
+		for (size_t column_index=0; column_index<previous->projection_column_table.size(); ++column_index) {
+			previous->delete_column(column_index);
+		}
+	}
+}
+
+
+void PedigreeDPTable::compute_component_starts(bool split) {
+	component_starts.assign(1, 0);
+	if (!split || (pedigree->triple_count() > 0)) {
+		return;
+	}
+	// a column shares no reads with its predecessor if its backward projection is empty
+	for (size_t column_index=1; column_index<indexers.size(); ++column_index) {
+		if (indexers[column_index]->get_backward_projection_width() == 0) {
+			component_starts.push_back(column_index);
+		}
+	}
+}
+
+
+size_t PedigreeDPTable::component_start(size_t column_index) const {
+	return *(upper_bound(component_starts.begin(), component_starts.end(), column_index) - 1);
+}
+
+
+unsigned int PedigreeDPTable::compute_component(size_t first, size_t end, const vector<bool>& keep, unsigned int column_threads) {
+	for (size_t column_index=first; column_index<end; ++column_index) {
+		compute_column(column_index, column_threads);
+		if ((column_index > first) && !keep[column_index-1]) {
+			delete_column(column_index-1);
+		}
+	}
+	if (end == indexers.size()) {
+		return 0;
+	}
+	// the forward projection of the last column of a component has a single entry: the optimal score
+	unsigned int score = projection_column_table[end-1]->at(0, 0);
+	if (!keep[end-1]) {
+		delete_column(end-1);
+	}
+	return score;
+}
+
+
+void PedigreeDPTable::compute_components(const vector<bool>& keep) {
+	size_t component_count = component_starts.size();
+	vector<size_t> ends(component_starts.begin() + 1, component_starts.end());
+	ends.push_back(indexers.size());
+	vector<unsigned int> scores(component_count, 0);
+
+	if ((threads <= 1) || (component_count == 1)) {
+		for (size_t c = 0; c < component_count; ++c) {
+			scores[c] = compute_component(component_starts[c], ends[c], keep, threads);
+		}
+	} else {
+		// process the most expensive components first, the cost of a column being its number of bipartitions
+		vector<pair<uint64_t, size_t> > jobs;
+		for (size_t c = 0; c < component_count; ++c) {
+			uint64_t cost = 0;
+			for (size_t column_index=component_starts[c]; column_index<ends[c]; ++column_index) {
+				cost += indexers[column_index]->column_size();
+			}
+			jobs.emplace_back(cost, c);
+		}
+		stable_sort(jobs.begin(), jobs.end(), [](const pair<uint64_t, size_t>& a, const pair<uint64_t, size_t>& b) { return a.first > b.first; });
+
+		unsigned int worker_count = (unsigned int)min<size_t>(threads, component_count);
+		unsigned int column_threads = max(1u, threads / worker_count);
+		atomic<size_t> next_job(0);
+		vector<thread> workers;
+		vector<exception_ptr> errors(worker_count);
+		for (unsigned int w = 0; w < worker_count; ++w) {
+			workers.emplace_back([&, w]() {
+				try {
+					for (size_t job = next_job++; job < jobs.size(); job = next_job++) {
+						size_t c = jobs[job].second;
+						scores[c] = compute_component(component_starts[c], ends[c], keep, column_threads);
+					}
+				} catch (...) {
+					errors[w] = current_exception();
+				}
+			});
+		}
+		for (auto& worker : workers) {
+			worker.join();
+		}
+		for (auto& error : errors) {
+			if (error) {
+				rethrow_exception(error);
+			}
+		}
+	}
+
+	for (unsigned int score : scores) {
+		optimal_score += score;
+	}
+}
+
+
+void PedigreeDPTable::take_over_column(PedigreeDPTable* previous, size_t previous_index, size_t column_index, int64_t offset) {
+	if (previous->projection_column_table[previous_index] == nullptr) {
+		return;
+	}
+	size_t memory = previous->stored_column_memory(previous_index);
+	previous->stored_memory -= memory;
+	projection_column_table[column_index] = previous->projection_column_table[previous_index];
+	index_backtrace_table[column_index] = previous->index_backtrace_table[previous_index];
+	transmission_backtrace_table[column_index] = previous->transmission_backtrace_table[previous_index];
+	previous->projection_column_table[previous_index] = nullptr;
+	previous->index_backtrace_table[previous_index] = nullptr;
+	previous->transmission_backtrace_table[previous_index] = nullptr;
+	stored_memory += memory;
+	peak_memory = std::max(peak_memory, stored_memory);
+
+	if (offset != 0) {
+		Vector2D<unsigned int>* projection_column = projection_column_table[column_index];
+		for (size_t j = 0; j < projection_column->get_size0(); ++j) {
+			for (size_t t = 0; t < projection_column->get_size1(); ++t) {
+				unsigned int value = projection_column->at(j, t);
+				if (value != numeric_limits<unsigned int>::max()) {
+					projection_column->set(j, t, (unsigned int)((int64_t)value + offset));
+				}
+			}
+		}
+	}
+}
+
+
+bool PedigreeDPTable::equal_up_to_offset(const Vector2D<unsigned int>& column, const Vector2D<unsigned int>& previous_column, int64_t* offset) {
+	if ((column.get_size0() != previous_column.get_size0()) || (column.get_size1() != previous_column.get_size1())) {
+		return false;
+	}
+	bool offset_known = false;
+	for (size_t j = 0; j < column.get_size0(); ++j) {
+		for (size_t t = 0; t < column.get_size1(); ++t) {
+			unsigned int value = column.at(j, t);
+			unsigned int previous_value = previous_column.at(j, t);
+			if ((value == numeric_limits<unsigned int>::max()) || (previous_value == numeric_limits<unsigned int>::max())) {
+				if (value != previous_value) {
+					return false;
+				}
+				continue;
+			}
+			int64_t difference = (int64_t)value - (int64_t)previous_value;
+			if (!offset_known) {
+				*offset = difference;
+				offset_known = true;
+			} else if (difference != *offset) {
+				return false;
 			}
 		}
 	}
+	return offset_known;
 }
 
 
-void PedigreeDPTable::compute_column(size_t column_index, unique_ptr<vector<const Entry*>> current_input_column) {
-	assert(column_index < input_column_iterator.get_column_count());
+size_t PedigreeDPTable::column_memory(size_t column_index) {
+	// the last column has no forward projection
+	if (column_index + 1 >= indexers.size()) {
+		return 0;
+	}
+	size_t entries = (size_t)transmission_configurations * indexers[column_index]->forward_projection_size();
+	size_t bits = 8 * sizeof(unsigned int)
+		+ PackedVector2D::bits_needed(indexers[column_index]->column_size())
+		+ PackedVector2D::bits_needed(transmission_configurations);
+	return entries * bits / 8;
+}
+
+
+void PedigreeDPTable::restore_column(size_t column_index) {
+	if (projection_column_table[column_index] != nullptr) {
+		return;
+	}
+	// find closest stored column to the left within the component (or start from the component's first column)
+	long start = (long)component_start(column_index);
+	long first = (long)column_index - 1;
+	while ((first >= start) && (projection_column_table[first] == nullptr)) {
+		--first;
+	}
+	vector<bool> keep(column_index + 1, true);
+	if (checkpoint_policy == CHECKPOINT_LOG) {
+		keep.assign(column_index + 1, false);
+		mark_checkpoints(first, column_index, &keep);
+	}
+	instrumentation::add(PEDIGREE_RECOMPUTED_COLUMNS, column_index - first);
+	for (size_t j = first + 1; j <= column_index; ++j) {
+		compute_column(j, threads);
+		if ((j > (size_t)(first + 1)) && !keep[j-1]) {
+			delete_column(j-1);
+		}
+	}
+	assert(projection_column_table[column_index] != nullptr);
+}
+
+
+size_t PedigreeDPTable::stored_column_memory(size_t column_index) const {
+	if (projection_column_table[column_index] == nullptr) {
+		return 0;
+	}
+	return sizeof(unsigned int) * projection_column_table[column_index]->get_size0() * projection_column_table[column_index]->get_size1()
+		+ index_backtrace_table[column_index]->memory()
+		+ transmission_backtrace_table[column_index]->memory();
+}
+
+
+void PedigreeDPTable::delete_column(size_t column_index) {
+	size_t memory = stored_column_memory(column_index);
+	{
+		lock_guard<mutex> lock(memory_mutex);
+		stored_memory -= memory;
+	}
+	ColumnArena<PackedVector2D>::instance().release(index_backtrace_table[column_index]);
+	ColumnArena<PackedVector2D>::instance().release(transmission_backtrace_table[column_index]);
+	ColumnArena<Vector2D<unsigned int> >::instance().release(projection_column_table[column_index]);
+	index_backtrace_table[column_index] = nullptr;
+	transmission_backtrace_table[column_index] = nullptr;
+	projection_column_table[column_index] = nullptr;
+}
+
+
+void PedigreeDPTable::compute_column(size_t column_index, unsigned int column_threads) {
+	assert(column_index < input_columns->get_column_count());
 
 	// check whether requested column is already there
 	if (projection_column_table[column_index] != nullptr) {
@@ -186,152 +622,215 @@ void PedigreeDPTable::compute_column(size_t column_index, unique_ptr<vector<cons
 
 	ColumnIndexingScheme* current_indexer = indexers[column_index];
 	assert(current_indexer != nullptr);
+	++computed_columns;
 
-	// compute the number of different transmission vectors
-	unsigned int transmission_configurations = std::pow(4, pedigree->triple_count());
-
-	// if current input column was not provided, then create it
-	if (current_input_column.get() == nullptr) {
-		input_column_iterator.jump_to_column(column_index);
-		current_input_column = input_column_iterator.get_next();
-	}
+	PackedColumn current_input_column = input_columns->get_column(column_index);
 
 	// reserve memory for the current DP column
-	Vector2D<unsigned int> dp_column(current_indexer->column_size(), transmission_configurations, 0);
+	unsigned int column_size = current_indexer->column_size();
+	if (instrumentation::is_enabled()) {
+		instrumentation::add(PEDIGREE_COLUMNS, 1);
+		instrumentation::record_max(PEDIGREE_MAX_COLUMN_SIZE, column_size);
+		instrumentation::add(PEDIGREE_COLUMN_BYTES, column_memory(column_index));
+	}
 
-	// obtain previous projection column (which is assumed to have been already computed)
+	// obtain previous projection column (which is assumed to have been already computed), unless the
+	// column starts a component
 	Vector2D<unsigned int>* previous_projection_column = nullptr;
-	if (column_index > 0) {
+	if (column_index != component_start(column_index)) {
 		previous_projection_column = projection_column_table[column_index - 1];
 	}
 
-	// initialize forward projection column and associated backtrace columns,
+	// split the bipartitions into contiguous ranges to be processed in parallel
+	unsigned int chunk_count = 1;
+	if (column_threads > 1) {
+		chunk_count = std::max(1u, std::min(column_threads, column_size / MIN_ROWS_PER_THREAD));
+	}
+	vector<column_chunk_t> chunks(chunk_count);
+
+	// initialize forward projection column and associated backtrace columns for each chunk,
 	// if existing (i.e. if not last column)
-	Vector2D<unsigned int>* current_projection_column = nullptr;
-	Vector2D<unsigned int>* transmission_backtrace_column = nullptr;
-	Vector2D<unsigned int>* index_backtrace_column = nullptr;
-	if (column_index + 1 < input_column_iterator.get_column_count()) {
-		current_projection_column = new Vector2D<unsigned int>(
-			current_indexer->forward_projection_size(),
-			transmission_configurations,
-			numeric_limits<unsigned int>::max()
-		);
-		transmission_backtrace_column = new Vector2D<unsigned int>(
-			current_indexer->forward_projection_size(),
-			transmission_configurations,
-			numeric_limits<unsigned int>::max()
-		);
-		index_backtrace_column = new Vector2D<unsigned int>(
-			current_indexer->forward_projection_size(),
-			transmission_configurations,
-			numeric_limits<unsigned int>::max()
-		);
+	bool last_column = column_index + 1 == input_columns->get_column_count();
+	if (!last_column) {
+		for (auto& chunk : chunks) {
+			chunk.projection_column.reset(ColumnArena<Vector2D<unsigned int> >::instance().acquire(
+				current_indexer->forward_projection_size(),
+				transmission_configurations,
+				numeric_limits<unsigned int>::max()
+			));
+			chunk.transmission_backtrace_column.reset(ColumnArena<PackedVector2D>::instance().acquire(
+				current_indexer->forward_projection_size(),
+				transmission_configurations,
+				PackedVector2D::bits_needed(transmission_configurations)
+			));
+			chunk.index_backtrace_column.reset(ColumnArena<PackedVector2D>::instance().acquire(
+				current_indexer->forward_projection_size(),
+				transmission_configurations,
+				PackedVector2D::bits_needed(column_size)
+			));
+		}
 	}
 
-	// create column cost computers
-	vector<PedigreeColumnCostComputer> cost_computers;
-	cost_computers.reserve(transmission_configurations);
-	for(unsigned int i = 0; i < transmission_configurations; ++i) {
-		cost_computers.emplace_back(*current_input_column, column_index, read_sources, pedigree, *pedigree_partitions[i], distrust_genotypes);
+	if (chunk_count == 1) {
+		compute_column_rows(column_index, current_input_column, 0, column_size, previous_projection_column, &chunks[0]);
+	} else {
+		vector<thread> workers;
+		vector<exception_ptr> errors(chunk_count);
+		for (unsigned int c = 0; c < chunk_count; ++c) {
+			unsigned int first_rank = (uint64_t)column_size * c / chunk_count;
+			unsigned int end_rank = (uint64_t)column_size * (c+1) / chunk_count;
+			workers.emplace_back([&, c, first_rank, end_rank]() {
+				try {
+					compute_column_rows(column_index, current_input_column, first_rank, end_rank, previous_projection_column, &chunks[c]);
+				} catch (...) {
+					errors[c] = current_exception();
+				}
+			});
+		}
+		for (auto& worker : workers) {
+			worker.join();
+		}
+		for (auto& error : errors) {
+			if (error) {
+				rethrow_exception(error);
+			}
+		}
+		// merge chunks in rank order, ties are resolved in favor of the earlier chunk
+		column_chunk_t& result = chunks[0];
+		for (unsigned int c = 1; c < chunk_count; ++c) {
+			const column_chunk_t& chunk = chunks[c];
+			if (last_column) {
+				if (chunk.optimal_score < result.optimal_score) {
+					result.optimal_score = chunk.optimal_score;
+					result.optimal_score_index = chunk.optimal_score_index;
+					result.optimal_transmission_value = chunk.optimal_transmission_value;
+					result.previous_transmission_value = chunk.previous_transmission_value;
+				}
+				continue;
+			}
+			for (unsigned int j = 0; j < current_indexer->forward_projection_size(); ++j) {
+				for (unsigned int i = 0; i < transmission_configurations; ++i) {
+					if (chunk.projection_column->at(j, i) < result.projection_column->at(j, i)) {
+						result.projection_column->set(j, i, chunk.projection_column->at(j, i));
+						result.index_backtrace_column->set(j, i, chunk.index_backtrace_column->at(j, i));
+						result.transmission_backtrace_column->set(j, i, chunk.transmission_backtrace_column->at(j, i));
+					}
+				}
+			}
+		}
+	}
+
+	// if last column, then record optimal score, otherwise store computed tables
+	column_chunk_t& result = chunks[0];
+	if (last_column) {
+		if (result.optimal_score < optimal_score) {
+			optimal_score = result.optimal_score;
+			optimal_score_index = result.optimal_score_index;
+			optimal_transmission_value = result.optimal_transmission_value;
+			previous_transmission_value = result.previous_transmission_value;
+		}
+	} else {
+		index_backtrace_table[column_index] = result.index_backtrace_column.release();
+		transmission_backtrace_table[column_index] = result.transmission_backtrace_column.release();
+		projection_column_table[column_index] = result.projection_column.release();
+		size_t memory = stored_column_memory(column_index);
+		lock_guard<mutex> lock(memory_mutex);
+		stored_memory += memory;
+		peak_memory = std::max(peak_memory, stored_memory);
 	}
+}
 
-	// iterate over all bipartitions
-	unique_ptr<ColumnIndexingIterator> iterator = current_indexer->get_iterator();
+
+void PedigreeDPTable::compute_column_rows(size_t column_index, const PackedColumn& current_input_column, unsigned int first_rank, unsigned int end_rank, const Vector2D<unsigned int>* previous_projection_column, column_chunk_t* chunk) {
+	(this->*column_rows_kernel)(column_index, current_input_column, first_rank, end_rank, previous_projection_column, chunk);
+}
+
+
+template <unsigned int N>
+void PedigreeDPTable::compute_column_rows_impl(size_t column_index, const PackedColumn& current_input_column, unsigned int first_rank, unsigned int end_rank, const Vector2D<unsigned int>* previous_projection_column, column_chunk_t* chunk) {
+	// constant if known at compile time, such that all loops over the transmission values are unrolled
+	const unsigned int configurations = (N > 0) ? N : transmission_configurations;
+	assert(configurations == transmission_configurations);
+	ColumnIndexingScheme* current_indexer = indexers[column_index];
+	Vector2D<unsigned int>* current_projection_column = chunk->projection_column.get();
+	PackedVector2D* transmission_backtrace_column = chunk->transmission_backtrace_column.get();
+	PackedVector2D* index_backtrace_column = chunk->index_backtrace_column.get();
+
+	// all other transmission values have infinite costs in this column
+	const vector<unsigned int>& current_values = feasible_transmission_values[column_index];
+	if (current_values.empty()) {
+		throw std::runtime_error("Error: Mendelian conflict");
+	}
+	// the same holds for the previous projection column; without one, all previous costs are zero
+	const vector<unsigned int>& previous_values = (previous_projection_column != nullptr) ? feasible_transmission_values[column_index - 1] : all_transmission_values;
+
+	// create cost engine for all feasible transmission values
+	PedigreeColumnCostEngine cost_engine(current_input_column, column_index, read_sources, pedigree, pedigree_partitions, current_values, distrust_genotypes);
+
+	// min-plus kernel combining current costs, previous projection column and recombination costs,
+	// restricted to pairs of feasible transmission values if not all of them are
+	bool restricted = (current_values.size() < configurations) || (previous_values.size() < configurations);
+	TransmissionKernel kernel = restricted
+		? TransmissionKernel(configurations, recombcost[column_index], current_values, previous_values)
+		: TransmissionKernel(configurations, recombcost[column_index]);
+	transmission_costs_t<N> current_costs(configurations);
+	transmission_costs_t<N> dp_costs(configurations);
+	transmission_costs_t<N> min_recomb_index(configurations);
+
+	// iterate over all bipartitions in the given range
+	unique_ptr<ColumnIndexingIterator> iterator = current_indexer->get_iterator(first_rank, end_rank);
 	while (iterator->has_next()) {
 		int bit_changed = -1;
 		iterator->advance(&bit_changed);
 		if (bit_changed >= 0) {
-			for(auto& cost_computer : cost_computers) {
-				cost_computer.update_partitioning(bit_changed);
-			}
+			cost_engine.update_partitioning(bit_changed);
 		} else {
-			for(auto& cost_computer : cost_computers) {
-				cost_computer.set_partitioning(iterator->get_partition());
-			}
+			cost_engine.set_partitioning(iterator->get_partition());
 		}
 
 		// Determine index in backward projection column from where to fetch the previous cost
 		size_t backward_projection_index = 0;
-		if (column_index > 0) {
+		if (previous_projection_column != nullptr) {
 			backward_projection_index = iterator->get_backward_projection();
 		}
-		// Determine index in the current DP column to be written
-		size_t current_index = iterator->get_index();
-
 		// Compute aggregate cost based on cost in previous and cost in current column
-		vector<unsigned int> min_recomb_index(transmission_configurations);
-		bool found_valid_transmission_vector = false;
-		for (size_t i = 0; i < transmission_configurations; ++i) {
-			// Compute cost incurred by current cell of DP table
-			unsigned int current_cost = cost_computers[i].get_cost();
-			unsigned int min = numeric_limits<unsigned int>::max();
-			size_t min_index = 0;
-			if (current_cost < numeric_limits<unsigned int>::max()) {
-				found_valid_transmission_vector = true;
-			}
-			for (size_t j = 0; j < transmission_configurations; ++j) {
-				// Step 1: add up cost from current_cost column and previous columns
-				unsigned int val;
-				unsigned int previous_cost = 0;
-				if (column_index > 0) {
-					previous_cost = previous_projection_column->at(backward_projection_index,j);
-				}
-				if ((current_cost < numeric_limits<unsigned int>::max()) && (previous_cost < numeric_limits<unsigned int>::max())) {
-					val = current_cost + previous_cost;
-				} else {
-					val = numeric_limits<unsigned int>::max();
-				}
-				// Step 2: add further cost incurred by recombination
-				// change in bit 0 --> recombination in mother
-				size_t x = i ^ j; // count the number of bits set in x
-
-				if (val < numeric_limits<unsigned int>::max()) {
-					val += popcount(x) * recombcost[column_index];
-				}
-
-				// check for new minimum
-				if (val < min) {
-					min = val;
-					min_index = j;
-				}
-			}
-			dp_column.set(current_index, i, min);
-			min_recomb_index[i] = min_index;
+		cost_engine.get_costs(current_costs.data());
+		const unsigned int* previous_costs = nullptr;
+		if (previous_projection_column != nullptr) {
+			previous_costs = &previous_projection_column->at(backward_projection_index, 0);
 		}
-		if (!found_valid_transmission_vector) {
-			throw std::runtime_error("Error: Mendelian conflict");
+		// the row of the DP column is only needed until it has been reduced into the projection column
+		unsigned int* dp_row = dp_costs.data();
+		if (N == 1) {
+			kernel.compute_fixed<N>(current_costs.data(), previous_costs, dp_row, min_recomb_index.data());
+		} else {
+			kernel.compute(current_costs.data(), previous_costs, dp_row, min_recomb_index.data());
 		}
 
 		// if last DP column, then check for new optimal score, otherwise update forward projection and backtrace columns
 		if (current_projection_column == 0) {
 			// update running optimal score index
-			for (size_t i = 0; i < transmission_configurations; ++i) {
-				if (dp_column.at(current_index, i) < optimal_score) {
-					optimal_score = dp_column.at(current_index, i);
-					optimal_score_index = iterator->get_index();
-					optimal_transmission_value = i;
-					previous_transmission_value = min_recomb_index[i];
+			for (unsigned int i = 0; i < configurations; ++i) {
+				if (dp_row[i] < chunk->optimal_score) {
+					chunk->optimal_score = dp_row[i];
+					chunk->optimal_score_index = iterator->get_index();
+					chunk->optimal_transmission_value = i;
+					chunk->previous_transmission_value = min_recomb_index[i];
 				}
 			}
 		} else {
 			unsigned int forward_index = iterator->get_forward_projection();
 			unsigned int it_idx = iterator->get_index();
-			for (unsigned int i = 0; i < transmission_configurations; ++i) {
-				if (dp_column.at(current_index, i) < current_projection_column->at(forward_index,i)) {
-					current_projection_column->set(forward_index, i, dp_column.at(current_index, i));
+			unsigned int* projection_row = &current_projection_column->at(forward_index, 0);
+			for (unsigned int i = 0; i < configurations; ++i) {
+				if (dp_row[i] < projection_row[i]) {
+					projection_row[i] = dp_row[i];
 					index_backtrace_column->set(forward_index, i, it_idx);
-					transmission_backtrace_column->set(forward_index,i, min_recomb_index[i]);
+					transmission_backtrace_column->set(forward_index, i, min_recomb_index[i]);
 				}
 			}
 		}
 	}
-
-	// if not last column, then store computed tables
-	if (current_projection_column != 0) {
-		index_backtrace_table[column_index] = index_backtrace_column;
-		transmission_backtrace_table[column_index] = transmission_backtrace_column;
-		projection_column_table[column_index] = current_projection_column;
-	}
 }
 
 
@@ -341,14 +840,49 @@ unsigned int PedigreeDPTable::get_optimal_score() {
 }
 
 
+size_t PedigreeDPTable::get_peak_memory() {
+	return peak_memory;
+}
+
+
+checkpoint_policy_t PedigreeDPTable::get_checkpoint_policy() {
+	return checkpoint_policy;
+}
+
+
+size_t PedigreeDPTable::get_computed_column_count() {
+	return computed_columns;
+}
+
+
+unsigned int PedigreeDPTable::get_column_count() {
+	return input_columns->get_column_count();
+}
+
+
+unsigned int PedigreeDPTable::get_position(size_t column_index) {
+	return input_columns->get_positions()->at(column_index);
+}
+
+
+vector<PedigreeColumnCostComputer::phased_variant_t> PedigreeDPTable::get_phased_column(size_t column_index, unsigned int* transmission_value) {
+	assert(column_index < index_path.size());
+	assert(transmission_value != nullptr);
+	const index_and_inheritance_t& v = index_path[column_index];
+	PedigreeColumnCostComputer cost_computer(input_columns->get_column(column_index), column_index, read_sources, pedigree, *pedigree_partitions[v.inheritance_value], distrust_genotypes);
+	cost_computer.set_partitioning(v.index);
+	*transmission_value = v.inheritance_value;
+	return cost_computer.get_alleles();
+}
+
+
 void PedigreeDPTable::get_super_reads(std::vector<ReadSet*>* output_read_set, vector<unsigned int>* transmission_vector) {
 	assert(output_read_set != nullptr);
 	assert(output_read_set->size() == pedigree->size());
 	assert(transmission_vector != nullptr);
 	transmission_vector->clear();
 
-	input_column_iterator.jump_to_column(0);
-	const vector<unsigned int>* positions = input_column_iterator.get_positions();
+	const vector<unsigned int>* positions = input_columns->get_positions();
 
 	std::vector<std::pair<Read*,Read*>> superreads;
 	for (unsigned int i=0; i<pedigree->size(); i++) {
@@ -359,25 +893,19 @@ void PedigreeDPTable::get_super_reads(std::vector<ReadSet*>* output_read_set, ve
 	}
 
 	if (index_backtrace_table.empty()) {
-		assert(!input_column_iterator.has_next());
+		assert(input_columns->get_column_count() == 0);
 	} else {
-		// run through the file again with the input_column_iterator
-		unsigned int i = 0; // column index
-		while (input_column_iterator.has_next()) {
-			const index_and_inheritance_t& v = index_path[i];
-			unique_ptr<vector<const Entry *> > column = input_column_iterator.get_next();
-			PedigreeColumnCostComputer cost_computer(*column, i, read_sources, pedigree, *pedigree_partitions[v.inheritance_value], distrust_genotypes);
-			cost_computer.set_partitioning(v.index);
-
-			auto population_alleles = cost_computer.get_alleles();
+		// run through all input columns again
+		for (unsigned int i = 0; i < input_columns->get_column_count(); ++i) {
+			unsigned int transmission_value;
+			auto population_alleles = get_phased_column(i, &transmission_value);
 			
 			// TODO: compute proper weights based on likelihoods.
 			for (unsigned int k=0; k<pedigree->size(); k++) {
 				superreads[k].first->addVariant(positions->at(i), population_alleles[k].allele0, population_alleles[k].quality);
 				superreads[k].second->addVariant(positions->at(i), population_alleles[k].allele1, population_alleles[k].quality);
 			}
-			transmission_vector->push_back(v.inheritance_value);
-			++i; // next column
+			transmission_vector->push_back(transmission_value);
 		}
 	}
 	for(unsigned int k=0;k<pedigree->size();k++) {
@@ -2,17 +2,26 @@
 #define PEDIGREE_DP_TABLE_H
 
 #include <array>
+#include <limits>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
 
 #include "columnindexingscheme.h"
-#include "columniterator.h"
 #include "entry.h"
 #include "read.h"
 #include "readset.h"
 #include "pedigree.h"
 #include "pedigreepartitions.h"
+#include "pedigreecolumncostcomputer.h"
+#include "pedigreetopology.h"
 #include "vector2d.h"
+#include "packedvector2d.h"
+#include "columnarena.h"
+#include "packedcolumns.h"
+#include "checkpointpolicy.h"
 
 typedef struct index_and_inheritance_t {
 	unsigned int index;
@@ -28,7 +37,19 @@ private:
 	const std::vector<unsigned int>& recombcost;
 	const Pedigree* pedigree;
 	bool distrust_genotypes;
-	std::vector<PedigreePartitions*> pedigree_partitions;
+	// number of threads used to process the rows of a single DP column
+	unsigned int threads;
+	// checkpoint policy in effect (never CHECKPOINT_AUTO after construction)
+	checkpoint_policy_t checkpoint_policy;
+	// memory limit (in bytes) used to choose a policy if CHECKPOINT_AUTO was requested
+	size_t memory_limit;
+	// if true, stored (checkpoint) columns are kept after the backtrace, such that a later table can reuse them
+	bool incremental;
+	// pedigree partitions for all transmission values, shared by all DP tables for pedigrees of the same topology
+	std::shared_ptr<const PedigreeTopology> topology;
+	const std::vector<PedigreePartitions*>& pedigree_partitions;
+	// number of transmission values (4^trios)
+	unsigned int transmission_configurations;
 	// vector of indexingschemes
 	std::vector<ColumnIndexingScheme*> indexers;
 	// optimal score and its index in the rightmost DP table column
@@ -41,29 +62,109 @@ private:
 	std::vector<Vector2D<unsigned int>* > projection_column_table;
 	// index_backtrace_table[c][i][t] indicates the index (=bipartition) in column c from which the
 	// i-th entry in the FORWARD projection of column c comes from, assuming a transmission value of t
-	std::vector<Vector2D<unsigned int>* > index_backtrace_table;
+	// stored using ceil(log2(column_size)) bits per entry
+	std::vector<PackedVector2D*> index_backtrace_table;
 	// let x := index_backtrace_table[c][i][t] and dp[x][t] the corresponding DP entry
 	// and j be the BACKWARD projection of x.
 	// Then t' = transmission_backtrace_table[c][i][t] is the transmission index (from {0,1,2,3})
-	// that gave rise to dp[x][t].
-	std::vector<Vector2D<unsigned int>* > transmission_backtrace_table;
-	ColumnIterator input_column_iterator;
+	// that gave rise to dp[x][t]. Stored using 2 bits per trio.
+	std::vector<PackedVector2D*> transmission_backtrace_table;
+	// memory (in bytes) currently used by stored projection and backtrace columns, and its maximum so far
+	size_t stored_memory;
+	size_t peak_memory;
+	// all input columns, built once (after read ids have been reassigned)
+	std::unique_ptr<PackedColumns> input_columns;
+	// column_keys[c] identifies everything column c contributes to the DP: position, recombination cost, genotypes
+	// (or genotype likelihoods) and the entries of all reads, including whether they continue from column c-1 and
+	// into column c+1. Columns with equal keys in two tables are processed identically.
+	std::vector<uint64_t> column_keys;
+	// feasible_transmission_values[c] lists (in ascending order) the transmission values for which at least one
+	// allele assignment in column c is compatible with the genotypes; with distrust_genotypes, all of them.
+	// All DP cells of other transmission values are infinite and are not computed.
+	std::vector<std::vector<unsigned int> > feasible_transmission_values;
+	// 0, ..., transmission_configurations-1
+	std::vector<unsigned int> all_transmission_values;
+	// number of DP columns computed so far (including recomputations)
+	std::atomic<size_t> computed_columns;
+	// first column of every component, i.e. of every maximal range of columns connected by reads (see
+	// compute_component_starts). Without trios, the components are independent of each other.
+	std::vector<size_t> component_starts;
+	// guards stored_memory and peak_memory while components are computed concurrently
+	std::mutex memory_mutex;
 	// optimal path obtained from backtrace
 	std::vector<index_and_inheritance_t> index_path;
 
-	// helper function to pull read ids out of read column
-	std::unique_ptr<std::vector<unsigned int> > extract_read_ids(const std::vector<const Entry *>& entries);
-
 	/** Initializes/clears all member variables associated with the DP table, i.e. indexers, index_backtrace_table,
 	 *  transmission_backtrace_table, optimal_score, optimal_score_index, optimal_transmission_value, and previous_transmission_value. */
 	void clear_table();
-	void compute_table();
-	/** Computes the DP column at the given index, assuming that the previous column
-	 *  has already been computed. */
-	void compute_column(size_t column_index, std::unique_ptr<std::vector<const Entry*>> current_input_column = nullptr);
+	/** Computes column_keys. */
+	void compute_column_keys();
+	/** Computes feasible_transmission_values. */
+	void compute_feasible_transmission_values();
+	/** Runs the forward pass and the backtrace. If previous is given, its stored columns and optimal path are
+	 *  reused where the columns of both tables agree (see constructor). */
+	void compute_table(PedigreeDPTable* previous);
+	/** Computes component_starts. If split is false or the pedigree contains trios (whose transmission vectors
+	 *  link all columns), the whole table is a single component. */
+	void compute_component_starts(bool split);
+	/** Returns the first column of the component containing the given column. */
+	size_t component_start(size_t column_index) const;
+	/** Runs the forward pass over the columns of the component first, ..., end-1 and returns its optimal score
+	 *  (for the last component, the optimal score is recorded as for the whole table and 0 is returned). */
+	unsigned int compute_component(size_t first, size_t end, const std::vector<bool>& keep, unsigned int column_threads);
+	/** Runs the forward pass over all components, concurrently if there are several threads, and records the
+	 *  sum of their optimal scores. */
+	void compute_components(const std::vector<bool>& keep);
+	/** Returns whether the columns of the given table can be reused by this one. */
+	bool can_reuse(const PedigreeDPTable& previous) const;
+	/** Returns the number of bytes needed to store the projection and backtrace columns of the given column. */
+	size_t column_memory(size_t column_index);
+	/** Returns the number of bytes used by the stored projection and backtrace columns at the given index. */
+	size_t stored_column_memory(size_t column_index) const;
+	/** Makes sure the projection and backtrace columns at the given index exist by recomputing
+	 *  them starting from the closest stored column to the left. */
+	void restore_column(size_t column_index);
+	/** Frees the projection and backtrace columns at the given index. */
+	void delete_column(size_t column_index);
+	/** Moves the stored columns at previous_index of the previous table to column_index of this table, adding
+	 *  offset to all finite costs. */
+	void take_over_column(PedigreeDPTable* previous, size_t previous_index, size_t column_index, int64_t offset);
+	/** Returns whether all finite costs of column equal the ones of previous_column plus a constant (stored in offset)
+	 *  and both have the same infinite entries. */
+	static bool equal_up_to_offset(const Vector2D<unsigned int>& column, const Vector2D<unsigned int>& previous_column, int64_t* offset);
+	/** Computes the DP column at the given index using up to column_threads threads, assuming that the
+	 *  previous column has already been computed (unless the column starts a component). */
+	void compute_column(size_t column_index, unsigned int column_threads);
+
+	/** Result of processing a contiguous range of rows of a DP column (see compute_column_rows).
+	 *  For all but the last column, the forward projection column and the associated backtrace
+	 *  columns are filled; for the last column, the optimal score in the range is recorded. */
+	typedef struct column_chunk_t {
+		arena_column_ptr<Vector2D<unsigned int> > projection_column;
+		arena_column_ptr<PackedVector2D> index_backtrace_column;
+		arena_column_ptr<PackedVector2D> transmission_backtrace_column;
+		unsigned int optimal_score;
+		unsigned int optimal_score_index;
+		unsigned int optimal_transmission_value;
+		unsigned int previous_transmission_value;
+		column_chunk_t() : optimal_score(std::numeric_limits<unsigned int>::max()), optimal_score_index(0), optimal_transmission_value(0), previous_transmission_value(0) {};
+	} column_chunk_t;
+
+	/** Processes the rows with Gray code ranks first_rank, ..., end_rank-1 of the given column, writing
+	 *  to the given chunk. Each row of the DP column is reduced into the chunk as soon as it is computed,
+	 *  so the DP column itself is never stored. Rows are processed in rank order and ties are resolved in
+	 *  favor of the first row, such that merging the chunks of a column in rank order gives the same
+	 *  result as processing the whole column at once. */
+	void compute_column_rows(size_t column_index, const PackedColumn& current_input_column, unsigned int first_rank, unsigned int end_rank, const Vector2D<unsigned int>* previous_projection_column, column_chunk_t* chunk);
 
-	/** Returns the number of set bits. */
-	static size_t popcount(size_t x);
+	/** Implementation of compute_column_rows for N transmission values known at compile time (N = 1, 4 or 16,
+	 *  i.e. up to two trios), whose loops over the transmission values are unrolled, or for any number of them
+	 *  if N is 0. The instance used by a table is chosen once in the constructor. */
+	template <unsigned int N>
+	void compute_column_rows_impl(size_t column_index, const PackedColumn& current_input_column, unsigned int first_rank, unsigned int end_rank, const Vector2D<unsigned int>* previous_projection_column, column_chunk_t* chunk);
+
+	typedef void (PedigreeDPTable::*column_rows_kernel_t)(size_t, const PackedColumn&, unsigned int, unsigned int, const Vector2D<unsigned int>*, column_chunk_t*);
+	column_rows_kernel_t column_rows_kernel;
 
 	template <class T>
 	void init(std::vector<T*>& v, size_t size) {
@@ -75,6 +176,15 @@ private:
 		v.assign(size, nullptr);
 	}
 
+	/** Like init, but returns the columns to the column arena instead of deleting them. */
+	template <class T>
+	void release(std::vector<T*>& v, size_t size) {
+		for(size_t i=0; i<v.size(); ++i) {
+			ColumnArena<T>::instance().release(v[i]);
+		}
+		v.assign(size, nullptr);
+	}
+
 public:
 	/** Constructor.
 	 *  @param read_set DP table is constructed for the contained reads. Ownership is retained
@@ -83,13 +193,44 @@ public:
 	 *                            (in the given pedigree object).
 	 *  @param positions Positions to work on. If 0, then all positions given in read_set will be used. Caller retains
 	 *                   ownership.
+	 *  @param threads Number of threads used to process the bipartitions of large DP columns and, for pedigrees
+	 *                 without trios, to process independent components concurrently. The result does not depend
+	 *                 on the number of threads.
+	 *  @param checkpoint_policy Determines which columns are stored during the forward pass (see checkpoint_policy_t).
+	 *                           The result does not depend on the policy.
+	 *  @param memory_limit Memory (in bytes) available for stored columns, only used with CHECKPOINT_AUTO.
+	 *  @param incremental If true, the columns stored according to the checkpoint policy are kept after the
+	 *                     backtrace (instead of being freed), such that a later table can reuse them as previous.
+	 *  @param previous A table computed earlier for the same pedigree from a different version of the reads
+	 *                  (e.g. after adding or removing reads). Stored columns of previous, which are not affected
+	 *                  by the changes, are taken over: columns to the left of the first changed column are not
+	 *                  recomputed, and to the right of the last changed column, columns are only recomputed
+	 *                  until their costs equal the ones of previous up to a constant. The result is the same as
+	 *                  without previous. Afterwards, previous has no stored columns left, but its results can
+	 *                  still be queried. Caller retains ownership.
+	 *
+	 *  For pedigrees without trios (e.g. a single individual), the columns are split into components, between
+	 *  which no read continues. Components are independent, so each one gets its own checkpoints, recomputations
+	 *  during the backtrace stay within a component, and components are processed concurrently. This is not
+	 *  done for incremental tables or when previous is given.
 	 */
-	PedigreeDPTable(ReadSet* read_set, const std::vector<unsigned int>& recombcost, const Pedigree* pedigree, bool distrust_genotypes, const std::vector<unsigned int>* positions = nullptr);
+	PedigreeDPTable(ReadSet* read_set, const std::vector<unsigned int>& recombcost, const Pedigree* pedigree, bool distrust_genotypes, const std::vector<unsigned int>* positions = nullptr, unsigned int threads = 1, checkpoint_policy_t checkpoint_policy = CHECKPOINT_SQRT, size_t memory_limit = 0, bool incremental = false, PedigreeDPTable* previous = nullptr);
  
 	~PedigreeDPTable();
 
 	unsigned int get_optimal_score();
 
+	/** Returns the maximum amount of memory (in bytes) used to store projection and backtrace columns
+	 *  at the same time, including recomputed columns during the backtrace. */
+	size_t get_peak_memory();
+
+	/** Returns the checkpoint policy that has been used (if CHECKPOINT_AUTO was requested, the chosen one). */
+	checkpoint_policy_t get_checkpoint_policy();
+
+	/** Returns the number of DP columns that have been computed, including recomputations during the
+	 *  backtrace. Columns reused from a previous table are not counted. */
+	size_t get_computed_column_count();
+
 	/** Computes optimal haplotypes and adds them (in the form of "super reads") to 
 	 *  the given read_set.
 	 *
@@ -98,6 +239,18 @@ public:
 	 */
 	void get_super_reads(std::vector<ReadSet*>* output_read_set, std::vector<unsigned int>* transmission_vector);
 
+	/** Returns the number of columns. */
+	unsigned int get_column_count();
+
+	/** Returns the genomic position of the given column. */
+	unsigned int get_position(size_t column_index);
+
+	/** Returns the optimal phased variants of all individuals (ordered by their index in the pedigree) at the given
+	 *  column and stores the transmission value used at that column in transmission_value. Columns can be obtained
+	 *  one at a time and in any order, such that callers do not need to hold the super reads of all columns
+	 *  returned by get_super_reads. Each call takes time linear in the number of reads in the column. */
+	std::vector<PedigreeColumnCostComputer::phased_variant_t> get_phased_column(size_t column_index, unsigned int* transmission_value);
+
 	/** Performs a backtrace through the DP table and returns optimal partitioning of the reads.
 	 *  Pointer ownership is transferred to caller. */
 	std::vector<bool>* get_optimal_partitioning();
@@ -1,10 +1,12 @@
 #include <cassert>
+#include <functional>
+#include <map>
 
 #include "pedigreepartitions.h"
 
 using namespace std;
 
-PedigreePartitions::PedigreePartitions(const Pedigree& pedigree, unsigned int transmission_vector) : pedigree(pedigree), transmission_vector(transmission_vector), haplotype_to_partition_map(pedigree.size(), {-1,-1}) {
+PedigreePartitions::PedigreePartitions(const Pedigree& pedigree, unsigned int transmission_vector) : individual_count(pedigree.size()), transmission_vector(transmission_vector), haplotype_to_partition_map(pedigree.size(), {-1,-1}) {
 	partition_count = 2 * (pedigree.size() - pedigree.triple_count());
 	
 	// for each individual the index of the triple in which this individual is a child (-1 for "none")
@@ -22,19 +24,19 @@ PedigreePartitions::PedigreePartitions(const Pedigree& pedigree, unsigned int tr
 		}
 	}
 	for (size_t i=0; i<pedigree.size(); ++i) {
-		compute_haplotype_to_partition_rec(i, triple_indices);
+		compute_haplotype_to_partition_rec(i, triple_indices, pedigree);
 	}
 }
 
 
-void PedigreePartitions::compute_haplotype_to_partition_rec(size_t i,  const vector<int>& triple_indices) {
+void PedigreePartitions::compute_haplotype_to_partition_rec(size_t i,  const vector<int>& triple_indices, const Pedigree& pedigree) {
 	if (haplotype_to_partition_map[i][0] != -1) return;
 	int triple_index = triple_indices[i];
 	assert(triple_index >=0);
 	int parent0 = pedigree.get_triples()[triple_index][0];
 	int parent1 = pedigree.get_triples()[triple_index][1];
-	compute_haplotype_to_partition_rec(parent0, triple_indices);
-	compute_haplotype_to_partition_rec(parent1, triple_indices);
+	compute_haplotype_to_partition_rec(parent0, triple_indices, pedigree);
+	compute_haplotype_to_partition_rec(parent1, triple_indices, pedigree);
 	haplotype_to_partition_map[i] = array<int, 2>{
 	  haplotype_to_partition_map[parent0][!(bool)((transmission_vector >> (2*triple_index)) & 1)],
 	  haplotype_to_partition_map[parent1][!(bool)((transmission_vector >> (2*triple_index+1)) & 1)]
@@ -51,8 +53,83 @@ size_t PedigreePartitions::haplotype_to_partition(size_t individual_index, size_
 	return haplotype_to_partition_map[individual_index][haplotype];
 }
 
+size_t PedigreePartitions::genotypes_hash::operator()(const vector<uint64_t>& genotypes) const {
+	size_t h = genotypes.size();
+	for (uint64_t g : genotypes) {
+		h = h * 31 + std::hash<uint64_t>()(g);
+	}
+	return h;
+}
+
+
+const vector<unsigned int>& PedigreePartitions::get_compatible_assignments(const vector<const Genotype*>& genotypes) const {
+	assert(genotypes.size() == individual_count);
+	// genotypes are identified by ploidy and canonical index
+	vector<uint64_t> key;
+	key.reserve(individual_count);
+	for (const Genotype* genotype : genotypes) {
+		key.push_back((genotype->get_index() << 4) | genotype->get_ploidy());
+	}
+	lock_guard<mutex> lock(compatible_assignments_mutex);
+	auto it = compatible_assignments.find(key);
+	if (it != compatible_assignments.end()) {
+		return it->second;
+	}
+	vector<unsigned int>& assignments = compatible_assignments[key];
+	for (unsigned int i = 0; i < (1u << partition_count); ++i) {
+		bool genotypes_compatible = true;
+		for (size_t individuals_index = 0; individuals_index < individual_count; ++individuals_index) {
+			unsigned int allele0 = (i >> haplotype_to_partition(individuals_index, 0)) & 1;
+			unsigned int allele1 = (i >> haplotype_to_partition(individuals_index, 1)) & 1;
+			if (Genotype(vector<unsigned int>{allele0, allele1}) != *genotypes[individuals_index]) {
+				genotypes_compatible = false;
+				break;
+			}
+		}
+		if (genotypes_compatible) {
+			assignments.push_back(i);
+		}
+	}
+	return assignments;
+}
+
+
+void PedigreePartitions::compute_assignment_genotypes() const {
+	unsigned int assignment_count = 1u << partition_count;
+	assignment_genotypes.resize(assignment_count * individual_count);
+	// number of allele assignments giving each vector of genotypes
+	map<vector<unsigned int>, unsigned int> genotypes_counts;
+	for (unsigned int a = 0; a < assignment_count; ++a) {
+		for (size_t individuals_index = 0; individuals_index < individual_count; ++individuals_index) {
+			unsigned int allele0 = (a >> haplotype_to_partition(individuals_index, 0)) & 1;
+			unsigned int allele1 = (a >> haplotype_to_partition(individuals_index, 1)) & 1;
+			assignment_genotypes[a * individual_count + individuals_index] = Genotype(vector<unsigned int>{allele0, allele1}).get_index();
+		}
+		vector<unsigned int> genotypes(assignment_genotypes.begin() + a * individual_count, assignment_genotypes.begin() + (a + 1) * individual_count);
+		genotypes_counts[genotypes] += 1;
+	}
+	assignment_multiplicities.resize(assignment_count);
+	for (unsigned int a = 0; a < assignment_count; ++a) {
+		vector<unsigned int> genotypes(assignment_genotypes.begin() + a * individual_count, assignment_genotypes.begin() + (a + 1) * individual_count);
+		assignment_multiplicities[a] = genotypes_counts[genotypes];
+	}
+}
+
+
+const vector<unsigned int>& PedigreePartitions::get_assignment_genotypes() const {
+	call_once(assignment_genotypes_flag, &PedigreePartitions::compute_assignment_genotypes, this);
+	return assignment_genotypes;
+}
+
+
+const vector<unsigned int>& PedigreePartitions::get_assignment_multiplicities() const {
+	call_once(assignment_genotypes_flag, &PedigreePartitions::compute_assignment_genotypes, this);
+	return assignment_multiplicities;
+}
+
+
 std::ostream& operator<<(std::ostream& out, const PedigreePartitions& pp) {
-	for (size_t i=0; i<pp.pedigree.size(); ++i) {
+	for (size_t i=0; i<pp.individual_count; ++i) {
 		out << "sample" << i << ":";
 		for (size_t h=0; h<2; ++h) {
 			out << "  hap" << h << "-->" << pp.haplotype_to_partition(i, h);
@@ -3,6 +3,8 @@
 
 #include <array>
 #include <vector>
+#include <mutex>
+#include <unordered_map>
 
 #include "pedigree.h"
 
@@ -11,12 +13,24 @@
  */
 class PedigreePartitions {
 private:
-	const Pedigree& pedigree;
+	size_t individual_count;
 	unsigned int transmission_vector;
 	unsigned int partition_count;
 	std::vector<std::array<int,2>> haplotype_to_partition_map;
 	/** (Recursively) compute entry haplotype_to_partition_map[i]. */
-	void compute_haplotype_to_partition_rec(size_t i, const std::vector<int>& triple_indices);
+	void compute_haplotype_to_partition_rec(size_t i, const std::vector<int>& triple_indices, const Pedigree& pedigree);
+
+	struct genotypes_hash {
+		size_t operator()(const std::vector<uint64_t>& genotypes) const;
+	};
+	// compatible allele assignments for all combinations of genotypes seen so far
+	mutable std::unordered_map<std::vector<uint64_t>, std::vector<unsigned int>, genotypes_hash> compatible_assignments;
+	mutable std::mutex compatible_assignments_mutex;
+	// genotype indices and multiplicities of all allele assignments, see get_assignment_genotypes()
+	mutable std::vector<unsigned int> assignment_genotypes;
+	mutable std::vector<unsigned int> assignment_multiplicities;
+	mutable std::once_flag assignment_genotypes_flag;
+	void compute_assignment_genotypes() const;
 public:
 	PedigreePartitions(const Pedigree& pedigree, unsigned int transmission_vector);
 
@@ -26,6 +40,21 @@ public:
 	/** Returns an index of the partition for a given individual and haplotype (0 or 1). */
 	size_t haplotype_to_partition(size_t individual_index, size_t haplotype) const;
 
+	/** Returns all allele assignments compatible with the given genotypes (one per individual), in
+	 *  increasing order. In an allele assignment, the i-th bit gives the allele assigned to partition i.
+	 *  Assignments are enumerated once for each combination of genotypes and reused afterwards, also
+	 *  by other threads. The returned reference remains valid during the lifetime of this object. */
+	const std::vector<unsigned int>& get_compatible_assignments(const std::vector<const Genotype*>& genotypes) const;
+
+	/** Returns, for every allele assignment a and individual i, the index (see Genotype::get_index)
+	 *  of the genotype that a gives to i, stored at position a * (number of individuals) + i.
+	 *  Computed on first use and reused afterwards, also by other threads. */
+	const std::vector<unsigned int>& get_assignment_genotypes() const;
+
+	/** Returns, for every allele assignment, the number of allele assignments (including itself)
+	 *  that give the same genotypes to all individuals. */
+	const std::vector<unsigned int>& get_assignment_multiplicities() const;
+
 	friend std::ostream& operator<<(std::ostream& out, const PedigreePartitions& pp);
 
 };
@@ -0,0 +1,56 @@
+#include <cmath>
+#include <map>
+#include <mutex>
+
+#include "pedigreetopology.h"
+
+using namespace std;
+
+namespace {
+	mutex cache_mutex;
+	// topologies keyed by number of individuals followed by the indices in all triples
+	map<vector<size_t>, shared_ptr<const PedigreeTopology> > cache;
+}
+
+
+PedigreeTopology::PedigreeTopology(const Pedigree& pedigree) {
+	for (size_t i=0; i<std::pow(4, pedigree.triple_count()); ++i) {
+		partitions.push_back(new PedigreePartitions(pedigree, i));
+	}
+}
+
+
+PedigreeTopology::~PedigreeTopology() {
+	for (PedigreePartitions* p : partitions) {
+		delete p;
+	}
+}
+
+
+shared_ptr<const PedigreeTopology> get_pedigree_topology(const Pedigree& pedigree) {
+	vector<size_t> key;
+	key.push_back(pedigree.size());
+	for (const Pedigree::triple_entry_t& triple : pedigree.get_triples()) {
+		key.insert(key.end(), triple.begin(), triple.end());
+	}
+	lock_guard<mutex> lock(cache_mutex);
+	auto it = cache.find(key);
+	if (it != cache.end()) {
+		return it->second;
+	}
+	shared_ptr<const PedigreeTopology> topology = make_shared<PedigreeTopology>(pedigree);
+	cache[key] = topology;
+	return topology;
+}
+
+
+size_t get_pedigree_topology_cache_size() {
+	lock_guard<mutex> lock(cache_mutex);
+	return cache.size();
+}
+
+
+void clear_pedigree_topology_cache() {
+	lock_guard<mutex> lock(cache_mutex);
+	cache.clear();
+}
@@ -0,0 +1,44 @@
+#ifndef PEDIGREE_TOPOLOGY_H
+#define PEDIGREE_TOPOLOGY_H
+
+#include <vector>
+#include <memory>
+
+#include "pedigree.h"
+#include "pedigreepartitions.h"
+
+/** Data that only depends on the topology of a pedigree, i.e. on the number of individuals and the
+ *  trio relationships between them (in terms of individual indices), but not on the genotypes:
+ *  the pedigree partitions for all transmission values, which in turn cache the compatible allele
+ *  assignments for each combination of genotypes.
+ *
+ *  Objects are obtained through get_pedigree_topology() and shared read-only between all DP tables
+ *  (and their threads) working on pedigrees of the same topology.
+ */
+class PedigreeTopology {
+public:
+	explicit PedigreeTopology(const Pedigree& pedigree);
+	~PedigreeTopology();
+
+	/** Returns the pedigree partitions, indexed by transmission value. */
+	const std::vector<PedigreePartitions*>& get_partitions() const {
+		return partitions;
+	}
+
+private:
+	PedigreeTopology(const PedigreeTopology&) = delete;
+	PedigreeTopology& operator=(const PedigreeTopology&) = delete;
+
+	std::vector<PedigreePartitions*> partitions;
+};
+
+/** Returns the (cached) topology of the given pedigree. Thread-safe. */
+std::shared_ptr<const PedigreeTopology> get_pedigree_topology(const Pedigree& pedigree);
+
+/** Returns the number of distinct pedigree topologies currently cached. */
+size_t get_pedigree_topology_cache_size();
+
+/** Removes all topologies from the cache. Topologies still in use by DP tables remain valid. */
+void clear_pedigree_topology_cache();
+
+#endif
@@ -0,0 +1,55 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "phasingcomparison.h"
+
+using namespace std;
+
+block_comparison_t compare_diploid_block(const diploid_phasing_t& phasing0, const diploid_phasing_t& phasing1) {
+	const string& a0 = phasing0.first;
+	const string& a1 = phasing0.second;
+	const string& b0 = phasing1.first;
+	const string& b1 = phasing1.second;
+	size_t length = a0.size();
+	if ((a1.size() != length) || (b0.size() != length) || (b1.size() != length)) {
+		throw std::invalid_argument("All haplotypes of a block must have the same length");
+	}
+	block_comparison_t result;
+	size_t hamming_same = 0;
+	size_t hamming_swapped = 0;
+	size_t switches_in_a_row = 0;
+	for (size_t i = 0; i < length; ++i) {
+		hamming_same += (a0[i] != b0[i]) + (a1[i] != b1[i]);
+		hamming_swapped += (a1[i] != b0[i]) + (a0[i] != b1[i]);
+		bool same_genotype = ((a0[i] == b0[i]) && (a1[i] == b1[i])) || ((a0[i] == b1[i]) && (a1[i] == b0[i]));
+		if (!same_genotype) result.diff_genotypes += 1;
+		if (i == 0) continue;
+		// the first haplotypes of both phasings are compared by their switch encodings
+		bool switch0 = a0[i-1] != a0[i];
+		bool switch1 = b0[i-1] != b0[i];
+		if (switch0 != switch1) {
+			result.switches += 1;
+			switches_in_a_row += 1;
+		}
+		if ((i + 1 == length) || (switch0 == switch1)) {
+			result.switch_flip_flips += switches_in_a_row / 2;
+			result.switch_flip_switches += switches_in_a_row % 2;
+			switches_in_a_row = 0;
+		}
+	}
+	result.hamming = min(hamming_same, hamming_swapped) / 2;
+	return result;
+}
+
+
+vector<block_comparison_t> compare_diploid_blocks(const vector<diploid_phasing_t>& phasings0, const vector<diploid_phasing_t>& phasings1) {
+	if (phasings0.size() != phasings1.size()) {
+		throw std::invalid_argument("Both phasings must consist of the same blocks");
+	}
+	vector<block_comparison_t> results;
+	results.reserve(phasings0.size());
+	for (size_t i = 0; i < phasings0.size(); ++i) {
+		results.push_back(compare_diploid_block(phasings0[i], phasings1[i]));
+	}
+	return results;
+}
@@ -0,0 +1,33 @@
+#ifndef PHASING_COMPARISON_H
+#define PHASING_COMPARISON_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/** Differences between two diploid phasings of the same block. */
+typedef struct block_comparison_t {
+	// positions (except the first), at which only one of the phasings switches between the haplotypes
+	size_t switches;
+	// decomposition of these switches into isolated switches and flips (two switches in a row)
+	size_t switch_flip_switches;
+	size_t switch_flip_flips;
+	// Hamming distance of the haplotypes, minimized over both assignments of the haplotypes and halved
+	size_t hamming;
+	// number of positions, at which the (unphased) genotypes differ
+	size_t diff_genotypes;
+	block_comparison_t() : switches(0), switch_flip_switches(0), switch_flip_flips(0), hamming(0), diff_genotypes(0) {}
+} block_comparison_t;
+
+typedef std::pair<std::string, std::string> diploid_phasing_t;
+
+/** Compares two diploid phasings of a block. Each phasing is given as its two haplotypes, which are strings
+ *  with one character per allele (such as "0110"). All four haplotypes must have the same length. The results
+ *  are the same as those of compare_blocks in whatshap/cli/compare.py.
+ */
+block_comparison_t compare_diploid_block(const diploid_phasing_t& phasing0, const diploid_phasing_t& phasing1);
+
+/** Compares the phasings of a number of blocks and returns one result per block (in the given order). */
+std::vector<block_comparison_t> compare_diploid_blocks(const std::vector<diploid_phasing_t>& phasings0, const std::vector<diploid_phasing_t>& phasings1);
+
+#endif
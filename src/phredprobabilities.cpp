@@ -0,0 +1,32 @@
+#include "phredprobabilities.h"
+
+using namespace std;
+
+template <typename Float>
+const PhredProbabilities<Float>& PhredProbabilities<Float>::get() {
+	// initialized once, also when first used by several threads at the same time
+	static const PhredProbabilities<Float> probabilities;
+	return probabilities;
+}
+
+
+template <typename Float>
+PhredProbabilities<Float>::PhredProbabilities() {
+	for (unsigned int q = 0; q < TABLE_SIZE; ++q) {
+		long double error = (q == 0) ? 0.9999L : pow(10, -(long double)q/10.0L);
+		errors[q] = error;
+		matches[q] = Float(1) - errors[q];
+		log_errors[q] = log(error);
+		log_matches[q] = log1p(-error);
+	}
+}
+
+
+template <typename Float>
+Float PhredProbabilities<Float>::compute_error(unsigned int phred_score) {
+	return pow(10, -(long double)phred_score/10.0L);
+}
+
+
+template class PhredProbabilities<long double>;
+template class PhredProbabilities<double>;
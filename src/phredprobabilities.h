@@ -0,0 +1,53 @@
+#ifndef PHRED_PROBABILITIES_H
+#define PHRED_PROBABILITIES_H
+
+#include <array>
+#include <cmath>
+
+/** Probabilities that correspond to phred scores, in the numeric type Float. The error
+ *  probability of a phred score q is 10^(-q/10), except that a score of 0 gives 0.9999
+ *  such that the match probability is not 0. Values for scores below TABLE_SIZE are
+ *  looked up in tables that are computed once (in long double precision) and shared by
+ *  all threads; larger scores, which do not occur in practice, are computed on demand.
+ */
+template <typename Float>
+class PhredProbabilities {
+public:
+	static const unsigned int TABLE_SIZE = 256;
+
+	/** Returns the shared tables. */
+	static const PhredProbabilities& get();
+
+	/** Returns the probability that an observation with the given phred score is wrong. */
+	Float error(unsigned int phred_score) const {
+		return (phred_score < TABLE_SIZE) ? errors[phred_score] : compute_error(phred_score);
+	}
+
+	/** Returns 1 - error(phred_score). */
+	Float match(unsigned int phred_score) const {
+		return (phred_score < TABLE_SIZE) ? matches[phred_score] : Float(1) - compute_error(phred_score);
+	}
+
+	/** Returns the natural logarithm of error(phred_score). */
+	Float log_error(unsigned int phred_score) const {
+		return (phred_score < TABLE_SIZE) ? log_errors[phred_score] : std::log(compute_error(phred_score));
+	}
+
+	/** Returns the natural logarithm of match(phred_score). */
+	Float log_match(unsigned int phred_score) const {
+		return (phred_score < TABLE_SIZE) ? log_matches[phred_score] : std::log1p(-compute_error(phred_score));
+	}
+
+private:
+	PhredProbabilities();
+
+	static Float compute_error(unsigned int phred_score);
+
+	// each table starts at a cache line
+	alignas(64) std::array<Float, TABLE_SIZE> errors;
+	alignas(64) std::array<Float, TABLE_SIZE> matches;
+	alignas(64) std::array<Float, TABLE_SIZE> log_errors;
+	alignas(64) std::array<Float, TABLE_SIZE> log_matches;
+};
+
+#endif
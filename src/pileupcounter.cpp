@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+#include "pileupcounter.h"
+
+using namespace std;
+
+namespace {
+	const char BASE_CHARS[] = "ACGTN";
+
+	/** Returns the index of a base in BASE_CHARS or -1. */
+	int base_index(char c) {
+		switch (toupper(c)) {
+		case 'A': return 0;
+		case 'C': return 1;
+		case 'G': return 2;
+		case 'T': return 3;
+		case 'N': return 4;
+		default: return -1;
+		}
+	}
+
+	/** Appends a (reference position, query position) pair for each aligned base. */
+	void aligned_pairs(int reference_start, const PileupCounter::cigar_t& cigar, vector<pair<int,int> >& pairs) {
+		int ref_pos = reference_start;
+		int query_pos = 0;
+		for (const auto& op : cigar) {
+			switch (op.first) {
+			case 0: case 7: case 8: // M, =, X
+				for (int i = 0; i < op.second; ++i) {
+					pairs.emplace_back(ref_pos + i, query_pos + i);
+				}
+				ref_pos += op.second;
+				query_pos += op.second;
+				break;
+			case 1: case 4: // I, S
+				query_pos += op.second;
+				break;
+			case 2: case 3: // D, N
+				ref_pos += op.second;
+				break;
+			default: // H, P
+				break;
+			}
+		}
+	}
+}
+
+
+PileupCounter::PileupCounter(int start, const string& reference, unsigned int min_base_quality) :
+	start(start),
+	reference(reference),
+	min_base_quality(min_base_quality),
+	counts(reference.size() * BASES, 0)
+{
+	if (start < 0) {
+		throw std::invalid_argument("PileupCounter: start must not be negative");
+	}
+}
+
+
+void PileupCounter::add(const string& name, int reference_start, const cigar_t& cigar, const string& query_sequence, const string& qualities, int mate_start) {
+	alignment_t alignment;
+	alignment.reference_start = reference_start;
+	alignment.cigar = cigar;
+	alignment.query_sequence = query_sequence;
+	if (qualities.empty()) {
+		// missing qualities are stored as 0xff in BAM files
+		alignment.qualities.assign(query_sequence.size(), 0xff);
+	} else {
+		if (qualities.size() != query_sequence.size()) {
+			throw std::invalid_argument("PileupCounter: query sequence and qualities differ in length");
+		}
+		alignment.qualities.assign(qualities.begin(), qualities.end());
+	}
+	if (mate_start >= 0) {
+		auto it = pending_mates.find(name);
+		if (it != pending_mates.end()) {
+			adjust_overlap_qualities(it->second, alignment);
+			count(it->second);
+			count(alignment);
+			pending_mates.erase(it);
+			return;
+		}
+		if (mate_start >= reference_start) {
+			pending_mates.emplace(name, std::move(alignment));
+			return;
+		}
+	}
+	count(alignment);
+}
+
+
+void PileupCounter::finish() {
+	for (const auto& it : pending_mates) {
+		count(it.second);
+	}
+	pending_mates.clear();
+}
+
+
+void PileupCounter::count(const alignment_t& alignment) {
+	int end = start + (int)reference.size();
+	int ref_pos = alignment.reference_start;
+	int query_pos = 0;
+	for (const auto& op : alignment.cigar) {
+		if (ref_pos >= end) break;
+		switch (op.first) {
+		case 0: case 7: case 8: // M, =, X
+			for (int i = max(0, start - ref_pos); i < op.second && ref_pos + i < end; ++i) {
+				int q = query_pos + i;
+				if (q >= (int)alignment.query_sequence.size()) break;
+				int b = base_index(alignment.query_sequence[q]);
+				if ((b >= 0) && (alignment.qualities[q] >= min_base_quality)) {
+					counts[(size_t)(ref_pos + i - start) * BASES + b] += 1;
+				}
+			}
+			ref_pos += op.second;
+			query_pos += op.second;
+			break;
+		case 1: case 4: // I, S
+			query_pos += op.second;
+			break;
+		case 2: case 3: // D, N
+			ref_pos += op.second;
+			break;
+		default: // H, P
+			break;
+		}
+	}
+}
+
+
+void PileupCounter::adjust_overlap_qualities(alignment_t& a, alignment_t& b) {
+	vector<pair<int,int> > a_pairs;
+	vector<pair<int,int> > b_pairs;
+	aligned_pairs(a.reference_start, a.cigar, a_pairs);
+	aligned_pairs(b.reference_start, b.cigar, b_pairs);
+	size_t i = 0;
+	size_t j = 0;
+	while ((i < a_pairs.size()) && (j < b_pairs.size())) {
+		if (a_pairs[i].first < b_pairs[j].first) {
+			++i;
+		} else if (a_pairs[i].first > b_pairs[j].first) {
+			++j;
+		} else {
+			size_t qa = a_pairs[i].second;
+			size_t qb = b_pairs[j].second;
+			if ((qa < a.query_sequence.size()) && (qb < b.query_sequence.size())) {
+				uint8_t& a_qual = a.qualities[qa];
+				uint8_t& b_qual = b.qualities[qb];
+				if (a.query_sequence[qa] == b.query_sequence[qb]) {
+					a_qual = min(a_qual + b_qual, 200);
+					b_qual = 0;
+				} else if (a_qual >= b_qual) {
+					a_qual = (uint8_t)(0.8 * a_qual);
+					b_qual = 0;
+				} else {
+					b_qual = (uint8_t)(0.8 * b_qual);
+					a_qual = 0;
+				}
+			}
+			++i;
+			++j;
+		}
+	}
+}
+
+
+vector<pileup_candidate_t> PileupCounter::get_candidates(unsigned int min_absolute, double min_relative, bool multi_allelics) {
+	finish();
+	vector<pileup_candidate_t> candidates;
+	vector<pair<uint32_t,char> > alternatives;
+	for (size_t i = 0; i < reference.size(); ++i) {
+		char reference_base = toupper(reference[i]);
+		if (reference_base == 'N') continue;
+		const uint32_t* position_counts = &counts[i * BASES];
+		int r = base_index(reference_base);
+		uint32_t reference_count = (r >= 0) ? position_counts[r] : 0;
+		alternatives.clear();
+		for (int b = 0; b < BASES; ++b) {
+			uint32_t count = position_counts[b];
+			if ((b == r) || (count < min_absolute) || (count == 0)) continue;
+			if ((double)count / (count + reference_count) >= min_relative) {
+				alternatives.emplace_back(count, BASE_CHARS[b]);
+			}
+		}
+		if (alternatives.empty()) continue;
+		// most frequent first; ties are ordered by decreasing base
+		sort(alternatives.rbegin(), alternatives.rend());
+		if (!multi_allelics && (alternatives.size() > 1) && (alternatives[0].first == alternatives[1].first)) {
+			continue;
+		}
+		pileup_candidate_t candidate;
+		candidate.position = start + (int)i;
+		candidate.reference = reference_base;
+		for (size_t k = 0; k < (multi_allelics ? alternatives.size() : 1); ++k) {
+			candidate.alternatives += alternatives[k].second;
+		}
+		candidates.push_back(candidate);
+	}
+	return candidates;
+}
+
+
+unsigned int PileupCounter::get_count(int position, char base) const {
+	int b = base_index(base);
+	if ((position < start) || (position >= start + (int)reference.size()) || (b < 0)) {
+		throw std::out_of_range("PileupCounter::get_count: invalid position or base");
+	}
+	return counts[(size_t)(position - start) * BASES + b];
+}
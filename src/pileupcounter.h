@@ -0,0 +1,86 @@
+#ifndef PILEUP_COUNTER_H
+#define PILEUP_COUNTER_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/** A position at which alternative bases are frequent enough (see PileupCounter). */
+typedef struct pileup_candidate_t {
+	int position;
+	char reference;
+	/** Alternative bases, most frequent first. */
+	std::string alternatives;
+} pileup_candidate_t;
+
+/** Counts the bases that alignments have at each position of a region of a chromosome and
+ *  reports the positions at which an alternative base is supported by enough alignments
+ *  (Python: find_snv_candidates). The counts of all positions are kept in a single flat
+ *  array. As in an htslib pileup (used by samtools mpileup and pysam), bases with a quality
+ *  below a threshold are not counted, and the qualities of the bases of overlapping mates
+ *  are adjusted such that each such base is counted only once.
+ */
+class PileupCounter {
+public:
+	/** CIGAR as a list of (operation, length) pairs, using the BAM operation codes MIDNSHP=X (0-8). */
+	typedef std::vector<std::pair<int,int> > cigar_t;
+
+	/** Constructor.
+	 *  @param start Position (0-based) of the first base of the region.
+	 *  @param reference Reference sequence of the region.
+	 *  @param min_base_quality Bases with lower quality are not counted.
+	 */
+	PileupCounter(int start, const std::string& reference, unsigned int min_base_quality);
+
+	/** Counts the bases of an alignment within the region. Alignments must be added in the
+	 *  order of their reference start. Bases that are not one of ACGTN are ignored.
+	 *  @param qualities Base qualities (one byte per base) or empty if not available.
+	 *  @param mate_start Reference start of the mate if the mate can overlap this alignment,
+	 *                    -1 otherwise. The first of two mates with the same name is counted
+	 *                    only when the second one is added (or on finish()).
+	 */
+	void add(const std::string& name, int reference_start, const cigar_t& cigar, const std::string& query_sequence, const std::string& qualities, int mate_start = -1);
+
+	/** Counts the alignments whose mate was not added. */
+	void finish();
+
+	/** Returns the positions (in increasing order) at which alternative bases occur at least
+	 *  min_absolute times and in a fraction of at least min_relative of the alternative and
+	 *  reference bases. Positions at which the reference is N are skipped. If multi_allelics
+	 *  is false, only the most frequent alternative base is reported, and positions at which
+	 *  two alternative bases are equally frequent are skipped. Calls finish().
+	 */
+	std::vector<pileup_candidate_t> get_candidates(unsigned int min_absolute, double min_relative, bool multi_allelics);
+
+	/** Returns how many times the given base (one of ACGTN) was counted at a position. */
+	unsigned int get_count(int position, char base) const;
+
+private:
+	static const int BASES = 5;
+
+	typedef struct alignment_t {
+		int reference_start;
+		cigar_t cigar;
+		std::string query_sequence;
+		std::vector<uint8_t> qualities;
+	} alignment_t;
+
+	int start;
+	std::string reference;
+	unsigned int min_base_quality;
+	// BASES entries per position of the region
+	std::vector<uint32_t> counts;
+	// first mates waiting for the second one, by name
+	std::unordered_map<std::string, alignment_t> pending_mates;
+
+	void count(const alignment_t& alignment);
+
+	/** Adjusts the qualities of bases at which mates a (added first) and b overlap like
+	 *  htslib does: if the bases agree, a gets the sum of both qualities (at most 200);
+	 *  otherwise, the better one keeps 80% of its quality. The other base gets quality 0. */
+	static void adjust_overlap_qualities(alignment_t& a, alignment_t& b);
+};
+
+#endif
@@ -0,0 +1,287 @@
+#include "blockphaser.h"
+#include "readscoring.h"
+#include "clustereditingsolver.h"
+#include "haplothreader.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+constexpr double BlockPhaser::EXPECTED_ERROR;
+constexpr double BlockPhaser::P_VALUE_THRESHOLD;
+
+BlockPhaser::BlockPhaser(uint32_t ploidy, uint32_t minOverlap, bool bundleEdges, uint32_t refinements,
+                         uint32_t blockCutSensitivity, uint32_t beamWidth, uint64_t threadingMemory, uint32_t threads) :
+    ploidy(ploidy),
+    minOverlap(minOverlap),
+    bundleEdges(bundleEdges),
+    refinements(refinements),
+    blockCutSensitivity(blockCutSensitivity),
+    beamWidth(beamWidth),
+    threadingMemory(threadingMemory),
+    threads(std::max(threads, 1U))
+{}
+
+std::vector<BlockPhasingResult> BlockPhaser::phaseBlocks(const std::vector<ReadSet*>& blocks,
+                                                         const std::vector<std::vector<std::unordered_map<uint32_t, uint32_t>>>& genotypes,
+                                                         const ReadScoreIndex* index,
+                                                         const std::vector<uint32_t>& blockStarts) const {
+    uint32_t numBlocks = blocks.size();
+    std::vector<BlockPhasingResult> results(numBlocks);
+    if (index != nullptr && blockStarts.size() != numBlocks + 1)
+        throw std::invalid_argument("BlockPhaser: expected the first variant of every block and the number of variants");
+
+    // estimate the cost of every block by its number of read entries and start with the most expensive ones
+    uint32_t numNonSingletonBlocks = 0;
+    std::vector<std::pair<uint64_t, uint32_t>> jobs;
+    for (uint32_t b = 0; b < numBlocks; b++) {
+        uint64_t entries = 0;
+        for (uint32_t i = 0; i < blocks[b]->size(); i++)
+            entries += blocks[b]->get(i)->getVariantCount();
+        jobs.push_back(std::pair<uint64_t, uint32_t>(entries, b));
+        if (genotypes[b].size() > 1)
+            numNonSingletonBlocks++;
+    }
+    std::stable_sort(jobs.begin(), jobs.end(), [](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b) {
+        return a.first > b.first;
+    });
+
+    // blocks are phased in parallel, so each gets its share of threads for its own computations
+    uint32_t blockThreads = std::max(1U, threads / std::max(1U, numNonSingletonBlocks));
+    uint32_t numWorkers = std::min(threads, numBlocks);
+
+    // the index is restricted to the variants of a block on the thread that phases it
+    auto phase = [&](uint32_t b) {
+        std::unique_ptr<ReadScoreIndex> blockIndex;
+        if (index != nullptr && genotypes[b].size() > 1)
+            blockIndex.reset(index->restrictToVariants(blockStarts[b], blockStarts[b + 1]));
+        results[b] = phaseBlock(blocks[b], genotypes[b], blockThreads, blockIndex.get());
+    };
+    if (numWorkers <= 1) {
+        for (const std::pair<uint64_t, uint32_t>& job : jobs)
+            phase(job.second);
+        return results;
+    }
+
+    std::atomic<uint32_t> nextJob(0);
+    std::vector<std::exception_ptr> errors(numWorkers);
+    std::vector<std::thread> workers;
+    for (uint32_t w = 0; w < numWorkers; w++) {
+        workers.emplace_back([&, w]() {
+            try {
+                for (uint32_t j = nextJob++; j < numBlocks; j = nextJob++) {
+                    phase(jobs[j].second);
+                }
+            } catch (...) {
+                errors[w] = std::current_exception();
+                nextJob = numBlocks;
+            }
+        });
+    }
+    for (std::thread& worker : workers)
+        worker.join();
+    for (std::exception_ptr& error : errors)
+        if (error)
+            std::rethrow_exception(error);
+
+    return results;
+}
+
+BlockPhasingResult BlockPhaser::phaseBlock(ReadSet* block, const std::vector<std::unordered_map<uint32_t, uint32_t>>& genotypes,
+                                           const uint32_t blockThreads, const ReadScoreIndex* blockIndex) const {
+    // handle singleton blocks differently (for efficiency reasons)
+    if (genotypes.size() == 1)
+        return phaseSingletonBlock(block, genotypes[0]);
+
+    BlockPhasingResult result;
+
+    // Phase I: cluster editing on the similarities of all read pairs
+    TriangleSparseMatrix similarities;
+    std::vector<std::vector<uint32_t>> noHaplotypes;
+    if (blockIndex != nullptr)
+        ReadScoring().scoreIndexLocal(&similarities, *blockIndex, noHaplotypes, minOverlap, ploidy);
+    else
+        ReadScoring().scoreReadsetLocal(&similarities, block, noHaplotypes, minOverlap, ploidy, blockThreads);
+
+    std::vector<std::vector<uint32_t>>& clustering = result.clustering;
+    ClusterEditingSolution solution = ClusterEditingSolver(similarities, bundleEdges, blockThreads).run();
+    for (uint32_t i = 0; i < solution.getNumClusters(); i++)
+        clustering.push_back(std::vector<uint32_t>(solution.getCluster(i).begin(), solution.getCluster(i).end()));
+
+    // refine clusters by solving inconsistencies in consensus (the worst case count is never updated, as in polyphase.py)
+    uint32_t numPositions = genotypes.size();
+    uint64_t lastInconsistencies = (uint64_t)clustering.size() * numPositions;
+    bool refine = true;
+    for (uint32_t run = 0; refine && run < refinements; run++) {
+        refine = false;
+        uint32_t inconsistencies = findInconsistencies(block, clustering, similarities);
+        if (inconsistencies > 0 && inconsistencies < lastInconsistencies) {
+            solution = ClusterEditingSolver(similarities, bundleEdges, blockThreads).run();
+            clustering.clear();
+            for (uint32_t i = 0; i < solution.getNumClusters(); i++)
+                clustering.push_back(std::vector<uint32_t>(solution.getCluster(i).begin(), solution.getCluster(i).end()));
+        }
+    }
+
+    // add trailing isolated nodes as singleton clusters, if missing
+    uint32_t nodesInClusters = 0;
+    for (const std::vector<uint32_t>& cluster : clustering)
+        nodesInClusters += cluster.size();
+    for (uint32_t i = nodesInClusters; i < block->size(); i++)
+        clustering.push_back(std::vector<uint32_t>(1, i));
+
+    // Phase II: threading of the haplotypes through the clusters
+    ThreadingPreprocessor preprocessor(block, clustering, ploidy);
+    HaploThreader threader(ploidy, 32.0, 8.0, true, ploidy > 6 ? 16 * (1U << ploidy) : 0, beamWidth, threadingMemory, blockThreads);
+    result.path = threader.computePaths(preprocessor, genotypes);
+    result.path = preprocessor.improvePathOnMultiswitches(result.path);
+    result.path = preprocessor.improvePathOnCollapsedswitches(result.path);
+    computeCutPositions(result.path, clustering.size(), result.cutPositions, result.haploidCuts);
+    result.haplotypes = preprocessor.getHaplotypes(result.path);
+
+    return result;
+}
+
+BlockPhasingResult BlockPhaser::phaseSingletonBlock(ReadSet* block, const std::unordered_map<uint32_t, uint32_t>& genotype) const {
+    BlockPhasingResult result;
+
+    // use the genotype as phasing; alleles get cluster ids in the order of Genotype::as_vector (descending)
+    std::vector<uint32_t> alleles;
+    for (const std::pair<const uint32_t, uint32_t>& entry : genotype)
+        alleles.push_back(entry.first);
+    std::sort(alleles.rbegin(), alleles.rend());
+
+    result.clustering.resize(alleles.size());
+    for (uint32_t i = 0; i < block->size(); i++) {
+        uint32_t allele = block->get(i)->getAllele(0);
+        std::vector<uint32_t>::iterator it = std::find(alleles.begin(), alleles.end(), allele);
+        if (it != alleles.end())
+            result.clustering[it - alleles.begin()].push_back(i);
+    }
+
+    result.path.resize(1);
+    for (uint32_t a = 0; a < alleles.size(); a++) {
+        for (uint32_t i = 0; i < genotype.at(alleles[a]); i++) {
+            result.path[0].push_back(a);
+            result.haplotypes.push_back(std::to_string(alleles[a]));
+        }
+    }
+    result.cutPositions.push_back(0);
+    result.haploidCuts.assign(ploidy, std::vector<Position>(1, 0));
+    return result;
+}
+
+uint32_t BlockPhaser::findInconsistencies(ReadSet* block, const std::vector<std::vector<uint32_t>>& clustering,
+                                          TriangleSparseMatrix& similarities) const {
+    ThreadingPreprocessor preprocessor(block, clustering, ploidy);
+    const std::vector<uint32_t>& genomePositions = preprocessor.getGenomePositions();
+    const std::vector<std::vector<GlobalClusterId>>& covMap = preprocessor.getCovMap();
+    const std::vector<std::vector<GlobalClusterId>>& coveringClusters = preprocessor.getCoveringClusters();
+    const std::vector<std::vector<uint32_t>>& absoluteCoverage = preprocessor.getAbsoluteCoverage();
+    const std::vector<std::vector<double>>& consensusFraction = preprocessor.getConsensusFraction();
+
+    uint32_t numInconsistentPositions = 0;
+    for (Position pos = 0; pos < genomePositions.size(); pos++) {
+        for (uint32_t k = 0; k < coveringClusters[pos].size(); k++) {
+            GlobalClusterId c = coveringClusters[pos][k];
+            uint32_t i = std::find(covMap[pos].begin(), covMap[pos].end(), c) - covMap[pos].begin();
+            if (i == covMap[pos].size())
+                continue;
+
+            // binomial test, whether the deviations from the majority allele are significant enough for splitting
+            uint32_t absCount = absoluteCoverage[pos][k];
+            uint32_t absDeviations = (uint32_t)(absCount * (1 - consensusFraction[pos][i]));
+            if (binomialUpperTail(absDeviations, absCount, EXPECTED_ERROR) >= P_VALUE_THRESHOLD)
+                continue;
+
+            numInconsistentPositions++;
+            std::vector<uint32_t> zeroReads;
+            std::vector<uint32_t> oneReads;
+            for (uint32_t readId : clustering[c]) {
+                const Read* read = block->get(readId);
+                for (int v = 0; v < read->getVariantCount(); v++) {
+                    if ((uint32_t)read->getPosition(v) == genomePositions[pos]) {
+                        if (read->getAllele(v) == 0)
+                            zeroReads.push_back(readId);
+                        else
+                            oneReads.push_back(readId);
+                    }
+                }
+            }
+            for (uint32_t r0 : zeroReads)
+                for (uint32_t r1 : oneReads)
+                    similarities.set(r0, r1, -std::numeric_limits<float>::infinity());
+        }
+    }
+    return numInconsistentPositions;
+}
+
+double BlockPhaser::binomialUpperTail(uint32_t k, uint32_t n, double p) {
+    if (k == 0)
+        return 1.0;
+    double tail = 0.0;
+    for (uint32_t i = k; i <= n; i++)
+        tail += std::exp(std::lgamma(n + 1.0) - std::lgamma(i + 1.0) - std::lgamma(n - i + 1.0)
+                         + i * std::log(p) + (n - i) * std::log1p(-p));
+    return std::min(tail, 1.0);
+}
+
+void BlockPhaser::computeCutPositions(const std::vector<std::vector<GlobalClusterId>>& path, const uint32_t numClusters,
+                                      std::vector<Position>& cutPositions, std::vector<std::vector<Position>>& haploidCuts) const {
+    cutPositions.assign(1, 0);
+    haploidCuts.clear();
+    if (path.size() == 0)
+        return;
+
+    uint32_t numHaps = path[0].size();
+    haploidCuts.assign(numHaps, std::vector<Position>(1, 0));
+    if (blockCutSensitivity < 3)
+        return;
+
+    // 3: cut for every multi-switch, 4: also for every rise-fall of a cluster's copy number, 5: cut for every switch
+    uint32_t dissimThreshold = blockCutSensitivity >= 5 ? 1 : 2;
+    uint32_t riseFallDissim = blockCutSensitivity >= 4 ? numHaps + 1 : 0;
+
+    std::vector<bool> cpnRising(numClusters, false);
+    for (Position i = 1; i < path.size(); i++) {
+        const std::vector<GlobalClusterId>& prev = path[i - 1];
+        const std::vector<GlobalClusterId>& cur = path[i];
+        uint32_t dissim = 0;
+        std::vector<GlobalClusterId> clustersCut;
+        for (uint32_t j = 0; j < numHaps; j++) {
+            GlobalClusterId oldC = prev[j];
+            GlobalClusterId newC = cur[j];
+            if (oldC == newC)
+                continue;
+            clustersCut.push_back(oldC);
+            bool riseFall = false;
+            // check if previous cluster went down from copy number >= 2 to a smaller one >= 1
+            uint32_t oldBefore = std::count(prev.begin(), prev.end(), oldC);
+            uint32_t oldAfter = std::count(cur.begin(), cur.end(), oldC);
+            if (oldBefore > oldAfter && oldAfter >= 1 && cpnRising[oldC])
+                riseFall = true;
+            // check if new cluster went up from copy number >= 1 to a greater one >= 2
+            uint32_t newBefore = std::count(prev.begin(), prev.end(), newC);
+            uint32_t newAfter = std::count(cur.begin(), cur.end(), newC);
+            if (newAfter > newBefore && newBefore >= 1)
+                cpnRising[newC] = true;
+            // check if one cluster has been rising and then falling in the current block
+            if (riseFall)
+                dissim += riseFallDissim;
+            // count general switches
+            dissim++;
+        }
+
+        if (dissim >= dissimThreshold) {
+            std::fill(cpnRising.begin(), cpnRising.end(), false);
+            cutPositions.push_back(i);
+            for (uint32_t j = 0; j < numHaps; j++)
+                if (std::find(clustersCut.begin(), clustersCut.end(), prev[j]) != clustersCut.end())
+                    haploidCuts[j].push_back(i);
+        }
+    }
+}
@@ -0,0 +1,120 @@
+#ifndef BLOCKPHASER_H
+#define BLOCKPHASER_H
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include "../readset.h"
+#include "readscoreindex.h"
+#include "trianglesparsematrix.h"
+#include "threadingpreprocessor.h"
+
+/**
+ * Result of phasing a single block: the clusters of reads (by read id inside the block), the tuple of clusters for every
+ * variant, the haplotypes as strings over allele ids, the first position of every phasing block and the first position of
+ * every block on each haplotype.
+ */
+struct BlockPhasingResult {
+    std::vector<std::vector<uint32_t>> clustering;
+    std::vector<std::vector<GlobalClusterId>> path;
+    std::vector<std::string> haplotypes;
+    std::vector<Position> cutPositions;
+    std::vector<std::vector<Position>> haploidCuts;
+};
+
+/**
+ * Runs the polyploid phasing (read scoring, cluster editing with refinements and threading) for a set of independent blocks.
+ * The blocks are distributed over worker threads, starting with the most expensive ones. All workers read the same read sets,
+ * which are not modified. Each block is phased in the same way regardless of the number of threads, so the results do not
+ * depend on it.
+ */
+class BlockPhaser {
+
+public:
+    /**
+     * @param ploidy Number of haplotypes to phase
+     * @param minOverlap Minimum number of shared variants of two reads to compute a similarity score
+     * @param bundleEdges Whether the cluster editing heuristic bundles edges (see ClusterEditingSolver)
+     * @param refinements Maximum number of cluster editing refinements on inconsistent clusters
+     * @param blockCutSensitivity Policy for cutting the threaded haplotypes into phasing blocks (0 to 5)
+     * @param beamWidth If positive, only this many tuples are kept per variant by the threading (see HaploThreader)
+     * @param threadingMemory If positive, maximum memory in bytes for the threading DP table of a block
+     * @param threads Maximum number of threads. Blocks are phased concurrently, and each block uses its share of the threads.
+     */
+    BlockPhaser(uint32_t ploidy, uint32_t minOverlap, bool bundleEdges, uint32_t refinements, uint32_t blockCutSensitivity,
+                uint32_t beamWidth = 0, uint64_t threadingMemory = 0, uint32_t threads = 1);
+
+    /**
+     * Phases all blocks and returns one result per block (in the given order).
+     *
+     * @param blocks The read set of every block
+     * @param genotypes For every block, the genotype of every variant as a map from allele to its multiplicity
+     * @param index If given, the read pairs are scored from this index of the read set that the blocks were split from,
+     *              instead of counting their overlaps and differences again
+     * @param blockStarts The rank of the first variant of every block in the index, followed by the number of variants
+     */
+    std::vector<BlockPhasingResult> phaseBlocks(const std::vector<ReadSet*>& blocks,
+                                                const std::vector<std::vector<std::unordered_map<uint32_t, uint32_t>>>& genotypes,
+                                                const ReadScoreIndex* index = nullptr,
+                                                const std::vector<uint32_t>& blockStarts = std::vector<uint32_t>()) const;
+
+    /**
+     * Phases a single block using the given number of threads. If an index of the block is given, the read pairs are
+     * scored from it.
+     */
+    BlockPhasingResult phaseBlock(ReadSet* block, const std::vector<std::unordered_map<uint32_t, uint32_t>>& genotypes,
+                                  const uint32_t blockThreads, const ReadScoreIndex* blockIndex = nullptr) const;
+
+    /**
+     * Computes the positions, at which the threaded haplotypes are cut into phasing blocks according to the block cut
+     * sensitivity. The levels mean:
+     *
+     * 0 -- No cuts at all, even if regions are not connected by any reads
+     * 1 -- Only cut, when regions are not connected by any reads (already done when splitting the blocks)
+     * 2 -- Only cut, when regions are not connected by a sufficient number of reads (also already done in advance)
+     * 3 -- Cut between two positions, if at least two haplotypes switch their cluster on this transition. In this case it
+     *      is ambiguous, how the haplotypes are continued.
+     * 4 -- Additionally to 3, cut every time a haplotype leaves a collapsed region (a cluster that several haplotypes go
+     *      through), unless the cluster has contained these haplotypes since the start of the current block. Default option.
+     * 5 -- Cut every time a haplotype switches clusters. Most conservative, but also very short blocks.
+     *
+     * cutPositions receives the first position of every block (so 0 is always contained) and haploidCuts the cut
+     * positions of every haplotype individually.
+     */
+    void computeCutPositions(const std::vector<std::vector<GlobalClusterId>>& path, const uint32_t numClusters,
+                             std::vector<Position>& cutPositions, std::vector<std::vector<Position>>& haploidCuts) const;
+
+private:
+    // expected error rate and significance level for detecting clusters, which contain reads from different haplotypes
+    static constexpr double EXPECTED_ERROR = 0.05;
+    static constexpr double P_VALUE_THRESHOLD = 0.02;
+
+    uint32_t ploidy;
+    uint32_t minOverlap;
+    bool bundleEdges;
+    uint32_t refinements;
+    uint32_t blockCutSensitivity;
+    uint32_t beamWidth;
+    uint64_t threadingMemory;
+    uint32_t threads;
+
+    /**
+     * Phases a block with a single variant by using the genotype as phasing.
+     */
+    BlockPhasingResult phaseSingletonBlock(ReadSet* block, const std::unordered_map<uint32_t, uint32_t>& genotype) const;
+
+    /**
+     * Returns the number of positions, at which a cluster has a significantly ambiguous consensus (counting a position once
+     * per inconsistent cluster), and forbids all read pairs with different alleles on these positions in the similarities.
+     */
+    uint32_t findInconsistencies(ReadSet* block, const std::vector<std::vector<uint32_t>>& clustering,
+                                 TriangleSparseMatrix& similarities) const;
+
+    /**
+     * Returns the probability to observe at least k successes in n Bernoulli trials with success probability p.
+     */
+    static double binomialUpperTail(uint32_t k, uint32_t n, double p);
+};
+
+#endif
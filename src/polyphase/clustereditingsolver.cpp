@@ -1,9 +1,151 @@
 #include "clustereditingsolver.h"
+#include "../instrumentation.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+
+using NodeId = StaticSparseGraph::NodeId;
 
 ClusterEditingSolution ClusterEditingSolver::run() {
-    StaticSparseGraph sGraph(m);
-    InducedCostHeuristic instance(sGraph, bundleEdges);
-    ClusterEditingSolution solution = instance.solve();
+    instrumentation::ScopedTimer timer(CLUSTER_EDITING_NS);
+    NodeId numNodes = m.getMaxDim();
+    instrumentation::add(CLUSTER_EDITING_RUNS, 1);
+    instrumentation::add(CLUSTER_EDITING_NODES, numNodes);
+    std::vector<TriangleSparseMatrix::Entry>& entries = m.getSortedEntries();
+
+    // find connected components over positive edges (union-find with path halving and union by size)
+    std::vector<NodeId> parent(numNodes);
+    std::vector<NodeId> componentSize(numNodes, 1);
+    for (NodeId u = 0; u < numNodes; u++) {
+        parent[u] = u;
+    }
+    auto find = [&parent] (NodeId u) {
+        while (parent[u] != u) {
+            parent[u] = parent[parent[u]];
+            u = parent[u];
+        }
+        return u;
+    };
+    for (const TriangleSparseMatrix::Entry& entry : entries) {
+        if (entry.item.v <= 0.0f)
+            continue;
+        NodeId ru = find(entry.row());
+        NodeId rv = find(entry.col());
+        if (ru == rv)
+            continue;
+        if (componentSize[ru] < componentSize[rv])
+            std::swap(ru, rv);
+        parent[rv] = ru;
+        componentSize[ru] += componentSize[rv];
+    }
+
+    // nodes of each component in ascending order, such that the heuristic sees them in the same order
+    std::vector<std::vector<NodeId>> components;
+    std::vector<NodeId> componentOfRoot(numNodes, StaticSparseGraph::InvalidNodeId);
+    std::vector<NodeId> localId(numNodes, 0);
+    for (NodeId u = 0; u < numNodes; u++) {
+        NodeId r = find(u);
+        if (componentOfRoot[r] == StaticSparseGraph::InvalidNodeId) {
+            componentOfRoot[r] = components.size();
+            components.push_back(std::vector<NodeId>());
+        }
+        std::vector<NodeId>& component = components[componentOfRoot[r]];
+        localId[u] = component.size();
+        component.push_back(u);
+    }
+
+    if (components.size() <= 1) {
+        return solve(m, threads);
+    }
+
+    // copy the edges of each non-trivial component, relabeling its nodes to 0, ..., size-1
+    std::vector<TriangleSparseMatrix> instances(components.size());
+    std::vector<uint64_t> numEntries(components.size(), 0);
+    for (const TriangleSparseMatrix::Entry& entry : entries) {
+        NodeId c = componentOfRoot[find(entry.row())];
+        if (c == componentOfRoot[find(entry.col())])
+            numEntries[c]++;
+    }
+    std::vector<uint32_t> jobs;
+    for (uint32_t c = 0; c < components.size(); c++) {
+        if (components[c].size() > 1) {
+            instances[c].reserve(numEntries[c]);
+            jobs.push_back(c);
+        }
+    }
+    for (const TriangleSparseMatrix::Entry& entry : entries) {
+        NodeId u = entry.row();
+        NodeId v = entry.col();
+        NodeId c = componentOfRoot[find(u)];
+        if (c == componentOfRoot[find(v)])
+            instances[c].set(localId[u], localId[v], entry.item.v);
+    }
+
+    // solve non-trivial components, largest first
+    std::stable_sort(jobs.begin(), jobs.end(), [&components] (uint32_t a, uint32_t b) { return components[a].size() > components[b].size(); });
+
+    std::vector<ClusterEditingSolution> solutions(components.size());
+    uint32_t numThreads = std::max(1u, std::min(threads, (uint32_t)jobs.size()));
+    // a single large component gets all threads for the heuristic itself
+    uint32_t heuristicThreads = jobs.size() == 1 ? threads : 1;
+    std::atomic<uint32_t> nextJob(0);
+    auto work = [&] () {
+        for (uint32_t j = nextJob++; j < jobs.size(); j = nextJob++) {
+            solutions[jobs[j]] = solve(instances[jobs[j]], heuristicThreads);
+            instances[jobs[j]] = TriangleSparseMatrix();
+        }
+    };
+    if (numThreads == 1) {
+        work();
+    } else {
+        std::vector<std::thread> workers;
+        std::vector<std::exception_ptr> errors(numThreads);
+        for (uint32_t t = 0; t < numThreads; t++) {
+            workers.emplace_back([&, t] () {
+                try {
+                    work();
+                } catch (...) {
+                    errors[t] = std::current_exception();
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        for (std::exception_ptr& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    // merge the solutions, ordering clusters by their smallest node as the heuristic does
+    double totalCost = 0.0;
+    std::vector<std::vector<NodeId>> clusters;
+    for (uint32_t c = 0; c < components.size(); c++) {
+        if (components[c].size() == 1) {
+            clusters.push_back(components[c]);
+            continue;
+        }
+        if (!solutions[c].isValid()) {
+            return ClusterEditingSolution();
+        }
+        totalCost += solutions[c].getTotalCost();
+        for (uint32_t k = 0; k < solutions[c].getNumClusters(); k++) {
+            std::vector<NodeId> cluster;
+            for (NodeId v : solutions[c].getCluster(k)) {
+                cluster.push_back(components[c][v]);
+            }
+            clusters.push_back(cluster);
+        }
+    }
+    std::sort(clusters.begin(), clusters.end(), [] (const std::vector<NodeId>& a, const std::vector<NodeId>& b) { return a[0] < b[0]; });
+    return ClusterEditingSolution(totalCost, clusters);
+}
 
-    return solution;
+ClusterEditingSolution ClusterEditingSolver::solve(TriangleSparseMatrix& instance, const uint32_t heuristicThreads) const {
+    StaticSparseGraph sGraph(instance);
+    InducedCostHeuristic heuristic(sGraph, bundleEdges, heuristicThreads);
+    return heuristic.solve();
 }
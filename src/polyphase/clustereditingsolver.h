@@ -15,6 +15,11 @@
 /**
  * Central solver for cluster editing instances. Uses a InducedCostHeuristic to
  * determine a low-cost transformation of the given graph into a clique graph.
+ * 
+ * Nodes which are not connected by a path of positive edges never end up in the
+ * same cluster, and the induced costs of an edge only depend on triangles with
+ * two positive edges. Therefore, the connected components of the graph restricted
+ * to positive edges are solved independently (and in parallel, if threads > 1).
  */
 class ClusterEditingSolver {
 
@@ -30,11 +35,14 @@ public:
      *      this option is enabled, these groups of edges are treated as bundles,
      *      with shared and combined induced costs. If disabled, each edge is treated
      *      individually.
+     * @param threads Number of threads used by the heuristic. The solution does not
+     *      depend on it.
      */
 
-    ClusterEditingSolver(TriangleSparseMatrix& m, bool bundleEdges) :
+    ClusterEditingSolver(TriangleSparseMatrix& m, bool bundleEdges, uint32_t threads = 1) :
 		m(m), 
-		bundleEdges(bundleEdges)
+		bundleEdges(bundleEdges),
+		threads(threads)
     {};
 
     /**
@@ -46,8 +54,14 @@ public:
     ClusterEditingSolution run();
 
 private:
+    /**
+     * Solves the given instance using the given number of threads for the heuristic.
+     */
+    ClusterEditingSolution solve(TriangleSparseMatrix& instance, const uint32_t heuristicThreads) const;
+
     TriangleSparseMatrix& m;
     bool bundleEdges;
+    uint32_t threads;
 };
 
 #endif
@@ -1,6 +1,9 @@
 #include "edgeheap.h"
 #include <cmath>
 #include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
   
 using Edge = StaticSparseGraph::Edge;
 using EdgeWeight = StaticSparseGraph::EdgeWeight;
@@ -8,6 +11,11 @@ using EdgeId = StaticSparseGraph::EdgeId;
 using RankId = StaticSparseGraph::RankId;
 using NodeId = StaticSparseGraph::NodeId;
 
+// induced costs are only initialized on several threads if each thread gets at least this many nodes
+static const NodeId MIN_NODES_PER_THREAD = 64;
+// number of consecutive nodes whose edges are processed by a thread at a time
+static const NodeId NODES_PER_BLOCK = 16;
+
 EdgeHeap::EdgeHeap(StaticSparseGraph& param_graph) :
     graph(param_graph),
     unprocessed(0),
@@ -20,10 +28,94 @@ EdgeHeap::EdgeHeap(StaticSparseGraph& param_graph) :
     edgeBundles(1+param_graph.numEdges(), std::vector<RankId>(0))
 {}
 
-void EdgeHeap::initInducedCosts() {
-    uint64_t numNodes = graph.numNodes();
+void EdgeHeap::initInducedCosts(const uint32_t threads) {
+    NodeId numNodes = graph.numNodes();
+    uint32_t numThreads = std::max(1u, std::min(threads, numNodes / MIN_NODES_PER_THREAD));
+    
     // compute array: edge -> icf/icp
-    for (NodeId u = 0; u < numNodes; u++) {
+    if (numThreads == 1) {
+        unprocessed += initInducedCosts(0, numNodes);
+    } else {
+        /* Every edge uv (u < v) is handled by the thread processing node u, so each entry of icf and icp is
+         * written by one thread only, and with the same order of summation as without threads. Blocks of
+         * nodes are handed out one at a time, since the number of triangles per node varies a lot. */
+        std::atomic<NodeId> nextBlock(0);
+        NodeId numBlocks = (numNodes + NODES_PER_BLOCK - 1) / NODES_PER_BLOCK;
+        std::vector<uint64_t> counts(numThreads, 0);
+        std::vector<std::thread> workers;
+        std::vector<std::exception_ptr> errors(numThreads);
+        for (uint32_t t = 0; t < numThreads; t++) {
+            workers.emplace_back([&, t]() {
+                try {
+                    for (NodeId block = nextBlock++; block < numBlocks; block = nextBlock++) {
+                        NodeId first = block * NODES_PER_BLOCK;
+                        counts[t] += initInducedCosts(first, std::min(first + NODES_PER_BLOCK, numNodes));
+                    }
+                } catch (...) {
+                    errors[t] = std::current_exception();
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        for (std::exception_ptr& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+        for (uint64_t count : counts) {
+            unprocessed += count;
+        }
+    }
+    
+    for (unsigned int i = 0; i < icf.size(); i++){
+        if(std::isnan(icf[graph.findIndex(i)])) {
+            std::cout<<"NaN! in icf"<<std::endl;
+            break;
+        }
+        if(std::isnan(icp[graph.findIndex(i)])) {
+            std::cout<<"NaN! in icp"<<std::endl;
+            break;
+        }
+    }
+    
+    // sort edges by icf and icp values
+    for (RankId id = 0; id < icf.size(); id++) {
+        forb_rank2edge.push_back(id);
+        perm_rank2edge.push_back(id);
+    }
+    
+    /* A sorted vector is a valid max-heap. Building the heaps with a linear-time heapify instead would change
+     * the order of edges with equal induced costs, and thereby the solution, so both vectors are still sorted
+     * (in parallel, if possible). */
+    auto sortIcf = [this] () { std::sort(forb_rank2edge.begin(), forb_rank2edge.end(), [this] (const EdgeId& a, const EdgeId& b) { return icf[a] > icf[b]; }); };
+    auto sortIcp = [this] () { std::sort(perm_rank2edge.begin(), perm_rank2edge.end(), [this] (const EdgeId& a, const EdgeId& b) { return icp[a] > icp[b]; }); };
+    if (numThreads > 1) {
+        std::thread icfSorter(sortIcf);
+        sortIcp();
+        icfSorter.join();
+    } else {
+        sortIcf();
+        sortIcp();
+    }
+    
+    // save index in sorted vectors for each edge
+    for (RankId i = 0; i < icf.size(); i++) {
+        edge2forb_rank[forb_rank2edge[i]] = i;
+        edge2perm_rank[perm_rank2edge[i]] = i;
+    }
+    
+    // initialize edge bundles
+    for (RankId id = 0; id < icf.size(); id++) {
+        edgeToBundle[id] = id;
+        edgeBundles[id].push_back(id);
+    }
+}
+
+uint64_t EdgeHeap::initInducedCosts(const NodeId firstNode, const NodeId endNode) {
+    uint64_t count = 0;
+    for (NodeId u = firstNode; u < endNode; u++) {
         for (NodeId v : graph.getNonZeroNeighbours(u)) {
             if (v < u)
                 continue;
@@ -47,7 +139,7 @@ void EdgeHeap::initInducedCosts() {
             } else {
                 icf[rId] = 0.0;
                 icp[rId] = 0.0;
-                unprocessed++;
+                count++;
             }
             
             // costs for the edge uv itself
@@ -74,38 +166,7 @@ void EdgeHeap::initInducedCosts() {
             }
         }
     }
-    
-    for (unsigned int i = 0; i < icf.size(); i++){
-        if(std::isnan(icf[graph.findIndex(i)])) {
-            std::cout<<"NaN! in icf"<<std::endl;
-            break;
-        }
-        if(std::isnan(icp[graph.findIndex(i)])) {
-            std::cout<<"NaN! in icp"<<std::endl;
-            break;
-        }
-    }
-    
-    // sort edges by icf and icp values
-    for (RankId id = 0; id < icf.size(); id++) {
-        forb_rank2edge.push_back(id);
-        perm_rank2edge.push_back(id);
-    }
-    
-    std::sort(forb_rank2edge.begin(), forb_rank2edge.end(), [this] (const EdgeId& a, const EdgeId& b) { return icf[a] > icf[b]; });
-    std::sort(perm_rank2edge.begin(), perm_rank2edge.end(), [this] (const EdgeId& a, const EdgeId& b) { return icp[a] > icp[b]; });
-    
-    // save index in sorted vectors for each edge
-    for (RankId i = 0; i < icf.size(); i++) {
-        edge2forb_rank[forb_rank2edge[i]] = i;
-        edge2perm_rank[perm_rank2edge[i]] = i;
-    }
-    
-    // initialize edge bundles
-    for (RankId id = 0; id < icf.size(); id++) {
-        edgeToBundle[id] = id;
-        edgeBundles[id].push_back(id);
-    }
+    return count;
 }
 
 Edge EdgeHeap::getMaxIcfEdge() const {
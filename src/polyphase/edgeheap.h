@@ -17,9 +17,10 @@ public:
     EdgeHeap(StaticSparseGraph& param_graph);
   
     /**
-     * Initializes the induced costs for all edges. May take quite long!
+     * Initializes the induced costs for all edges. May take quite long! The edges are processed on the given
+     * number of threads; the result does not depend on it.
      */
-    void initInducedCosts();
+    void initInducedCosts(const uint32_t threads = 1);
     
     /**
     * Returns the edge with the highest icf.
@@ -90,6 +91,12 @@ public:
     uint64_t numUnprocessed() const;
 
 private:
+    /**
+     * Initializes the induced costs of all edges uv with u in [firstNode, endNode). Returns the number of edges,
+     * which are neither zero, forbidden nor permanent.
+     */
+    uint64_t initInducedCosts(const StaticSparseGraph::NodeId firstNode, const StaticSparseGraph::NodeId endNode);
+
     /**
      * Removes the edge with the specified rank
      */
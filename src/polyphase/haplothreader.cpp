@@ -1,18 +1,27 @@
 #include "haplothreader.h"
+#include "threadingpreprocessor.h"
+#include "../instrumentation.h"
 #include <limits>
 #include <algorithm>
 #include <unordered_set>
 #include <random>
+#include <atomic>
+#include <thread>
+#include <exception>
 
 constexpr uint64_t ClusterTuple::TUPLE_MASKS[];
 const ClusterTuple ClusterTuple::INVALID_TUPLE = ClusterTuple((TupleCode)-1);
 
-HaploThreader::HaploThreader (uint32_t ploidy, double switchCost, double affineSwitchCost, bool symmetryOptimization, uint32_t rowLimit) :
+HaploThreader::HaploThreader (uint32_t ploidy, double switchCost, double affineSwitchCost, bool symmetryOptimization, uint32_t rowLimit,
+                              uint32_t beamWidth, uint64_t maxMemory, uint32_t threads) :
     ploidy(ploidy),
     switchCost(switchCost),
     affineSwitchCost(affineSwitchCost),
     symmetryOptimization(symmetryOptimization),
-    rowLimit(rowLimit)
+    rowLimit(rowLimit),
+    beamWidth(beamWidth),
+    maxMemory(maxMemory),
+    threads(std::max(1U, threads))
 {
 }
 
@@ -22,21 +31,79 @@ std::vector<std::vector<GlobalClusterId>> HaploThreader::computePaths (const std
                     const std::vector<std::vector<uint32_t>>& consensus,
                     const std::vector<std::unordered_map<uint32_t, uint32_t>>& genotypes
                    ) const {
+    instrumentation::ScopedTimer timer(THREADING_NS);
     Position numVars = covMap.size();
-    std::vector<std::vector<GlobalClusterId>> path;
+    instrumentation::add(THREADING_POSITIONS, numVars);
+    std::vector<std::pair<Position, Position>> segments;
     for (uint32_t i = 0; i < blockStarts.size(); i++) {
         Position start = blockStarts[i];
         Position end = i == blockStarts.size()-1 ? numVars : blockStarts[i+1];
-        if (end > start) {
-            std::vector<std::vector<GlobalClusterId>> section = computePaths(blockStarts[i], end, covMap, coverage, consensus, genotypes, numVars);
-            for (auto tuple : section) {
-                path.push_back(tuple);
+        if (end > start)
+            segments.push_back(std::pair<Position, Position>(start, end));
+    }
+    
+    // segments are independent, so they are threaded concurrently (longest first) if more than one thread is available
+    std::vector<std::vector<std::vector<GlobalClusterId>>> sections(segments.size());
+    uint32_t numWorkers = std::min(threads, (uint32_t)segments.size());
+    if (numWorkers <= 1) {
+        for (uint32_t i = 0; i < segments.size(); i++)
+            sections[i] = computeSegment(segments[i].first, segments[i].second, covMap, coverage, consensus, genotypes, numVars, threads, maxMemory);
+    } else {
+        std::vector<uint32_t> order(segments.size());
+        for (uint32_t i = 0; i < segments.size(); i++)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&segments] (uint32_t a, uint32_t b) {
+            return segments[a].second - segments[a].first > segments[b].second - segments[b].first;
+        });
+        uint32_t innerThreads = std::max(1U, threads / numWorkers);
+        std::atomic<uint32_t> next(0);
+        std::vector<std::exception_ptr> errors(numWorkers);
+        std::vector<std::thread> workers;
+        for (uint32_t t = 0; t < numWorkers; t++) {
+            workers.emplace_back([&, t] () {
+                try {
+                    for (uint32_t k = next++; k < order.size(); k = next++) {
+                        uint32_t i = order[k];
+                        sections[i] = computeSegment(segments[i].first, segments[i].second, covMap, coverage, consensus, genotypes,
+                                                     numVars, innerThreads, maxMemory / numWorkers);
+                    }
+                } catch (...) {
+                    errors[t] = std::current_exception();
+                }
+            });
+        }
+        for (std::thread& worker : workers)
+            worker.join();
+        for (std::exception_ptr& error : errors)
+            if (error)
+                std::rethrow_exception(error);
+    }
+    
+    // stitch sections together: each section is permuted, such that its haplotypes continue the ones of the previous section
+    std::vector<std::vector<GlobalClusterId>> path;
+    for (std::vector<std::vector<GlobalClusterId>>& section : sections) {
+        if (!path.empty() && !section.empty() && path.back().size() == ploidy && section[0].size() == ploidy) {
+            std::vector<uint32_t> perm = getStitchPermutation(path.back(), section[0]);
+            for (std::vector<GlobalClusterId>& tuple : section) {
+                std::vector<GlobalClusterId> permuted(ploidy);
+                for (uint32_t j = 0; j < ploidy; j++)
+                    permuted[j] = tuple[perm[j]];
+                tuple.swap(permuted);
             }
         }
+        for (std::vector<GlobalClusterId>& tuple : section)
+            path.push_back(tuple);
     }
     return path;
 }
 
+std::vector<std::vector<GlobalClusterId>> HaploThreader::computePaths (const ThreadingPreprocessor& preprocessor,
+                    const std::vector<std::unordered_map<uint32_t, uint32_t>>& genotypes
+                   ) const {
+    return computePaths(preprocessor.getIndependentStarts(), preprocessor.getCovMap(), preprocessor.getCompressedCoverage(),
+                        preprocessor.getCompressedConsensus(), genotypes);
+}
+
 std::vector<std::vector<GlobalClusterId>> HaploThreader::computePaths (Position start, Position end, 
                     const std::vector<std::vector<GlobalClusterId>>& covMap,
                     const std::vector<std::vector<double>>& coverage, 
@@ -44,6 +111,20 @@ std::vector<std::vector<GlobalClusterId>> HaploThreader::computePaths (Position
                     const std::vector<std::unordered_map<uint32_t, uint32_t>>& genotypes,
                     Position displayedEnd
                    ) const {
+    instrumentation::ScopedTimer timer(THREADING_NS);
+    instrumentation::add(THREADING_POSITIONS, end - start);
+    return computeSegment(start, end, covMap, coverage, consensus, genotypes, displayedEnd, threads, maxMemory);
+}
+
+std::vector<std::vector<GlobalClusterId>> HaploThreader::computeSegment (Position start, Position end, 
+                    const std::vector<std::vector<GlobalClusterId>>& covMap,
+                    const std::vector<std::vector<double>>& coverage, 
+                    const std::vector<std::vector<uint32_t>>& consensus,
+                    const std::vector<std::unordered_map<uint32_t, uint32_t>>& genotypes,
+                    Position displayedEnd,
+                    uint32_t numThreads,
+                    uint64_t memory
+                   ) const {
     
     // the actual DP table with sparse columns
     std::vector<std::unordered_map<ClusterTuple, ClusterEntry>> m;
@@ -56,6 +137,9 @@ std::vector<std::vector<GlobalClusterId>> HaploThreader::computePaths (Position
         displayedEnd = end;
     Position firstUnthreadedPosition = start;
     
+    // number of tuples to keep per position (zero if all tuples are computed)
+    uint32_t beam = getBeamWidth(end - start, memory);
+    
     /*
      * Compute the genotype conform tuples for the first column and quit if this set is empty.
      * Note that tuples in general only contain local cluster ids, which must be mapped by covMap[column_id]
@@ -92,6 +176,16 @@ std::vector<std::vector<GlobalClusterId>> HaploThreader::computePaths (Position
         }
     }
     
+    // in beam mode, only keep the best tuples
+    if (beam > 0 && column.size() > beam) {
+        std::vector<std::pair<ClusterTuple, ClusterEntry>> tuplePairs(column.begin(), column.end());
+        std::sort(tuplePairs.begin(), tuplePairs.end(), [] (const std::pair<ClusterTuple, ClusterEntry>& a, const std::pair<ClusterTuple, ClusterEntry>& b) {
+            return a.second.score < b.second.score || (a.second.score == b.second.score && a.first.asNumber() < b.first.asNumber());
+        });
+        column.clear();
+        column.insert(tuplePairs.begin(), tuplePairs.begin() + beam);
+    }
+    
     // cut down rows if parameter is set
     if (rowLimit > 0 && column.size() >= rowLimit) {
         std::vector<std::pair<ClusterTuple, ClusterEntry>> tuplePairs(column.begin(), column.end());
@@ -106,7 +200,7 @@ std::vector<std::vector<GlobalClusterId>> HaploThreader::computePaths (Position
     
     // precompute the sorted vector with global cluster ids for every entry in first column
     for (std::pair<ClusterTuple, ClusterEntry> predEntry : m[0]) {
-        std::vector<GlobalClusterId> tupleGlobal = predEntry.first.asVector(ploidy, covMap[0]);
+        std::vector<GlobalClusterId> tupleGlobal = predEntry.first.asVector(ploidy, covMap[start]);
         std::sort(tupleGlobal.begin(), tupleGlobal.end());
         sortedGlobalTuples[predEntry.first] = tupleGlobal;
     }
@@ -149,97 +243,82 @@ std::vector<std::vector<GlobalClusterId>> HaploThreader::computePaths (Position
         minimumTupleInColumn = ClusterTuple::INVALID_TUPLE;
         minimumPredTupleInColumn = ClusterTuple::INVALID_TUPLE;
         
-        // compute genotype conform tuples
-        confTuples = computeGenotypeConformTuples(covMap[pos], consensus[pos], genotypes[pos]);
+        if (beam > 0) {
+            // only score the candidate tuples, which can enter the beam
+            std::vector<std::pair<ClusterTuple, ClusterEntry>> rows = computeBeamColumn(pos, beam, m[pos-1-start], sortedGlobalTuples,
+                                                                                         covMap, coverage, consensus, genotypes, numThreads);
+            for (const std::pair<ClusterTuple, ClusterEntry>& row : rows) {
+                column[row.first] = row.second;
+                firstUnthreadedPosition = pos+1;
+                if (row.second.score < minimumInColumn) {
+                    minimumInColumn = row.second.score;
+                    minimumTupleInColumn = row.first;
+                    minimumPredTupleInColumn = row.second.pred;
+                }
+                permedTuples.push_back(row.first);
+            }
+        } else {
+            // compute genotype conform tuples
+            confTuples = computeGenotypeConformTuples(covMap[pos], consensus[pos], genotypes[pos]);
         
-        // iterate over generated tuples
-        for (ClusterTuple rowTuple : confTuples) {
-            // variables to store best score and backtracking direction
-            minimum = std::numeric_limits<Score>::infinity();
-            minimumPred = ClusterTuple::INVALID_TUPLE;
+            // iterate over generated tuples
+            for (ClusterTuple rowTuple : confTuples) {
+                // variables to store best score and backtracking direction
+                minimum = std::numeric_limits<Score>::infinity();
+                minimumPred = ClusterTuple::INVALID_TUPLE;
             
-            // auxiliary data, is precomputed once here
-            std::vector<GlobalClusterId> rowTupleGlobal = rowTuple.asVector(ploidy, covMap[pos]);
-            std::sort(rowTupleGlobal.begin(), rowTupleGlobal.end());
+                // auxiliary data, is precomputed once here
+                std::vector<GlobalClusterId> rowTupleGlobal = rowTuple.asVector(ploidy, covMap[pos]);
+                std::sort(rowTupleGlobal.begin(), rowTupleGlobal.end());
             
-            // this is the tuple into which the rowTuple will be transformed when the best permutation is found
-            ClusterTuple bestPerm;
+                // this is the tuple into which the rowTuple will be transformed when the best permutation is found
+                ClusterTuple bestPerm;
             
-            // compare each new tuple with every tuple from previous column
-            for (std::pair<ClusterTuple, ClusterEntry> predEntry : m[pos-1-start]) {
-                
-                // retrieve precomputed sorted vector over global ids
-                std::vector<GlobalClusterId> prevTupleGlobal = sortedGlobalTuples[predEntry.first];
-                
-                // compute optimal switch cost
-                Score s = predEntry.second.score + getSwitchCostAllPerms(prevTupleGlobal, rowTupleGlobal);
+                // compare each new tuple with every tuple from previous column
+                for (std::pair<ClusterTuple, ClusterEntry> predEntry : m[pos-1-start]) {
                 
-                if (s < minimum) {
-                    minExists = true;
-                    minimum = s;
-                    // minDissim = d;
-                    minimumPred = predEntry.first;
-                }
-            }
-            
-            if (minExists) {
-                // in addition to best score over all predecessors, we need the best permutation of rowTuple to achieve this
-                std::vector<GlobalClusterId> prevTuple = sortedGlobalTuples[minimumPred];
-                std::vector<uint32_t> residualPosPrev; // positions in previous tuple, which could not be matched to position in current tuple
-                std::vector<uint32_t> residualPosCur; // positions in current tuple, which could not be matched to position in previous tuple
-                getSwitchCostAllPerms(prevTuple, rowTupleGlobal, residualPosPrev, residualPosCur);
+                    // retrieve precomputed sorted vector over global ids
+                    std::vector<GlobalClusterId> prevTupleGlobal = sortedGlobalTuples[predEntry.first];
                 
-                if (residualPosPrev.size() != residualPosCur.size()) {
-                    std::cout<<"Residual sizes unequal"<<std::endl;
-                    for (auto i = prevTuple.begin(); i != prevTuple.end(); ++i)
-                        std::cout << *i << ' ';
-                    std::cout<<std::endl;
-                    for (auto i = rowTupleGlobal.begin(); i != rowTupleGlobal.end(); ++i)
-                        std::cout << *i << ' ';
-                    std::cout<<std::endl;
-                }
+                    // compute optimal switch cost
+                    Score s = predEntry.second.score + getSwitchCostAllPerms(prevTupleGlobal, rowTupleGlobal);
                 
-                std::vector<GlobalClusterId> bestPermGlobal(minimumPred.asVector(ploidy, covMap[pos-1]));
-                for (uint32_t i = 0; i < residualPosCur.size(); i++) {
-                    GlobalClusterId residueCur = rowTupleGlobal[residualPosCur[i]];
-                    GlobalClusterId residuePrev = prevTuple[residualPosPrev[i]];
-                    for (uint32_t j = 0; j < ploidy; j++) {
-                        if (bestPermGlobal[j] == residuePrev) {
-                            bestPermGlobal[j] = residueCur;
-                            break;
-                        }
+                    if (s < minimum) {
+                        minExists = true;
+                        minimum = s;
+                        // minDissim = d;
+                        minimumPred = predEntry.first;
                     }
                 }
             
-                std::unordered_map<GlobalClusterId, LocalClusterId> globalToLocal;
-                for (uint32_t i = 0; i < covMap[pos].size(); i++)
-                    globalToLocal[covMap[pos][i]] = i;
-                for (uint32_t i = 0; i < ploidy; i++)
-                    bestPerm.set(globalToLocal[bestPermGlobal[i]], i);
-            } else {
-                bestPerm = rowTuple;
-            }
+                if (minExists) {
+                    // in addition to best score over all predecessors, we need the best permutation of rowTuple to achieve this
+                    bestPerm = getBestPermutation(minimumPred, sortedGlobalTuples[minimumPred], rowTupleGlobal, covMap[pos-1], covMap[pos]);
+                } else {
+                    bestPerm = rowTuple;
+                }
             
-            Score coverageCost = getCoverageCost(rowTuple, coverage[pos]);
-            if (coverageCost != getCoverageCost(bestPerm, coverage[pos])) {
-                std::cout<<"Row tuples have unequal coverage cost"<<std::endl;
-                std::cout<<rowTuple.asString(ploidy, covMap[pos])<<std::endl;
-                std::cout<<bestPerm.asString(ploidy, covMap[pos])<<std::endl;
-            }
+                Score coverageCost = getCoverageCost(rowTuple, coverage[pos]);
+                if (coverageCost != getCoverageCost(bestPerm, coverage[pos])) {
+                    std::cout<<"Row tuples have unequal coverage cost"<<std::endl;
+                    std::cout<<rowTuple.asString(ploidy, covMap[pos])<<std::endl;
+                    std::cout<<bestPerm.asString(ploidy, covMap[pos])<<std::endl;
+                }
             
-            // report best recursion
-            if (minExists) {
-                column[bestPerm] = ClusterEntry(minimum + coverageCost, minimumPred);
-            } else {
-                column[bestPerm] = ClusterEntry(coverageCost, ClusterTuple::INVALID_TUPLE);
-            }
-            firstUnthreadedPosition = pos+1;
-            if (column[bestPerm].score < minimumInColumn) {
-                minimumInColumn = column[bestPerm].score;
-                minimumTupleInColumn = bestPerm;
-                minimumPredTupleInColumn = minimumPred;
+                // report best recursion
+                if (minExists) {
+                    column[bestPerm] = ClusterEntry(minimum + coverageCost, minimumPred);
+                } else {
+                    column[bestPerm] = ClusterEntry(coverageCost, ClusterTuple::INVALID_TUPLE);
+                }
+                firstUnthreadedPosition = pos+1;
+                if (column[bestPerm].score < minimumInColumn) {
+                    minimumInColumn = column[bestPerm].score;
+                    minimumTupleInColumn = bestPerm;
+                    minimumPredTupleInColumn = minimumPred;
+                }
+                permedTuples.push_back(bestPerm);
             }
-            permedTuples.push_back(bestPerm);
         }
         
         // precompute the sorted vectors with global cluster ids for this column (will be reused in next column)
@@ -343,6 +422,206 @@ std::vector<std::vector<GlobalClusterId>> HaploThreader::computePaths (Position
     return path;
 }
 
+uint32_t HaploThreader::getBeamWidth(Position numPositions, uint64_t memory) const {
+    if (maxMemory == 0 || numPositions == 0)
+        return beamWidth;
+    uint64_t rowsByMemory = std::max((uint64_t)1, memory / ((uint64_t)numPositions * BYTES_PER_ROW));
+    if (beamWidth > 0)
+        return (uint32_t)std::min((uint64_t)beamWidth, rowsByMemory);
+    else
+        return (uint32_t)std::min((uint64_t)std::numeric_limits<uint32_t>::max(), rowsByMemory);
+}
+
+std::vector<std::pair<ClusterTuple, ClusterEntry>> HaploThreader::computeBeamColumn(Position pos, uint32_t beam,
+                    const std::unordered_map<ClusterTuple, ClusterEntry>& prevColumn,
+                    const std::unordered_map<ClusterTuple, std::vector<GlobalClusterId>>& sortedGlobalTuples,
+                    const std::vector<std::vector<GlobalClusterId>>& covMap,
+                    const std::vector<std::vector<double>>& coverage,
+                    const std::vector<std::vector<uint32_t>>& consensus,
+                    const std::vector<std::unordered_map<uint32_t, uint32_t>>& genotypes,
+                    uint32_t numThreads
+                   ) const {
+    typedef std::pair<ClusterTuple, ClusterEntry> Row;
+    // orders rows by score, ties are broken by the tuple, such that results do not depend on hashing or threads
+    auto rowOrder = [] (const Row& a, const Row& b) {
+        return a.second.score < b.second.score || (a.second.score == b.second.score && a.first.asNumber() < b.first.asNumber());
+    };
+    
+    // predecessors sorted by score, such that the search for the best one can stop early
+    std::vector<Row> preds(prevColumn.begin(), prevColumn.end());
+    std::sort(preds.begin(), preds.end(), rowOrder);
+    std::vector<const std::vector<GlobalClusterId>*> predTuplesGlobal;
+    predTuplesGlobal.reserve(preds.size());
+    for (const Row& pred : preds)
+        predTuplesGlobal.push_back(&sortedGlobalTuples.at(pred.first));
+    std::unordered_set<GlobalClusterId> prevClusters(covMap[pos-1].begin(), covMap[pos-1].end());
+    
+    /*
+     * Lower bound on the switch cost of each candidate: every haplotype, which is threaded through a cluster that does not
+     * exist at the previous position, has to switch. Together with the best predecessor score and the (exact) coverage cost,
+     * this bounds the score of a candidate from below.
+     */
+    struct Candidate {
+        ClusterTuple tuple;
+        Score switchBound;
+        Score coverageCost;
+        Score bound;
+    };
+    std::vector<Candidate> candidates;
+    for (ClusterTuple t : computeGenotypeConformTuples(covMap[pos], consensus[pos], genotypes[pos])) {
+        uint32_t newClusters = 0;
+        for (uint32_t i = 0; i < ploidy; i++)
+            newClusters += prevClusters.find(covMap[pos][t.get(i)]) == prevClusters.end();
+        Score switchBound = preds.empty() ? 0.0 : switchCost*newClusters + affineSwitchCost*(newClusters > 0);
+        Score coverageCost = getCoverageCost(t, coverage[pos]);
+        Score bestPred = preds.empty() ? 0.0 : preds[0].second.score;
+        candidates.push_back(Candidate{t, switchBound, coverageCost, bestPred + switchBound + coverageCost});
+    }
+    std::sort(candidates.begin(), candidates.end(), [] (const Candidate& a, const Candidate& b) {
+        return a.bound < b.bound || (a.bound == b.bound && a.tuple.asNumber() < b.tuple.asNumber());
+    });
+    
+    // scores a candidate by finding its best predecessor and the best permutation of it
+    auto scoreCandidate = [&] (const Candidate& c) {
+        std::vector<GlobalClusterId> rowTupleGlobal = c.tuple.asVector(ploidy, covMap[pos]);
+        std::sort(rowTupleGlobal.begin(), rowTupleGlobal.end());
+        Score minimum = std::numeric_limits<Score>::infinity();
+        uint32_t minimumPred = preds.size();
+        for (uint32_t j = 0; j < preds.size(); j++) {
+            // all remaining predecessors have a higher score
+            if (preds[j].second.score + c.switchBound >= minimum)
+                break;
+            Score s = preds[j].second.score + getSwitchCostAllPerms(*predTuplesGlobal[j], rowTupleGlobal);
+            if (s < minimum) {
+                minimum = s;
+                minimumPred = j;
+            }
+        }
+        if (minimumPred < preds.size()) {
+            ClusterTuple bestPerm = getBestPermutation(preds[minimumPred].first, *predTuplesGlobal[minimumPred], rowTupleGlobal,
+                                                       covMap[pos-1], covMap[pos]);
+            return Row(bestPerm, ClusterEntry(minimum + c.coverageCost, preds[minimumPred].first));
+        } else {
+            return Row(c.tuple, ClusterEntry(c.coverageCost, ClusterTuple::INVALID_TUPLE));
+        }
+    };
+    
+    std::vector<Row> rows;
+    for (uint32_t batchStart = 0; batchStart < candidates.size(); batchStart += BEAM_BATCH_SIZE) {
+        // stop if no remaining candidate can be better than the worst row in the beam
+        if (rows.size() >= beam) {
+            std::nth_element(rows.begin(), rows.begin() + (beam-1), rows.end(), rowOrder);
+            rows.resize(beam);
+            Score worst = std::max_element(rows.begin(), rows.end(), rowOrder)->second.score;
+            if (candidates[batchStart].bound >= worst)
+                break;
+        }
+        
+        // score batch, on multiple threads if there is enough work
+        uint32_t batchEnd = std::min((uint32_t)candidates.size(), batchStart + BEAM_BATCH_SIZE);
+        std::vector<Row> batch(batchEnd - batchStart);
+        uint64_t work = (uint64_t)(batchEnd - batchStart) * std::max((uint64_t)1, (uint64_t)preds.size());
+        uint32_t batchThreads = (uint32_t)std::min((uint64_t)numThreads, std::max((uint64_t)1, work / MIN_TRANSITIONS_PER_THREAD));
+        if (batchThreads <= 1) {
+            for (uint32_t i = batchStart; i < batchEnd; i++)
+                batch[i - batchStart] = scoreCandidate(candidates[i]);
+        } else {
+            std::atomic<uint32_t> next(batchStart);
+            std::vector<std::exception_ptr> errors(batchThreads);
+            std::vector<std::thread> workers;
+            for (uint32_t t = 0; t < batchThreads; t++) {
+                workers.emplace_back([&, t] () {
+                    try {
+                        for (uint32_t i = next++; i < batchEnd; i = next++)
+                            batch[i - batchStart] = scoreCandidate(candidates[i]);
+                    } catch (...) {
+                        errors[t] = std::current_exception();
+                    }
+                });
+            }
+            for (std::thread& worker : workers)
+                worker.join();
+            for (std::exception_ptr& error : errors)
+                if (error)
+                    std::rethrow_exception(error);
+        }
+        rows.insert(rows.end(), batch.begin(), batch.end());
+    }
+    
+    std::sort(rows.begin(), rows.end(), rowOrder);
+    if (rows.size() > beam)
+        rows.resize(beam);
+    return rows;
+}
+
+std::vector<GlobalClusterId> HaploThreader::getBestPermutationGlobal(const std::vector<GlobalClusterId>& predGlobal,
+                                                                    const std::vector<GlobalClusterId>& prevTuple,
+                                                                    const std::vector<GlobalClusterId>& rowTupleGlobal) const {
+    std::vector<uint32_t> residualPosPrev; // positions in previous tuple, which could not be matched to position in current tuple
+    std::vector<uint32_t> residualPosCur; // positions in current tuple, which could not be matched to position in previous tuple
+    getSwitchCostAllPerms(prevTuple, rowTupleGlobal, residualPosPrev, residualPosCur);
+    
+    if (residualPosPrev.size() != residualPosCur.size()) {
+        std::cout<<"Residual sizes unequal"<<std::endl;
+        for (auto i = prevTuple.begin(); i != prevTuple.end(); ++i)
+            std::cout << *i << ' ';
+        std::cout<<std::endl;
+        for (auto i = rowTupleGlobal.begin(); i != rowTupleGlobal.end(); ++i)
+            std::cout << *i << ' ';
+        std::cout<<std::endl;
+    }
+    
+    std::vector<GlobalClusterId> bestPermGlobal(predGlobal);
+    for (uint32_t i = 0; i < residualPosCur.size(); i++) {
+        GlobalClusterId residueCur = rowTupleGlobal[residualPosCur[i]];
+        GlobalClusterId residuePrev = prevTuple[residualPosPrev[i]];
+        for (uint32_t j = 0; j < ploidy; j++) {
+            if (bestPermGlobal[j] == residuePrev) {
+                bestPermGlobal[j] = residueCur;
+                break;
+            }
+        }
+    }
+    return bestPermGlobal;
+}
+
+ClusterTuple HaploThreader::getBestPermutation(const ClusterTuple pred, const std::vector<GlobalClusterId>& prevTuple,
+                                              const std::vector<GlobalClusterId>& rowTupleGlobal,
+                                              const std::vector<GlobalClusterId>& prevClusters,
+                                              const std::vector<GlobalClusterId>& curClusters) const {
+    ClusterTuple bestPerm;
+    std::vector<GlobalClusterId> bestPermGlobal = getBestPermutationGlobal(pred.asVector(ploidy, prevClusters), prevTuple, rowTupleGlobal);
+    std::unordered_map<GlobalClusterId, LocalClusterId> globalToLocal;
+    for (uint32_t i = 0; i < curClusters.size(); i++)
+        globalToLocal[curClusters[i]] = i;
+    for (uint32_t i = 0; i < ploidy; i++)
+        bestPerm.set(globalToLocal[bestPermGlobal[i]], i);
+    return bestPerm;
+}
+
+std::vector<uint32_t> HaploThreader::getStitchPermutation(const std::vector<GlobalClusterId>& prevTuple,
+                                                          const std::vector<GlobalClusterId>& curTuple) const {
+    std::vector<GlobalClusterId> prevSorted(prevTuple);
+    std::vector<GlobalClusterId> curSorted(curTuple);
+    std::sort(prevSorted.begin(), prevSorted.end());
+    std::sort(curSorted.begin(), curSorted.end());
+    std::vector<GlobalClusterId> target = getBestPermutationGlobal(prevTuple, prevSorted, curSorted);
+    
+    // assign positions of curTuple to the target positions, keeping the order of equal clusters
+    std::vector<uint32_t> perm(ploidy, 0);
+    std::vector<bool> used(ploidy, false);
+    for (uint32_t j = 0; j < ploidy; j++) {
+        for (uint32_t k = 0; k < ploidy; k++) {
+            if (!used[k] && curTuple[k] == target[j]) {
+                perm[j] = k;
+                used[k] = true;
+                break;
+            }
+        }
+    }
+    return perm;
+}
+
 Score HaploThreader::getCoverageCost(ClusterTuple tuple, const std::vector<double>& coverage) const {
     // tuple contains local cluster ids, which have to be translated with covMap to get the global ids
     Score cost = 0.0;
@@ -16,6 +16,8 @@ typedef uint32_t Position;
 typedef double Score;
 typedef uint64_t TupleCode;
 
+class ThreadingPreprocessor;
+
 /**
  * Struct to represent cluster tuples. Each tuple is encoded by a 64bit unsigned integer. The first cluster is encoded by the lowest 5 bits, the second
  * cluster by the next highest 5 bits, etc. There is space for 12 clusters, each ranging from id 0 to 31. Each cluster is encoded as a local cluster id. 
@@ -225,12 +227,22 @@ public:
      * @param ploidy The number of paths, which have to be threaded through the clusters
      * @param switchCost The factor how much a single cluster switches is penalized over a wrong copy number of a cluster (compared to its coverage)
      * @param affineSwitchCost Penalty for a position, in which a cluster switch occurs
+     * @param beamWidth If greater than zero, only this many tuples (partial paths) are kept per position. Candidate tuples are
+     *                  scored in order of a lower bound on their cost, and scoring stops as soon as no remaining candidate
+     *                  can enter the beam. Zero computes all genotype conform tuples for every position.
+     * @param maxMemory If greater than zero, the number of tuples kept per position is limited such that the DP table does
+     *                  not exceed this many bytes (enables the beam mode if beamWidth is zero)
+     * @param threads Number of threads used for independent phasing runs and for scoring the transitions into the candidate tuples
+     *                of a position (beam mode only)
      */
-    HaploThreader (uint32_t ploidy, double switchCost, double affineSwitchCost, bool symmetryOptimization, uint32_t rowLimit);
+    HaploThreader (uint32_t ploidy, double switchCost, double affineSwitchCost, bool symmetryOptimization, uint32_t rowLimit,
+                   uint32_t beamWidth = 0, uint64_t maxMemory = 0, uint32_t threads = 1);
     
     /**
      * Computes a number of paths (depending on the provided ploidy), which run through the provided clusters. For each variant the result
-     * contains a tuple of cluster ids, which represent the paths.
+     * contains a tuple of cluster ids, which represent the paths. The phasing runs between consecutive block starts are independent
+     * and are computed concurrently if more than one thread is available. Each run is permuted, such that its paths continue the paths
+     * of the previous run with as few switches as possible.
      * 
      * @param blockStarts A list of positions, from which the phasing runs have to start
      * @param covMap A vector, which for every position contains the global cluster ids of the present clusters
@@ -246,6 +258,17 @@ public:
                     const std::vector<std::unordered_map<uint32_t, uint32_t>>& genotypes
                    ) const;
                   
+    /**
+     * Computes the paths for all independent phasing runs, using the coverage map, coverage and consensus computed by the given
+     * preprocessor.
+     *
+     * @param preprocessor Auxiliary data of the read set and clustering to phase
+     * @param genotypes The genotype for every positon
+     */
+    std::vector<std::vector<GlobalClusterId>> computePaths (const ThreadingPreprocessor& preprocessor,
+                    const std::vector<std::unordered_map<uint32_t, uint32_t>>& genotypes
+                   ) const;
+                  
     /**
      * Computes a number of paths (depending on the provided ploidy), which run through the provided clusters. For each variant the result
      * contains a tuple of cluster ids, which represent the paths.
@@ -266,11 +289,81 @@ public:
                    ) const;
 
 private:
+    // number of candidate tuples, which are scored before checking whether the remaining ones can still enter the beam
+    static const uint32_t BEAM_BATCH_SIZE = 256;
+    // minimum number of (candidate, predecessor) pairs to score per thread
+    static const uint64_t MIN_TRANSITIONS_PER_THREAD = 16384;
+    // estimated memory used by one row of the DP table (entry plus hash table overhead)
+    static const uint64_t BYTES_PER_ROW = sizeof(std::pair<ClusterTuple, ClusterEntry>) + 2 * sizeof(void*);
+    
     uint32_t ploidy;
     double switchCost;
     double affineSwitchCost;
     bool symmetryOptimization;
     uint32_t rowLimit;
+    uint32_t beamWidth;
+    uint64_t maxMemory;
+    uint32_t threads;
+    
+    /**
+     * Returns the number of tuples to keep per position for a phasing run over the given number of positions, whose DP table
+     * may use the given amount of memory (if maxMemory is set). Zero means that the beam mode is not used.
+     */
+    uint32_t getBeamWidth(Position numPositions, uint64_t memory) const;
+    
+    /**
+     * Computes the paths for a single phasing run from start (inclusive) to end (exclusive), using at most numThreads threads
+     * and (if maxMemory is set) the given amount of memory for the DP table.
+     */
+    std::vector<std::vector<GlobalClusterId>> computeSegment (Position start, Position end,
+                    const std::vector<std::vector<GlobalClusterId>>& covMap,
+                    const std::vector<std::vector<double>>& coverage, 
+                    const std::vector<std::vector<uint32_t>>& consensus,
+                    const std::vector<std::unordered_map<uint32_t, uint32_t>>& genotypes,
+                    Position displayedEnd,
+                    uint32_t numThreads,
+                    uint64_t memory
+                   ) const;
+    
+    /**
+     * Computes the DP column for position pos in beam mode. Returns at most beam rows, sorted by score. The previous column
+     * and the sorted global cluster ids of its tuples must be provided.
+     */
+    std::vector<std::pair<ClusterTuple, ClusterEntry>> computeBeamColumn(Position pos, uint32_t beam,
+                    const std::unordered_map<ClusterTuple, ClusterEntry>& prevColumn,
+                    const std::unordered_map<ClusterTuple, std::vector<GlobalClusterId>>& sortedGlobalTuples,
+                    const std::vector<std::vector<GlobalClusterId>>& covMap,
+                    const std::vector<std::vector<double>>& coverage,
+                    const std::vector<std::vector<uint32_t>>& consensus,
+                    const std::vector<std::unordered_map<uint32_t, uint32_t>>& genotypes,
+                    uint32_t numThreads
+                   ) const;
+    
+    /**
+     * Replaces the clusters of a predecessor tuple (global ids, in haplotype order), which do not occur in the current tuple, by
+     * the clusters of the current tuple, which do not occur in the predecessor. The sorted global cluster ids of both tuples must
+     * be provided. The result is the permutation of the current tuple with the lowest switch cost to the predecessor.
+     */
+    std::vector<GlobalClusterId> getBestPermutationGlobal(const std::vector<GlobalClusterId>& predGlobal,
+                                                          const std::vector<GlobalClusterId>& prevTuple,
+                                                          const std::vector<GlobalClusterId>& rowTupleGlobal) const;
+    
+    /**
+     * Returns the permutation of a tuple (with local cluster ids of the current position), which has the lowest switch cost
+     * to the given predecessor tuple (with local cluster ids of the previous position). The sorted global cluster ids of both
+     * tuples and the global ids of the clusters at both positions must be provided.
+     */
+    ClusterTuple getBestPermutation(const ClusterTuple pred, const std::vector<GlobalClusterId>& prevTuple,
+                                    const std::vector<GlobalClusterId>& rowTupleGlobal,
+                                    const std::vector<GlobalClusterId>& prevClusters,
+                                    const std::vector<GlobalClusterId>& curClusters) const;
+    
+    /**
+     * Returns a permutation perm of curTuple (both tuples with global ids), such that the tuple with curTuple[perm[i]] at index i
+     * continues prevTuple with the lowest switch cost. Used to stitch together the paths of consecutive phasing runs.
+     */
+    std::vector<uint32_t> getStitchPermutation(const std::vector<GlobalClusterId>& prevTuple,
+                                               const std::vector<GlobalClusterId>& curTuple) const;
     
     /**
      * Computes the coverage cost of a tuple, considering the following coverage distribution. All cluster
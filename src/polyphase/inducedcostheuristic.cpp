@@ -9,7 +9,7 @@ using EdgeId = StaticSparseGraph::EdgeId;
 using NodeId = StaticSparseGraph::NodeId;
 using RankId = StaticSparseGraph::RankId;
 
-InducedCostHeuristic::InducedCostHeuristic(StaticSparseGraph& param_graph, bool param_bundleEdges) :
+InducedCostHeuristic::InducedCostHeuristic(StaticSparseGraph& param_graph, bool param_bundleEdges, uint32_t threads) :
     bundleEdges(param_bundleEdges),
     graph(param_graph),
     edgeHeap(graph),
@@ -22,7 +22,7 @@ InducedCostHeuristic::InducedCostHeuristic(StaticSparseGraph& param_graph, bool
     if (!resolvePermanentForbidden()) {
         totalCost = std::numeric_limits<EdgeWeight>::infinity();
     }
-    edgeHeap.initInducedCosts();
+    edgeHeap.initInducedCosts(threads);
     totalEdges = edgeHeap.numUnprocessed();
 }
 
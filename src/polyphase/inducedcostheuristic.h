@@ -27,9 +27,11 @@ public:
      *      this option is enabled, these groups of edges are treated as bundles,
      *      with shared and combined induced costs. If disabled, each edge is treated
      *      individually.
+     * @param threads Number of threads used to initialize the induced costs. The
+     *      solution does not depend on it.
      * 
      */
-    InducedCostHeuristic(StaticSparseGraph& param_graph, bool param_bundleEdges);
+    InducedCostHeuristic(StaticSparseGraph& param_graph, bool param_bundleEdges, uint32_t threads = 1);
     
     /**
      * Starts the solving process.
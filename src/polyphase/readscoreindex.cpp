@@ -0,0 +1,463 @@
+#include "readscoreindex.h"
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// read pairs are only counted on several threads if each thread gets at least this many reads
+static const uint32_t MIN_READS_PER_THREAD = 64;
+// number of consecutive reads whose pairs are counted by a thread at a time
+static const uint32_t READS_PER_TILE = 16;
+
+namespace {
+    const char SERIALIZATION_MAGIC[4] = {'W', 'H', 'S', 'I'};
+    const uint32_t SERIALIZATION_VERSION = 1;
+
+    template <typename T>
+    void writeValues(std::string* out, const T* values, size_t count) {
+        out->append(reinterpret_cast<const char*>(values), count * sizeof(T));
+    }
+
+    template <typename T>
+    void writeValue(std::string* out, T value) {
+        writeValues(out, &value, 1);
+    }
+
+    /** Reads values from a buffer, checking that it is not exceeded. */
+    class BufferReader {
+    public:
+        BufferReader(const char* data, size_t size) : data(data), size(size), offset(0) {}
+
+        template <typename T>
+        void readValues(T* values, size_t count) {
+            if (count > (size - offset) / sizeof(T))
+                throw std::runtime_error("ReadScoreIndex::deserialize: unexpected end of data.");
+            memcpy(values, data + offset, count * sizeof(T));
+            offset += count * sizeof(T);
+        }
+
+        /** Resizes values to count values and reads them, checking the size before allocating memory. */
+        template <typename T>
+        void readVector(std::vector<T>* values, uint64_t count) {
+            if (count > (size - offset) / sizeof(T))
+                throw std::runtime_error("ReadScoreIndex::deserialize: unexpected end of data.");
+            values->resize(count);
+            readValues(values->data(), count);
+        }
+
+        template <typename T>
+        T readValue() {
+            T value;
+            readValues(&value, 1);
+            return value;
+        }
+
+        size_t remaining() const {
+            return size - offset;
+        }
+
+        bool atEnd() const {
+            return offset == size;
+        }
+
+    private:
+        const char* data;
+        size_t size;
+        size_t offset;
+    };
+}
+
+ReadScoreIndex::ReadScoreIndex() : minOverlap(0), planes(1) {}
+
+ReadScoreIndex::ReadScoreIndex(const ReadSet* readset, const uint32_t minOverlap, const uint32_t threads) :
+    minOverlap(minOverlap),
+    planes(1)
+{
+    // map the variants of each read to the rank of their position among all variant positions
+    uint32_t numReads = readset->size();
+    for (uint32_t i = 0; i < numReads; i++) {
+        const Read* read = readset->get(i);
+        if (read->getVariantCount() == 0)
+            throw std::runtime_error("ReadScoreIndex: read without variants");
+        for (int k = 0; k < read->getVariantCount(); k++)
+            positions.push_back(read->getPosition(k));
+    }
+    std::sort(positions.begin(), positions.end());
+    positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+    std::unordered_map<uint32_t, uint32_t> posMap;
+    for (uint32_t r = 0; r < positions.size(); r++)
+        posMap[positions[r]] = r;
+    std::vector<std::vector<std::pair<uint32_t, uint8_t>>> variants(numReads);
+    for (uint32_t i = 0; i < numReads; i++) {
+        const Read* read = readset->get(i);
+        for (int k = 0; k < read->getVariantCount(); k++)
+            variants[i].emplace_back(posMap[read->getPosition(k)], (uint8_t)read->getAllele(k));
+    }
+    computeBitsets(variants);
+    variants.clear();
+    computeBeginsEnds();
+
+    // iterate over all read pairs (efficiently omitting those who can certainly not overlap)
+    std::vector<uint32_t> pairCounts(numReads, 0);
+    auto countPairs = [&](uint32_t from, uint32_t to, std::vector<Pair>& result) {
+        for (uint32_t i = from; i < to; i++) {
+            // iterate until start position of read is behind end of read i
+            for (uint32_t j = i + 1; j < numReads && begins[j] <= ends[i]; j++) {
+                if (ends[i] < begins[j] || ends[j] < begins[i])
+                    continue;
+                uint32_t ov = 0;
+                uint32_t di = 0;
+                countOverlapDiff(i, j, ov, di);
+                if (ov >= minOverlap) {
+                    result.push_back(Pair{j, ov, di});
+                    pairCounts[i]++;
+                }
+            }
+        }
+    };
+
+    // tiles of consecutive reads are handed out one at a time, since the number of overlapping reads varies. Each
+    // tile collects its pairs separately, and the tiles are concatenated afterwards.
+    uint32_t numThreads = std::max(1u, std::min(threads, numReads / MIN_READS_PER_THREAD));
+    uint32_t numTiles = numThreads == 1 ? 1 : (numReads + READS_PER_TILE - 1) / READS_PER_TILE;
+    uint32_t readsPerTile = numThreads == 1 ? numReads : READS_PER_TILE;
+    std::vector<std::vector<Pair>> tilePairs(numTiles);
+    if (numThreads == 1) {
+        countPairs(0, numReads, tilePairs[0]);
+    } else {
+        std::atomic<uint32_t> nextTile(0);
+        std::vector<std::thread> workers;
+        std::vector<std::exception_ptr> errors(numThreads);
+        for (uint32_t t = 0; t < numThreads; t++) {
+            workers.emplace_back([&, t]() {
+                try {
+                    for (uint32_t tile = nextTile++; tile < numTiles; tile = nextTile++) {
+                        uint32_t from = tile * readsPerTile;
+                        countPairs(from, std::min(from + readsPerTile, numReads), tilePairs[tile]);
+                    }
+                } catch (...) {
+                    errors[t] = std::current_exception();
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        for (std::exception_ptr& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    pairOffsets.assign(numReads + 1, 0);
+    for (uint32_t i = 0; i < numReads; i++)
+        pairOffsets[i + 1] = pairOffsets[i] + pairCounts[i];
+    pairs.reserve(pairOffsets[numReads]);
+    for (std::vector<Pair>& tile : tilePairs) {
+        pairs.insert(pairs.end(), tile.begin(), tile.end());
+        std::vector<Pair>().swap(tile);
+    }
+}
+
+ReadScoreIndex* ReadScoreIndex::restrictToVariants(const uint32_t firstVariant, const uint32_t endVariant) const {
+    if (firstVariant > endVariant || endVariant > positions.size())
+        throw std::invalid_argument("ReadScoreIndex::restrictToVariants: invalid range of variants");
+    std::unique_ptr<ReadScoreIndex> result(new ReadScoreIndex());
+    result->minOverlap = minOverlap;
+    result->positions.assign(positions.begin() + firstVariant, positions.begin() + endVariant);
+
+    // collect the variants of each read inside of the range
+    uint32_t numReads = getNumReads();
+    const uint32_t NONE = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> newIndex(numReads, NONE);
+    std::vector<bool> inside(numReads, false);
+    std::vector<std::vector<std::pair<uint32_t, uint8_t>>> variants;
+    for (uint32_t i = 0; i < numReads; i++) {
+        uint32_t first = firstRank(i);
+        uint32_t last = lastRank(i);
+        if (last < firstVariant || first >= endVariant)
+            continue;
+        std::vector<std::pair<uint32_t, uint8_t>> readVariants;
+        const uint64_t* covered = &words[offset[i]];
+        for (uint32_t r = std::max(first, firstVariant); r <= std::min(last, endVariant - 1); r++) {
+            uint32_t word = r / 64 - firstWord[i];
+            uint64_t bit = 1UL << (r % 64);
+            if ((covered[word] & bit) == 0)
+                continue;
+            uint8_t allele = 0;
+            for (uint32_t p = 0; p < planes; p++) {
+                if (covered[(p + 1) * numWords[i] + word] & bit)
+                    allele |= 1 << p;
+            }
+            readVariants.emplace_back(r - firstVariant, allele);
+        }
+        if (readVariants.empty())
+            continue;
+        newIndex[i] = variants.size();
+        inside[i] = first >= firstVariant && last < endVariant;
+        variants.push_back(readVariants);
+    }
+    result->planes = planes;
+    result->computeBitsets(variants);
+    result->computeBeginsEnds();
+
+    // the pairs are enumerated as in the constructor, which stops at the first read that begins behind the end of read
+    // i. Unlike in the read set, this order is not sorted by the begins, since reads are cut at the range.
+    uint32_t numNewReads = variants.size();
+    const std::vector<uint32_t>& newBegins = result->begins;
+    const std::vector<uint32_t>& newEnds = result->ends;
+    std::vector<uint32_t> stop(numNewReads);
+    for (uint32_t i = 0; i < numNewReads; i++) {
+        uint32_t j = i + 1;
+        while (j < numNewReads && newBegins[j] <= newEnds[i])
+            j++;
+        stop[i] = j;
+    }
+
+    // pairs of reads inside of the range keep their counts, the others are counted again
+    result->pairOffsets.assign(numNewReads + 1, 0);
+    for (uint32_t i = 0; i < numReads; i++) {
+        uint32_t ni = newIndex[i];
+        if (ni == NONE)
+            continue;
+        for (const Pair* pair = pairsBegin(i); pair != pairsEnd(i); pair++) {
+            uint32_t nj = newIndex[pair->partner];
+            if (nj == NONE || nj >= stop[ni] || newEnds[nj] < newBegins[ni])
+                continue;
+            if (inside[i] && inside[pair->partner]) {
+                result->pairs.push_back(Pair{nj, pair->overlap, pair->diff});
+            } else {
+                uint32_t ov = 0;
+                uint32_t di = 0;
+                result->countOverlapDiff(ni, nj, ov, di);
+                if (ov < minOverlap)
+                    continue;
+                result->pairs.push_back(Pair{nj, ov, di});
+            }
+        }
+        result->pairOffsets[ni + 1] = result->pairs.size();
+    }
+    return result.release();
+}
+
+void ReadScoreIndex::computeBitsets(const std::vector<std::vector<std::pair<uint32_t, uint8_t>>>& variants) {
+    // number of bits needed to distinguish all allele ids
+    uint8_t maxAllele = 0;
+    for (const std::vector<std::pair<uint32_t, uint8_t>>& readVariants : variants) {
+        for (const std::pair<uint32_t, uint8_t>& variant : readVariants) {
+            maxAllele = std::max(maxAllele, variant.second);
+        }
+    }
+    while (planes < 8 && (maxAllele >> planes) != 0) {
+        planes++;
+    }
+
+    uint32_t numReads = variants.size();
+    firstWord.assign(numReads, 0);
+    numWords.assign(numReads, 0);
+    offset.assign(numReads, 0);
+    words.clear();
+    for (uint32_t i = 0; i < numReads; i++) {
+        offset[i] = words.size();
+        uint32_t first = std::numeric_limits<uint32_t>::max();
+        uint32_t last = 0;
+        for (const std::pair<uint32_t, uint8_t>& variant : variants[i]) {
+            first = std::min(first, variant.first);
+            last = std::max(last, variant.first);
+        }
+        uint32_t n = last / 64 - first / 64 + 1;
+        firstWord[i] = first / 64;
+        numWords[i] = n;
+        words.resize(words.size() + (uint64_t)(planes + 1) * n, 0UL);
+        uint64_t* covered = &words[offset[i]];
+        for (const std::pair<uint32_t, uint8_t>& variant : variants[i]) {
+            uint32_t word = variant.first / 64 - firstWord[i];
+            uint64_t bit = 1UL << (variant.first % 64);
+            covered[word] |= bit;
+            for (uint32_t p = 0; p < planes; p++) {
+                if ((variant.second >> p) & 1)
+                    covered[(p + 1) * n + word] |= bit;
+            }
+        }
+    }
+}
+
+void ReadScoreIndex::computeBeginsEnds() {
+    uint32_t numReads = firstWord.size();
+    begins.resize(numReads);
+    ends.resize(numReads);
+    for (uint32_t i = 0; i < numReads; i++) {
+        begins[i] = positions[firstRank(i)];
+        ends[i] = positions[lastRank(i)];
+    }
+}
+
+uint32_t ReadScoreIndex::firstRank(const uint32_t i) const {
+    // the first and the last word of a bitset are never empty
+    return firstWord[i] * 64 + __builtin_ctzll(words[offset[i]]);
+}
+
+uint32_t ReadScoreIndex::lastRank(const uint32_t i) const {
+    uint32_t last = numWords[i] - 1;
+    return (firstWord[i] + last) * 64 + 63 - __builtin_clzll(words[offset[i] + last]);
+}
+
+void ReadScoreIndex::countOverlapDiff(const uint32_t i, const uint32_t j, uint32_t& ov, uint32_t& di) const {
+    ov = 0;
+    di = 0;
+    uint32_t firstI = firstWord[i];
+    uint32_t firstJ = firstWord[j];
+    uint32_t numI = numWords[i];
+    uint32_t numJ = numWords[j];
+    uint32_t from = std::max(firstI, firstJ);
+    uint32_t to = std::min(firstI + numI, firstJ + numJ);
+    const uint64_t* wordsI = &words[offset[i]];
+    const uint64_t* wordsJ = &words[offset[j]];
+    for (uint32_t w = from; w < to; w++) {
+        uint32_t wi = w - firstI;
+        uint32_t wj = w - firstJ;
+        uint64_t both = wordsI[wi] & wordsJ[wj];
+        if (both == 0)
+            continue;
+        uint64_t differ = 0;
+        for (uint32_t p = 1; p <= planes; p++) {
+            differ |= wordsI[p * numI + wi] ^ wordsJ[p * numJ + wj];
+        }
+        ov += __builtin_popcountll(both);
+        di += __builtin_popcountll(both & differ);
+    }
+}
+
+std::string ReadScoreIndex::serialize() const {
+    uint64_t numReads = getNumReads();
+    std::string out;
+    out.reserve(sizeof(SERIALIZATION_MAGIC) + 4 * sizeof(uint32_t) + 3 * sizeof(uint64_t) + positions.size() * sizeof(uint32_t)
+                + numReads * 3 * sizeof(uint32_t) + words.size() * sizeof(uint64_t) + pairs.size() * sizeof(Pair));
+    out.append(SERIALIZATION_MAGIC, sizeof(SERIALIZATION_MAGIC));
+    writeValue<uint32_t>(&out, SERIALIZATION_VERSION);
+    writeValue<uint32_t>(&out, minOverlap);
+    writeValue<uint32_t>(&out, planes);
+    writeValue<uint32_t>(&out, positions.size());
+    writeValues(&out, positions.data(), positions.size());
+    writeValue<uint64_t>(&out, numReads);
+    writeValues(&out, firstWord.data(), numReads);
+    writeValues(&out, numWords.data(), numReads);
+    writeValue<uint64_t>(&out, words.size());
+    writeValues(&out, words.data(), words.size());
+    for (uint64_t i = 0; i < numReads; i++)
+        writeValue<uint32_t>(&out, pairOffsets[i + 1] - pairOffsets[i]);
+    writeValue<uint64_t>(&out, pairs.size());
+    for (const Pair& pair : pairs) {
+        writeValue<uint32_t>(&out, pair.partner);
+        writeValue<uint32_t>(&out, pair.overlap);
+        writeValue<uint32_t>(&out, pair.diff);
+    }
+    return out;
+}
+
+ReadScoreIndex* ReadScoreIndex::deserialize(const std::string& data) {
+    return deserialize(data.data(), data.size());
+}
+
+ReadScoreIndex* ReadScoreIndex::load(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw std::runtime_error("Could not open ReadScoreIndex file " + path);
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) == -1) {
+        close(fd);
+        throw std::runtime_error("Could not read ReadScoreIndex file " + path);
+    }
+    size_t size = fileStat.st_size;
+    if (size == 0) {
+        close(fd);
+        throw std::runtime_error("ReadScoreIndex::deserialize: not a serialized ReadScoreIndex.");
+    }
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Could not memory-map ReadScoreIndex file " + path);
+    }
+    std::unique_ptr<void, std::function<void(void*)>> unmap(mapping, [size](void* p) { munmap(p, size); });
+    return deserialize((const char*)mapping, size);
+}
+
+ReadScoreIndex* ReadScoreIndex::deserialize(const char* data, size_t size) {
+    if ((size < sizeof(SERIALIZATION_MAGIC)) || (memcmp(data, SERIALIZATION_MAGIC, sizeof(SERIALIZATION_MAGIC)) != 0)) {
+        throw std::runtime_error("ReadScoreIndex::deserialize: not a serialized ReadScoreIndex.");
+    }
+    BufferReader in(data + sizeof(SERIALIZATION_MAGIC), size - sizeof(SERIALIZATION_MAGIC));
+    if (in.readValue<uint32_t>() != SERIALIZATION_VERSION) {
+        throw std::runtime_error("ReadScoreIndex::deserialize: unsupported version.");
+    }
+    std::unique_ptr<ReadScoreIndex> result(new ReadScoreIndex());
+    result->minOverlap = in.readValue<uint32_t>();
+    result->planes = in.readValue<uint32_t>();
+    in.readVector(&result->positions, in.readValue<uint32_t>());
+    uint64_t numReads = in.readValue<uint64_t>();
+    if (result->planes < 1 || result->planes > 8 || numReads >= std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("ReadScoreIndex::deserialize: malformed data.");
+    }
+    in.readVector(&result->firstWord, numReads);
+    in.readVector(&result->numWords, numReads);
+    result->offset.resize(numReads);
+    uint64_t numPositionWords = (result->positions.size() + 63) / 64;
+    uint64_t expectedWords = 0;
+    for (uint64_t i = 0; i < numReads; i++) {
+        uint64_t first = result->firstWord[i];
+        uint64_t n = result->numWords[i];
+        if (n == 0 || first + n > numPositionWords) {
+            throw std::runtime_error("ReadScoreIndex::deserialize: malformed data.");
+        }
+        result->offset[i] = expectedWords;
+        expectedWords += (result->planes + 1) * n;
+    }
+    if (in.readValue<uint64_t>() != expectedWords) {
+        throw std::runtime_error("ReadScoreIndex::deserialize: malformed data.");
+    }
+    in.readVector(&result->words, expectedWords);
+    for (uint64_t i = 0; i < numReads; i++) {
+        uint64_t n = result->numWords[i];
+        if (result->words[result->offset[i]] == 0 || result->words[result->offset[i] + n - 1] == 0
+            || result->lastRank(i) >= result->positions.size()) {
+            throw std::runtime_error("ReadScoreIndex::deserialize: malformed data.");
+        }
+    }
+    result->pairOffsets.assign(numReads + 1, 0);
+    for (uint64_t i = 0; i < numReads; i++) {
+        result->pairOffsets[i + 1] = result->pairOffsets[i] + in.readValue<uint32_t>();
+    }
+    uint64_t numPairs = in.readValue<uint64_t>();
+    if (numPairs != result->pairOffsets[numReads] || numPairs > in.remaining() / (3 * sizeof(uint32_t))) {
+        throw std::runtime_error("ReadScoreIndex::deserialize: malformed data.");
+    }
+    result->pairs.resize(numPairs);
+    for (uint64_t i = 0; i < numReads; i++) {
+        for (uint64_t k = result->pairOffsets[i]; k < result->pairOffsets[i + 1]; k++) {
+            Pair& pair = result->pairs[k];
+            pair.partner = in.readValue<uint32_t>();
+            pair.overlap = in.readValue<uint32_t>();
+            pair.diff = in.readValue<uint32_t>();
+            if (pair.partner <= i || pair.partner >= numReads) {
+                throw std::runtime_error("ReadScoreIndex::deserialize: malformed data.");
+            }
+        }
+    }
+    if (!in.atEnd()) {
+        throw std::runtime_error("ReadScoreIndex::deserialize: trailing data.");
+    }
+    result->computeBeginsEnds();
+    return result.release();
+}
@@ -0,0 +1,140 @@
+#ifndef READSCOREINDEX_H
+#define READSCOREINDEX_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../readset.h"
+
+/**
+ * Overlaps and differences of all pairs of reads of a read set, from which ReadScoring computes the similarity scores.
+ *
+ * Counting them is the expensive part of scoring, while the scores also depend on the ploidy and, in polyphase, on the
+ * blocks into which the variants are divided. An index is therefore computed once for all reads of a chromosome: it can
+ * be restricted to the variants of each block without scanning the reads again, and it can be stored with serialize()
+ * and memory-mapped by later runs with load(). Only pairs that share at least minOverlap variants are stored.
+ *
+ * The reads are kept as bitsets over the ranks of their variant positions among all positions of the read set. For
+ * each read, one bitset marks the covered positions, followed by one bitset per bit of the allele ids ("planes"). Each
+ * bitset spans the words from the read's first to its last covered position. Reads must be sorted by their first
+ * position and must have at least one variant.
+ */
+class ReadScoreIndex {
+public:
+    /** Pair of a read with a read that has a larger index. */
+    struct Pair {
+        uint32_t partner;
+        // number of variants covered by both reads (overlap) and those among them with different alleles (diff)
+        uint32_t overlap;
+        uint32_t diff;
+    };
+
+    /**
+     * Counts the overlaps and differences of all read pairs on the given number of threads; the result does not
+     * depend on it.
+     */
+    ReadScoreIndex(const ReadSet* readset, const uint32_t minOverlap, const uint32_t threads = 1);
+
+    /**
+     * Returns the index of the read set that only contains the variants with ranks firstVariant, ..., endVariant-1,
+     * as split_readset in whatshap/cli/polyphase.py creates it for a block: it consists of the reads with at least one
+     * of these variants, in the same order. Only the pairs with a read that has variants outside of the block are
+     * counted again. Caller owns the returned pointer.
+     */
+    ReadScoreIndex* restrictToVariants(const uint32_t firstVariant, const uint32_t endVariant) const;
+
+    uint32_t getMinOverlap() const { return minOverlap; }
+    uint32_t getNumReads() const { return begins.size(); }
+    uint64_t getNumPairs() const { return pairs.size(); }
+
+    /** Sorted positions of all variants of the reads. */
+    const std::vector<uint32_t>& getPositions() const { return positions; }
+
+    /** Positions of the first and the last variant of every read. */
+    const std::vector<uint32_t>& getBegins() const { return begins; }
+    const std::vector<uint32_t>& getEnds() const { return ends; }
+
+    /** The pairs of read i with the reads j > i, sorted by j. */
+    const Pair* pairsBegin(const uint32_t i) const { return pairs.data() + pairOffsets[i]; }
+    const Pair* pairsEnd(const uint32_t i) const { return pairs.data() + pairOffsets[i + 1]; }
+
+    /**
+     * Calls f(rank) for the rank of every variant covered by both reads, in increasing order.
+     */
+    template <typename F>
+    void forSharedVariants(const uint32_t i, const uint32_t j, F f) const;
+
+    /**
+     * Returns a compact binary representation of the index. Integers are stored in native byte order.
+     */
+    std::string serialize() const;
+
+    /**
+     * Creates an index from the output of serialize(). Caller owns the returned pointer. Throws std::runtime_error if
+     * the data is malformed.
+     */
+    static ReadScoreIndex* deserialize(const std::string& data);
+
+    /**
+     * Creates an index from a file containing the output of serialize(), which is memory-mapped while reading. Caller
+     * owns the returned pointer. Throws std::runtime_error if the file cannot be read or is malformed.
+     */
+    static ReadScoreIndex* load(const std::string& path);
+
+private:
+    ReadScoreIndex();
+
+    static ReadScoreIndex* deserialize(const char* data, size_t size);
+
+    /**
+     * Computes the bitsets from the ranks and alleles of the variants of every read.
+     */
+    void computeBitsets(const std::vector<std::vector<std::pair<uint32_t, uint8_t>>>& variants);
+
+    /**
+     * Computes the begins and ends from the bitsets.
+     */
+    void computeBeginsEnds();
+
+    uint32_t firstRank(const uint32_t i) const;
+    uint32_t lastRank(const uint32_t i) const;
+
+    /**
+     * Counts the variants covered by both reads (overlap) and those among them with different alleles (diff).
+     */
+    void countOverlapDiff(const uint32_t i, const uint32_t j, uint32_t& ov, uint32_t& di) const;
+
+    uint32_t minOverlap;
+    // position of every variant rank
+    std::vector<uint32_t> positions;
+    std::vector<uint32_t> begins;
+    std::vector<uint32_t> ends;
+
+    uint32_t planes;
+    std::vector<uint32_t> firstWord;
+    std::vector<uint32_t> numWords;
+    std::vector<uint64_t> offset;
+    std::vector<uint64_t> words;
+
+    // pairs of read i are pairs[pairOffsets[i]], ..., pairs[pairOffsets[i+1]-1]
+    std::vector<uint64_t> pairOffsets;
+    std::vector<Pair> pairs;
+};
+
+template <typename F>
+void ReadScoreIndex::forSharedVariants(const uint32_t i, const uint32_t j, F f) const {
+    uint32_t from = std::max(firstWord[i], firstWord[j]);
+    uint32_t to = std::min(firstWord[i] + numWords[i], firstWord[j] + numWords[j]);
+    const uint64_t* wordsI = &words[offset[i]];
+    const uint64_t* wordsJ = &words[offset[j]];
+    for (uint32_t w = from; w < to; w++) {
+        uint64_t both = wordsI[w - firstWord[i]] & wordsJ[w - firstWord[j]];
+        while (both != 0) {
+            f(w * 64 + __builtin_ctzll(both));
+            both &= both - 1;
+        }
+    }
+}
+
+#endif
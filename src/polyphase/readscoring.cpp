@@ -1,71 +1,79 @@
 #include "readscoring.h"
 #include <vector>
-#include <unordered_set>
 #include <unordered_map>
 #include <limits>
 #include <cmath>
 #include <algorithm>
+#include <memory>
+#include <stdexcept>
 
-void ReadScoring::scoreReadsetGlobal(TriangleSparseMatrix *result, ReadSet *readset, const uint32_t minOverlap, const uint32_t ploidy) const {
-    // copy relevant information from readset for fast access
-    std::vector<uint32_t> begins;
-    std::vector<uint32_t> ends;
-    std::vector<std::vector<uint32_t>> positions;
-	std::vector<std::vector<uint8_t>> alleles;
-    std::vector<uint32_t> posList;
-    std::unordered_map<uint32_t, uint32_t> posMap;
-    uint32_t longestReadSpan = 0;
-    computeStartEnd(readset, begins, ends, positions, alleles, posList, posMap, longestReadSpan);
-    
-    // compute length of overlap and difference for all read pairs
-    double hammingDistSame = 0;
-    double hammingDistDiff = 0;
-    computeOverlapDiff(readset, begins, ends, positions, alleles, posList, posMap, result, hammingDistSame, hammingDistDiff, minOverlap, ploidy, longestReadSpan);
-    hammingDistSame = 0.10;
-    hammingDistDiff = 0.40;
+void ReadScoring::scoreReadsetGlobal(TriangleSparseMatrix *result, const ReadSet *readset, const uint32_t minOverlap, const uint32_t ploidy, const uint32_t threads) const {
+    ReadScoreIndex index(readset, minOverlap, threads);
+    scoreIndexGlobal(result, index, minOverlap);
+}
+
+void ReadScoring::scoreReadsetLocal(TriangleSparseMatrix* result, const ReadSet* readset, const uint32_t minOverlap, const uint32_t ploidy, const uint32_t threads) const {
+    std::vector<std::vector<uint32_t>> emptyRef;
+    scoreReadsetLocal(result, readset, emptyRef, minOverlap, ploidy, threads);
+}
+
+void ReadScoring::scoreReadsetLocal(TriangleSparseMatrix* result, const ReadSet* readset, std::vector<std::vector<uint32_t>>& refHaplotypes, const uint32_t minOverlap, const uint32_t ploidy, const uint32_t threads) const {
+    ReadScoreIndex index(readset, minOverlap, threads);
+    scoreIndexLocal(result, index, refHaplotypes, minOverlap, ploidy);
+}
+
+void ReadScoring::scoreIndexGlobal(TriangleSparseMatrix *result, const ReadScoreIndex& index, const uint32_t minOverlap) const {
+    if (minOverlap < index.getMinOverlap()) {
+        throw std::invalid_argument("ReadScoring: minOverlap is smaller than the one of the index");
+    }
+    double hammingDistSame = 0.10;
+    double hammingDistDiff = 0.40;
     
     // compute pair wise scores
-    std::vector<std::pair<uint32_t, uint32_t>> entries = result->getEntries();
     std::unordered_map<uint64_t, float> cache;
-    for (std::pair<uint32_t, uint32_t> p : entries) {
-        uint32_t i = p.first;
-        uint32_t j = p.second;
-        TriangleSparseMatrix::DoubleInt d = result->getDoubleInt(i, j);
-        uint32_t ov = d.u1;
-        uint32_t di = d.u2;
-        uint64_t ovdi = (ov*(ov+1))/2+di;
-        std::unordered_map<uint64_t, float>::const_iterator it = cache.find(ovdi);
-        if (it == cache.end()) {
-            cache[ovdi] = logratioSim(ov, di, hammingDistSame, hammingDistDiff);
+    result->reserve(index.getNumPairs());
+    for (uint32_t i = 0; i < index.getNumReads(); i++) {
+        for (const ReadScoreIndex::Pair* pair = index.pairsBegin(i); pair != index.pairsEnd(i); pair++) {
+            uint32_t ov = pair->overlap;
+            uint32_t di = pair->diff;
+            if (ov < minOverlap)
+                continue;
+            uint64_t ovdi = ((uint64_t)ov*(ov+1))/2+di;
+            std::unordered_map<uint64_t, float>::const_iterator it = cache.find(ovdi);
+            if (it == cache.end()) {
+                it = cache.emplace(ovdi, logratioSim(ov, di, hammingDistSame, hammingDistDiff)).first;
+            }
+            result->set(i, pair->partner, it->second);
         }
-        result->set(i, j, cache[ovdi]);
     }
-    
 }
 
-void ReadScoring::scoreReadsetLocal(TriangleSparseMatrix* result, ReadSet* readset, const uint32_t minOverlap, const uint32_t ploidy) const {
+void ReadScoring::scoreIndexLocal(TriangleSparseMatrix* result, const ReadScoreIndex& index, const uint32_t minOverlap, const uint32_t ploidy) const {
     std::vector<std::vector<uint32_t>> emptyRef;
-    scoreReadsetLocal(result, readset, emptyRef, minOverlap, ploidy);
+    scoreIndexLocal(result, index, emptyRef, minOverlap, ploidy);
 }
 
-void ReadScoring::scoreReadsetLocal(TriangleSparseMatrix* result, ReadSet* readset, std::vector<std::vector<uint32_t>>& refHaplotypes, const uint32_t minOverlap, const uint32_t ploidy) const {
+void ReadScoring::scoreIndexLocal(TriangleSparseMatrix* result, const ReadScoreIndex& index, std::vector<std::vector<uint32_t>>& refHaplotypes, const uint32_t minOverlap, const uint32_t ploidy) const {
     
     if (ploidy < 2) {
         std::cout<<"Error: Ploidy < 2!"<<std::endl;
         return;
     }
+    if (minOverlap < index.getMinOverlap()) {
+        throw std::invalid_argument("ReadScoring: minOverlap is smaller than the one of the index");
+    }
     
-    uint32_t numReads = readset->size();
-    
-    // copy relevant information from readset for fast access
-    std::vector<uint32_t> begins;
-    std::vector<uint32_t> ends;
-    std::vector<std::vector<uint32_t>> positions;
-	std::vector<std::vector<uint8_t>> alleles;
-    std::vector<uint32_t> posList;
-    std::unordered_map<uint32_t, uint32_t> posMap;
+    uint32_t numReads = index.getNumReads();
+    if (numReads == 0) {
+        return;
+    }
+    const std::vector<uint32_t>& begins = index.getBegins();
+    const std::vector<uint32_t>& ends = index.getEnds();
+    const std::vector<uint32_t>& posList = index.getPositions();
     uint32_t longestReadSpan = 0;
-    computeStartEnd(readset, begins, ends, positions, alleles, posList, posMap, longestReadSpan);
+    for (uint32_t i = 0; i < numReads; i++) {
+        longestReadSpan = std::max(longestReadSpan, ends[i] - begins[i]);
+    }
     
     // check ref haplotypes
     if (refHaplotypes.size() > 0) {
@@ -80,24 +88,30 @@ void ReadScoring::scoreReadsetLocal(TriangleSparseMatrix* result, ReadSet* reads
         }
     }
     
-    // compute length of overlap and difference for all read pairs
-    // reuse the result matrix to store overlaps and diffs. they will be overwritten later on
+    // estimate the default distances from all read pairs
+    std::vector<uint32_t> coveredReads;
+    std::vector<bool> covered(numReads, true);
+    for (uint32_t i = 0; i < numReads; i++) {
+        coveredReads.push_back(i);
+    }
+    std::vector<double> relativeDiffs;
+    collectRelativeDiffs(index, coveredReads, covered, minOverlap, relativeDiffs);
     double defaultSameDist = 0;
     double defaultDiffDist = 0;
-    computeOverlapDiff(readset, begins, ends, positions, alleles, posList, posMap, result, defaultSameDist, defaultDiffDist, minOverlap, ploidy, longestReadSpan);
+    computeCutoff(numReads, ploidy, relativeDiffs, defaultSameDist, defaultDiffDist);
+    covered.assign(numReads, false);
     
     // compute longest read length and average read length (in base pairs) and divide by 2
     uint32_t windowSize = 0;
     for (uint32_t i = 0; i < numReads; i++) {
-        uint32_t len = readset->get(i)->lastPosition() - readset->get(i)->firstPosition();
-        windowSize += len;
+        windowSize += ends[i] - begins[i];
     }
     windowSize /= (4*numReads);
     
     //divide snp positions by window size
     std::vector<uint32_t> windowStarts;
-    std::unordered_map<uint32_t, double> posToSameDist;
-    std::unordered_map<uint32_t, double> posToDiffDist;
+    std::vector<double> sameDists(posList.size());
+    std::vector<double> diffDists(posList.size());
     
     uint32_t windowStartPosition = 0;
     for (uint32_t current = 0; current < posList.size(); current++) {
@@ -116,14 +130,37 @@ void ReadScoring::scoreReadsetLocal(TriangleSparseMatrix* result, ReadSet* reads
         uint32_t start = posList[startVariant];
         uint32_t end = posList[endVariant-1];
 
-        // compute length of overlap and difference for all read pairs
-        TriangleSparseMatrix overlapsDiffsLocal;
+        // the reads covering the whole window (or all reads, if the window bounds happen to equal 0 and the number of reads)
+        coveredReads.clear();
+        if (start == 0 && end == numReads) {
+            for (uint32_t i = 0; i < numReads; i++) {
+                coveredReads.push_back(i);
+            }
+        } else {
+            // binary search to find first read, which can theoretically cover this window
+            uint32_t firstIndex = std::lower_bound(begins.begin(), begins.end(), start-longestReadSpan) - begins.begin();
+            // iterate until start position of read is behind required start
+            for (uint32_t j = firstIndex; j < numReads && begins[j] <= start; j++) {
+                if (ends[j] >= end) {
+                    coveredReads.push_back(j);
+                }
+            }
+        }
+        
+        // take the overlaps and differences of their pairs from the index
+        for (uint32_t i : coveredReads) {
+            covered[i] = true;
+        }
+        relativeDiffs.clear();
+        collectRelativeDiffs(index, coveredReads, covered, minOverlap, relativeDiffs);
+        for (uint32_t i : coveredReads) {
+            covered[i] = false;
+        }
         double localSameDist = 0;
         double localDiffDist = 0;
-        computeOverlapDiff(readset, begins, ends, positions, alleles, posList, posMap, &overlapsDiffsLocal, 
-                           localSameDist, localDiffDist, minOverlap, ploidy, longestReadSpan, start, end);
+        computeCutoff(coveredReads.size(), ploidy, relativeDiffs, localSameDist, localDiffDist);
         
-        if (overlapsDiffsLocal.getEntries().size() < ploidy) {
+        if (relativeDiffs.size() < ploidy) {
             // too few read pairs, use average over all reads instead
             localSameDist = defaultSameDist;
             localDiffDist = defaultDiffDist;
@@ -156,176 +193,147 @@ void ReadScoring::scoreReadsetLocal(TriangleSparseMatrix* result, ReadSet* reads
             localDiffDist = std::min(localDiffDist, bestDiffDist*(1-localSameDist)+(1-bestDiffDist)*localSameDist);
         }
         
-        // store values in a map for every snp position
-        for (uint32_t j = windowStarts[windowIdx]; j < windowStarts[windowIdx+1]; j++) {
-            posToSameDist[posList[j]] = localSameDist;
-            posToDiffDist[posList[j]] = localDiffDist;
+        // store values for every snp position
+        for (uint32_t j = startVariant; j < endVariant; j++) {
+            sameDists[j] = localSameDist;
+            diffDists[j] = localDiffDist;
         }
     }
             
     // now, iterate over all overlapping read pairs and compute their score
-    std::vector<std::pair<uint32_t, uint32_t>> entries = result->getEntries();
-    for (std::pair<uint32_t, uint32_t> p : entries) {
-        uint32_t i = p.first;
-        uint32_t j = p.second;
-        TriangleSparseMatrix::DoubleInt ovdi = result->getDoubleInt(i, j);
-        uint32_t ov = ovdi.u1;
-        uint32_t di = ovdi.u2;
-        
-        // zig zag over read positions to determine their individual same/diff dists
-        double same = 0.0;
-        double diff = 0.0;
-        uint32_t k = 0;
-        uint32_t l = 0;
-        while (k < positions[i].size() && l < positions[j].size()) {
-            if (positions[i][k] == positions[j][l]) {
-                same += posToSameDist[positions[i][k]];
-                diff += posToDiffDist[positions[i][k]];
-                k++; l++;
-            } else if (positions[i][k] < positions[j][l]) {
-                k++;
-            } else {
-                l++;
-            }
+    result->reserve(index.getNumPairs());
+    for (uint32_t i = 0; i < numReads; i++) {
+        for (const ReadScoreIndex::Pair* pair = index.pairsBegin(i); pair != index.pairsEnd(i); pair++) {
+            uint32_t ov = pair->overlap;
+            uint32_t di = pair->diff;
+            if (ov < minOverlap)
+                continue;
+            
+            // sum up the same/diff dists of the shared positions
+            double same = 0.0;
+            double diff = 0.0;
+            index.forSharedVariants(i, pair->partner, [&](uint32_t rank) {
+                same += sameDists[rank];
+                diff += diffDists[rank];
+            });
+            same /= ov;
+            diff /= ov;
+            same = std::max(same, 0.001);
+            diff = std::min(0.999, std::max(diff, same + 0.001));
+            result->set(i, pair->partner, logratioSim(ov, di, same, diff));
         }
-        same /= ov;
-        diff /= ov;
-        same = std::max(same, 0.001);
-		diff = std::min(0.999, std::max(diff, same + 0.001));
-        result->set(i, j, logratioSim(ov, di, same, diff));
     }
 }
 
-void ReadScoring::computeStartEnd (const ReadSet* readset,
-                                   std::vector<uint32_t>& begins,
-                                   std::vector<uint32_t>& ends,
-                                   std::vector<std::vector<uint32_t>>& positions,
-                                   std::vector<std::vector<uint8_t>>& alleles,
-                                   std::vector<uint32_t>& posList,
-                                   std::unordered_map<uint32_t, uint32_t>& posMap,
-                                   uint32_t& longestReadSpan) const {
-    // copy all relevant information from the readset into vectors for efficient access
+std::vector<uint32_t> ReadScoring::computeLinkageBasedBlockStarts(const ReadSet* readset, const uint32_t ploidy, const bool singleLinkage) const {
+    // map the variants of each read to the rank of their position among all variant positions
     uint32_t numReads = readset->size();
-    std::unordered_set<uint32_t> allPos;
+    std::unique_ptr<std::vector<unsigned int>> posList(readset->get_positions());
+    uint32_t numVars = posList->size();
+    if (numVars == 0) {
+        return std::vector<uint32_t>();
+    }
+    std::unordered_map<uint32_t, uint32_t> posMap;
+    for (uint32_t i = 0; i < numVars; i++) {
+        posMap[(*posList)[i]] = i;
+    }
+    std::vector<std::vector<uint32_t>> readVars(numReads);
     for (uint32_t i = 0; i < numReads; i++) {
-        begins.push_back(readset->get(i)->firstPosition());
-        ends.push_back(readset->get(i)->lastPosition());
-        std::vector<uint32_t> pos;
-        std::vector<uint8_t> all;
-        for (int k = 0; k < readset->get(i)->getVariantCount(); k++) {
-            pos.push_back(readset->get(i)->getPosition(k));
-            all.push_back((uint8_t)(readset->get(i)->getAllele(k)));
-            allPos.insert(readset->get(i)->getPosition(k));
+        const Read* read = readset->get(i);
+        for (int k = 0; k < read->getVariantCount(); k++) {
+            readVars[i].push_back(posMap[read->getPosition(k)]);
         }
-        positions.push_back(pos);
-        alleles.push_back(all);
     }
-    
-    // create position map
-    posList.clear();
-    for (uint32_t pos : allPos) {
-        posList.push_back(pos);
+
+    // number of reads needed to connect two variants
+    uint32_t cutThreshold = 1;
+    if (ploidy != 2 && !singleLinkage) {
+        cutThreshold = ploidy * ploidy;
+        for (uint32_t i = ploidy - 1; i < ploidy * ploidy; i++) {
+            // chance to cover at most ploidy-2 haplotypes with i reads
+            cutThreshold = i;
+            if (ploidy * std::pow(((double)ploidy - 2.0) / ploidy, i) < 0.02) {
+                break;
+            }
+        }
     }
-    std::sort(posList.begin(), posList.end());
-    for (uint32_t i = 0; i < posList.size(); i++) {
-        posMap[posList[i]] = i;
+
+    // count the reads covering each pair of consecutive variants in one sweep over the reads
+    std::vector<uint32_t> linkToNext(numVars, 0);
+    for (const std::vector<uint32_t>& vars : readVars) {
+        for (uint32_t k = 0; k + 1 < vars.size(); k++) {
+            if (vars[k] + 1 == vars[k + 1]) {
+                linkToNext[vars[k]]++;
+            }
+        }
     }
-    
-    // determine length of the longest read
-    longestReadSpan = 0;
-    for (uint32_t i = 0; i < numReads; i++) {
-        longestReadSpan = std::max(longestReadSpan, ends[i] - begins[i]);
+    std::vector<uint32_t> posClust(numVars, 0);
+    for (uint32_t i = 1; i < numVars; i++) {
+        posClust[i] = linkToNext[i - 1] >= cutThreshold ? posClust[i - 1] : posClust[i - 1] + 1;
     }
-}
+    uint32_t numClust = posClust.back() + 1;
 
-void ReadScoring::computeOverlapDiff (const ReadSet* readset,
-                                      const std::vector<uint32_t>& begins,
-                                      const std::vector<uint32_t>& ends,
-                                      const std::vector<std::vector<uint32_t>>& positions,
-                                      const std::vector<std::vector<uint8_t>>& alleles,
-                                      const std::vector<uint32_t>& posList,
-                                      std::unordered_map<uint32_t, uint32_t>& posMap,
-                                      TriangleSparseMatrix* overlapDiffs,
-                                      double& distSame,
-                                      double& distDiff,
-                                      const uint32_t minOverlap,
-                                      const uint32_t ploidy,
-                                      const uint32_t longestReadSpan,
-                                      const uint32_t begin,
-                                      const uint32_t end) const {
-                                          
-    std::vector<uint32_t> coveredReads;
-    
-    // determine coveredReads if begin and end position are specified (otherwise use all reads)
-    if (begin == 0 && end == begins.size()) {
-        for (uint32_t i = 0; i < begins.size(); i++) {
-            coveredReads.push_back(i);
+    // count the reads covering each pair of clusters
+    std::unordered_map<uint64_t, uint32_t> linkCoverage;
+    std::vector<uint32_t> clusters;
+    for (const std::vector<uint32_t>& vars : readVars) {
+        clusters.clear();
+        for (uint32_t var : vars) {
+            clusters.push_back(posClust[var]);
         }
-    } else {
-        // binary search to find first read, which can theoretically cover this window
-        uint32_t firstIndex = std::lower_bound(begins.begin(), begins.end(), begin-longestReadSpan) - begins.begin();
-        // iterate until start position of read is behind required start
-        for (uint32_t j = firstIndex; begins[j] <= begin && j < begins.size(); j++) {
-            if (ends[j] >= end) {
-                coveredReads.push_back(j);
+        std::sort(clusters.begin(), clusters.end());
+        clusters.erase(std::unique(clusters.begin(), clusters.end()), clusters.end());
+        for (uint32_t k = 0; k < clusters.size(); k++) {
+            for (uint32_t l = k + 1; l < clusters.size(); l++) {
+                linkCoverage[((uint64_t)clusters[k] << 32) | clusters[l]]++;
             }
         }
     }
-    
-    // iterate over all read pairs (efficiently omitting those who can certainly not overlap)
-    std::vector<double> relativeDiffs;
-    for (uint32_t i = 0; i < coveredReads.size(); i++) {
-        // iterate until start position of read is behind required start
-        uint32_t ci = coveredReads[i];
-        for (uint32_t j = i+1; j < coveredReads.size() && begins[coveredReads[j]] <= ends[ci]; j++) {
-            uint32_t cj = coveredReads[j];
-            if (ends[ci] < begins[cj] || ends[cj] < begins[ci])
-                continue;
-            uint32_t ov = 0;
-            uint32_t di = 0;
-            uint32_t k = 0;
-            uint32_t l = 0;
-            while (k < positions[ci].size() && l < positions[cj].size()) {
-                if (positions[ci][k] == positions[cj][l]) {
-                    if (alleles[ci][k] != alleles[cj][l]) {
-                        di++;
-                    }
-                    ov++; k++; l++; 
-                } else if (positions[ci][k] < positions[cj][l]) {
-                    k++;
-                } else {
-                    l++;
-                }
-            }
-            if (ov >= minOverlap) {
-                overlapDiffs->setDoubleInt(ci, cj, (uint16_t)ov, (uint16_t)di);
-                relativeDiffs.push_back((double)di / (double)ov);
+
+    // merge clusters that are (transitively) linked by enough reads
+    std::vector<uint32_t> parent(numClust);
+    for (uint32_t c = 0; c < numClust; c++) {
+        parent[c] = c;
+    }
+    auto find = [&parent](uint32_t c) {
+        while (parent[c] != c) {
+            parent[c] = parent[parent[c]];
+            c = parent[c];
+        }
+        return c;
+    };
+    for (const auto& link : linkCoverage) {
+        if (link.second >= cutThreshold) {
+            uint32_t c1 = find((uint32_t)(link.first >> 32));
+            uint32_t c2 = find((uint32_t)(link.first & 0xFFFFFFFF));
+            if (c1 != c2) {
+                parent[std::max(c1, c2)] = std::min(c1, c2);
             }
         }
     }
-    
-    // estimate error rate of reads within equal haplotype
-    computeCutoff(coveredReads, ploidy, relativeDiffs, distSame, distDiff);
+
+    // cut between variants of different merged clusters
+    std::vector<uint32_t> cuts;
+    cuts.push_back(0);
+    for (uint32_t i = 1; i < numVars; i++) {
+        if (find(posClust[i]) != find(posClust[i - 1])) {
+            cuts.push_back(i);
+        }
+    }
+    return cuts;
 }
 
-void ReadScoring::computeOverlapDiff (const ReadSet* readset,
-                                      const std::vector<uint32_t>& begins,
-                                      const std::vector<uint32_t>& ends,
-                                      const std::vector<std::vector<uint32_t>>& positions,
-                                      const std::vector<std::vector<uint8_t>>& alleles,
-                                      const std::vector<uint32_t>& posList,
-                                      std::unordered_map<uint32_t, uint32_t>& posMap,
-                                      TriangleSparseMatrix* overlapDiffs,
-                                      double& distSame,
-                                      double& distDiff,
-                                      const uint32_t minOverlap,
-                                      const uint32_t ploidy,
-                                      const uint32_t longestReadSpan) const {
-    computeOverlapDiff(readset, begins, ends, positions, alleles, posList, posMap, overlapDiffs, distSame, distDiff, minOverlap, ploidy, longestReadSpan, 0, begins.size());
+void ReadScoring::collectRelativeDiffs(const ReadScoreIndex& index, const std::vector<uint32_t>& coveredReads, const std::vector<bool>& covered, const uint32_t minOverlap, std::vector<double>& relDiffs) const {
+    for (uint32_t i : coveredReads) {
+        for (const ReadScoreIndex::Pair* pair = index.pairsBegin(i); pair != index.pairsEnd(i); pair++) {
+            if (pair->overlap >= minOverlap && covered[pair->partner]) {
+                relDiffs.push_back((double)pair->diff / (double)pair->overlap);
+            }
+        }
+    }
 }
 
-void ReadScoring::computeCutoff(const std::vector<uint32_t>& coveredReads, const uint32_t ploidy, std::vector<double> relDiffs, double& distSame, double& distDiff) const {
-    uint32_t numReads = coveredReads.size();
+void ReadScoring::computeCutoff(const uint32_t numReads, const uint32_t ploidy, std::vector<double> relDiffs, double& distSame, double& distDiff) const {
     std::sort(relDiffs.begin(), relDiffs.end());
     double sameSum = 0.0;
     int sameNum = 0;
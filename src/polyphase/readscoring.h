@@ -3,6 +3,7 @@
 
 #include "../readset.h"
 #include "../read.h"
+#include "readscoreindex.h"
 #include "trianglesparsematrix.h"
 
 class ReadScoring {
@@ -10,51 +11,36 @@ class ReadScoring {
 public:
     /**
      * Computes pairwise scores for all reads in the readset and returns a sparse triangle matrix, where elements with a score of zero are not included.
+     * The overlaps and differences of read pairs are counted on the given number of threads; the result does not depend on it.
      */
-    void scoreReadsetGlobal(TriangleSparseMatrix *result, ReadSet *readset, const uint32_t minOverlap, const uint32_t ploidy) const;
-    void scoreReadsetLocal(TriangleSparseMatrix *result, ReadSet *readset, const uint32_t minOverlap, const uint32_t ploidy) const;
-    void scoreReadsetLocal(TriangleSparseMatrix *result, ReadSet *readset, std::vector<std::vector<uint32_t>>& refHaplotypes, const uint32_t minOverlap, const uint32_t ploidy) const;
+    void scoreReadsetGlobal(TriangleSparseMatrix *result, const ReadSet *readset, const uint32_t minOverlap, const uint32_t ploidy, const uint32_t threads = 1) const;
+    void scoreReadsetLocal(TriangleSparseMatrix *result, const ReadSet *readset, const uint32_t minOverlap, const uint32_t ploidy, const uint32_t threads = 1) const;
+    void scoreReadsetLocal(TriangleSparseMatrix *result, const ReadSet *readset, std::vector<std::vector<uint32_t>>& refHaplotypes, const uint32_t minOverlap, const uint32_t ploidy, const uint32_t threads = 1) const;
+
+    /**
+     * Same as above, but takes the overlaps and differences of the read pairs from an index of the readset, such that the
+     * reads are not scanned again. minOverlap must not be smaller than the one of the index.
+     */
+    void scoreIndexGlobal(TriangleSparseMatrix *result, const ReadScoreIndex& index, const uint32_t minOverlap) const;
+    void scoreIndexLocal(TriangleSparseMatrix *result, const ReadScoreIndex& index, const uint32_t minOverlap, const uint32_t ploidy) const;
+    void scoreIndexLocal(TriangleSparseMatrix *result, const ReadScoreIndex& index, std::vector<std::vector<uint32_t>>& refHaplotypes, const uint32_t minOverlap, const uint32_t ploidy) const;
+
+    /**
+     * Divides the variants of the readset (indexed by their rank among all variant positions) into intervals that are
+     * poorly connected by the reads and returns the index of the first variant of each interval. Two consecutive
+     * variants are connected if at least a threshold of reads covers both of them; this threshold is 1 for ploidy 2 or
+     * if singleLinkage is set and otherwise the smallest number of reads that cover at least ploidy-1 haplotypes with
+     * a chance of 98%. Runs of connected variants are then merged if enough reads cover both of them (transitively).
+     */
+    std::vector<uint32_t> computeLinkageBasedBlockStarts(const ReadSet *readset, const uint32_t ploidy, const bool singleLinkage) const;
 
 private:
-    void computeStartEnd (const ReadSet* readset,
-                          std::vector<uint32_t>& begins,
-                          std::vector<uint32_t>& ends,
-                          std::vector<std::vector<uint32_t>>& positions,
-                          std::vector<std::vector<uint8_t>>& alleles,
-                          std::vector<uint32_t>& posList,
-                          std::unordered_map<uint32_t, uint32_t>& posMap,
-                          uint32_t& longestReadSpan) const;
+    /**
+     * Collects the relative differences of all pairs of the marked reads with an overlap of at least minOverlap.
+     */
+    void collectRelativeDiffs(const ReadScoreIndex& index, const std::vector<uint32_t>& coveredReads, const std::vector<bool>& covered, const uint32_t minOverlap, std::vector<double>& relDiffs) const;
 
-    void computeOverlapDiff (const ReadSet* readset,
-                             const std::vector<uint32_t>& begins,
-                             const std::vector<uint32_t>& ends,
-                             const std::vector<std::vector<uint32_t>>& positions,
-                             const std::vector<std::vector<uint8_t>>& alleles,
-                             const std::vector<uint32_t>& posList,
-                             std::unordered_map<uint32_t, uint32_t>& posMap,
-                             TriangleSparseMatrix* overlapDiffs,
-                             double& distSame,
-                             double& distDiff,
-                             const uint32_t minOverlap,
-                             const uint32_t ploidy,
-                             const uint32_t longestReadSpan,
-                             const uint32_t begin,
-                             const uint32_t end) const;
-                             
-    void computeOverlapDiff (const ReadSet* readset,
-                             const std::vector<uint32_t>& begins,
-                             const std::vector<uint32_t>& ends,
-                             const std::vector<std::vector<uint32_t>>& positions,
-                             const std::vector<std::vector<uint8_t>>& alleles,
-                             const std::vector<uint32_t>& posList,
-                             std::unordered_map<uint32_t, uint32_t>& posMap,
-                             TriangleSparseMatrix* overlapDiffs,
-                             double& distSame,
-                             double& distDiff,
-                             const uint32_t minOverlap,
-                             const uint32_t ploidy,
-                             const uint32_t longestReadSpan) const;
-    void computeCutoff(const std::vector<uint32_t>& coveredReads, const uint32_t ploidy, std::vector<double> relDiffs, double& distSame, double& distDiff) const;
+    void computeCutoff(const uint32_t numReads, const uint32_t ploidy, std::vector<double> relDiffs, double& distSame, double& distDiff) const;
     float logratioSim(const uint32_t overlap, const uint32_t diff, const double distSame, const double distDiff) const;
     double binomPmf(const uint32_t n, const uint32_t k, const double p) const;
 };
@@ -12,15 +12,77 @@ using EdgeWeight = StaticSparseGraph::EdgeWeight;
 using EdgeId = StaticSparseGraph::EdgeId;
 using RankId = StaticSparseGraph::RankId;
 using NodeId = StaticSparseGraph::NodeId;
+using RankBlock = StaticSparseGraph::RankBlock;
+
+namespace {
+    
+    /**
+     * Looks up the rank of an edge in the two-level rank structure, using the given popcount function. Inlined
+     * into functions compiled with and without the POPCNT instruction set.
+     */
+    template <uint64_t Popcount(uint64_t)>
+    inline __attribute__((always_inline)) RankId findRankWith(const RankBlock* rank1, const RankBlock* rank2, const EdgeId id) {
+        const RankBlock& superblock = rank1[id / 4096];
+        uint64_t bitv = superblock.bits >> (63 - (id/64) % 64);
+        
+        // check if corresponding bit in rank block is unset
+        if ((bitv & 1UL) == 0) {
+            return 0;
+        }
+        
+        const RankBlock& block = rank2[superblock.offset + Popcount(bitv) - 1];
+        bitv = block.bits >> (63 - id % 64);
+        
+        if ((bitv & 1UL) == 0) {
+            return 0;
+        }
+        
+        return block.offset + Popcount(bitv) - 1;
+    }
+    
+    RankId findRankScalar(const RankBlock* rank1, const RankBlock* rank2, const EdgeId id) {
+        return findRankWith<StaticSparseGraph::popcount>(rank1, rank2, id);
+    }
+    
+    typedef RankId (*find_rank_t)(const RankBlock* rank1, const RankBlock* rank2, const EdgeId id);
+    
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    // compiles to the POPCNT instruction when inlined into findRankPopcnt
+    inline __attribute__((always_inline)) uint64_t popcountBuiltin(uint64_t bitv) {
+        return __builtin_popcountll(bitv);
+    }
+    
+    __attribute__((target("popcnt")))
+    RankId findRankPopcnt(const RankBlock* rank1, const RankBlock* rank2, const EdgeId id) {
+        return findRankWith<popcountBuiltin>(rank1, rank2, id);
+    }
+    
+    find_rank_t selectFindRank() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("popcnt") ? findRankPopcnt : findRankScalar;
+    }
+#else
+    // only used to name the instruction set
+    RankId findRankPopcnt(const RankBlock* rank1, const RankBlock* rank2, const EdgeId id) {
+        return findRankScalar(rank1, rank2, id);
+    }
+    
+    find_rank_t selectFindRank() {
+        return findRankScalar;
+    }
+#endif
+    
+    const find_rank_t findRank = selectFindRank();
+}
 
 StaticSparseGraph::StaticSparseGraph(StaticSparseGraph& other) :
     size(other.size),
     rank1(other.rank1),
-    offset1(other.offset1),
     rank2(other.rank2),
-    offset2(other.offset2),
     weightv(other.weightv),
     unprunedNeighbours(other.unprunedNeighbours),
+    unprunedRanks(other.unprunedRanks),
+    unprunedPositions(other.unprunedPositions),
     nonzeroNeighbours(other.nonzeroNeighbours),
     cliqueOfNode(other.cliqueOfNode),
     cliques(other.cliques),
@@ -28,12 +90,12 @@ StaticSparseGraph::StaticSparseGraph(StaticSparseGraph& other) :
 
 StaticSparseGraph::StaticSparseGraph(TriangleSparseMatrix& m) :
     size((uint64_t)m.getMaxDim()),
-    rank1(std::max((int64_t)0, (int64_t)(size*(size-1)/2 - 1) / 4096 + 1), 0UL),
-    offset1(std::max((int64_t)0, (int64_t)(size*(size-1)/2 - 1) / 4096 + 1), 0UL),
+    rank1(std::max((int64_t)0, (int64_t)(size*(size-1)/2 - 1) / 4096 + 1), RankBlock{0UL, 0UL}),
     rank2(0),
-    offset2(0),
     weightv(0),
     unprunedNeighbours(size, std::vector<NodeId>(0)),
+    unprunedRanks(size, std::vector<RankId>(0)),
+    unprunedPositions(0),
     nonzeroNeighbours(size, std::vector<NodeId>(0)),
     cliqueOfNode(size, 0),
     cliques(size, std::vector<NodeId>(0)),
@@ -51,45 +113,48 @@ StaticSparseGraph::StaticSparseGraph(TriangleSparseMatrix& m) :
 void StaticSparseGraph::compile(TriangleSparseMatrix& m) {
     weightv.push_back(0.0);
     
-    // iterate over all sorted edges
-    for (EdgeId id : m.getIndices()) {
-        NodeId u = std::ceil(std::sqrt(2*(id+1)+0.25) - 0.5);
-        NodeId v = (NodeId)(id - (uint64_t)u * (uint64_t)(u-1) / 2);
-        EdgeWeight w = m.get(u, v);
+    // iterate over all sorted edges (the entries of m are sorted in place, not copied)
+    std::vector<TriangleSparseMatrix::Entry>& entries = m.getSortedEntries();
+    weightv.reserve(entries.size() + 1);
+    unprunedPositions.resize(entries.size() + 1, std::pair<uint32_t, uint32_t>(0, 0));
+    for (const TriangleSparseMatrix::Entry& entry : entries) {
+        EdgeId id = entry.index - 1;
+        NodeId u = entry.row();
+        NodeId v = entry.col();
+        EdgeWeight w = entry.item.v;
         
         // insert entry into rank structure
         uint64_t block1 = id / 4096UL;
         uint64_t block2 = (id/64UL) % 64UL;
-        uint64_t bitv = rank1[block1] >> (63 - block2);
+        uint64_t bitv = rank1[block1].bits >> (63 - block2);
         
         // check if new block in rank1 has been reached
-        if (rank1[block1] == 0UL) {
-            offset1[block1] = rank2.size();
+        if (rank1[block1].bits == 0UL) {
+            rank1[block1].offset = rank2.size();
         }
         
         // check if rank1 already has a one at this position
         if ((bitv & 1UL) == 0) {
             // set bit in rank1 to one
-            rank1[block1] |= (1UL << (63 - block2));
+            rank1[block1].bits |= (1UL << (63 - block2));
             bitv |= 1UL;
             // create new block for rank2
-            rank2.push_back(0UL);
-            offset2.push_back(weightv.size());
+            rank2.push_back(RankBlock{0UL, weightv.size()});
         }
         
-        block2 = offset1[block1] + popcount(bitv) - 1; //only count ones BEFORE current position
+        block2 = rank1[block1].offset + popcount(bitv) - 1; //only count ones BEFORE current position
         uint64_t block3 = id % 64UL;
-        bitv = rank2[block2] >> (63 - block3);
+        bitv = rank2[block2].bits >> (63 - block3);
         
         // insert edge
         if((bitv & 1UL) != 0) {
             std::cout<<"Assertion violated (Edge already inserted): "<<u<<" "<<v<<std::endl;
         }
-        rank2[block2] |= (1UL << (63 - block3));
+        rank2[block2].bits |= (1UL << (63 - block3));
         bitv |= 1UL;
         
-        if(offset2[block2] + popcount(bitv) - 1 != weightv.size()) {
-            std::cout<<"Assertion violated (Weight vector incorrect size): "<<u<<" "<<v<<" "<<(offset2[block2] + popcount(bitv) - 1)<<" "<<(weightv.size())<<std::endl;
+        if(rank2[block2].offset + popcount(bitv) - 1 != weightv.size()) {
+            std::cout<<"Assertion violated (Weight vector incorrect size): "<<u<<" "<<v<<" "<<(rank2[block2].offset + popcount(bitv) - 1)<<" "<<(weightv.size())<<std::endl;
         }
         weightv.push_back(w);
         if (w == StaticSparseGraph::Forbidden)
@@ -97,15 +162,13 @@ void StaticSparseGraph::compile(TriangleSparseMatrix& m) {
         else if (w == StaticSparseGraph::Permanent)
             setPermanent(Edge(u, v), weightv.size()-1);
         
-        refreshEdgeMetaData(Edge(u,v), 0.0, w);
+        refreshEdgeMetaData(Edge(u,v), weightv.size()-1, 0.0, w);
         
         EdgeWeight checkWeight = getWeight(Edge(u,v));
         if(w != checkWeight) {
             std::cout<<"Assertion violated (Get != Set): "<<u<<" "<<v<<" "<<w<<" "<<(getWeight(Edge(u,v)))<<std::endl;
         }
     }
-    
-    weightv.shrink_to_fit();
 }
 
 EdgeWeight StaticSparseGraph::getWeight(const Edge e) {
@@ -159,11 +222,10 @@ void StaticSparseGraph::setPermanent(const Edge e, RankId r) {
     }
     if (merged != discarded) {
         // move nodes from discarded to merged cluster
-        for (NodeId d : cliques[discarded]) {
+        for (NodeId d : cliques[discarded])
             cliqueOfNode[d] = merged;
-            cliques[merged].push_back(d);
-        }
-        cliques[discarded].clear();
+        cliques[merged].insert(cliques[merged].end(), cliques[discarded].begin(), cliques[discarded].end());
+        std::vector<NodeId>().swap(cliques[discarded]);
         
         // copy forbidden connections to merged cluster and update references
         for (NodeId f : forbidden[discarded]) {
@@ -171,13 +233,13 @@ void StaticSparseGraph::setPermanent(const Edge e, RankId r) {
             forbidden[f].insert(merged);
             forbidden[f].erase(discarded);
         }
-        forbidden[discarded].clear();
+        std::unordered_set<NodeId>().swap(forbidden[discarded]);
         
         if (cliqueOfNode[e.u] != cliqueOfNode[e.v]) {
             std::cout<<"Error 1000 "<<cliqueOfNode[e.u]<<" != "<<cliqueOfNode[e.v]<<std::endl;
         }
     }
-    refreshEdgeMetaData(e, weightv[r], StaticSparseGraph::Permanent);
+    refreshEdgeMetaData(e, r, weightv[r], StaticSparseGraph::Permanent);
     if (r > 0)
         weightv[r] = StaticSparseGraph::Permanent;
 }
@@ -203,7 +265,7 @@ void StaticSparseGraph::setForbidden(const Edge e, RankId r) {
         forbidden[cu].insert(cv);
         forbidden[cv].insert(cu);
     }
-    refreshEdgeMetaData(e, weightv[r], StaticSparseGraph::Forbidden);
+    refreshEdgeMetaData(e, r, weightv[r], StaticSparseGraph::Forbidden);
     if (r > 0)
         weightv[r] = StaticSparseGraph::Forbidden;
 }
@@ -243,19 +305,11 @@ const std::vector<NodeId>& StaticSparseGraph::getNonZeroNeighbours(const NodeId
     return nonzeroNeighbours[v];
 }
 
-void StaticSparseGraph::refreshEdgeMetaData(const Edge e, const EdgeWeight oldW, const EdgeWeight newW) {
+void StaticSparseGraph::refreshEdgeMetaData(const Edge e, const RankId r, const EdgeWeight oldW, const EdgeWeight newW) {
     if ((oldW == StaticSparseGraph::Forbidden || oldW == StaticSparseGraph::Permanent || (oldW == 0.0)) && ((newW != 0.0) && newW != StaticSparseGraph::Forbidden && newW != StaticSparseGraph::Permanent)) {
-        unprunedNeighbours[e.u].push_back(e.v);
-        unprunedNeighbours[e.v].push_back(e.u);
+        addUnprunedEdge(e, r);
     } else if (oldW != StaticSparseGraph::Forbidden && oldW != StaticSparseGraph::Permanent && (oldW != 0.0) && ((newW == 0.0) || newW == StaticSparseGraph::Forbidden || newW == StaticSparseGraph::Permanent)) {
-        if (!removeFromVector(unprunedNeighbours[e.u], e.v))
-            std::cout<<"Error: Non-zero real neighbour "<<e.v<<" of "<<e.u<<" not found. Weight was set from "<<oldW<<" to "<<newW<<std::endl;
-        if (!removeFromVector(unprunedNeighbours[e.v], e.u))
-            std::cout<<"Error: Non-zero real neighbour "<<e.u<<" of "<<e.v<<" not found. Weight was set from "<<oldW<<" to "<<newW<<std::endl;
-        if (std::find(unprunedNeighbours[e.u].begin(), unprunedNeighbours[e.u].end(), e.v) != unprunedNeighbours[e.u].end())
-            std::cout<<"Removed unpruned neighbour "<<e.v<<" from "<<e.u<<", but is still there"<<std::endl;
-        if (std::find(unprunedNeighbours[e.v].begin(), unprunedNeighbours[e.v].end(), e.u) != unprunedNeighbours[e.v].end())
-            std::cout<<"Removed unpruned neighbour "<<e.u<<" from "<<e.v<<", but is still there"<<std::endl;
+        removeUnprunedEdge(e, r);
     }
     if (oldW == 0.0 && newW != 0.0) {
         nonzeroNeighbours[e.u].push_back(e.v);
@@ -268,6 +322,40 @@ void StaticSparseGraph::refreshEdgeMetaData(const Edge e, const EdgeWeight oldW,
     }
 }
 
+void StaticSparseGraph::addUnprunedEdge(const Edge e, const RankId r) {
+    uint32_t posU = unprunedNeighbours[e.u].size();
+    uint32_t posV = unprunedNeighbours[e.v].size();
+    unprunedNeighbours[e.u].push_back(e.v);
+    unprunedRanks[e.u].push_back(r);
+    unprunedNeighbours[e.v].push_back(e.u);
+    unprunedRanks[e.v].push_back(r);
+    unprunedPositions[r] = e.u > e.v ? std::make_pair(posU, posV) : std::make_pair(posV, posU);
+}
+
+void StaticSparseGraph::removeUnprunedEdge(const Edge e, const RankId r) {
+    for (NodeId x : {e.u, e.v}) {
+        NodeId y = x == e.u ? e.v : e.u;
+        std::vector<NodeId>& neighbours = unprunedNeighbours[x];
+        std::vector<RankId>& ranks = unprunedRanks[x];
+        uint32_t pos = x > y ? unprunedPositions[r].first : unprunedPositions[r].second;
+        if (pos >= neighbours.size() || neighbours[pos] != y) {
+            std::cout<<"Error: Non-zero real neighbour "<<y<<" of "<<x<<" not found."<<std::endl;
+            continue;
+        }
+        // move last entry into the gap and update its stored position
+        NodeId movedNode = neighbours.back();
+        RankId movedRank = ranks.back();
+        neighbours[pos] = movedNode;
+        ranks[pos] = movedRank;
+        neighbours.pop_back();
+        ranks.pop_back();
+        if (x > movedNode)
+            unprunedPositions[movedRank].first = pos;
+        else
+            unprunedPositions[movedRank].second = pos;
+    }
+}
+
 bool StaticSparseGraph::removeFromVector(std::vector<NodeId>& vec, NodeId v) {
     bool found = false;
     for (unsigned int i = 0; i < vec.size(); i++) {
@@ -286,22 +374,9 @@ RankId StaticSparseGraph::findIndex(const Edge e) const {
 }
 
 RankId StaticSparseGraph::findIndex(const EdgeId id) const {
-    uint64_t block1 = id / 4096;
-    uint64_t block2 = (id/64) % 64;
-    uint64_t bitv = rank1[block1] >> (63 - block2);
-    
-    // check if corresponding bit in rank block is unset
-    if ((bitv & 1UL) == 0) {
-        return 0;
-    }
-    
-    block2 = offset1[block1] + popcount(bitv) - 1;
-    uint64_t block3 = id % 64;
-    bitv = rank2[block2] >> (63 - block3);
-    
-    if ((bitv & 1UL) == 0) {
-        return 0;
-    }
-    
-    return offset2[block2] + popcount(bitv) - 1;
+    return findRank(rank1.data(), rank2.data(), id);
+}
+
+const char* StaticSparseGraph::rankInstructionSet() {
+    return findRank == findRankPopcnt ? "popcnt" : "scalar";
 }
@@ -42,9 +42,17 @@ public:
 		bitv = (bitv & m2) + ((bitv >> 2) & m2);
 		bitv = (bitv + (bitv >> 4)) & m4;
 		return (bitv * h01) >> 56;
-		//return _mm_popcnt_u64(bitv); //TODO: can be used instead as a speedup, but requires <x86intrin.h> to be included
 	}
     
+    /**
+     * Block of the two-level rank structure used to find the index of an edge's weight: a bit vector and the number
+     * of ones before it. Both are stored next to each other, such that each level of a lookup reads a single cache line.
+     */
+    struct RankBlock {
+        uint64_t bits;
+        uint64_t offset;
+    };
+    
     /**
     * Compact data structure to represent an edge. It consists of two node indices.
     */
@@ -175,8 +183,14 @@ public:
     
     /**
      * Returns an edge's index in the rank data structure. For non-existing edges, zero is returned.
+     * Uses the POPCNT instruction if the CPU supports it.
      */
     RankId findIndex(const EdgeId id) const;
+    
+    /**
+     * Returns the name of the instruction set used to compute ranks ("popcnt" or "scalar").
+     */
+    static const char* rankInstructionSet();
 
 private:
 	// masks and algorithm to compute popcounts on 64bit words
@@ -187,16 +201,19 @@ private:
 	
     // used for sparse and fast storage of edge weights
     uint64_t size;
-    std::vector<uint64_t> rank1;                // size = 8 bytes per 4096 possible edges (= size*(size-1)/1024)
-    std::vector<uint64_t> offset1;              // size = rank1
-    std::vector<uint64_t> rank2;                // size: best case = 8 bytes per 64 existing edges, worst case = 8 bytes per existing edge
-    std::vector<uint64_t> offset2;              // size = rank 2
+    std::vector<RankBlock> rank1;               // size = 16 bytes per 4096 possible edges (= size*(size-1)/512)
+    std::vector<RankBlock> rank2;               // size: best case = 16 bytes per 64 existing edges, worst case = 16 bytes per existing edge
     std::vector<EdgeWeight> weightv;            // size = 8 bytes per existing edge
     
     
     // additional information for efficient iteration over non-zero non-infinity neighbours
     std::vector<std::vector<NodeId>> unprunedNeighbours;
     
+    // rank of the edge behind every entry of unprunedNeighbours, and for every edge (by rank) the positions of its
+    // entries in the lists of its larger (first) and smaller (second) node. Allows to remove entries in constant time.
+    std::vector<std::vector<RankId>> unprunedRanks;
+    std::vector<std::pair<uint32_t, uint32_t>> unprunedPositions;
+    
     // additional information for efficient iteration over non-zero neighbours
     std::vector<std::vector<NodeId>> nonzeroNeighbours;
     
@@ -213,7 +230,18 @@ private:
     /**
      * Refreshes interal data about edges. Necessary for consistency.
      */
-    void refreshEdgeMetaData(const Edge e, const EdgeWeight oldW, const EdgeWeight newW);
+    void refreshEdgeMetaData(const Edge e, const RankId r, const EdgeWeight oldW, const EdgeWeight newW);
+    
+    /**
+     * Adds the edge with rank r to the unpruned neighbours of both its nodes.
+     */
+    void addUnprunedEdge(const Edge e, const RankId r);
+    
+    /**
+     * Removes the edge with rank r from the unpruned neighbours of both its nodes. The entry is overwritten by the last
+     * entry of the respective list, so the order of the remaining neighbours is the same as with removeFromVector.
+     */
+    void removeUnprunedEdge(const Edge e, const RankId r);
     
     /**
      * Removes a specific node id from the vector.
@@ -4,15 +4,34 @@
 #include <algorithm>
 #include <unordered_set>
 #include <random>
+#include <thread>
+#include <atomic>
+#include <exception>
 
 constexpr uint64_t Permutation::TUPLE_MASKS[];
 const Permutation Permutation::INVALID = Permutation(0xf000000000000000);
+const uint32_t SwitchFlipCalculator::MAX_TABLE_PLOIDY;
+const uint64_t SwitchFlipCalculator::MIN_PARALLEL_TRANSITIONS;
+const uint32_t SwitchFlipCalculator::NO_PRED;
 
-SwitchFlipCalculator::SwitchFlipCalculator (uint32_t ploidy, double switchCost, double flipCost) :
+SwitchFlipCalculator::SwitchFlipCalculator (uint32_t ploidy, double switchCost, double flipCost, uint32_t threads) :
     ploidy(ploidy),
     switchCost(switchCost),
-    flipCost(flipCost)
+    flipCost(flipCost),
+    threads(std::max(1U, threads))
 {
+    permutations = getPermutations();
+    
+    // precompute the switch distances between all pairs of permutations for small ploidies
+    if (ploidy <= MAX_TABLE_PLOIDY) {
+        uint32_t numPerms = permutations.size();
+        switchTable.resize(numPerms * numPerms);
+        for (uint32_t i = 0; i < numPerms; i++) {
+            for (uint32_t j = 0; j < numPerms; j++) {
+                switchTable[i * numPerms + j] = (uint8_t)getNumSwitches(permutations[i], permutations[j]);
+            }
+        }
+    }
 }
 
 std::pair<Score, Score> SwitchFlipCalculator::compare (const std::vector<std::vector<uint32_t>>& phasing0,
@@ -21,88 +40,165 @@ std::pair<Score, Score> SwitchFlipCalculator::compare (const std::vector<std::ve
                     std::vector<std::vector<uint32_t>>& flippedHapsInColumn,
                     std::vector<std::vector<uint32_t>>& permInColumn
                     ) const {
+    return computeComparison(phasing0, phasing1, switchesInColumn, flippedHapsInColumn, permInColumn, threads);
+}
+
+std::vector<std::pair<Score, Score>> SwitchFlipCalculator::compareBlocks (const std::vector<std::vector<std::vector<uint32_t>>>& phasings0,
+                    const std::vector<std::vector<std::vector<uint32_t>>>& phasings1
+                    ) const {
+    uint32_t numBlocks = phasings0.size();
+    std::vector<std::pair<Score, Score>> results(numBlocks);
+    
+    // start with the longest blocks
+    std::vector<std::pair<uint64_t, uint32_t>> jobs;
+    for (uint32_t b = 0; b < numBlocks; b++) {
+        jobs.push_back(std::pair<uint64_t, uint32_t>(phasings0[b].size(), b));
+    }
+    std::stable_sort(jobs.begin(), jobs.end(), [](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b) {
+        return a.first > b.first;
+    });
+    
+    // blocks are compared in parallel, so each gets its share of threads for its own columns
+    uint32_t blockThreads = std::max(1U, threads / std::max(1U, numBlocks));
+    uint32_t numWorkers = std::min(threads, numBlocks);
+    auto compareJob = [&](uint32_t b) {
+        std::vector<uint32_t> switchesInColumn;
+        std::vector<std::vector<uint32_t>> flippedHapsInColumn;
+        std::vector<std::vector<uint32_t>> permInColumn;
+        results[b] = computeComparison(phasings0[b], phasings1[b], switchesInColumn, flippedHapsInColumn, permInColumn, blockThreads);
+    };
+    if (numWorkers <= 1) {
+        for (const std::pair<uint64_t, uint32_t>& job : jobs)
+            compareJob(job.second);
+        return results;
+    }
+    
+    std::atomic<uint32_t> nextJob(0);
+    std::vector<std::exception_ptr> errors(numWorkers);
+    std::vector<std::thread> workers;
+    for (uint32_t w = 0; w < numWorkers; w++) {
+        workers.emplace_back([&, w]() {
+            try {
+                for (uint32_t j = nextJob++; j < numBlocks; j = nextJob++) {
+                    compareJob(jobs[j].second);
+                }
+            } catch (...) {
+                errors[w] = std::current_exception();
+                nextJob = numBlocks;
+            }
+        });
+    }
+    for (std::thread& worker : workers)
+        worker.join();
+    for (std::exception_ptr& error : errors)
+        if (error)
+            std::rethrow_exception(error);
+    
+    return results;
+}
+
+std::pair<Score, Score> SwitchFlipCalculator::computeComparison (const std::vector<std::vector<uint32_t>>& phasing0,
+                    const std::vector<std::vector<uint32_t>>& phasing1,
+                    std::vector<uint32_t>& switchesInColumn,
+                    std::vector<std::vector<uint32_t>>& flippedHapsInColumn,
+                    std::vector<std::vector<uint32_t>>& permInColumn,
+                    const uint32_t blockThreads
+                    ) const {
     
-    // setup data structures
-    std::vector<std::unordered_map<Permutation, PermutationEntry>> m;
-    std::vector<Permutation> permutations = getPermutations();
+    // setup data structures: for every column, the indices of all kept permutations (ascending) and their predecessors
+    uint32_t numPerms = permutations.size();
     Position numVars = phasing0.size();
+    std::vector<std::vector<uint32_t>> keptRows(numVars);
+    std::vector<std::vector<uint32_t>> keptPreds(numVars);
+    std::vector<Score> column(numPerms);
 
     // initialize first column
-    std::unordered_map<Permutation, PermutationEntry> column;
-    Score minimumInColumn = std::numeric_limits<Score>::infinity();
-    Permutation minimumPermInColumn = Permutation::INVALID;
-    Permutation minimumPredPermInColumn = Permutation::INVALID;
-    uint32_t allEntries = 0;
-    uint32_t keptEntries = 0;
-    for (Permutation p : permutations) {
-        column[p] = PermutationEntry(this->flipCost * getNumFlips(p, phasing0[0], phasing1[0]), Permutation::INVALID);
-        if (column[p].score < minimumInColumn) {
-            minimumInColumn = column[p].score;
-            minimumPermInColumn = p;
-        }
+    for (uint32_t r = 0; r < numPerms; r++) {
+        column[r] = this->flipCost * getNumFlips(permutations[r], phasing0[0], phasing1[0]);
+        keptRows[0].push_back(r);
+        keptPreds[0].push_back(NO_PRED);
     }
     
-    m.push_back(std::unordered_map<Permutation, PermutationEntry>(column.begin(), column.end()));
-    allEntries += permutations.size();
-    keptEntries += column.size();
+    // a predecessor can only improve a row, if its own score is not larger than the current minimum of the row
+    bool sortedCutoff = switchCost >= 0.0;
+    std::vector<std::pair<Score, uint32_t>> preds;
+    std::vector<Score> rowMinimum(numPerms);
+    std::vector<uint32_t> rowPred(numPerms);
+    std::vector<Score> rowFlipCost(numPerms);
     
     // iterate over positions
     for (Position pos = 1; pos < numVars; pos++) {
         
-        // reset variables
-        column.clear();
-        Score minimum = std::numeric_limits<Score>::infinity();
-        Permutation minimumPred = Permutation::INVALID;
-        bool minExists = false;
-        minimumInColumn = std::numeric_limits<Score>::infinity();
-        minimumPermInColumn = Permutation::INVALID;
-        minimumPredPermInColumn = Permutation::INVALID;
+        // collect predecessors, which can be part of a finite path, ordered by score and index
+        preds.clear();
+        for (uint32_t p : keptRows[pos-1]) {
+            if (column[p] < std::numeric_limits<Score>::infinity()) {
+                preds.push_back(std::pair<Score, uint32_t>(column[p], p));
+            }
+        }
+        std::sort(preds.begin(), preds.end());
         
-        // iterate over rows
-        for (Permutation rowPerm : permutations) {
-            minimum = std::numeric_limits<Score>::infinity();
-            minimumPred = Permutation::INVALID;
-            
-            // iterate over previous rows
-            for (std::pair<Permutation, PermutationEntry> predEntry : m[pos-1]) {
-                Score s = predEntry.second.score + switchCost * getNumSwitches(rowPerm, predEntry.first);
-                if (s < minimum) {
-                    minExists = true;
-                    minimum = s;
-                    minimumPred = predEntry.first;
+        // find the best predecessor of every row in [begin, end). Ties are broken by the smallest predecessor index.
+        auto computeRows = [&](uint32_t begin, uint32_t end) {
+            for (uint32_t r = begin; r < end; r++) {
+                Score minimum = std::numeric_limits<Score>::infinity();
+                uint32_t minimumPred = NO_PRED;
+                for (const std::pair<Score, uint32_t>& pred : preds) {
+                    if (sortedCutoff && pred.first > minimum)
+                        break;
+                    Score s = pred.first + switchCost * getNumSwitches(r, pred.second);
+                    if (s < minimum || (s == minimum && minimumPred != NO_PRED && pred.second < minimumPred)) {
+                        minimum = s;
+                        minimumPred = pred.second;
+                    }
                 }
+                rowMinimum[r] = minimum;
+                rowPred[r] = minimumPred;
+                rowFlipCost[r] = this->flipCost * getNumFlips(permutations[r], phasing0[pos], phasing1[pos]);
             }
-            
-            Score flipCost = this->flipCost * getNumFlips(rowPerm, phasing0[pos], phasing1[pos]);
-            
-            // report best recursion
-            if (minExists) {
-                column[rowPerm] = PermutationEntry(minimum + flipCost, minimumPred);
-            } else {
-                column[rowPerm] = PermutationEntry(flipCost, Permutation::INVALID);
+        };
+        
+        // split the rows among threads if the column is large enough
+        uint32_t numThreads = std::min(blockThreads, numPerms);
+        if (numThreads > 1 && (uint64_t)numPerms * preds.size() >= MIN_PARALLEL_TRANSITIONS) {
+            std::vector<std::thread> workers;
+            for (uint32_t t = 1; t < numThreads; t++) {
+                workers.emplace_back(computeRows, (uint64_t)numPerms * t / numThreads, (uint64_t)numPerms * (t + 1) / numThreads);
             }
-            if (column[rowPerm].score < minimumInColumn) {
-                minimumInColumn = column[rowPerm].score;
-                minimumPermInColumn = rowPerm;
-                minimumPredPermInColumn = minimumPred;
+            computeRows(0, numPerms / numThreads);
+            for (std::thread& worker : workers)
+                worker.join();
+        } else {
+            computeRows(0, numPerms);
+        }
+        
+        // report best recursions. Once a predecessor was found for some row, rows without one keep an infinite score.
+        bool minExists = false;
+        Score minimumInColumn = std::numeric_limits<Score>::infinity();
+        for (uint32_t r = 0; r < numPerms; r++) {
+            minExists |= rowPred[r] != NO_PRED;
+            column[r] = minExists ? rowMinimum[r] + rowFlipCost[r] : rowFlipCost[r];
+            if (column[r] < minimumInColumn) {
+                minimumInColumn = column[r];
             }
         }
         
         // remove non-profitable entries
-        std::vector<Permutation> profitableTuples;
-        std::vector<Permutation> openTuples;
-        for (Permutation t : permutations) {
-            if (column[t].score <= minimumInColumn) {
+        std::vector<uint32_t> profitableTuples;
+        std::vector<uint32_t> openTuples;
+        std::vector<bool> kept(numPerms, true);
+        for (uint32_t t = 0; t < numPerms; t++) {
+            if (column[t] <= minimumInColumn) {
                 profitableTuples.push_back(t);
             } else {
                 openTuples.push_back(t);
             }
         }
         
-        for (Permutation t : openTuples) {
+        for (uint32_t t : openTuples) {
             bool profitable = true;
-            for (Permutation p : profitableTuples) {
-                if (column[t].score >= column[p].score + switchCost * getNumSwitches(t, p)) {
+            for (uint32_t p : profitableTuples) {
+                if (column[t] >= column[p] + switchCost * getNumSwitches(t, p)) {
                     profitable = false;
                     break;
                 }
@@ -112,37 +208,52 @@ std::pair<Score, Score> SwitchFlipCalculator::compare (const std::vector<std::ve
                     profitableTuples.push_back(t);
                 }
             } else {
-                column.erase(t);
+                kept[t] = false;
             }
         }
         
-        // write column into dp table(s)
-        m.push_back(std::unordered_map<Permutation, PermutationEntry>(column.begin(), column.end()));
-        allEntries += permutations.size();
-        keptEntries += column.size();
+        // write column into dp table
+        for (uint32_t r = 0; r < numPerms; r++) {
+            if (kept[r]) {
+                keptRows[pos].push_back(r);
+                keptPreds[pos].push_back(rowPred[r]);
+            }
+        }
     }
     
+    // returns the predecessor of a row in a column (none, if the row was not kept)
+    auto predOf = [&](Position pos, uint32_t row) {
+        if (row == NO_PRED)
+            return NO_PRED;
+        auto it = std::lower_bound(keptRows[pos].begin(), keptRows[pos].end(), row);
+        if (it == keptRows[pos].end() || *it != row)
+            return NO_PRED;
+        return keptPreds[pos][it - keptRows[pos].begin()];
+    };
+    auto asPermutation = [&](uint32_t row) {
+        return row == NO_PRED ? Permutation::INVALID : permutations[row];
+    };
+    
     // backtracking start
     Score flips = 0.0;
     Score switches = 0.0;
-    Permutation currentRow = Permutation::INVALID;
+    uint32_t currentRow = NO_PRED;
     Score minimum = std::numeric_limits<Score>::infinity();
-    for (std::pair<Permutation, PermutationEntry> entry : m[numVars-1]) {
-        if (entry.second.score < minimum) {
-            minimum = entry.second.score;
-            currentRow = entry.first;
+    for (uint32_t r : keptRows[numVars-1]) {
+        if (column[r] < minimum) {
+            minimum = column[r];
+            currentRow = r;
         }
     }
-    if (currentRow == Permutation::INVALID) {
+    if (currentRow == NO_PRED) {
         std::cout<<"No minimum at end of compared block!"<<std::endl;
         return std::pair<Score, Score>(std::numeric_limits<Score>::infinity(), std::numeric_limits<Score>::infinity());
     } else {
-        if (currentRow.asVector(ploidy).size() == 0)
-            std::cout<<"Problem occured at variant "<<(numVars-1)<<" in row "<<currentRow.asString(ploidy)<<std::endl;
-        permInColumn.push_back(currentRow.asVector(ploidy));
-        Score localFlips = getNumFlips(currentRow, phasing0[numVars-1], phasing1[numVars-1]);
-        Score localSwitches = getNumSwitches(currentRow, m[numVars-1][currentRow].pred);
-        std::vector<uint32_t> localFlippedHaps = getFlippedHaps(currentRow, phasing0[numVars-1], phasing1[numVars-1]);
+        Permutation current = asPermutation(currentRow);
+        permInColumn.push_back(current.asVector(ploidy));
+        Score localFlips = getNumFlips(current, phasing0[numVars-1], phasing1[numVars-1]);
+        Score localSwitches = getNumSwitches(current, asPermutation(predOf(numVars-1, currentRow)));
+        std::vector<uint32_t> localFlippedHaps = getFlippedHaps(current, phasing0[numVars-1], phasing1[numVars-1]);
         flippedHapsInColumn.push_back(localFlippedHaps);
         switchesInColumn.push_back(localSwitches);
         flips += localFlips;
@@ -151,20 +262,16 @@ std::pair<Score, Score> SwitchFlipCalculator::compare (const std::vector<std::ve
     
     // backtracking iteration
     for (Position pos = numVars-2; pos < numVars; pos--) {
-        currentRow = m[pos+1][currentRow].pred;
-        if (currentRow.asVector(ploidy).size() == 0) {
-            std::cout<<"Problem occured at variant "<<(pos)<<" in row "<<currentRow.asString(ploidy)<<std::endl;
-            return std::pair<Score, Score>(std::numeric_limits<Score>::infinity(), std::numeric_limits<Score>::infinity());
-        } else {
-            permInColumn.push_back(currentRow.asVector(ploidy));
-            Score localFlips = getNumFlips(currentRow, phasing0[pos], phasing1[pos]);
-            Score localSwitches = pos == 0 ? 0.0 : getNumSwitches(currentRow, m[pos][currentRow].pred);
-            std::vector<uint32_t> localFlippedHaps = getFlippedHaps(currentRow, phasing0[pos], phasing1[pos]);
-            flippedHapsInColumn.push_back(localFlippedHaps);
-            switchesInColumn.push_back(localSwitches);
-            flips += localFlips;
-            switches += localSwitches;
-        }
+        currentRow = predOf(pos+1, currentRow);
+        Permutation current = asPermutation(currentRow);
+        permInColumn.push_back(current.asVector(ploidy));
+        Score localFlips = getNumFlips(current, phasing0[pos], phasing1[pos]);
+        Score localSwitches = pos == 0 ? 0.0 : getNumSwitches(current, asPermutation(predOf(pos, currentRow)));
+        std::vector<uint32_t> localFlippedHaps = getFlippedHaps(current, phasing0[pos], phasing1[pos]);
+        flippedHapsInColumn.push_back(localFlippedHaps);
+        switchesInColumn.push_back(localSwitches);
+        flips += localFlips;
+        switches += localSwitches;
     }
     
     // reverse as we constructed it back to front
@@ -205,6 +312,13 @@ Score SwitchFlipCalculator::getNumSwitches(const Permutation p1, const Permutati
     return StaticSparseGraph::popcount(y);
 }
 
+Score SwitchFlipCalculator::getNumSwitches(const uint32_t i, const uint32_t j) const {
+    if (!switchTable.empty()) {
+        return (Score)switchTable[i * permutations.size() + j];
+    }
+    return getNumSwitches(permutations[i], permutations[j]);
+}
+
 std::vector<Permutation> SwitchFlipCalculator::getPermutations() const {        
     std::vector<Permutation> perms;
     Haplotype curPerm[ploidy];
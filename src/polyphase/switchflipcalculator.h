@@ -9,6 +9,7 @@
 #include <sstream>
 #include <algorithm>
 #include <limits>
+#include <cstdint>
 
 typedef uint32_t Position;
 typedef uint32_t Haplotype;
@@ -147,31 +148,6 @@ namespace std {
     };
 }
 
-struct PermutationEntry {
-    Score score;
-    Permutation pred;
-    
-    PermutationEntry() :
-    score(std::numeric_limits<Score>::infinity()), pred(Permutation::INVALID) {}
-    
-    PermutationEntry(const Score score, const Permutation pred) :
-    score(score),
-    pred(pred){}
-    
-    PermutationEntry(const PermutationEntry& other) {
-        pred = other.pred;
-        score = other.score;
-    }
-    
-    bool operator==(const PermutationEntry& other) const {
-        return pred == other.pred && score == other.score;
-    }
-    
-    bool operator!=(const PermutationEntry& other) const {
-        return pred != other.pred || score != other.score;
-    }
-};
-
 /**
  * ===
  * 
@@ -190,9 +166,10 @@ public:
      * @param ploidy The number of paths, which have to be threaded through the clusters
      * @param switchCost The factor how much a single cluster switches is penalized over a wrong copy number of a cluster (compared to its coverage)
      * @param flipCost The factor how much a single cluster switches is penalized over a wrong copy number of a cluster (compared to its coverage)
-     * @param affineSwitchCost Penalty for a position, in which a cluster switch occurs
+     * @param threads Maximum number of threads. Blocks are compared concurrently, and the rows of large DP columns are split among
+     * the threads of a block. The results do not depend on the number of threads.
      */
-    SwitchFlipCalculator (uint32_t ploidy, double switchCost, double flipCost);
+    SwitchFlipCalculator (uint32_t ploidy, double switchCost, double flipCost, uint32_t threads = 1);
     
     /**
      * Computes a number of paths (depending on the provided ploidy), which run through the provided clusters. For each variant the result
@@ -208,11 +185,47 @@ public:
                     std::vector<std::vector<uint32_t>>& flippedHapsInColumn,
                     std::vector<std::vector<uint32_t>>& permInColumn
                     ) const;
+    
+    /**
+     * Compares a number of independent blocks (same as calling compare on each of them) and returns the numbers of switches and
+     * flips for every block (in the given order).
+     * 
+     * @param phasings0 For every block, the position-wise phasing of the first haplotype set
+     * @param phasings1 For every block, the position-wise phasing of the second haplotype set
+     */
+    std::vector<std::pair<Score, Score>> compareBlocks (const std::vector<std::vector<std::vector<uint32_t>>>& phasings0,
+                    const std::vector<std::vector<std::vector<uint32_t>>>& phasings1
+                    ) const;
 
 private:
+    // up to this ploidy, the switch distance between all pairs of permutations is precomputed (720 x 720 entries for hexaploids)
+    static const uint32_t MAX_TABLE_PLOIDY = 6;
+    // minimum number of transitions in a DP column to split its rows among several threads
+    static const uint64_t MIN_PARALLEL_TRANSITIONS = 1 << 16;
+    static const uint32_t NO_PRED = std::numeric_limits<uint32_t>::max();
+    
     uint32_t ploidy;
     double switchCost;
     double flipCost;
+    uint32_t threads;
+    
+    // all permutations in lexicographic order. Inside the DP, permutations are addressed by their index in this vector.
+    std::vector<Permutation> permutations;
+    
+    // for two permutation indices i and j, the number of switches between them at index i * permutations.size() + j. The number of
+    // switches is the number of haplotypes, which are not fixed by the composition of the inverse of one with the other.
+    std::vector<uint8_t> switchTable;
+    
+    /**
+     * Runs the comparison using the given number of threads for each DP column.
+     */
+    std::pair<Score, Score> computeComparison (const std::vector<std::vector<uint32_t>>& phasing0,
+                    const std::vector<std::vector<uint32_t>>& phasing1,
+                    std::vector<uint32_t>& switchesInColumn,
+                    std::vector<std::vector<uint32_t>>& flippedHapsInColumn,
+                    std::vector<std::vector<uint32_t>>& permInColumn,
+                    const uint32_t blockThreads
+                    ) const;
     
     /**
      * Computes the coverage cost of a tuple, considering the following coverage distribution. All cluster
@@ -232,6 +245,11 @@ private:
      */
     Score getNumSwitches(const Permutation p1, const Permutation p2) const;
     
+    /**
+     * Same as getNumSwitches, but for two permutation indices. Uses the precomputed table, if present.
+     */
+    Score getNumSwitches(const uint32_t i, const uint32_t j) const;
+    
     /**
      * Computes all permutations as tuples.
      */
@@ -0,0 +1,430 @@
+#include "threadingpreprocessor.h"
+#include <algorithm>
+
+ThreadingPreprocessor::ThreadingPreprocessor(const ReadSet* readset, const std::vector<std::vector<uint32_t>>& clustering, uint32_t ploidy) :
+    ploidy(ploidy)
+{
+    std::vector<unsigned int>* positions = readset->get_positions();
+    genomePositions.assign(positions->begin(), positions->end());
+    delete positions;
+
+    computeCoverage(readset, clustering);
+    computeCovMap();
+    computeConsensus(readset, clustering);
+    computeSimilarity();
+}
+
+Position ThreadingPreprocessor::getNumPositions() const {
+    return genomePositions.size();
+}
+
+const std::vector<uint32_t>& ThreadingPreprocessor::getGenomePositions() const {
+    return genomePositions;
+}
+
+const std::vector<Position>& ThreadingPreprocessor::getClusterStarts() const {
+    return clusterStarts;
+}
+
+const std::vector<Position>& ThreadingPreprocessor::getClusterEnds() const {
+    return clusterEnds;
+}
+
+const std::vector<std::vector<GlobalClusterId>>& ThreadingPreprocessor::getCoveringClusters() const {
+    return coveringClusters;
+}
+
+const std::vector<std::vector<uint32_t>>& ThreadingPreprocessor::getAbsoluteCoverage() const {
+    return absoluteCoverage;
+}
+
+const std::vector<std::vector<GlobalClusterId>>& ThreadingPreprocessor::getCovMap() const {
+    return covMap;
+}
+
+const std::vector<std::vector<double>>& ThreadingPreprocessor::getCompressedCoverage() const {
+    return compressedCoverage;
+}
+
+const std::vector<std::vector<uint32_t>>& ThreadingPreprocessor::getCompressedConsensus() const {
+    return compressedConsensus;
+}
+
+const std::vector<std::vector<double>>& ThreadingPreprocessor::getConsensusFraction() const {
+    return consensusFraction;
+}
+
+std::vector<Position> ThreadingPreprocessor::getIndependentStarts() const {
+    std::vector<Position> starts(1, 0);
+    for (Position pos = 1; pos < covMap.size(); pos++) {
+        bool shared = false;
+        for (GlobalClusterId c : covMap[pos]) {
+            if (localIndex(pos - 1, c) < covMap[pos - 1].size()) {
+                shared = true;
+                break;
+            }
+        }
+        if (!shared)
+            starts.push_back(pos);
+    }
+    return starts;
+}
+
+double ThreadingPreprocessor::getSimilarity(Position pos, GlobalClusterId c1, GlobalClusterId c2) const {
+    if (pos == 0 || pos >= covMap.size())
+        return 0.0;
+    uint32_t i = localIndex(pos - 1, c1);
+    uint32_t j = localIndex(pos, c2);
+    if (i >= covMap[pos - 1].size() || j >= covMap[pos].size())
+        return 0.0;
+    return similarity[similarityOffset[pos] + i * covMap[pos].size() + j];
+}
+
+uint32_t ThreadingPreprocessor::localIndex(Position pos, GlobalClusterId c) const {
+    const std::vector<GlobalClusterId>& clusters = covMap[pos];
+    uint32_t i = 0;
+    while (i < clusters.size() && clusters[i] != c)
+        i++;
+    return i;
+}
+
+void ThreadingPreprocessor::computeCoverage(const ReadSet* readset, const std::vector<std::vector<uint32_t>>& clustering) {
+    Position numPositions = genomePositions.size();
+    coveringClusters.assign(numPositions, std::vector<GlobalClusterId>());
+    absoluteCoverage.assign(numPositions, std::vector<uint32_t>());
+    clusterStarts.assign(clustering.size(), numPositions);
+    clusterEnds.assign(clustering.size(), 0);
+
+    // clusters are processed in ascending order, so the covering clusters of every position are sorted
+    for (GlobalClusterId c = 0; c < clustering.size(); c++) {
+        for (uint32_t readId : clustering[c]) {
+            const Read* read = readset->get(readId);
+            for (int k = 0; k < read->getVariantCount(); k++) {
+                Position pos = std::lower_bound(genomePositions.begin(), genomePositions.end(),
+                                                (uint32_t)read->getPosition(k)) - genomePositions.begin();
+                if (coveringClusters[pos].empty() || coveringClusters[pos].back() != c) {
+                    coveringClusters[pos].push_back(c);
+                    absoluteCoverage[pos].push_back(0);
+                }
+                absoluteCoverage[pos].back()++;
+                clusterStarts[c] = std::min(clusterStarts[c], pos);
+                clusterEnds[c] = std::max(clusterEnds[c], pos);
+            }
+        }
+    }
+}
+
+void ThreadingPreprocessor::computeCovMap() {
+    Position numPositions = genomePositions.size();
+    covMap.assign(numPositions, std::vector<GlobalClusterId>());
+    compressedCoverage.assign(numPositions, std::vector<double>());
+
+    for (Position pos = 0; pos < numPositions; pos++) {
+        const std::vector<uint32_t>& counts = absoluteCoverage[pos];
+        uint32_t sum = 0;
+        for (uint32_t count : counts)
+            sum += count;
+
+        // stable sort keeps clusters with equal coverage in ascending order
+        std::vector<uint32_t> order(counts.size());
+        for (uint32_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&counts](uint32_t a, uint32_t b) { return counts[a] > counts[b]; });
+
+        uint32_t cutOff = std::min((uint32_t)order.size(), 2 * ploidy);
+        for (uint32_t i = ploidy; i < cutOff; i++) {
+            if ((double)counts[order[i]] / sum < 1.0 / (8.0 * ploidy)) {
+                cutOff = i;
+                break;
+            }
+        }
+        for (uint32_t i = 0; i < cutOff; i++) {
+            covMap[pos].push_back(coveringClusters[pos][order[i]]);
+            compressedCoverage[pos].push_back((double)counts[order[i]] / sum);
+        }
+    }
+}
+
+void ThreadingPreprocessor::computeConsensus(const ReadSet* readset, const std::vector<std::vector<uint32_t>>& clustering) {
+    Position numPositions = genomePositions.size();
+
+    // count alleles for every cluster in the coverage maps as (allele, count) pairs
+    std::vector<std::vector<std::vector<std::pair<int, uint32_t>>>> alleleCounts(numPositions);
+    for (Position pos = 0; pos < numPositions; pos++)
+        alleleCounts[pos].resize(covMap[pos].size());
+
+    for (GlobalClusterId c = 0; c < clustering.size(); c++) {
+        for (uint32_t readId : clustering[c]) {
+            const Read* read = readset->get(readId);
+            for (int k = 0; k < read->getVariantCount(); k++) {
+                Position pos = std::lower_bound(genomePositions.begin(), genomePositions.end(),
+                                                (uint32_t)read->getPosition(k)) - genomePositions.begin();
+                uint32_t i = localIndex(pos, c);
+                if (i >= covMap[pos].size())
+                    continue;
+                std::vector<std::pair<int, uint32_t>>& counts = alleleCounts[pos][i];
+                int allele = read->getAllele(k);
+                uint32_t a = 0;
+                while (a < counts.size() && counts[a].first != allele)
+                    a++;
+                if (a == counts.size())
+                    counts.push_back(std::pair<int, uint32_t>(allele, 0));
+                counts[a].second++;
+            }
+        }
+    }
+
+    // majority allele, ties are resolved towards the smaller allele
+    compressedConsensus.assign(numPositions, std::vector<uint32_t>());
+    consensusFraction.assign(numPositions, std::vector<double>());
+    for (Position pos = 0; pos < numPositions; pos++) {
+        for (std::vector<std::pair<int, uint32_t>>& counts : alleleCounts[pos]) {
+            if (counts.empty()) {
+                compressedConsensus[pos].push_back(0);
+                consensusFraction[pos].push_back(1.0);
+                continue;
+            }
+            std::sort(counts.begin(), counts.end());
+            int maxAllele = 0;
+            uint32_t maxCount = 0;
+            uint32_t sumCount = 0;
+            for (const std::pair<int, uint32_t>& count : counts) {
+                sumCount += count.second;
+                if (count.second > maxCount) {
+                    maxAllele = count.first;
+                    maxCount = count.second;
+                }
+            }
+            compressedConsensus[pos].push_back(maxAllele);
+            consensusFraction[pos].push_back((double)maxCount / sumCount);
+        }
+    }
+}
+
+void ThreadingPreprocessor::computeSimilarity() {
+    Position numPositions = genomePositions.size();
+
+    // weigh the consensus of every cluster in the coverage maps with its absolute coverage
+    std::vector<std::vector<int64_t>> zeroes(numPositions);
+    std::vector<std::vector<int64_t>> ones(numPositions);
+    for (Position pos = 0; pos < numPositions; pos++) {
+        for (uint32_t i = 0; i < covMap[pos].size(); i++) {
+            GlobalClusterId c = covMap[pos][i];
+            uint32_t k = std::lower_bound(coveringClusters[pos].begin(), coveringClusters[pos].end(), c) - coveringClusters[pos].begin();
+            int64_t abs = absoluteCoverage[pos][k];
+            int64_t allele = (int32_t)compressedConsensus[pos][i];
+            zeroes[pos].push_back(abs * (1 - allele));
+            ones[pos].push_back(abs * allele);
+        }
+    }
+
+    similarityOffset.assign(numPositions + 1, 0);
+    for (Position var = 1; var < numPositions; var++)
+        similarityOffset[var + 1] = similarityOffset[var] + covMap[var - 1].size() * covMap[var].size();
+    similarity.assign(similarityOffset[numPositions], 0.0);
+
+    std::vector<uint32_t> window1;
+    std::vector<uint32_t> window2;
+    for (Position var = 1; var < numPositions; var++) {
+        Position first = var >= SIMILARITY_WINDOW ? var - SIMILARITY_WINDOW : 0;
+        Position last = std::min(numPositions - 1, var + SIMILARITY_WINDOW - 1);
+        for (uint32_t i = 0; i < covMap[var - 1].size(); i++) {
+            // local indices of both clusters on the window positions
+            window1.clear();
+            for (Position pos = first; pos < last; pos++)
+                window1.push_back(localIndex(pos, covMap[var - 1][i]));
+            for (uint32_t j = 0; j < covMap[var].size(); j++) {
+                window2.clear();
+                for (Position pos = first; pos < last; pos++)
+                    window2.push_back(localIndex(pos, covMap[var][j]));
+                int64_t same = 0;
+                int64_t diff = 0;
+                for (Position pos = first; pos < last; pos++) {
+                    uint32_t i1 = window1[pos - first];
+                    uint32_t i2 = window2[pos - first];
+                    if (i1 < covMap[pos].size() && i2 < covMap[pos].size()) {
+                        same += zeroes[pos][i1] * zeroes[pos][i2] + ones[pos][i1] * ones[pos][i2];
+                        diff += zeroes[pos][i1] * ones[pos][i2] + ones[pos][i1] * zeroes[pos][i2];
+                    }
+                }
+                similarity[similarityOffset[var] + i * covMap[var].size() + j] = same > 0 ? (double)same / (same + diff) : 0.0;
+            }
+        }
+    }
+}
+
+std::vector<uint32_t> ThreadingPreprocessor::findBestPermutation(const std::vector<double>& scores, uint32_t n) const {
+    std::vector<uint32_t> perm(n);
+    for (uint32_t j = 0; j < n; j++)
+        perm[j] = j;
+    std::vector<uint32_t> bestPerm = perm;
+    double bestScore = 0.0;
+    for (uint32_t j = 0; j < n; j++)
+        bestScore += scores[j * n + j];
+
+    // permutations are enumerated in lexicographic order, the first one with the highest score wins
+    while (std::next_permutation(perm.begin(), perm.end())) {
+        double score = 0.0;
+        for (uint32_t j = 0; j < n; j++)
+            score += scores[j * n + perm[j]];
+        if (score > bestScore) {
+            bestScore = score;
+            bestPerm = perm;
+        }
+    }
+    return bestPerm;
+}
+
+std::vector<std::vector<GlobalClusterId>> ThreadingPreprocessor::improvePathOnMultiswitches(const std::vector<std::vector<GlobalClusterId>>& path) const {
+    std::vector<std::vector<GlobalClusterId>> correctedPath;
+    if (path.size() == 0)
+        return correctedPath;
+
+    correctedPath.push_back(path[0]);
+    uint32_t numHaps = path[0].size();
+    std::vector<uint32_t> currentPerm(numHaps);
+    std::vector<uint32_t> inversePerm(numHaps);
+    for (uint32_t j = 0; j < numHaps; j++) {
+        currentPerm[j] = j;
+        inversePerm[j] = j;
+    }
+
+    for (Position i = 1; i < path.size(); i++) {
+        // haplotypes, which changed cluster at current position
+        std::vector<uint32_t> changed;
+        for (uint32_t j = 0; j < numHaps; j++)
+            if (path[i - 1][j] != path[i][j])
+                changed.push_back(j);
+
+        if (changed.size() >= 2) {
+            // if at least two threads changed cluster: find optimal permutation of changed clusters
+            uint32_t n = changed.size();
+            std::vector<double> scores(n * n);
+            for (uint32_t j = 0; j < n; j++)
+                for (uint32_t k = 0; k < n; k++)
+                    scores[j * n + k] = getSimilarity(i, path[i - 1][changed[j]], path[i][changed[k]]);
+            std::vector<uint32_t> bestPerm = findBestPermutation(scores, n);
+
+            // apply local best permutation to current global permutation
+            std::vector<uint32_t> currentPermCopy = currentPerm;
+            for (uint32_t j = 0; j < n; j++)
+                currentPermCopy[changed[j]] = currentPerm[changed[bestPerm[j]]];
+            currentPerm = currentPermCopy;
+            for (uint32_t j = 0; j < numHaps; j++)
+                inversePerm[currentPerm[j]] = j;
+        }
+
+        // apply current optimal permutation to local cluster config and add to corrected path
+        std::vector<GlobalClusterId> tuple(numHaps);
+        for (uint32_t j = 0; j < numHaps; j++)
+            tuple[j] = path[i][inversePerm[j]];
+        correctedPath.push_back(tuple);
+    }
+
+    return correctedPath;
+}
+
+std::vector<std::vector<GlobalClusterId>> ThreadingPreprocessor::improvePathOnCollapsedswitches(const std::vector<std::vector<GlobalClusterId>>& path) const {
+    std::vector<std::vector<GlobalClusterId>> correctedPath;
+    if (path.size() == 0)
+        return correctedPath;
+
+    correctedPath.push_back(path[0]);
+    uint32_t numHaps = path[0].size();
+    std::vector<uint32_t> currentPerm(numHaps);
+    std::vector<uint32_t> inversePerm(numHaps);
+    for (uint32_t j = 0; j < numHaps; j++) {
+        currentPerm[j] = j;
+        inversePerm[j] = j;
+    }
+
+    for (Position i = 1; i < path.size(); i++) {
+        // present cluster ids in order of first occurrence
+        std::vector<GlobalClusterId> present;
+        for (uint32_t j = 0; j < numHaps; j++)
+            if (std::find(present.begin(), present.end(), path[i][j]) == present.end())
+                present.push_back(path[i][j]);
+
+        std::vector<std::vector<uint32_t>> changed;
+        for (GlobalClusterId c : present) {
+            if (std::count(path[i - 1].begin(), path[i - 1].end(), c) >= 2) {
+                // for all collapsed clusters: find haplotypes, which go through and check whether one of them exits
+                bool outgoing = false;
+                std::vector<uint32_t> affected;
+                for (uint32_t j = 0; j < numHaps; j++) {
+                    if (path[i - 1][j] == c) {
+                        affected.push_back(j);
+                        if (path[i][j] != c)
+                            outgoing = true;
+                    }
+                }
+                // if haplotypes leaves collapsed cluster, all other might be equally suited, so add them
+                if (outgoing)
+                    changed.push_back(affected);
+            }
+        }
+
+        for (const std::vector<uint32_t>& hGroup : changed) {
+            // for every group of haplotypes coming from a collapsed cluster:
+            uint32_t n = hGroup.size();
+            GlobalClusterId collapsed = path[i - 1][hGroup[0]];
+
+            // find last cluster before collapsed one for every haplotype (or use collapsed one if this does not exist)
+            std::vector<GlobalClusterId> left;
+            std::vector<GlobalClusterId> right;
+            for (uint32_t j : hGroup) {
+                int64_t pos = i - 1;
+                while (pos >= 0 && path[pos][j] == collapsed)
+                    pos--;
+                left.push_back(pos >= 0 ? path[pos][j] : collapsed);
+                right.push_back(path[i][j]);
+            }
+
+            // we need to catch the case, where we compare a cluster with itself
+            double identSim = 0.0;
+            for (GlobalClusterId c1 : left)
+                for (GlobalClusterId c2 : right)
+                    if (c1 != c2)
+                        identSim = std::max(identSim, getSimilarity(i, c1, c2));
+            identSim = identSim * 2 + 1;
+
+            std::vector<double> scores(n * n);
+            for (uint32_t j = 0; j < n; j++)
+                for (uint32_t k = 0; k < n; k++)
+                    scores[j * n + k] = left[j] != right[k] ? getSimilarity(i, left[j], right[k]) : identSim;
+            std::vector<uint32_t> bestPerm = findBestPermutation(scores, n);
+
+            // apply local best permutation to current global permutation
+            std::vector<uint32_t> currentPermCopy = currentPerm;
+            for (uint32_t j = 0; j < n; j++)
+                currentPermCopy[hGroup[j]] = currentPerm[hGroup[bestPerm[j]]];
+            currentPerm = currentPermCopy;
+            for (uint32_t j = 0; j < numHaps; j++)
+                inversePerm[currentPerm[j]] = j;
+        }
+
+        // apply current optimal permutation to local cluster config and add to corrected path
+        std::vector<GlobalClusterId> tuple(numHaps);
+        for (uint32_t j = 0; j < numHaps; j++)
+            tuple[j] = path[i][inversePerm[j]];
+        correctedPath.push_back(tuple);
+    }
+
+    return correctedPath;
+}
+
+std::vector<std::string> ThreadingPreprocessor::getHaplotypes(const std::vector<std::vector<GlobalClusterId>>& path) const {
+    std::vector<std::string> haplotypes;
+    for (uint32_t j = 0; j < ploidy; j++) {
+        std::string hap;
+        for (Position pos = 0; pos < path.size(); pos++) {
+            uint32_t i = pos < covMap.size() ? localIndex(pos, path[pos][j]) : 0;
+            if (pos < covMap.size() && i < covMap[pos].size())
+                hap += std::to_string(compressedConsensus[pos][i]);
+            else
+                hap += "n";
+        }
+        haplotypes.push_back(hap);
+    }
+    return haplotypes;
+}
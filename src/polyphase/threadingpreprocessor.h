@@ -0,0 +1,147 @@
+#ifndef THREADINGPREPROCESSOR_H
+#define THREADINGPREPROCESSOR_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "../readset.h"
+#include "../read.h"
+#include "haplothreader.h"
+
+/**
+ * ===
+ *
+ * Computes the auxiliary data of the threading stage of the polyploid phasing from a read set and a clustering of its
+ * reads: the coverage of every cluster on every position, the clusters relevant for the threading (coverage map), their
+ * consensus alleles and the similarity between the relevant clusters of consecutive positions. Also contains the post
+ * processing steps of the threading, which use these similarities to improve a computed path.
+ *
+ * Positions are the indices of the sorted variant positions of the read set. All results are equal to the ones of the
+ * corresponding Python functions in whatshap/threading.py.
+ *
+ * ==
+ */
+
+class ThreadingPreprocessor {
+
+public:
+    /**
+     * Computes all auxiliary data.
+     *
+     * @param readset The fragment matrix to phase
+     * @param clustering For every cluster, the ids of the reads it contains
+     * @param ploidy Number of haplotypes to phase
+     */
+    ThreadingPreprocessor(const ReadSet* readset, const std::vector<std::vector<uint32_t>>& clustering, uint32_t ploidy);
+
+    /**
+     * Returns the number of (variant) positions.
+     */
+    Position getNumPositions() const;
+
+    /**
+     * Returns the genome position of every position.
+     */
+    const std::vector<uint32_t>& getGenomePositions() const;
+
+    /**
+     * Returns the first and last position covered by a cluster (as two vectors over the cluster ids). Clusters without
+     * variants start at the number of positions and end at zero.
+     */
+    const std::vector<Position>& getClusterStarts() const;
+    const std::vector<Position>& getClusterEnds() const;
+
+    /**
+     * For every position, returns the ids of all clusters with non-zero coverage (ascending) and their absolute coverage.
+     */
+    const std::vector<std::vector<GlobalClusterId>>& getCoveringClusters() const;
+    const std::vector<std::vector<uint32_t>>& getAbsoluteCoverage() const;
+
+    /**
+     * For every position, returns the ids of the clusters relevant for the threading. At least ploidy and at most 2*ploidy
+     * clusters are selected, in descending order of coverage; clusters beyond the first ploidy ones need a relative
+     * coverage of at least 1/(8*ploidy).
+     */
+    const std::vector<std::vector<GlobalClusterId>>& getCovMap() const;
+
+    /**
+     * For every position, returns the relative coverage of the clusters in the coverage map (in the same order).
+     */
+    const std::vector<std::vector<double>>& getCompressedCoverage() const;
+
+    /**
+     * For every position, returns the consensus allele of the clusters in the coverage map (in the same order) and the
+     * fraction of the cluster's reads that agree with it.
+     */
+    const std::vector<std::vector<uint32_t>>& getCompressedConsensus() const;
+    const std::vector<std::vector<double>>& getConsensusFraction() const;
+
+    /**
+     * Returns the first position of every independent phasing run: every position, which shares no cluster in the coverage
+     * map with its predecessor, starts a new run. Position 0 is always contained.
+     */
+    std::vector<Position> getIndependentStarts() const;
+
+    /**
+     * Returns the similarity between cluster c1 on position pos-1 and cluster c2 on position pos, based on the consensus
+     * alleles of both clusters in a window around pos. Returns zero if one of the clusters is not in the coverage map of
+     * its position.
+     */
+    double getSimilarity(Position pos, GlobalClusterId c1, GlobalClusterId c2) const;
+
+    /**
+     * Post processing step after the threading. If two or more haplotypes switch clusters on the same position, the
+     * similarities between the clusters are used to find the most likely continuation of the switching haplotypes.
+     */
+    std::vector<std::vector<GlobalClusterId>> improvePathOnMultiswitches(const std::vector<std::vector<GlobalClusterId>>& path) const;
+
+    /**
+     * Post processing step after the threading. If a haplotype leaves a cluster on a collapsed region, the similarities
+     * between the clusters are used to find the most likely continuation of the switching haplotypes.
+     */
+    std::vector<std::vector<GlobalClusterId>> improvePathOnCollapsedswitches(const std::vector<std::vector<GlobalClusterId>>& path) const;
+
+    /**
+     * Returns the alleles of every haplotype along the path as a string, using the consensus of the clusters. Positions,
+     * at which a haplotype runs through a cluster outside of the coverage map, are marked with 'n'.
+     */
+    std::vector<std::string> getHaplotypes(const std::vector<std::vector<GlobalClusterId>>& path) const;
+
+private:
+    // number of positions before (and after, minus one) a position used for the cluster similarity
+    static const uint32_t SIMILARITY_WINDOW = 10;
+
+    uint32_t ploidy;
+    std::vector<uint32_t> genomePositions;
+    std::vector<Position> clusterStarts;
+    std::vector<Position> clusterEnds;
+    std::vector<std::vector<GlobalClusterId>> coveringClusters;
+    std::vector<std::vector<uint32_t>> absoluteCoverage;
+    std::vector<std::vector<GlobalClusterId>> covMap;
+    std::vector<std::vector<double>> compressedCoverage;
+    std::vector<std::vector<uint32_t>> compressedConsensus;
+    std::vector<std::vector<double>> consensusFraction;
+
+    // similarities between the clusters in the coverage maps of consecutive positions: for position pos, a matrix with one row
+    // per cluster of covMap[pos-1] and one column per cluster of covMap[pos], starting at similarityOffset[pos]
+    std::vector<uint64_t> similarityOffset;
+    std::vector<double> similarity;
+
+    /**
+     * Returns the index of a cluster in the coverage map of a position or the size of the coverage map, if it is not present.
+     */
+    uint32_t localIndex(Position pos, GlobalClusterId c) const;
+
+    void computeCoverage(const ReadSet* readset, const std::vector<std::vector<uint32_t>>& clustering);
+    void computeCovMap();
+    void computeConsensus(const ReadSet* readset, const std::vector<std::vector<uint32_t>>& clustering);
+    void computeSimilarity();
+
+    /**
+     * Returns the permutation of haplotypes (applied as current[haplotypes[i]] = current[haplotypes[perm[i]]]), which maximizes
+     * the sum of scores between left[i] and right[perm[i]]. The identity is kept if no other permutation is strictly better.
+     */
+    std::vector<uint32_t> findBestPermutation(const std::vector<double>& scores, uint32_t n) const;
+};
+
+#endif
@@ -4,7 +4,21 @@
 
 //using namespace std;
 
-TriangleSparseMatrix::TriangleSparseMatrix() : maxDim(0) {  }
+static inline uint64_t slotOf(uint64_t index, uint64_t mask) {
+    uint64_t h = index * 0x9E3779B97F4A7C15ULL;
+    return (h ^ (h >> 32)) & mask;
+}
+
+uint32_t TriangleSparseMatrix::Entry::row() const {
+    return (uint32_t)std::ceil(std::sqrt(2*index+0.25) - 0.5);
+}
+
+uint32_t TriangleSparseMatrix::Entry::col() const {
+    uint64_t u = row();
+    return (uint32_t)((index-1) - u * (u-1) / 2);
+}
+
+TriangleSparseMatrix::TriangleSparseMatrix() : numEntries(0), sorted(false), maxDim(0) {  }
 
 uint64_t TriangleSparseMatrix::entryToIndex(uint32_t i, uint32_t j) {
     if (i < j)
@@ -16,7 +30,7 @@ uint64_t TriangleSparseMatrix::entryToIndex(uint32_t i, uint32_t j) {
 }
 
 uint64_t TriangleSparseMatrix::size() {
-    return m.size();
+    return numEntries;
 }
 
 uint32_t TriangleSparseMatrix::getMaxDim() {
@@ -24,19 +38,17 @@ uint32_t TriangleSparseMatrix::getMaxDim() {
 }
 
 float TriangleSparseMatrix::get(uint32_t i, uint32_t j) {
-    uint64_t index = entryToIndex(i, j);
-    std::unordered_map<uint64_t, MatrixItem>::const_iterator it = m.find(index);
-    if (it != m.end())
-        return it->second.v;
+    Entry* entry = find(entryToIndex(i, j));
+    if (entry != nullptr)
+        return entry->item.v;
     else
         return 0;
 }
 
 TriangleSparseMatrix::DoubleInt TriangleSparseMatrix::getDoubleInt(uint32_t i, uint32_t j) {
-    uint64_t index = entryToIndex(i, j);
-    std::unordered_map<uint64_t, MatrixItem>::const_iterator it = m.find(index);
-    if (it != m.end())
-        return DoubleInt(it->second.i);
+    Entry* entry = find(entryToIndex(i, j));
+    if (entry != nullptr)
+        return DoubleInt(entry->item.i);
     else
         return DoubleInt(0, 0);
 }
@@ -44,7 +56,7 @@ TriangleSparseMatrix::DoubleInt TriangleSparseMatrix::getDoubleInt(uint32_t i, u
 void TriangleSparseMatrix::set(uint32_t i, uint32_t j, float v) {
     uint64_t index = entryToIndex(i, j);
     if (index != 0) {
-        m[index].v = v;
+        insert(index).item.v = v;
         maxDim = std::max(maxDim, i+1);
         maxDim = std::max(maxDim, j+1);
     }
@@ -53,28 +65,97 @@ void TriangleSparseMatrix::set(uint32_t i, uint32_t j, float v) {
 void TriangleSparseMatrix::setDoubleInt(uint32_t i, uint32_t j, uint16_t u1, uint16_t u2) {
     uint64_t index = entryToIndex(i, j);
     if (index != 0) {
-        m[index].i = ((uint32_t)u1 << 16) + (uint32_t)u2;
+        insert(index).item.i = ((uint32_t)u1 << 16) + (uint32_t)u2;
         maxDim = std::max(maxDim, i+1);
         maxDim = std::max(maxDim, j+1);
     }
 }
 
-std::vector<uint64_t> TriangleSparseMatrix::getIndices() {
-    std::vector<uint64_t> indices;
-    for (auto entry : m) {
-        indices.push_back(entry.first-1);
-    }
-    std::sort(indices.begin(), indices.end());
-    return indices;
-}
-
 std::vector<std::pair<uint32_t, uint32_t>> TriangleSparseMatrix::getEntries() {
     std::vector<std::pair<uint32_t, uint32_t>> pairs;
-    for (auto entry : m) {
-        uint64_t u = std::ceil(std::sqrt(2*(entry.first)+0.25) - 0.5);
-        uint64_t v = (entry.first-1) - u * (u-1) / 2;
-        pairs.push_back(std::pair<uint32_t, uint32_t>((uint32_t)u, (uint32_t)v));
+    pairs.reserve(numEntries);
+    for (const Entry& entry : getSortedEntries()) {
+        pairs.push_back(std::pair<uint32_t, uint32_t>(entry.row(), entry.col()));
     }
     return pairs;
 }
 
+void TriangleSparseMatrix::reserve(uint64_t n) {
+    n = std::max(n, numEntries);
+    uint64_t capacity = 16;
+    while (capacity * 3 < n * 4)
+        capacity *= 2;
+    if (sorted || capacity > slots.size())
+        rehash(capacity);
+}
+
+void TriangleSparseMatrix::merge(TriangleSparseMatrix& other) {
+    reserve(numEntries + other.numEntries);
+    for (const Entry& entry : other.slots) {
+        if (entry.index != 0)
+            insert(entry.index).item = entry.item;
+    }
+    maxDim = std::max(maxDim, other.maxDim);
+}
+
+void TriangleSparseMatrix::sortEntries() {
+    if (sorted)
+        return;
+    // move occupied slots to the front, then sort them; no additional memory is needed
+    slots.erase(std::remove_if(slots.begin(), slots.end(), [](const Entry& e) { return e.index == 0; }), slots.end());
+    std::sort(slots.begin(), slots.end(), [](const Entry& a, const Entry& b) { return a.index < b.index; });
+    sorted = true;
+}
+
+std::vector<TriangleSparseMatrix::Entry>& TriangleSparseMatrix::getSortedEntries() {
+    sortEntries();
+    return slots;
+}
+
+TriangleSparseMatrix::Entry* TriangleSparseMatrix::find(uint64_t index) {
+    if (index == 0 || slots.empty())
+        return nullptr;
+    if (sorted) {
+        std::vector<Entry>::iterator it = std::lower_bound(slots.begin(), slots.end(), index,
+                                                           [](const Entry& e, uint64_t i) { return e.index < i; });
+        return (it != slots.end() && it->index == index) ? &(*it) : nullptr;
+    }
+    // linear probing
+    uint64_t mask = slots.size() - 1;
+    for (uint64_t pos = slotOf(index, mask); slots[pos].index != 0; pos = (pos + 1) & mask) {
+        if (slots[pos].index == index)
+            return &slots[pos];
+    }
+    return nullptr;
+}
+
+TriangleSparseMatrix::Entry& TriangleSparseMatrix::insert(uint64_t index) {
+    Entry* existing = find(index);
+    if (existing != nullptr)
+        return *existing;
+    // keep the load factor at most 3/4
+    reserve(numEntries + 1);
+    uint64_t mask = slots.size() - 1;
+    uint64_t pos = slotOf(index, mask);
+    while (slots[pos].index != 0)
+        pos = (pos + 1) & mask;
+    slots[pos].index = index;
+    slots[pos].item.i = 0;
+    numEntries++;
+    return slots[pos];
+}
+
+void TriangleSparseMatrix::rehash(uint64_t capacity) {
+    std::vector<Entry> table(capacity, Entry{0, {0.0f}});
+    uint64_t mask = capacity - 1;
+    for (const Entry& entry : slots) {
+        if (entry.index == 0)
+            continue;
+        uint64_t pos = slotOf(entry.index, mask);
+        while (table[pos].index != 0)
+            pos = (pos + 1) & mask;
+        table[pos] = entry;
+    }
+    slots.swap(table);
+    sorted = false;
+}
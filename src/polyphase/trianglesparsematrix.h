@@ -2,15 +2,19 @@
 #define TRIANGLESPARSEMATRIX_H
 
 #include <cstdint>
-#include <unordered_map>
 #include <set>
 #include <vector>
 
 /**
  * A simple storage class, to sparsely store float values for pairs of non-negative integers.
+ *
+ * Entries are kept in a flat open-addressing hash table (16 bytes per slot). Calling sortEntries()
+ * turns the table in place into a list of entries sorted by index, which can be read (and whose
+ * values can be modified) without copying via getSortedEntries(). Lookups on a sorted matrix use
+ * binary search; inserting a new entry turns it back into a hash table.
  */
 class TriangleSparseMatrix {
- 
+
 public:
     struct DoubleInt {
         uint16_t u1;
@@ -19,6 +23,20 @@ public:
         DoubleInt(uint16_t v1, uint16_t v2) : u1(v1), u2(v2) {}
         DoubleInt(uint32_t u) : u1(u/65536), u2(u%65536) {}
     };
+    union MatrixItem {
+        float v;
+        uint32_t i;
+    };
+    struct Entry {
+        // index of the entry as computed by entryToIndex, zero for an empty slot
+        uint64_t index;
+        MatrixItem item;
+        // the larger of both coordinates
+        uint32_t row() const;
+        // the smaller of both coordinates
+        uint32_t col() const;
+    };
+
 	TriangleSparseMatrix();
     uint64_t entryToIndex(uint32_t i, uint32_t j);
     uint64_t size();
@@ -27,17 +45,40 @@ public:
     DoubleInt getDoubleInt(uint32_t i, uint32_t j);
     void set(uint32_t i, uint32_t j, float v);
     void setDoubleInt(uint32_t i, uint32_t j, uint16_t u1, uint16_t u2);
-    std::vector<uint64_t> getIndices();
     std::vector<std::pair<uint32_t, uint32_t>> getEntries();
 
+    /**
+     * Makes room for n entries without rehashing.
+     */
+    void reserve(uint64_t n);
+
+    /**
+     * Inserts all entries of other into this matrix, overwriting existing entries with the same index.
+     * Used to combine matrices that were filled independently (e.g. by different threads).
+     */
+    void merge(TriangleSparseMatrix& other);
+
+    /**
+     * Sorts the entries by index in place. Does nothing if they are already sorted.
+     */
+    void sortEntries();
+
+    /**
+     * Returns all entries sorted by index (sorting them first if necessary). Their values may be
+     * modified, but the reference is only valid until a new entry is inserted.
+     */
+    std::vector<Entry>& getSortedEntries();
+
 private:
-    union MatrixItem {
-        float v;
-        uint32_t i;
-    };
-	std::unordered_map<uint64_t, MatrixItem> m;
+    // hash table with a power-of-two number of slots or, if sorted is true, entries sorted by index
+	std::vector<Entry> slots;
+    uint64_t numEntries;
+    bool sorted;
     uint32_t maxDim;
+
+    Entry* find(uint64_t index);
+    Entry& insert(uint64_t index);
+    void rehash(uint64_t capacity);
 };
 
 #endif
-
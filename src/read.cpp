@@ -5,17 +5,35 @@
 
 
 #include "read.h"
+#include "stringpool.h"
 
 using namespace std;
 
-Read::Read(const std::string& name, int mapq, int source_id, int sample_id, int reference_start, const std::string& BX_tag) : name(name), mapqs(1, mapq), source_id(source_id), sample_id(sample_id), reference_start(reference_start), BX_tag(BX_tag) {
+namespace {
+	const string empty_BX_tag;
+}
+
+
+Read::Read(const std::string& name, int mapq, int source_id, int sample_id, int reference_start, const std::string& BX_tag) : name(make_shared<const string>(name)), mapqs(1, mapq), source_id(source_id), sample_id(sample_id), reference_start(reference_start), shared_variants(make_shared<entry_list_t>()) {
 	this->id = -1;
+	if (!BX_tag.empty()) {
+		this->BX_tag = intern_string(BX_tag);
+	}
+}
+
+
+Read::entry_list_t& Read::mutable_variants() {
+	if (shared_variants.use_count() > 1) {
+		shared_variants = make_shared<entry_list_t>(*shared_variants);
+	}
+	return *shared_variants;
 }
 
 
 string Read::toString() {
+	const entry_list_t& variants = *shared_variants;
 	ostringstream oss;
-	oss << name << " mapq:(";
+	oss << *name << " mapq:(";
 	for (size_t i=0; i<mapqs.size(); ++i) {
 		if (i>0) oss << ",";
 		oss << mapqs[i];
@@ -31,16 +49,20 @@ string Read::toString() {
 
 
 void Read::addVariant(int position, int allele, int quality) {
+	entry_list_t& variants = mutable_variants();
 	variants.push_back(enriched_entry_t(position, allele, quality));
 }
 
 
 void Read::sortVariants() {
+	// avoid unsharing the variants of sorted reads
+	if (isSorted()) return;
+	entry_list_t& variants = mutable_variants();
 	sort(variants.begin(), variants.end(), entry_comparator_t());
 	for (size_t i=1; i<variants.size(); ++i) {
 		if (variants[i-1].position == variants[i].position) {
 			ostringstream oss;
-			oss << "Duplicate variant in read " << name << " at position " << variants[i].position;
+			oss << "Duplicate variant in read " << *name << " at position " << variants[i].position;
 			throw std::runtime_error(oss.str());
 		}
 	}
@@ -48,18 +70,21 @@ void Read::sortVariants() {
 
 
 int Read::firstPosition() const {
+	const entry_list_t& variants = *shared_variants;
 	if (variants.size() == 0) throw std::runtime_error("No variants present");
 	return variants[0].position;
 }
 
 
 int Read::lastPosition() const {
+	const entry_list_t& variants = *shared_variants;
 	if (variants.size() == 0) throw std::runtime_error("No variants present");
 	return variants[variants.size()-1].position;
 }
 
 
 void Read::setID(int id) {
+	entry_list_t& variants = mutable_variants();
 	this->id = id;
 	for (size_t i=0; i<variants.size(); ++i) {
 		variants[i].entry.set_read_id(id);
@@ -73,6 +98,7 @@ int Read::getID() const {
 
 
 void Read::addPositionsToSet(std::unordered_set<unsigned int>* set) {
+	const entry_list_t& variants = *shared_variants;
 	assert(set != 0);
 	for (size_t i=0; i<variants.size(); ++i) {
 		set->insert(variants[i].position);
@@ -81,53 +107,61 @@ void Read::addPositionsToSet(std::unordered_set<unsigned int>* set) {
 
 
 int Read::getPosition(size_t variant_idx) const {
+	const entry_list_t& variants = *shared_variants;
 	assert(variant_idx < variants.size());
 	return variants[variant_idx].position;
 }
 
 
 void Read::setPosition(size_t variant_idx, int position) {
+	entry_list_t& variants = mutable_variants();
 	assert(variant_idx < variants.size());
 	variants[variant_idx].position = position;
 }
 
 
 int Read::getAllele(size_t variant_idx) const {
+	const entry_list_t& variants = *shared_variants;
 	assert(variant_idx < variants.size());
 	return variants[variant_idx].entry.get_allele_type();
 }
 
 
 void Read::setAllele(size_t variant_idx, int allele) {
+	entry_list_t& variants = mutable_variants();
 	assert(variant_idx < variants.size());
 	variants[variant_idx].entry.set_allele_type((Entry::allele_t)allele);
 }
 
 
 int Read::getVariantQuality(size_t variant_idx) const {
+	const entry_list_t& variants = *shared_variants;
 	assert(variant_idx < variants.size());
 	return variants[variant_idx].entry.get_phred_score();
 }
 
 
 void Read::setVariantQuality(size_t variant_idx, int quality) {
+	entry_list_t& variants = mutable_variants();
 	assert(variant_idx < variants.size());
 	variants[variant_idx].entry.set_phred_score(quality);
 }
 
 
 const Entry* Read::getEntry(size_t variant_idx) const {
+	const entry_list_t& variants = *shared_variants;
 	return &(variants[variant_idx].entry);
 }
 
 
 int Read::getVariantCount() const {
+	const entry_list_t& variants = *shared_variants;
 	return variants.size();
 }
 
 
 const string& Read::getName() const {
-	return name;
+	return *name;
 }
 
 
@@ -155,10 +189,14 @@ int Read::getReferenceStart() const {
 }
 
 const std::string& Read::getBXTag() const {
-	return BX_tag; 
+	if (BX_tag == nullptr) {
+		return empty_BX_tag;
+	}
+	return *BX_tag;
 }
 
 bool Read::isSorted() const {
+	const entry_list_t& variants = *shared_variants;
 	entry_comparator_t comparator;
 	for (size_t i=1; i<variants.size(); ++i) {
 		if (!comparator(variants[i-1],variants[i])) {
@@ -169,5 +207,5 @@ bool Read::isSorted() const {
 }
 
 bool Read::hasBXTag() const {
-	return (BX_tag != "");
+	return BX_tag != nullptr;
 }
@@ -4,9 +4,15 @@
 #include <string>
 #include <vector>
 #include <unordered_set>
+#include <memory>
 
 #include "entry.h"
 
+/** A read, given by its variant entries. Copies of a read (e.g. those made by ReadSet::subset())
+ *  share its name and, until one of them is modified (copy-on-write), its variants, such that
+ *  copying a read is cheap. BX tags are interned, such that reads tagged with the same barcode
+ *  store it only once.
+ */
 class Read {
 public:
 	Read(const std::string& name, int mapq, int source_id, int sample_id, int reference_start = -1, const std::string& BX_tag = "");
@@ -36,6 +42,8 @@ public:
 	int getSourceID() const;
 	int getSampleID() const;
 	int getReferenceStart() const;
+	/** Returns the BX tag (empty if there is none). Tags are interned, so reads with equal
+	 *  tags return the same string object. */
 	const std::string& getBXTag() const;
 	bool isSorted() const;
 	bool hasBXTag() const;
@@ -54,14 +62,20 @@ private:
 		}
 	} entry_comparator_t;
 
-	std::string name;
+	std::shared_ptr<const std::string> name;
 	std::vector<int> mapqs;
 	int source_id;
 	int sample_id;
 	int id;
 	int reference_start;
-	std::string BX_tag;
-	std::vector<enriched_entry_t> variants;
+	// null if the read has no BX tag
+	std::shared_ptr<const std::string> BX_tag;
+	typedef std::vector<enriched_entry_t> entry_list_t;
+	// shared with copies of this read as long as none of them modifies it
+	std::shared_ptr<entry_list_t> shared_variants;
+
+	/** Returns the variants for modification, after making a private copy if they are shared. */
+	entry_list_t& mutable_variants();
 };
 
 #endif
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include "readclouds.h"
+
+using namespace std;
+
+namespace {
+
+/** The reads with the same BX tag, sorted by reference start. Reads that have been assigned
+ *  are skipped in later searches. */
+class TagGroup {
+public:
+	void add(int reference_start, size_t read_index) {
+		reads.push_back(make_pair(reference_start, read_index));
+	}
+
+	void finish() {
+		stable_sort(reads.begin(), reads.end(), [] (const pair<int, size_t>& a, const pair<int, size_t>& b) { return a.first < b.first; });
+		next.resize(reads.size() + 1);
+		for (size_t k = 0; k < next.size(); ++k) {
+			next[k] = k;
+		}
+	}
+
+	/** Calls f(read_index) for all reads that start within [begin, end] and have not been removed,
+	 *  in the order of their reference starts. f returns whether to remove the read. */
+	template <typename Function>
+	void visit(long long begin, long long end, Function f) {
+		size_t k = lower_bound(reads.begin(), reads.end(), begin, [] (const pair<int, size_t>& read, long long start) { return read.first < start; }) - reads.begin();
+		for (k = find(k); (k < reads.size()) && (reads[k].first <= end); k = find(k + 1)) {
+			if (f(reads[k].second)) {
+				next[k] = k + 1;
+			}
+		}
+	}
+
+private:
+	vector<pair<int, size_t> > reads;
+	// next[k] leads (via other entries) to the first read at or after k that has not been removed
+	vector<size_t> next;
+
+	size_t find(size_t k) {
+		while (next[k] != k) {
+			next[k] = next[next[k]];
+			k = next[k];
+		}
+		return k;
+	}
+};
+
+} // namespace
+
+size_t assign_read_haplotypes(const ReadSet& reads, const vector<unsigned int>& positions, const vector<int>& phasesets,
+	const vector<int>& alleles, bool use_bx_tags, unsigned int linked_read_cutoff,
+	vector<read_haplotype_t>* read_haplotypes, vector<read_cloud_t>* clouds)
+{
+	if ((phasesets.size() != positions.size()) || (alleles.size() != positions.size())) {
+		throw std::invalid_argument("positions, phasesets and alleles must have the same length");
+	}
+	size_t read_count = reads.size();
+
+	// reads are identified by their names, and BX tags by their interned strings
+	vector<size_t> name_ids(read_count);
+	unordered_map<string, size_t> name_index;
+	unordered_map<const string*, size_t> group_index;
+	vector<TagGroup> groups;
+	vector<size_t> read_groups(read_count, groups.size());
+	for (size_t i = 0; i < read_count; ++i) {
+		const Read* read = reads.get(i);
+		name_ids[i] = name_index.emplace(read->getName(), name_index.size()).first->second;
+		if (use_bx_tags && read->hasBXTag()) {
+			auto inserted = group_index.emplace(&read->getBXTag(), groups.size());
+			if (inserted.second) {
+				groups.emplace_back();
+			}
+			read_groups[i] = inserted.first->second;
+			groups[read_groups[i]].add(read->getReferenceStart(), i);
+		}
+	}
+	for (TagGroup& group : groups) {
+		group.finish();
+	}
+
+	size_t multiple_phasesets = 0;
+	vector<bool> assigned(name_index.size(), false);
+	vector<size_t> cloud;
+	// sum of the signed qualities for each phase set of a cloud, in the order of occurrence
+	vector<pair<int, long long> > costs;
+	for (size_t i = 0; i < read_count; ++i) {
+		if (assigned[name_ids[i]]) {
+			continue;
+		}
+		assigned[name_ids[i]] = true;
+		cloud.assign(1, i);
+		if (read_groups[i] < groups.size()) {
+			long long start = reads.get(i)->getReferenceStart();
+			groups[read_groups[i]].visit(start - linked_read_cutoff, start + linked_read_cutoff, [&] (size_t j) {
+				if (!assigned[name_ids[j]]) {
+					cloud.push_back(j);
+				}
+				return true;
+			});
+			for (size_t j : cloud) {
+				assigned[name_ids[j]] = true;
+			}
+		}
+
+		costs.clear();
+		for (size_t j : cloud) {
+			const Read* read = reads.get(j);
+			for (int k = 0; k < read->getVariantCount(); ++k) {
+				unsigned int position = read->getPosition(k);
+				auto it = lower_bound(positions.begin(), positions.end(), position);
+				if ((it == positions.end()) || (*it != position)) {
+					throw std::invalid_argument("read " + read->getName() + " has a variant at position " + to_string(position) + ", which is not phased");
+				}
+				size_t v = it - positions.begin();
+				int allele = read->getAllele(k);
+				if ((allele != 0) && (allele != 1)) {
+					throw std::invalid_argument("only alleles 0 and 1 are supported");
+				}
+				auto cost = find_if(costs.begin(), costs.end(), [&] (const pair<int, long long>& c) { return c.first == phasesets[v]; });
+				if (cost == costs.end()) {
+					costs.push_back(make_pair(phasesets[v], 0));
+					cost = costs.end() - 1;
+				}
+				cost->second += (allele == alleles[v]) ? read->getVariantQuality(k) : -read->getVariantQuality(k);
+			}
+		}
+		if (costs.empty()) {
+			continue;
+		}
+		if (costs.size() > 1) {
+			multiple_phasesets += 1;
+		}
+		auto best = costs.begin();
+		for (auto it = costs.begin(); it != costs.end(); ++it) {
+			if (llabs(it->second) > llabs(best->second)) {
+				best = it;
+			}
+		}
+		if (best->second == 0) {
+			continue;
+		}
+		int haplotype = (best->second > 0) ? 0 : 1;
+		clouds->push_back(read_cloud_t{i, haplotype, best->first});
+		for (size_t j : cloud) {
+			read_haplotypes->push_back(read_haplotype_t{j, haplotype, llabs(best->second), best->first});
+		}
+	}
+	return multiple_phasesets;
+}
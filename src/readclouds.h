@@ -0,0 +1,49 @@
+#ifndef READ_CLOUDS_H
+#define READ_CLOUDS_H
+
+#include <string>
+#include <vector>
+
+#include "readset.h"
+
+/** Haplotype of a phased read (and of all other reads of its read cloud). */
+typedef struct read_haplotype_t {
+	// index of the read in the read set
+	size_t read_index;
+	int haplotype;
+	// absolute difference of the costs of assigning the read cloud to haplotypes 0 and 1
+	long long quality;
+	int phaseset;
+} read_haplotype_t;
+
+/** A phased read cloud, identified by the read whose BX tag and reference start it was built for. */
+typedef struct read_cloud_t {
+	size_t read_index;
+	int haplotype;
+	int phaseset;
+} read_cloud_t;
+
+/** Assigns reads to the haplotypes of a phased sample as "whatshap haplotag" does.
+ *
+ *  The reads are processed in order. Each read that has not been assigned yet forms a read
+ *  cloud together with all unassigned reads that have the same BX tag and start at most
+ *  linked_read_cutoff bases away from it (if use_bx_tags is set). Reads are identified by
+ *  their names, so a read is not assigned again if one with the same name has been assigned.
+ *  The variants of the reads of a cloud are merged by summing up, for each phase set, the
+ *  qualities of the alleles that agree with haplotype 0 minus those of the other alleles.
+ *  The cloud is assigned to the phase set with the largest absolute sum (the first one with
+ *  a variant in the cloud on ties) and to haplotype 0 or 1 depending on the sign of the sum.
+ *
+ *  @param positions Sorted positions of the phased variants, which must include those of all
+ *                   variants of the reads.
+ *  @param phasesets Phase set of each variant.
+ *  @param alleles Allele (0 or 1) of each variant on haplotype 0.
+ *  @param read_haplotypes Receives the assignment of every read of a phased cloud.
+ *  @param clouds Receives every phased cloud.
+ *  @return The number of clouds with variants in more than one phase set.
+ */
+size_t assign_read_haplotypes(const ReadSet& reads, const std::vector<unsigned int>& positions, const std::vector<int>& phasesets,
+	const std::vector<int>& alleles, bool use_bx_tags, unsigned int linked_read_cutoff,
+	std::vector<read_haplotype_t>* read_haplotypes, std::vector<read_cloud_t>* clouds);
+
+#endif
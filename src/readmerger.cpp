@@ -0,0 +1,320 @@
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <stdexcept>
+
+#include "readmerger.h"
+
+using namespace std;
+
+namespace {
+	typedef pair<unsigned int, unsigned int> edge_t;
+
+	const unsigned int UNSEEN = (unsigned int)-1;
+
+	/** Union-find with path halving and union by size. */
+	class UnionFind {
+	public:
+		UnionFind(size_t size) : parent(size), sizes(size, 1) {
+			for (size_t i = 0; i < size; ++i) parent[i] = i;
+		}
+
+		unsigned int find(unsigned int x) {
+			while (parent[x] != x) {
+				parent[x] = parent[parent[x]];
+				x = parent[x];
+			}
+			return x;
+		}
+
+		/** Returns whether x and y were in different sets before. */
+		bool merge(unsigned int x, unsigned int y) {
+			x = find(x);
+			y = find(y);
+			if (x == y) return false;
+			if (sizes[x] < sizes[y]) swap(x, y);
+			parent[y] = x;
+			sizes[x] += sizes[y];
+			return true;
+		}
+
+	private:
+		vector<unsigned int> parent;
+		vector<unsigned int> sizes;
+	};
+
+
+	/** Undirected graph on the reads, in which the neighbours of a read are iterated in the order the
+	 *  edges were added (as in networkx.Graph). */
+	class Graph {
+	public:
+		Graph(size_t node_count) : adjacency(node_count), pred(node_count, UNSEEN), pred_edge(node_count), succ(node_count, UNSEEN), succ_edge(node_count) {}
+
+		void add_edge(unsigned int u, unsigned int v, int weight) {
+			adjacency[u].push_back(make_pair(v, edges.size()));
+			adjacency[v].push_back(make_pair(u, edges.size()));
+			edges.push_back(edge_t(u, v));
+			weights.push_back(weight);
+			removed.push_back(false);
+		}
+
+		void remove_edge(size_t edge) {
+			removed[edge] = true;
+		}
+
+		bool is_removed(size_t edge) const {
+			return removed[edge];
+		}
+
+		int get_weight(size_t edge) const {
+			return weights[edge];
+		}
+
+		const vector<edge_t>& get_edges() const {
+			return edges;
+		}
+
+		/** Returns the edges on a shortest path from source to target (source != target), or an empty
+		 *  vector if there is none. Like networkx.shortest_path, the path is found by a breadth-first
+		 *  search from both ends, which always expands the smaller fringe, such that ties between
+		 *  paths of equal length are resolved in the same way.
+		 */
+		vector<size_t> shortest_path(unsigned int source, unsigned int target) {
+			assert(source != target);
+			vector<size_t> path;
+			visit(pred, source, source);
+			visit(succ, target, target);
+			vector<unsigned int> forward_fringe(1, source);
+			vector<unsigned int> reverse_fringe(1, target);
+			vector<unsigned int> this_level;
+			unsigned int meeting = UNSEEN;
+			while (!forward_fringe.empty() && !reverse_fringe.empty() && (meeting == UNSEEN)) {
+				bool forward = forward_fringe.size() <= reverse_fringe.size();
+				vector<unsigned int>& fringe = forward ? forward_fringe : reverse_fringe;
+				vector<unsigned int>& seen = forward ? pred : succ;
+				vector<size_t>& seen_edge = forward ? pred_edge : succ_edge;
+				const vector<unsigned int>& other = forward ? succ : pred;
+				this_level.swap(fringe);
+				fringe.clear();
+				for (size_t i = 0; (i < this_level.size()) && (meeting == UNSEEN); ++i) {
+					unsigned int v = this_level[i];
+					for (const auto& neighbour : adjacency[v]) {
+						if (removed[neighbour.second]) continue;
+						unsigned int w = neighbour.first;
+						if (seen[w] == UNSEEN) {
+							fringe.push_back(w);
+							visit(seen, w, v);
+							seen_edge[w] = neighbour.second;
+						}
+						if (other[w] != UNSEEN) {
+							meeting = w;
+							break;
+						}
+					}
+				}
+			}
+			if (meeting != UNSEEN) {
+				for (unsigned int v = meeting; v != source; v = pred[v]) {
+					path.push_back(pred_edge[v]);
+				}
+				reverse(path.begin(), path.end());
+				for (unsigned int v = meeting; v != target; v = succ[v]) {
+					path.push_back(succ_edge[v]);
+				}
+			}
+			for (unsigned int v : touched) {
+				pred[v] = UNSEEN;
+				succ[v] = UNSEEN;
+			}
+			touched.clear();
+			return path;
+		}
+
+	private:
+		// per read, the neighbours and the indices of the connecting edges
+		vector<vector<pair<unsigned int, size_t> > > adjacency;
+		vector<edge_t> edges;
+		// number of matches minus number of mismatches of every edge
+		vector<int> weights;
+		vector<bool> removed;
+		// predecessor of every node reached from the source or target (and the edge to it)
+		vector<unsigned int> pred;
+		vector<size_t> pred_edge;
+		vector<unsigned int> succ;
+		vector<size_t> succ_edge;
+		vector<unsigned int> touched;
+
+		void visit(vector<unsigned int>& seen, unsigned int v, unsigned int from) {
+			seen[v] = from;
+			touched.push_back(v);
+		}
+	};
+
+
+	/** Returns the number of connected components of the given edges. */
+	size_t count_components(size_t node_count, const vector<edge_t>& edges) {
+		UnionFind components(node_count);
+		size_t count = node_count;
+		for (const edge_t& edge : edges) {
+			if (components.merge(edge.first, edge.second)) --count;
+		}
+		return count;
+	}
+}
+
+
+ReadMerger::ReadMerger(double error_rate, double max_error_rate, double positive_threshold, double negative_threshold) : max_error_rate(max_error_rate) {
+	// a match is (1 - error_rate) / (error_rate / 3) times more likely when both reads come from the same haplotype
+	double base = log((1.0 - error_rate) / (error_rate / 3.0));
+	match_threshold = 1 + int(log(positive_threshold) / base);
+	mismatch_threshold = 1 + int(log(negative_threshold) / base);
+}
+
+
+int ReadMerger::get_match_threshold() const {
+	return match_threshold;
+}
+
+
+int ReadMerger::get_mismatch_threshold() const {
+	return mismatch_threshold;
+}
+
+
+ReadSet* ReadMerger::merge(const ReadSet& readset, read_merging_stats_t* stats) const {
+	size_t read_count = readset.size();
+	vector<long long> begins(read_count);
+	vector<long long> ends(read_count);
+	for (size_t i = 0; i < read_count; ++i) {
+		const Read* read = readset.get(i);
+		if (read->getVariantCount() == 0) continue;
+		for (int k = 0; k < read->getVariantCount(); ++k) {
+			int allele = read->getAllele(k);
+			if ((allele != 0) && (allele != 1)) {
+				throw std::invalid_argument("Read merging requires biallelic variants");
+			}
+		}
+		// the end is the begin plus the number of variants, and overlaps are aligned by the difference of
+		// the begins (as done by the former implementation)
+		begins[i] = read->getPosition(0);
+		ends[i] = begins[i] + read->getVariantCount();
+	}
+
+	// sweep over the reads, keeping those that may overlap the current one
+	Graph blue(read_count);
+	vector<edge_t> conflicts;
+	vector<unsigned int> active;
+	for (unsigned int i = 0; i < read_count; ++i) {
+		const Read* read = readset.get(i);
+		if (read->getVariantCount() == 0) continue;
+		active.erase(remove_if(active.begin(), active.end(), [&](unsigned int j) { return ends[j] <= begins[i]; }), active.end());
+		for (unsigned int j : active) {
+			const Read* other = readset.get(j);
+			long long length = other->getVariantCount();
+			long long hang = begins[i] - begins[j];
+			// Python slice semantics: a negative hang counts from the end of the other read
+			long long start = (hang >= 0) ? min(hang, length) : max(0LL, length + hang);
+			int match = 0;
+			int mismatch = 0;
+			for (long long k = start, l = 0; (k < length) && (l < read->getVariantCount()); ++k, ++l) {
+				if (other->getAllele(k) == read->getAllele(l)) {
+					++match;
+				} else {
+					++mismatch;
+				}
+			}
+			int total = match + mismatch;
+			if ((total >= mismatch_threshold) && (total > 0)
+				&& ((double)min(match, mismatch) / (double)total <= max_error_rate)
+				&& (match - mismatch >= match_threshold)) {
+				blue.add_edge(j, i, match - mismatch);
+				if (mismatch - match >= mismatch_threshold) {
+					conflicts.push_back(edge_t(j, i));
+				}
+			}
+		}
+		active.push_back(i);
+	}
+
+	if (stats != nullptr) {
+		stats->blue_edges = blue.get_edges().size();
+		stats->blue_components = count_components(read_count, blue.get_edges());
+		stats->notblue_edges = conflicts.size();
+		stats->notblue_components = count_components(read_count, conflicts);
+	}
+
+	// For every conflict inside a blue component (as computed before removing any edges), remove the weakest
+	// edge on a shortest path between both reads until they are disconnected
+	UnionFind initial_components(read_count);
+	for (const edge_t& edge : blue.get_edges()) {
+		initial_components.merge(edge.first, edge.second);
+	}
+	sort(conflicts.begin(), conflicts.end());
+	for (const edge_t& conflict : conflicts) {
+		if (initial_components.find(conflict.first) != initial_components.find(conflict.second)) continue;
+		while (true) {
+			vector<size_t> path = blue.shortest_path(conflict.first, conflict.second);
+			if (path.empty()) break;
+			size_t weakest = path[0];
+			for (size_t edge : path) {
+				if (blue.get_weight(edge) < blue.get_weight(weakest)) weakest = edge;
+			}
+			blue.remove_edge(weakest);
+		}
+	}
+
+	// the representative of a blue component is its smallest read
+	UnionFind final_components(read_count);
+	for (size_t edge = 0; edge < blue.get_edges().size(); ++edge) {
+		if (!blue.is_removed(edge)) {
+			final_components.merge(blue.get_edges()[edge].first, blue.get_edges()[edge].second);
+		}
+	}
+	vector<unsigned int> representative(read_count, (unsigned int)-1);
+	vector<unsigned int> component_size(read_count, 0);
+	for (unsigned int i = 0; i < read_count; ++i) {
+		unsigned int root = final_components.find(i);
+		if (representative[root] == (unsigned int)-1) representative[root] = i;
+		component_size[root] += 1;
+	}
+
+	// sum up the qualities of both alleles of every position within each component
+	map<unsigned int, map<int, pair<long long, long long> > > superreads;
+	for (unsigned int i = 0; i < read_count; ++i) {
+		unsigned int root = final_components.find(i);
+		if (component_size[root] == 1) continue;
+		map<int, pair<long long, long long> >& superread = superreads[representative[root]];
+		const Read* read = readset.get(i);
+		for (int k = 0; k < read->getVariantCount(); ++k) {
+			pair<long long, long long>& z = superread[read->getPosition(k)];
+			if (read->getAllele(k) == 0) {
+				z.first += read->getVariantQuality(k);
+			} else {
+				z.second += read->getVariantQuality(k);
+			}
+		}
+	}
+
+	ReadSet* result = new ReadSet();
+	for (unsigned int i = 0; i < read_count; ++i) {
+		unsigned int root = final_components.find(i);
+		if ((component_size[root] > 1) && (representative[root] != i)) continue;
+		Read* merged = new Read("read" + to_string(i), 0, 0, 0);
+		if (component_size[root] > 1) {
+			for (const auto& position : superreads[i]) {
+				const pair<long long, long long>& z = position.second;
+				int allele = (z.first >= z.second) ? 0 : 1;
+				merged->addVariant(position.first, allele, (int)llabs(z.second - z.first));
+			}
+		} else {
+			const Read* read = readset.get(i);
+			for (int k = 0; k < read->getVariantCount(); ++k) {
+				merged->addVariant(read->getPosition(k), read->getAllele(k), read->getVariantQuality(k));
+			}
+		}
+		result->add(merged);
+	}
+	return result;
+}
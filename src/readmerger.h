@@ -0,0 +1,53 @@
+#ifndef READ_MERGER_H
+#define READ_MERGER_H
+
+#include "readset.h"
+
+/** Sizes of the graphs built while merging reads. */
+typedef struct read_merging_stats_t {
+	// pairs of reads likely coming from the same haplotype (blue edges) and their connected components
+	size_t blue_edges;
+	size_t blue_components;
+	// pairs of reads likely coming from different haplotypes (conflicts) and their connected components
+	size_t notblue_edges;
+	size_t notblue_components;
+	read_merging_stats_t() : blue_edges(0), blue_components(0), notblue_edges(0), notblue_components(0) {}
+} read_merging_stats_t;
+
+/** Merges reads that likely come from the same haplotype into super reads (Python: whatshap.merge).
+ *  Overlapping read pairs are found by sweeping over the reads in the order of the ReadSet. A pair is
+ *  connected by a blue edge if the number of matching alleles sufficiently exceeds the number of mismatching
+ *  ones, and is a conflict if it is the other way round. The blue edges within a connected component that
+ *  connect the two reads of a conflict are removed (the weakest edge on a shortest path, repeatedly),
+ *  and the reads of every remaining blue component are merged into one read. The result is the same as the
+ *  one of the former networkx-based implementation.
+ */
+class ReadMerger {
+public:
+	/** Constructor.
+	 *  @param error_rate The probability that an allele is wrong.
+	 *  @param max_error_rate The maximum fraction of mismatches of a blue edge.
+	 *  @param positive_threshold Threshold of the ratio between the probabilities that a pair of reads comes from
+	 *                            the same haplotype and from different haplotypes (for blue edges).
+	 *  @param negative_threshold Threshold of the same ratio for conflicts.
+	 */
+	ReadMerger(double error_rate, double max_error_rate, double positive_threshold, double negative_threshold);
+
+	/** Returns the merged reads, named "read<i>" after the index i of the (first) original read. Reads that are
+	 *  not merged are copied. Caller owns the returned pointer.
+	 *  @param stats If not null, the sizes of the graphs are stored in it.
+	 */
+	ReadSet* merge(const ReadSet& readset, read_merging_stats_t* stats = nullptr) const;
+
+	/** Minimum difference between matches and mismatches for a blue edge. */
+	int get_match_threshold() const;
+	/** Minimum difference between mismatches and matches for a conflict and minimum overlap of both. */
+	int get_mismatch_threshold() const;
+
+private:
+	double max_error_rate;
+	int match_threshold;
+	int mismatch_threshold;
+};
+
+#endif
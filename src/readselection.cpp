@@ -0,0 +1,540 @@
+#include <cassert>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+
+#include "readselection.h"
+
+using namespace std;
+
+namespace {
+	typedef struct read_score_t {
+		int new_score;
+		int total_score;
+		int min_quality;
+		read_score_t() : new_score(0), total_score(0), min_quality(-1) {}
+		bool operator<(const read_score_t& other) const {
+			if (new_score != other.new_score) return new_score < other.new_score;
+			if (total_score != other.total_score) return total_score < other.total_score;
+			return min_quality < other.min_quality;
+		}
+	} read_score_t;
+
+
+	/** Binary max-heap of reads, indexed by read such that scores can be looked up and changed.
+	 *  Of reads with equal scores, the one with the smallest index is popped first. */
+	class ReadQueue {
+	public:
+		ReadQueue(size_t read_count) : positions(read_count, NOT_QUEUED) {}
+
+		bool empty() const {
+			return heap.empty();
+		}
+
+		void push(const read_score_t& score, unsigned int read) {
+			assert(positions[read] == NOT_QUEUED);
+			heap.push_back(entry_t(score, read));
+			positions[read] = heap.size() - 1;
+			sift_up(heap.size() - 1);
+		}
+
+		/** Removes the read with the highest score and returns it. */
+		unsigned int pop() {
+			assert(!heap.empty());
+			unsigned int read = heap[0].second;
+			positions[read] = NOT_QUEUED;
+			if (heap.size() == 1) {
+				heap.pop_back();
+			} else {
+				heap[0] = heap.back();
+				heap.pop_back();
+				positions[heap[0].second] = 0;
+				sift_down(0);
+			}
+			return read;
+		}
+
+		bool contains(unsigned int read) const {
+			return positions[read] != NOT_QUEUED;
+		}
+
+		const read_score_t& get_score(unsigned int read) const {
+			assert(contains(read));
+			return heap[positions[read]].first;
+		}
+
+		void change_score(unsigned int read, const read_score_t& score) {
+			assert(contains(read));
+			size_t index = positions[read];
+			bool increased = heap[index].first < score;
+			heap[index].first = score;
+			if (increased) {
+				sift_up(index);
+			} else {
+				sift_down(index);
+			}
+		}
+
+	private:
+		typedef pair<read_score_t, unsigned int> entry_t;
+		static const size_t NOT_QUEUED = (size_t)-1;
+
+		vector<entry_t> heap;
+		// position of each read in the heap, or NOT_QUEUED
+		vector<size_t> positions;
+
+		bool lower(size_t index1, size_t index2) const {
+			const entry_t& entry1 = heap[index1];
+			const entry_t& entry2 = heap[index2];
+			if (entry1.first < entry2.first) return true;
+			if (entry2.first < entry1.first) return false;
+			return entry1.second > entry2.second;
+		}
+
+		void swap_entries(size_t index1, size_t index2) {
+			swap(heap[index1], heap[index2]);
+			positions[heap[index1].second] = index1;
+			positions[heap[index2].second] = index2;
+		}
+
+		void sift_up(size_t index) {
+			while (index > 0) {
+				size_t parent = (index - 1) / 2;
+				if (!lower(parent, index)) break;
+				swap_entries(parent, index);
+				index = parent;
+			}
+		}
+
+		void sift_down(size_t index) {
+			while (true) {
+				size_t left = 2 * index + 1;
+				size_t right = 2 * index + 2;
+				size_t child;
+				if (right < heap.size()) {
+					child = lower(left, right) ? right : left;
+				} else if (left < heap.size()) {
+					child = left;
+				} else {
+					break;
+				}
+				if (!lower(index, child)) break;
+				swap_entries(index, child);
+				index = child;
+			}
+		}
+	};
+
+	// definition needed since the constructor binds a reference to it
+	const size_t ReadQueue::NOT_QUEUED;
+
+
+	/** Union-find over variant indices in which each set is represented by its smallest element. */
+	class BlockFinder {
+	public:
+		BlockFinder(size_t variant_count) : parents(variant_count) {
+			for (size_t i=0; i<variant_count; ++i) {
+				parents[i] = i;
+			}
+		}
+
+		unsigned int find(unsigned int x) {
+			unsigned int root = x;
+			while (parents[root] != root) {
+				root = parents[root];
+			}
+			while (parents[x] != root) {
+				unsigned int next = parents[x];
+				parents[x] = root;
+				x = next;
+			}
+			return root;
+		}
+
+		void merge(unsigned int x, unsigned int y) {
+			unsigned int x_root = find(x);
+			unsigned int y_root = find(y);
+			if (x_root < y_root) {
+				parents[y_root] = x_root;
+			} else {
+				parents[x_root] = y_root;
+			}
+		}
+
+	private:
+		vector<unsigned int> parents;
+	};
+
+
+	class ReadSelector {
+	public:
+		/** If max_coverages is null, max_coverage applies to all variants. */
+		ReadSelector(const ReadSet& readset, unsigned int max_coverage, const vector<unsigned int>* max_coverages, bool bridging, vector<read_selection_round_t>* rounds);
+
+		/** Runs rounds of selection until all reads flagged in undecided have been decided,
+		 *  clearing their flags. */
+		void select(vector<bool>* undecided);
+
+		const vector<bool>& get_selected() const {
+			return selected;
+		}
+
+	private:
+		// maximum coverage of each variant
+		vector<unsigned int> max_coverages;
+		bool bridging;
+		vector<read_selection_round_t>* rounds;
+		size_t read_count;
+		size_t variant_count;
+		// variant indices covered by read i are read_variants[read_offsets[i]], ..., read_variants[read_offsets[i+1]-1]
+		vector<size_t> read_offsets;
+		vector<unsigned int> read_variants;
+		// reads covering variant j are variant_reads[variant_offsets[j]], ..., variant_reads[variant_offsets[j+1]-1]
+		vector<size_t> variant_offsets;
+		vector<unsigned int> variant_reads;
+		vector<read_score_t> initial_scores;
+		// number of selected reads spanning each variant
+		vector<unsigned int> coverage;
+		vector<bool> selected;
+
+		unsigned int first_variant(unsigned int read) const {
+			return read_variants[read_offsets[read]];
+		}
+
+		unsigned int last_variant(unsigned int read) const {
+			return read_variants[read_offsets[read+1] - 1];
+		}
+
+		bool violates_coverage(unsigned int read) const {
+			for (unsigned int j = first_variant(read); j <= last_variant(read); ++j) {
+				if (coverage[j] >= max_coverages[j]) return true;
+			}
+			return false;
+		}
+
+		void add_coverage(unsigned int read) {
+			for (unsigned int j = first_variant(read); j <= last_variant(read); ++j) {
+				coverage[j] += 1;
+			}
+		}
+
+		void merge_blocks(unsigned int read, BlockFinder* blocks) const {
+			for (size_t k = read_offsets[read] + 1; k < read_offsets[read+1]; ++k) {
+				blocks->merge(first_variant(read), read_variants[k]);
+			}
+		}
+
+		unique_ptr<ReadQueue> make_queue(const vector<bool>& undecided) const;
+
+		/** Picks reads as long as they cover new variants. Reads that violate the coverage
+		 *  constraint are appended to violating_reads. */
+		void select_covering_reads(ReadQueue* queue, vector<unsigned int>* covering_reads, vector<unsigned int>* violating_reads);
+	};
+
+
+	ReadSelector::ReadSelector(const ReadSet& readset, unsigned int max_coverage, const vector<unsigned int>* max_coverages, bool bridging, vector<read_selection_round_t>* rounds) :
+		bridging(bridging),
+		rounds(rounds),
+		read_count(readset.size())
+	{
+		unique_ptr<vector<unsigned int> > positions(readset.get_positions());
+		variant_count = positions->size();
+		if (max_coverages == nullptr) {
+			this->max_coverages.assign(variant_count, max_coverage);
+		} else if (max_coverages->size() != variant_count) {
+			throw std::invalid_argument("readselection expects a maximum coverage for each variant");
+		} else {
+			this->max_coverages = *max_coverages;
+		}
+		read_offsets.reserve(read_count + 1);
+		read_offsets.push_back(0);
+		initial_scores.resize(read_count);
+		vector<size_t> variant_read_counts(variant_count, 0);
+		for (size_t i=0; i<read_count; ++i) {
+			const Read* read = readset.get(i);
+			if (read->getVariantCount() < 2) {
+				throw std::invalid_argument("readselection expects reads that cover at least two variants");
+			}
+			int min_quality = read->getVariantQuality(0);
+			for (int k=0; k<read->getVariantCount(); ++k) {
+				unsigned int j = lower_bound(positions->begin(), positions->end(), (unsigned int)read->getPosition(k)) - positions->begin();
+				assert((j < variant_count) && ((*positions)[j] == (unsigned int)read->getPosition(k)));
+				read_variants.push_back(j);
+				variant_read_counts[j] += 1;
+				min_quality = min(min_quality, read->getVariantQuality(k));
+			}
+			read_offsets.push_back(read_variants.size());
+			// the score is (good - bad, good - bad, minimum quality), where good is the number of
+			// covered variants and bad is the number of those spanned, but not covered
+			int good_score = read->getVariantCount();
+			int bad_score = ((int)last_variant(i) - (int)first_variant(i) + 1) - good_score;
+			initial_scores[i].new_score = good_score - bad_score;
+			initial_scores[i].total_score = good_score - bad_score;
+			initial_scores[i].min_quality = min_quality;
+		}
+		variant_offsets.reserve(variant_count + 1);
+		variant_offsets.push_back(0);
+		for (size_t j=0; j<variant_count; ++j) {
+			variant_offsets.push_back(variant_offsets.back() + variant_read_counts[j]);
+		}
+		variant_reads.resize(read_variants.size());
+		vector<size_t> next(variant_offsets.begin(), variant_offsets.end() - 1);
+		for (size_t i=0; i<read_count; ++i) {
+			for (size_t k = read_offsets[i]; k < read_offsets[i+1]; ++k) {
+				variant_reads[next[read_variants[k]]++] = i;
+			}
+		}
+		coverage.assign(variant_count, 0);
+		selected.assign(read_count, false);
+	}
+
+
+	unique_ptr<ReadQueue> ReadSelector::make_queue(const vector<bool>& undecided) const {
+		unique_ptr<ReadQueue> queue(new ReadQueue(read_count));
+		for (size_t i=0; i<read_count; ++i) {
+			if (undecided[i]) {
+				queue->push(initial_scores[i], i);
+			}
+		}
+		return queue;
+	}
+
+
+	void ReadSelector::select_covering_reads(ReadQueue* queue, vector<unsigned int>* covering_reads, vector<unsigned int>* violating_reads) {
+		// variants covered by any read selected so far in this round
+		vector<bool> covered(variant_count, false);
+		// variants covered by the current read that were not covered before
+		vector<bool> newly_covered(variant_count, false);
+		vector<unsigned int> new_variants;
+		vector<bool> affected(read_count, false);
+		vector<unsigned int> affected_reads;
+		while (!queue->empty()) {
+			unsigned int read = queue->pop();
+			new_variants.clear();
+			for (size_t k = read_offsets[read]; k < read_offsets[read+1]; ++k) {
+				if (!covered[read_variants[k]]) {
+					new_variants.push_back(read_variants[k]);
+				}
+			}
+			// only add read if it covers at least one new variant and adding it does not violate coverage constraints
+			if (violates_coverage(read)) {
+				violating_reads->push_back(read);
+				continue;
+			}
+			if (new_variants.empty()) {
+				continue;
+			}
+			add_coverage(read);
+			covering_reads->push_back(read);
+			for (unsigned int j : new_variants) {
+				covered[j] = true;
+				newly_covered[j] = true;
+				for (size_t k = variant_offsets[j]; k < variant_offsets[j+1]; ++k) {
+					unsigned int other = variant_reads[k];
+					if (!affected[other]) {
+						affected[other] = true;
+						affected_reads.push_back(other);
+					}
+				}
+			}
+			// update scores of queued reads covering one of the new variants: their first score is
+			// decreased by the number of their variants that are not among the new variants
+			sort(affected_reads.begin(), affected_reads.end());
+			for (unsigned int other : affected_reads) {
+				affected[other] = false;
+				if (!queue->contains(other)) {
+					continue;
+				}
+				read_score_t score = queue->get_score(other);
+				for (size_t k = read_offsets[other]; k < read_offsets[other+1]; ++k) {
+					if (!newly_covered[read_variants[k]]) {
+						score.new_score -= 1;
+					}
+				}
+				queue->change_score(other, score);
+			}
+			affected_reads.clear();
+			for (unsigned int j : new_variants) {
+				newly_covered[j] = false;
+			}
+		}
+	}
+
+
+	void ReadSelector::select(vector<bool>* undecided) {
+		size_t undecided_count = count(undecided->begin(), undecided->end(), true);
+		while (undecided_count > 0) {
+			read_selection_round_t round;
+			vector<unsigned int> violating_reads;
+			unique_ptr<ReadQueue> queue = make_queue(*undecided);
+			select_covering_reads(queue.get(), &round.covering_reads, &violating_reads);
+			BlockFinder blocks(variant_count);
+			for (unsigned int read : round.covering_reads) {
+				selected[read] = true;
+				(*undecided)[read] = false;
+				merge_blocks(read, &blocks);
+			}
+			for (unsigned int read : violating_reads) {
+				(*undecided)[read] = false;
+			}
+			undecided_count -= round.covering_reads.size() + violating_reads.size();
+
+			if (bridging) {
+				queue = make_queue(*undecided);
+				while (!queue->empty()) {
+					unsigned int read = queue->pop();
+					// check whether read meets coverage constraints
+					if (violates_coverage(read)) {
+						(*undecided)[read] = false;
+						undecided_count -= 1;
+						continue;
+					}
+					// skip read if it only covers one block
+					unsigned int block = blocks.find(first_variant(read));
+					bool bridges = false;
+					for (size_t k = read_offsets[read] + 1; k < read_offsets[read+1]; ++k) {
+						if (blocks.find(read_variants[k]) != block) {
+							bridges = true;
+							break;
+						}
+					}
+					if (!bridges) {
+						continue;
+					}
+					round.bridging_reads.push_back(read);
+					selected[read] = true;
+					add_coverage(read);
+					(*undecided)[read] = false;
+					undecided_count -= 1;
+					merge_blocks(read, &blocks);
+				}
+			}
+			round.undecided = undecided_count;
+			if (rounds != nullptr) {
+				rounds->push_back(round);
+			}
+		}
+	}
+}
+
+
+namespace {
+	vector<unsigned int> run_selection(ReadSelector* selector, const ReadSet& readset, const unordered_set<int>* preferred_source_ids) {
+		vector<bool> preferred(readset.size(), false);
+		bool has_preferred = false;
+		if (preferred_source_ids != nullptr) {
+			for (size_t i=0; i<readset.size(); ++i) {
+				if (preferred_source_ids->count(readset.get(i)->getSourceID()) > 0) {
+					preferred[i] = true;
+					has_preferred = true;
+				}
+			}
+		}
+		if (has_preferred) {
+			selector->select(&preferred);
+		}
+		// preferred reads remain candidates for the following rounds
+		vector<bool> undecided(readset.size(), true);
+		selector->select(&undecided);
+
+		vector<unsigned int> result;
+		const vector<bool>& selected = selector->get_selected();
+		for (size_t i=0; i<selected.size(); ++i) {
+			if (selected[i]) {
+				result.push_back(i);
+			}
+		}
+		return result;
+	}
+}
+
+
+vector<unsigned int> select_reads(const ReadSet& readset, unsigned int max_coverage, const unordered_set<int>* preferred_source_ids, bool bridging, vector<read_selection_round_t>* rounds) {
+	ReadSelector selector(readset, max_coverage, nullptr, bridging, rounds);
+	return run_selection(&selector, readset, preferred_source_ids);
+}
+
+
+vector<unsigned int> select_reads(const ReadSet& readset, const vector<unsigned int>& max_coverages, const unordered_set<int>* preferred_source_ids, bool bridging, vector<read_selection_round_t>* rounds) {
+	ReadSelector selector(readset, 0, &max_coverages, bridging, rounds);
+	return run_selection(&selector, readset, preferred_source_ids);
+}
+
+
+size_t estimate_column_memory(unsigned int read_count, unsigned int transmission_configurations) {
+	size_t rows = (size_t)1 << read_count;
+	unsigned int configuration_bits = 0;
+	while ((1u << configuration_bits) < transmission_configurations) {
+		configuration_bits += 1;
+	}
+	size_t bits = 8 * sizeof(unsigned int) + read_count + configuration_bits;
+	return (rows * transmission_configurations * bits + 7) / 8;
+}
+
+
+vector<coverage_limit_t> choose_coverage_limits(const ReadSet& readset, unsigned int min_coverage, unsigned int max_coverage, unsigned int transmission_configurations, size_t memory_budget, unsigned int window_size, size_t* memory) {
+	if ((min_coverage > max_coverage) || (window_size == 0)) {
+		throw std::invalid_argument("choose_coverage_limits: invalid coverage range or window size");
+	}
+	unique_ptr<vector<unsigned int> > positions(readset.get_positions());
+	size_t variant_count = positions->size();
+	// number of reads spanning each variant
+	vector<int> depth_changes(variant_count + 1, 0);
+	for (size_t i=0; i<readset.size(); ++i) {
+		const Read* read = readset.get(i);
+		if (read->getVariantCount() == 0) continue;
+		size_t first = lower_bound(positions->begin(), positions->end(), (unsigned int)read->getPosition(0)) - positions->begin();
+		size_t last = lower_bound(positions->begin(), positions->end(), (unsigned int)read->getPosition(read->getVariantCount() - 1)) - positions->begin();
+		depth_changes[first] += 1;
+		depth_changes[last + 1] -= 1;
+	}
+	vector<unsigned int> depths(variant_count);
+	int depth = 0;
+	for (size_t j=0; j<variant_count; ++j) {
+		depth += depth_changes[j];
+		depths[j] = depth;
+	}
+
+	size_t window_count = (variant_count + window_size - 1) / window_size;
+	vector<unsigned int> limits(window_count, min_coverage);
+	size_t total = 0;
+	for (size_t j=0; j<variant_count; ++j) {
+		total += estimate_column_memory(min(depths[j], min_coverage), transmission_configurations);
+	}
+	// windows that can be raised, by (current maximum, window)
+	typedef pair<unsigned int, size_t> candidate_t;
+	priority_queue<candidate_t, vector<candidate_t>, greater<candidate_t> > candidates;
+	for (size_t w=0; w<window_count; ++w) {
+		candidates.push(candidate_t(min_coverage, w));
+	}
+	while (!candidates.empty()) {
+		size_t w = candidates.top().second;
+		candidates.pop();
+		unsigned int limit = limits[w];
+		if (limit >= max_coverage) continue;
+		size_t increase = 0;
+		size_t end = min(variant_count, (w + 1) * window_size);
+		for (size_t j = w * window_size; j < end; ++j) {
+			if (depths[j] > limit) {
+				increase += estimate_column_memory(limit + 1, transmission_configurations) - estimate_column_memory(limit, transmission_configurations);
+			}
+		}
+		if ((increase == 0) || (total + increase > memory_budget)) continue;
+		total += increase;
+		limits[w] = limit + 1;
+		candidates.push(candidate_t(limit + 1, w));
+	}
+
+	vector<coverage_limit_t> result;
+	for (size_t w=0; w<window_count; ++w) {
+		if (result.empty() || (result.back().max_coverage != limits[w])) {
+			result.push_back(coverage_limit_t((*positions)[w * window_size], limits[w]));
+		}
+	}
+	if (memory != nullptr) {
+		*memory = total;
+	}
+	return result;
+}
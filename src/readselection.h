@@ -0,0 +1,70 @@
+#ifndef READ_SELECTION_H
+#define READ_SELECTION_H
+
+#include <vector>
+#include <unordered_set>
+
+#include "readset.h"
+
+/** Reads chosen in one round of read selection. */
+typedef struct read_selection_round_t {
+	// reads selected to cover variants not covered by any other read selected in this round
+	std::vector<unsigned int> covering_reads;
+	// reads selected to connect blocks of variants
+	std::vector<unsigned int> bridging_reads;
+	// number of reads that remain undecided after this round
+	size_t undecided;
+	read_selection_round_t() : undecided(0) {}
+} read_selection_round_t;
+
+/** Greedily selects reads (given by their indices in readset) such that the coverage (in terms of
+ *  spanned variants) nowhere exceeds max_coverage. Selection proceeds in rounds. A round first picks
+ *  the best reads (by the score (new - gaps, total - gaps, minimum quality), where new is the number of
+ *  variants not covered by reads selected earlier in the round, gaps is the number of variants spanned
+ *  but not covered) as long as they cover a new variant, and then, if bridging is enabled, adds reads that
+ *  connect blocks of variants covered by these reads. Reads from one of the preferred sources (if given)
+ *  are selected first. Ties are broken in the order of the reads in the ReadSet.
+ *
+ *  All reads need to cover at least two variants, otherwise std::invalid_argument is thrown.
+ *
+ *  @param rounds If not null, the reads chosen in each round are appended to it.
+ *  @return The indices of all selected reads in ascending order.
+ */
+std::vector<unsigned int> select_reads(const ReadSet& readset, unsigned int max_coverage, const std::unordered_set<int>* preferred_source_ids = nullptr, bool bridging = true, std::vector<read_selection_round_t>* rounds = nullptr);
+
+/** Like select_reads above, but with a maximum coverage for each variant (in the order of
+ *  readset.get_positions()) instead of one for all variants. A read is selected only if the
+ *  coverage stays below the maximum of every variant it spans. */
+std::vector<unsigned int> select_reads(const ReadSet& readset, const std::vector<unsigned int>& max_coverages, const std::unordered_set<int>* preferred_source_ids = nullptr, bool bridging = true, std::vector<read_selection_round_t>* rounds = nullptr);
+
+/** Maximum coverage for the variants from position on (up to the next limit). */
+typedef struct coverage_limit_t {
+	unsigned int position;
+	unsigned int max_coverage;
+	coverage_limit_t(unsigned int position, unsigned int max_coverage) : position(position), max_coverage(max_coverage) {}
+} coverage_limit_t;
+
+/** Estimates the memory (in bytes) needed to store a column of PedigreeDPTable in which the
+ *  given number of reads is active: the column has 2^read_count rows and an entry for each
+ *  row and transmission configuration, which (like PedigreeDPTable::column_memory) takes a
+ *  cost and backtrace indices into the column and the configurations. The time needed to
+ *  compute the column is proportional. */
+size_t estimate_column_memory(unsigned int read_count, unsigned int transmission_configurations);
+
+/** Chooses a maximum coverage for each window of window_size consecutive variants of the
+ *  readset such that the estimated memory (see estimate_column_memory) of the DP table
+ *  computed from the selected reads stays within memory_budget, assuming that every variant
+ *  is then spanned by min(coverage, maximum) selected reads. Starting from min_coverage
+ *  everywhere, the lowest maximum of a window in which some variant is spanned by more reads
+ *  is repeatedly raised by one (up to max_coverage, ties broken by position) if the estimate
+ *  stays within the budget, which retains the most coverage per byte. Windows with low
+ *  coverage thus leave more of the budget to windows with high coverage (such as repeats),
+ *  and maxima are lower if there are many variants. If even min_coverage exceeds the budget,
+ *  it is used anyway.
+ *
+ *  @param memory If not null, the estimated memory for the chosen limits is stored there.
+ *  @return Limits with increasing positions; the first one is at the first variant.
+ */
+std::vector<coverage_limit_t> choose_coverage_limits(const ReadSet& readset, unsigned int min_coverage, unsigned int max_coverage, unsigned int transmission_configurations, size_t memory_budget, unsigned int window_size, size_t* memory = nullptr);
+
+#endif
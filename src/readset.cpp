@@ -1,13 +1,81 @@
 #include <sstream>
+#include <cassert>
 #include <stdexcept>
 #include <algorithm>
 #include <unordered_set>
 #include <iomanip>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <functional>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "readset.h"
 
 using namespace std;
 
+namespace {
+	const char SERIALIZATION_MAGIC[4] = {'W', 'H', 'R', 'S'};
+	const uint32_t SERIALIZATION_VERSION = 1;
+
+	template <typename T>
+	void write_value(string* out, T value) {
+		out->append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	void write_string(string* out, const string& s) {
+		write_value<uint32_t>(out, s.size());
+		out->append(s);
+	}
+
+	/** Reads values from a buffer, checking that it is not exceeded. */
+	class buffer_reader_t {
+	public:
+		buffer_reader_t(const char* data, size_t size) : data(data), size(size), offset(0) {}
+
+		template <typename T>
+		T read_value() {
+			check_available(sizeof(T));
+			T value;
+			memcpy(&value, data + offset, sizeof(T));
+			offset += sizeof(T);
+			return value;
+		}
+
+		string read_string() {
+			uint32_t length = read_value<uint32_t>();
+			check_available(length);
+			string s(data + offset, length);
+			offset += length;
+			return s;
+		}
+
+		void skip(size_t length) {
+			check_available(length);
+			offset += length;
+		}
+
+		bool at_end() const {
+			return offset == size;
+		}
+
+	private:
+		const char* data;
+		size_t size;
+		size_t offset;
+
+		void check_available(size_t length) const {
+			if (size - offset < length) {
+				throw std::runtime_error("ReadSet::deserialize: unexpected end of data.");
+			}
+		}
+	};
+}
+
 ReadSet::ReadSet() {
 }
 
@@ -20,7 +88,7 @@ ReadSet::~ReadSet() {
 
 
 void ReadSet::add(Read* read) {
-	name_and_source_id_t name_and_source_id = name_and_source_id_t(read->getName(), read->getSourceID());
+	name_and_source_id_t name_and_source_id = name_and_source_id_t(&read->getName(), read->getSourceID());
 	if (read_name_map.find(name_and_source_id) != read_name_map.end()) {
 		throw std::runtime_error("ReadSet::add: duplicate read name.");
 	}
@@ -41,12 +109,21 @@ string ReadSet::toString() {
 
 void ReadSet::sort() {
 	// Sort the reads by position
-	std::sort(reads.begin(), reads.end(), read_comparator_t());
-	
-	// Update read_name_map
-	read_name_map.clear();
-	for (size_t i=0; i<reads.size(); ++i) {
-		read_name_map[name_and_source_id_t(reads[i]->getName(), reads[i]->getSourceID())] = i;
+	name_and_source_id_hasher_t hasher;
+	vector<read_sort_key_t> keys;
+	keys.reserve(reads.size());
+	for (Read* read : reads) {
+		keys.emplace_back(read, hasher(name_and_source_id_t(&read->getName(), read->getSourceID())));
+	}
+	if (std::is_sorted(keys.begin(), keys.end())) {
+		return;
+	}
+	std::sort(keys.begin(), keys.end());
+
+	// Update read_name_map (its keys refer to names owned by the reads, which do not move)
+	for (size_t i=0; i<keys.size(); ++i) {
+		reads[i] = keys[i].read;
+		read_name_map.find(name_and_source_id_t(&reads[i]->getName(), reads[i]->getSourceID()))->second = i;
 	}
 }
 
@@ -73,7 +150,7 @@ Read* ReadSet::get(int i) const {
 
 
 Read* ReadSet::getByName(std::string name, int source_id) const {
-	read_name_map_t::const_iterator it = read_name_map.find(name_and_source_id_t(name,source_id));
+	read_name_map_t::const_iterator it = read_name_map.find(name_and_source_id_t(&name, source_id));
 	if (it == read_name_map.end()) {
 		return 0;
 	} else {
@@ -96,4 +173,112 @@ void ReadSet::reassignReadIds() {
 	for (size_t i=0; i<reads.size(); ++i) {
 		reads[i]->setID(i);
 	}
-}
\ No newline at end of file
+}
+
+string ReadSet::serialize() const {
+	size_t size = sizeof(SERIALIZATION_MAGIC) + sizeof(uint32_t) + sizeof(uint64_t);
+	for (const Read* read : reads) {
+		size += 4 * sizeof(uint32_t) + read->getName().size() + read->getBXTag().size() + 3 * sizeof(int32_t);
+		size += read->getMapqs().size() * sizeof(int32_t) + read->getVariantCount() * 3 * sizeof(int32_t);
+	}
+	string out;
+	out.reserve(size);
+	out.append(SERIALIZATION_MAGIC, sizeof(SERIALIZATION_MAGIC));
+	write_value<uint32_t>(&out, SERIALIZATION_VERSION);
+	write_value<uint64_t>(&out, reads.size());
+	for (const Read* read : reads) {
+		write_string(&out, read->getName());
+		write_string(&out, read->getBXTag());
+		write_value<int32_t>(&out, read->getSourceID());
+		write_value<int32_t>(&out, read->getSampleID());
+		write_value<int32_t>(&out, read->getReferenceStart());
+		const vector<int>& mapqs = read->getMapqs();
+		write_value<uint32_t>(&out, mapqs.size());
+		for (int mapq : mapqs) {
+			write_value<int32_t>(&out, mapq);
+		}
+		write_value<uint32_t>(&out, read->getVariantCount());
+		for (int i=0; i<read->getVariantCount(); ++i) {
+			write_value<int32_t>(&out, read->getPosition(i));
+			write_value<int32_t>(&out, read->getAllele(i));
+			write_value<int32_t>(&out, read->getVariantQuality(i));
+		}
+	}
+	assert(out.size() == size);
+	return out;
+}
+
+
+ReadSet* ReadSet::deserialize(const string& data) {
+	return deserialize(data.data(), data.size(), -1);
+}
+
+
+ReadSet* ReadSet::load(const string& path, int sample_id) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd == -1) {
+		throw std::runtime_error("Could not open ReadSet file " + path);
+	}
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) == -1) {
+		close(fd);
+		throw std::runtime_error("Could not read ReadSet file " + path);
+	}
+	size_t size = file_stat.st_size;
+	if (size == 0) {
+		close(fd);
+		throw std::runtime_error("ReadSet::deserialize: not a serialized ReadSet.");
+	}
+	void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		throw std::runtime_error("Could not memory-map ReadSet file " + path);
+	}
+	unique_ptr<void, function<void(void*)>> unmap(mapping, [size](void* p) { munmap(p, size); });
+	return deserialize((const char*)mapping, size, sample_id);
+}
+
+
+ReadSet* ReadSet::deserialize(const char* data, size_t size, int sample_id) {
+	if ((size < sizeof(SERIALIZATION_MAGIC)) || (memcmp(data, SERIALIZATION_MAGIC, sizeof(SERIALIZATION_MAGIC)) != 0)) {
+		throw std::runtime_error("ReadSet::deserialize: not a serialized ReadSet.");
+	}
+	buffer_reader_t in(data, size);
+	in.skip(sizeof(SERIALIZATION_MAGIC));
+	if (in.read_value<uint32_t>() != SERIALIZATION_VERSION) {
+		throw std::runtime_error("ReadSet::deserialize: unsupported version.");
+	}
+	uint64_t read_count = in.read_value<uint64_t>();
+	unique_ptr<ReadSet> result(new ReadSet());
+	for (uint64_t i=0; i<read_count; ++i) {
+		string name = in.read_string();
+		string BX_tag = in.read_string();
+		int source_id = in.read_value<int32_t>();
+		int read_sample_id = in.read_value<int32_t>();
+		if (sample_id >= 0) {
+			read_sample_id = sample_id;
+		}
+		int reference_start = in.read_value<int32_t>();
+		uint32_t mapq_count = in.read_value<uint32_t>();
+		if (mapq_count == 0) {
+			throw std::runtime_error("ReadSet::deserialize: read without mapping quality.");
+		}
+		unique_ptr<Read> read(new Read(name, in.read_value<int32_t>(), source_id, read_sample_id, reference_start, BX_tag));
+		for (uint32_t j=1; j<mapq_count; ++j) {
+			read->addMapq(in.read_value<int32_t>());
+		}
+		uint32_t variant_count = in.read_value<uint32_t>();
+		for (uint32_t j=0; j<variant_count; ++j) {
+			int position = in.read_value<int32_t>();
+			int allele = in.read_value<int32_t>();
+			int quality = in.read_value<int32_t>();
+			read->addVariant(position, allele, quality);
+		}
+		result->add(read.get());
+		read.release();
+	}
+	if (!in.at_end()) {
+		throw std::runtime_error("ReadSet::deserialize: trailing data.");
+	}
+	return result.release();
+}
@@ -1,6 +1,7 @@
 #ifndef READSET_H
 #define READSET_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -16,7 +17,8 @@ public:
 	virtual ~ReadSet();
 	/** Ownership of pointer is transferred from caller to the ReadSet. */
 	void add(Read* read);
-	/** Sort reads by first variant position. */
+	/** Sort reads by first variant position. Reads that are added in sorted order (such as
+	 *  reads detected in coordinate-sorted alignments) are not reordered. */
 	void sort();
 	/** Returns the set of SNP positions. To create this set,
 	 *  this method iterates over all contained reads.
@@ -29,54 +31,68 @@ public:
 	/** Access a read in the set by its name. Ownership stays with the ReadSet. */
 	Read* getByName(std::string name, int source_id) const;
 	/** Creates a subset of reads as given by the set of indices. Note that this
-	 *  creates a COPY of each read.
+	 *  creates a COPY of each read. Copies share their variants with the original
+	 *  reads until either of them is modified, so this does not copy any variants.
 	 */
 	ReadSet* subset(const IndexSet* indices) const;
 	/** Assigns read_ids to all instances of Entry stored in the reads such that
 	 *  each read_id matches the index of the corresponding read in the ReadSet. */
 	void reassignReadIds();
+	/** Returns a compact binary representation of all reads (names, BX tags, source and
+	 *  sample ids, reference starts, mapping qualities and variants; read ids are not
+	 *  stored). Integers are stored in native byte order. */
+	std::string serialize() const;
+	/** Creates a ReadSet from the output of serialize(). Caller owns the returned pointer.
+	 *  Throws std::runtime_error if the data is malformed. */
+	static ReadSet* deserialize(const std::string& data);
+	/** Creates a ReadSet from a file containing the output of serialize(), which is memory-mapped
+	 *  while reading. If sample_id is not negative, it replaces the sample ids of all reads.
+	 *  Caller owns the returned pointer. Throws std::runtime_error if the file cannot be read or
+	 *  is malformed. */
+	static ReadSet* load(const std::string& path, int sample_id = -1);
 private:
-	typedef struct read_comparator_t {
-		read_comparator_t() {}
-		bool operator()(const Read* r1, const Read* r2) {
-			if ((r1->getVariantCount() > 0) || (r2->getVariantCount() > 0)) {
-				// put reads with no variants first in the set
-				if (r1->getVariantCount() == 0) return true;
-				if (r2->getVariantCount() == 0) return false;
-				// standard case: sort by positions
-				if (r1->firstPosition() != r2->firstPosition()) {
-					return r1->firstPosition() < r2->firstPosition();
-				}
+	static ReadSet* deserialize(const char* data, size_t size, int sample_id);
+
+	// Sort key of a read, computed once per read such that sorting does not repeatedly hash
+	// read names. Reads with no variants come first; ties are broken by the hash value of
+	// name and source id and, in the extremely unlikely case of a hash collision, by name
+	// and source id.
+	typedef struct read_sort_key_t {
+		read_sort_key_t(Read* read, size_t hash) :
+			read(read),
+			position(read->getVariantCount() > 0 ? (int64_t)read->firstPosition() : INT64_MIN),
+			hash(hash) {}
+		bool operator<(const read_sort_key_t& other) const {
+			if (position != other.position) {
+				return position < other.position;
 			}
-			// break ties by using hash value
-			name_and_source_id_hasher_t hasher;
-			std::size_t hash1 = hasher(name_and_source_id_t(r1->getName(), r1->getSourceID()));
-			std::size_t hash2 = hasher(name_and_source_id_t(r2->getName(), r2->getSourceID()));
-			if (hash1 != hash2) {
-				return hash1 < hash2;
+			if (hash != other.hash) {
+				return hash < other.hash;
 			}
-			// this is the extremely unlikely case of a hash collision
-			// ressort to comparing names and source_ids.
-			int name_cmp = r1->getName().compare(r2->getName());
+			int name_cmp = read->getName().compare(other.read->getName());
 			if (name_cmp != 0) {
 				return name_cmp < 0;
 			}
-			return r1->getSourceID() < r2->getSourceID();
+			return read->getSourceID() < other.read->getSourceID();
 		}
-	} read_comparator_t;
+		Read* read;
+		int64_t position;
+		std::size_t hash;
+	} read_sort_key_t;
 
+	// Refers to the name of a read (owned by the read) instead of copying it
 	typedef struct name_and_source_id_t {
-		name_and_source_id_t(std::string name, int source_id) : name(name), source_id(source_id) {}
+		name_and_source_id_t(const std::string* name, int source_id) : name(name), source_id(source_id) {}
 		bool operator==(const name_and_source_id_t& other) const {
-			return (name.compare(other.name) == 0) && (source_id == other.source_id);
+			return (name->compare(*other.name) == 0) && (source_id == other.source_id);
 		}
-		std::string name;
+		const std::string* name;
 		int source_id;
 	} name_and_source_id_t;
 
 	typedef struct name_and_source_id_hasher_t {
 		std::size_t operator()(const name_and_source_id_t& x) const {
-			return (std::hash<std::string>()(x.name)) ^ (std::hash<int>()(x.source_id));
+			return (std::hash<std::string>()(*x.name)) ^ (std::hash<int>()(x.source_id));
 		}
 	} name_and_source_id_hasher_t;
 
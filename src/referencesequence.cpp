@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "referencesequence.h"
+
+using namespace std;
+
+ReferenceSequence::ReferenceSequence(const string& sequence) :
+	length(sequence.size()),
+	offset(0),
+	line_bases(0),
+	line_width(0),
+	mapping(nullptr),
+	mapping_length(0),
+	data(nullptr)
+{
+	this->sequence.reserve(sequence.size());
+	for (char c : sequence) {
+		this->sequence.push_back(toupper((unsigned char)c));
+	}
+	data = this->sequence.data();
+}
+
+
+ReferenceSequence::ReferenceSequence(const string& path, size_t length, uint64_t offset, size_t line_bases, size_t line_width) :
+	length(length),
+	path(path),
+	offset(offset),
+	line_bases(line_bases),
+	line_width(line_width),
+	mapping(nullptr),
+	mapping_length(0),
+	data(nullptr)
+{
+	if ((length > 0) && ((line_bases == 0) || (line_width < line_bases))) {
+		throw std::runtime_error("Invalid FASTA index entry for " + path);
+	}
+	// bytes from the first to the last base
+	uint64_t record_bytes = (length == 0) ? 0 : ((length - 1) / line_bases) * line_width + (length - 1) % line_bases + 1;
+	if (record_bytes == 0) {
+		return;
+	}
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd == -1) {
+		throw std::runtime_error("Could not open FASTA file " + path);
+	}
+	struct stat file_stat;
+	if ((fstat(fd, &file_stat) == -1) || ((uint64_t)file_stat.st_size < offset + record_bytes)) {
+		close(fd);
+		throw std::runtime_error("FASTA file " + path + " is shorter than given by its index");
+	}
+	// the mapping needs to start at a multiple of the page size
+	uint64_t page_size = sysconf(_SC_PAGESIZE);
+	uint64_t mapping_offset = offset - offset % page_size;
+	mapping_length = offset + record_bytes - mapping_offset;
+	mapping = mmap(nullptr, mapping_length, PROT_READ, MAP_SHARED, fd, mapping_offset);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		mapping = nullptr;
+		throw std::runtime_error("Could not memory-map FASTA file " + path);
+	}
+	data = (const char*)mapping + (offset - mapping_offset);
+}
+
+
+ReferenceSequence::~ReferenceSequence() {
+	if (mapping != nullptr) {
+		munmap(mapping, mapping_length);
+	}
+}
+
+
+size_t ReferenceSequence::size() const {
+	return length;
+}
+
+
+bool ReferenceSequence::is_mapped() const {
+	return !path.empty();
+}
+
+
+void ReferenceSequence::append(long start, long end, string& result) const {
+	start = max(0L, min(start, (long)length));
+	end = min(end, (long)length);
+	if (start >= end) {
+		return;
+	}
+	if (!is_mapped()) {
+		result.append(sequence, start, end - start);
+		return;
+	}
+	result.reserve(result.size() + (end - start));
+	size_t position = start;
+	while (position < (size_t)end) {
+		// copy the remainder of the line that contains position
+		size_t line = position / line_bases;
+		size_t column = position % line_bases;
+		size_t count = min(line_bases - column, (size_t)end - position);
+		const char* bases = data + line * line_width + column;
+		for (size_t i = 0; i < count; ++i) {
+			result.push_back(toupper((unsigned char)bases[i]));
+		}
+		position += count;
+	}
+}
+
+
+const string& ReferenceSequence::get_path() const {
+	return path;
+}
+
+
+uint64_t ReferenceSequence::get_offset() const {
+	return offset;
+}
+
+
+size_t ReferenceSequence::get_line_bases() const {
+	return line_bases;
+}
+
+
+size_t ReferenceSequence::get_line_width() const {
+	return line_width;
+}
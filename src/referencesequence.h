@@ -0,0 +1,61 @@
+#ifndef REFERENCE_SEQUENCE_H
+#define REFERENCE_SEQUENCE_H
+
+#include <string>
+#include <cstdint>
+
+/** One sequence (such as a chromosome) of a reference genome. The sequence is either held in
+ *  memory or read on demand from a memory-mapped, uncompressed FASTA file, such that only the
+ *  parts that are accessed are loaded and the pages are shared between all processes that
+ *  map the same file. Characters are returned in upper case.
+ */
+class ReferenceSequence {
+public:
+	/** Holds a copy of the given sequence in memory. */
+	ReferenceSequence(const std::string& sequence);
+
+	/** Maps a record of an indexed FASTA file. The parameters are the fields of its entry
+	 *  in the .fai index: the length of the sequence, the offset of its first base in the file,
+	 *  the number of bases per line and the number of bytes per line (including the newline).
+	 *  Throws std::runtime_error if the file cannot be mapped or is too short.
+	 */
+	ReferenceSequence(const std::string& path, size_t length, uint64_t offset, size_t line_bases, size_t line_width);
+
+	~ReferenceSequence();
+
+	size_t size() const;
+
+	/** Whether the sequence is read from a memory-mapped file. */
+	bool is_mapped() const;
+
+	/** Appends the characters at positions start, ..., end-1 to result. The range is clipped to
+	 *  the sequence, as for slices in Python.
+	 */
+	void append(long start, long end, std::string& result) const;
+
+	/** Returns the parameters given to the constructor. */
+	const std::string& get_path() const;
+	uint64_t get_offset() const;
+	size_t get_line_bases() const;
+	size_t get_line_width() const;
+
+private:
+	ReferenceSequence(const ReferenceSequence&);
+	ReferenceSequence& operator=(const ReferenceSequence&);
+
+	// unmapped sequence (empty if mapped)
+	std::string sequence;
+	size_t length;
+
+	std::string path;
+	uint64_t offset;
+	size_t line_bases;
+	size_t line_width;
+	// start and length of the mapped part of the file
+	void* mapping;
+	size_t mapping_length;
+	// the byte at the offset of the first base
+	const char* data;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#include <mutex>
+#include <unordered_map>
+
+#include "stringpool.h"
+
+using namespace std;
+
+namespace {
+	typedef struct string_pointer_hasher_t {
+		size_t operator()(const string* s) const {
+			return hash<string>()(*s);
+		}
+	} string_pointer_hasher_t;
+
+	typedef struct string_pointer_equal_t {
+		bool operator()(const string* s1, const string* s2) const {
+			return *s1 == *s2;
+		}
+	} string_pointer_equal_t;
+
+	mutex pool_mutex;
+	// keyed by the pooled string itself, such that the pool does not store a second copy
+	unordered_map<const string*, weak_ptr<const string>, string_pointer_hasher_t, string_pointer_equal_t> pool;
+
+	void release_string(const string* s) {
+		{
+			lock_guard<mutex> lock(pool_mutex);
+			auto it = pool.find(s);
+			// an equal string may already have been interned anew after this one expired
+			if ((it != pool.end()) && (it->first == s)) {
+				pool.erase(it);
+			}
+		}
+		delete s;
+	}
+}
+
+
+shared_ptr<const string> intern_string(const string& s) {
+	lock_guard<mutex> lock(pool_mutex);
+	auto it = pool.find(&s);
+	if (it != pool.end()) {
+		shared_ptr<const string> pooled = it->second.lock();
+		if (pooled) {
+			return pooled;
+		}
+		// expired, but not yet released
+		pool.erase(it);
+	}
+	shared_ptr<const string> pooled(new string(s), release_string);
+	pool.emplace(pooled.get(), pooled);
+	return pooled;
+}
+
+
+size_t get_interned_string_count() {
+	lock_guard<mutex> lock(pool_mutex);
+	return pool.size();
+}
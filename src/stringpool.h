@@ -0,0 +1,18 @@
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include <string>
+#include <memory>
+
+/** Returns a shared, immutable copy of the given string. As long as a string returned
+ *  by intern_string() is alive, all further calls with an equal string return the same
+ *  object, such that strings that occur many times (e.g. BX tags shared by all reads of a
+ *  molecule) are stored only once. A string is freed when its last copy goes away.
+ *  Thread-safe.
+ */
+std::shared_ptr<const std::string> intern_string(const std::string& s);
+
+/** Returns the number of distinct strings currently interned. */
+size_t get_interned_string_count();
+
+#endif
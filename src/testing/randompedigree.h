@@ -0,0 +1,94 @@
+#ifndef RANDOM_PEDIGREE_H
+#define RANDOM_PEDIGREE_H
+
+#include <algorithm>
+#include <array>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../genotype.h"
+#include "../pedigree.h"
+#include "../phredgenotypelikelihoods.h"
+#include "../read.h"
+#include "../readset.h"
+
+/** A random pedigree for testing the pedigree DP. Trios form a chain: individuals 0 and 1 are the parents
+ *  of 2, individuals 2 and 3 the parents of 4, and so on. The haplotypes of children are inherited from
+ *  their parents, and reads are sampled from the haplotypes with errors. Unless conflicts is true, the
+ *  genotypes match the haplotypes; otherwise, some of them are replaced at random, which may give
+ *  Mendelian conflicts. Genotype likelihoods are random integral phred scores.
+ */
+class RandomPedigree {
+public:
+    Pedigree pedigree;
+    ReadSet read_set;
+    std::vector<unsigned int> positions;
+    std::vector<unsigned int> recombcost;
+    // read_marks[r] is the index of the individual of read r in read_set
+    std::vector<unsigned int> read_marks;
+    // haplotypes[i][v] are the alleles of individual i at variant v
+    std::vector<std::vector<std::array<unsigned int, 2>>> haplotypes;
+
+    RandomPedigree(std::mt19937& rng, unsigned int trios, unsigned int variants, unsigned int reads, bool conflicts) {
+        unsigned int individuals = (trios == 0) ? 1 : 2*trios + 1;
+        for (unsigned int v = 0; v < variants; v++) {
+            positions.push_back(100 + 10*v);
+            recombcost.push_back(rng() % 20);
+        }
+        haplotypes.assign(individuals, std::vector<std::array<unsigned int, 2>>(variants));
+        for (unsigned int v = 0; v < variants; v++) {
+            for (unsigned int i = 0; i < individuals; i++) {
+                if (is_child(i, trios)) {
+                    haplotypes[i][v] = {haplotypes[i-2][v][rng() % 2], haplotypes[i-1][v][rng() % 2]};
+                } else {
+                    haplotypes[i][v] = {(unsigned int)(rng() % 2), (unsigned int)(rng() % 2)};
+                }
+            }
+        }
+        for (unsigned int i = 0; i < individuals; i++) {
+            std::vector<Genotype*> genotypes;
+            std::vector<PhredGenotypeLikelihoods*> genotype_likelihoods;
+            for (unsigned int v = 0; v < variants; v++) {
+                unsigned int allele0 = haplotypes[i][v][0];
+                unsigned int allele1 = haplotypes[i][v][1];
+                if (conflicts && (rng() % 5 == 0)) {
+                    allele0 = rng() % 2;
+                    allele1 = rng() % 2;
+                }
+                genotypes.push_back(new Genotype(std::vector<uint32_t>{allele0, allele1}));
+                std::vector<double> gl = {double(rng() % 50), double(rng() % 50), double(rng() % 50)};
+                genotype_likelihoods.push_back(new PhredGenotypeLikelihoods(gl, 2));
+            }
+            pedigree.addIndividual(i, genotypes, genotype_likelihoods);
+        }
+        for (unsigned int t = 0; t < trios; t++) {
+            pedigree.addRelationship(2*t, 2*t + 1, 2*t + 2);
+        }
+        for (unsigned int r = 0; r < reads; r++) {
+            unsigned int individual = rng() % individuals;
+            unsigned int haplotype = rng() % 2;
+            unsigned int start = rng() % (variants - 1);
+            unsigned int end = std::min(variants, start + 2 + (unsigned int)(rng() % 5));
+            Read* read = new Read("read" + std::to_string(r), 60, 0, individual);
+            for (unsigned int v = start; v < end; v++) {
+                unsigned int allele = haplotypes[individual][v][haplotype];
+                if (rng() % 10 == 0) {
+                    allele = 1 - allele;
+                }
+                read->addVariant(positions[v], allele, 1 + rng() % 30);
+            }
+            read_set.add(read);
+        }
+        read_set.sort();
+        for (unsigned int r = 0; r < read_set.size(); r++) {
+            read_marks.push_back(pedigree.id_to_index(read_set.get(r)->getSampleID()));
+        }
+    }
+
+    static bool is_child(unsigned int individual, unsigned int trios) {
+        return (individual >= 2) && (individual % 2 == 0) && (individual / 2 <= trios);
+    }
+};
+
+#endif
@@ -11,6 +11,8 @@
 #include "../entry.h"
 #include "../transitionprobabilitycomputer.h"
 #include "../vector2d.h"
+#include "../genotype.h"
+#include "../packedcolumns.h"
 
 #include <iostream>
 #include <string>
@@ -32,6 +34,16 @@ size_t popcount(size_t x) {
 }
 
 
+// heterozygous genotypes for the given number of variants; owned by the pedigree they are added to
+vector<Genotype*> heterozygous_genotypes(size_t count){
+    vector<Genotype*> genotypes;
+    for(size_t i = 0; i < count; i++){
+        genotypes.push_back(new Genotype(1, 2));
+    }
+    return genotypes;
+}
+
+
 ReadSet* string_to_readset(string s, string weights, bool use){
     ReadSet* read_set = new ReadSet;
     stringstream s1(s);
@@ -131,7 +143,7 @@ bool compare_entries(vector<const Entry*> c1, string c2){
 TEST_CASE("test transition prob computer", "[test transition prob computer]"){
 
     SECTION("test simple example", "[test simple example]"){
-        TransitionProbabilityComputer trans(10,1,16,4);
+        TransitionProbabilityComputer<> trans(10,1,16,4);
         std::vector<long double> expected_cost = {0.9L*0.9L, 0.1L*0.9L, 0.1L*0.1L};
         long double nor = (0.9L*0.9L+2*0.1L*0.9L+0.1L*0.1L)*16;
 
@@ -147,7 +159,7 @@ TEST_CASE("test transition prob computer", "[test transition prob computer]"){
     }
 
     SECTION("test for single individual", "[test for single individual]"){
-        TransitionProbabilityComputer trans(10,0,4,1);
+        TransitionProbabilityComputer<> trans(10,0,4,1);
         REQUIRE(trans.get(0,0) == 0.25);
     }
 }*/
@@ -168,17 +180,17 @@ TEST_CASE("test transition prob computer", "[test transition prob computer]"){
         std::vector<PhredGenotypeLikelihoods*> gl_child;
 
         for(unsigned int i = 0; i < positions->size(); i++){
-            PhredGenotypeLikelihoods* n_m = new PhredGenotypeLikelihoods(1/3.0,1/3.0,1/3.0);
-            PhredGenotypeLikelihoods* n_f = new PhredGenotypeLikelihoods(1/3.0,1/3.0,1/3.0);
-            PhredGenotypeLikelihoods* n_c = new PhredGenotypeLikelihoods(1/3.0,1/3.0,1/3.0);
+            PhredGenotypeLikelihoods* n_m = new PhredGenotypeLikelihoods({1/3.0,1/3.0,1/3.0}, 2);
+            PhredGenotypeLikelihoods* n_f = new PhredGenotypeLikelihoods({1/3.0,1/3.0,1/3.0}, 2);
+            PhredGenotypeLikelihoods* n_c = new PhredGenotypeLikelihoods({1/3.0,1/3.0,1/3.0}, 2);
             gl_mother.push_back(n_m);
             gl_father.push_back(n_f);
             gl_child.push_back(n_c);
         }
 
-        pedigree->addIndividual(0, std::vector<unsigned int >(positions->size(),1), gl_mother);
-        pedigree->addIndividual(1, std::vector<unsigned int >(positions->size(),1), gl_father);
-        pedigree->addIndividual(2, std::vector<unsigned int >(positions->size(),1), gl_child);
+        pedigree->addIndividual(0, heterozygous_genotypes(positions->size()), gl_mother);
+        pedigree->addIndividual(1, heterozygous_genotypes(positions->size()), gl_father);
+        pedigree->addIndividual(2, heterozygous_genotypes(positions->size()), gl_child);
         pedigree->addRelationship(0,1,2);
 
         // create all pedigree partitions
@@ -190,7 +202,7 @@ TEST_CASE("test transition prob computer", "[test transition prob computer]"){
         }
 
         for(unsigned int column_index = 0; column_index < positions->size(); ++column_index){
-            TransitionProbabilityComputer trans(column_index,10,pedigree,pedigree_partitions);
+            TransitionProbabilityComputer<> trans(column_index,10,pedigree,pedigree_partitions);
             std::vector<long double> expected_cost = {0.9L*0.9L, 0.1L*0.9L, 0.1L*0.1L};
             long double nor = (0.9L*0.9L+2*0.1L*0.9L+0.1L*0.1L);
 
@@ -240,17 +252,17 @@ TEST_CASE("test transition prob computer", "[test transition prob computer]"){
         std::vector<PhredGenotypeLikelihoods*> gl_child;
 
         for(unsigned int i = 0; i < positions->size(); i++){
-            PhredGenotypeLikelihoods* n_m = new PhredGenotypeLikelihoods(0,1,0);
-            PhredGenotypeLikelihoods* n_f = new PhredGenotypeLikelihoods(0,1,0);
-            PhredGenotypeLikelihoods* n_c = new PhredGenotypeLikelihoods(0.25,0.5,0.25);
+            PhredGenotypeLikelihoods* n_m = new PhredGenotypeLikelihoods({0,1,0}, 2);
+            PhredGenotypeLikelihoods* n_f = new PhredGenotypeLikelihoods({0,1,0}, 2);
+            PhredGenotypeLikelihoods* n_c = new PhredGenotypeLikelihoods({0.25,0.5,0.25}, 2);
             gl_mother.push_back(n_m);
             gl_father.push_back(n_f);
             gl_child.push_back(n_c);
         }
 
-        pedigree->addIndividual(0, std::vector<unsigned int >(positions->size(),1), gl_mother);
-        pedigree->addIndividual(1, std::vector<unsigned int >(positions->size(),1), gl_father);
-        pedigree->addIndividual(2, std::vector<unsigned int >(positions->size(),1), gl_child);
+        pedigree->addIndividual(0, heterozygous_genotypes(positions->size()), gl_mother);
+        pedigree->addIndividual(1, heterozygous_genotypes(positions->size()), gl_father);
+        pedigree->addIndividual(2, heterozygous_genotypes(positions->size()), gl_child);
         pedigree->addRelationship(0,1,2);
 
         // create all pedigree partitions
@@ -262,7 +274,7 @@ TEST_CASE("test transition prob computer", "[test transition prob computer]"){
         }
 
         for(unsigned int column_index = 0; column_index < positions->size(); ++column_index){
-            TransitionProbabilityComputer trans(column_index,10,pedigree,pedigree_partitions);
+            TransitionProbabilityComputer<> trans(column_index,10,pedigree,pedigree_partitions);
             std::vector<long double> expected_cost = {0.9L*0.9L, 0.1L*0.9L, 0.1L*0.1L};
             long double nor = (0.9L*0.9L+2*0.1L*0.9L+0.1L*0.1L);
 
@@ -300,11 +312,11 @@ TEST_CASE("test transition prob computer", "[test transition prob computer]"){
 
        std::vector<PhredGenotypeLikelihoods*> gl;
        for(unsigned int i = 0; i < positions->size(); i++){
-           PhredGenotypeLikelihoods* n = new PhredGenotypeLikelihoods(1/3.0,1/3.0,1/3.0);
+           PhredGenotypeLikelihoods* n = new PhredGenotypeLikelihoods({1/3.0,1/3.0,1/3.0}, 2);
            gl.push_back(n);
        }
 
-       pedigree->addIndividual(0, std::vector<unsigned int >(positions->size(),1), gl);
+       pedigree->addIndividual(0, heterozygous_genotypes(positions->size()), gl);
        std::vector<PedigreePartitions*> pedigree_partitions;
 
 
@@ -314,7 +326,7 @@ TEST_CASE("test transition prob computer", "[test transition prob computer]"){
        }
 
        for(unsigned int column_index = 0; column_index < positions->size(); ++column_index){
-           TransitionProbabilityComputer trans(column_index,10,pedigree,pedigree_partitions);
+           TransitionProbabilityComputer<> trans(column_index,10,pedigree,pedigree_partitions);
            for(unsigned int a = 0; a < 1<<pedigree_partitions[0]->count(); ++a){
             if((a>0) && (a<3)){
                 REQUIRE((trans.get_prob_transmission(0,0)*trans.get_prob_allele_assignment(0,a)) == 1.0L/6.0L);
@@ -345,7 +357,7 @@ TEST_CASE("test column_cost_computer","[test column_cost_computer]"){
         std::vector<PhredGenotypeLikelihoods*> genotype_likelihoods(positions->size(),nullptr);
         std::vector<unsigned int> recombcost(positions->size(), 1);
         Pedigree* pedigree = new Pedigree;
-        pedigree->addIndividual(0, std::vector<unsigned int >(positions->size(),1), genotype_likelihoods);
+        pedigree->addIndividual(0, heterozygous_genotypes(positions->size()), genotype_likelihoods);
 
         // create all pedigree partitions
         std::vector<PedigreePartitions*> pedigree_partitions;
@@ -362,14 +374,13 @@ TEST_CASE("test column_cost_computer","[test column_cost_computer]"){
         }
         vector<string> columns = get_columns(reads[r],2);
 
-        ColumnIterator input_column_iterator(*read_set, positions);
-        unsigned int col_ind = 0;
+        PackedColumns input_columns(*read_set, positions);
 
-        while(input_column_iterator.has_next()){
-            unique_ptr<vector<const Entry *> > current_input_column = input_column_iterator.get_next();
+        for(unsigned int col_ind = 0; col_ind < input_columns.get_column_count(); col_ind++){
+            PackedColumn current_input_column = input_columns.get_column(col_ind);
 
             // create column cost computer
-            GenotypeColumnCostComputer cost_computer(*current_input_column, col_ind, read_sources, pedigree,*pedigree_partitions[0]);
+            GenotypeColumnCostComputer<> cost_computer(current_input_column, col_ind, read_sources, pedigree,*pedigree_partitions[0]);
             cost_computer.set_partitioning(0);
 
             unsigned int switch_cost = 1;
@@ -401,8 +412,6 @@ TEST_CASE("test column_cost_computer","[test column_cost_computer]"){
             REQUIRE(cost_computer.get_cost(1) == naive_column_cost_computer(columns[col_ind],2,switch_cost,0,1));
             REQUIRE(cost_computer.get_cost(2) == naive_column_cost_computer(columns[col_ind],2,switch_cost,1,0));
             REQUIRE(cost_computer.get_cost(3) == naive_column_cost_computer(columns[col_ind],2,switch_cost,1,1));
-
-            col_ind += 1;
         }
 
         delete read_set;
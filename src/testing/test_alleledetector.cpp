@@ -0,0 +1,146 @@
+#include "../alleledetector.h"
+#include "../referencesequence.h"
+
+#include <algorithm>
+#include <climits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+
+using namespace std;
+
+namespace {
+
+    // full Gotoh DP table in single precision after skipping identical prefixes and suffixes, as in
+    // whatshap.align.edit_distance_affine_gap
+    int full_affine_gap(string query, string ref, int mismatch_cost, int gap_start, int gap_extend) {
+        while (!query.empty() && !ref.empty() && (query[0] == ref[0])) {
+            query.erase(0, 1);
+            ref.erase(0, 1);
+        }
+        while (!query.empty() && !ref.empty() && (query.back() == ref.back())) {
+            query.pop_back();
+            ref.pop_back();
+        }
+        size_t m = query.size();
+        size_t n = ref.size();
+        const float infinity = INT_MAX;
+        vector<float> a(m + 1, infinity), b(m + 1), c(m + 1, infinity);
+        a[0] = b[0] = c[0] = 0;
+        for (size_t i = 1; i <= m; i++) {
+            b[i] = gap_start + ((int)i - 1) * gap_extend;
+        }
+        for (size_t j = 1; j <= n; j++) {
+            float prev_a = a[0], prev_b = b[0], prev_c = c[0];
+            a[0] = infinity;
+            b[0] = infinity;
+            c[0] = gap_start + ((int)j - 1) * gap_extend;
+            for (size_t i = 1; i <= m; i++) {
+                float m_c = (query[i-1] == ref[j-1]) ? 0.0f : (float)mismatch_cost;
+                float c_a = min(prev_a, min(prev_b, prev_c)) + m_c;
+                float c_b = min(a[i-1] + gap_start, min(b[i-1] + gap_extend, c[i-1] + gap_start));
+                float c_c = min(a[i] + gap_start, min(b[i] + gap_start, c[i] + gap_extend));
+                prev_a = a[i];
+                prev_b = b[i];
+                prev_c = c[i];
+                a[i] = c_a;
+                b[i] = c_b;
+                c[i] = c_c;
+            }
+        }
+        return (int)min(a[m], min(b[m], c[m]));
+    }
+
+    string random_sequence(mt19937& rng, size_t length) {
+        string s;
+        for (size_t i = 0; i < length; i++) {
+            s += "ACGT"[rng() % 4];
+        }
+        return s;
+    }
+
+    // applies random substitutions, insertions and deletions of up to max_gap bases
+    string mutate(mt19937& rng, string s, unsigned int edits, unsigned int max_gap) {
+        for (unsigned int e = 0; e < edits && !s.empty(); e++) {
+            size_t position = rng() % s.size();
+            switch (rng() % 3) {
+            case 0:
+                s[position] = "ACGT"[rng() % 4];
+                break;
+            case 1:
+                s.insert(position, random_sequence(rng, 1 + rng() % max_gap));
+                break;
+            default:
+                s.erase(position, 1 + rng() % max_gap);
+            }
+        }
+        return s;
+    }
+
+    void check_affine_gap(AlleleDetector& detector, const string& query, const string& ref, int mismatch_cost, int gap_start, int gap_extend) {
+        int expected = full_affine_gap(query, ref, mismatch_cost, gap_start, gap_extend);
+        int banded = detector.edit_distance_affine_gap(query.data(), query.size(), ref.data(), ref.size());
+        INFO("query " << query << ", reference " << ref);
+        REQUIRE(banded == expected);
+    }
+}
+
+TEST_CASE("test banded affine gap realignment", "[test banded affine gap realignment]") {
+    mt19937 rng(22);
+    shared_ptr<const ReferenceSequence> reference = make_shared<ReferenceSequence>("ACGT");
+    // (mismatch, gap start, gap extend); a zero gap cost means the band cannot be bounded
+    const vector<vector<int>> costs = {{1, 1, 1}, {5, 2, 1}, {15, 6, 2}, {3, 0, 1}, {4, 3, 0}, {2, 10, 10}};
+
+    vector<unique_ptr<AlleleDetector>> detectors;
+    for (const vector<int>& cost : costs) {
+        detectors.emplace_back(new AlleleDetector(vector<int>(), vector<string>(), vector<string>(), reference, 10, true, cost[1], cost[2], cost[0]));
+    }
+
+    SECTION("random windows with few edits", "[few edits]") {
+        for (size_t k = 0; k < costs.size(); k++) {
+            for (int repeat = 0; repeat < 300; repeat++) {
+                string ref = random_sequence(rng, rng() % 120);
+                string query = mutate(rng, ref, rng() % 6, 1 + rng() % 20);
+                check_affine_gap(*detectors[k], query, ref, costs[k][0], costs[k][1], costs[k][2]);
+                check_affine_gap(*detectors[k], ref, query, costs[k][0], costs[k][1], costs[k][2]);
+            }
+        }
+    }
+
+    SECTION("unrelated and empty windows", "[unrelated windows]") {
+        for (size_t k = 0; k < costs.size(); k++) {
+            for (int repeat = 0; repeat < 100; repeat++) {
+                check_affine_gap(*detectors[k], random_sequence(rng, rng() % 40), random_sequence(rng, rng() % 40), costs[k][0], costs[k][1], costs[k][2]);
+            }
+            check_affine_gap(*detectors[k], "", "", costs[k][0], costs[k][1], costs[k][2]);
+            check_affine_gap(*detectors[k], "ACGT", "", costs[k][0], costs[k][1], costs[k][2]);
+            check_affine_gap(*detectors[k], "", "ACGT", costs[k][0], costs[k][1], costs[k][2]);
+        }
+    }
+
+    SECTION("optimal alignments far outside the initial band", "[outside band]") {
+        // Shifting a window by k bases costs two gaps of length k, while staying on the diagonal costs
+        // mismatches at most positions. For k above the initial band of 4 diagonals, the band must be
+        // widened to find the optimum, although both windows have the same length.
+        for (size_t k = 0; k < costs.size(); k++) {
+            for (size_t shift : {5, 9, 17, 33}) {
+                for (int repeat = 0; repeat < 20; repeat++) {
+                    string middle = random_sequence(rng, 40 + rng() % 60);
+                    string query = random_sequence(rng, shift) + middle + "A";
+                    string ref = "C" + middle + random_sequence(rng, shift);
+                    check_affine_gap(*detectors[k], query, ref, costs[k][0], costs[k][1], costs[k][2]);
+                    check_affine_gap(*detectors[k], ref, query, costs[k][0], costs[k][1], costs[k][2]);
+                }
+                // a long insertion and an equally long deletion in the same window
+                string left = random_sequence(rng, 30);
+                string right = random_sequence(rng, 30);
+                string query = "G" + left + random_sequence(rng, shift) + right + "T";
+                string ref = "A" + left + right + random_sequence(rng, shift) + "C";
+                check_affine_gap(*detectors[k], query, ref, costs[k][0], costs[k][1], costs[k][2]);
+            }
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#include "../packedcolumns.h"
+#include "../pedigreecolumncostcomputer.h"
+#include "../pedigreecolumncostengine.h"
+#include "../pedigreepartitions.h"
+#include "randompedigree.h"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "catch.hpp"
+
+using namespace std;
+
+TEST_CASE("test PedigreeColumnCostEngine", "[test PedigreeColumnCostEngine]") {
+    mt19937 rng(8);
+
+    // The engine derives the costs of all transmission values from shared per-haplotype costs. They must
+    // equal the costs of one PedigreeColumnCostComputer per transmission value that reads the column itself.
+    for (unsigned int trial = 0; trial < 60; trial++) {
+        unsigned int trios = trial % 3;
+        bool distrust_genotypes = (trial % 2 == 0);
+        RandomPedigree instance(rng, trios, 6, 8 + rng() % 5, !distrust_genotypes);
+        unsigned int transmission_configurations = 1u << (2*trios);
+        vector<unique_ptr<PedigreePartitions>> partitions;
+        vector<PedigreePartitions*> partition_pointers;
+        vector<unsigned int> all_values;
+        for (unsigned int t = 0; t < transmission_configurations; t++) {
+            partitions.emplace_back(new PedigreePartitions(instance.pedigree, t));
+            partition_pointers.push_back(partitions.back().get());
+            all_values.push_back(t);
+        }
+
+        PackedColumns columns(instance.read_set, &instance.positions);
+        for (unsigned int column_index = 0; column_index < columns.get_column_count(); column_index++) {
+            PackedColumn column = columns.get_column(column_index);
+            vector<PedigreeColumnCostComputer> cost_computers;
+            for (unsigned int t = 0; t < transmission_configurations; t++) {
+                cost_computers.emplace_back(column, column_index, instance.read_marks, &instance.pedigree, *partitions[t], distrust_genotypes);
+            }
+            PedigreeColumnCostEngine engine(column, column_index, instance.read_marks, &instance.pedigree, partition_pointers, all_values, distrust_genotypes);
+            REQUIRE(engine.computes_all_costs());
+            // an engine restricted to some of the transmission values gives infinite costs for all others
+            vector<unsigned int> restricted_values;
+            for (unsigned int t = 0; t < transmission_configurations; t++) {
+                if ((transmission_configurations == 1) || (rng() % 2 == 0)) {
+                    restricted_values.push_back(t);
+                }
+            }
+            PedigreeColumnCostEngine restricted_engine(column, column_index, instance.read_marks, &instance.pedigree, partition_pointers, restricted_values, distrust_genotypes);
+            REQUIRE(restricted_engine.computes_all_costs() == (restricted_values.size() == transmission_configurations));
+
+            vector<unsigned int> costs(transmission_configurations);
+            vector<unsigned int> restricted_costs(transmission_configurations);
+            // walk all bipartitions in Gray code order, resetting the partitioning now and then
+            unsigned int partitioning = 0;
+            engine.set_partitioning(0);
+            restricted_engine.set_partitioning(0);
+            for (unsigned int rank = 0; rank < (1u << column.size()); rank++) {
+                if (rank > 0) {
+                    int bit = __builtin_ctz(rank);
+                    partitioning ^= 1u << bit;
+                    if (rank % 37 == 0) {
+                        engine.set_partitioning(partitioning);
+                        restricted_engine.set_partitioning(partitioning);
+                    } else {
+                        engine.update_partitioning(bit);
+                        restricted_engine.update_partitioning(bit);
+                    }
+                }
+                engine.get_costs(costs.data());
+                restricted_engine.get_costs(restricted_costs.data());
+                for (unsigned int t = 0; t < transmission_configurations; t++) {
+                    cost_computers[t].set_partitioning(partitioning);
+                    unsigned int expected = cost_computers[t].get_cost();
+                    REQUIRE(costs[t] == expected);
+                    bool restricted = find(restricted_values.begin(), restricted_values.end(), t) == restricted_values.end();
+                    REQUIRE(restricted_costs[t] == (restricted ? numeric_limits<unsigned int>::max() : expected));
+                }
+            }
+        }
+    }
+}
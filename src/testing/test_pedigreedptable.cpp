@@ -0,0 +1,331 @@
+#include "../pedigreedptable.h"
+#include "randompedigree.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+
+using namespace std;
+
+namespace {
+
+    // score, partitioning, super reads and transmission vector of an optimal solution
+    struct Solution {
+        unsigned int score;
+        vector<bool> partitioning;
+        vector<string> super_reads;
+        vector<unsigned int> transmission_vector;
+    };
+
+    Solution solve(RandomPedigree& instance, bool distrust_genotypes, unsigned int threads, checkpoint_policy_t policy = CHECKPOINT_SQRT) {
+        PedigreeDPTable table(&instance.read_set, instance.recombcost, &instance.pedigree, distrust_genotypes, &instance.positions, threads, policy);
+        Solution solution;
+        solution.score = table.get_optimal_score();
+        unique_ptr<vector<bool>> partitioning(table.get_optimal_partitioning());
+        solution.partitioning = *partitioning;
+        vector<ReadSet*> super_reads;
+        for (size_t i = 0; i < instance.pedigree.size(); i++) {
+            super_reads.push_back(new ReadSet());
+        }
+        table.get_super_reads(&super_reads, &solution.transmission_vector);
+        for (ReadSet* read_set : super_reads) {
+            solution.super_reads.push_back(read_set->toString());
+            delete read_set;
+        }
+        return solution;
+    }
+
+    // largest number of reads that cover a column
+    unsigned int max_coverage(const RandomPedigree& instance) {
+        unsigned int result = 0;
+        for (unsigned int position : instance.positions) {
+            unsigned int coverage = 0;
+            for (size_t r = 0; r < instance.read_set.size(); r++) {
+                const Read* read = instance.read_set.get(r);
+                if ((read->firstPosition() <= (int)position) && ((int)position <= read->lastPosition())) {
+                    coverage += 1;
+                }
+            }
+            result = max(result, coverage);
+        }
+        return result;
+    }
+
+    const unsigned long long INF = numeric_limits<unsigned long long>::max();
+
+    /** Optimal costs of a RandomPedigree computed by definition, independently of the DP: the columns are
+     *  solved for every bipartition of the reads, and the transmission values are chosen by a DP over the
+     *  columns that tries all pairs of consecutive values.
+     */
+    class BruteForcePedigree {
+    public:
+        BruteForcePedigree(const RandomPedigree& instance, unsigned int trios, bool distrust_genotypes)
+            : instance(instance), trios(trios), configurations(1u << (2*trios))
+        {
+            unsigned int columns = instance.positions.size();
+            column_reads.resize(columns);
+            column_costs.resize(columns);
+            for (unsigned int r = 0; r < instance.read_set.size(); r++) {
+                const Read* read = instance.read_set.get(r);
+                for (int v = 0; v < read->getVariantCount(); v++) {
+                    unsigned int c = find(instance.positions.begin(), instance.positions.end(), read->getPosition(v)) - instance.positions.begin();
+                    column_reads[c].push_back(r);
+                }
+            }
+            for (unsigned int c = 0; c < columns; c++) {
+                compute_column_costs(c, distrust_genotypes);
+            }
+        }
+
+        // partition of haplotype h of individual i for transmission value t: founders get two partitions each, in
+        // the order of their indices, and child 2k+2 inherits haplotype !t_2k of individual 2k and haplotype
+        // !t_2k+1 of individual 2k+1
+        unsigned int partition(unsigned int individual, unsigned int haplotype, unsigned int t) const {
+            if (RandomPedigree::is_child(individual, trios)) {
+                unsigned int k = individual / 2 - 1;
+                unsigned int parent = (haplotype == 0) ? 2*k : 2*k + 1;
+                return partition(parent, ((t >> (2*k + haplotype)) & 1) ? 0 : 1, t);
+            }
+            unsigned int founder = (individual < 2) ? individual : individual / 2 + 1;
+            return 2*founder + haplotype;
+        }
+
+        // cost of a column for the given read bipartition (bit r set: read r on haplotype 1) and transmission value
+        unsigned long long column_cost(unsigned int column, unsigned int bipartition, unsigned int t) const {
+            unsigned int local = 0;
+            for (unsigned int i = 0; i < column_reads[column].size(); i++) {
+                local |= ((bipartition >> column_reads[column][i]) & 1) << i;
+            }
+            return column_costs[column][local * configurations + t];
+        }
+
+        unsigned long long recombination_cost(unsigned int column, unsigned int t, unsigned int previous_t) const {
+            return (unsigned long long)__builtin_popcount(t ^ previous_t) * instance.recombcost[column];
+        }
+
+        // cost of a solution given by read bipartition and transmission values
+        unsigned long long cost(unsigned int bipartition, const vector<unsigned int>& transmission_values) const {
+            unsigned long long total = 0;
+            for (unsigned int c = 0; c < instance.positions.size(); c++) {
+                unsigned long long cost = column_cost(c, bipartition, transmission_values[c]);
+                if (cost == INF) {
+                    return INF;
+                }
+                total += cost;
+                if (c > 0) {
+                    total += recombination_cost(c, transmission_values[c], transmission_values[c-1]);
+                }
+            }
+            return total;
+        }
+
+        // optimal cost over all read bipartitions and transmission values
+        unsigned long long optimal_cost() const {
+            unsigned long long best = INF;
+            vector<unsigned long long> previous(configurations), current(configurations);
+            for (unsigned int bipartition = 0; bipartition < (1u << instance.read_set.size()); bipartition++) {
+                previous.assign(configurations, 0);
+                for (unsigned int c = 0; c < instance.positions.size(); c++) {
+                    for (unsigned int t = 0; t < configurations; t++) {
+                        current[t] = INF;
+                        unsigned long long cost = column_cost(c, bipartition, t);
+                        if (cost == INF) {
+                            continue;
+                        }
+                        for (unsigned int previous_t = 0; previous_t < configurations; previous_t++) {
+                            if (previous[previous_t] == INF) {
+                                continue;
+                            }
+                            unsigned long long recombination = (c > 0) ? recombination_cost(c, t, previous_t) : 0;
+                            current[t] = min(current[t], previous[previous_t] + recombination + cost);
+                        }
+                    }
+                    swap(previous, current);
+                }
+                best = min(best, *min_element(previous.begin(), previous.end()));
+            }
+            return best;
+        }
+
+        // true if the genotypes of some column are compatible with no transmission value
+        bool has_mendelian_conflict() const {
+            for (unsigned int c = 0; c < instance.positions.size(); c++) {
+                bool feasible = false;
+                for (unsigned int t = 0; t < configurations; t++) {
+                    feasible = feasible || (column_costs[c][t] != INF);
+                }
+                if (!feasible) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        const RandomPedigree& instance;
+        unsigned int trios;
+        unsigned int configurations;
+        // for every column the reads covering it, and the costs for all bipartitions of these reads (bit i set:
+        // the i-th of them on haplotype 1) and all transmission values
+        vector<vector<unsigned int>> column_reads;
+        vector<vector<unsigned long long>> column_costs;
+
+        // column costs are given by the best assignment of alleles to the partitions, where reads pay for
+        // mismatches and the genotypes must match (or cost their genotype likelihoods)
+        void compute_column_costs(unsigned int column, bool distrust_genotypes) {
+            unsigned int individuals = instance.pedigree.size();
+            unsigned int partitions = 2 * (individuals - trios);
+            const vector<unsigned int>& reads = column_reads[column];
+            // individual, allele and quality of the entries of the reads in this column
+            vector<array<unsigned int, 3>> entries;
+            for (unsigned int r : reads) {
+                const Read* read = instance.read_set.get(r);
+                for (int v = 0; v < read->getVariantCount(); v++) {
+                    if (read->getPosition(v) == (int)instance.positions[column]) {
+                        entries.push_back({instance.read_marks[r], (unsigned int)read->getAllele(v), (unsigned int)read->getVariantQuality(v)});
+                    }
+                }
+            }
+            // genotype_costs[i][a0 + 2*a1] is the cost of individual i having alleles a0 and a1
+            vector<array<unsigned long long, 4>> genotype_costs(individuals);
+            for (unsigned int i = 0; i < individuals; i++) {
+                for (unsigned int alleles = 0; alleles < 4; alleles++) {
+                    Genotype genotype(vector<unsigned int>{alleles & 1, alleles >> 1});
+                    if (distrust_genotypes) {
+                        genotype_costs[i][alleles] = (unsigned int)instance.pedigree.get_genotype_likelihoods(i, column)->get(genotype);
+                    } else {
+                        bool matches = genotype.get_index() == instance.pedigree.get_genotype(i, column)->get_index();
+                        genotype_costs[i][alleles] = matches ? 0 : INF;
+                    }
+                }
+            }
+            vector<unsigned long long>& costs = column_costs[column];
+            costs.assign((1u << reads.size()) * configurations, INF);
+            vector<array<unsigned int, 2>> partition_of(individuals);
+            // alleles[i][h] is the allele of haplotype h of individual i
+            vector<array<unsigned int, 2>> alleles(individuals);
+            for (unsigned int t = 0; t < configurations; t++) {
+                for (unsigned int i = 0; i < individuals; i++) {
+                    partition_of[i] = {partition(i, 0, t), partition(i, 1, t)};
+                }
+                for (unsigned int assignment = 0; assignment < (1u << partitions); assignment++) {
+                    unsigned long long genotype_cost = 0;
+                    for (unsigned int i = 0; i < individuals; i++) {
+                        alleles[i] = {(assignment >> partition_of[i][0]) & 1, (assignment >> partition_of[i][1]) & 1};
+                        unsigned long long cost = genotype_costs[i][alleles[i][0] + 2*alleles[i][1]];
+                        genotype_cost = (cost == INF) ? INF : genotype_cost + cost;
+                        if (genotype_cost == INF) {
+                            break;
+                        }
+                    }
+                    if (genotype_cost == INF) {
+                        continue;
+                    }
+                    for (unsigned int local = 0; local < (1u << reads.size()); local++) {
+                        unsigned long long cost = genotype_cost;
+                        for (unsigned int i = 0; i < entries.size(); i++) {
+                            unsigned int haplotype = (local >> i) & 1;
+                            if (alleles[entries[i][0]][haplotype] != entries[i][1]) {
+                                cost += entries[i][2];
+                            }
+                        }
+                        unsigned long long& best = costs[local * configurations + t];
+                        best = min(best, cost);
+                    }
+                }
+            }
+        }
+    };
+
+    // checks optimal score and solution of the DP against the brute force solution with the given optimal cost
+    void check_against_brute_force(RandomPedigree& instance, const BruteForcePedigree& brute_force, unsigned long long expected, bool distrust_genotypes, unsigned int threads = 1, checkpoint_policy_t policy = CHECKPOINT_SQRT) {
+        if (!distrust_genotypes && brute_force.has_mendelian_conflict()) {
+            REQUIRE_THROWS_AS(solve(instance, distrust_genotypes, threads, policy), std::runtime_error);
+            return;
+        }
+        Solution solution = solve(instance, distrust_genotypes, threads, policy);
+        REQUIRE(solution.score == expected);
+        // reads in the first part of the partitioning are on haplotype 0
+        unsigned int bipartition = 0;
+        for (unsigned int r = 0; r < solution.partitioning.size(); r++) {
+            if (!solution.partitioning[r]) {
+                bipartition |= 1u << r;
+            }
+        }
+        REQUIRE(solution.transmission_vector.size() == instance.positions.size());
+        REQUIRE(brute_force.cost(bipartition, solution.transmission_vector) == expected);
+    }
+
+    void check_equal(const Solution& solution, const Solution& expected) {
+        REQUIRE(solution.score == expected.score);
+        REQUIRE(solution.partitioning == expected.partitioning);
+        REQUIRE(solution.super_reads == expected.super_reads);
+        REQUIRE(solution.transmission_vector == expected.transmission_vector);
+    }
+}
+
+TEST_CASE("test PedigreeDPTable threads", "[test PedigreeDPTable threads]") {
+    mt19937 rng(42);
+
+    SECTION("single individuals with many components", "[components]") {
+        // few short reads on many variants leave gaps between which no read continues
+        for (int trial = 0; trial < 40; trial++) {
+            bool distrust_genotypes = (trial % 2 == 1);
+            RandomPedigree instance(rng, 0, 60, 10 + rng() % 30, false);
+            Solution expected = solve(instance, distrust_genotypes, 1);
+            for (unsigned int threads : {2u, 3u, 8u}) {
+                check_equal(solve(instance, distrust_genotypes, threads), expected);
+            }
+        }
+    }
+
+    SECTION("columns large enough to be split among threads", "[large columns]") {
+        // with more than 4096 bipartitions, a column is computed in chunks on several threads
+        for (int trial = 0; trial < 6; trial++) {
+            unsigned int trios = trial % 2;
+            bool distrust_genotypes = (trial % 3 == 0);
+            unique_ptr<RandomPedigree> instance;
+            do {
+                instance.reset(new RandomPedigree(rng, trios, 8, 30, false));
+            } while ((max_coverage(*instance) < 13) || (max_coverage(*instance) > 16));
+            Solution expected = solve(*instance, distrust_genotypes, 1);
+            for (unsigned int threads : {2u, 4u}) {
+                check_equal(solve(*instance, distrust_genotypes, threads), expected);
+            }
+        }
+    }
+}
+
+TEST_CASE("test PedigreeDPTable against brute force", "[test PedigreeDPTable against brute force]") {
+    mt19937 rng(52);
+    // number of reads is limited such that all bipartitions can be tried
+    const unsigned int max_reads[] = {12, 9, 7, 6};
+
+    // 400 random pedigrees with 0 to 3 trios, with trusted genotypes (some of which give Mendelian conflicts)
+    // and with genotype likelihoods; every fifth one is also solved with other checkpoint policies and threads
+    for (unsigned int trial = 0; trial < 400; trial++) {
+        unsigned int trios = trial % 4;
+        bool distrust_genotypes = (trial / 4) % 2 == 1;
+        bool conflicts = !distrust_genotypes && ((trial / 8) % 4 == 0);
+        RandomPedigree instance(rng, trios, 4 + rng() % 5, 2 + rng() % (max_reads[trios] - 1), conflicts);
+        INFO("trial " << trial << ", trios " << trios << ", distrust genotypes " << distrust_genotypes);
+        BruteForcePedigree brute_force(instance, trios, distrust_genotypes);
+        unsigned long long expected = brute_force.optimal_cost();
+        check_against_brute_force(instance, brute_force, expected, distrust_genotypes);
+        if (trial % 5 == 0) {
+            for (checkpoint_policy_t policy : {CHECKPOINT_ALL, CHECKPOINT_SQRT, CHECKPOINT_LOG}) {
+                for (unsigned int threads : {2u, 3u}) {
+                    INFO("checkpoint policy " << policy << ", threads " << threads);
+                    check_against_brute_force(instance, brute_force, expected, distrust_genotypes, threads, policy);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#include "../phredprobabilities.h"
+
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include "catch.hpp"
+
+using namespace std;
+
+namespace {
+
+    // whether a and b differ by at most the given multiple of the machine epsilon of Float, relative to b
+    template <typename Float>
+    bool close(Float a, Float b, Float ulps) {
+        return fabs(a - b) <= ulps * numeric_limits<Float>::epsilon() * fabs(b);
+    }
+
+    template <typename Float>
+    void check_phred_probabilities() {
+        const PhredProbabilities<Float>& probabilities = PhredProbabilities<Float>::get();
+        REQUIRE(&PhredProbabilities<Float>::get() == &probabilities);
+
+        // a score of 0 would give a match probability of 0
+        REQUIRE(probabilities.error(0) == Float(0.9999L));
+        REQUIRE(probabilities.match(0) == Float(1) - Float(0.9999L));
+        REQUIRE(close<Float>(probabilities.log_error(0), Float(log(0.9999L)), 4));
+        REQUIRE(close<Float>(probabilities.log_match(0), Float(log1p(-0.9999L)), 4));
+
+        // scores from the tables and above them
+        for (unsigned int q = 1; q < PhredProbabilities<Float>::TABLE_SIZE + 100; q++) {
+            INFO("phred score " << q);
+            long double expected = pow(10.0L, -(long double)q/10.0L);
+            Float error = probabilities.error(q);
+            REQUIRE(error == Float(expected));
+            // the double precision computation used before the tables differs in the last few bits, since the
+            // rounding error of -q/10 is amplified by the exponentiation
+            REQUIRE(close<double>(double(error), pow(10.0, -double(q)/10.0), 64));
+            REQUIRE(probabilities.match(q) == Float(1) - error);
+            REQUIRE(close<Float>(probabilities.log_error(q), Float(log(expected)), 4));
+            REQUIRE(close<Float>(probabilities.log_match(q), Float(log1p(-expected)), 4));
+        }
+    }
+}
+
+TEST_CASE("test PhredProbabilities", "[test PhredProbabilities]") {
+
+    SECTION("values equal 10^(-q/10)", "[values]") {
+        check_phred_probabilities<double>();
+        check_phred_probabilities<long double>();
+    }
+
+    SECTION("concurrent lookups give one table", "[concurrency]") {
+        vector<const PhredProbabilities<double>*> tables(8);
+        vector<thread> threads;
+        for (size_t i = 0; i < tables.size(); i++) {
+            threads.emplace_back([&tables, i]() {
+                tables[i] = &PhredProbabilities<double>::get();
+            });
+        }
+        for (thread& t : threads) {
+            t.join();
+        }
+        for (size_t i = 0; i < tables.size(); i++) {
+            REQUIRE(tables[i] == tables[0]);
+            REQUIRE(close<double>(tables[i]->error(30), 0.001, 2));
+        }
+    }
+}
@@ -0,0 +1,203 @@
+#include "../polyphase/staticsparsegraph.h"
+#include "../polyphase/trianglesparsematrix.h"
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+
+using namespace std;
+
+typedef StaticSparseGraph::Edge Edge;
+typedef StaticSparseGraph::EdgeId EdgeId;
+typedef StaticSparseGraph::NodeId NodeId;
+
+namespace {
+
+    // random graph on the given number of nodes in which each edge has a non-zero weight with the given probability
+    map<EdgeId, float> random_edges(mt19937& rng, NodeId nodes, double density) {
+        map<EdgeId, float> edges;
+        uniform_real_distribution<double> coin(0.0, 1.0);
+        for (NodeId v = 1; v < nodes; v++) {
+            for (NodeId u = 0; u < v; u++) {
+                if (coin(rng) < density) {
+                    float weight = 1.0f + (rng() % 100);
+                    edges[Edge(u, v).id()] = (rng() % 2 == 0) ? weight : -weight;
+                }
+            }
+        }
+        return edges;
+    }
+
+    TriangleSparseMatrix to_matrix(NodeId nodes, const map<EdgeId, float>& edges) {
+        TriangleSparseMatrix matrix;
+        for (NodeId v = 1; v < nodes; v++) {
+            for (NodeId u = 0; u < v; u++) {
+                auto it = edges.find(Edge(u, v).id());
+                if (it != edges.end()) {
+                    matrix.set(u, v, it->second);
+                }
+            }
+        }
+        // make sure that the graph has all nodes
+        if (edges.count(Edge(nodes - 2, nodes - 1).id()) == 0) {
+            matrix.set(nodes - 2, nodes - 1, 1.0f);
+        }
+        return matrix;
+    }
+
+    // order of a neighbour list after removing v in the same way as StaticSparseGraph::removeFromVector
+    void remove_from_vector(vector<NodeId>& vec, NodeId v) {
+        auto it = find(vec.begin(), vec.end(), v);
+        REQUIRE(it != vec.end());
+        *it = vec.back();
+        vec.pop_back();
+    }
+}
+
+TEST_CASE("test StaticSparseGraph rank lookups", "[test StaticSparseGraph rank lookups]") {
+    mt19937 rng(32);
+
+    SECTION("popcount", "[popcount]") {
+        REQUIRE(StaticSparseGraph::popcount(0) == 0);
+        REQUIRE(StaticSparseGraph::popcount(~0ULL) == 64);
+        for (int repeat = 0; repeat < 10000; repeat++) {
+            uint64_t word = ((uint64_t)rng() << 32) | rng();
+            REQUIRE(StaticSparseGraph::popcount(word) == (uint64_t)__builtin_popcountll(word));
+        }
+        string instruction_set = StaticSparseGraph::rankInstructionSet();
+        REQUIRE(((instruction_set == "popcnt") || (instruction_set == "scalar")));
+    }
+
+    SECTION("edge ranks", "[edge ranks]") {
+        // 200 nodes give 19900 edge ids, i.e. several superblocks of 4096 ids; dense graphs fill whole blocks of 64
+        for (double density : {0.001, 0.05, 0.5, 1.0}) {
+            NodeId nodes = 200;
+            map<EdgeId, float> edges = random_edges(rng, nodes, density);
+            TriangleSparseMatrix matrix = to_matrix(nodes, edges);
+            // the matrix may have been given an additional edge
+            edges[Edge(nodes - 2, nodes - 1).id()] = matrix.get(nodes - 2, nodes - 1);
+            StaticSparseGraph graph(matrix);
+            REQUIRE(graph.numNodes() == nodes);
+            REQUIRE(graph.numEdges() == edges.size());
+
+            // stored edges have ranks 1, 2, ... in the order of their ids, all others have rank 0
+            StaticSparseGraph::RankId rank = 0;
+            EdgeId id = 0;
+            for (NodeId v = 1; v < nodes; v++) {
+                for (NodeId u = 0; u < v; u++, id++) {
+                    Edge e(u, v);
+                    REQUIRE(e.id() == id);
+                    auto it = edges.find(id);
+                    if (it == edges.end()) {
+                        REQUIRE(graph.findIndex(id) == 0);
+                        REQUIRE(graph.getWeight(e) == 0.0f);
+                    } else {
+                        rank += 1;
+                        REQUIRE(graph.findIndex(id) == rank);
+                        REQUIRE(graph.findIndex(e) == rank);
+                        REQUIRE(graph.getWeight(e) == it->second);
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("test StaticSparseGraph permanent and forbidden edges", "[test StaticSparseGraph permanent and forbidden edges]") {
+    mt19937 rng(34);
+
+    // Random sequences of permanent and forbidden edges are replayed on a simple model: the unpruned neighbours
+    // lose an entry as with removeFromVector, cliques are the components of the permanent edges, and two nodes
+    // are forbidden if some forbidden edge connects their cliques.
+    for (int trial = 0; trial < 10; trial++) {
+        NodeId nodes = 10 + rng() % 40;
+        map<EdgeId, float> edges = random_edges(rng, nodes, 0.05 + 0.1 * (trial % 5));
+        TriangleSparseMatrix matrix = to_matrix(nodes, edges);
+        edges[Edge(nodes - 2, nodes - 1).id()] = matrix.get(nodes - 2, nodes - 1);
+        StaticSparseGraph graph(matrix);
+
+        vector<Edge> stored;
+        for (NodeId v = 1; v < nodes; v++) {
+            for (NodeId u = 0; u < v; u++) {
+                if (edges.count(Edge(u, v).id()) > 0) {
+                    stored.push_back(Edge(u, v));
+                }
+            }
+        }
+        vector<vector<NodeId>> unpruned(nodes);
+        vector<vector<NodeId>> nonzero(nodes);
+        vector<NodeId> component(nodes);
+        for (NodeId v = 0; v < nodes; v++) {
+            unpruned[v] = graph.getUnprunedNeighbours(v);
+            nonzero[v] = graph.getNonZeroNeighbours(v);
+            component[v] = v;
+        }
+        vector<Edge> forbidden_edges;
+        auto is_forbidden = [&](NodeId a, NodeId b) {
+            for (const Edge& f : forbidden_edges) {
+                NodeId cu = component[f.u];
+                NodeId cv = component[f.v];
+                if ((cu == component[a] && cv == component[b]) || (cu == component[b] && cv == component[a])) {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        for (size_t operation = 0; operation < 2 * stored.size(); operation++) {
+            Edge e = stored[rng() % stored.size()];
+            bool permanent = rng() % 3 == 0;
+            // skip the contradicting operations, which are rejected with an error message
+            if ((permanent && is_forbidden(e.u, e.v)) || (!permanent && component[e.u] == component[e.v])) {
+                continue;
+            }
+            float& weight = edges[e.id()];
+            if (weight != StaticSparseGraph::Permanent && weight != StaticSparseGraph::Forbidden) {
+                remove_from_vector(unpruned[e.u], e.v);
+                remove_from_vector(unpruned[e.v], e.u);
+            }
+            if (permanent) {
+                graph.setPermanent(e);
+                weight = StaticSparseGraph::Permanent;
+                NodeId discarded = component[e.v];
+                for (NodeId& c : component) {
+                    if (c == discarded) {
+                        c = component[e.u];
+                    }
+                }
+            } else {
+                graph.setForbidden(e);
+                weight = StaticSparseGraph::Forbidden;
+                forbidden_edges.push_back(e);
+            }
+
+            REQUIRE(graph.getWeight(e) == weight);
+            for (NodeId v = 0; v < nodes; v++) {
+                REQUIRE(graph.getUnprunedNeighbours(v) == unpruned[v]);
+                REQUIRE(graph.getNonZeroNeighbours(v) == nonzero[v]);
+                vector<NodeId> clique = graph.getCliqueOf(v);
+                sort(clique.begin(), clique.end());
+                vector<NodeId> expected_clique;
+                for (NodeId u = 0; u < nodes; u++) {
+                    if (component[u] == component[v]) {
+                        expected_clique.push_back(u);
+                    }
+                }
+                REQUIRE(clique == expected_clique);
+            }
+            for (int check = 0; check < 50; check++) {
+                NodeId u = rng() % nodes;
+                NodeId v = rng() % nodes;
+                if (u == v) {
+                    continue;
+                }
+                REQUIRE(graph.isPermanent(Edge(u, v)) == (component[u] == component[v]));
+                REQUIRE(graph.isForbidden(Edge(u, v)) == is_forbidden(u, v));
+            }
+        }
+    }
+}
@@ -0,0 +1,125 @@
+#include "../transitionprobabilitycomputer.h"
+#include "../pedigreepartitions.h"
+#include "randompedigree.h"
+
+#include <cmath>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "catch.hpp"
+
+using namespace std;
+
+namespace {
+
+    // transition probabilities between transmission values as computed for every column before they were cached
+    template <typename Float>
+    Vector2D<Float> reference_transmission_probabilities(unsigned int recombcost, size_t trio_count) {
+        size_t transmission_configurations = 1 << (2*trio_count);
+        long double recomb_prob = pow(10,-(long double)(recombcost)/10.0L);
+        vector<long double> bernoulli;
+        for (unsigned int i = 0; i <= 2*trio_count; ++i) {
+            bernoulli.push_back(pow(recomb_prob,i)*pow(1-recomb_prob,2*trio_count-i));
+        }
+        Vector2D<Float> result(transmission_configurations, transmission_configurations, 0.0);
+        for (size_t i = 0; i < transmission_configurations; ++i) {
+            vector<long double> row(transmission_configurations);
+            long double normalization_sum = 0.0L;
+            for (size_t j = 0; j < transmission_configurations; ++j) {
+                row[j] = bernoulli[__builtin_popcountl(i ^ j)];
+                normalization_sum += row[j];
+            }
+            for (size_t j = 0; j < transmission_configurations; ++j) {
+                result.set(i, j, (Float)(row[j] / normalization_sum));
+            }
+        }
+        return result;
+    }
+
+    template <typename Float>
+    void check_transmission_probabilities() {
+        typedef TransitionProbabilityComputer<Float> Computer;
+        Computer::clear_transmission_probability_cache();
+        REQUIRE(Computer::get_transmission_probability_cache_size() == 0);
+
+        for (size_t trio_count = 0; trio_count <= 3; trio_count++) {
+            for (unsigned int recombcost : {0u, 1u, 10u, 37u}) {
+                shared_ptr<const Vector2D<Float> > matrix = Computer::get_transmission_probabilities(recombcost, trio_count);
+                Vector2D<Float> expected = reference_transmission_probabilities<Float>(recombcost, trio_count);
+                REQUIRE(matrix->get_size0() == expected.get_size0());
+                REQUIRE(matrix->get_size1() == expected.get_size1());
+                for (size_t i = 0; i < expected.get_size0(); i++) {
+                    for (size_t j = 0; j < expected.get_size1(); j++) {
+                        REQUIRE(matrix->at(i,j) == expected.at(i,j));
+                    }
+                }
+                // the same key gives the same matrix
+                REQUIRE(Computer::get_transmission_probabilities(recombcost, trio_count) == matrix);
+            }
+        }
+        REQUIRE(Computer::get_transmission_probability_cache_size() == 16);
+
+        // matrices remain valid after the cache is cleared, and are recomputed with equal values
+        shared_ptr<const Vector2D<Float> > matrix = Computer::get_transmission_probabilities(10, 1);
+        Computer::clear_transmission_probability_cache();
+        REQUIRE(Computer::get_transmission_probability_cache_size() == 0);
+        shared_ptr<const Vector2D<Float> > recomputed = Computer::get_transmission_probabilities(10, 1);
+        REQUIRE(recomputed != matrix);
+        for (size_t i = 0; i < 4; i++) {
+            for (size_t j = 0; j < 4; j++) {
+                REQUIRE(recomputed->at(i,j) == matrix->at(i,j));
+            }
+        }
+    }
+}
+
+TEST_CASE("test transmission probability cache", "[test transmission probability cache]") {
+
+    SECTION("cached matrices equal per-column computation", "[cached values]") {
+        check_transmission_probabilities<long double>();
+        check_transmission_probabilities<double>();
+    }
+
+    SECTION("computers of columns with equal recombination costs share one matrix", "[sharing]") {
+        mt19937 rng(13);
+        RandomPedigree instance(rng, 2, 8, 10, false);
+        vector<PedigreePartitions*> partitions;
+        for (unsigned int t = 0; t < 16; t++) {
+            partitions.push_back(new PedigreePartitions(instance.pedigree, t));
+        }
+        TransitionProbabilityComputer<>::clear_transmission_probability_cache();
+        for (size_t column_index = 0; column_index < instance.positions.size(); column_index++) {
+            TransitionProbabilityComputer<> computer(column_index, 10 + column_index % 2, &instance.pedigree, partitions);
+            shared_ptr<const Vector2D<long double> > matrix = TransitionProbabilityComputer<>::get_transmission_probabilities(10 + column_index % 2, 2);
+            for (unsigned int t1 = 0; t1 < 16; t1++) {
+                for (unsigned int t2 = 0; t2 < 16; t2++) {
+                    REQUIRE(computer.get_prob_transmission(t1, t2) == matrix->at(t1, t2));
+                }
+            }
+        }
+        REQUIRE(TransitionProbabilityComputer<>::get_transmission_probability_cache_size() == 2);
+        for (PedigreePartitions* p : partitions) {
+            delete p;
+        }
+    }
+
+    SECTION("concurrent lookups of the same key give one matrix", "[concurrency]") {
+        TransitionProbabilityComputer<>::clear_transmission_probability_cache();
+        vector<shared_ptr<const Vector2D<long double> > > matrices(8);
+        vector<thread> threads;
+        for (size_t i = 0; i < matrices.size(); i++) {
+            threads.emplace_back([&matrices, i]() {
+                matrices[i] = TransitionProbabilityComputer<>::get_transmission_probabilities(25, 3);
+            });
+        }
+        for (thread& t : threads) {
+            t.join();
+        }
+        for (size_t i = 1; i < matrices.size(); i++) {
+            REQUIRE(matrices[i] == matrices[0]);
+        }
+        REQUIRE(TransitionProbabilityComputer<>::get_transmission_probability_cache_size() == 1);
+    }
+}
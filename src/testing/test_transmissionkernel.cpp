@@ -0,0 +1,198 @@
+#include "../transmissionkernel.h"
+
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "catch.hpp"
+
+using namespace std;
+
+namespace {
+
+    const unsigned int INF = numeric_limits<unsigned int>::max();
+
+    // costs drawn from few distinct values, such that there are many ties, infinite costs and
+    // sums that saturate
+    vector<unsigned int> random_costs(mt19937& rng, size_t count) {
+        const vector<unsigned int> values = {0, 1, 2, 3, 7, INF / 2, INF - 1, INF, INF};
+        uniform_int_distribution<size_t> pick(0, values.size() - 1);
+        vector<unsigned int> costs(count);
+        for (size_t i = 0; i < count; i++) {
+            costs[i] = values[pick(rng)];
+        }
+        return costs;
+    }
+
+    // dp and min_index by definition: the smallest j attaining the minimum, infinity and 0 if none is finite
+    void naive_kernel(unsigned int n, unsigned int m, const unsigned int* penalty, const unsigned int* current_cost, const unsigned int* previous_cost, unsigned int* dp, unsigned int* min_index) {
+        for (unsigned int i = 0; i < n; i++) {
+            unsigned long long best = INF;
+            min_index[i] = 0;
+            for (unsigned int j = 0; j < m; j++) {
+                unsigned long long val = (unsigned long long)current_cost[i] + previous_cost[j] + penalty[j*n + i];
+                if (val > INF) val = INF;
+                if (val < best) {
+                    best = val;
+                    min_index[i] = j;
+                }
+            }
+            dp[i] = best;
+        }
+    }
+
+    // compares the unrolled kernel for N transmission values with compute, with and without previous costs
+    template <unsigned int N>
+    void check_compute_fixed(mt19937& rng, unsigned int recombcost) {
+        TransmissionKernel transmission_kernel(N, recombcost);
+        vector<unsigned int> current_cost = random_costs(rng, N);
+        vector<unsigned int> previous_cost = random_costs(rng, N);
+        vector<unsigned int> expected_dp(N), expected_index(N), dp(N), min_index(N);
+        for (const unsigned int* previous : {(const unsigned int*)previous_cost.data(), (const unsigned int*)nullptr}) {
+            transmission_kernel.compute(current_cost.data(), previous, expected_dp.data(), expected_index.data());
+            transmission_kernel.compute_fixed<N>(current_cost.data(), previous, dp.data(), min_index.data());
+            REQUIRE(dp == expected_dp);
+            REQUIRE(min_index == expected_index);
+        }
+    }
+
+    // random non-empty ascending subset of the values 0, ..., n-1
+    vector<unsigned int> random_values(mt19937& rng, unsigned int n) {
+        vector<unsigned int> values;
+        while (values.empty()) {
+            for (unsigned int i = 0; i < n; i++) {
+                if (rng() % 3 == 0) {
+                    values.push_back(i);
+                }
+            }
+        }
+        return values;
+    }
+
+    // costs of all values not in the given list are infinite
+    vector<unsigned int> restricted_costs(mt19937& rng, unsigned int n, const vector<unsigned int>& values) {
+        vector<unsigned int> costs(n, INF);
+        vector<unsigned int> finite = random_costs(rng, values.size());
+        for (size_t k = 0; k < values.size(); k++) {
+            costs[values[k]] = finite[k];
+        }
+        return costs;
+    }
+}
+
+TEST_CASE("test transmission kernels", "[test transmission kernels]") {
+    mt19937 rng(42);
+    TransmissionKernel::kernel_t scalar = TransmissionKernel::get_kernel("scalar");
+    REQUIRE(scalar != nullptr);
+    REQUIRE(TransmissionKernel::get_kernel("unknown") == nullptr);
+
+    for (const string instruction_set : {"scalar", "sse4.1", "avx2"}) {
+        TransmissionKernel::kernel_t kernel = TransmissionKernel::get_kernel(instruction_set);
+        if (kernel == nullptr) {
+            WARN("instruction set " << instruction_set << " not supported, kernel not tested");
+            continue;
+        }
+        SECTION("kernel " + instruction_set + " agrees with scalar kernel") {
+            unsigned int lanes = (instruction_set == "avx2") ? 8 : 4;
+            for (unsigned int n : {lanes, 2*lanes, 16u, 64u}) {
+                for (unsigned int m : {1u, 3u, n}) {
+                    for (int repeat = 0; repeat < 50; repeat++) {
+                        vector<unsigned int> penalty = random_costs(rng, n*m);
+                        vector<unsigned int> current_cost = random_costs(rng, n);
+                        vector<unsigned int> previous_cost = random_costs(rng, m);
+                        vector<unsigned int> expected_dp(n), expected_index(n), dp(n), min_index(n);
+                        naive_kernel(n, m, penalty.data(), current_cost.data(), previous_cost.data(), expected_dp.data(), expected_index.data());
+                        scalar(n, m, penalty.data(), current_cost.data(), previous_cost.data(), dp.data(), min_index.data());
+                        REQUIRE(dp == expected_dp);
+                        REQUIRE(min_index == expected_index);
+                        kernel(n, m, penalty.data(), current_cost.data(), previous_cost.data(), dp.data(), min_index.data());
+                        REQUIRE(dp == expected_dp);
+                        REQUIRE(min_index == expected_index);
+                    }
+                }
+            }
+        }
+    }
+
+    SECTION("all costs saturated", "[all costs saturated]") {
+        for (const string instruction_set : {"scalar", "sse4.1", "avx2"}) {
+            TransmissionKernel::kernel_t kernel = TransmissionKernel::get_kernel(instruction_set);
+            if (kernel == nullptr) continue;
+            vector<unsigned int> penalty(16*16, 1), current_cost(16, INF), previous_cost(16, 0), dp(16, 0), min_index(16, 1);
+            kernel(16, 16, penalty.data(), current_cost.data(), previous_cost.data(), dp.data(), min_index.data());
+            REQUIRE(dp == vector<unsigned int>(16, INF));
+            REQUIRE(min_index == vector<unsigned int>(16, 0));
+        }
+    }
+
+    SECTION("ties are resolved towards the smallest previous value", "[ties]") {
+        for (const string instruction_set : {"scalar", "sse4.1", "avx2"}) {
+            TransmissionKernel::kernel_t kernel = TransmissionKernel::get_kernel(instruction_set);
+            if (kernel == nullptr) continue;
+            // all sums are 5, except for previous value 0, which is infinite
+            vector<unsigned int> penalty(8*8, 2), current_cost(8, 3), previous_cost(8, 0), dp(8), min_index(8);
+            previous_cost[0] = INF;
+            kernel(8, 8, penalty.data(), current_cost.data(), previous_cost.data(), dp.data(), min_index.data());
+            REQUIRE(dp == vector<unsigned int>(8, 5));
+            REQUIRE(min_index == vector<unsigned int>(8, 1));
+        }
+    }
+
+    SECTION("compute uses zero previous costs for the first column", "[first column]") {
+        for (unsigned int n : {1u, 4u, 16u, 64u}) {
+            TransmissionKernel transmission_kernel(n, 10);
+            vector<unsigned int> current_cost = random_costs(rng, n);
+            vector<unsigned int> zeros(n, 0), expected_dp(n), expected_index(n), dp(n), min_index(n);
+            transmission_kernel.compute(current_cost.data(), nullptr, dp.data(), min_index.data());
+            transmission_kernel.compute(current_cost.data(), zeros.data(), expected_dp.data(), expected_index.data());
+            REQUIRE(dp == expected_dp);
+            REQUIRE(min_index == expected_index);
+            // with zero previous costs, staying at the same transmission value is optimal
+            for (unsigned int i = 0; i < n; i++) {
+                REQUIRE(dp[i] == current_cost[i]);
+                REQUIRE(min_index[i] == ((current_cost[i] == INF) ? 0 : i));
+            }
+        }
+    }
+
+    SECTION("compute_fixed agrees with compute", "[compute_fixed]") {
+        for (unsigned int recombcost : {0u, 1u, 10u, INF / 4}) {
+            for (int repeat = 0; repeat < 100; repeat++) {
+                check_compute_fixed<1>(rng, recombcost);
+                check_compute_fixed<4>(rng, recombcost);
+                check_compute_fixed<16>(rng, recombcost);
+            }
+        }
+    }
+
+    SECTION("restricted kernel agrees with unrestricted kernel", "[restricted]") {
+        for (unsigned int n : {1u, 4u, 16u, 64u}) {
+            for (unsigned int recombcost : {0u, 3u, 10u}) {
+                TransmissionKernel unrestricted(n, recombcost);
+                vector<unsigned int> all_values(n);
+                for (unsigned int i = 0; i < n; i++) {
+                    all_values[i] = i;
+                }
+                for (int repeat = 0; repeat < 50; repeat++) {
+                    vector<unsigned int> current_values = random_values(rng, n);
+                    vector<unsigned int> previous_values = random_values(rng, n);
+                    vector<unsigned int> current_cost = restricted_costs(rng, n, current_values);
+                    vector<unsigned int> previous_cost = restricted_costs(rng, n, previous_values);
+                    vector<unsigned int> expected_dp(n), expected_index(n), dp(n), min_index(n);
+                    TransmissionKernel restricted(n, recombcost, current_values, previous_values);
+                    unrestricted.compute(current_cost.data(), previous_cost.data(), expected_dp.data(), expected_index.data());
+                    restricted.compute(current_cost.data(), previous_cost.data(), dp.data(), min_index.data());
+                    REQUIRE(dp == expected_dp);
+                    REQUIRE(min_index == expected_index);
+                    // first column: all previous values are possible, with zero costs
+                    TransmissionKernel first_column(n, recombcost, current_values, all_values);
+                    unrestricted.compute(current_cost.data(), nullptr, expected_dp.data(), expected_index.data());
+                    first_column.compute(current_cost.data(), nullptr, dp.data(), min_index.data());
+                    REQUIRE(dp == expected_dp);
+                    REQUIRE(min_index == expected_index);
+                }
+            }
+        }
+    }
+}
@@ -2,20 +2,116 @@
 #include <cmath>
 #include <iostream>
 #include <cassert>
+#include <mutex>
+#include <utility>
 
 #include "phredgenotypelikelihoods.h"
 
 using namespace std;
 
-TransitionProbabilityComputer::TransitionProbabilityComputer(size_t column_index, unsigned int recombcost, const Pedigree* pedigree, const std::vector<PedigreePartitions*>& pedigree_partitions)
+namespace {
+    // transmission probability matrices keyed by recombination cost and number of trios
+    template <typename Float>
+    struct transmission_probability_cache_t {
+        mutex cache_mutex;
+        map<pair<unsigned int, size_t>, shared_ptr<const Vector2D<Float> > > cache;
+    };
+
+    template <typename Float>
+    transmission_probability_cache_t<Float>& transmission_probability_cache() {
+        static transmission_probability_cache_t<Float> cache;
+        return cache;
+    }
+}
+
+template <typename Float>
+TransitionProbabilityComputer<Float>::TransitionProbabilityComputer(size_t column_index, unsigned int recombcost, const Pedigree* pedigree, const std::vector<PedigreePartitions*>& pedigree_partitions)
     :transmission_configurations(pow(4, pedigree->triple_count())),
      allele_assignments(1<<pedigree_partitions[0]->count()),
-     transitions_transmissions(transmission_configurations,transmission_configurations,0.0L),
+     transitions_transmissions(get_transmission_probabilities(recombcost, pedigree->triple_count())),
      pedigree(pedigree),
      pedigree_partitions(pedigree_partitions),
      transitions_allele_assignments(transmission_configurations,allele_assignments)
 {
-    size_t trio_count = pedigree->triple_count();
+    // probabilities are computed in long double precision and only rounded to Float when stored
+    Vector2D<long double> allele_assignment_probs(transmission_configurations,allele_assignments);
+
+    // genotype likelihoods of all individuals at this column
+    size_t individual_count = pedigree->size();
+    std::vector<const double*> likelihoods(individual_count);
+    for (size_t individuals_index = 0; individuals_index < individual_count; ++individuals_index) {
+        const PhredGenotypeLikelihoods* gls = pedigree->get_genotype_likelihoods(individuals_index, column_index);
+        assert(gls != nullptr);
+        likelihoods[individuals_index] = gls->as_vector().data();
+    }
+
+    // compute transition probabilities corresponding to allele assignments
+    for(size_t i = 0; i < transmission_configurations; ++i){
+        // genotypes given by each allele assignment and the number of allele assignments giving the
+        // same genotype vector; both only depend on the pedigree partitions and are shared by all columns
+        const std::vector<unsigned int>& genotypes = pedigree_partitions[i]->get_assignment_genotypes();
+        const std::vector<unsigned int>& multiplicities = pedigree_partitions[i]->get_assignment_multiplicities();
+
+        // divide each probability by the number of times the genotype vector occurs
+        long double normalization_sum = 0.0L;
+        for(unsigned int a = 0; a < allele_assignments; ++a){
+            long double prob = 1.0L;
+            for (size_t individuals_index = 0; individuals_index < individual_count; ++individuals_index) {
+                prob *= likelihoods[individuals_index][genotypes[a * individual_count + individuals_index]];
+            }
+            prob /= multiplicities[a];
+            allele_assignment_probs.set(i,a,prob);
+            normalization_sum += prob;
+        }
+
+        // normalize the probabilities
+        for(unsigned int a = 0; a < allele_assignments; ++a){
+            allele_assignment_probs.at(i,a) /= normalization_sum;
+        }
+    }
+
+    for(size_t i = 0; i < transmission_configurations; ++i){
+        for(unsigned int a = 0; a < allele_assignments; ++a){
+            transitions_allele_assignments.set(i,a,(Float)allele_assignment_probs.at(i,a));
+        }
+    }
+}
+
+template <typename Float>
+Float TransitionProbabilityComputer<Float>::get_prob_transmission(unsigned int t1, unsigned int t2)
+{
+    assert(t1 < transmission_configurations);
+    assert(t2 < transmission_configurations);
+    return transitions_transmissions->at(t1,t2);
+}
+
+template <typename Float>
+Float TransitionProbabilityComputer<Float>::get_prob_allele_assignment(unsigned int t, unsigned int a){
+    return transitions_allele_assignments.at(t,a);
+}
+
+template <typename Float>
+size_t TransitionProbabilityComputer<Float>::popcount(size_t& x) {
+    unsigned int count = 0;
+    for (;x; x >>= 1) {
+        count += x & 1;
+    }
+    return count;
+}
+
+template <typename Float>
+shared_ptr<const Vector2D<Float> > TransitionProbabilityComputer<Float>::get_transmission_probabilities(unsigned int recombcost, size_t trio_count)
+{
+    transmission_probability_cache_t<Float>& c = transmission_probability_cache<Float>();
+    pair<unsigned int, size_t> key(recombcost, trio_count);
+    lock_guard<mutex> lock(c.cache_mutex);
+    auto it = c.cache.find(key);
+    if (it != c.cache.end()) {
+        return it->second;
+    }
+
+    size_t transmission_configurations = pow(4, trio_count);
+    Vector2D<long double> transmission_probs(transmission_configurations,transmission_configurations,0.0L);
 
     // precompute bernoulli distribution
     long double recomb_prob = pow(10,-(long double)(recombcost)/10.0L);
@@ -33,72 +129,40 @@ TransitionProbabilityComputer::TransitionProbabilityComputer(size_t column_index
             // count how many bits are set
             x = popcount(x);
             long double prob = bernoulli[x];
-            transitions_transmissions.set(i,j, prob);
+            transmission_probs.set(i,j, prob);
             normalization_sum += prob;
         }
         // normalize row
         for(size_t j = 0; j < transmission_configurations; ++j){
-            transitions_transmissions.at(i,j) /= normalization_sum;
+            transmission_probs.at(i,j) /= normalization_sum;
         }
     }
 
-    // compute transition probabilities corresponding to allele assignments
+    shared_ptr<Vector2D<Float> > result = make_shared<Vector2D<Float> >(transmission_configurations,transmission_configurations,0.0);
     for(size_t i = 0; i < transmission_configurations; ++i){
-        // maps genotype vectors to the number of possible allele assignments
-        std::map< std::vector<Genotype>, size_t > genotypes_to_haplotype_counts;
-        // maps a haplotype to the corresponding genotype
-        std::vector< std::vector<Genotype> > haplotypes_to_genotypes(allele_assignments);
-        for(unsigned int a = 0; a < allele_assignments; ++a){
-            long double prob = 1.0L;
-            vector<Genotype> genotype_vector;
-            for (size_t individuals_index = 0; individuals_index < pedigree->size(); ++individuals_index) {
-                unsigned int partition0 = pedigree_partitions[i]->haplotype_to_partition(individuals_index,0);
-                unsigned int partition1 = pedigree_partitions[i]->haplotype_to_partition(individuals_index,1);
-                unsigned int allele0 = (a >> partition0) & 1;
-                unsigned int allele1 = (a >> partition1) & 1;
-
-                Genotype genotype(vector<unsigned int>{allele0, allele1});
-                const PhredGenotypeLikelihoods* gls = pedigree->get_genotype_likelihoods(individuals_index, column_index);
-                assert(gls != nullptr);
-                prob *= gls->get(genotype);
-                genotype_vector.push_back(genotype);
-            }
-
-            // keep the results
-            genotypes_to_haplotype_counts[genotype_vector] += 1;
-            transitions_allele_assignments.set(i,a,prob);
-            haplotypes_to_genotypes[a] = genotype_vector;
-        }
-
-        // divide each probability by the number of times the genotype vector occurs
-        long double normalization_sum = 0.0L;
-        for(unsigned int a = 0; a < allele_assignments; ++a){
-            transitions_allele_assignments.at(i,a) /= genotypes_to_haplotype_counts[haplotypes_to_genotypes[a]];
-            normalization_sum += transitions_allele_assignments.at(i,a);
-        }
-
-        // normalize the probabilities
-        for(unsigned int a = 0; a < allele_assignments; ++a){
-            transitions_allele_assignments.at(i,a) /= normalization_sum;
+        for(size_t j = 0; j < transmission_configurations; ++j){
+            result->set(i,j,(Float)transmission_probs.at(i,j));
         }
     }
+    c.cache[key] = result;
+    return result;
 }
 
-long double TransitionProbabilityComputer::get_prob_transmission(unsigned int t1, unsigned int t2)
+template <typename Float>
+size_t TransitionProbabilityComputer<Float>::get_transmission_probability_cache_size()
 {
-    assert(t1 < transmission_configurations);
-    assert(t2 < transmission_configurations);
-    return transitions_transmissions.at(t1,t2);
+    transmission_probability_cache_t<Float>& c = transmission_probability_cache<Float>();
+    lock_guard<mutex> lock(c.cache_mutex);
+    return c.cache.size();
 }
 
-long double TransitionProbabilityComputer::get_prob_allele_assignment(unsigned int t, unsigned int a){
-    return transitions_allele_assignments.at(t,a);
+template <typename Float>
+void TransitionProbabilityComputer<Float>::clear_transmission_probability_cache()
+{
+    transmission_probability_cache_t<Float>& c = transmission_probability_cache<Float>();
+    lock_guard<mutex> lock(c.cache_mutex);
+    c.cache.clear();
 }
 
-size_t TransitionProbabilityComputer::popcount(size_t& x) {
-    unsigned int count = 0;
-    for (;x; x >>= 1) {
-        count += x & 1;
-    }
-    return count;
-}
+template class TransitionProbabilityComputer<long double>;
+template class TransitionProbabilityComputer<double>;
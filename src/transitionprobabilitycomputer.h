@@ -2,27 +2,45 @@
 #define TRANSITIONPROBABILITYCOMPUTER_H
 
 #include <map>
+#include <memory>
 #include "vector2d.h"
 #include "pedigree.h"
 #include "pedigreepartitions.h"
 
+/** Transition and allele assignment probabilities of one column of the genotyping DP.
+ *  All probabilities are computed in long double precision and stored as Float, which is
+ *  the numeric type used by the DP table (see GenotypeDPTable).
+ *
+ *  Transition probabilities between transmission values only depend on the recombination cost
+ *  and the number of trios. They are computed once per such combination and shared (read-only)
+ *  between all columns and DP tables, see get_transmission_probabilities().
+ */
+template <typename Float = long double>
 class TransitionProbabilityComputer {
 private:
     unsigned int transmission_configurations;
     unsigned int allele_assignments;
-    Vector2D<long double> transitions_transmissions;
-    size_t popcount(size_t& x);
+    std::shared_ptr<const Vector2D<Float> > transitions_transmissions;
+    static size_t popcount(size_t& x);
 
     const Pedigree* pedigree;
     const std::vector<PedigreePartitions*>& pedigree_partitions;
     // transitions to allele assignments
-    Vector2D<long double> transitions_allele_assignments;
+    Vector2D<Float> transitions_allele_assignments;
 
 public:
     TransitionProbabilityComputer(size_t column_index, unsigned int recombcost, const Pedigree* pedigree, const std::vector<PedigreePartitions*>& pedigree_partitions);
     // get the transision probability for change of transmission vector t1 to t2
-    long double get_prob_transmission(unsigned int t1, unsigned int t2);
-    long double get_prob_allele_assignment(unsigned int t, unsigned int a);
+    Float get_prob_transmission(unsigned int t1, unsigned int t2);
+    Float get_prob_allele_assignment(unsigned int t, unsigned int a);
+
+    /** Returns the (cached) matrix of transition probabilities between transmission values
+     *  for the given recombination cost and number of trios. Thread-safe. */
+    static std::shared_ptr<const Vector2D<Float> > get_transmission_probabilities(unsigned int recombcost, size_t trio_count);
+    /** Returns the number of transmission probability matrices currently cached. */
+    static size_t get_transmission_probability_cache_size();
+    /** Removes all matrices from the cache. Matrices still in use remain valid. */
+    static void clear_transmission_probability_cache();
 };
 
 #endif // TRANSITIONPROBABILITYCOMPUTER_H
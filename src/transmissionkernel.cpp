@@ -0,0 +1,203 @@
+#include <limits>
+#include <cassert>
+
+#include "transmissionkernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TRANSMISSION_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+	inline unsigned int saturating_add(unsigned int a, unsigned int b) {
+		unsigned int s = a + b;
+		return (s < a) ? numeric_limits<unsigned int>::max() : s;
+	}
+
+	void kernel_scalar(unsigned int n, unsigned int m, const unsigned int* penalty, const unsigned int* current_cost, const unsigned int* previous_cost, unsigned int* dp, unsigned int* min_index) {
+		for (unsigned int i = 0; i < n; ++i) {
+			dp[i] = numeric_limits<unsigned int>::max();
+			min_index[i] = 0;
+		}
+		for (unsigned int j = 0; j < m; ++j) {
+			const unsigned int* penalty_row = penalty + j*n;
+			for (unsigned int i = 0; i < n; ++i) {
+				unsigned int val = saturating_add(saturating_add(current_cost[i], previous_cost[j]), penalty_row[i]);
+				// strict comparison: ties are resolved in favor of the smallest j
+				if (val < dp[i]) {
+					dp[i] = val;
+					min_index[i] = j;
+				}
+			}
+		}
+	}
+
+#ifdef TRANSMISSION_KERNEL_X86
+	// The vectorized kernels process the transmission values i in lanes and loop over j
+	// such that ties are resolved in favor of the smallest j, exactly as in the scalar kernel.
+
+	__attribute__((target("sse4.1")))
+	inline __m128i saturating_add_sse41(__m128i a, __m128i b) {
+		__m128i s = _mm_add_epi32(a, b);
+		// overflow occured iff s < a, i.e. iff min(s,a) != a
+		__m128i no_overflow = _mm_cmpeq_epi32(_mm_min_epu32(s, a), a);
+		return _mm_or_si128(s, _mm_xor_si128(no_overflow, _mm_set1_epi32(-1)));
+	}
+
+	__attribute__((target("sse4.1")))
+	void kernel_sse41(unsigned int n, unsigned int m, const unsigned int* penalty, const unsigned int* current_cost, const unsigned int* previous_cost, unsigned int* dp, unsigned int* min_index) {
+		assert(n % 4 == 0);
+		for (unsigned int i = 0; i < n; i += 4) {
+			__m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current_cost + i));
+			__m128i best = _mm_set1_epi32(-1);
+			__m128i best_index = _mm_setzero_si128();
+			for (unsigned int j = 0; j < m; ++j) {
+				__m128i val = saturating_add_sse41(current, _mm_set1_epi32(previous_cost[j]));
+				val = saturating_add_sse41(val, _mm_loadu_si128(reinterpret_cast<const __m128i*>(penalty + j*n + i)));
+				__m128i new_best = _mm_min_epu32(best, val);
+				// lanes where val < best
+				__m128i improved = _mm_xor_si128(_mm_cmpeq_epi32(new_best, best), _mm_set1_epi32(-1));
+				best_index = _mm_blendv_epi8(best_index, _mm_set1_epi32(j), improved);
+				best = new_best;
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dp + i), best);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(min_index + i), best_index);
+		}
+	}
+
+	__attribute__((target("avx2")))
+	inline __m256i saturating_add_avx2(__m256i a, __m256i b) {
+		__m256i s = _mm256_add_epi32(a, b);
+		__m256i no_overflow = _mm256_cmpeq_epi32(_mm256_min_epu32(s, a), a);
+		return _mm256_or_si256(s, _mm256_xor_si256(no_overflow, _mm256_set1_epi32(-1)));
+	}
+
+	__attribute__((target("avx2")))
+	void kernel_avx2(unsigned int n, unsigned int m, const unsigned int* penalty, const unsigned int* current_cost, const unsigned int* previous_cost, unsigned int* dp, unsigned int* min_index) {
+		assert(n % 8 == 0);
+		for (unsigned int i = 0; i < n; i += 8) {
+			__m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(current_cost + i));
+			__m256i best = _mm256_set1_epi32(-1);
+			__m256i best_index = _mm256_setzero_si256();
+			for (unsigned int j = 0; j < m; ++j) {
+				__m256i val = saturating_add_avx2(current, _mm256_set1_epi32(previous_cost[j]));
+				val = saturating_add_avx2(val, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(penalty + j*n + i)));
+				__m256i new_best = _mm256_min_epu32(best, val);
+				__m256i improved = _mm256_xor_si256(_mm256_cmpeq_epi32(new_best, best), _mm256_set1_epi32(-1));
+				best_index = _mm256_blendv_epi8(best_index, _mm256_set1_epi32(j), improved);
+				best = new_best;
+			}
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dp + i), best);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(min_index + i), best_index);
+		}
+	}
+
+	bool cpu_supports(const char* feature) {
+		__builtin_cpu_init();
+		if (feature[0] == 'a') return __builtin_cpu_supports("avx2");
+		return __builtin_cpu_supports("sse4.1");
+	}
+#endif
+
+	TransmissionKernel::kernel_t select_kernel(unsigned int n) {
+#ifdef TRANSMISSION_KERNEL_X86
+		static const bool has_avx2 = cpu_supports("avx2");
+		static const bool has_sse41 = cpu_supports("sse4.1");
+		if ((n % 8 == 0) && has_avx2) return kernel_avx2;
+		if ((n % 4 == 0) && has_sse41) return kernel_sse41;
+#endif
+		return kernel_scalar;
+	}
+}
+
+
+TransmissionKernel::TransmissionKernel(unsigned int transmission_configurations, unsigned int recombcost) :
+	transmission_configurations(transmission_configurations),
+	penalty(transmission_configurations*transmission_configurations, 0),
+	zeros(transmission_configurations, 0),
+	kernel(select_kernel(transmission_configurations)),
+	restricted(false)
+{
+	for (unsigned int j = 0; j < transmission_configurations; ++j) {
+		for (unsigned int i = 0; i < transmission_configurations; ++i) {
+			unsigned int recombinations = __builtin_popcount(i ^ j);
+			penalty[j*transmission_configurations + i] = recombinations * recombcost;
+		}
+	}
+}
+
+
+TransmissionKernel::TransmissionKernel(unsigned int transmission_configurations, unsigned int recombcost, const vector<unsigned int>& current_values, const vector<unsigned int>& previous_values) :
+	transmission_configurations(transmission_configurations),
+	penalty(current_values.size()*previous_values.size(), 0),
+	zeros(transmission_configurations, 0),
+	kernel(select_kernel(current_values.size())),
+	restricted(true),
+	current_values(current_values),
+	previous_values(previous_values),
+	current_buffer(current_values.size()),
+	previous_buffer(previous_values.size()),
+	dp_buffer(current_values.size()),
+	min_index_buffer(current_values.size())
+{
+	unsigned int n = current_values.size();
+	for (unsigned int j = 0; j < previous_values.size(); ++j) {
+		assert(previous_values[j] < transmission_configurations);
+		for (unsigned int i = 0; i < n; ++i) {
+			assert(current_values[i] < transmission_configurations);
+			unsigned int recombinations = __builtin_popcount(current_values[i] ^ previous_values[j]);
+			penalty[j*n + i] = recombinations * recombcost;
+		}
+	}
+}
+
+
+void TransmissionKernel::compute(const unsigned int* current_cost, const unsigned int* previous_cost, unsigned int* dp, unsigned int* min_index) {
+	if (previous_cost == nullptr) {
+		previous_cost = zeros.data();
+	}
+	if (!restricted) {
+		kernel(transmission_configurations, transmission_configurations, penalty.data(), current_cost, previous_cost, dp, min_index);
+		return;
+	}
+	for (unsigned int i = 0; i < current_values.size(); ++i) {
+		current_buffer[i] = current_cost[current_values[i]];
+	}
+	for (unsigned int j = 0; j < previous_values.size(); ++j) {
+		previous_buffer[j] = previous_cost[previous_values[j]];
+	}
+	kernel(current_values.size(), previous_values.size(), penalty.data(), current_buffer.data(), previous_buffer.data(), dp_buffer.data(), min_index_buffer.data());
+	for (unsigned int i = 0; i < transmission_configurations; ++i) {
+		dp[i] = numeric_limits<unsigned int>::max();
+		min_index[i] = 0;
+	}
+	// previous values are ascending, so ties are still resolved in favor of the smallest j
+	for (unsigned int i = 0; i < current_values.size(); ++i) {
+		if (dp_buffer[i] < numeric_limits<unsigned int>::max()) {
+			dp[current_values[i]] = dp_buffer[i];
+			min_index[current_values[i]] = previous_values[min_index_buffer[i]];
+		}
+	}
+}
+
+
+const char* TransmissionKernel::instruction_set() {
+#ifdef TRANSMISSION_KERNEL_X86
+	if (cpu_supports("avx2")) return "avx2";
+	if (cpu_supports("sse4.1")) return "sse4.1";
+#endif
+	return "scalar";
+}
+
+
+TransmissionKernel::kernel_t TransmissionKernel::get_kernel(const string& instruction_set) {
+#ifdef TRANSMISSION_KERNEL_X86
+	if ((instruction_set == "avx2") && cpu_supports("avx2")) return kernel_avx2;
+	if ((instruction_set == "sse4.1") && cpu_supports("sse4.1")) return kernel_sse41;
+#endif
+	if (instruction_set == "scalar") return kernel_scalar;
+	return nullptr;
+}
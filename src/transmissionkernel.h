@@ -0,0 +1,102 @@
+#ifndef TRANSMISSION_KERNEL_H
+#define TRANSMISSION_KERNEL_H
+
+#include <vector>
+#include <limits>
+#include <string>
+
+/** Min-plus kernel used by PedigreeDPTable to combine the cost of a DP cell with the
+ *  previous projection column over all pairs of transmission values.
+ *
+ *  For a given column, the penalty matrix popcount(i^j) * recombcost is precomputed once.
+ *  All additions saturate at numeric_limits<unsigned int>::max(), which hence serves as
+ *  "infinity" without any branching. Depending on the CPU, an AVX2, SSE4.1 or a scalar
+ *  implementation is picked at runtime; all of them give identical results.
+ */
+class TransmissionKernel {
+public:
+	/** Constructor.
+	 *  @param transmission_configurations Number of transmission values (i.e. 4^trios).
+	 *  @param recombcost Cost of a single recombination event in the current column.
+	 */
+	TransmissionKernel(unsigned int transmission_configurations, unsigned int recombcost);
+
+	/** Constructor for a kernel restricted to the transmission values that can have a finite cost,
+	 *  e.g. because they are compatible with the genotypes. Gives the same results as the
+	 *  unrestricted kernel, provided that all current costs not in current_values and all
+	 *  previous costs not in previous_values are infinite. Only the pairs of values from these
+	 *  lists are combined.
+	 *  @param current_values Transmission values with possibly finite current cost, ascending.
+	 *  @param previous_values Transmission values with possibly finite previous cost, ascending.
+	 */
+	TransmissionKernel(unsigned int transmission_configurations, unsigned int recombcost, const std::vector<unsigned int>& current_values, const std::vector<unsigned int>& previous_values);
+
+	/** For every transmission value i, computes
+	 *    dp[i] = min_j (current_cost[i] + previous_cost[j] + popcount(i^j) * recombcost)
+	 *  and stores the smallest j attaining this minimum in min_index[i]. If no finite value
+	 *  exists, dp[i] is set to infinity and min_index[i] to 0.
+	 *  @param previous_cost May be null (for the first column), in which case it is taken to be zero.
+	 *  A restricted kernel uses internal buffers, so one object must not be used by several threads.
+	 */
+	void compute(const unsigned int* current_cost, const unsigned int* previous_cost, unsigned int* dp, unsigned int* min_index);
+
+	/** Same as compute, for N transmission values known at compile time (N must equal the number given to
+	 *  the constructor), such that both loops are fully unrolled. Meant for N = 1 (no trios), where this is a
+	 *  single addition; already for N = 4, the vectorized kernels are at least as fast. */
+	template <unsigned int N>
+	void compute_fixed(const unsigned int* current_cost, const unsigned int* previous_cost, unsigned int* dp, unsigned int* min_index) const {
+		if (previous_cost == nullptr) {
+			previous_cost = zeros.data();
+		}
+		const unsigned int* p = penalty.data();
+		for (unsigned int i = 0; i < N; ++i) {
+			dp[i] = std::numeric_limits<unsigned int>::max();
+			min_index[i] = 0;
+		}
+		for (unsigned int j = 0; j < N; ++j) {
+			for (unsigned int i = 0; i < N; ++i) {
+				unsigned int val = saturating_add(saturating_add(current_cost[i], previous_cost[j]), p[j*N + i]);
+				if (val < dp[i]) {
+					dp[i] = val;
+					min_index[i] = j;
+				}
+			}
+		}
+	}
+
+	/** Returns the name of the instruction set used ("avx2", "sse4.1" or "scalar"). */
+	static const char* instruction_set();
+
+	/** Computes dp and min_index for n current and m previous values, penalty being an m x n matrix. */
+	typedef void (*kernel_t)(unsigned int n, unsigned int m, const unsigned int* penalty, const unsigned int* current_cost, const unsigned int* previous_cost, unsigned int* dp, unsigned int* min_index);
+
+	/** Returns the kernel for the given instruction set ("avx2", "sse4.1" or "scalar"), or nullptr if it
+	 *  is not supported by the CPU. The avx2 kernel requires n to be a multiple of 8, the sse4.1 kernel a
+	 *  multiple of 4. Used to test the kernels against each other. */
+	static kernel_t get_kernel(const std::string& instruction_set);
+
+private:
+	static unsigned int saturating_add(unsigned int a, unsigned int b) {
+		unsigned int s = a + b;
+		return (s < a) ? std::numeric_limits<unsigned int>::max() : s;
+	}
+
+	unsigned int transmission_configurations;
+	// penalty[j*transmission_configurations + i] = popcount(i^j) * recombcost; stored row-wise by j
+	// such that the loop over i reads contiguous memory
+	std::vector<unsigned int> penalty;
+	// all-zero previous column used for the first DP column
+	std::vector<unsigned int> zeros;
+	kernel_t kernel;
+	// for a restricted kernel: the transmission values considered, penalty (then of size
+	// previous_values.size() x current_values.size()) and buffers for the restricted rows
+	bool restricted;
+	std::vector<unsigned int> current_values;
+	std::vector<unsigned int> previous_values;
+	std::vector<unsigned int> current_buffer;
+	std::vector<unsigned int> previous_buffer;
+	std::vector<unsigned int> dp_buffer;
+	std::vector<unsigned int> min_index_buffer;
+};
+
+#endif
@@ -0,0 +1,340 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+#include "vcfrewriter.h"
+
+using namespace std;
+
+namespace {
+
+// chunks smaller than this are rewritten on a single thread
+const size_t MIN_BYTES_PER_THREAD = 1 << 20;
+
+// a column or field of a record, given by its first character and its length
+typedef pair<const char*, size_t> field_t;
+
+void split(const char* begin, const char* end, char separator, vector<field_t>* fields) {
+	fields->clear();
+	while (true) {
+		const char* next = (const char*)memchr(begin, separator, end - begin);
+		if (next == nullptr) {
+			fields->emplace_back(begin, end - begin);
+			return;
+		}
+		fields->emplace_back(begin, next - begin);
+		begin = next + 1;
+	}
+}
+
+bool equals(const field_t& field, const char* s) {
+	return (field.second == strlen(s)) && (memcmp(field.first, s, field.second) == 0);
+}
+
+const char* line_end(const char* line, const char* end) {
+	const char* newline = (const char*)memchr(line, '\n', end - line);
+	return (newline == nullptr) ? end : newline;
+}
+
+// returns the length of the CHROM and POS columns of a line (including the tab between them)
+size_t key_length(const char* line, const char* end) {
+	const char* tab = (const char*)memchr(line, '\t', end - line);
+	if (tab != nullptr) {
+		tab = (const char*)memchr(tab + 1, '\t', end - tab - 1);
+	}
+	return ((tab == nullptr) ? end : tab) - line;
+}
+
+// appends the QUAL column formatted as htslib writes it (a float printed with "%g", such
+// as "500" for "500.0"), such that the output matches that of pysam; values that are not
+// finite numbers are copied unchanged
+void append_quality(const field_t& quality, string* output) {
+	string value(quality.first, quality.second);
+	char* parsed_end = nullptr;
+	float number = strtof(value.c_str(), &parsed_end);
+	if (value.empty() || parsed_end != value.c_str() + value.size() || !isfinite(number)) {
+		output->append(value);
+		return;
+	}
+	char formatted[32];
+	snprintf(formatted, sizeof(formatted), "%g", (double)number);
+	output->append(formatted);
+}
+
+// appends the line with its QUAL column (if there is one) formatted by append_quality
+void append_line(const char* line, const char* next_line, const vector<field_t>& columns, string* output) {
+	if (columns.size() < 6) {
+		output->append(line, next_line);
+		return;
+	}
+	const field_t& quality = columns[5];
+	output->append(line, quality.first);
+	append_quality(quality, output);
+	output->append(quality.first + quality.second, next_line);
+}
+
+// appends the genotype unphased, with its alleles sorted unless one is missing
+void append_unphased_genotype(const field_t& genotype, vector<unsigned long>* alleles, string* output) {
+	alleles->clear();
+	bool numeric = true;
+	unsigned long allele = 0;
+	size_t digits = 0;
+	for (size_t i = 0; i <= genotype.second; ++i) {
+		char c = (i < genotype.second) ? genotype.first[i] : '/';
+		if (c == '/' || c == '|') {
+			numeric = numeric && (digits > 0);
+			alleles->push_back(allele);
+			allele = 0;
+			digits = 0;
+		} else if (c >= '0' && c <= '9') {
+			allele = allele * 10 + (c - '0');
+			++digits;
+		} else {
+			numeric = false;
+		}
+	}
+	if (numeric && alleles->size() > 1) {
+		sort(alleles->begin(), alleles->end());
+		for (size_t i = 0; i < alleles->size(); ++i) {
+			if (i > 0) {
+				output->push_back('/');
+			}
+			output->append(to_string(alleles->at(i)));
+		}
+		return;
+	}
+	for (size_t i = 0; i < genotype.second; ++i) {
+		char c = genotype.first[i];
+		output->push_back((c == '|') ? '/' : c);
+	}
+}
+
+}
+
+VcfRewriter::VcfRewriter(const vector<string>& remove_tags, unsigned int threads, bool phased_chromosomes_only) :
+	remove_tags(remove_tags.begin(), remove_tags.end()),
+	threads(max(1u, threads)),
+	phased_chromosomes_only(phased_chromosomes_only)
+{
+	if (this->remove_tags.count("GT") > 0) {
+		throw std::invalid_argument("VcfRewriter: the GT field cannot be removed");
+	}
+}
+
+void VcfRewriter::set_phase(const string& chromosome, unsigned int position, int allele0, int allele1, int phase_set) {
+	if (allele0 < 0 || allele1 < 0) {
+		throw std::invalid_argument("VcfRewriter: alleles must not be negative");
+	}
+	phase_t phase = {allele0, allele1, phase_set};
+	phases[chromosome][position] = phase;
+}
+
+void VcfRewriter::rewrite(const string& chunk, string* output) {
+	const char* begin = chunk.data();
+	const char* end = begin + chunk.size();
+	if (begin == end) {
+		return;
+	}
+	if (end[-1] != '\n') {
+		throw std::invalid_argument("VcfRewriter: the chunk does not end with a complete line");
+	}
+
+	// split the chunk into parts of about equal size at line boundaries
+	size_t parts = max((size_t)1, min((size_t)threads, chunk.size() / MIN_BYTES_PER_THREAD));
+	vector<const char*> boundaries(1, begin);
+	for (size_t k = 1; k < parts; ++k) {
+		const char* boundary = max(boundaries.back(), begin + k * chunk.size() / parts);
+		boundary = min(end, line_end(boundary, end) + 1);
+		if (boundary < end) {
+			boundaries.push_back(boundary);
+		}
+	}
+	boundaries.push_back(end);
+	parts = boundaries.size() - 1;
+
+	// the record preceding each part
+	vector<field_t> previous_keys(1, field_t(last_key.data(), last_key.size()));
+	for (size_t k = 1; k < parts; ++k) {
+		const char* previous_end = boundaries[k] - 1;
+		const char* previous_line = previous_end;
+		while (previous_line > begin && previous_line[-1] != '\n') {
+			--previous_line;
+		}
+		previous_keys.emplace_back(previous_line, key_length(previous_line, previous_end));
+	}
+	const char* last_line = end - 1;
+	while (last_line > begin && last_line[-1] != '\n') {
+		--last_line;
+	}
+	string new_last_key(last_line, key_length(last_line, end - 1));
+
+	if (parts == 1) {
+		rewrite_lines(begin, end, previous_keys[0].first, previous_keys[0].second, output);
+	} else {
+		vector<string> outputs(parts);
+		vector<thread> workers;
+		vector<exception_ptr> errors(parts);
+		for (size_t k = 0; k < parts; ++k) {
+			workers.emplace_back([&, k]() {
+				try {
+					outputs[k].reserve(boundaries[k + 1] - boundaries[k]);
+					rewrite_lines(boundaries[k], boundaries[k + 1], previous_keys[k].first, previous_keys[k].second, &outputs[k]);
+				} catch (...) {
+					errors[k] = current_exception();
+				}
+			});
+		}
+		for (auto& worker : workers) {
+			worker.join();
+		}
+		for (auto& error : errors) {
+			if (error) {
+				rethrow_exception(error);
+			}
+		}
+		for (const string& part : outputs) {
+			output->append(part);
+		}
+	}
+	last_key = new_last_key;
+}
+
+void VcfRewriter::rewrite_lines(const char* begin, const char* end, const char* previous_key, size_t previous_key_length,
+	string* output) const
+{
+	vector<field_t> columns;
+	vector<field_t> keys;
+	vector<field_t> values;
+	vector<bool> keep;
+	vector<unsigned long> alleles;
+	// phases of the chromosome of the previous record (nullptr if it has none)
+	string chromosome;
+	const chromosome_phases_t* chromosome_phases = nullptr;
+
+	for (const char* line = begin; line < end; ) {
+		const char* line_stop = line_end(line, end);
+		const char* next_line = min(end, line_stop + 1);
+		if (line == line_stop || line[0] == '#') {
+			output->append(line, next_line);
+			line = next_line;
+			continue;
+		}
+		size_t line_key_length = key_length(line, line_stop);
+		bool duplicate = (previous_key_length == line_key_length) && (memcmp(previous_key, line, line_key_length) == 0);
+		previous_key = line;
+		previous_key_length = line_key_length;
+
+		split(line, line_stop, '\t', &columns);
+		if (chromosome.size() != columns[0].second || chromosome.compare(0, string::npos, columns[0].first, columns[0].second) != 0) {
+			chromosome.assign(columns[0].first, columns[0].second);
+			auto it = phases.find(chromosome);
+			chromosome_phases = (it == phases.end()) ? nullptr : &it->second;
+		}
+		if (phased_chromosomes_only && chromosome_phases == nullptr) {
+			line = next_line;
+			continue;
+		}
+		if (columns.size() < 10) {
+			// no samples
+			append_line(line, next_line, columns, output);
+			line = next_line;
+			continue;
+		}
+		split(columns[8].first, columns[8].first + columns[8].second, ':', &keys);
+		keep.assign(keys.size(), true);
+		size_t kept_keys = 0;
+		size_t genotype_index = keys.size();
+		for (size_t i = 0; i < keys.size(); ++i) {
+			if (equals(keys[i], "GT")) {
+				genotype_index = i;
+			} else if (!remove_tags.empty() && remove_tags.count(string(keys[i].first, keys[i].second)) > 0) {
+				keep[i] = false;
+				continue;
+			}
+			++kept_keys;
+		}
+
+		const phase_t* phase = nullptr;
+		if (chromosome_phases != nullptr && genotype_index < keys.size()) {
+			bool snv = (columns[3].second == 1) && (columns[4].second == 1) && !equals(columns[4], ".");
+			if (snv && !duplicate) {
+				unsigned long position = strtoul(string(columns[1].first, columns[1].second).c_str(), nullptr, 10);
+				auto it = (position > 0) ? chromosome_phases->find(position - 1) : chromosome_phases->end();
+				if (it != chromosome_phases->end()) {
+					phase = &it->second;
+				}
+			}
+		}
+		if (kept_keys == keys.size() && genotype_index == keys.size() && phase == nullptr) {
+			append_line(line, next_line, columns, output);
+			line = next_line;
+			continue;
+		}
+		bool phased = (phase != nullptr) && (phase->allele0 != phase->allele1);
+
+		output->append(line, columns[5].first);
+		append_quality(columns[5], output);
+		output->append(columns[5].first + columns[5].second, columns[8].first);
+		if (kept_keys == 0) {
+			output->push_back('.');
+		}
+		bool first = true;
+		for (size_t i = 0; i < keys.size(); ++i) {
+			if (keep[i]) {
+				if (!first) {
+					output->push_back(':');
+				}
+				output->append(keys[i].first, keys[i].second);
+				first = false;
+			}
+		}
+		if (phased) {
+			output->append(":PS");
+		}
+
+		for (size_t s = 0; s + 9 < columns.size(); ++s) {
+			const field_t& sample = columns[s + 9];
+			output->push_back('\t');
+			split(sample.first, sample.first + sample.second, ':', &values);
+			// the phased sample gets a value for every key, since PS is added last
+			bool set_phase = (s == 0) && (phase != nullptr);
+			size_t value_count = set_phase ? max(values.size(), keys.size()) : values.size();
+			first = true;
+			for (size_t i = 0; i < value_count; ++i) {
+				if (i < keys.size() && !keep[i]) {
+					continue;
+				}
+				if (!first) {
+					output->push_back(':');
+				}
+				first = false;
+				if (i == genotype_index && set_phase) {
+					// the alleles only differ if the genotype is phased
+					output->append(to_string(phase->allele0));
+					output->push_back(phased ? '|' : '/');
+					output->append(to_string(phase->allele1));
+				} else if (i >= values.size()) {
+					output->push_back('.');
+				} else if (i == genotype_index) {
+					append_unphased_genotype(values[i], &alleles, output);
+				} else {
+					output->append(values[i].first, values[i].second);
+				}
+			}
+			if (first) {
+				output->push_back('.');
+			}
+			if (set_phase && phased) {
+				output->push_back(':');
+				output->append(to_string(phase->phase_set));
+			}
+		}
+		output->append(line_stop, next_line);
+		line = next_line;
+	}
+}
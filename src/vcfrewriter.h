@@ -0,0 +1,60 @@
+#ifndef VCF_REWRITER_H
+#define VCF_REWRITER_H
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/** Rewrites the genotype fields of VCF records in text form, as "whatshap unphase" and
+ *  "whatshap hapcut2vcf" do. A record is only split at the tabs and colons needed to find
+ *  its FORMAT keys and sample values. QUAL is reformatted as htslib writes it, such that
+ *  the output matches that of pysam; all other columns are copied unchanged.
+ *
+ *  In every record, the values of the removed FORMAT keys are dropped from all samples and
+ *  all genotypes are unphased, with their alleles sorted if none is missing ('1|0' becomes
+ *  '0/1'). Afterwards, the phases given by set_phase() are applied to the first sample.
+ */
+class VcfRewriter {
+public:
+	/** @param remove_tags FORMAT keys whose values are removed (GT cannot be removed).
+	 *  @param threads Number of threads that rewrite the records of a chunk.
+	 *  @param phased_chromosomes_only If true, records on chromosomes without any phases
+	 *         given by set_phase() are dropped.
+	 */
+	VcfRewriter(const std::vector<std::string>& remove_tags, unsigned int threads, bool phased_chromosomes_only = false);
+
+	/** Phases the first sample at the given (0-based) position. If the record there is a
+	 *  biallelic SNV and not at the same position as the previous record, its genotype is
+	 *  replaced by the given alleles. If these differ, the genotype is written as phased
+	 *  ('allele0|allele1') and a PS field with the given phase set is added.
+	 */
+	void set_phase(const std::string& chromosome, unsigned int position, int allele0, int allele1, int phase_set);
+
+	/** Rewrites the records in chunk, which must consist of complete lines (each terminated by
+	 *  a newline), and appends them to output. Header lines are copied unchanged. Chunks must
+	 *  be given in the order of the file, since the first record of a chunk is compared to the
+	 *  last one of the previous chunk.
+	 */
+	void rewrite(const std::string& chunk, std::string* output);
+
+private:
+	typedef struct phase_t {
+		int allele0;
+		int allele1;
+		int phase_set;
+	} phase_t;
+	typedef std::unordered_map<unsigned int, phase_t> chromosome_phases_t;
+
+	void rewrite_lines(const char* begin, const char* end, const char* previous_key, size_t previous_key_length,
+		std::string* output) const;
+
+	std::unordered_set<std::string> remove_tags;
+	unsigned int threads;
+	bool phased_chromosomes_only;
+	std::unordered_map<std::string, chromosome_phases_t> phases;
+	// CHROM and POS columns (including the tab between them) of the last record rewritten
+	std::string last_key;
+};
+
+#endif
@@ -27,11 +27,24 @@ public:
 		v.assign(size0*size1, value);
 	}
 
-	size_t get_size0(){
+	/** Changes dimensions and sets all entries to the given value. Memory is only
+	 *  reallocated if the new size exceeds the capacity. */
+	void reset(size_t size0, size_t size1, const T& value) {
+		this->size0 = size0;
+		this->size1 = size1;
+		v.assign(size0*size1, value);
+	}
+
+	/** Returns the number of bytes allocated for the entries. */
+	size_t capacity() const {
+		return v.capacity() * sizeof(T);
+	}
+
+	size_t get_size0() const {
 	  return size0;
 	}
 
-	size_t get_size1(){
+	size_t get_size1() const {
 	  return size1;
 	}
 
@@ -68,6 +68,34 @@ def test_edit_distance_bytes():
         assert ed(s, t) == ed(t, s)
 
 
+def naive_edit_distance(s, t):
+    costs = list(range(len(s) + 1))
+    for j in range(1, len(t) + 1):
+        prev = costs[0]
+        costs[0] += 1
+        for i in range(1, len(s) + 1):
+            c = min(prev + (s[i - 1] != t[j - 1]), costs[i] + 1, costs[i - 1] + 1)
+            prev = costs[i]
+            costs[i] = c
+    return costs[len(s)]
+
+
+def test_edit_distance_long():
+    # strings that need more than one 64-bit word
+    seed(11)
+    for _ in range(50):
+        s = "".join(choice("ACGT") for _ in range(randint(60, 200)))
+        t = list(s)
+        for _ in range(randint(0, 20)):
+            t[randint(0, len(t) - 1)] = choice("ACGT")
+        t = "".join(t)[randint(0, 5) :]
+        assert ed(s, t) == naive_edit_distance(s, t)
+        assert ed(t, s) == naive_edit_distance(s, t)
+        assert_banded(s, t, 10)
+    assert ed("A" * 100, "A" * 50) == 50
+    assert ed("A" * 130, "C" * 130) == 130
+
+
 def assert_banded(s, t, maxdiff):
     banded_dist = ed(s, t, maxdiff=maxdiff)
     true_dist = ed(s, t)
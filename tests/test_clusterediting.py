@@ -1,7 +1,7 @@
 import itertools
 import math
 
-from whatshap.core import ClusterEditingSolver, scoreReadsetGlobal
+from whatshap.core import ClusterEditingSolver, TriangleSparseMatrix, scoreReadsetGlobal
 from whatshap.testhelpers import string_to_readset
 
 
@@ -130,3 +130,31 @@ def test_similarities2():
     readset = string_to_readset(reads)
     similarities = scoreReadsetGlobal(readset, 4, 4)
     print("computed similarities:", similarities)
+
+
+def test_clusterediting_threads():
+    # enough nodes such that the induced costs are initialized on several threads
+    similarities = TriangleSparseMatrix()
+    for i in range(500):
+        for j in range(i + 1, min(i + 20, 500)):
+            similarities.set(i, j, ((i * 31 + j * 17) % 23 - 11) / 2)
+    clusters1 = ClusterEditingSolver(similarities, False).run()
+    clusters4 = ClusterEditingSolver(similarities, False, 4).run()
+    assert clusters1 == clusters4
+
+
+def test_clusterediting_components():
+    # three groups of nodes without positive edges between them, plus an isolated node 12
+    similarities = TriangleSparseMatrix()
+    groups = [[0, 3, 6, 9], [1, 4, 7, 10], [2, 5, 8, 11]]
+    for group in groups:
+        for i in group:
+            for j in group:
+                if i < j:
+                    similarities.set(i, j, 2.0)
+    similarities.set(0, 1, -3.0)
+    similarities.set(4, 8, -1.0)
+    similarities.set(12, 11, -5.0)
+    for threads in [1, 3]:
+        clusters = ClusterEditingSolver(similarities, False, threads).run()
+        assert clusters == groups + [[12]]
@@ -0,0 +1,44 @@
+from whatshap.costmodel import CostModel, ProblemFeatures, compute_features
+from whatshap.testhelpers import string_to_readset
+
+
+def test_compute_features():
+    reads = string_to_readset(
+        """
+        11 0
+         01
+          110
+        """
+    )
+    # positions 10 ... 60; position 60 is not covered
+    features = compute_features(reads, [10, 20, 30, 40, 50, 60])
+    # coverages of the columns are 1, 2, 3, 2, 1, 0
+    assert features.coverage_histogram == {0: 1, 1: 2, 2: 2, 3: 1}
+    assert features.columns == 6
+    assert features.max_coverage == 3
+
+
+def engines(model, coverage, **kwargs):
+    features = ProblemFeatures({coverage: 1000}, **kwargs)
+    return {p.engine: p.seconds for p in model.predict(features, distrust_genotypes=False)}
+
+
+def test_whatshap_faster_at_low_coverage():
+    predictions = engines(CostModel(hapchat_max_coverage=256), 10)
+    assert predictions["whatshap"] < predictions["hapchat"]
+
+
+def test_hapchat_faster_at_high_coverage():
+    predictions = engines(CostModel(hapchat_max_coverage=256), 20)
+    assert predictions["hapchat"] < predictions["whatshap"]
+    # unless the WhatsHap DP uses enough threads
+    predictions = engines(CostModel(hapchat_max_coverage=256, threads=8), 20)
+    assert predictions["whatshap"] < predictions["hapchat"]
+
+
+def test_hapchat_restrictions():
+    model = CostModel(hapchat_max_coverage=16)
+    assert set(engines(model, 20)) == {"whatshap"}
+    assert set(engines(model, 10, individuals=3, trios=1)) == {"whatshap"}
+    features = ProblemFeatures({10: 1000})
+    assert len(model.predict(features, distrust_genotypes=True)) == 1
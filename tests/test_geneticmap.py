@@ -1,5 +1,9 @@
 import pytest
-from whatshap.pedigree import GeneticMapRecombinationCostComputer, ParseError
+from whatshap.pedigree import (
+    GeneticMapRecombinationCostComputer,
+    ParseError,
+    recombination_cost_map,
+)
 
 
 def test_read_genetic_map(tmp_path):
@@ -29,3 +33,20 @@ def test_invalid_float(tmp_path):
     path.write_text("ignored header\n" "55550 0 abc\n")
     with pytest.raises(ParseError):
         _ = GeneticMapRecombinationCostComputer(str(path))
+
+
+def test_native_costs_match_python(tmp_path):
+    path = tmp_path / "genetic.map"
+    path.write_text(
+        "ignored header\n"
+        "568527 0 0\n"
+        "600000 0 0.1\n"
+        "600000 0 0.1\n"
+        "650000 0 0.1\n"
+        "723891 2.9813105581 0.417644215424158\n"
+    )
+    computer = GeneticMapRecombinationCostComputer(str(path))
+    positions = [1000, 568527, 580000, 600000, 600001, 620000, 650000, 700000, 723891, 800000]
+    expected = recombination_cost_map(computer.load_genetic_map(str(path)), positions)
+    assert computer.compute(positions) == expected
+    assert computer.compute(positions[3:]) == [0] + expected[4:]
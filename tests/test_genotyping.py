@@ -1,10 +1,16 @@
 import math
+
+import pytest
+
 from whatshap.core import (
     ReadSet,
     Pedigree,
     NumericSampleIds,
     PhredGenotypeLikelihoods,
     GenotypeDPTable,
+    compute_genotypes,
+    compute_genotypes_batch,
+    binomial_coefficient,
 )
 from whatshap.testhelpers import (
     string_to_readset,
@@ -42,6 +48,19 @@ def compare_to_expected(dp_forward_backward, positions, expected=None, genotypes
             assert max_geno == genotypes[i]
 
 
+def test_binomial_coefficient():
+    # all coefficients of the precomputed table (n < 34) and some beyond it
+    for n in range(40):
+        for k in range(-1, n + 2):
+            expected = math.comb(n, k) if 0 <= k <= n else 0
+            if expected <= 2**31 - 1:
+                assert binomial_coefficient(n, k) == expected
+            else:
+                with pytest.raises(OverflowError):
+                    binomial_coefficient(n, k)
+    assert binomial_coefficient(1000, 2) == 499500
+
+
 def test_genotyping_empty_readset():
     rs = ReadSet()
     genotypes = canonic_index_list_to_biallelic_gt_list([1, 1])
@@ -53,6 +72,45 @@ def test_genotyping_empty_readset():
     _ = GenotypeDPTable(numeric_sample_ids, rs, recombcost, pedigree)
 
 
+def test_genotyping_invalid_precision():
+    rs = ReadSet()
+    numeric_sample_ids = NumericSampleIds()
+    pedigree = Pedigree(numeric_sample_ids)
+    pedigree.add_individual("individual0", [], [])
+    with pytest.raises(ValueError):
+        GenotypeDPTable(numeric_sample_ids, rs, [], pedigree, precision="float")
+
+
+def test_compute_genotypes_batch():
+    readsets = [
+        string_to_readset(
+            """
+            11 1
+            1011
+             0 11
+            """
+        ),
+        string_to_readset(
+            """
+            0000
+            0010
+            """
+        ),
+        string_to_readset(
+            """
+            1  0
+            1 00
+            """
+        ),
+        ReadSet(),
+    ]
+    positions = readsets[0].get_positions()
+    expected = [compute_genotypes(readset, positions) for readset in readsets]
+    for threads in [1, 3]:
+        assert compute_genotypes_batch(readsets, positions, threads) == expected
+    assert compute_genotypes_batch([], positions) == []
+
+
 def check_genotyping_single_individual(
     reads, weights=None, expected=None, genotypes=None, scaling=None, genotype_priors=None
 ):
@@ -1,3 +1,4 @@
+from whatshap.core import ReadMerger as CoreReadMerger
 from whatshap.merge import ReadMerger
 from whatshap.testhelpers import string_to_readset
 
@@ -64,3 +65,25 @@ def test_read_merging2():
     # error rates and thresholds so high that no merging occurs
 
     assert_variants(merged_reads, reads)
+
+
+def test_core_read_merger():
+    reads = string_to_readset(
+        """
+      000000
+      000000
+      111111
+    """
+    )
+    merger = CoreReadMerger(0.15, 0.25, 100000, 1000)
+    assert merger.get_thresholds() == (5, 3)
+    merged_reads, stats = merger.merge(reads)
+    assert stats == {
+        "blue_edges": 1,
+        "blue_components": 2,
+        "notblue_edges": 0,
+        "notblue_components": 3,
+    }
+    assert [read.name for read in merged_reads] == ["read0", "read2"]
+    assert list(merged_reads[0]) == [(pos, 0, 2) for pos in range(10, 70, 10)]
+    assert list(merged_reads[1]) == list(reads[2])
@@ -3,6 +3,8 @@ Test genotyping of pedigrees
 """
 import math
 
+import pytest
+
 from whatshap.core import (
     GenotypeDPTable,
     ReadSet,
@@ -30,6 +32,12 @@ def genotype_pedigree(
 ):
     rs = string_to_readset_pedigree(s=reads, w=weights, scaling_quality=scaling)
     dp_forward_backward = GenotypeDPTable(numeric_sample_ids, rs, recombcost, pedigree, positions)
+    dp_forward_backward_double = GenotypeDPTable(
+        numeric_sample_ids, rs, recombcost, pedigree, positions, precision="double"
+    )
+    dp_forward_backward_concurrent = GenotypeDPTable(
+        numeric_sample_ids, rs, recombcost, pedigree, positions, concurrent=True
+    )
 
     # for each position compare the likeliest genotype to the expected ones
     print("expected genotypes: ", expected_genotypes)
@@ -40,6 +48,24 @@ def genotype_pedigree(
                 "individual" + str(individual), pos
             )
 
+            # likelihoods computed in double precision must agree up to rounding errors
+            likelihoods_double = dp_forward_backward_double.get_genotype_likelihoods(
+                "individual" + str(individual), pos
+            )
+            for genotype in likelihoods.genotypes():
+                assert likelihoods_double[genotype] == pytest.approx(
+                    likelihoods[genotype], rel=1e-9, abs=1e-12
+                )
+
+            # so must likelihoods computed by the concurrent forward and backward pass
+            likelihoods_concurrent = dp_forward_backward_concurrent.get_genotype_likelihoods(
+                "individual" + str(individual), pos
+            )
+            for genotype in likelihoods.genotypes():
+                assert likelihoods_concurrent[genotype] == pytest.approx(
+                    likelihoods[genotype], rel=1e-9, abs=1e-12
+                )
+
             # if expected likelihoods given, compare
             if expected is not None:
                 print(
@@ -856,3 +882,88 @@ def test_genotyping_trio14():
     genotype_pedigree(
         numeric_sample_ids, reads, recombcost, pedigree, expected_genotypes, scaling=1000
     )
+
+
+def test_genotyping_trio_checkpoint_policies():
+    reads = """
+      A 111111111
+      A 0101 0 10
+      A  10101 01
+      B 001 01 11
+      B 110110 01
+      B  01110 0
+      C 0011 0 11
+      C 010 01  1
+      C  10011 01
+    """
+    results = []
+    for checkpoint_policy in ["sqrt", "all", "log", "auto"]:
+        numeric_sample_ids = NumericSampleIds()
+        pedigree = Pedigree(numeric_sample_ids)
+        for individual in ["individual0", "individual1", "individual2"]:
+            pedigree.add_individual(
+                individual,
+                canonic_index_list_to_biallelic_gt_list([1] * 9),
+                [PhredGenotypeLikelihoods([1 / 3.0, 1 / 3.0, 1 / 3.0])] * 9,
+            )
+        pedigree.add_relationship("individual0", "individual1", "individual2")
+        rs = string_to_readset_pedigree(reads)
+        dp_forward_backward = GenotypeDPTable(
+            numeric_sample_ids, rs, [10] * 9, pedigree, checkpoint_policy=checkpoint_policy
+        )
+        if checkpoint_policy == "auto":
+            # no memory limit given
+            assert dp_forward_backward.get_checkpoint_policy() == "log"
+        else:
+            assert dp_forward_backward.get_checkpoint_policy() == checkpoint_policy
+        likelihoods = []
+        for individual in range(3):
+            for pos in range(9):
+                gl = dp_forward_backward.get_genotype_likelihoods(
+                    "individual" + str(individual), pos
+                )
+                likelihoods.append([gl[genotype] for genotype in gl.genotypes()])
+        results.append(likelihoods)
+    # recomputed columns are identical to stored ones
+    assert results[0] == results[1] == results[2] == results[3]
+
+
+def test_genotyping_trio_concurrent_checkpoints():
+    reads = """
+      B 001 01 11
+      B 110110 01
+      B  01110 0
+      C 0011 0 11
+      C 010 01  1
+      C  10011 01
+    """
+    results = []
+    for checkpoint_policy in ["sqrt", "all", "log"]:
+        numeric_sample_ids = NumericSampleIds()
+        pedigree = Pedigree(numeric_sample_ids)
+        for individual in ["individual0", "individual1", "individual2"]:
+            pedigree.add_individual(
+                individual,
+                canonic_index_list_to_biallelic_gt_list([1] * 9),
+                [PhredGenotypeLikelihoods([1 / 3.0, 1 / 3.0, 1 / 3.0])] * 9,
+            )
+        pedigree.add_relationship("individual0", "individual1", "individual2")
+        rs = string_to_readset_pedigree(reads)
+        dp_forward_backward = GenotypeDPTable(
+            numeric_sample_ids,
+            rs,
+            [10] * 9,
+            pedigree,
+            checkpoint_policy=checkpoint_policy,
+            concurrent=True,
+        )
+        likelihoods = []
+        for individual in range(3):
+            for pos in range(9):
+                gl = dp_forward_backward.get_genotype_likelihoods(
+                    "individual" + str(individual), pos
+                )
+                likelihoods.append([gl[genotype] for genotype in gl.genotypes()])
+        results.append(likelihoods)
+    # recomputed forward and backward columns are identical to stored ones
+    assert results[0] == results[1] == results[2]
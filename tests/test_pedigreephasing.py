@@ -1,6 +1,7 @@
 """
 Test phasing of pedigrees (PedMEC algorithm)
 """
+import random
 from collections import defaultdict
 from pytest import raises
 from whatshap.core import (
@@ -9,6 +10,10 @@ from whatshap.core import (
     Pedigree,
     NumericSampleIds,
     PhredGenotypeLikelihoods,
+    get_column_arena_stats,
+    clear_column_arenas,
+    get_pedigree_topology_cache_size,
+    clear_pedigree_topology_cache,
 )
 from whatshap.pedigree import centimorgen_to_phred
 from whatshap.testhelpers import string_to_readset_pedigree, canonic_index_list_to_biallelic_gt_list
@@ -477,3 +482,208 @@ def test_phase_trio_genotype_likelihoods():
     all_expected_haplotypes = [("111", "010"), ("001", "110"), ("001", "010")]
     assert_haplotypes(superreads_list, all_expected_haplotypes, 3)
     assert_trio_allele_order(superreads_list, transmission_vector, 3)
+
+
+def test_phase_trio_threads():
+    # 14 reads covering all positions make the DP columns large enough to be split among threads
+    rng = random.Random(42)
+    reads = "\n".join(
+        "ABC"[i % 3] + " " + "".join(rng.choice("01") for _ in range(5)) for i in range(14)
+    )
+    results = []
+    for threads in [1, 4]:
+        pedigree = Pedigree(NumericSampleIds())
+        for individual in ["individual0", "individual1", "individual2"]:
+            pedigree.add_individual(individual, canonic_index_list_to_biallelic_gt_list([1] * 5))
+        pedigree.add_relationship("individual0", "individual1", "individual2")
+        rs = string_to_readset_pedigree(reads)
+        dp_table = PedigreeDPTable(rs, [10] * 5, pedigree, threads=threads)
+        superreads_list, transmission_vector = dp_table.get_super_reads()
+        haplotypes = [
+            ["".join(str(v.allele) for v in sr) for sr in superreads]
+            for superreads in superreads_list
+        ]
+        results.append(
+            (
+                dp_table.get_optimal_cost(),
+                transmission_vector,
+                haplotypes,
+                dp_table.get_optimal_partitioning(),
+            )
+        )
+    assert results[0] == results[1]
+
+
+def test_phase_trio_checkpoint_policies():
+    reads = """
+      A 111111
+      A 0101 0
+      A  10101
+      B 001 01
+      B 110110
+      B  01110
+      C 0011 0
+      C 010 01
+      C  10011
+    """
+    recombcost = [10] * 6
+    results = []
+    peak_memory = dict()
+    for checkpoint_policy in ["sqrt", "all", "log"]:
+        pedigree = Pedigree(NumericSampleIds())
+        pedigree.add_individual("individual0", canonic_index_list_to_biallelic_gt_list([1] * 6))
+        pedigree.add_individual("individual1", canonic_index_list_to_biallelic_gt_list([1] * 6))
+        pedigree.add_individual("individual2", canonic_index_list_to_biallelic_gt_list([1] * 6))
+        pedigree.add_relationship("individual0", "individual1", "individual2")
+        rs = string_to_readset_pedigree(reads)
+        dp_table = PedigreeDPTable(rs, recombcost, pedigree, checkpoint_policy=checkpoint_policy)
+        assert dp_table.get_checkpoint_policy() == checkpoint_policy
+        superreads_list, transmission_vector = dp_table.get_super_reads()
+        haplotypes = [
+            ["".join(str(v.allele) for v in sr) for sr in superreads]
+            for superreads in superreads_list
+        ]
+        results.append((dp_table.get_optimal_cost(), transmission_vector, haplotypes))
+        peak_memory[checkpoint_policy] = dp_table.get_peak_memory()
+    assert results[0] == results[1] == results[2]
+    assert 0 < peak_memory["log"] <= peak_memory["all"]
+    assert 0 < peak_memory["sqrt"] <= peak_memory["all"]
+
+
+def test_phase_checkpoint_policy_auto():
+    reads = """
+      A 1111
+      A 0101
+      A 1010
+    """
+    pedigree = Pedigree(NumericSampleIds())
+    pedigree.add_individual("individual0", canonic_index_list_to_biallelic_gt_list([1] * 4))
+    rs = string_to_readset_pedigree(reads)
+    dp_table = PedigreeDPTable(rs, [10] * 4, pedigree, checkpoint_policy="auto", memory_limit=10**9)
+    assert dp_table.get_checkpoint_policy() == "all"
+    rs = string_to_readset_pedigree(reads)
+    dp_table = PedigreeDPTable(rs, [10] * 4, pedigree, checkpoint_policy="auto", memory_limit=0)
+    assert dp_table.get_checkpoint_policy() == "log"
+    with raises(ValueError):
+        PedigreeDPTable(rs, [10] * 4, pedigree, checkpoint_policy="unknown")
+
+
+def test_column_arena_reuse():
+    reads = """
+      A 1111
+      A 0101
+      A 1010
+    """
+    pedigree = Pedigree(NumericSampleIds())
+    pedigree.add_individual("individual0", canonic_index_list_to_biallelic_gt_list([1] * 4))
+    clear_column_arenas()
+    assert get_column_arena_stats()["retained_bytes"] == 0
+    before = get_column_arena_stats()
+    costs = []
+    for _ in range(2):
+        rs = string_to_readset_pedigree(reads)
+        dp_table = PedigreeDPTable(rs, [10] * 4, pedigree)
+        costs.append(dp_table.get_optimal_cost())
+        del dp_table
+    after = get_column_arena_stats()
+    assert costs[0] == costs[1]
+    assert after["acquired"] > before["acquired"]
+    # the second table reuses the columns released by the first one
+    assert after["reused"] > before["reused"]
+    assert after["retained_bytes"] > 0
+
+
+def test_pedigree_topology_cache():
+    reads = """
+      A 111
+      A 010
+      B 001
+      B 110
+      C 001
+      C 010
+    """
+
+    def phase_trio(genotypes):
+        pedigree = Pedigree(NumericSampleIds())
+        for individual in ["individual0", "individual1", "individual2"]:
+            pedigree.add_individual(individual, canonic_index_list_to_biallelic_gt_list(genotypes))
+        pedigree.add_relationship("individual0", "individual1", "individual2")
+        dp_table = PedigreeDPTable(string_to_readset_pedigree(reads), [10] * 3, pedigree)
+        superreads_list, transmission_vector = dp_table.get_super_reads()
+        return dp_table.get_optimal_cost(), transmission_vector
+
+    clear_pedigree_topology_cache()
+    assert get_pedigree_topology_cache_size() == 0
+    first = phase_trio([1, 1, 1])
+    # trios with other genotypes share the same topology
+    phase_trio([1, 0, 1])
+    assert get_pedigree_topology_cache_size() == 1
+    assert phase_trio([1, 1, 1]) == first
+    pedigree = Pedigree(NumericSampleIds())
+    pedigree.add_individual("individual0", canonic_index_list_to_biallelic_gt_list([1] * 3))
+    PedigreeDPTable(string_to_readset_pedigree("A 111\nA 010"), [10] * 3, pedigree)
+    assert get_pedigree_topology_cache_size() == 2
+    clear_pedigree_topology_cache()
+    assert phase_trio([1, 1, 1]) == first
+
+
+def test_phased_columns():
+    reads = """
+      A 111111
+      A 0101 0
+      B 001 01
+      B 110110
+      C 0011 0
+      C  10011
+    """
+    pedigree = Pedigree(NumericSampleIds())
+    for individual in ["individual0", "individual1", "individual2"]:
+        pedigree.add_individual(individual, canonic_index_list_to_biallelic_gt_list([1] * 6))
+    pedigree.add_relationship("individual0", "individual1", "individual2")
+    rs = string_to_readset_pedigree(reads)
+    dp_table = PedigreeDPTable(rs, [10] * 6, pedigree)
+    superreads_list, transmission_vector = dp_table.get_super_reads()
+    columns = list(dp_table.phased_columns())
+    assert len(columns) == 6
+    assert [transmission_value for _, transmission_value, _ in columns] == transmission_vector
+    for i, (position, _, alleles) in enumerate(columns):
+        assert len(alleles) == 3
+        for (allele0, allele1, quality), superreads in zip(alleles, superreads_list):
+            assert superreads[0][i] == (position, allele0, quality)
+            assert superreads[1][i] == (position, allele1, quality)
+    assert dp_table.get_phased_column(2) == columns[2]
+    with raises(IndexError):
+        dp_table.get_phased_column(6)
+
+
+def test_phase_trio_incremental():
+    rng = random.Random(7)
+    reads = [
+        "ABC"[i % 3] + " " * (start + 1) + "".join(rng.choice("01") for _ in range(6))
+        for i, start in enumerate(range(0, 34, 2))
+    ]
+    pedigree = Pedigree(NumericSampleIds())
+    for individual in ["individual0", "individual1", "individual2"]:
+        pedigree.add_individual(individual, canonic_index_list_to_biallelic_gt_list([1] * 40))
+    pedigree.add_relationship("individual0", "individual1", "individual2")
+
+    def result(dp_table):
+        superreads_list, transmission_vector = dp_table.get_super_reads()
+        haplotypes = [
+            ["".join(str(v.allele) for v in sr) for sr in superreads]
+            for superreads in superreads_list
+        ]
+        return dp_table.get_optimal_cost(), transmission_vector, haplotypes
+
+    rs = string_to_readset_pedigree("\n".join(reads))
+    previous = PedigreeDPTable(rs, [10] * 40, pedigree, incremental=True)
+    result(previous)
+
+    # add a read covering the last positions
+    reads.append("B" + " " * 35 + "011010")
+    rs = string_to_readset_pedigree("\n".join(reads))
+    expected = PedigreeDPTable(rs, [10] * 40, pedigree)
+    rs = string_to_readset_pedigree("\n".join(reads))
+    dp_table = PedigreeDPTable(rs, [10] * 40, pedigree, incremental=True, previous=previous)
+    assert result(dp_table) == result(expected)
+    assert 0 < dp_table.get_computed_column_count() < expected.get_computed_column_count()
@@ -206,6 +206,70 @@ def test_phase4a(algorithm):
     check_phasing_single_individual(reads, algorithm)
 
 
+def test_hapchat_in_threads():
+    from concurrent.futures import ThreadPoolExecutor
+
+    all_reads = [
+        """
+      1  11010
+      00 00101
+      001 01010
+        """,
+        """
+      1  11010
+      00 00101
+      001 01110
+       1    111
+        """,
+        """
+     10
+     010
+     010
+        """,
+    ] * 4
+
+    def phase(reads):
+        dp_table = HapChatCore(string_to_readset(reads))
+        superreads = dp_table.get_super_reads()[0][0]
+        return dp_table.get_optimal_cost(), [str(read) for read in superreads]
+
+    expected = [phase(reads) for reads in all_reads]
+    with ThreadPoolExecutor(max_workers=4) as executor:
+        assert list(executor.map(phase, all_reads)) == expected
+
+
+def test_pedigree_dp_table_in_threads():
+    from concurrent.futures import ThreadPoolExecutor
+
+    all_reads = [
+        """
+      1  11010
+      00 00101
+      001 01010
+        """,
+        """
+      1  11010
+      00 00101
+      001 01110
+       1    111
+        """,
+    ] * 4
+
+    def phase(reads):
+        readset = string_to_readset(reads)
+        positions = readset.get_positions()
+        pedigree = Pedigree(NumericSampleIds())
+        genotypes = canonic_index_list_to_biallelic_gt_list([1] * len(positions))
+        pedigree.add_individual("individual0", genotypes, [None] * len(positions))
+        dp_table = PedigreeDPTable(readset, [10] * len(positions), pedigree, positions=positions)
+        superreads = dp_table.get_super_reads()[0][0]
+        return dp_table.get_optimal_cost(), [str(read) for read in superreads]
+
+    expected = [phase(reads) for reads in all_reads]
+    with ThreadPoolExecutor(max_workers=4) as executor:
+        assert list(executor.map(phase, all_reads)) == expected
+
+
 # note: these final two tests do not apply to hapchat because their
 # (brute force solutions) are weighted phasings -- hapchat does not do
 # weights (for the time being)
@@ -236,3 +300,42 @@ def test_weighted_phasing1():
        2    111
     """
     check_phasing_single_individual(reads, "whatshap", weights)
+
+
+def test_phase_components():
+    # three groups of reads, between which no read continues, are phased independently
+    reads = """
+      1  11010
+      00 00101
+      001 01110
+                1011
+                 0100
+                 01 1
+                      110
+                      001
+                       10
+    """
+    positions = string_to_readset(reads).get_positions()
+    pedigree = Pedigree(NumericSampleIds())
+    pedigree.add_individual(
+        "individual0",
+        [canonic_index_to_biallelic_gt(1) for _ in positions],
+        [PhredGenotypeLikelihoods([0, 0, 0])] * len(positions),
+    )
+
+    def phase(**kwargs):
+        dp_table = PedigreeDPTable(
+            string_to_readset(reads), [1] * len(positions), pedigree, True, **kwargs
+        )
+        superreads, _ = dp_table.get_super_reads()
+        return (
+            dp_table.get_optimal_cost(),
+            [str(read) for read in superreads[0]],
+            dp_table.get_optimal_partitioning(),
+        )
+
+    # incremental tables are never split into components
+    expected = phase(incremental=True)
+    for policy in ["all", "sqrt", "log"]:
+        for threads in [1, 3]:
+            assert phase(checkpoint_policy=policy, threads=threads) == expected
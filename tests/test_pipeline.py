@@ -0,0 +1,93 @@
+import time
+
+from pytest import raises, mark
+
+from whatshap.pipeline import BackgroundWorker, prefetch
+
+
+@mark.parametrize("depth", [0, 1, 3])
+def test_prefetch(depth):
+    assert list(prefetch(range(10), depth)) == list(range(10))
+    assert list(prefetch([], depth)) == []
+
+
+@mark.parametrize("depth", [0, 2])
+def test_prefetch_exception(depth):
+    def items():
+        yield 1
+        yield 2
+        raise ValueError("failed")
+
+    consumed = []
+    with raises(ValueError):
+        for item in prefetch(items(), depth):
+            consumed.append(item)
+    assert consumed == [1, 2]
+
+
+def test_prefetch_stops_early():
+    produced = []
+
+    def items():
+        for i in range(100):
+            produced.append(i)
+            yield i
+
+    for item in prefetch(items(), 2):
+        if item == 3:
+            break
+    # the queue holds at most two items, and the producer may have been working on one more
+    assert len(produced) <= 7
+
+
+def test_prefetch_runs_ahead():
+    produced = []
+
+    def items():
+        for i in range(3):
+            produced.append(i)
+            yield i
+
+    iterator = prefetch(items(), 3)
+    assert next(iterator) == 0
+    for _ in range(100):
+        if len(produced) == 3:
+            break
+        time.sleep(0.01)
+    assert produced == [0, 1, 2]
+    assert list(iterator) == [1, 2]
+
+
+@mark.parametrize("depth", [0, 1, 4])
+def test_background_worker(depth):
+    results = []
+    with BackgroundWorker(depth) as worker:
+        for i in range(20):
+            worker.submit(results.append, i)
+    assert results == list(range(20))
+
+
+@mark.parametrize("depth", [0, 2])
+def test_background_worker_exception(depth):
+    results = []
+
+    def append(i):
+        if i == 2:
+            raise KeyError(i)
+        results.append(i)
+
+    with raises(KeyError):
+        with BackgroundWorker(depth) as worker:
+            for i in range(10):
+                worker.submit(append, i)
+    assert results == [0, 1]
+
+
+def test_background_worker_skips_calls_after_error_in_caller():
+    results = []
+    with raises(RuntimeError):
+        with BackgroundWorker(5) as worker:
+            worker.submit(time.sleep, 0.2)
+            worker.submit(results.append, 1)
+            raise RuntimeError()
+    assert results == []
@@ -0,0 +1,79 @@
+from pytest import raises
+
+from whatshap.core import Read, ReadSet, assign_read_haplotypes
+
+
+def make_readset(reads):
+    """reads is a list of (name, reference start, BX tag, [(position, allele), ...])"""
+    readset = ReadSet()
+    for name, reference_start, bx_tag, variants in reads:
+        read = Read(name, 60, 0, 0, reference_start, bx_tag)
+        for position, allele in variants:
+            read.add_variant(position, allele, 10)
+        readset.add(read)
+    return readset
+
+
+POSITIONS = [100, 200, 300, 400, 500]
+PHASESETS = [1, 1, 1, 1, 7]
+ALLELES = [0, 1, 0, 0, 0]
+
+READS = [
+    ("a", 100, "X", [(100, 0), (200, 1)]),
+    # same BX tag and close to read a
+    ("b", 150, "X", [(300, 0)]),
+    # same BX tag, but far away
+    ("c", 90000, "X", [(400, 1)]),
+    ("d", 120, None, [(200, 0)]),
+    ("e", 130, "Y", [(500, 1)]),
+]
+
+
+def test_assign_read_haplotypes():
+    read_haplotypes, clouds, n_multiple = assign_read_haplotypes(
+        make_readset(READS), POSITIONS, PHASESETS, ALLELES, True, 50000
+    )
+    assert sorted(read_haplotypes) == [
+        ("a", 0, 30, 1),
+        ("b", 0, 30, 1),
+        ("c", 1, 10, 1),
+        ("d", 1, 10, 1),
+        ("e", 1, 10, 7),
+    ]
+    assert sorted(clouds) == [
+        ("", 120, 1, 1),
+        ("X", 100, 0, 1),
+        ("X", 90000, 1, 1),
+        ("Y", 130, 1, 7),
+    ]
+    assert n_multiple == 0
+
+
+def test_assign_read_haplotypes_without_bx_tags():
+    read_haplotypes, clouds, n_multiple = assign_read_haplotypes(
+        make_readset(READS), POSITIONS, PHASESETS, ALLELES, False, 50000
+    )
+    assert sorted(read_haplotypes)[:2] == [("a", 0, 20, 1), ("b", 0, 10, 1)]
+    assert len(clouds) == 5
+
+
+def test_assign_read_haplotypes_multiple_phase_sets():
+    reads = [("a", 100, "X", [(100, 0), (500, 1)]), ("b", 100, "X", [(200, 1)])]
+    read_haplotypes, clouds, n_multiple = assign_read_haplotypes(
+        make_readset(reads), POSITIONS, PHASESETS, ALLELES, True, 50000
+    )
+    # phase set 1 has the larger absolute cost
+    assert sorted(read_haplotypes) == [("a", 0, 20, 1), ("b", 0, 20, 1)]
+    assert n_multiple == 1
+
+
+def test_assign_read_haplotypes_unphased_variant():
+    with raises(ValueError):
+        assign_read_haplotypes(
+            make_readset([("a", 100, None, [(150, 0), (200, 1)])]),
+            POSITIONS,
+            PHASESETS,
+            ALLELES,
+            True,
+            50000,
+        )
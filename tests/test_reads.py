@@ -1,6 +1,8 @@
 """
 Test Read and ReadSet classes
 """
+import pickle
+
 from pytest import raises
 from whatshap.core import Read, ReadSet, Variant
 
@@ -139,3 +141,102 @@ def test_non_existing_read_name2():
 
 
 # TODO: Test subset method
+
+
+def test_readset_subset_keeps_names_and_bx_tags():
+    rs = ReadSet()
+    for i, tag in enumerate(["AAAC", "AAAC", "", "AAAG"]):
+        r = Read("Read {}".format(i), 10 + i, 0, 0, -1, tag)
+        r.add_variant(100 + i, 0, 10)
+        r.add_variant(200, 1, 20)
+        rs.add(r)
+    subset = rs.subset([0, 2, 3])
+    del rs
+    assert [r.name for r in subset] == ["Read 0", "Read 2", "Read 3"]
+    assert [r.BX_tag for r in subset] == ["AAAC", "", "AAAG"]
+    assert [r.has_BX_tag() for r in subset] == [True, False, True]
+    assert subset[(0, "Read 3")].mapqs == (13,)
+
+
+def test_readset_subset_is_independent_copy():
+    rs = ReadSet()
+    for name in ["Read A", "Read B"]:
+        r = Read(name, 10)
+        r.add_variant(100, 0, 10)
+        r.add_variant(200, 1, 20)
+        rs.add(r)
+    subset = rs.subset([1])
+    subset[0][0] = Variant(position=150, allele=1, quality=30)
+    subset[0].add_variant(300, 0, 5)
+    assert list(rs[1]) == [Variant(100, 0, 10), Variant(200, 1, 20)]
+    assert list(subset[0]) == [Variant(150, 1, 30), Variant(200, 1, 20), Variant(300, 0, 5)]
+    rs[1].add_variant(50, 1, 7)
+    assert len(subset[0]) == 3
+
+
+def test_readset_sort_reads_without_variants():
+    rs = ReadSet()
+    for name, position in [("A", 200), ("B", None), ("C", 100), ("D", 100), ("E", None)]:
+        r = Read(name, 10)
+        if position is not None:
+            r.add_variant(position, 0, 10)
+        rs.add(r)
+    rs.sort()
+    names = [read.name for read in rs]
+    assert sorted(names[:2]) == ["B", "E"]
+    assert sorted(names[2:4]) == ["C", "D"]
+    assert names[4] == "A"
+    rs.sort()
+    assert [read.name for read in rs] == names
+    assert all(rs[(0, name)].name == name for name in names)
+
+
+def test_readset_pickle():
+    rs = ReadSet()
+    r = Read("Read A", 56, 1, 2, 1000, "AAACGT")
+    r.add_mapq(20)
+    r.add_variant(100, 1, 37)
+    r.add_variant(101, 0, 18)
+    rs.add(r)
+    r = Read("Read B", 0, 3)
+    r.add_variant(99, 2, 23)
+    rs.add(r)
+    rs.add(Read("Read C", 7))
+    for copy in [pickle.loads(pickle.dumps(rs)), ReadSet.from_bytes(rs.to_bytes())]:
+        assert len(copy) == 3
+        for read, copied in zip(rs, copy):
+            assert copied.name == read.name
+            assert copied.mapqs == read.mapqs
+            assert copied.source_id == read.source_id
+            assert copied.sample_id == read.sample_id
+            assert copied.reference_start == read.reference_start
+            assert copied.BX_tag == read.BX_tag
+            assert list(copied) == list(read)
+        assert copy[(1, "Read A")].mapqs == (56, 20)
+
+
+def test_readset_load(tmp_path):
+    rs = ReadSet()
+    r = Read("Read A", 56, 1, 2, 1000, "AAACGT")
+    r.add_variant(100, 1, 37)
+    rs.add(r)
+    rs.add(Read("Read B", 0, 3, 4))
+    path = tmp_path / "reads.readset"
+    path.write_bytes(rs.to_bytes())
+    loaded = ReadSet.load(str(path))
+    assert [(read.name, read.sample_id) for read in loaded] == [("Read A", 2), ("Read B", 4)]
+    assert list(loaded[0]) == list(rs[0])
+    loaded = ReadSet.load(str(path), 7)
+    assert [read.sample_id for read in loaded] == [7, 7]
+    with raises(RuntimeError):
+        ReadSet.load(str(tmp_path / "missing.readset"))
+
+
+def test_readset_from_invalid_bytes():
+    data = ReadSet().to_bytes()
+    with raises(RuntimeError):
+        ReadSet.from_bytes(b"foo")
+    with raises(RuntimeError):
+        ReadSet.from_bytes(data + b"x")
+    with raises(RuntimeError):
+        ReadSet.from_bytes(data[:-1])
@@ -1,8 +1,21 @@
 """
 Test ReadScoring
 """
+import pickle
 
-from whatshap.core import Read, ReadSet, scoreReadsetGlobal
+from pytest import raises
+
+from whatshap.core import (
+    Read,
+    ReadSet,
+    ReadScoreIndex,
+    TriangleSparseMatrix,
+    scoreReadsetGlobal,
+    scoreReadsetLocal,
+    scoreIndexGlobal,
+    scoreIndexLocal,
+    compute_linkage_based_block_starts,
+)
 
 
 def test_readscoring_toy():
@@ -72,3 +85,122 @@ def test_readscoring_toy():
     assert sim.get(4, 5) < 0.0
     assert sim.get(4, 6) > 0.0
     assert sim.get(5, 6) < 0.0
+
+
+def test_triangle_sparse_matrix():
+    m = TriangleSparseMatrix()
+    for i in range(1, 200):
+        for j in range(0, i, 3):
+            m.set(i, j, i + j / 1000)
+    m.set(5, 2, -1.5)
+    m.set(2, 5, 2.5)
+    assert len(m) == sum(len(range(0, i, 3)) for i in range(1, 200)) + 1
+    assert m.get(5, 2) == 2.5
+    assert m.get(4, 1) == 0.0
+    assert m.get(3, 3) == 0.0
+    entries = list(m)
+    assert entries == sorted(entries)
+    assert all(m.get(i, j) != 0.0 for i, j in entries)
+    # inserting after iterating (which sorts the entries) must still work
+    m.set(1000, 999, 3.0)
+    assert m.get(999, 1000) == 3.0
+    assert len(m) == len(entries) + 1
+
+
+def test_readscoring_threads():
+    # enough reads such that the pairs are counted on several threads
+    readset = ReadSet()
+    for i in range(400):
+        read = Read("read{}".format(i), 15)
+        for pos in range(i, i + 30, 2):
+            read.add_variant(10 * pos, (pos * 7 + i * (i % 3)) % 3, 1)
+        readset.add(read)
+    sim1 = scoreReadsetLocal(readset, 3, 3)
+    sim4 = scoreReadsetLocal(readset, 3, 3, threads=4)
+    assert len(sim1) > 0
+    assert list(sim1) == list(sim4)
+    for i, j in sim1:
+        assert sim1.get(i, j) == sim4.get(i, j)
+
+
+def create_overlapping_readset():
+    readset = ReadSet()
+    for i in range(400):
+        read = Read("read{}".format(i), 15)
+        for pos in range(i, i + 30, 2):
+            read.add_variant(10 * pos, (pos * 7 + i * (i % 3)) % 3, 1)
+        readset.add(read)
+    return readset
+
+
+def assert_same_scores(sim1, sim2):
+    assert list(sim1) == list(sim2)
+    for i, j in sim1:
+        assert sim1.get(i, j) == sim2.get(i, j)
+
+
+def test_read_score_index(tmp_path):
+    readset = create_overlapping_readset()
+    index = ReadScoreIndex(readset, 3, threads=4)
+    assert len(index) == 400
+    assert index.min_overlap() == 3
+    assert index.num_pairs() > 0
+    assert index.get_positions() == readset.get_positions()
+    sim = scoreIndexLocal(index, 3, 3)
+    assert len(sim) > 0
+    assert_same_scores(sim, scoreReadsetLocal(readset, 3, 3))
+    # the index can be reused for other ploidies and larger minimum overlaps
+    assert_same_scores(scoreIndexLocal(index, 4, 4), scoreReadsetLocal(readset, 4, 4))
+    assert_same_scores(scoreIndexGlobal(index, 3), scoreReadsetGlobal(readset, 3, 2))
+    with raises(ValueError):
+        scoreIndexLocal(index, 2, 3)
+
+    # stored indices give the same scores
+    path = tmp_path / "index.bin"
+    path.write_bytes(index.to_bytes())
+    for copy in [
+        ReadScoreIndex.from_bytes(index.to_bytes()),
+        ReadScoreIndex.load(str(path)),
+        pickle.loads(pickle.dumps(index)),
+    ]:
+        assert copy.to_bytes() == index.to_bytes()
+        assert_same_scores(scoreIndexLocal(copy, 3, 3), sim)
+    with raises(RuntimeError):
+        ReadScoreIndex.from_bytes(index.to_bytes()[:-1])
+
+
+def test_read_score_index_restrict():
+    readset = create_overlapping_readset()
+    positions = readset.get_positions()
+    index = ReadScoreIndex(readset, 2)
+    block_starts = [0, 50, 51, 200, len(positions)]
+    for first, end in zip(block_starts, block_starts[1:]):
+        # the block readset as split_readset in polyphase creates it
+        block_positions = set(positions[first:end])
+        block = ReadSet()
+        for read in readset:
+            variants = [variant for variant in read if variant.position in block_positions]
+            if variants:
+                block_read = Read(read.name, 15)
+                for variant in variants:
+                    block_read.add_variant(variant.position, variant.allele, 1)
+                block.add(block_read)
+        block_index = index.restrict(first, end)
+        assert len(block_index) == len(block)
+        assert block_index.get_positions() == positions[first:end]
+        assert_same_scores(scoreIndexLocal(block_index, 2, 3), scoreReadsetLocal(block, 2, 3))
+
+
+def test_linkage_based_block_starts():
+    readset = ReadSet()
+    for i, positions in enumerate([[10, 20, 30], [30, 40], [50], [60, 70], [30, 50]]):
+        read = Read("read{}".format(i), 15)
+        for pos in positions:
+            read.add_variant(pos, 0, 1)
+        readset.add(read)
+    # 10-40 and 50 are connected by the last read, although it does not cover 40
+    assert compute_linkage_based_block_starts(readset, 2) == [0, 5]
+    assert compute_linkage_based_block_starts(readset, 4, single_linkage=True) == [0, 5]
+    # with ploidy 4, at least 8 reads are needed to connect two variants
+    assert compute_linkage_based_block_starts(readset, 4) == [0, 1, 2, 3, 4, 5, 6]
+    assert compute_linkage_based_block_starts(ReadSet(), 4) == []
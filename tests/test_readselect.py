@@ -1,4 +1,4 @@
-from whatshap.core import readselection
+from whatshap.core import readselection, choose_coverage_limits
 from whatshap.testhelpers import string_to_readset
 
 
@@ -82,6 +82,45 @@ def test_components_of_readselection():
 #      assert len(set(new_components.values())) == 1
 
 
+def test_selection_ties_broken_by_read_order():
+    # Identical reads: the first ones are selected
+    reads = string_to_readset("\n".join(["111"] * 10))
+    for max_cov in range(1, 5):
+        selected_reads = readselection(
+            reads, max_cov=max_cov, preferred_source_ids=None, bridging=False
+        )
+        assert selected_reads == set(range(max_cov)), str(selected_reads)
+
+    # Reads 1 and 2 tie for covering the last variant after read 0 has been selected
+    reads = string_to_readset(
+        """
+      11
+       11
+        11
+      11
+       11
+        11
+    """
+    )
+    for bridging in [False, True]:
+        selected_reads = readselection(
+            reads, max_cov=1, preferred_source_ids=None, bridging=bridging
+        )
+        assert selected_reads == set([0, 2]), str(selected_reads)
+        selected_reads = readselection(
+            reads, max_cov=2, preferred_source_ids=None, bridging=bridging
+        )
+        assert selected_reads == set([0, 1, 2]), str(selected_reads)
+
+    # Two alternating groups of 20 equal reads each, more than a hash set keeps in index order
+    reads = string_to_readset("\n".join(["1 1", "  11"] * 20))
+    for max_cov in range(1, 4):
+        selected_reads = readselection(
+            reads, max_cov=max_cov, preferred_source_ids=None, bridging=True
+        )
+        assert selected_reads == set(range(max_cov)), str(selected_reads)
+
+
 def test_selection_with_preferred_sources():
     readset = string_to_readset(
         """
@@ -129,3 +168,48 @@ def test_selection_with_preferred_sources():
 # selected_reads, skipped_reads = readselection(reads, max_cov = 2, bridging= True)
 
 # fmt: on
+
+
+def test_selection_with_coverage_limits():
+    reads = string_to_readset(
+        """
+      11
+      11
+      11
+        11
+        11
+        11
+    """
+    )
+    positions = reads.get_positions()
+    coverage_limits = [(positions[0], 1), (positions[2], 3)]
+    selected_reads = readselection(
+        reads, max_cov=2, preferred_source_ids=None, coverage_limits=coverage_limits
+    )
+    assert len(selected_reads & {0, 1, 2}) == 1
+    assert {3, 4, 5} <= selected_reads
+
+
+def test_choose_coverage_limits():
+    reads = string_to_readset(
+        """
+      11
+      11
+      11
+      11
+      11
+      11
+        11
+        11
+    """
+    )
+    positions = reads.get_positions()
+    limits, memory = choose_coverage_limits(reads, 1, 10, 1, 10 ** 9, 2)
+    assert limits == [(positions[0], 6), (positions[2], 2)]
+    limits, memory_with_limit = choose_coverage_limits(reads, 1, 4, 1, 10 ** 9, 2)
+    assert limits == [(positions[0], 4), (positions[2], 2)]
+    assert memory_with_limit < memory
+    # If the budget does not suffice for the minimum, the minimum is used anyway
+    limits, memory = choose_coverage_limits(reads, 1, 10, 1, 0, 2)
+    assert limits == [(positions[0], 1)]
+    assert memory > 0
@@ -1,7 +1,8 @@
 import pytest
 
-from whatshap.core import Read, Variant
-from whatshap.variants import merge_two_reads, merge_reads
+from whatshap.core import Read, Variant, AlleleDetector
+from whatshap.variants import ReadSetReader, merge_two_reads, merge_reads
+from whatshap.vcf import VcfVariant
 
 
 @pytest.mark.parametrize("merge", [merge_two_reads, merge_reads])
@@ -90,3 +91,49 @@ def test_merge_many_reads():
     # TODO merging should not depend on the order of reads
     expected[1] = Variant(200, 0, 51)
     assert expected == list(merge_reads(*reads[::-1]))
+
+
+def test_extraction_windows(monkeypatch):
+    monkeypatch.setattr(ReadSetReader, "MIN_WINDOW_VARIANTS", 2)
+    variants = [VcfVariant(position, "A", "C") for position in [10, 20, 30, 40, 50, 60, 70]]
+    assert ReadSetReader._extraction_windows(variants, threads=1) == [
+        (0, 30, True),
+        (30, 50, False),
+        (50, 70, False),
+        (70, None, False),
+    ]
+    windows = ReadSetReader._extraction_windows(variants, threads=1, regions=[(15, 45), (60, None)])
+    assert windows == [(15, 40, True), (40, 45, False), (60, None, True)]
+
+
+def test_allele_detector():
+    reference = "GATTACAGATTACAGATTACA"
+    variants = [VcfVariant(3, "T", "G"), VcfVariant(10, "T", "C"), VcfVariant(14, "G", "<DEL>")]
+    detector = AlleleDetector(variants, reference, overhang=10)
+    assert len(detector) == 3
+    read = Read("read", 60, 0, 0, 0)
+    query = reference[:3] + "G" + reference[4:]
+    # the symbolic allele is skipped
+    assert detector.detect(read, [(0, len(query))], query, 0) == 2
+    assert list(read) == [Variant(3, 1, 30), Variant(10, 0, 30)]
+    assert detector.cache_stats() == {"hits": 0, "misses": 2}
+
+    # the same query is not realigned again
+    read = Read("read2", 60, 0, 0, 0)
+    assert detector.detect(read, [(0, len(query))], query, 0) == 2
+    assert list(read) == [Variant(3, 1, 30), Variant(10, 0, 30)]
+    assert detector.cache_stats() == {"hits": 2, "misses": 2}
+
+    # an alignment without CIGAR covers no variants
+    read = Read("unmapped", 60, 0, 0, 0)
+    assert detector.detect(read, None, query, 0) == 0
+    assert len(read) == 0
+
+
+def test_allele_detector_deletion():
+    reference = "GATTACAGATTACAGATTACA"
+    detector = AlleleDetector([VcfVariant(7, "GA", "G")], reference, overhang=10)
+    read = Read("read", 60, 0, 0, 0)
+    query = reference[:8] + reference[9:]
+    assert detector.detect(read, [(0, 8), (2, 1), (0, 12)], query, 0) == 1
+    assert list(read) == [Variant(7, 1, 30)]
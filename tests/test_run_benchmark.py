@@ -0,0 +1,59 @@
+import json
+
+from whatshap.cli.benchmark import run_benchmark, compare_reports, merge_runs
+
+
+def make_run(wall_seconds, stages, max_rss_bytes):
+    return dict(
+        wall_seconds=wall_seconds,
+        total_seconds=wall_seconds,
+        stages=stages,
+        core={},
+        max_rss_bytes=max_rss_bytes,
+    )
+
+
+def test_merge_runs():
+    runs = [
+        make_run(2.0, {"read_bam": 1.0, "phase": 0.5}, 100),
+        make_run(1.5, {"read_bam": 1.2, "phase": 0.2}, 300),
+    ]
+    merged = merge_runs(runs)
+    assert merged["wall_seconds"] == 1.5
+    assert merged["stages"] == {"read_bam": 1.0, "phase": 0.2}
+    assert merged["max_rss_bytes"] == 300
+    assert merged["repetitions"] == 2
+
+
+def test_compare_reports():
+    baseline = dict(commands=dict(phase=make_run(10.0, {"read_bam": 4.0, "phase": 0.01}, 1000)))
+    report = dict(
+        commands=dict(
+            phase=make_run(10.5, {"read_bam": 6.0, "phase": 0.05}, 1500),
+            haplotag=make_run(1.0, {}, 10),
+        )
+    )
+    comparisons = compare_reports(report, baseline, tolerance=0.2, min_seconds=0.1)
+    regressions = {measure for _, measure, _, _, regression in comparisons if regression}
+    # phase is five times slower, but by less than min_seconds; haplotag is not in the baseline
+    assert regressions == {"stages.read_bam", "max_rss_bytes"}
+    assert all(command == "phase" for command, _, _, _, _ in comparisons)
+
+
+def test_benchmark_haplotag(tmp_path):
+    report_path = tmp_path / "report.json"
+    assert run_benchmark(["haplotag"], repetitions=1, output=report_path)
+    with open(report_path) as f:
+        report = json.load(f)
+    run = report["commands"]["haplotag"]
+    assert run["repetitions"] == 1
+    assert run["max_rss_bytes"] > 0
+    assert "haplotag-process" in run["stages"]
+
+    # Compared against itself (with a generous tolerance), there is no regression
+    second_path = tmp_path / "second.json"
+    assert run_benchmark(
+        ["haplotag"], repetitions=1, output=second_path, baseline=report_path, tolerance=100
+    )
+    with open(second_path) as f:
+        assert json.load(f)["baseline"]["regressions"] == []
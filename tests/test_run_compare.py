@@ -3,7 +3,15 @@ Tests for 'whatshap compare'
 """
 
 from collections import namedtuple
-from whatshap.cli.compare import run_compare, compute_switch_flips_poly, compare_block
+from whatshap.cli.compare import (
+    run_compare,
+    compute_switch_flips_poly,
+    compare_block,
+    compare_blocks,
+    compute_switch_flips,
+    hamming,
+    switch_encoding,
+)
 
 
 def test_compare1(tmp_path):
@@ -324,6 +332,68 @@ def test_compare_block():
     assert switch_flips.switches == 0.0
 
 
+def test_compare_blocks_multithreaded():
+    blocks = [
+        (["000000", "101111", "111010"], ["000000", "101010", "111111"]),
+        (["1110001", "1011101", "0000010"], ["1110001", "1010010", "0001101"]),
+        (["1111101", "1010001", "0000010"], ["1110001", "1010010", "0001101"]),
+        (["111111", "111111", "111111"], ["111111", "000000", "111111"]),
+    ]
+    for threads in [1, 2, 8]:
+        block_errors = compare_blocks(blocks, threads)
+        assert len(block_errors) == len(blocks)
+        for (phasing, truth), errors in zip(blocks, block_errors):
+            expected = compare_block(phasing, truth)
+            assert errors.switches == expected.switches
+            assert errors.hamming == expected.hamming
+            assert errors.diff_genotypes == expected.diff_genotypes
+            assert errors.switch_flips.switches == expected.switch_flips.switches
+            assert errors.switch_flips.flips == expected.switch_flips.flips
+
+
+def test_compare_blocks_diploid():
+    blocks = [
+        (["0001011", "1110100"], ["0001100", "1110011"]),
+        (["0011", "1100"], ["1101", "0010"]),
+        (["010", "101"], ["010", "101"]),
+        (["0120", "1201"], ["0102", "1210"]),
+        (["01", "10"], ["11", "00"]),
+    ]
+    block_errors = compare_blocks(blocks)
+    assert len(block_errors) == len(blocks)
+    for (phasing, truth), errors in zip(blocks, block_errors):
+        switch_flips = compute_switch_flips(phasing[0], truth[0])
+        assert errors.switches == hamming(switch_encoding(phasing[0]), switch_encoding(truth[0]))
+        assert errors.switch_flips.switches == switch_flips.switches
+        assert errors.switch_flips.flips == switch_flips.flips
+        assert errors.hamming == min(
+            hamming(phasing[0], truth[0]) + hamming(phasing[1], truth[1]),
+            hamming(phasing[1], truth[0]) + hamming(phasing[0], truth[1]),
+        ) // 2
+        assert errors.diff_genotypes == sum(
+            sorted(gt0) != sorted(gt1) for gt0, gt1 in zip(zip(*phasing), zip(*truth))
+        )
+
+
+def test_compare_chromosomes_in_parallel(tmp_path):
+    outputs = []
+    for threads in [1, 2]:
+        outtsv = tmp_path / "output{}.tsv".format(threads)
+        outbed = tmp_path / "output{}.bed".format(threads)
+        run_compare(
+            vcf=["tests/data/phased1.vcf", "tests/data/phased2.vcf"],
+            ploidy=2,
+            names="p1,p2",
+            tsv_pairwise=outtsv,
+            switch_error_bed=outbed,
+            sample="sample2",
+            threads=threads,
+        )
+        outputs.append((outtsv.read_text(), outbed.read_text()))
+    assert outputs[0] == outputs[1]
+    assert len(outputs[0][0].splitlines()) == 3
+
+
 def test_compare_ignore_sample_name(tmp_path):
     outtsv = tmp_path / "output.tsv"
     run_compare(
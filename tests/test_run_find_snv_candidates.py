@@ -1,4 +1,5 @@
 from whatshap.cli.find_snv_candidates import run_find_snv_candidates
+from whatshap.core import PileupCounter
 
 
 def test_call(tmpdir):
@@ -20,3 +21,57 @@ def test_call(tmpdir):
             continue
         expected_lines.append(line)
     assert computed_lines == expected_lines
+
+
+def test_call_with_threads(tmp_path, monkeypatch):
+    import whatshap.cli.find_snv_candidates
+
+    # many small tiles, counted in worker processes
+    monkeypatch.setattr(whatshap.cli.find_snv_candidates, "TILE_LENGTH", 1000)
+    outputs = []
+    for threads in [1, 3]:
+        output = tmp_path / f"output{threads}.vcf"
+        run_find_snv_candidates(
+            "tests/data/pacbio/reference.fasta",
+            "tests/data/pacbio/pacbio.bam",
+            datatype="pacbio",
+            output=str(output),
+            threads=threads,
+        )
+        outputs.append([line for line in output.read_text().splitlines() if line[0] != "#"])
+    expected = [line.rstrip("\n") for line in open("tests/data/expected-calls.vcf")]
+    assert outputs[0] == outputs[1] == [line for line in expected if line[0] != "#"]
+
+
+def test_pileup_counter():
+    counter = PileupCounter(100, "ACGTA")
+    # soft clip, 2 matches, deletion, insertion, 3 matches (the last one beyond the region)
+    counter.add("read1", 100, [(4, 2), (0, 2), (2, 1), (1, 1), (0, 3)], "NNTCAGGC", b"")
+    # the second base has a quality below the threshold and is not counted
+    counter.add("read2", 100, [(0, 2)], "AC", bytes([30, 4]))
+    assert [counter.count(100, base) for base in "ACGTN"] == [1, 0, 0, 1, 0]
+    assert counter.count(101, "C") == 1
+    assert [counter.count(102, base) for base in "ACGTN"] == [0, 0, 0, 0, 0]
+    assert counter.count(103, "G") == 1
+    assert counter.count(104, "G") == 1
+    assert counter.candidates(1, 0.5) == [(100, "A", ["T"]), (103, "T", ["G"]), (104, "A", ["G"])]
+    assert counter.candidates(2, 0.5) == []
+
+
+def test_pileup_counter_overlapping_mates():
+    counter = PileupCounter(0, "AAAA")
+    # Overlapping bases of mates are counted once: if the mates agree, the first one
+    # gets the sum of both qualities, otherwise the better base keeps 80% of its quality
+    counter.add("pair", 0, [(0, 3)], "CCC", bytes([3, 30, 10]), mate_start=1)
+    counter.add("pair", 1, [(0, 3)], "CAG", bytes([20, 5, 30]), mate_start=0)
+    assert [counter.count(position, "C") for position in range(4)] == [0, 1, 1, 0]
+    assert counter.count(2, "A") == 0
+    assert counter.count(3, "G") == 1
+    # If the mate is not added, the first alignment is counted unchanged
+    counter.add("single", 0, [(0, 1)], "T", bytes([30]), mate_start=2)
+    assert counter.candidates(1, 0.1) == [
+        (0, "A", ["T"]),
+        (1, "A", ["C"]),
+        (2, "A", ["C"]),
+        (3, "A", ["G"]),
+    ]
@@ -288,6 +288,31 @@ def test_genotyping_trio(tmp_path):
         assert table.samples == ["HG004", "HG003", "HG002"]
 
 
+def test_genotyping_trio_double_precision(tmp_path):
+    # genotyping in double precision should give the same genotypes and (up to rounding)
+    # the same likelihoods as the default long double precision
+    outvcfs = [tmp_path / "output-longdouble.vcf", tmp_path / "output-double.vcf"]
+    for outvcf, dp_precision in zip(outvcfs, ["longdouble", "double"]):
+        run_genotype(
+            phase_input_files=[trio_bamfile],
+            variant_file="tests/data/trio.vcf",
+            output=outvcf,
+            ped="tests/data/trio.ped",
+            genmap="tests/data/trio.map",
+            dp_precision=dp_precision,
+        )
+    table1, table2 = [
+        list(VcfReader(outvcf, phases=True, genotype_likelihoods=True))[0] for outvcf in outvcfs
+    ]
+    assert table1.samples == table2.samples
+    for sample in table1.samples:
+        assert table1.genotypes_of(sample) == table2.genotypes_of(sample)
+        for gl1, gl2 in zip(
+            table1.genotype_likelihoods_of(sample), table2.genotype_likelihoods_of(sample)
+        ):
+            assert gl1.log10_probs() == pytest.approx(gl2.log10_probs(), rel=1e-5, abs=1e-6)
+
+
 @pytest.mark.parametrize("chromosome", ["1", "2"])
 def test_genotyping_specific_chromosome(chromosome, tmp_path):
     outvcf = tmp_path / "output.vcf"
@@ -1,3 +1,5 @@
+from pysam import VariantFile
+
 from whatshap.cli.hapcut2vcf import run_hapcut2vcf
 
 
@@ -6,3 +8,27 @@ def test_hapcut2vcf(tmp_path):
     run_hapcut2vcf(
         hapcut="tests/data/pacbio/hapcut.txt", vcf="tests/data/pacbio/variants.vcf", output=out
     )
+    with VariantFile(str(out)) as vcf:
+        assert "PS" in vcf.header.formats
+        records = {record.pos: record for record in vcf}
+    call = records[10854].samples[0]
+    assert call["GT"] == (0, 1)
+    assert call.phased
+    assert call["PS"] == 10854
+    # not a SNV, left unphased
+    call = records[11850].samples[0]
+    assert call["GT"] == (0, 0)
+    assert not call.phased
+
+
+def test_hapcut2vcf_drops_chromosomes_without_blocks(tmp_path):
+    vcf = tmp_path / "variants.vcf"
+    with open("tests/data/pacbio/variants.vcf") as f:
+        text = f.read()
+    vcf.write_text(text + "other\t100\t.\tA\tG\t50\t.\t.\tGT\t0/1\n")
+    out = tmp_path / "hapcut.vcf"
+    run_hapcut2vcf(hapcut="tests/data/pacbio/hapcut.txt", vcf=str(vcf), output=out)
+    chromosomes = {
+        line.split("\t")[0] for line in out.read_text().splitlines() if not line.startswith("#")
+    }
+    assert chromosomes == {"ref"}
@@ -164,6 +164,24 @@ def test_haplotag_missing_chromosome(tmp_path):
     assert ps_count > 0
 
 
+def test_haplotag_chromosomes_in_parallel(tmp_path):
+    outputs = []
+    for threads in [1, 2]:
+        outbam = tmp_path / f"output{threads}.bam"
+        outlist = tmp_path / f"list{threads}.tsv"
+        run_haplotag(
+            variant_file="tests/data/haplotag.missing_chr.vcf.gz",
+            alignment_file="tests/data/haplotag.large.bam",
+            haplotag_list=outlist,
+            output=outbam,
+            threads=threads,
+        )
+        with pysam.AlignmentFile(outbam) as f:
+            alignments = [alignment.to_string() for alignment in f]
+        outputs.append((alignments, outlist.read_text()))
+    assert outputs[0] == outputs[1]
+
+
 def test_contig_exists_in_bam_but_not_in_vcf_header(tmp_path):
     outbam = tmp_path / "output.bam"
 
@@ -1,13 +1,16 @@
 """
 Integration tests that use the command-line entry points run_whatshap, run_haplotag etc.
 """
+import gzip
+import json
 import os
 from collections import namedtuple
 
 from pytest import raises, fixture, mark
 import pysam
-from whatshap.cli.phase import run_whatshap
+from whatshap.cli.phase import run_whatshap, estimate_unit_count
 from whatshap.cli import CommandLineError
+from whatshap.variants import ReadSetReader
 from whatshap.vcf import VcfReader, VariantCallPhase
 
 
@@ -35,7 +38,7 @@ bam_files = [
 ]
 
 
-@fixture(params=["whatshap", "hapchat"])
+@fixture(params=["whatshap", "hapchat", "auto"])
 def algorithm(request):
     return request.param
 
@@ -62,6 +65,17 @@ def test_run_phase_without_reference():
         main(["phase", "-o", "/dev/null", "tests/data/onevariant.vcf", "tests/data/oneread.bam"])
 
 
+def test_internal_downsampling_limit():
+    from whatshap.__main__ import main
+
+    arguments = ["--no-reference", "--internal-downsampling", "30", "-o", "/dev/null"]
+    inputs = ["tests/data/onevariant.vcf", "tests/data/oneread.bam"]
+    with raises(SystemExit):
+        main(["phase"] + arguments + inputs)
+    # HapChat is not limited by the size of the DP columns
+    main(["phase", "--algorithm", "hapchat"] + arguments + inputs)
+
+
 def test_one_variant(algorithm):
     run_whatshap(
         phase_input_files=["tests/data/oneread.bam"],
@@ -167,6 +181,26 @@ def test_with_reference(algorithm, expected_vcf, tmpdir):
     assert actual == expected, "VCF output not as expected"
 
 
+def test_with_reference_parallel_allele_detection(monkeypatch, tmp_path):
+    # use many small windows
+    monkeypatch.setattr(ReadSetReader, "MIN_WINDOW_VARIANTS", 3)
+    out = str(tmp_path / "out.vcf")
+    run_whatshap(
+        phase_input_files=["tests/data/pacbio/pacbio.bam"],
+        variant_file="tests/data/pacbio/variants.vcf",
+        reference="tests/data/pacbio/reference.fasta",
+        output=out,
+        write_command_line_header=False,
+        threads=3,
+    )
+    with open("tests/data/pacbio/phased.vcf") as f:
+        expected = f.read()
+    with open(out) as f:
+        actual = f.read()
+
+    assert actual == expected, "VCF output not as expected"
+
+
 def test_with_reference_and_indels(algorithm):
     run_whatshap(
         phase_input_files=["tests/data/pacbio/pacbio.bam"],
@@ -656,6 +690,132 @@ def test_phase_specific_chromosome(chromosome, tmp_path):
             assert_phasing(table.phases_of("HG002"), [None, None, None, None, None])
 
 
+@mark.parametrize("ped", [None, "tests/data/trio.ped"])
+def test_phase_chromosomes_in_parallel(ped, tmp_path):
+    outputs = []
+    for threads in [1, 3]:
+        outvcf = tmp_path / f"output{threads}.vcf"
+        outreadlist = tmp_path / f"readlist{threads}.tsv"
+        run_whatshap(
+            phase_input_files=[trio_bamfile],
+            variant_file="tests/data/trio-two-chromosomes.vcf",
+            output=outvcf,
+            ped=ped,
+            genmap="tests/data/trio.map",
+            read_list_filename=outreadlist,
+            write_command_line_header=False,
+            threads=threads,
+        )
+        outputs.append((outvcf.read_text(), outreadlist.read_text()))
+    assert outputs[0] == outputs[1]
+
+
+def test_phase_compressed_output_with_threads(tmp_path):
+    outputs = []
+    for threads in [1, 2]:
+        outvcf = tmp_path / f"output{threads}.vcf.gz"
+        run_whatshap(
+            phase_input_files=[trio_bamfile],
+            variant_file="tests/data/trio-two-chromosomes.vcf",
+            output=outvcf,
+            write_command_line_header=False,
+            threads=threads,
+        )
+        with gzip.open(outvcf, "rt") as f:
+            outputs.append(f.read())
+    assert outputs[0] == outputs[1]
+
+
+@mark.parametrize("threads", [1, 3])
+def test_phase_read_cache(threads, tmp_path):
+    cache_dir = tmp_path / "cache"
+    outputs = []
+    for i in range(2):
+        outvcf = tmp_path / f"output{i}.vcf"
+        run_whatshap(
+            phase_input_files=[trio_bamfile],
+            variant_file="tests/data/trio-two-chromosomes.vcf",
+            output=outvcf,
+            ped="tests/data/trio.ped",
+            genmap="tests/data/trio.map",
+            write_command_line_header=False,
+            threads=threads,
+            read_cache=str(cache_dir),
+        )
+        if i == 0:
+            entries = sorted(os.listdir(cache_dir))
+            assert entries
+        outputs.append(outvcf.read_text())
+    assert sorted(os.listdir(cache_dir)) == entries
+    assert outputs[0] == outputs[1]
+
+
+@mark.parametrize("chromosomes", [None, ["1"]])
+def test_phase_pipeline_depth(chromosomes, tmp_path):
+    outputs = []
+    for depth in [0, 1, 3]:
+        outvcf = tmp_path / f"output{depth}.vcf"
+        run_whatshap(
+            phase_input_files=[trio_bamfile],
+            variant_file="tests/data/trio-two-chromosomes.vcf",
+            output=outvcf,
+            chromosomes=chromosomes,
+            write_command_line_header=False,
+            pipeline_depth=depth,
+        )
+        outputs.append(outvcf.read_text())
+    assert outputs[0] == outputs[1] == outputs[2]
+
+
+def test_phase_coverage_budget(tmp_path):
+    # A budget of 0 leaves the minimum coverage everywhere
+    outputs = []
+    for kwargs in [dict(max_coverage=5), dict(coverage_budget=0)]:
+        outvcf = tmp_path / "output.vcf"
+        run_whatshap(
+            phase_input_files=["tests/data/pacbio/pacbio.bam"],
+            variant_file="tests/data/pacbio/variants.vcf",
+            reference="tests/data/pacbio/reference.fasta",
+            output=outvcf,
+            write_command_line_header=False,
+            **kwargs,
+        )
+        outputs.append(outvcf.read_text())
+    assert outputs[0] == outputs[1]
+
+    run_whatshap(
+        phase_input_files=[trio_bamfile],
+        variant_file="tests/data/trio.vcf",
+        ped="tests/data/trio.ped",
+        output=tmp_path / "trio.vcf",
+        coverage_budget=100,
+    )
+
+
+@mark.parametrize("threads,pipeline_depth", [(1, 0), (1, 1), (3, 0)])
+def test_phase_timers_json(threads, pipeline_depth, tmp_path):
+    timers_json = tmp_path / "timers.json"
+    run_whatshap(
+        phase_input_files=[trio_bamfile],
+        variant_file="tests/data/trio-two-chromosomes.vcf",
+        output=tmp_path / "output.vcf",
+        ped="tests/data/trio.ped",
+        genmap="tests/data/trio.map",
+        threads=threads,
+        timers_json=timers_json,
+        pipeline_depth=pipeline_depth,
+    )
+    timers = json.loads(timers_json.read_text())
+    # stages run in background threads or worker processes are included
+    for stage in ["parse_vcf", "read_bam", "phase", "write_vcf"]:
+        assert timers["stages"][stage] > 0
+    core = timers["core"]
+    assert core["pedigree_columns"] > 0
+    assert core["pedigree_max_column_size"] > 0
+    assert core["pedigree_column_bytes"] > 0
+    assert core["cluster_editing_runs"] == 0
+
+
 def test_phase_trio_paired_end_reads(tmp_path):
     outvcf = tmp_path / "output-paired_end.vcf"
     run_whatshap(
@@ -979,3 +1139,15 @@ def test_distrust_genotypes_assertion(tmp_path):
     assert table.chromosome == "chr1"
     phase0 = VariantCallPhase(23824647, (0, 1), None)
     assert_phasing(table.phases_of("NA12878"), [None, phase0, None, phase0])
+
+
+def test_estimate_unit_count():
+    # chromosomes are listed in the header
+    vcf_reader = VcfReader("tests/data/phased-via-mixed-HP-PS.vcf")
+    assert estimate_unit_count(vcf_reader, [], 1) == 2
+    assert estimate_unit_count(vcf_reader, ["chrA"], 3) == 3
+    assert estimate_unit_count(vcf_reader, ["chrC"], 1) == 0
+    # no index and no contig headers
+    vcf_reader = VcfReader("tests/data/multisample.vcf")
+    assert estimate_unit_count(vcf_reader, ["chrA"], 1) == 1
+    assert estimate_unit_count(vcf_reader, [], 1) > 1
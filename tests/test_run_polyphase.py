@@ -126,3 +126,49 @@ def test_polyphase_multithreaded(tmp_path):
         [st == mt for (st, mt) in zip(table_st.genotype_likelihoods, table_mt.genotype_likelihoods)]
     )
     assert all([st == mt for (st, mt) in zip(table_st.variants, table_mt.variants)])
+
+
+def test_polyphase_multithreaded_block_cuts(tmp_path):
+    """Blocks phased on several threads must be cut exactly as in single-threaded runs"""
+
+    for s in [3, 4, 5]:
+        phases = []
+        for threads in [1, 2]:
+            outvcf = tmp_path / "output{}_{}.vcf".format(s, threads)
+            run_polyphase(
+                phase_input_files=["tests/data/polyploid.chr22.42M.12k.bam"],
+                variant_file="tests/data/polyploid.chr22.42M.12k.vcf",
+                ploidy=4,
+                ignore_read_groups=True,
+                block_cut_sensitivity=s,
+                output=outvcf,
+                threads=threads,
+            )
+            tables = list(VcfReader(outvcf, phases=True))
+            assert len(tables) == 1
+            phases.append(tables[0].phases_of("HG00514_NA19240"))
+        assert phases[0] == phases[1]
+
+
+def test_polyphase_score_index(tmp_path):
+    index_dir = tmp_path / "index"
+    outputs = []
+    for i, (threads, score_index) in enumerate([(1, None), (1, index_dir), (2, index_dir)]):
+        outvcf = tmp_path / "output{}.vcf".format(i)
+        run_polyphase(
+            phase_input_files=["tests/data/polyploid.chr22.42M.12k.bam"],
+            variant_file="tests/data/polyploid.chr22.42M.12k.vcf",
+            ploidy=4,
+            ignore_read_groups=True,
+            output=outvcf,
+            write_command_line_header=False,
+            threads=threads,
+            score_index=None if score_index is None else str(score_index),
+        )
+        if i == 1:
+            entries = sorted(os.listdir(index_dir))
+            assert entries
+        outputs.append(outvcf.read_text())
+    # the second run reuses the stored index
+    assert sorted(os.listdir(index_dir)) == entries
+    assert outputs[0] == outputs[1] == outputs[2]
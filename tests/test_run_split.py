@@ -1,3 +1,5 @@
+import pysam
+
 from whatshap.cli.split import run_split
 
 
@@ -35,3 +37,32 @@ def test_split_bam_no_sequence(tmp_path):
         produced_output = dump.readlines()[1:]  # skip header line
         for e, p in zip(expected_output, produced_output):
             assert e == p
+
+
+def test_split_bam_threads(tmp_path):
+    input_bam = "tests/data/reads-no-sequence.bam"
+    input_list = "tests/data/reads-no-sequence.haplotags.tsv"
+    for discard_unknown_reads, expected_reads in [(False, 10), (True, 3)]:
+        outputs = []
+        for threads in [1, 3]:
+            paths = [
+                tmp_path / "{}.{}.{:d}.bam".format(name, threads, discard_unknown_reads)
+                for name in ("h1", "h2", "untagged")
+            ]
+            run_split(
+                input_bam,
+                input_list,
+                output_h1=str(paths[0]),
+                output_h2=str(paths[1]),
+                output_untagged=str(paths[2]),
+                discard_unknown_reads=discard_unknown_reads,
+                threads=threads,
+            )
+            names = []
+            for path in paths:
+                with pysam.AlignmentFile(path, check_sq=False) as bam:
+                    names.append([record.query_name for record in bam.fetch(until_eof=True)])
+            outputs.append(names)
+        assert outputs[0] == outputs[1]
+        assert [len(names) for names in outputs[0]][:2] == [2, 1]
+        assert sum(len(names) for names in outputs[0]) == expected_reads
@@ -1,7 +1,12 @@
 """
 Tests for 'whatshap stats'
 """
+import gzip
+import shutil
 from collections import namedtuple
+
+from pytest import mark
+
 from whatshap.cli.stats import run_stats
 
 
@@ -85,3 +90,54 @@ def test_stats2(tmp_path):
     assert entry_all.variant_per_block_sum == "8"
     assert entry_all.bp_per_block_sum == "750"
     assert entry_all.block_n50[:-1] == "350"
+
+
+def test_stats_chromosomes_in_parallel(tmp_path):
+    outputs = []
+    for threads in [1, 2]:
+        outtsv = tmp_path / "output{}.tsv".format(threads)
+        outgtf = tmp_path / "output{}.gtf".format(threads)
+        outblocks = tmp_path / "blocks{}.tsv".format(threads)
+        run_stats(
+            vcf="tests/data/haplotag.large.vcf.gz",
+            tsv=outtsv,
+            gtf=outgtf,
+            block_list=outblocks,
+            threads=threads,
+        )
+        outputs.append((outtsv.read_text(), outgtf.read_text(), outblocks.read_text()))
+    assert outputs[0] == outputs[1]
+    lines = [l.split("\t") for l in outputs[1][0].splitlines()]
+    assert [fields[1] for fields in lines[1:]] == ["chr1", "chr2", "chr3", "ALL"]
+    Fields = namedtuple("Fields", [f.strip("#") for f in lines[0]])
+    entry_all = Fields(*lines[-1])
+    assert entry_all.variants == "17"
+
+
+@mark.parametrize("chromosomes", [None, ["chr3", "chr1"]])
+def test_stats_indexed_and_unindexed_vcf(tmp_path, chromosomes):
+    # Without an index, the VCF is streamed serially, with an index, chromosomes are fetched
+    # in worker processes. Both must give the same output.
+    unindexed = tmp_path / "unindexed.vcf"
+    with gzip.open("tests/data/haplotag.large.vcf.gz", "rb") as f, open(unindexed, "wb") as out:
+        shutil.copyfileobj(f, out)
+    outputs = []
+    for name, vcf in [("indexed", "tests/data/haplotag.large.vcf.gz"), ("unindexed", unindexed)]:
+        outtsv = tmp_path / f"{name}.tsv"
+        outgtf = tmp_path / f"{name}.gtf"
+        outblocks = tmp_path / f"{name}.blocks.tsv"
+        run_stats(
+            vcf=str(vcf),
+            tsv=outtsv,
+            gtf=outgtf,
+            block_list=outblocks,
+            chromosomes=chromosomes,
+            threads=2,
+        )
+        # the third column of the TSV is the file name
+        tsv = [line.split("\t") for line in outtsv.read_text().splitlines()]
+        tsv = [fields[:2] + fields[3:] for fields in tsv]
+        outputs.append((tsv, outgtf.read_text(), outblocks.read_text()))
+    assert outputs[0] == outputs[1]
+    expected_chromosomes = ["chr1", "chr2", "chr3"] if chromosomes is None else ["chr1", "chr3"]
+    assert [fields[1] for fields in outputs[0][0][1:]] == expected_chromosomes + ["ALL"]
@@ -0,0 +1,162 @@
+from pytest import raises
+from pysam import VariantFile
+
+from whatshap.cli import CommandLineError
+from whatshap.cli.phase import run_whatshap
+from whatshap.cli.stitch import run_stitch, BlockJoiner
+
+VCF_HEADER = """##fileformat=VCFv4.2
+##whatshap_shard={shard}
+##contig=<ID=chr1,length=10000>
+##FORMAT=<ID=GT,Number=1,Type=String,Description="Genotype">
+##FORMAT=<ID=PS,Number=1,Type=Integer,Description="Phase set identifier">
+#CHROM	POS	ID	REF	ALT	QUAL	FILTER	INFO	FORMAT	sample
+"""
+
+
+def write_shard(path, shard, calls):
+    """calls is a list of (position, genotype, phase set) tuples"""
+    with open(path, "w") as f:
+        f.write(VCF_HEADER.format(shard=shard))
+        for position, genotype, ps in calls:
+            fields = "GT:PS\t{}:{}".format(genotype, ps) if ps is not None else "GT\t" + genotype
+            print("chr1", position, ".", "A", "C", ".", "PASS", ".", fields, sep="\t", file=f)
+
+
+def read_calls(path):
+    calls = []
+    for record in VariantFile(path):
+        call = record.samples["sample"]
+        genotype = ("|" if call.phased else "/").join(str(allele) for allele in call["GT"])
+        calls.append((record.pos, genotype, call.get("PS") if call.phased else None))
+    return calls
+
+
+def test_block_joiner():
+    joiner = BlockJoiner()
+    assert joiner.join("a", "b", True)
+    assert joiner.join("c", "b", False)
+    assert joiner.join("c", "d", True)
+    root, swapped_a = joiner.find("a")
+    for block, expected_swap in [("b", True), ("c", True), ("d", False)]:
+        block_root, swapped = joiner.find(block)
+        assert block_root == root
+        assert swapped ^ swapped_a == expected_swap
+    assert not joiner.join("a", "d", True)
+    assert joiner.join("a", "d", False)
+
+
+def test_stitch(tmp_path):
+    # Shard 1 owns 1-1000 and shard 2 owns 1001-; their windows overlap at 801-1200
+    shard1 = tmp_path / "shard1.vcf"
+    shard2 = tmp_path / "shard2.vcf"
+    write_shard(
+        shard1,
+        "chr1:1-1000;window=1-1200",
+        [
+            (100, "0|1", 100),
+            (500, "1|0", 100),
+            (900, "0|1", 100),
+            (950, "0/1", None),
+            (1100, "1|0", 100),
+        ],
+    )
+    write_shard(
+        shard2,
+        "chr1:1001-;window=801-",
+        [
+            (900, "1|0", 850),
+            (950, "0/1", None),
+            (1100, "0|1", 850),
+            (1500, "1|0", 850),
+            (3000, "0|1", 3000),
+            (3100, "0|1", 3000),
+        ],
+    )
+    out = tmp_path / "out.vcf"
+    # Order of the inputs does not matter
+    run_stitch([str(shard2), str(shard1)], str(out), write_command_line_header=False)
+    assert read_calls(out) == [
+        (100, "0|1", 100),
+        (500, "1|0", 100),
+        (900, "0|1", 100),
+        (950, "0/1", None),
+        (1100, "1|0", 100),
+        (1500, "0|1", 100),
+        (3000, "0|1", 3000),
+        (3100, "0|1", 3000),
+    ]
+    with open(out) as f:
+        assert "whatshap_shard" not in f.read()
+
+
+def test_stitch_without_shard_header(tmp_path):
+    with raises(CommandLineError):
+        run_stitch(["tests/data/phased-via-PS.vcf"], str(tmp_path / "out.vcf"))
+
+
+def test_stitch_overlapping_regions(tmp_path):
+    shard1 = tmp_path / "shard1.vcf"
+    shard2 = tmp_path / "shard2.vcf"
+    write_shard(shard1, "chr1:1-1000;window=1-1200", [])
+    write_shard(shard2, "chr1:901-;window=801-", [])
+    with raises(CommandLineError):
+        run_stitch([str(shard1), str(shard2)], str(tmp_path / "out.vcf"))
+
+
+def test_stitch_gap_between_regions(tmp_path):
+    shard1 = tmp_path / "shard1.vcf"
+    shard2 = tmp_path / "shard2.vcf"
+    write_shard(shard1, "chr1:1-1000;window=1-1200", [])
+    write_shard(shard2, "chr1:1101-;window=901-", [])
+    with raises(CommandLineError):
+        run_stitch([str(shard1), str(shard2)], str(tmp_path / "out.vcf"))
+
+
+def test_stitch_region_not_at_chromosome_border(tmp_path):
+    # Only variants within the regions are written if the shards do not reach the
+    # chromosome ends
+    shard1 = tmp_path / "shard1.vcf"
+    shard2 = tmp_path / "shard2.vcf"
+    write_shard(shard1, "chr1:101-1000;window=1-1200", [(50, "0|1", 50), (500, "0|1", 50)])
+    write_shard(shard2, "chr1:1001-2000;window=801-2200", [(1500, "0|1", 900), (2100, "0|1", 900)])
+    out = tmp_path / "out.vcf"
+    run_stitch([str(shard1), str(shard2)], str(out), write_command_line_header=False)
+    assert read_calls(out) == [(500, "0|1", 500), (1500, "0|1", 1500)]
+
+
+def run_pacbio_shard(region, output, region_margin):
+    run_whatshap(
+        phase_input_files=["tests/data/pacbio/pacbio.bam"],
+        variant_file="tests/data/pacbio/variants.vcf",
+        reference="tests/data/pacbio/reference.fasta",
+        output=str(output),
+        write_command_line_header=False,
+        region=region,
+        region_margin=region_margin,
+    )
+
+
+def test_phase_region(tmp_path):
+    out = tmp_path / "shard.vcf"
+    run_pacbio_shard("ref:12001-13000", out, region_margin=500)
+    positions = [record.pos for record in VariantFile(out)]
+    assert positions
+    assert all(11500 < position <= 13500 for position in positions)
+
+
+def test_phase_regions_and_stitch(tmp_path):
+    # With windows that cover the entire chromosome, both shards are phased like the
+    # complete chromosome
+    shards = []
+    for i, region in enumerate(["ref:1-15000", "ref:15001-"]):
+        shards.append(tmp_path / "shard{}.vcf".format(i))
+        run_pacbio_shard(region, shards[-1], region_margin=100000)
+    out = tmp_path / "stitched.vcf"
+    run_stitch([str(shard) for shard in shards], str(out), write_command_line_header=False)
+
+    with open("tests/data/pacbio/phased.vcf") as f:
+        expected = [line for line in f if not line.startswith("#")]
+    with open(out) as f:
+        actual = [line for line in f if not line.startswith("#")]
+    assert actual == expected
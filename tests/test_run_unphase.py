@@ -1,4 +1,8 @@
-from whatshap.cli.unphase import run_unphase
+import gzip
+
+from pysam import VariantFile
+
+from whatshap.cli.unphase import run_unphase, TAGS_TO_REMOVE
 
 
 def test_unphase(tmpdir):
@@ -12,3 +16,85 @@ def test_unphase(tmpdir):
 def test_unphase_string_typed_ps(tmpdir):
     # Ensure a VCF with PS tags of type String (although against VCF spec) can be read
     run_unphase("tests/data/string_typed_ps_tag.vcf", str(tmpdir.join("out.vcf")))
+
+
+def test_unphase_compressed_input(tmp_path):
+    compressed = tmp_path / "phased.vcf.gz"
+    with open("tests/data/phased-via-mixed-HP-PS.vcf", "rb") as f:
+        compressed.write_bytes(gzip.compress(f.read()))
+    out = tmp_path / "out.vcf"
+    run_unphase(str(compressed), str(out), threads=2)
+    with open("tests/data/unphased.vcf") as f:
+        expected = f.read()
+    assert expected == out.read_text(encoding="ascii")
+
+
+def test_unphase_bcf_input(tmp_path):
+    bcf = tmp_path / "phased.bcf"
+    with VariantFile("tests/data/phased-via-mixed-HP-PS.vcf") as vcf:
+        with VariantFile(str(bcf), "wb", header=vcf.header) as writer:
+            for record in vcf:
+                writer.write(record)
+    out = tmp_path / "out.vcf"
+    run_unphase(str(bcf), str(out))
+    with open("tests/data/unphased.vcf") as f:
+        expected = f.read()
+    assert expected == out.read_text(encoding="ascii")
+
+
+
+def unphase_with_pysam(vcf_path, out_path):
+    """The pysam implementation of unphase, whose output rewrite_vcf_text reproduces"""
+    with VariantFile(vcf_path) as reader:
+        for tag in TAGS_TO_REMOVE:
+            if tag in reader.header.formats:
+                reader.header.formats.remove_header(tag)
+        with VariantFile(out_path, mode="w", header=reader.header) as writer:
+            for record in reader:
+                for tag in TAGS_TO_REMOVE:
+                    if tag in record.format:
+                        del record.format[tag]
+                for call in record.samples.values():
+                    if call["GT"] is not None and None not in call["GT"]:
+                        call["GT"] = sorted(call["GT"])
+                    call.phased = False
+                writer.write(record)
+
+
+def test_unphase_float_fields(tmp_path):
+    # htslib reformats Float values, so such records are decoded with pysam
+    vcf = tmp_path / "float.vcf"
+    vcf.write_text(
+        "##fileformat=VCFv4.2\n"
+        "##contig=<ID=chr1,length=1000>\n"
+        '##INFO=<ID=AF,Number=A,Type=Float,Description="Allele frequency">\n'
+        '##FORMAT=<ID=GT,Number=1,Type=String,Description="Genotype">\n'
+        '##FORMAT=<ID=GL,Number=G,Type=Float,Description="Genotype likelihoods">\n'
+        '##FORMAT=<ID=PS,Number=1,Type=Integer,Description="Phase set">\n'
+        "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\tsample\n"
+        "chr1\t100\t.\tA\tC\t50.0\tPASS\tAF=0.50\tGT:GL:PS\t1|0:-0.50,-1.00,-3.20:100\n"
+        "chr1\t200\t.\tG\tT\t.\tPASS\tAF=1.000\tGT:GL:PS\t0|1:-2.0,0.0,-1e-2:100\n"
+    )
+    out = tmp_path / "out.vcf"
+    run_unphase(str(vcf), str(out))
+    expected = tmp_path / "expected.vcf"
+    unphase_with_pysam(str(vcf), str(expected))
+    assert out.read_text() == expected.read_text()
+    assert "-0.5,-1,-3.2" in out.read_text()
+
+
+def test_unphase_without_contig_headers(tmp_path):
+    # The contig header lines that htslib would add are added
+    vcf = tmp_path / "nocontigs.vcf"
+    vcf.write_text(
+        "##fileformat=VCFv4.2\n"
+        '##FORMAT=<ID=GT,Number=1,Type=String,Description="Genotype">\n'
+        "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\tsample\n"
+        "chr1\t100\t.\tA\tC\t.\tPASS\t.\tGT\t1|0\n"
+        "chr2\t200\t.\tG\tT\t.\tPASS\t.\tGT\t0|1\n"
+    )
+    out = tmp_path / "out.vcf"
+    run_unphase(str(vcf), str(out))
+    with VariantFile(str(out)) as result:
+        assert list(result.header.contigs) == ["chr1", "chr2"]
+        assert [str(record.samples["sample"]["GT"]) for record in result] == ["(0, 1)"] * 2
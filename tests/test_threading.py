@@ -8,13 +8,14 @@ from whatshap.threading import (
     get_coverage,
     get_coverage_absolute,
     get_cluster_start_end_positions,
-    compute_cut_positions,
     improve_path_on_multiswitches,
+    improve_path_on_collapsedswitches,
+    compute_cluster_to_cluster_similarity,
     compute_threading_path,
     get_pos_to_clusters_map,
     get_local_cluster_consensus,
 )
-from whatshap.core import Read, ReadSet
+from whatshap.core import Read, ReadSet, BlockPhaser, HaploThreader, ThreadingPreprocessor
 
 
 def create_testinstance1():
@@ -215,6 +216,10 @@ def test_cut_positions():
         [8, 11, 9, 10],
     ]
 
+    def compute_cut_positions(path, block_cut_sensitivity, num_clusters):
+        phaser = BlockPhaser(4, 2, False, 0, block_cut_sensitivity)
+        return phaser.compute_cut_positions(path, num_clusters)
+
     cuts1 = compute_cut_positions(path, 1, 12)
     cuts2 = compute_cut_positions(path, 2, 12)
     cuts3 = compute_cut_positions(path, 3, 12)
@@ -347,3 +352,114 @@ def test_path_with_affine():
     assert first_block == first_truth
     assert second_block == second_truth
     assert third_block == third_truth
+
+
+def test_path_beam():
+    readset, var_pos, clustering, genotypes = create_testinstance1()
+    ploidy = 3
+
+    index, rev_index = get_position_map(readset)
+    num_vars = len(rev_index)
+    positions = get_cluster_start_end_positions(readset, clustering, index)
+    coverage = get_coverage(readset, clustering, index)
+    cov_map = get_pos_to_clusters_map(coverage, ploidy)
+    consensus = get_local_cluster_consensus(readset, clustering, cov_map, positions)
+
+    paths = [
+        compute_threading_path(
+            readset,
+            clustering,
+            num_vars,
+            coverage,
+            cov_map,
+            consensus,
+            ploidy,
+            genotypes,
+            beam_width=beam_width,
+            memory_limit=memory_limit,
+            threads=threads,
+        )
+        for beam_width, memory_limit, threads in [(64, 0, 1), (64, 0, 4), (0, 2**20, 1)]
+    ]
+    for path in paths:
+        assert path == paths[0]
+        cluster_paths = ["".join([str(path[i][j]) for i in range(len(path))]) for j in range(3)]
+        first_block = set([cluster_paths[0][:9], cluster_paths[1][:9], cluster_paths[2][:9]])
+        assert first_block == set(["000000000", "111111111", "044444444"])
+        third_block = set([cluster_paths[0][20:], cluster_paths[1][20:], cluster_paths[2][20:]])
+        assert third_block == set(["66", "77", "55"])
+
+
+def test_haplothreader_independent_blocks():
+    # two regions without common clusters, threaded as separate runs
+    cov_map = [[0, 1]] * 4 + [[2, 3, 4]] * 4
+    coverage = [[0.5, 0.5]] * 4 + [[0.5, 0.25, 0.25]] * 4
+    consensus = [[0, 1]] * 4 + [[0, 1, 1]] * 4
+    genotypes = [{0: 2, 1: 1}] * 4 + [{0: 1, 1: 2}] * 4
+
+    paths = []
+    for threads in [1, 2]:
+        threader = HaploThreader(3, 32.0, 8.0, True, 0, 0, 0, threads)
+        paths.append(
+            threader.computePathsBlockwise([0, 4], cov_map, coverage, consensus, genotypes)
+        )
+    assert paths[0] == paths[1]
+    path = paths[0]
+    assert len(path) == 8
+    for pos in range(4):
+        assert sorted(path[pos]) == [0, 0, 1]
+    for pos in range(4, 8):
+        assert sorted(path[pos]) == [2, 3, 4]
+    # haplotypes keep their clusters within each run
+    assert all(path[pos] == path[0] for pos in range(4))
+    assert all(path[pos] == path[4] for pos in range(4, 8))
+
+
+def test_threading_preprocessor():
+    readset, var_pos, clustering, genotypes = create_testinstance1()
+    ploidy = 3
+
+    index, rev_index = get_position_map(readset)
+    num_vars = len(rev_index)
+    positions = get_cluster_start_end_positions(readset, clustering, index)
+    coverage = get_coverage(readset, clustering, index)
+    cov_map = get_pos_to_clusters_map(coverage, ploidy)
+    consensus = get_local_cluster_consensus(readset, clustering, cov_map, positions)
+    cluster_sim = compute_cluster_to_cluster_similarity(
+        readset, clustering, index, consensus, cov_map
+    )
+
+    # auxiliary data must be identical to the one computed in Python
+    preprocessor = ThreadingPreprocessor(readset, clustering, ploidy)
+    assert preprocessor.get_num_positions() == num_vars
+    assert preprocessor.get_genome_positions() == rev_index
+    assert preprocessor.get_cluster_start_end_positions() == positions
+    assert preprocessor.get_cov_map() == cov_map
+    assert preprocessor.get_compressed_coverage() == [
+        [coverage[pos][c] for c in cov_map[pos]] for pos in range(num_vars)
+    ]
+    assert preprocessor.get_compressed_consensus() == [
+        [consensus[pos][c] for c in cov_map[pos]] for pos in range(num_vars)
+    ]
+    for pos in range(1, num_vars):
+        for c1 in cov_map[pos - 1]:
+            for c2 in cov_map[pos]:
+                assert preprocessor.get_similarity(pos, c1, c2) == cluster_sim[pos][(c1, c2)]
+
+    # threading and post processing must yield the same paths
+    path = compute_threading_path(
+        readset, clustering, num_vars, coverage, cov_map, consensus, ploidy, genotypes
+    )
+    threader = HaploThreader(ploidy, 32.0, 8.0, True, 0)
+    assert threader.computePathsPreprocessed(preprocessor, genotypes) == path
+    multi_path = improve_path_on_multiswitches(path, len(clustering), cluster_sim)
+    assert preprocessor.improve_path_on_multiswitches(path) == multi_path
+    collapsed_path = improve_path_on_collapsedswitches(multi_path, len(clustering), cluster_sim)
+    assert preprocessor.improve_path_on_collapsedswitches(multi_path) == collapsed_path
+
+    haplotypes = preprocessor.get_haplotypes(collapsed_path)
+    assert len(haplotypes) == ploidy
+    for j in range(ploidy):
+        assert haplotypes[j] == "".join(
+            str(consensus[pos][collapsed_path[pos][j]]) for pos in range(num_vars)
+        )
@@ -1,4 +1,5 @@
 import os.path
+import pickle
 
 from pytest import raises
 from whatshap.utils import (
@@ -7,6 +8,7 @@ from whatshap.utils import (
     FastaNotIndexedError,
     Region,
     InvalidRegion,
+    reference_sequence,
 )
 
 
@@ -27,6 +29,24 @@ def test_missing_fai():
         IndexedFasta("tests/data/not-indexed.fasta")
 
 
+def test_reference_sequence():
+    fasta = IndexedFasta("tests/data/pacbio/reference.fasta")
+    sequence = reference_sequence(fasta, "ref")
+    assert sequence.is_mapped()
+    expected = fasta["ref"][:]
+    assert len(sequence) == len(expected) == 26081
+    assert sequence[:] == expected
+    # spans several lines of the (lower case) FASTA file
+    assert sequence[55:130] == expected[55:130]
+    assert sequence[-1] == expected[-1]
+    assert sequence[26000:30000] == expected[26000:]
+    unpickled = pickle.loads(pickle.dumps(sequence))
+    assert unpickled.is_mapped()
+    assert unpickled[:] == expected
+    with raises(KeyError):
+        reference_sequence(fasta, "nonexistent")
+
+
 def test_region_start_greater_than_end():
     with raises(InvalidRegion):
         Region.parse("chr1:500-200")
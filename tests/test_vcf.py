@@ -65,6 +65,48 @@ def test_read_multisample_vcf():
     assert list(table.genotypes_of("sample2")) == canonic_index_list_to_biallelic_gt_list([1, 1, 0])
 
 
+def test_read_tables_of_included_chromosomes():
+    vcf_reader = VcfReader("tests/data/multisample.vcf")
+    tables = list(vcf_reader.tables(lambda chromosome: chromosome == "chrB"))
+    assert [chromosome for chromosome, _ in tables] == ["chrA", "chrB"]
+    assert tables[0][1] is None
+    table = tables[1][1]
+    assert table.chromosome == "chrB"
+    assert len(table.variants) == 1
+
+
+def test_read_subset_samples():
+    vcf_reader = VcfReader("tests/data/multisample.vcf", threads=2)
+    vcf_reader.subset_samples(["sample2"])
+    assert vcf_reader.samples == ["sample2"]
+    table = list(vcf_reader)[0]
+    assert table.samples == ["sample2"]
+    assert len(table.genotypes) == 1
+    assert list(table.genotypes_of("sample2")) == canonic_index_list_to_biallelic_gt_list([1, 1, 0])
+
+
+def test_stream():
+    tables = list(VcfReader("tests/data/phased-via-PS.vcf", phases=True))
+    vcf_reader = VcfReader("tests/data/phased-via-PS.vcf", phases=True)
+    assert vcf_reader.indexed_chromosomes() is None
+    streamed = [(chromosome, list(rows)) for chromosome, rows in vcf_reader.stream()]
+    assert [chromosome for chromosome, _ in streamed] == [table.chromosome for table in tables]
+    for table, (_, rows) in zip(tables, streamed):
+        assert [row[0] for row in rows] == table.variants
+        for i, sample in enumerate(table.samples):
+            assert [row[1][i] for row in rows] == table.genotypes_of(sample)
+            assert [row[2][i] for row in rows] == table.phases_of(sample)
+
+
+def test_stream_chromosome():
+    vcf_reader = VcfReader("tests/data/haplotag.large.vcf.gz", phases=True)
+    assert vcf_reader.indexed_chromosomes() == ["chr1", "chr2", "chr3"]
+    streamed = [(chromosome, list(rows)) for chromosome, rows in vcf_reader.stream("chr2")]
+    assert len(streamed) == 1
+    assert streamed[0][0] == "chr2"
+    assert len(streamed[0][1]) == 5
+
+
 def test_read_phased_vcf():
     for filename in ["tests/data/phased-via-HP.vcf", "tests/data/phased-via-PS.vcf"]:
         print("Testing", filename)
@@ -1,6 +1,8 @@
 import sys
+import json
 import resource
 import logging
+from typing import Dict, Optional
 
 from whatshap.bam import (
     AlignmentFileNotIndexedError,
@@ -9,7 +11,12 @@ from whatshap.bam import (
     ReferenceNotFoundError,
 )
 from whatshap.variants import ReadSetReader, ReadSetError
-from whatshap.utils import IndexedFasta, FastaNotIndexedError, detect_file_format
+from whatshap.utils import (
+    IndexedFasta,
+    FastaNotIndexedError,
+    detect_file_format,
+    reference_sequence,
+)
 from whatshap.core import ReadSet
 from whatshap.vcf import VcfReader
 
@@ -84,6 +91,25 @@ class PhasedInputReader:
         """Whether any of the input files are BAM or CRAM"""
         return bool(self._bam_paths)
 
+    @property
+    def realignment_cache_stats(self) -> Dict[str, int]:
+        """Cache statistics of detecting alleles by realignment (see ReadSetReader)"""
+        return self._readset_reader.realignment_cache_stats
+
+    def longest_template_span(self, chromosome, positions) -> int:
+        """
+        Return the longest reference span of a read or read pair overlapping one of the
+        given positions (see ReadSetReader.longest_template_span)
+        """
+        if not self._bam_paths:
+            return 0
+        try:
+            return self._readset_reader.longest_template_span(chromosome, positions)
+        except ReferenceNotFoundError:
+            raise CommandLineError(
+                "The chromosome {!r} was not found in the BAM/CRAM file.".format(chromosome)
+            )
+
     @staticmethod
     def _split_input_file_list(paths):
         bams = []
@@ -141,7 +167,7 @@ class PhasedInputReader:
             chromosome,
         )
         try:
-            reference = self._fasta[chromosome] if self._fasta else None
+            reference = reference_sequence(self._fasta, chromosome) if self._fasta else None
         except KeyError:
             raise CommandLineError(
                 "Chromosome {!r} present in VCF file, but not in the reference FASTA {!r}".format(
@@ -205,3 +231,23 @@ def log_memory_usage(include_children=False):
         else:
             memory_kb = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
         logger.info("Maximum memory usage: %.3f GB", memory_kb / 1e6)
+
+
+def log_realignment_cache_stats(stats: Optional[Dict[str, int]]):
+    if stats and stats["hits"] + stats["misses"] > 0:
+        logger.debug(
+            "Realignments: %(misses)d computed, %(hits)d taken from the cache of earlier reads",
+            stats,
+        )
+
+
+def write_timers_json(path: str, timers, core_counters: Dict[str, int]):
+    """
+    Write the time spent in each stage (seconds, from a StageTimer), the total time and
+    the counters of the core algorithms (see whatshap.core.get_instrumentation) to a
+    JSON file
+    """
+    data = dict(total=timers.total(), stages=timers.elapsed_times(), core=core_counters)
+    with open(path, "w") as f:
+        json.dump(data, f, indent=2, sort_keys=True)
+        print(file=f)
@@ -0,0 +1,271 @@
+"""
+Run phase, genotype, polyphase and haplotag on test data and report run times
+
+Each command is run in a separate process on a bundled dataset (by default from
+tests/data). The time spent in each stage, the counters of the core algorithms and
+the peak memory usage are collected into a single JSON report, which can be compared
+against a baseline report written earlier. The exit status is 1 if any time or
+memory usage exceeds the baseline by more than the given tolerance.
+"""
+import json
+import logging
+import os
+import platform
+import subprocess
+import sys
+import time
+from tempfile import TemporaryDirectory
+from typing import Callable, Dict, List, Optional
+
+from whatshap import __version__
+from whatshap.cli import CommandLineError
+
+logger = logging.getLogger(__name__)
+
+
+def phase_arguments(data_dir: str, output_dir: str) -> List[str]:
+    pacbio = os.path.join(data_dir, "pacbio")
+    return [
+        "--reference",
+        os.path.join(pacbio, "reference.fasta"),
+        "-o",
+        os.path.join(output_dir, "phased.vcf"),
+        os.path.join(pacbio, "variants.vcf"),
+        os.path.join(pacbio, "pacbio.bam"),
+    ]
+
+
+def genotype_arguments(data_dir: str, output_dir: str) -> List[str]:
+    pacbio = os.path.join(data_dir, "pacbio")
+    return [
+        "--reference",
+        os.path.join(pacbio, "reference.fasta"),
+        "-o",
+        os.path.join(output_dir, "genotyped.vcf"),
+        os.path.join(pacbio, "variants.vcf"),
+        os.path.join(pacbio, "pacbio.bam"),
+    ]
+
+
+def polyphase_arguments(data_dir: str, output_dir: str) -> List[str]:
+    return [
+        "--ploidy",
+        "4",
+        "--ignore-read-groups",
+        "-o",
+        os.path.join(output_dir, "polyphased.vcf"),
+        os.path.join(data_dir, "polyploid.chr22.42M.12k.vcf"),
+        os.path.join(data_dir, "polyploid.chr22.42M.12k.bam"),
+    ]
+
+
+def haplotag_arguments(data_dir: str, output_dir: str) -> List[str]:
+    pacbio = os.path.join(data_dir, "pacbio")
+    return [
+        "--reference",
+        os.path.join(pacbio, "reference.fasta"),
+        "-o",
+        os.path.join(output_dir, "haplotagged.bam"),
+        os.path.join(pacbio, "phased.vcf.gz"),
+        os.path.join(pacbio, "pacbio.bam"),
+    ]
+
+
+# Command-line arguments (except --timers-json) of each benchmarked command, given the data
+# directory and a directory for output files
+COMMANDS: Dict[str, Callable[[str, str], List[str]]] = {
+    "phase": phase_arguments,
+    "genotype": genotype_arguments,
+    "polyphase": polyphase_arguments,
+    "haplotag": haplotag_arguments,
+}
+
+
+# fmt: off
+def add_arguments(parser):
+    arg = parser.add_argument
+    arg("-o", "--output", default=None,
+        help="Write the JSON report to this file (default: standard output)")
+    arg("--baseline", metavar="JSON", default=None,
+        help="Compare against this report written by an earlier run")
+    arg("--tolerance", metavar="FRACTION", type=float, default=0.2,
+        help="Fraction by which times and memory usage may exceed the baseline "
+        "(default: %(default)s)")
+    arg("--min-seconds", metavar="SECONDS", type=float, default=0.1,
+        help="Ignore differences in time smaller than this (default: %(default)s)")
+    arg("--repetitions", metavar="N", type=int, default=3,
+        help="Run each command N times and report the fastest run (default: %(default)s)")
+    arg("--commands", metavar="LIST", default=",".join(COMMANDS),
+        help="Comma-separated list of commands to run (default: %(default)s)")
+    arg("--data-dir", metavar="DIR", default=os.path.join("tests", "data"),
+        help="Directory with the test data (default: %(default)s)")
+# fmt: on
+
+
+def validate(args, parser):
+    if args.repetitions < 1:
+        parser.error("--repetitions must be at least 1")
+    if args.tolerance < 0:
+        parser.error("--tolerance must not be negative")
+    for command in args.commands.split(","):
+        if command not in COMMANDS:
+            parser.error(
+                "Unknown command {!r} (choose from {})".format(command, ", ".join(COMMANDS))
+            )
+
+
+def run_command(command: str, data_dir: str) -> Dict:
+    """
+    Run a whatshap command once in a separate process and return its wall-clock time,
+    peak memory usage (including worker processes) and the stages and core counters
+    it reported with --timers-json
+    """
+    with TemporaryDirectory(prefix="whatshap-benchmark-") as output_dir:
+        timers_path = os.path.join(output_dir, "timers.json")
+        argv = [sys.executable, "-m", "whatshap", command, "--timers-json", timers_path]
+        argv += COMMANDS[command](data_dir, output_dir)
+        logger.debug("Running %s", " ".join(argv))
+        start = time.time()
+        process = subprocess.Popen(argv, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+        stderr = process.stderr.read()
+        # wait4 (instead of process.wait) also returns the resource usage of the process
+        _, status, usage = os.wait4(process.pid, 0)
+        wall_seconds = time.time() - start
+        process.stderr.close()
+        process.returncode = os.WEXITSTATUS(status) if os.WIFEXITED(status) else -1
+        if process.returncode != 0:
+            raise CommandLineError(
+                "whatshap {} failed:\n{}".format(command, stderr.decode(errors="replace"))
+            )
+        with open(timers_path) as f:
+            timers = json.load(f)
+    # ru_maxrss is in kilobytes on Linux, but in bytes on macOS
+    max_rss = usage.ru_maxrss if sys.platform == "darwin" else usage.ru_maxrss * 1024
+    return dict(
+        wall_seconds=wall_seconds,
+        total_seconds=timers["total"],
+        stages=timers["stages"],
+        core=timers["core"],
+        max_rss_bytes=max_rss,
+    )
+
+
+def merge_runs(runs: List[Dict]) -> Dict:
+    """Combine repeated runs of a command: the fastest run, and the largest memory usage"""
+    fastest = min(runs, key=lambda run: run["wall_seconds"])
+    result = dict(fastest)
+    result["stages"] = {
+        stage: min(run["stages"].get(stage, 0.0) for run in runs) for stage in fastest["stages"]
+    }
+    result["max_rss_bytes"] = max(run["max_rss_bytes"] for run in runs)
+    result["repetitions"] = len(runs)
+    return result
+
+
+def compare_reports(report: Dict, baseline: Dict, tolerance: float, min_seconds: float):
+    """
+    Return a list of (command, measure, baseline value, new value, regression) tuples for
+    all times and memory usages that occur in both reports. regression is True if the
+    new value exceeds the baseline value by more than the given fraction (and, for times,
+    also by more than min_seconds).
+    """
+    comparisons = []
+    for command, run in report["commands"].items():
+        if command not in baseline.get("commands", {}):
+            continue
+        old = baseline["commands"][command]
+        measures = [("wall_seconds", old["wall_seconds"], run["wall_seconds"])]
+        for stage, seconds in sorted(run["stages"].items()):
+            if stage in old["stages"]:
+                measures.append(("stages." + stage, old["stages"][stage], seconds))
+        for measure, old_value, new_value in measures:
+            regression = (
+                new_value > old_value * (1 + tolerance) and new_value - old_value > min_seconds
+            )
+            comparisons.append((command, measure, old_value, new_value, regression))
+        old_memory, new_memory = old["max_rss_bytes"], run["max_rss_bytes"]
+        regression = new_memory > old_memory * (1 + tolerance)
+        comparisons.append((command, "max_rss_bytes", old_memory, new_memory, regression))
+    return comparisons
+
+
+def run_benchmark(
+    commands: List[str],
+    data_dir: str = os.path.join("tests", "data"),
+    repetitions: int = 3,
+    output: Optional[str] = None,
+    baseline: Optional[str] = None,
+    tolerance: float = 0.2,
+    min_seconds: float = 0.1,
+) -> bool:
+    """
+    Run the given commands and write the report to output (standard output if None).
+    Return whether no regression against the baseline (if given) was found.
+    """
+    report: Dict = dict(
+        whatshap_version=__version__,
+        python_version=platform.python_version(),
+        machine=platform.machine(),
+        date=time.strftime("%Y-%m-%dT%H:%M:%S"),
+        commands={},
+    )
+    for command in commands:
+        logger.info("Running whatshap %s %d time(s) ...", command, repetitions)
+        runs = [run_command(command, data_dir) for _ in range(repetitions)]
+        report["commands"][command] = merge_runs(runs)
+        logger.info(
+            "... %.2f s, maximum memory usage %.3f GB",
+            report["commands"][command]["wall_seconds"],
+            report["commands"][command]["max_rss_bytes"] / 1e9,
+        )
+
+    success = True
+    if baseline is not None:
+        with open(baseline) as f:
+            baseline_report = json.load(f)
+        comparisons = compare_reports(report, baseline_report, tolerance, min_seconds)
+        report["baseline"] = dict(
+            path=str(baseline),
+            whatshap_version=baseline_report.get("whatshap_version"),
+            regressions=[
+                dict(command=command, measure=measure, baseline=old, value=new)
+                for command, measure, old, new, regression in comparisons
+                if regression
+            ],
+        )
+        logger.info("Comparison against baseline %s:", baseline)
+        for command, measure, old, new, regression in comparisons:
+            logger.info(
+                "%-10s %-30s %14.6g %14.6g %+8.1f%%%s",
+                command,
+                measure,
+                old,
+                new,
+                100 * (new - old) / old if old else 0.0,
+                "  REGRESSION" if regression else "",
+            )
+        success = not report["baseline"]["regressions"]
+
+    if output is None:
+        json.dump(report, sys.stdout, indent=2, sort_keys=True)
+        print()
+    else:
+        with open(output, "w") as f:
+            json.dump(report, f, indent=2, sort_keys=True)
+            print(file=f)
+    return success
+
+
+def main(args):
+    success = run_benchmark(
+        commands=args.commands.split(","),
+        data_dir=args.data_dir,
+        repetitions=args.repetitions,
+        output=args.output,
+        baseline=args.baseline,
+        tolerance=args.tolerance,
+        min_seconds=args.min_seconds,
+    )
+    if not success:
+        logger.error("Performance regressions found (see above)")
+        sys.exit(1)
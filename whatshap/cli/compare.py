@@ -1,16 +1,19 @@
 """
 Compare two or more phased variant files
 """
+import io
 import logging
 import math
+import sys
 from collections import defaultdict
-from contextlib import ExitStack
+from contextlib import ExitStack, redirect_stdout
 import dataclasses
 from itertools import chain, permutations
-from typing import Set, List, Optional, DefaultDict, Dict
+from multiprocessing import Pool
+from typing import Set, List, Optional, DefaultDict, Dict, Iterator, Tuple
 
 from whatshap.vcf import VcfReader, VcfVariant, VariantTable, PloidyError
-from whatshap.core import Genotype, SwitchFlipCalculator
+from whatshap.core import Genotype, SwitchFlipCalculator, compare_diploid_blocks
 from whatshap.cli import CommandLineError
 
 
@@ -42,6 +45,9 @@ def add_arguments(parser):
     add('--longest-block-tsv', default=None, help='Write position-wise agreement of longest '
         'joint blocks in each chromosome to tab-separated file. Only for diploid VCFs.')
     add('--ploidy', '-p', metavar='PLOIDY', type=int, default=2, help='The ploidy of the sample(s) (default: %(default)s).')
+    add('--threads', '-t', metavar='N', type=int, default=1, help='Number of threads to use. '
+        'Chromosomes are compared in parallel worker processes, and the blocks of polyploid '
+        'phasings are compared concurrently (default: %(default)s).')
     # TODO: what's the best way to request "two or more" VCFs?
     add('vcf', nargs='+', metavar='VCF/BCF', help='At least two phased variant files (VCF or BCF) to be compared.')
 # fmt: on
@@ -52,6 +58,8 @@ def validate(args, parser):
         parser.error("At least two VCFs need to be given.")
     if args.ploidy < 2:
         parser.error("Ploidy must be > 1.")
+    if args.threads < 1:
+        parser.error("Number of threads must be at least 1.")
     if args.ploidy > 2 and args.tsv_multiway:
         parser.error("Option --tsv-multiway can only be used if ploidy=2.")
     if args.ploidy > 2 and args.switch_error_bed:
@@ -277,36 +285,104 @@ def poly_num_switches(perm0, perm1):
 
 def compare_block(phasing0, phasing1):
     """Input are two lists of haplotype sequences over {0,1}."""
-    assert len(phasing0) == len(phasing1)
-    ploidy = len(phasing0)
+    return compare_blocks([(phasing0, phasing1)])[0]
 
-    minimum_hamming_distance = float("inf")
-    # compute minimum hamming distance
-    for permutation in permutations(phasing0):
-        # compute sum of hamming distances
-        total_hamming = 0
-        for i in range(ploidy):
-            total_hamming += hamming(phasing1[i], permutation[i])
-        total_hamming /= float(ploidy)
-        minimum_hamming_distance = min(minimum_hamming_distance, total_hamming)
-
-    matching_pos = compute_matching_genotype_pos(phasing0, phasing1)
-
-    if ploidy == 2:
-        # conversion to int is allowed, as there should be no fractional error counts for diploid comparisons
-        switches = int(hamming(switch_encoding(phasing0[0]), switch_encoding(phasing1[0])))
-        switch_flips = compute_switch_flips(phasing0[0], phasing1[0])
-        minimum_hamming_distance = int(minimum_hamming_distance)
-    else:
-        switches = compute_switch_errors_poly(phasing0, phasing1, matching_pos)
-        switch_flips = compute_switch_flips_poly(phasing0, phasing1)
-
-    return PhasingErrors(
-        switches=switches,
-        hamming=minimum_hamming_distance,
-        switch_flips=switch_flips,
-        diff_genotypes=len(phasing0[0]) - len(matching_pos),
-    )
+
+def compare_blocks(block_phasings, threads=1) -> List[PhasingErrors]:
+    """
+    Input is a list of blocks, each given as a pair of lists of haplotype sequences over {0,1}.
+    All blocks must have the same ploidy. Diploid blocks are compared natively. For polyploid
+    blocks, the switch errors and switch flips of all blocks are computed at once, using the given
+    number of threads.
+    """
+    if block_phasings and len(block_phasings[0][0]) == 2:
+        assert all(len(phasing0) == len(phasing1) == 2 for phasing0, phasing1 in block_phasings)
+        results = compare_diploid_blocks(
+            [tuple(phasing0) for phasing0, _ in block_phasings],
+            [tuple(phasing1) for _, phasing1 in block_phasings],
+        )
+        return [
+            PhasingErrors(
+                switches=switches,
+                hamming=hamming,
+                switch_flips=SwitchFlips(flip_switches, flips),
+                diff_genotypes=diff_genotypes,
+            )
+            for switches, flip_switches, flips, hamming, diff_genotypes in results
+        ]
+
+    block_errors = []
+    poly_blocks = []
+    for phasing0, phasing1 in block_phasings:
+        assert len(phasing0) == len(phasing1)
+        ploidy = len(phasing0)
+
+        minimum_hamming_distance = float("inf")
+        # compute minimum hamming distance
+        for permutation in permutations(phasing0):
+            # compute sum of hamming distances
+            total_hamming = 0
+            for i in range(ploidy):
+                total_hamming += hamming(phasing1[i], permutation[i])
+            total_hamming /= float(ploidy)
+            minimum_hamming_distance = min(minimum_hamming_distance, total_hamming)
+
+        matching_pos = compute_matching_genotype_pos(phasing0, phasing1)
+
+        errors = PhasingErrors(
+            hamming=minimum_hamming_distance, diff_genotypes=len(phasing0[0]) - len(matching_pos)
+        )
+        poly_blocks.append((errors, phasing0, phasing1, matching_pos))
+        block_errors.append(errors)
+
+    if poly_blocks:
+        compute_poly_block_errors(poly_blocks, threads)
+    return block_errors
+
+
+def compute_poly_block_errors(poly_blocks, threads):
+    """
+    Computes the switch errors (see compute_switch_errors_poly) and the switch flips (see
+    compute_switch_flips_poly) of polyploid blocks, given as tuples of a PhasingErrors object to
+    fill, both phasings and the positions with matching genotypes.
+    """
+    ploidy = len(poly_blocks[0][1])
+    assert all(len(phasing0) == ploidy for _, phasing0, _, _ in poly_blocks)
+    if ploidy > 6:
+        logger.warning(
+            "Computing vector error with more than 6 haplotypes. This may take very long ..."
+        )
+
+    # Switch errors: restrict to matching genotypes and forbid flips by a prohibitive flip cost. The
+    # cost only has to exceed the switch costs of every flip-free solution, so the cost for the
+    # longest block is sufficient for all blocks.
+    max_vars = max(len(phasing0[0]) for _, phasing0, _, _ in poly_blocks)
+    matched_blocks = []
+    for errors, phasing0, phasing1, matching_pos in poly_blocks:
+        if matching_pos:
+            phasing0_matched = ["".join([hap[i] for i in matching_pos]) for hap in phasing0]
+            phasing1_matched = ["".join([hap[i] for i in matching_pos]) for hap in phasing1]
+            matched_blocks.append((errors, phasing0_matched, phasing1_matched))
+    if matched_blocks:
+        calc = SwitchFlipCalculator(ploidy, 1, 2 * max_vars * ploidy + 1, threads)
+        results = calc.compare_blocks(
+            [phasing0 for _, phasing0, _ in matched_blocks],
+            [phasing1 for _, _, phasing1 in matched_blocks],
+        )
+        for (errors, _, _), (switches, flips) in zip(matched_blocks, results):
+            assert flips == 0
+            errors.switches = switches / ploidy
+
+    # Switch flips
+    compared_blocks = [block for block in poly_blocks if len(block[1][0]) > 0]
+    if compared_blocks:
+        calc = SwitchFlipCalculator(ploidy, 1, 1, threads)
+        results = calc.compare_blocks(
+            [phasing0 for _, phasing0, _, _ in compared_blocks],
+            [phasing1 for _, _, phasing1, _ in compared_blocks],
+        )
+        for (errors, _, _, _), (switches, flips) in zip(compared_blocks, results):
+            errors.switch_flips = SwitchFlips(switches / ploidy, flips / ploidy)
 
 
 def fraction2percentstr(nominator, denominator):
@@ -427,6 +503,7 @@ def compare(
     sample_names: List[str],
     dataset_names: List[str],
     ploidy: int,
+    threads: int = 1,
 ):
     """
     Return a PairwiseComparisonResults object if the variant_tables has a length of 2.
@@ -495,6 +572,7 @@ def compare(
             ploidy,
             sorted_variants,
             BedCreator(variant_tables[0].chromosome, dataset_names),
+            threads,
         )
 
         return (
@@ -519,6 +597,7 @@ def compare_pair(
     ploidy,
     sorted_variants,
     bed_creator: Optional[BedCreator],
+    threads: int = 1,
 ):
     longest_block = 0
     longest_block_errors = PhasingErrors()
@@ -528,6 +607,8 @@ def compare_pair(
     bed_records = []
     total_errors = PhasingErrors()
     total_compared_variants = 0
+    blocks = []
+    block_phasings = []
     for block in block_intersection.values():
         if len(block) < 2:
             continue
@@ -538,8 +619,13 @@ def compare_pair(
             p1 = "".join(str(phases[1][i].phase[j]) for i in block)
             phasing0.append(p0)
             phasing1.append(p1)
+        blocks.append(block)
+        block_phasings.append((phasing0, phasing1))
+
+    # all blocks are compared at once, so that polyploid blocks can be processed concurrently
+    block_errors = compare_blocks(block_phasings, threads)
+    for block, (phasing0, phasing1), errors in zip(blocks, block_phasings, block_errors):
         block_positions = [sorted_variants[i].position for i in block]
-        errors = compare_block(phasing0, phasing1)
 
         # TODO: extend to polyploid
         if ploidy == 2 and bed_creator is not None:
@@ -747,6 +833,211 @@ def create_blocksize_histogram(filename, block_stats, names, use_weights=False):
             pyplot.close()
 
 
+@dataclasses.dataclass
+class ChromosomeComparison:
+    """Output of comparing the phasings of a single chromosome (except for the report)"""
+
+    pairwise_rows: List[List]
+    longest_block_rows: List[List]
+    bed_records: List[Tuple]
+    multiway_rows: List[List]
+    # block statistics of each comparison to be included in the block size histograms
+    block_stats: List[List[List[BlockStats]]]
+
+
+def compare_chromosome(
+    chromosome: str,
+    variant_tables: List[VariantTable],
+    vcf: List[str],
+    dataset_names: List[str],
+    sample_names: List[str],
+    ploidy: int,
+    ignore_sample_name: bool,
+    only_snvs: bool,
+    threads: int = 1,
+) -> ChromosomeComparison:
+    """
+    Compare the phasings of a single chromosome, given as one variant table per VCF, and print
+    the report to stdout. The rows of the output files are returned.
+    """
+    result = ChromosomeComparison([], [], [], [], [])
+    width = max(max(len(n) for n in dataset_names), 15) + 5
+    print("---------------- Chromosome {} ----------------".format(chromosome))
+    all_variants_union = set()
+    all_variants_intersection = None
+    het_variants_union = set()
+    het_variants_intersection = None
+    het_variants0 = None
+    print("VARIANT COUNTS (heterozygous / all): ")
+    for variant_table, name, sample in zip(variant_tables, dataset_names, sample_names):
+        all_variants_union.update(variant_table.variants)
+        het_variants = [
+            v
+            for v, gt in zip(variant_table.variants, variant_table.genotypes_of(sample))
+            if not gt.is_homozygous()
+        ]
+        if het_variants0 is None:
+            het_variants0 = len(het_variants)
+        het_variants_union.update(het_variants)
+        if all_variants_intersection is None:
+            all_variants_intersection = set(variant_table.variants)
+            het_variants_intersection = set(het_variants)
+        else:
+            all_variants_intersection.intersection_update(variant_table.variants)
+            het_variants_intersection.intersection_update(het_variants)
+        print(
+            "{}:".format(name).rjust(width),
+            str(len(het_variants)).rjust(COUNT_WIDTH),
+            "/",
+            str(len(variant_table.variants)).rjust(COUNT_WIDTH),
+        )
+    print(
+        "UNION:".rjust(width),
+        str(len(het_variants_union)).rjust(COUNT_WIDTH),
+        "/",
+        str(len(all_variants_union)).rjust(COUNT_WIDTH),
+    )
+    print(
+        "INTERSECTION:".rjust(width),
+        str(len(het_variants_intersection)).rjust(COUNT_WIDTH),
+        "/",
+        str(len(all_variants_intersection)).rjust(COUNT_WIDTH),
+    )
+
+    for i in range(len(variant_tables)):
+        for j in range(i + 1, len(variant_tables)):
+            print("PAIRWISE COMPARISON: {} <--> {}:".format(dataset_names[i], dataset_names[j]))
+            (
+                results,
+                bed_records,
+                block_stats,
+                longest_block_positions,
+                longest_block_agreement,
+                multiway_results,
+            ) = compare(
+                [variant_tables[i], variant_tables[j]],
+                [sample_names[i], sample_names[j]],
+                [dataset_names[i], dataset_names[j]],
+                ploidy,
+                threads,
+            )
+            if len(variant_tables) == 2:
+                result.block_stats.append(block_stats)
+            result.bed_records.extend(bed_records)
+            sample_name = (
+                f"{sample_names[i]}_{sample_names[j]}" if ignore_sample_name else sample_names[i]
+            )
+            fields = [sample_name, chromosome, dataset_names[i], dataset_names[j], vcf[i], vcf[j]]
+            fields.extend(dataclasses.astuple(results))
+            fields.extend([het_variants0, int(only_snvs)])
+            result.pairwise_rows.append(fields)
+            if ploidy == 2:
+                assert len(longest_block_positions) == len(longest_block_agreement)
+                for position, phase_agreeing in zip(
+                    longest_block_positions, longest_block_agreement
+                ):
+                    result.longest_block_rows.append(
+                        [
+                            dataset_names[i],
+                            dataset_names[j],
+                            sample_name,
+                            chromosome,
+                            position,
+                            phase_agreeing,
+                        ]
+                    )
+    result.bed_records.sort()
+
+    if len(variant_tables) > 2:
+        assert ploidy == 2
+        print("MULTIWAY COMPARISON OF ALL PHASINGS:")
+        (
+            results,
+            bed_records,
+            block_stats,
+            longest_block_positions,
+            longest_block_agreement,
+            multiway_results,
+        ) = compare(variant_tables, sample_names, dataset_names, ploidy)
+        result.block_stats.append(block_stats)
+        sample_name = "_".join(set(sample_names)) if ignore_sample_name else sample_names[0]
+        for ((dataset_list0, dataset_list1), count) in multiway_results.items():
+            result.multiway_rows.append(
+                [
+                    sample_name,
+                    chromosome,
+                    "{" + dataset_list0 + "}",
+                    "{" + dataset_list1 + "}",
+                    count,
+                ]
+            )
+    return result
+
+
+def compare_chromosomes(
+    chromosomes: List[str], vcfs: List[Dict[str, VariantTable]], options: Dict, threads: int
+) -> Iterator[ChromosomeComparison]:
+    """
+    Compare the phasings of all given chromosomes (see compare_chromosome) and yield the results
+    in the given order. With more than one thread, the chromosomes are compared in parallel
+    worker processes, starting with the largest ones. The report of each chromosome is printed
+    when it is its turn, so the output does not depend on the number of threads.
+    """
+    if threads == 1 or len(chromosomes) == 1:
+        for chromosome in chromosomes:
+            variant_tables = [vcf[chromosome] for vcf in vcfs]
+            yield compare_chromosome(chromosome, variant_tables, threads=threads, **options)
+        return
+
+    processes = min(threads, len(chromosomes))
+    # the remaining threads are used for comparing the blocks of polyploid phasings
+    block_threads = max(1, threads // processes)
+    units = sorted(
+        range(len(chromosomes)),
+        key=lambda index: -sum(len(vcf[chromosomes[index]]) for vcf in vcfs),
+    )
+    logger.info("Comparing %d chromosomes in %d worker processes", len(chromosomes), processes)
+    # for each chromosome, the report and the comparison if it has been finished
+    finished: Dict[int, Tuple[str, ChromosomeComparison]] = {}
+    next_chromosome = 0
+    work = (
+        (index, chromosomes[index], [vcf[chromosomes[index]] for vcf in vcfs]) for index in units
+    )
+    with Pool(
+        processes=processes,
+        initializer=_init_compare_worker,
+        initargs=(options, block_threads),
+    ) as pool:
+        for index, report, comparison in pool.imap_unordered(_compare_unit, work):
+            finished[index] = (report, comparison)
+            while next_chromosome in finished:
+                report, comparison = finished.pop(next_chromosome)
+                sys.stdout.write(report)
+                yield comparison
+                next_chromosome += 1
+    assert next_chromosome == len(chromosomes)
+
+
+_compare_worker_state: Optional[Tuple[Dict, int]] = None
+
+
+def _init_compare_worker(options, block_threads):
+    global _compare_worker_state
+    _compare_worker_state = (options, block_threads)
+
+
+def _compare_unit(unit):
+    index, chromosome, variant_tables = unit
+    assert _compare_worker_state is not None
+    options, block_threads = _compare_worker_state
+    report = io.StringIO()
+    with redirect_stdout(report):
+        comparison = compare_chromosome(
+            chromosome, variant_tables, threads=block_threads, **options
+        )
+    return index, report.getvalue(), comparison
+
+
 def run_compare(
     vcf,
     ploidy,
@@ -760,6 +1051,7 @@ def run_compare(
     plot_blocksizes=None,
     plot_sum_of_blocksizes=None,
     longest_block_tsv=None,
+    threads=1,
 ):
     vcf_readers = [VcfReader(f, indels=not only_snvs, phases=True, ploidy=ploidy) for f in vcf]
     if names:
@@ -842,8 +1134,6 @@ def run_compare(
         for name, filename in zip(dataset_names, vcf):
             print(name.rjust(longest_name + 2), "=", filename)
 
-        width = max(longest_name, 15) + 5
-
         all_block_stats = [[] for _ in vcfs]
 
         def add_block_stats(block_stats):
@@ -851,143 +1141,34 @@ def run_compare(
             for big_list, new_list in zip(all_block_stats, block_stats):
                 big_list.extend(new_list)
 
-        for chromosome in sorted(chromosomes):
-            print("---------------- Chromosome {} ----------------".format(chromosome))
-            all_bed_records = []
-            variant_tables = [vcf[chromosome] for vcf in vcfs]
-            all_variants_union = set()
-            all_variants_intersection = None
-            het_variants_union = set()
-            het_variants_intersection = None
-            het_variant_sets = []
-            het_variants0 = None
-            print("VARIANT COUNTS (heterozygous / all): ")
-            for variant_table, name, sample in zip(variant_tables, dataset_names, sample_names):
-                all_variants_union.update(variant_table.variants)
-                het_variants = [
-                    v
-                    for v, gt in zip(variant_table.variants, variant_table.genotypes_of(sample))
-                    if not gt.is_homozygous()
-                ]
-                if het_variants0 is None:
-                    het_variants0 = len(het_variants)
-                het_variants_union.update(het_variants)
-                if all_variants_intersection is None:
-                    all_variants_intersection = set(variant_table.variants)
-                    het_variants_intersection = set(het_variants)
-                else:
-                    all_variants_intersection.intersection_update(variant_table.variants)
-                    het_variants_intersection.intersection_update(het_variants)
-                het_variant_sets.append(set(het_variants))
-                print(
-                    "{}:".format(name).rjust(width),
-                    str(len(het_variants)).rjust(COUNT_WIDTH),
-                    "/",
-                    str(len(variant_table.variants)).rjust(COUNT_WIDTH),
-                )
-            print(
-                "UNION:".rjust(width),
-                str(len(het_variants_union)).rjust(COUNT_WIDTH),
-                "/",
-                str(len(all_variants_union)).rjust(COUNT_WIDTH),
-            )
-            print(
-                "INTERSECTION:".rjust(width),
-                str(len(het_variants_intersection)).rjust(COUNT_WIDTH),
-                "/",
-                str(len(all_variants_intersection)).rjust(COUNT_WIDTH),
-            )
-
-            for i in range(len(vcfs)):
-                for j in range(i + 1, len(vcfs)):
-                    print(
-                        "PAIRWISE COMPARISON: {} <--> {}:".format(
-                            dataset_names[i], dataset_names[j]
-                        )
-                    )
-                    (
-                        results,
-                        bed_records,
-                        block_stats,
-                        longest_block_positions,
-                        longest_block_agreement,
-                        multiway_results,
-                    ) = compare(
-                        [variant_tables[i], variant_tables[j]],
-                        [sample_names[i], sample_names[j]],
-                        [dataset_names[i], dataset_names[j]],
-                        ploidy,
-                    )
-                    if len(vcfs) == 2:
-                        add_block_stats(block_stats)
-                    all_bed_records.extend(bed_records)
-                    sample_name = (
-                        f"{sample_names[i]}_{sample_names[j]}"
-                        if ignore_sample_name
-                        else sample_names[i]
-                    )
-                    if tsv_pairwise_file:
-                        fields = [
-                            sample_name,
-                            chromosome,
-                            dataset_names[i],
-                            dataset_names[j],
-                            vcf[i],
-                            vcf[j],
-                        ]
-                        fields.extend(dataclasses.astuple(results))
-                        fields.extend([het_variants0, int(only_snvs)])
-                        print(*fields, sep="\t", file=tsv_pairwise_file)
-                    if longest_block_tsv_file:
-                        assert ploidy == 2
-                        assert len(longest_block_positions) == len(longest_block_agreement)
-                        for position, phase_agreeing in zip(
-                            longest_block_positions, longest_block_agreement
-                        ):
-                            print(
-                                dataset_names[i],
-                                dataset_names[j],
-                                sample_name,
-                                chromosome,
-                                position,
-                                phase_agreeing,
-                                sep="\t",
-                                file=longest_block_tsv_file,
-                            )
+        options = dict(
+            vcf=vcf,
+            dataset_names=dataset_names,
+            sample_names=sample_names,
+            ploidy=ploidy,
+            ignore_sample_name=ignore_sample_name,
+            only_snvs=only_snvs,
+        )
+        for comparison in compare_chromosomes(sorted(chromosomes), vcfs, options, threads):
+            if tsv_pairwise_file:
+                for fields in comparison.pairwise_rows:
+                    print(*fields, sep="\t", file=tsv_pairwise_file)
+            if longest_block_tsv_file:
+                assert ploidy == 2
+                for fields in comparison.longest_block_rows:
+                    print(*fields, sep="\t", file=longest_block_tsv_file)
 
             # if requested, write all switch errors found in the current chromosome to the bed file
             if switch_error_bedfile:
                 assert ploidy == 2
-                all_bed_records.sort()
-                for record in all_bed_records:
+                for record in comparison.bed_records:
                     print(*record, sep="\t", file=switch_error_bedfile)
 
-            if len(vcfs) > 2:
-                assert ploidy == 2
-                print("MULTIWAY COMPARISON OF ALL PHASINGS:")
-                (
-                    results,
-                    bed_records,
-                    block_stats,
-                    longest_block_positions,
-                    longest_block_agreement,
-                    multiway_results,
-                ) = compare(variant_tables, sample_names, dataset_names, ploidy)
+            if tsv_multiway_file:
+                for fields in comparison.multiway_rows:
+                    print(*fields, sep="\t", file=tsv_multiway_file)
+            for block_stats in comparison.block_stats:
                 add_block_stats(block_stats)
-                if tsv_multiway_file:
-                    sample_name = (
-                        "_".join(set(sample_names)) if ignore_sample_name else sample_names[0]
-                    )
-                    for ((dataset_list0, dataset_list1), count) in multiway_results.items():
-                        print(
-                            sample_name,
-                            chromosome,
-                            "{" + dataset_list0 + "}",
-                            "{" + dataset_list1 + "}",
-                            count,
-                            sep="\t",
-                            file=tsv_multiway_file,
-                        )
 
         if plot_blocksizes:
             create_blocksize_histogram(plot_blocksizes, all_block_stats, dataset_names)
@@ -4,11 +4,13 @@ Generate candidate SNP positions.
 
 import pysam
 import sys
-import re
 import pyfaidx
-from collections import defaultdict
 import datetime
 import logging
+from multiprocessing import Pool
+from typing import List, Optional, Tuple
+
+from whatshap.core import PileupCounter
 
 logger = logging.getLogger(__name__)
 
@@ -39,6 +41,9 @@ def add_arguments(parser):
     group.add_argument(
         '--illumina', dest='datatype', action='store_const', const='illumina',
         help='Input is Illumina. Sets minrel=0.25 and minabs=3.')
+    add('--threads', '-t', metavar='N', type=int, default=1,
+        help='Number of worker processes used to count bases in regions of the genome in '
+        'parallel. Results do not depend on this setting (default: %(default)s)')
 # fmt: on
 
 
@@ -56,6 +61,7 @@ def run_find_snv_candidates(
     sample="sample",
     chromosome=None,
     output=sys.stdout,
+    threads=1,
 ):
     outfile = output
     if output != sys.stdout:
@@ -80,79 +86,127 @@ def run_find_snv_candidates(
         header_columns += ["FORMAT", sample]
     print(*header_columns, sep="\t", file=outfile)
 
-    re_nucleotide = re.compile("[ACGTNacgtn]")
-    re_indel = re.compile("[-\\+]([0-9]+)")
-    re_ref = re.compile("[,\\.]")
-    re_ignore = re.compile("([\\$\\*]|\\^.)")
+    with pysam.AlignmentFile(bam, "rb") as bamfile:
+        tiles = genome_tiles(bamfile, fasta, chromosome)
+    counting_args = (bam, ref, minabs, minrel, multi_allelics)
+    if threads > 1 and len(tiles) > 1:
+        with Pool(threads, initializer=_init_counting_worker, initargs=counting_args) as pool:
+            # imap keeps the order of the tiles
+            for candidates in pool.imap(_count_tile, tiles):
+                write_candidates(candidates, sample, outfile)
+    else:
+        with pysam.AlignmentFile(bam, "rb") as bamfile:
+            for chromosome, start, end in tiles:
+                candidates = count_tile(
+                    bamfile, fasta, chromosome, start, end, minabs, minrel, multi_allelics
+                )
+                write_candidates(candidates, sample, outfile)
+    if output != sys.stdout:
+        outfile.close()
+
+
+# Length of the regions into which chromosomes are split for counting bases
+TILE_LENGTH = 1_000_000
+
+# Alignments that are unmapped, secondary, QC-failed or duplicates are ignored (as by
+# pysam's pileup)
+SKIP_FLAGS = 0x4 | 0x100 | 0x200 | 0x400
+MIN_MAPPING_QUALITY = 20
+MIN_BASE_QUALITY = 5
 
-    bamfile = pysam.AlignmentFile(bam, "rb")
-    for pileupcolumn in bamfile.pileup(
-        contig=chromosome, min_mapping_quality=20, min_base_quality=5
+
+def genome_tiles(bamfile, fasta, chromosome=None) -> List[Tuple[str, int, int]]:
+    """
+    Split the chromosomes of the alignment file (or only the given one) into tiles of at
+    most TILE_LENGTH bases. Return a list of (chromosome, start, end) tuples.
+    """
+    tiles = []
+    for name, length in zip(bamfile.references, bamfile.lengths):
+        if chromosome is not None and name != chromosome:
+            continue
+        if name not in fasta:
+            logger.warning("Skipping chromosome %r as it is not in the reference", name)
+            continue
+        for start in range(0, length, TILE_LENGTH):
+            tiles.append((name, start, min(start + TILE_LENGTH, length)))
+    return tiles
+
+
+def mate_start(alignment) -> int:
+    """
+    Return the reference start of the mate of an alignment if the mate can overlap it
+    (checked as in htslib), otherwise -1
+    """
+    if not alignment.is_paired or alignment.mate_is_unmapped:
+        return -1
+    if alignment.next_reference_id >= 0 and alignment.next_reference_id != alignment.reference_id:
+        return -1
+    if (
+        abs(alignment.template_length) >= 2 * alignment.query_length
+        and alignment.next_reference_start >= alignment.reference_end
     ):
-        try:
-            pileup = "".join(
-                pileupcolumn.get_query_sequences(mark_matches=True, mark_ends=True, add_indels=True)
-            )
-        except AssertionError:
-            # TODO: seems to happen when there are large insertions/deletions
+        return -1
+    return alignment.next_reference_start
+
+
+def count_tile(
+    bamfile, fasta, chromosome: str, start: int, end: int, minabs, minrel, multi_allelics
+) -> List[Tuple[str, int, str, List[str]]]:
+    """
+    Count the bases of the alignments in a tile and return the candidate SNVs as
+    (chromosome, position, reference base, alternative bases) tuples (positions are 0-based)
+    """
+    counter = PileupCounter(start, fasta[chromosome][start:end], MIN_BASE_QUALITY)
+    for alignment in bamfile.fetch(chromosome, start, end):
+        if alignment.flag & SKIP_FLAGS or alignment.mapping_quality < MIN_MAPPING_QUALITY:
             continue
-        position = pileupcolumn.reference_pos + 1
-        chromosome = pileupcolumn.reference_name
-        i = 0
-        bases = defaultdict(int)
-        n = 0
-        ref = fasta[chromosome][position - 1].upper()
-        if ref == "N":
+        # reads from pairs that are not properly paired are ignored (as by pysam's pileup)
+        if alignment.is_paired and not alignment.is_proper_pair:
             continue
-        while i < len(pileup):
-            m = re_nucleotide.match(pileup[i:])
-            if m is not None:
-                bases[pileup[i].upper()] += 1
-                n += 1
-                i += 1
-                continue
-            m = re_indel.match(pileup[i:])
-            if m is not None:
-                l = int(m.group(1))
-                skip = (m.end() - m.start()) + l
-                i += skip
-                continue
-            m = re_ref.match(pileup[i:])
-            if m is not None:
-                bases[ref] += 1
-                n += 1
-                i += 1
-                continue
-            m = re_ignore.match(pileup[i:])
-            if m is not None:
-                skip = m.end() - m.start()
-                i += skip
-                continue
-            assert False
-        ref_count = bases[ref]
-        alts = []
-        for base, count in bases.items():
-            if base == ref:
-                continue
-            if (count >= minabs) and (count / (count + ref_count) >= minrel):
-                alts.append((count, base))
-        alts.sort(reverse=True)
-        if len(alts) > 0:
-            columns = [chromosome, position, ".", ref, ".", ".", "PASS", "."]
-            if sample is not None:
-                columns += ["GT", "."]
-            if multi_allelics:
-                columns[4] = ",".join(base for count, base in alts)
-            else:
-                # Do we have two equally supported ALT alleles
-                if len(alts) > 1 and (alts[0][0] == alts[1][0]):
-                    columns[4] = "N"
-                    continue
-                else:
-                    columns[4] = alts[0][1]
-            print(*columns, sep="\t", file=outfile)
-    if output != sys.stdout:
-        outfile.close()
+        qualities = alignment.query_qualities
+        counter.add(
+            alignment.query_name,
+            alignment.reference_start,
+            alignment.cigartuples,
+            alignment.query_sequence,
+            b"" if qualities is None else bytes(qualities),
+            mate_start(alignment),
+        )
+    return [
+        (chromosome, position, reference, alternatives)
+        for position, reference, alternatives in counter.candidates(minabs, minrel, multi_allelics)
+    ]
+
+
+def write_candidates(candidates, sample: Optional[str], outfile):
+    for chromosome, position, reference, alternatives in candidates:
+        columns = [chromosome, position + 1, ".", reference, ",".join(alternatives)]
+        columns += [".", "PASS", "."]
+        if sample is not None:
+            columns += ["GT", "."]
+        print(*columns, sep="\t", file=outfile)
+
+
+# State of a worker process used by run_find_snv_candidates
+_counting_worker_state = None
+
+
+def _init_counting_worker(bam, ref, minabs, minrel, multi_allelics):
+    global _counting_worker_state
+    # Each worker opens the input files itself as file handles cannot be shared
+    _counting_worker_state = (
+        pysam.AlignmentFile(bam, "rb"),
+        pyfaidx.Fasta(ref, as_raw=True),
+        minabs,
+        minrel,
+        multi_allelics,
+    )
+
+
+def _count_tile(tile):
+    bamfile, fasta, minabs, minrel, multi_allelics = _counting_worker_state
+    chromosome, start, end = tile
+    return count_tile(bamfile, fasta, chromosome, start, end, minabs, minrel, multi_allelics)
 
 
 def main(args):
@@ -7,7 +7,9 @@ forward backward algorithm.
 import logging
 import sys
 import platform
-from typing import Sequence
+from collections import deque
+from concurrent.futures import ThreadPoolExecutor
+from typing import Any, Deque, Dict, Sequence
 
 from contextlib import ExitStack
 from whatshap import __version__
@@ -18,8 +20,12 @@ from whatshap.core import (
     NumericSampleIds,
     PhredGenotypeLikelihoods,
     GenotypeDPTable,
-    compute_genotypes,
+    compute_genotypes_batch,
     Genotype,
+    get_column_arena_stats,
+    set_instrumentation_enabled,
+    reset_instrumentation,
+    get_instrumentation,
 )
 from whatshap.pedigree import (
     PedReader,
@@ -27,7 +33,7 @@ from whatshap.pedigree import (
     GeneticMapRecombinationCostComputer,
 )
 from whatshap.timer import StageTimer
-from whatshap.cli import log_memory_usage
+from whatshap.cli import log_memory_usage, log_realignment_cache_stats, write_timers_json
 from whatshap.cli.phase import select_reads, setup_families
 from whatshap.cli import CommandLineError, PhasedInputReader
 
@@ -66,6 +72,30 @@ def determine_genotype(likelihoods: Sequence[float], threshold_prob: float) -> f
         return int_to_diploid_biallelic_gt(-1)
 
 
+def store_genotypes(variant_table, var_to_pos, gt_prob, family, accessible_positions, future):
+    """
+    Wait for the GenotypeDPTable of a family to be computed, and store the genotypes and
+    genotype likelihoods of its samples in the variant table
+    """
+    forward_backward_table = future.result()
+    logger.debug("DP checkpoint policy: %s", forward_backward_table.get_checkpoint_policy())
+    for s in family:
+        likelihood_list = variant_table.genotype_likelihoods_of(s)
+        genotypes_list = variant_table.genotypes_of(s)
+
+        for pos in range(len(accessible_positions)):
+            likelihoods = forward_backward_table.get_genotype_likelihoods(s, pos)
+
+            # compute genotypes from likelihoods and store information
+            geno = determine_genotype(likelihoods, gt_prob)
+            assert isinstance(geno, Genotype)
+            genotypes_list[var_to_pos[accessible_positions[pos]]] = geno
+            likelihood_list[var_to_pos[accessible_positions[pos]]] = likelihoods
+
+        variant_table.set_genotypes_of(s, genotypes_list)
+        variant_table.set_genotype_likelihoods_of(s, likelihood_list)
+
+
 def run_genotype(
     phase_input_files,
     variant_file,
@@ -91,12 +121,29 @@ def run_genotype(
     mismatch=15,
     write_command_line_header=True,
     use_ped_samples=False,
+    dp_precision="longdouble",
+    dp_memory_limit=None,
+    threads=1,
+    timers_json=None,
+    read_cache=None,
 ):
     """
     For now: this function only runs the genotyping algorithm. Genotype likelihoods for
     all variants are computed using the forward backward algorithm
+
+    timers_json -- if given, name of a JSON file to which the time spent in each stage and the
+        counters and timers of the core algorithms are written
+    read_cache -- directory in which the reads (with detected alleles) of each chromosome are
+        cached, such that later runs on the same input can skip allele detection
     """
+    checkpoint_args: Dict[str, Any] = dict()
+    if dp_memory_limit is not None:
+        checkpoint_args = dict(checkpoint_policy="auto", memory_limit=dp_memory_limit * 1024 ** 2)
+
     timers = StageTimer()
+    if timers_json:
+        reset_instrumentation()
+        set_instrumentation_enabled(True)
     logger.info(
         "This is WhatsHap (genotyping) %s running under Python %s",
         __version__,
@@ -122,13 +169,17 @@ def run_genotype(
                 gap_start=gap_start,
                 gap_extend=gap_extend,
                 default_mismatch=mismatch,
+                threads=threads,
+                cache_dir=read_cache,
             )
         )
         show_phase_vcfs = phased_input_reader.has_vcfs
 
         # vcf writer for final genotype likelihoods
         vcf_writer = stack.enter_context(
-            GenotypeVcfWriter(command_line=command_line, in_path=variant_file, out_file=output)
+            GenotypeVcfWriter(
+                command_line=command_line, in_path=variant_file, out_file=output, threads=threads
+            )
         )
         # vcf writer for only the prior likelihoods (if output is desired)
         prior_vcf_writer = None
@@ -145,7 +196,11 @@ def run_genotype(
         # remove all likelihoods that may already be present
         vcf_reader = stack.enter_context(
             VcfReader(
-                variant_file, indels=indels, genotype_likelihoods=False, ignore_genotypes=True
+                variant_file,
+                indels=indels,
+                genotype_likelihoods=False,
+                ignore_genotypes=True,
+                threads=threads,
             )
         )
 
@@ -219,6 +274,7 @@ def run_genotype(
             positions = [v.position for v in variant_table.variants]
             if not nopriors:
                 # compute prior genotype likelihoods based on all reads
+                sample_readsets = []
                 for sample in samples:
                     logger.info("---- Initial genotyping of %s", sample)
                     with timers("read_bam"):
@@ -226,31 +282,34 @@ def run_genotype(
                             chromosome, variant_table.variants, sample, read_vcf=False
                         )
                         readset.sort()
-                        genotypes, genotype_likelihoods = compute_genotypes(readset, positions)
-                        # recompute genotypes based on given threshold
-                        reg_genotype_likelihoods = []
-                        for gl in range(len(genotype_likelihoods)):
-                            norm_sum = (
-                                genotype_likelihoods[gl][0]
-                                + genotype_likelihoods[gl][1]
-                                + genotype_likelihoods[gl][2]
-                                + 3 * constant
-                            )
-                            regularized = PhredGenotypeLikelihoods(
-                                [
-                                    (genotype_likelihoods[gl][0] + constant) / norm_sum,
-                                    (genotype_likelihoods[gl][1] + constant) / norm_sum,
-                                    (genotype_likelihoods[gl][2] + constant) / norm_sum,
-                                ]
-                            )
-                            genotypes[gl] = determine_genotype(regularized, gt_prob)
-                            assert isinstance(genotypes[gl], Genotype)
-                            reg_genotype_likelihoods.append(regularized)
-                        variant_table.set_genotype_likelihoods_of(
-                            sample,
-                            [PhredGenotypeLikelihoods(list(gl)) for gl in reg_genotype_likelihoods],
+                        sample_readsets.append(readset)
+                with timers("genotyping"):
+                    prior_genotypes = compute_genotypes_batch(sample_readsets, positions, threads)
+                for sample, (genotypes, genotype_likelihoods) in zip(samples, prior_genotypes):
+                    # recompute genotypes based on given threshold
+                    reg_genotype_likelihoods = []
+                    for gl in range(len(genotype_likelihoods)):
+                        norm_sum = (
+                            genotype_likelihoods[gl][0]
+                            + genotype_likelihoods[gl][1]
+                            + genotype_likelihoods[gl][2]
+                            + 3 * constant
                         )
-                        variant_table.set_genotypes_of(sample, genotypes)
+                        regularized = PhredGenotypeLikelihoods(
+                            [
+                                (genotype_likelihoods[gl][0] + constant) / norm_sum,
+                                (genotype_likelihoods[gl][1] + constant) / norm_sum,
+                                (genotype_likelihoods[gl][2] + constant) / norm_sum,
+                            ]
+                        )
+                        genotypes[gl] = determine_genotype(regularized, gt_prob)
+                        assert isinstance(genotypes[gl], Genotype)
+                        reg_genotype_likelihoods.append(regularized)
+                    variant_table.set_genotype_likelihoods_of(
+                        sample,
+                        [PhredGenotypeLikelihoods(list(gl)) for gl in reg_genotype_likelihoods],
+                    )
+                    variant_table.set_genotypes_of(sample, genotypes)
             else:
 
                 # use uniform genotype likelihoods for all individuals
@@ -264,106 +323,114 @@ def run_genotype(
                 prior_vcf_writer.write_genotypes(chromosome, variant_table, indels)
 
             # Iterate over all families to process, i.e. a separate DP table is created
-            # for each family.
-            for representative_sample, family in sorted(families.items()):
-                if len(family) == 1:
-                    logger.info("---- Processing individual %s", representative_sample)
-                else:
-                    logger.info("---- Processing family with individuals: %s", ",".join(family))
-                max_coverage_per_sample = max(1, max_coverage // len(family))
-                logger.info("Using maximum coverage per sample of %dX", max_coverage_per_sample)
-                trios = family_trios[representative_sample]
-                assert (len(family) == 1) or (len(trios) > 0)
-
-                # Get the reads belonging to each sample
-                readsets = dict()
-                for sample in family:
-                    with timers("read_bam"):
-                        readset, vcf_source_ids = phased_input_reader.read(
-                            chromosome, variant_table.variants, sample
-                        )
-
-                    with timers("select"):
-                        readset = readset.subset(
-                            [i for i, read in enumerate(readset) if len(read) >= 2]
-                        )
-                        logger.info(
-                            "Kept %d reads that cover at least two variants each", len(readset)
-                        )
-                        selected_reads = select_reads(
-                            readset, max_coverage_per_sample, preferred_source_ids=vcf_source_ids
-                        )
-                    readsets[sample] = selected_reads
-
-                # Merge reads into one ReadSet (note that each Read object
-                # knows the sample it originated from).
-                all_reads = ReadSet()
-                for sample, readset in readsets.items():
-                    for read in readset:
-                        assert read.is_sorted(), "Add a read.sort() here"
-                        all_reads.add(read)
-
-                all_reads.sort()
+            # for each family. Families are prepared (reads and pedigree) one after the
+            # other, but the DP tables of up to `threads` families are computed at the
+            # same time in worker threads (the GenotypeDPTable constructor releases the GIL).
+            # If there are threads to spare, each DP table runs its forward and backward
+            # pass at the same time.
+            concurrent_dp = threads >= 2 * len(families)
+            pending: Deque = deque()
+            with ThreadPoolExecutor(max_workers=threads) as executor:
+                for representative_sample, family in sorted(families.items()):
+                    if len(family) == 1:
+                        logger.info("---- Processing individual %s", representative_sample)
+                    else:
+                        logger.info("---- Processing family with individuals: %s", ",".join(family))
+                    max_coverage_per_sample = max(1, max_coverage // len(family))
+                    logger.info("Using maximum coverage per sample of %dX", max_coverage_per_sample)
+                    trios = family_trios[representative_sample]
+                    assert (len(family) == 1) or (len(trios) > 0)
+
+                    # Get the reads belonging to each sample
+                    readsets = dict()
+                    for sample in family:
+                        with timers("read_bam"):
+                            readset, vcf_source_ids = phased_input_reader.read(
+                                chromosome, variant_table.variants, sample
+                            )
 
-                # Determine which variants can (in principle) be phased
-                accessible_positions = sorted(all_reads.get_positions())
-                logger.info(
-                    "Variants covered by at least one phase-informative "
-                    "read in at least one individual after read selection: %d",
-                    len(accessible_positions),
-                )
+                        with timers("select"):
+                            readset = readset.subset(
+                                [i for i, read in enumerate(readset) if len(read) >= 2]
+                            )
+                            logger.info(
+                                "Kept %d reads that cover at least two variants each", len(readset)
+                            )
+                            selected_reads = select_reads(
+                                readset,
+                                max_coverage_per_sample,
+                                preferred_source_ids=vcf_source_ids,
+                            )
+                        readsets[sample] = selected_reads
 
-                # Create Pedigree
-                pedigree = Pedigree(numeric_sample_ids)
-                for sample in family:
-                    # genotypes are assumed to be unknown, so ignore information that
-                    # might already be present in the input vcf
-                    all_genotype_likelihoods = variant_table.genotype_likelihoods_of(sample)
-                    genotype_l = [
-                        all_genotype_likelihoods[var_to_pos[a_p]] for a_p in accessible_positions
-                    ]
-                    pedigree.add_individual(
-                        sample, [Genotype([]) for i in range(len(accessible_positions))], genotype_l
-                    )
-                for trio in trios:
-                    pedigree.add_relationship(
-                        father_id=trio.father, mother_id=trio.mother, child_id=trio.child
-                    )
+                    # Merge reads into one ReadSet (note that each Read object
+                    # knows the sample it originated from).
+                    all_reads = ReadSet()
+                    for sample, readset in readsets.items():
+                        for read in readset:
+                            assert read.is_sorted(), "Add a read.sort() here"
+                            all_reads.add(read)
 
-                recombination_costs = recombination_cost_computer.compute(accessible_positions)
+                    all_reads.sort()
 
-                # Finally, run genotyping algorithm
-                with timers("genotyping"):
-                    problem_name = "genotyping"
+                    # Determine which variants can (in principle) be phased
+                    accessible_positions = sorted(all_reads.get_positions())
                     logger.info(
-                        "Genotype %d sample%s by solving the %s problem ...",
-                        len(family),
-                        "s" if len(family) > 1 else "",
-                        problem_name,
-                    )
-                    forward_backward_table = GenotypeDPTable(
-                        numeric_sample_ids,
-                        all_reads,
-                        recombination_costs,
-                        pedigree,
-                        accessible_positions,
+                        "Variants covered by at least one phase-informative "
+                        "read in at least one individual after read selection: %d",
+                        len(accessible_positions),
                     )
-                    # store results
-                    for s in family:
-                        likelihood_list = variant_table.genotype_likelihoods_of(s)
-                        genotypes_list = variant_table.genotypes_of(s)
 
-                        for pos in range(len(accessible_positions)):
-                            likelihoods = forward_backward_table.get_genotype_likelihoods(s, pos)
+                    # Create Pedigree
+                    pedigree = Pedigree(numeric_sample_ids)
+                    for sample in family:
+                        # genotypes are assumed to be unknown, so ignore information that
+                        # might already be present in the input vcf
+                        all_genotype_likelihoods = variant_table.genotype_likelihoods_of(sample)
+                        genotype_l = [
+                            all_genotype_likelihoods[var_to_pos[a_p]]
+                            for a_p in accessible_positions
+                        ]
+                        pedigree.add_individual(
+                            sample,
+                            [Genotype([]) for i in range(len(accessible_positions))],
+                            genotype_l,
+                        )
+                    for trio in trios:
+                        pedigree.add_relationship(
+                            father_id=trio.father, mother_id=trio.mother, child_id=trio.child
+                        )
 
-                            # compute genotypes from likelihoods and store information
-                            geno = determine_genotype(likelihoods, gt_prob)
-                            assert isinstance(geno, Genotype)
-                            genotypes_list[var_to_pos[accessible_positions[pos]]] = geno
-                            likelihood_list[var_to_pos[accessible_positions[pos]]] = likelihoods
+                    recombination_costs = recombination_cost_computer.compute(accessible_positions)
 
-                        variant_table.set_genotypes_of(s, genotypes_list)
-                        variant_table.set_genotype_likelihoods_of(s, likelihood_list)
+                    # Finally, run genotyping algorithm
+                    with timers("genotyping"):
+                        problem_name = "genotyping"
+                        logger.info(
+                            "Genotype %d sample%s by solving the %s problem ...",
+                            len(family),
+                            "s" if len(family) > 1 else "",
+                            problem_name,
+                        )
+                        future = executor.submit(
+                            GenotypeDPTable,
+                            numeric_sample_ids,
+                            all_reads,
+                            recombination_costs,
+                            pedigree,
+                            accessible_positions,
+                            precision=dp_precision,
+                            concurrent=concurrent_dp,
+                            **checkpoint_args,
+                        )
+                        pending.append((family, accessible_positions, future))
+                        # store results in the order of the families
+                        while len(pending) >= threads:
+                            store_genotypes(variant_table, var_to_pos, gt_prob, *pending.popleft())
+
+                with timers("genotyping"):
+                    while pending:
+                        store_genotypes(variant_table, var_to_pos, gt_prob, *pending.popleft())
 
             with timers("write_vcf"):
                 logger.info("======== Writing VCF")
@@ -375,6 +442,11 @@ def run_genotype(
     logger.info("\n== SUMMARY ==")
     total_time = timers.total()
     log_memory_usage()
+    logger.debug(
+        "DP column buffers: %(acquired)d requested, %(reused)d reused, %(allocated)d allocated",
+        get_column_arena_stats(),
+    )
+    log_realignment_cache_stats(phased_input_reader.realignment_cache_stats)
     logger.info("Time spent reading BAM:                      %6.1f s", timers.elapsed("read_bam"))
     logger.info("Time spent parsing VCF:                      %6.1f s", timers.elapsed("parse_vcf"))
     if show_phase_vcfs:
@@ -389,6 +461,9 @@ def run_genotype(
     logger.info("Time spent writing VCF:                      %6.1f s", timers.elapsed("write_vcf"))
     logger.info("Time spent on rest:                          %6.1f s", total_time - timers.sum())
     logger.info("Total elapsed time:                          %6.1f s", total_time)
+    if timers_json:
+        set_instrumentation_enabled(False)
+        write_timers_json(timers_json, timers, get_instrumentation())
 
 
 # fmt: off
@@ -425,6 +500,27 @@ def add_arguments(parser):
     arg('--gt-qual-threshold', metavar='GTQUALTHRESHOLD', type=float, default=0,
         help='Phred scaled error probability threshold used for genotyping (default: %(default)s). Must be at least 0. '
         'If error probability of genotype is higher, genotype ./. is output.')
+    arg('--threads', '-t', metavar='N', type=int, default=1,
+        help='Number of threads used to detect alleles in the reads (using worker processes), '
+        'to compute prior genotype likelihoods of all samples and to genotype that many '
+        'families at the same time. With at least two threads per family, the forward and '
+        'backward pass of each family are also computed at the same time. '
+        'Results do not depend on this setting except for rounding errors '
+        '(default: %(default)s)')
+    arg('--dp-precision', choices=('longdouble', 'double'), default='longdouble',
+        help='Floating-point type used by the genotyping algorithm. "double" is faster, '
+        'but computed genotype likelihoods may differ in the last digits (default: %(default)s).')
+    arg('--dp-memory-limit', metavar='MB', type=int, default=None,
+        help='Memory available for storing columns of the genotyping DP table. If given, as many '
+        'columns as fit are kept in memory to avoid recomputing them during the forward pass. '
+        'Results do not depend on this setting (default: keep every sqrt(n)-th column)')
+    arg('--timers-json', metavar='FILE', default=None,
+        help='Write the time spent in each stage and counters of the core algorithms (computed '
+        'and recomputed DP columns, column sizes and bytes, time per pass) as JSON to FILE')
+    arg('--read-cache', metavar='DIR', default=None,
+        help='Cache the reads and their detected alleles in DIR. Later runs (also of '
+        '"whatshap phase" and "whatshap haplotag") on the same input files, variants and '
+        'read selection options reuse them instead of detecting alleles again')
     arg('--no-priors', dest='nopriors', default=False, action='store_true',
         help='Skip initial prior genotyping and use uniform priors (default: %(default)s).')
     arg('-p', '--prioroutput', default=None,
@@ -471,6 +567,10 @@ def validate(args, parser):
         )
     if len(args.phase_input_files) == 0:
         parser.error("Not providing any PHASEINPUT files not allowed for genotyping.")
+    if args.threads < 1:
+        parser.error("The number of threads must be at least 1.")
+    if args.dp_memory_limit is not None and args.dp_memory_limit < 0:
+        parser.error("The DP memory limit must not be negative.")
     if args.gt_qual_threshold < 0:
         parser.error("Genotype quality threshold (gt-qual-threshold) must be at least 0.")
     if args.prioroutput is not None and args.nopriors:
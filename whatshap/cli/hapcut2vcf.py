@@ -17,11 +17,10 @@ import re
 import sys
 from collections import namedtuple
 import itertools
-from contextlib import ExitStack
 
 from whatshap.cli import CommandLineError
-from whatshap.vcf import PhasedVcfWriter
-from whatshap.core import Read
+from whatshap.vcf import PREDEFINED_FORMATS, rewrite_vcf_text
+from whatshap.core import VcfRewriter
 from whatshap import __version__
 
 logger = logging.getLogger(__name__)
@@ -35,10 +34,24 @@ def add_arguments(parser):
         default=sys.stdout,
         help="Output VCF file. If omitted, use standard output.",
     )
+    add(
+        "--threads",
+        "-t",
+        metavar="N",
+        type=int,
+        default=1,
+        help="Number of threads used to decompress the VCF and to rewrite the records "
+        "(default: %(default)s).",
+    )
     add("vcf", metavar="VCF", help="VCF file")
     add("hapcut", metavar="HAPCUT-RESULT", help="hapCUT result file")
 
 
+def validate(args, parser):
+    if args.threads < 1:
+        parser.error("Number of threads must be at least 1.")
+
+
 HapCutVariant = namedtuple(
     "HapCutVariant", ["chromosome", "position", "haplotype1", "haplotype2", "component_id"]
 )
@@ -163,37 +176,54 @@ class HapCutParser:
             yield chromosome, list(block)
 
 
-def run_hapcut2vcf(hapcut, vcf, output=sys.stdout):
+def phased_header(lines, command_line):
+    """
+    Return the header lines of the phased VCF: the PS FORMAT and the command line are
+    added and a "phasing" header (added by FreeBayes) is removed.
+    """
+    samples = lines[-1].split("\t")[9:]
+    if len(samples) != 1:
+        # This would be easy to support with a --sample command-line parameter,
+        # but hapCUT does not seem to support multi-sample VCFs, so something
+        # must be wrong anyway.
+        raise CommandLineError("The VCF must contain exactly one sample")
+    result = [line for line in lines[:-1] if not line.startswith("##phasing=")]
+    if not any(line.startswith("##FORMAT=<ID=PS,") for line in result):
+        result.append(PREDEFINED_FORMATS["PS"].line())
+    result.append('##commandline="{}"'.format(command_line.replace('"', "")))
+    result.append(lines[-1])
+    return result
+
+
+def run_hapcut2vcf(hapcut, vcf, output=sys.stdout, threads=1):
+    """
+    Write the VCF with the phases of the hapCUT result. Genotypes that are not phased
+    by hapCUT are unphased, and their phase sets are removed. Records on chromosomes
+    without hapCUT blocks are not written.
+    """
     command_line = "(whatshap {}) {}".format(__version__, " ".join(sys.argv[1:]))
-    with ExitStack() as stack:
-        if isinstance(output, str):
-            output = stack.enter_context(open(output, "w"))
-
-        writer = PhasedVcfWriter(vcf, command_line, out_file=output)
-        if len(writer.samples) > 1:
-            # This would be easy to support with a --sample command-line parameter,
-            # but hapCUT does not seem to support multi-sample VCFs, so something
-            # must be wrong anyway.
-            raise CommandLineError("There is more than one sample in this VCF")
-        sample = writer.samples[0]
-
-        f = stack.enter_context(open(hapcut))
+    # Existing PS fields are removed from all records and added to the phased ones
+    rewriter = VcfRewriter(["PS"], threads, phased_chromosomes_only=True)
+    with open(hapcut) as f:
         parser = HapCutParser(f)
         for chromosome, blocks in parser:
             logger.info("Read %d phased blocks for chromosome %s", len(blocks), chromosome)
-
-            # Build one read for each haplotype and the connected components
-            haplotypes = [Read(str(i)) for i in (1, 2)]
-            components = dict()
             for block in blocks:
                 for variant in block:
-                    haplotypes[0].add_variant(variant.position, variant.haplotype1, 0)
-                    haplotypes[1].add_variant(variant.position, variant.haplotype2, 0)
-                    components[variant.position] = variant.component_id
-
-            sample_superreads = {sample: haplotypes}
-            sample_components = {sample: components}
-            writer.write(chromosome, sample_superreads, sample_components)
+                    rewriter.set_phase(
+                        chromosome,
+                        variant.position,
+                        variant.haplotype1,
+                        variant.haplotype2,
+                        variant.component_id + 1,
+                    )
+    rewrite_vcf_text(
+        vcf,
+        output,
+        rewriter,
+        lambda lines: phased_header(lines, command_line),
+        threads=threads,
+    )
 
 
 def main(args):
@@ -4,21 +4,25 @@ Tag reads by haplotype
 Sequencing reads are read from file ALIGNMENTS (in BAM format) and tagged reads
 are written to stdout.
 """
+import io
 import logging
 import os
 import sys
 import pysam
 import hashlib
-from collections import defaultdict
-from typing import List, Optional
+from collections import Counter, defaultdict
+from dataclasses import dataclass
+from multiprocessing import Pool
+from tempfile import TemporaryDirectory
+from typing import Dict, List, Optional, Tuple
 
 from xopen import xopen
 
 from contextlib import ExitStack
 from whatshap import __version__
-from whatshap.cli import PhasedInputReader, CommandLineError
+from whatshap.cli import PhasedInputReader, CommandLineError, write_timers_json
 from whatshap.vcf import VcfReader, VcfError, VariantTable, VariantCallPhase, VcfInvalidChromosome
-from whatshap.core import NumericSampleIds
+from whatshap.core import NumericSampleIds, assign_read_haplotypes
 from whatshap.timer import StageTimer
 from whatshap.utils import Region, stdout_is_regular_file
 
@@ -59,9 +63,19 @@ def add_arguments(parser):
         'haplotype the primary alignment has been assigned to (default: only tag primary alignments).')
     arg('--skip-missing-contigs', default=False, action='store_true',
         help='Skip reads that map to a contig that does not exist in the VCF')
+    arg('--threads', '-t', metavar='N', type=int, default=1,
+        help='Number of worker processes used to tag chromosomes in parallel (or, for a '
+        'single chromosome, to detect alleles in the reads). Results do not depend on '
+        'this setting (default: %(default)s)')
     arg('--output-threads', '--out-threads', default=1, type=int,
         help='Number of threads to use for output file writing (passed to pysam). '
         'For optimal performance, instead write output to stdout and use "samtools view" to compress.')
+    arg('--timers-json', metavar='FILE', default=None,
+        help='Write the time spent in each stage as JSON to FILE')
+    arg('--read-cache', metavar='DIR', default=None,
+        help='Cache the reads and their detected alleles in DIR. Later runs (also of '
+        '"whatshap phase" and "whatshap genotype") on the same input files and variants '
+        'reuse them instead of detecting alleles again')
     arg('variant_file', metavar='VCF', help='VCF file with phased variants (must be gzip-compressed and indexed)')
     arg('alignment_file', metavar='ALIGNMENTS',
         help='File (BAM/CRAM) with read alignments to be tagged by haplotype')
@@ -69,7 +83,8 @@ def add_arguments(parser):
 
 
 def validate(args, parser):
-    pass
+    if args.threads < 1:
+        parser.error("The number of threads must be at least 1.")
 
 
 def md5_of(filename):
@@ -178,61 +193,25 @@ def prepare_haplotag_information(
             variant_table.chromosome, variants, sample, regions=regions
         )
 
-        # map BX tag to list of reads
-        bx_tag_to_readlist = defaultdict(list)
-        for read in read_set:
-            if read.has_BX_tag() and not ignore_linked_read:
-                bx_tag_to_readlist[read.BX_tag].append(read)
-
-        # all reads processed so far
-        processed_reads = set()
-        for read in read_set:
-            if read.name in processed_reads:
-                continue
-            # mapping: phaseset --> phred scaled difference between costs of assigning reads to haplotype 0 or 1
-            haplotype_costs = defaultdict(int)
-
-            processed_reads.add(read.name)
-            reads_to_consider = {read}
-
-            # reads with same BX tag need to be considered too (unless --ignore-linked-read is set)
-            if read.has_BX_tag() and not ignore_linked_read:
-                for r in bx_tag_to_readlist[read.BX_tag]:
-                    if r.name not in processed_reads:
-                        # only select reads close to current one
-                        if abs(read.reference_start - r.reference_start) <= linked_read_cutoff:
-                            reads_to_consider.add(r)
-            for r in reads_to_consider:
-                processed_reads.add(r.name)
-                for v in r:
-                    assert v.allele in [0, 1]
-                    phaseset, allele = variantpos_to_phaseinfo[v.position]
-                    if v.allele == allele:
-                        haplotype_costs[phaseset] += v.quality
-                    else:
-                        haplotype_costs[phaseset] -= v.quality
-
-            l = list(haplotype_costs.items())
-            l.sort(key=lambda t: -abs(t[1]))
-            # logger.info('Read %s: %s', read.name, str(l))
-
-            if len(l) == 0:
-                continue
-            if len(l) > 1:
-                n_multiple_phase_sets += 1
-            phaseset, quality = l[0]
-            if quality == 0:
-                continue
-            haplotype = 0 if quality > 0 else 1
-            BX_tag_to_haplotype[read.BX_tag].append((read.reference_start, haplotype, phaseset))
-            for r in reads_to_consider:
-                read_to_haplotype[r.name] = (haplotype, abs(quality), phaseset)
-                logger.debug(
-                    "Assigned read {} to haplotype {} with a "
-                    "quality of {} based on {} covered variants".format(
-                        r.name, haplotype, quality, len(r)
-                    )
-                )
+        # Reads with the same BX tag that are close to each other form read clouds, which
+        # are assigned to haplotypes together (unless --ignore-linked-read is set)
+        positions = sorted(variantpos_to_phaseinfo)
+        read_haplotypes, clouds, n_multiple = assign_read_haplotypes(
+            read_set,
+            positions,
+            [variantpos_to_phaseinfo[position][0] for position in positions],
+            [variantpos_to_phaseinfo[position][1] for position in positions],
+            not ignore_linked_read,
+            linked_read_cutoff,
+        )
+        n_multiple_phase_sets += n_multiple
+        for bx_tag, reference_start, haplotype, phaseset in clouds:
+            BX_tag_to_haplotype[bx_tag].append((reference_start, haplotype, phaseset))
+        for name, haplotype, quality, phaseset in read_haplotypes:
+            read_to_haplotype[name] = (haplotype, quality, phaseset)
+            logger.debug(
+                "Assigned read %s to haplotype %d with a quality of %d", name, haplotype, quality
+            )
     return BX_tag_to_haplotype, read_to_haplotype, n_multiple_phase_sets
 
 
@@ -446,6 +425,229 @@ def ignore_read(alignment, tag_supplementary):
     return ignore
 
 
+def haplotag_chromosome(
+    chrom,
+    regions,
+    vcf_reader,
+    bam_reader,
+    phased_input_reader,
+    bam_writer,
+    haplotag_writer,
+    shared_samples,
+    ignore_linked_read,
+    linked_read_distance_cutoff,
+    tag_supplementary,
+    skip_missing_contigs,
+) -> Counter:
+    """
+    Tag all alignments in the given regions of a chromosome and write them (and the
+    haplotag list entries) to the given writers.
+
+    Return the numbers of processed alignments, tagged alignments and reads spanning
+    multiple phase sets.
+    """
+    counts: Counter = Counter()
+    logger.debug("Processing chromosome {}".format(chrom))
+
+    # If there are no alignments for this chromosome, skip it. This allows to have
+    # extra chromosomes in the BAM compared to the VCF as long as they are not actually
+    # used.
+    has_any_alignments = False
+    for _ in bam_reader.fetch(contig=chrom):
+        has_any_alignments = True
+        break
+    if not has_any_alignments:
+        return counts
+    try:
+        variant_table = load_chromosome_variants(vcf_reader, chrom, regions)
+    except VcfInvalidChromosome:
+        if skip_missing_contigs:
+            logger.info(f"Skipping reads on '{chrom}' because the contig does not exist in the VCF")
+            return counts
+        else:
+            raise CommandLineError(
+                f"Input BAM/CRAM contains reads on contig '{chrom}', but that contig does "
+                "not exist in the VCF header. To bypass this check, use "
+                "--skip-missing-contigs"
+            )
+    except VcfError as e:
+        raise CommandLineError(str(e))
+    if variant_table is not None:
+        logger.debug("Preparing haplotype information")
+        (BX_tag_to_haplotype, read_to_haplotype, n_mult) = prepare_haplotag_information(
+            variant_table,
+            shared_samples,
+            phased_input_reader,
+            regions,
+            ignore_linked_read,
+            linked_read_distance_cutoff,
+        )
+        counts["multiple_phase_sets"] += n_mult
+    else:
+        # avoid uninitialized variables
+        BX_tag_to_haplotype = None
+        read_to_haplotype = None
+
+    for start, end in regions:
+        logger.debug("Iterating chromosome regions")
+        for alignment in bam_reader.fetch(contig=chrom, start=start, stop=end):
+            counts["alignments"] += 1
+            haplotype_name = "none"
+            phaseset = "none"
+            alignment.set_tag("HP", value=None)
+            alignment.set_tag("PC", value=None)
+            alignment.set_tag("PS", value=None)
+            if variant_table is None or ignore_read(alignment, tag_supplementary):
+                # - If no variants in VCF for this chromosome,
+                # alignments just get written to output
+                # - Ignored reads are simply
+                # written to the output BAM
+                pass
+            else:
+                (is_tagged, haplotype_name, phaseset) = attempt_add_phase_information(
+                    alignment,
+                    read_to_haplotype,
+                    BX_tag_to_haplotype,
+                    linked_read_distance_cutoff,
+                    ignore_linked_read,
+                )
+                counts["tagged"] += is_tagged
+
+            bam_writer.write(alignment)
+            if not (alignment.is_secondary or alignment.is_supplementary):
+                print(
+                    alignment.query_name,
+                    haplotype_name,
+                    phaseset,
+                    chrom,
+                    sep="\t",
+                    file=haplotag_writer,
+                )
+
+            if counts["alignments"] % 100000 == 0:
+                logger.debug("Processed {} alignment records.".format(counts["alignments"]))
+    return counts
+
+
+def haplotag_chromosomes_parallel(
+    user_regions,
+    bam_reader,
+    bam_writer,
+    haplotag_writer,
+    segment_dir,
+    threads,
+    reader_args,
+    options,
+) -> Counter:
+    """
+    Tag every chromosome in a pool of worker processes, starting with the longest ones.
+    Each worker writes the tagged alignments of a chromosome to a BAM segment in
+    segment_dir. The segments and haplotag list entries are copied to the output in
+    the order of the chromosomes, such that the output is the same as when tagging
+    serially.
+    """
+    chromosomes = list(user_regions.items())
+    units = sorted(
+        range(len(chromosomes)),
+        key=lambda index: bam_reader.get_reference_length(chromosomes[index][0]),
+        reverse=True,
+    )
+    processes = min(threads, len(units))
+    logger.info(
+        "Tagging alignments on %d chromosomes using %d worker processes",
+        len(chromosomes),
+        processes,
+    )
+    counts: Counter = Counter()
+    # for each chromosome, the segment and haplotag list entries if it has been finished
+    finished: Dict[int, Tuple[str, str]] = {}
+    next_chromosome = 0
+
+    def write_finished_chromosomes():
+        nonlocal next_chromosome
+        while next_chromosome in finished:
+            segment_path, haplotag_lines = finished.pop(next_chromosome)
+            with pysam.AlignmentFile(segment_path, "rb", check_sq=False) as segment:
+                for alignment in segment.fetch(until_eof=True):
+                    bam_writer.write(alignment)
+            os.remove(segment_path)
+            haplotag_writer.write(haplotag_lines)
+            next_chromosome += 1
+
+    work = ((index, chromosomes[index][0], chromosomes[index][1]) for index in units)
+    with Pool(
+        processes=processes,
+        initializer=_init_haplotag_worker,
+        initargs=(reader_args, bam_reader.header.to_dict(), segment_dir, options),
+    ) as pool:
+        for index, segment_path, haplotag_lines, unit_counts in pool.imap_unordered(
+            _haplotag_unit, work
+        ):
+            finished[index] = (segment_path, haplotag_lines)
+            counts.update(unit_counts)
+            write_finished_chromosomes()
+    assert next_chromosome == len(chromosomes)
+    return counts
+
+
+@dataclass
+class HaplotagWorkerState:
+    vcf_reader: VcfReader
+    bam_reader: pysam.AlignmentFile
+    phased_input_reader: PhasedInputReader
+    header: Dict
+    segment_dir: str
+    options: Dict
+
+
+_haplotag_worker_state: Optional[HaplotagWorkerState] = None
+
+
+def _init_haplotag_worker(reader_args, header, segment_dir, options):
+    global _haplotag_worker_state
+    # Each worker opens the input files itself as file handles cannot be shared. Worker
+    # processes cannot start processes themselves, so alleles are detected serially.
+    _haplotag_worker_state = HaplotagWorkerState(
+        vcf_reader=VcfReader(reader_args["variant_file"], indels=True, phases=True),
+        bam_reader=pysam.AlignmentFile(reader_args["alignment_file"], "rb", require_index=True),
+        phased_input_reader=PhasedInputReader(
+            [reader_args["alignment_file"]],
+            reader_args["reference"],
+            NumericSampleIds(),
+            reader_args["ignore_read_groups"],
+            indels=False,
+            threads=1,
+            cache_dir=reader_args["read_cache"],
+        ),
+        header=header,
+        segment_dir=segment_dir,
+        options=options,
+    )
+
+
+def _haplotag_unit(unit):
+    index, chrom, regions = unit
+    state = _haplotag_worker_state
+    assert state is not None
+    segment_path = os.path.join(state.segment_dir, "segment{}.bam".format(index))
+    haplotag_lines = io.StringIO()
+    # The segment is read back right away, so fast compression is sufficient
+    with pysam.AlignmentFile(
+        segment_path, "wb1", header=pysam.AlignmentHeader.from_dict(state.header)
+    ) as segment_writer:
+        counts = haplotag_chromosome(
+            chrom,
+            regions,
+            state.vcf_reader,
+            state.bam_reader,
+            state.phased_input_reader,
+            segment_writer,
+            haplotag_lines,
+            **state.options,
+        )
+    return index, segment_path, haplotag_lines.getvalue(), counts
+
+
 def run_haplotag(
     variant_file,
     alignment_file,
@@ -460,6 +662,9 @@ def run_haplotag(
     tag_supplementary=False,
     skip_missing_contigs=False,
     output_threads=1,
+    threads=1,
+    timers_json=None,
+    read_cache=None,
 ):
 
     timers = StageTimer()
@@ -499,7 +704,13 @@ def run_haplotag(
 
         phased_input_reader = stack.enter_context(
             PhasedInputReader(
-                [alignment_file], reference, NumericSampleIds(), ignore_read_groups, indels=False
+                [alignment_file],
+                reference,
+                NumericSampleIds(),
+                ignore_read_groups,
+                indels=False,
+                threads=threads,
+                cache_dir=read_cache,
             )
         )
 
@@ -520,92 +731,57 @@ def run_haplotag(
         )
         timers.start("haplotag-process")
 
-        n_alignments = 0
-        n_tagged = 0
-        n_multiple_phase_sets = 0
-
-        for chrom, regions in user_regions.items():
-            logger.debug("Processing chromosome {}".format(chrom))
-
-            # If there are no alignments for this chromosome, skip it. This allows to have
-            # extra chromosomes in the BAM compared to the VCF as long as they are not actually
-            # used.
-            has_any_alignments = False
-            for _ in bam_reader.fetch(contig=chrom):
-                has_any_alignments = True
-                break
-            if not has_any_alignments:
-                continue
-            try:
-                variant_table = load_chromosome_variants(vcf_reader, chrom, regions)
-            except VcfInvalidChromosome:
-                if skip_missing_contigs:
-                    logger.info(
-                        f"Skipping reads on '{chrom}' because the contig does not exist in the VCF"
-                    )
-                    continue
-                else:
-                    raise CommandLineError(
-                        f"Input BAM/CRAM contains reads on contig '{chrom}', but that contig does "
-                        "not exist in the VCF header. To bypass this check, use "
-                        "--skip-missing-contigs"
+        options = dict(
+            shared_samples=shared_samples,
+            ignore_linked_read=ignore_linked_read,
+            linked_read_distance_cutoff=linked_read_distance_cutoff,
+            tag_supplementary=tag_supplementary,
+            skip_missing_contigs=skip_missing_contigs,
+        )
+        if threads > 1 and len(user_regions) > 1:
+            # Segments are written next to the output file, as they can be large
+            output_dir = (
+                os.path.dirname(os.path.abspath(output))
+                if isinstance(output, (str, os.PathLike))
+                else None
+            )
+            segment_dir = stack.enter_context(
+                TemporaryDirectory(prefix="whatshap-haplotag-", dir=output_dir)
+            )
+            counts = haplotag_chromosomes_parallel(
+                user_regions,
+                bam_reader,
+                bam_writer,
+                haplotag_writer,
+                segment_dir,
+                threads,
+                reader_args=dict(
+                    variant_file=variant_file,
+                    alignment_file=alignment_file,
+                    reference=reference,
+                    ignore_read_groups=ignore_read_groups,
+                    read_cache=read_cache,
+                ),
+                options=options,
+            )
+        else:
+            counts = Counter()
+            for chrom, regions in user_regions.items():
+                counts.update(
+                    haplotag_chromosome(
+                        chrom,
+                        regions,
+                        vcf_reader,
+                        bam_reader,
+                        phased_input_reader,
+                        bam_writer,
+                        haplotag_writer,
+                        **options,
                     )
-            except VcfError as e:
-                raise CommandLineError(str(e))
-            if variant_table is not None:
-                logger.debug("Preparing haplotype information")
-                (BX_tag_to_haplotype, read_to_haplotype, n_mult) = prepare_haplotag_information(
-                    variant_table,
-                    shared_samples,
-                    phased_input_reader,
-                    regions,
-                    ignore_linked_read,
-                    linked_read_distance_cutoff,
                 )
-                n_multiple_phase_sets += n_mult
-            else:
-                # avoid uninitialized variables
-                BX_tag_to_haplotype = None
-                read_to_haplotype = None
-
-            for start, end in regions:
-                logger.debug("Iterating chromosome regions")
-                for alignment in bam_reader.fetch(contig=chrom, start=start, stop=end):
-                    n_alignments += 1
-                    haplotype_name = "none"
-                    phaseset = "none"
-                    alignment.set_tag("HP", value=None)
-                    alignment.set_tag("PC", value=None)
-                    alignment.set_tag("PS", value=None)
-                    if variant_table is None or ignore_read(alignment, tag_supplementary):
-                        # - If no variants in VCF for this chromosome,
-                        # alignments just get written to output
-                        # - Ignored reads are simply
-                        # written to the output BAM
-                        pass
-                    else:
-                        (is_tagged, haplotype_name, phaseset) = attempt_add_phase_information(
-                            alignment,
-                            read_to_haplotype,
-                            BX_tag_to_haplotype,
-                            linked_read_distance_cutoff,
-                            ignore_linked_read,
-                        )
-                        n_tagged += is_tagged
-
-                    bam_writer.write(alignment)
-                    if not (alignment.is_secondary or alignment.is_supplementary):
-                        print(
-                            alignment.query_name,
-                            haplotype_name,
-                            phaseset,
-                            chrom,
-                            sep="\t",
-                            file=haplotag_writer,
-                        )
-
-                    if n_alignments % 100000 == 0:
-                        logger.debug("Processed {} alignment records.".format(n_alignments))
+        n_alignments = counts["alignments"]
+        n_tagged = counts["tagged"]
+        n_multiple_phase_sets = counts["multiple_phase_sets"]
         timers.stop("haplotag-process")
         logger.debug("Processing complete (time: {})".format(timers.elapsed("haplotag-process")))
 
@@ -616,6 +792,8 @@ def run_haplotag(
     logger.info("Alignments that could be tagged:         %12d", n_tagged)
     logger.info("Alignments spanning multiple phase sets: %12d", n_multiple_phase_sets)
     logger.info("Finished in %.1f s", timers.elapsed("haplotag-run"))
+    if timers_json:
+        write_timers_json(timers_json, timers, {})
 
 
 def main(args):
@@ -6,27 +6,38 @@ Read a VCF and one or more files with phase information (BAM/CRAM or VCF phased
 blocks) and phase the variants. The phased VCF is written to standard output.
 """
 import logging
+import queue
 import sys
 import platform
+import time
 
 from argparse import SUPPRESS
-from collections import defaultdict
+from collections import defaultdict, Counter
 from copy import deepcopy
+from dataclasses import dataclass
+from multiprocessing import Pool
 
 from contextlib import ExitStack
-from typing import Optional, List, TextIO, Union, Dict
+from typing import Any, Optional, List, TextIO, Tuple, Union, Dict, Iterable
 
-from whatshap.vcf import VcfReader, PhasedVcfWriter, VcfError, VariantTable
+from whatshap.vcf import VcfReader, PhasedVcfWriter, VcfError, VariantTable, Shard
 from whatshap import __version__
 from whatshap.core import (
     ReadSet,
     readselection,
+    choose_coverage_limits,
     Pedigree,
     PedigreeDPTable,
     NumericSampleIds,
     PhredGenotypeLikelihoods,
     HapChatCore,
+    get_column_arena_stats,
+    set_instrumentation_enabled,
+    reset_instrumentation,
+    get_instrumentation,
+    merge_instrumentation,
 )
+from whatshap.costmodel import CostModel, EnginePrediction, compute_features
 from whatshap.graph import ComponentFinder
 from whatshap.pedigree import (
     PedReader,
@@ -37,9 +48,16 @@ from whatshap.pedigree import (
     ParseError,
     RecombinationCostComputer,
 )
+from whatshap.pipeline import BackgroundWorker, prefetch
 from whatshap.timer import StageTimer
-from whatshap.utils import plural_s, warn_once
-from whatshap.cli import CommandLineError, log_memory_usage, PhasedInputReader
+from whatshap.utils import plural_s, warn_once, Region, InvalidRegion
+from whatshap.cli import (
+    CommandLineError,
+    log_memory_usage,
+    log_realignment_cache_stats,
+    PhasedInputReader,
+    write_timers_json,
+)
 from whatshap.merge import ReadMerger, DoNothingReadMerger, ReadMergerBase
 
 __author__ = "Murray Patterson, Alexander Schönhuth, Tobias Marschall, Marcel Martin"
@@ -128,11 +146,17 @@ def best_case_blocks(reads):
     return len(component_sizes), len(non_singletons)
 
 
-def select_reads(readset, max_coverage, preferred_source_ids):
-    logger.info(
-        "Reducing coverage to at most %dX by selecting most informative reads ...", max_coverage
+def select_reads(readset, max_coverage, preferred_source_ids, coverage_limits=None):
+    if coverage_limits is None:
+        logger.info(
+            "Reducing coverage to at most %dX by selecting most informative reads ...",
+            max_coverage,
+        )
+    else:
+        logger.info("Reducing coverage by selecting most informative reads ...")
+    selected_indices = readselection(
+        readset, max_coverage, preferred_source_ids, coverage_limits=coverage_limits
     )
-    selected_indices = readselection(readset, max_coverage, preferred_source_ids)
     selected_reads = readset.subset(selected_indices)
     logger.info(
         "Selected %d reads covering %d variants",
@@ -283,6 +307,14 @@ def run_whatshap(
     write_command_line_header: bool = True,
     use_ped_samples: bool = False,
     algorithm: str = "whatshap",
+    threads: int = 1,
+    dp_memory_limit: Optional[int] = None,
+    timers_json: Optional[str] = None,
+    read_cache: Optional[str] = None,
+    pipeline_depth: int = 0,
+    region: Optional[str] = None,
+    region_margin: Optional[int] = None,
+    coverage_budget: Optional[int] = None,
 ):
     """
     Run WhatsHap.
@@ -307,17 +339,53 @@ def run_whatshap(
     recombination_list_filename -- filename to write putative recombination events to
     tag -- How to store phasing info in the VCF, can be 'PS' or 'HP'
     read_list_filename -- name of file to write list of used reads to
-    algorithm -- algorithm to use, can be 'whatshap' or 'hapchat'
+    algorithm -- algorithm to use, can be 'whatshap' or 'hapchat', or 'auto' to choose the
+        algorithm that is predicted to be faster for each family and chromosome
+    threads -- number of threads used to detect alleles in the reads and to compute large columns
+        of the phasing DP table. If there is more than one chromosome or family to phase, they are
+        phased in this many worker processes instead.
+    dp_memory_limit -- memory (in MB) available for storing DP columns. If given, the checkpoint
+        policy of the DP table is chosen such that recomputation is minimized within this limit.
     gl_regularizer -- float to be passed as regularization constant to GenotypeLikelihoods.as_phred
     gtchange_list_filename -- filename to write list of changed genotypes to
     default_gq -- genotype likelihood to be used when GL or PL not available
     write_command_line_header -- whether to add a ##commandline header to the output VCF
+    timers_json -- if given, name of a JSON file to which the time spent in each stage and the
+        counters and timers of the core algorithms are written
+    read_cache -- directory in which the reads (with detected alleles) of each chromosome are
+        cached, such that later runs on the same input can skip allele detection
+    pipeline_depth -- when phasing chromosomes one after another, read up to this many
+        chromosomes ahead in a background thread and write phased chromosomes in another
+        one, such that reading, phasing and writing overlap. 0 (the default) disables this.
+    region -- if given, phase only this region (chrom:start-end) as a shard that can be joined
+        with the shards of adjacent regions by whatshap stitch. The variants within
+        region_margin base pairs around the region are also phased, and only they are written.
+    region_margin -- by default, twice the longest span of a read (pair) at the borders of
+        the region
+    coverage_budget -- if given, memory (in MB) that the DP table of a chromosome may need if
+        all its columns are stored. The maximum coverage is then chosen separately for each
+        window of variants such that this budget is used where coverage is high, and
+        max_coverage is ignored.
     """
 
     if algorithm == "hapchat" and ped is not None:
         raise CommandLineError("The hapchat algorithm cannot do pedigree phasing")
+    if algorithm == "hapchat" and coverage_budget is not None:
+        raise CommandLineError("A coverage budget cannot be used with the hapchat algorithm")
+
+    checkpoint_args: Dict[str, Any] = dict()
+    if dp_memory_limit is not None:
+        checkpoint_args = dict(checkpoint_policy="auto", memory_limit=dp_memory_limit * 1024 ** 2)
 
     timers = StageTimer()
+    # counters of the core algorithms collected in worker processes
+    core_counters: Dict[str, int] = dict()
+    if timers_json:
+        reset_instrumentation()
+        set_instrumentation_enabled(True)
+    # maximum memory used for storing columns of a single DP table
+    dp_peak_memory = 0
+    realignment_cache_stats: Counter = Counter()
     logger.info(f"This is WhatsHap {__version__} running under Python {platform.python_version()}")
     numeric_sample_ids = NumericSampleIds()
     command_line: Optional[str]
@@ -347,10 +415,17 @@ def run_whatshap(
                 ignore_read_groups,
                 mapq_threshold=mapping_quality,
                 indels=indels,
+                threads=threads,
+                cache_dir=read_cache,
             )
         )
         show_phase_vcfs = phased_input_reader.has_vcfs
 
+        shard = None
+        if region is not None:
+            shard = make_shard(phased_input_reader, region, region_margin)
+            chromosomes = [shard.chromosome]
+
         if phased_input_reader.has_alignments and reference is None:
             raise CommandLineError(
                 "A reference FASTA needs to be provided with -r/--reference; "
@@ -366,6 +441,8 @@ def run_whatshap(
                     out_file=output,
                     tag=tag,
                     indels=indels,
+                    threads=threads,
+                    shard=shard,
                 )
             )
         except (OSError, VcfError) as e:
@@ -373,7 +450,12 @@ def run_whatshap(
 
         # Only read genotype likelihoods from VCFs when distrusting genotypes
         vcf_reader = stack.enter_context(
-            VcfReader(variant_file, indels=indels, genotype_likelihoods=distrust_genotypes)
+            VcfReader(
+                variant_file,
+                indels=indels,
+                genotype_likelihoods=distrust_genotypes,
+                threads=threads,
+            )
         )
 
         if ignore_read_groups and not samples and len(vcf_reader.samples) > 1:
@@ -389,6 +471,8 @@ def run_whatshap(
             samples = PedReader(ped).samples()
 
         raise_if_any_sample_not_in_vcf(vcf_reader, samples)
+        # the calls of samples that are not phased do not need to be parsed
+        vcf_reader.subset_samples(samples)
 
         recombination_cost_computer = make_recombination_cost_computer(ped, genmap, recombrate)
 
@@ -398,11 +482,17 @@ def run_whatshap(
             for trio in trios:
                 # Ensure that all mentioned individuals have a numeric id
                 _ = numeric_sample_ids[trio.child]
+        family_list = sorted(families.items())
+        # Assign numeric ids to the other samples in the order in which phasing uses them,
+        # such that they are the same in all worker processes
+        for _, family in family_list:
+            for sample in family:
+                _ = numeric_sample_ids[sample]
 
         read_list = None
         if read_list_filename:
             read_list = stack.enter_context(ReadList(read_list_filename))
-            if algorithm == "hapchat":
+            if algorithm != "whatshap":
                 logger.warning(
                     "On which haplotype a read occurs in the inferred solution is not yet "
                     "implemented in hapchat, and so the corresponding column in the "
@@ -413,195 +503,764 @@ def run_whatshap(
             # TODO should this be done in PhasedInputReader.__init__?
             phased_input_reader.read_vcfs()
 
-        superreads: Dict[str, ReadSet]
-        components: Dict
-        for variant_table in timers.iterate("parse_vcf", vcf_reader):
-            chromosome = variant_table.chromosome
-            if (not chromosomes) or (chromosome in chromosomes):
-                logger.info("======== Working on chromosome %r", chromosome)
-            else:
-                logger.info(
-                    "Leaving chromosome %r unchanged (present in VCF but not requested by option --chromosome)",
-                    chromosome,
+        phaser_args = dict(
+            read_merger=read_merger,
+            recombination_cost_computer=recombination_cost_computer,
+            numeric_sample_ids=numeric_sample_ids,
+            max_coverage=max_coverage,
+            distrust_genotypes=distrust_genotypes,
+            include_homozygous=include_homozygous,
+            genetic_haplotyping=genetic_haplotyping,
+            default_gq=default_gq,
+            gl_regularizer=gl_regularizer,
+            algorithm=algorithm,
+            checkpoint_args=checkpoint_args,
+            keep_reads=read_list is not None,
+            regions=None if shard is None else [(shard.window_start, shard.window_end)],
+            coverage_budget=None if coverage_budget is None else coverage_budget * 1024 ** 2,
+        )
+        if threads > 1 and pipeline_depth > 0:
+            # Alleles are detected in worker processes, which must not be forked from a
+            # background thread
+            logger.debug("Not reading chromosomes in the background")
+            pipeline_depth = 0
+        # Stages run in other threads or processes are timed separately, as their times
+        # overlap with those of the main thread
+        background_timers: List[StageTimer] = []
+        read_timers = timers
+        write_timers = timers
+        if pipeline_depth > 0:
+            read_timers = StageTimer()
+            write_timers = StageTimer()
+            background_timers += [read_timers, write_timers]
+        chromosome_writer = ChromosomeWriter(
+            vcf_writer,
+            read_list,
+            recombination_list_filename,
+            gtchange_list_filename,
+            numeric_sample_ids,
+            distrust_genotypes,
+            write_timers,
+        )
+
+        # VariantTables are only built for the requested chromosomes
+        variant_tables: Iterable[Tuple[str, Optional[VariantTable]]] = read_timers.iterate(
+            "parse_vcf", vcf_reader.tables(lambda chromosome: is_requested(chromosome, chromosomes))
+        )
+        if shard is not None:
+            variant_tables = (
+                (chromosome, None if table is None else restrict_to_shard(table, shard))
+                for chromosome, table in variant_tables
+            )
+        n_units = 1
+        if threads > 1:
+            n_units = estimate_unit_count(vcf_reader, chromosomes, len(family_list))
+
+        if n_units > 1:
+            reader_args = dict(
+                bam_or_vcf_paths=phase_input_files,
+                reference=None if reference is False else reference,
+                numeric_sample_ids=numeric_sample_ids,
+                ignore_read_groups=ignore_read_groups,
+                mapq_threshold=mapping_quality,
+                indels=indels,
+                cache_dir=read_cache,
+            )
+            worker_timers = StageTimer()
+            background_timers.append(worker_timers)
+            worker_peak_memory, worker_cache_stats, core_counters = phase_chromosomes_parallel(
+                variant_tables,
+                family_list,
+                family_trios,
+                reader_args,
+                phaser_args,
+                threads,
+                n_units,
+                chromosome_writer,
+                worker_timers,
+                instrumentation=bool(timers_json),
+            )
+            dp_peak_memory = max(dp_peak_memory, worker_peak_memory)
+            realignment_cache_stats.update(worker_cache_stats)
+        else:
+            phaser = FamilyPhaser(phased_input_reader, threads=threads, **phaser_args)
+
+            def read_chromosomes():
+                for chromosome, variant_table in variant_tables:
+                    if variant_table is None:
+                        yield chromosome, None
+                        continue
+                    logger.info("======== Working on chromosome %r", chromosome)
+                    # A separate DP table is created for each family
+                    yield chromosome, [
+                        phaser.read(variant_table, family, family_trios[sample], read_timers)
+                        for sample, family in family_list
+                    ]
+
+            # The next chromosome is read and the previous one written while phasing
+            with BackgroundWorker(pipeline_depth) as writer:
+                for chromosome, family_inputs in prefetch(read_chromosomes(), pipeline_depth):
+                    if family_inputs is None:
+                        writer.submit(chromosome_writer.write_unchanged, chromosome)
+                        continue
+                    phasings = []
+                    for family_input in family_inputs:
+                        phasing = phaser.solve(family_input, timers)
+                        dp_peak_memory = max(dp_peak_memory, phasing.dp_peak_memory)
+                        phasings.append((family_input.trios, phasing))
+                    writer.submit(chromosome_writer.write, chromosome, phasings)
+                    logger.debug("Chromosome %r phased", chromosome)
+        realignment_cache_stats.update(phased_input_reader.realignment_cache_stats)
+        background_time = 0.0
+        for background_timer in background_timers:
+            background_time += background_timer.sum()
+            timers.merge(background_timer)
+
+    log_time_and_memory_usage(
+        timers,
+        show_phase_vcfs=show_phase_vcfs,
+        background_time=background_time,
+        dp_peak_memory=dp_peak_memory,
+        realignment_cache_stats=realignment_cache_stats,
+    )
+    if timers_json:
+        merge_instrumentation(core_counters, get_instrumentation())
+        set_instrumentation_enabled(False)
+        write_timers_json(timers_json, timers, core_counters)
+
+
+# Number of work units per worker process that are read ahead when phasing in parallel
+PARALLEL_LOOKAHEAD = 2
+
+# Range of the maximum coverage (of all samples of a family together) with a coverage budget
+ADAPTIVE_MIN_COVERAGE = 5
+ADAPTIVE_MAX_COVERAGE = 23
+# Number of consecutive variants that get the same maximum coverage with a coverage budget
+COVERAGE_LIMIT_WINDOW = 50
+
+# The window of a shard extends its region by this many times the longest read (pair) span
+SHARD_MARGIN_FACTOR = 2
+
+
+def make_shard(phased_input_reader, region: str, margin: Optional[int]) -> Shard:
+    """
+    Return the shard for the given region (chrom:start-end). Unless a margin is given, its
+    window extends the region by SHARD_MARGIN_FACTOR times the longest span of a read (pair)
+    overlapping the borders of the region. Every read that connects variants on both sides
+    of a border is then contained in the windows of both adjacent shards.
+    """
+    try:
+        parsed = Region.parse(region)
+    except InvalidRegion as e:
+        raise CommandLineError("Invalid region {!r}: {}".format(region, e))
+    if margin is None:
+        borders = [parsed.start] if parsed.start > 0 else []
+        if parsed.end is not None:
+            borders.append(parsed.end)
+        span = phased_input_reader.longest_template_span(parsed.chromosome, borders)
+        margin = SHARD_MARGIN_FACTOR * span
+        logger.info("Longest read span at the borders of the region: %d bp", span)
+    shard = Shard(
+        chromosome=parsed.chromosome,
+        start=parsed.start,
+        end=parsed.end,
+        window_start=max(0, parsed.start - margin),
+        window_end=None if parsed.end is None else parsed.end + margin,
+    )
+    logger.info(
+        "Phasing shard %s (the region and %d bp on both sides)", shard.header_value(), margin
+    )
+    return shard
+
+
+def restrict_to_shard(variant_table: VariantTable, shard: Shard) -> VariantTable:
+    """Remove the variants outside the window of the shard (if it is on the same chromosome)"""
+    if variant_table.chromosome == shard.chromosome:
+        variant_table.subset_rows_by_position(
+            variant.position
+            for variant in variant_table.variants
+            if shard.in_window(shard.chromosome, variant.position)
+        )
+    return variant_table
+
+
+def is_requested(chromosome: str, chromosomes: Optional[List[str]]) -> bool:
+    """Return whether a chromosome is to be phased (an empty list means all)"""
+    return (not chromosomes) or (chromosome in chromosomes)
+
+
+def estimate_unit_count(
+    vcf_reader: VcfReader, chromosomes: Optional[List[str]], n_families: int
+) -> int:
+    """
+    Return the number of work units (a family on a requested chromosome) without reading
+    any records, counting the chromosomes listed in the index of the VCF or, without an
+    index, in its header. If neither lists any, count the requested chromosomes, or assume
+    several chromosomes if all are requested.
+    """
+    listed = vcf_reader.indexed_chromosomes()
+    if listed is None:
+        listed = list(vcf_reader.contigs)
+    if listed:
+        n_chromosomes = sum(is_requested(chromosome, chromosomes) for chromosome in listed)
+    else:
+        n_chromosomes = len(chromosomes) if chromosomes else 2
+    return n_families * n_chromosomes
+
+
+@dataclass
+class FamilyPhasing:
+    """Result of phasing the samples of a family on one chromosome"""
+
+    # the two superreads of every sample
+    superreads: Dict[str, ReadSet]
+    # maps each phased position to its component (shared by all samples)
+    overall_components: Dict[int, int]
+    accessible_positions: List[int]
+    recombination_costs: List[int]
+    transmission_vector: Optional[List[int]]
+    dp_peak_memory: int
+    # only kept if a list of used reads is written
+    all_reads: Optional[ReadSet] = None
+    partitioning: Optional[List[int]] = None
+
+
+@dataclass
+class FamilyInput:
+    """Selected reads of a family on one chromosome, as needed for phasing it"""
+
+    family: List[str]
+    trios: List
+    # the selected reads of all samples
+    all_reads: ReadSet
+    phasable_variant_table: VariantTable
+    homozygous_positions: List[int]
+
+
+class FamilyPhaser:
+    """
+    Phase the samples of a family on a chromosome: read the alignments, select reads,
+    solve the (Ped)MEC problem and find the phased blocks.
+
+    Reading (read()) and solving (solve()) can be run in different threads, such that the
+    next chromosome is read while the current one is phased.
+    """
+
+    def __init__(
+        self,
+        phased_input_reader: PhasedInputReader,
+        read_merger: ReadMergerBase,
+        recombination_cost_computer: RecombinationCostComputer,
+        numeric_sample_ids: NumericSampleIds,
+        max_coverage: int,
+        distrust_genotypes: bool,
+        include_homozygous: bool,
+        genetic_haplotyping: bool,
+        default_gq: int,
+        gl_regularizer: Optional[float],
+        algorithm: str,
+        checkpoint_args: Dict[str, Any],
+        keep_reads: bool,
+        threads: int = 1,
+        regions: Optional[List[Tuple[int, Optional[int]]]] = None,
+        coverage_budget: Optional[int] = None,
+    ):
+        """
+        keep_reads -- whether the results contain the phased reads and their partitioning
+        threads -- number of threads used to compute large columns of the DP table
+        regions -- if given, only alignments overlapping these (start, end) regions are read
+        coverage_budget -- if given, estimated memory (in bytes) of the DP table from which the
+            maximum coverage of each window of variants is chosen (see choose_coverage_limits)
+        """
+        self._phased_input_reader = phased_input_reader
+        self._read_merger = read_merger
+        self._recombination_cost_computer = recombination_cost_computer
+        self._numeric_sample_ids = numeric_sample_ids
+        self._max_coverage = max_coverage
+        self._distrust_genotypes = distrust_genotypes
+        self._include_homozygous = include_homozygous
+        self._genetic_haplotyping = genetic_haplotyping
+        self._default_gq = default_gq
+        self._gl_regularizer = gl_regularizer
+        self._algorithm = algorithm
+        self._checkpoint_args = checkpoint_args
+        self._keep_reads = keep_reads
+        self._threads = threads
+        self._regions = regions
+        self._coverage_budget = coverage_budget
+        self._cost_model = None
+        if algorithm == "auto":
+            self._cost_model = CostModel(HapChatCore.MAX_COVERAGE, threads)
+
+    def phase(self, variant_table, family, trios, timers) -> FamilyPhasing:
+        return self.solve(self.read(variant_table, family, trios, timers), timers)
+
+    def read(self, variant_table, family, trios, timers) -> FamilyInput:
+        """Read the alignments of all samples of the family and select reads"""
+        chromosome = variant_table.chromosome
+        if len(family) == 1:
+            logger.info("---- Processing individual %s", family[0])
+        else:
+            logger.info("---- Processing family with individuals: %s", ",".join(family))
+        max_coverage_per_sample = max(1, self._max_coverage // len(family))
+        if self._coverage_budget is None:
+            logger.info("Using maximum coverage per sample of %dX", max_coverage_per_sample)
+        assert len(family) == 1 or len(trios) > 0
+
+        homozygous_positions, phasable_variant_table = find_phaseable_variants(
+            family, self._include_homozygous, trios, variant_table
+        )
+
+        # Get the reads belonging to each sample
+        candidate_reads = dict()
+        all_vcf_source_ids = dict()
+        for sample in family:
+            with timers("read_bam"):
+                readset, vcf_source_ids = self._phased_input_reader.read(
+                    chromosome, phasable_variant_table.variants, sample, regions=self._regions
                 )
-                with timers("write_vcf"):
-                    superreads, components = dict(), dict()
-                    vcf_writer.write(chromosome, superreads, components)
-                continue
-
-            # These two variables hold the phasing results for all samples
-            superreads, components = dict(), dict()
-
-            # Iterate over all families to process, i.e. a separate DP table is created
-            # for each family.
-            # TODO: Can the body of this loop be factored out into a phase_family function?
-            for representative_sample, family in sorted(families.items()):
-                if len(family) == 1:
-                    logger.info("---- Processing individual %s", representative_sample)
-                else:
-                    logger.info("---- Processing family with individuals: %s", ",".join(family))
-                max_coverage_per_sample = max(1, max_coverage // len(family))
-                logger.info("Using maximum coverage per sample of %dX", max_coverage_per_sample)
-                trios = family_trios[representative_sample]
-                assert len(family) == 1 or len(trios) > 0
-
-                homozygous_positions, phasable_variant_table = find_phaseable_variants(
-                    family, include_homozygous, trios, variant_table
+
+            # TODO: Read selection done w.r.t. all variants, where using heterozygous
+            #  variants only would probably give better results.
+            with timers("select"):
+                readset = readset.subset([i for i, read in enumerate(readset) if len(read) >= 2])
+                logger.info("Kept %d reads that cover at least two variants each", len(readset))
+                candidate_reads[sample] = (readset, self._read_merger.merge(readset))
+            all_vcf_source_ids[sample] = vcf_source_ids
+
+        coverage_limits = None
+        if self._coverage_budget is not None:
+            with timers("select"):
+                coverage_limits = self._choose_coverage_limits(
+                    {sample: merged for sample, (_, merged) in candidate_reads.items()}, trios
                 )
 
-                # Get the reads belonging to each sample
-                readsets = dict()  # TODO this could become a list
-                for sample in family:
-                    with timers("read_bam"):
-                        readset, vcf_source_ids = phased_input_reader.read(
-                            chromosome, phasable_variant_table.variants, sample
-                        )
-
-                    # TODO: Read selection done w.r.t. all variants, where using heterozygous
-                    #  variants only would probably give better results.
-                    with timers("select"):
-                        readset = readset.subset(
-                            [i for i, read in enumerate(readset) if len(read) >= 2]
-                        )
-                        logger.info(
-                            "Kept %d reads that cover at least two variants each", len(readset)
-                        )
-                        merged_reads = read_merger.merge(readset)
-                        selected_reads = select_reads(
-                            merged_reads,
-                            max_coverage_per_sample,
-                            preferred_source_ids=vcf_source_ids,
-                        )
-
-                    readsets[sample] = selected_reads
-                    if len(family) == 1 and not distrust_genotypes:
-                        # When having a pedigree (len(family) > 1), blocks are also merged after
-                        # phasing based on the pedigree information and these statistics are not
-                        # so useful. When distrust_genotypes, genotypes can change during phasing
-                        # and so can the block structure. So don't print these stats in those cases
-                        log_best_case_phasing_info(readset, selected_reads)
-
-                all_reads = merge_readsets(readsets)
-
-                # Determine which variants can (in principle) be phased
-                accessible_positions = sorted(all_reads.get_positions())
-                logger.info(
-                    "Variants covered by at least one phase-informative "
-                    "read in at least one individual after read selection: %d",
-                    len(accessible_positions),
+        readsets = dict()  # TODO this could become a list
+        for sample in family:
+            readset, merged_reads = candidate_reads.pop(sample)
+            with timers("select"):
+                selected_reads = select_reads(
+                    merged_reads,
+                    max_coverage_per_sample,
+                    preferred_source_ids=all_vcf_source_ids[sample],
+                    coverage_limits=coverage_limits,
                 )
-                if len(family) > 1 and genetic_haplotyping:
-                    # In case of genetic haplotyping, also retain all positions homozygous
-                    # in at least one individual (because they might be phased based on genotypes)
-                    accessible_positions = sorted(
-                        set(accessible_positions).union(homozygous_positions)
-                    )
-                    logger.info(
-                        "Variants either covered by phase-informative read or homozygous "
-                        "in at least one individual: %d",
-                        len(accessible_positions),
-                    )
 
-                # Keep only accessible positions
-                phasable_variant_table.subset_rows_by_position(accessible_positions)
-                assert len(phasable_variant_table.variants) == len(accessible_positions)
+            readsets[sample] = selected_reads
+            if len(family) == 1 and not self._distrust_genotypes:
+                # When having a pedigree (len(family) > 1), blocks are also merged after
+                # phasing based on the pedigree information and these statistics are not
+                # so useful. When distrust_genotypes, genotypes can change during phasing
+                # and so can the block structure. So don't print these stats in those cases
+                log_best_case_phasing_info(readset, selected_reads)
+
+        return FamilyInput(
+            family=family,
+            trios=trios,
+            all_reads=merge_readsets(readsets),
+            phasable_variant_table=phasable_variant_table,
+            homozygous_positions=homozygous_positions,
+        )
+
+    def _choose_coverage_limits(self, readsets, trios) -> List[Tuple[int, int]]:
+        """
+        Choose the maximum coverage per sample for each window of variants such that the
+        DP table for the reads of all samples fits into the coverage budget
+        """
+        n_samples = len(readsets)
+        max_coverage = max(ADAPTIVE_MIN_COVERAGE, ADAPTIVE_MAX_COVERAGE - 2 * len(trios))
+        limits, memory = choose_coverage_limits(
+            merge_readsets(readsets),
+            ADAPTIVE_MIN_COVERAGE,
+            max_coverage,
+            4 ** len(trios),
+            self._coverage_budget,
+            COVERAGE_LIMIT_WINDOW,
+        )
+        limits = [(position, max(1, limit // n_samples)) for position, limit in limits]
+        if limits:
+            logger.info(
+                "Using maximum coverage per sample between %dX and %dX "
+                "(estimated DP table size %.1f MB)",
+                min(limit for _, limit in limits),
+                max(limit for _, limit in limits),
+                memory / 1024 ** 2,
+            )
+        if memory > self._coverage_budget:
+            logger.warning(
+                "The coverage budget is exceeded even with a maximum coverage of %dX",
+                ADAPTIVE_MIN_COVERAGE,
+            )
+        return limits
+
+    def _choose_algorithm(self, all_reads, positions, n_individuals, n_trios) -> EnginePrediction:
+        """Choose the algorithm with the lowest predicted running time"""
+        assert self._cost_model is not None
+        features = compute_features(all_reads, positions, n_individuals, n_trios)
+        predictions = self._cost_model.predict(features, self._distrust_genotypes)
+        logger.info(
+            "Predicted phasing time for %d columns with coverage up to %dX: %s",
+            features.columns,
+            features.max_coverage,
+            ", ".join(f"{p.seconds:.2f} s with {p.engine}" for p in predictions),
+        )
+        logger.debug("Coverage histogram: %s", sorted(features.coverage_histogram.items()))
+        return min(predictions, key=lambda p: p.seconds)
+
+    def solve(self, family_input: FamilyInput, timers) -> FamilyPhasing:
+        """Solve the (Ped)MEC problem for reads returned by read() and find the phased blocks"""
+        numeric_sample_ids = self._numeric_sample_ids
+        distrust_genotypes = self._distrust_genotypes
+        family = family_input.family
+        trios = family_input.trios
+        all_reads = family_input.all_reads
+        phasable_variant_table = family_input.phasable_variant_table
+        homozygous_positions = family_input.homozygous_positions
+
+        # Determine which variants can (in principle) be phased
+        accessible_positions = sorted(all_reads.get_positions())
+        logger.info(
+            "Variants covered by at least one phase-informative "
+            "read in at least one individual after read selection: %d",
+            len(accessible_positions),
+        )
+        if len(family) > 1 and self._genetic_haplotyping:
+            # In case of genetic haplotyping, also retain all positions homozygous
+            # in at least one individual (because they might be phased based on genotypes)
+            accessible_positions = sorted(set(accessible_positions).union(homozygous_positions))
+            logger.info(
+                "Variants either covered by phase-informative read or homozygous "
+                "in at least one individual: %d",
+                len(accessible_positions),
+            )
+
+        # Keep only accessible positions
+        phasable_variant_table.subset_rows_by_position(accessible_positions)
+        assert len(phasable_variant_table.variants) == len(accessible_positions)
+
+        pedigree = create_pedigree(
+            self._default_gq,
+            distrust_genotypes,
+            family,
+            self._gl_regularizer,
+            numeric_sample_ids,
+            phasable_variant_table,
+            trios,
+        )
+        recombination_costs = self._recombination_cost_computer.compute(accessible_positions)
+
+        # Finally, run phasing algorithm
+        dp_peak_memory = 0
+        with timers("phase"):
+            problem_name = "MEC" if len(family) == 1 else "PedMEC"
+            logger.info(
+                "Phasing %d sample%s by solving the %s problem ...",
+                len(family),
+                plural_s(len(family)),
+                problem_name,
+            )
 
-                pedigree = create_pedigree(
-                    default_gq,
+            algorithm = self._algorithm
+            prediction = None
+            if self._cost_model is not None:
+                prediction = self._choose_algorithm(
+                    all_reads, accessible_positions, len(family), len(trios)
+                )
+                algorithm = prediction.engine
+            start_time = time.perf_counter()
+            dp_table: Union[HapChatCore, PedigreeDPTable]
+            if algorithm == "hapchat":
+                dp_table = HapChatCore(all_reads)
+            else:
+                dp_table = PedigreeDPTable(
+                    all_reads,
+                    recombination_costs,
+                    pedigree,
                     distrust_genotypes,
-                    family,
-                    gl_regularizer,
-                    numeric_sample_ids,
-                    phasable_variant_table,
-                    trios,
+                    accessible_positions,
+                    threads=self._threads,
+                    **self._checkpoint_args,
                 )
-                recombination_costs = recombination_cost_computer.compute(accessible_positions)
-
-                # Finally, run phasing algorithm
-                with timers("phase"):
-                    problem_name = "MEC" if len(family) == 1 else "PedMEC"
-                    logger.info(
-                        "Phasing %d sample%s by solving the %s problem ...",
-                        len(family),
-                        plural_s(len(family)),
-                        problem_name,
-                    )
+                logger.debug("DP checkpoint policy: %s", dp_table.get_checkpoint_policy())
+                dp_peak_memory = dp_table.get_peak_memory()
 
-                    dp_table: Union[HapChatCore, PedigreeDPTable]
-                    if algorithm == "hapchat":
-                        dp_table = HapChatCore(all_reads)
-                    else:
-                        dp_table = PedigreeDPTable(
-                            all_reads,
-                            recombination_costs,
-                            pedigree,
-                            distrust_genotypes,
-                            accessible_positions,
-                        )
-
-                    superreads_list, transmission_vector = dp_table.get_super_reads()
-                    logger.info("%s cost: %d", problem_name, dp_table.get_optimal_cost())
-
-                with timers("components"):
-                    overall_components = compute_overall_components(
-                        accessible_positions,
-                        all_reads,
-                        distrust_genotypes,
-                        family,
-                        genetic_haplotyping,
-                        homozygous_positions,
-                        numeric_sample_ids,
-                        superreads_list,
-                    )
-                    log_component_stats(overall_components, len(accessible_positions))
-
-                if recombination_list_filename:
-                    n_recombinations = write_recombination_list(
-                        recombination_list_filename,
-                        chromosome,
-                        accessible_positions,
-                        overall_components,
-                        recombination_costs,
-                        transmission_vector,
-                        trios,
-                    )
-                    logger.info("Total no. of detected recombination events: %d", n_recombinations)
-
-                # Superreads in superreads_list are in the same order as individuals were added to the pedigree
-                for sample, sample_superreads in zip(family, superreads_list):
-                    superreads[sample] = sample_superreads
-                    assert len(sample_superreads) == 2
-                    assert (
-                        sample_superreads[0].sample_id
-                        == sample_superreads[1].sample_id
-                        == numeric_sample_ids[sample]
-                    )
-                    # identical for all samples
-                    components[sample] = overall_components
-
-                if read_list:
-                    read_list.write(
-                        all_reads,
-                        dp_table.get_optimal_partitioning(),
-                        components,
-                        numeric_sample_ids,
-                    )
+            superreads_list, transmission_vector = dp_table.get_super_reads()
+            logger.info("%s cost: %d", problem_name, dp_table.get_optimal_cost())
+            if prediction is not None:
+                logger.info(
+                    "Phasing with %s took %.2f s (predicted: %.2f s for %.4g work units)",
+                    algorithm,
+                    time.perf_counter() - start_time,
+                    prediction.seconds,
+                    prediction.units,
+                )
+
+        with timers("components"):
+            overall_components = compute_overall_components(
+                accessible_positions,
+                all_reads,
+                distrust_genotypes,
+                family,
+                self._genetic_haplotyping,
+                homozygous_positions,
+                numeric_sample_ids,
+                superreads_list,
+            )
+            log_component_stats(overall_components, len(accessible_positions))
 
-            with timers("write_vcf"):
-                logger.info("======== Writing VCF")
-                changed_genotypes = vcf_writer.write(chromosome, superreads, components)
-                logger.info("Done writing VCF")
-                if changed_genotypes:
-                    assert distrust_genotypes
-                    logger.info("Changed %d genotypes while writing VCF", len(changed_genotypes))
+        # Superreads in superreads_list are in the same order as individuals were added to the pedigree
+        superreads = dict()
+        for sample, sample_superreads in zip(family, superreads_list):
+            superreads[sample] = sample_superreads
+            assert len(sample_superreads) == 2
+            assert (
+                sample_superreads[0].sample_id
+                == sample_superreads[1].sample_id
+                == numeric_sample_ids[sample]
+            )
 
-            if gtchange_list_filename:
-                logger.info("Writing list of changed genotypes to %r", gtchange_list_filename)
-                write_changed_genotypes(gtchange_list_filename, changed_genotypes)
+        phasing = FamilyPhasing(
+            superreads=superreads,
+            overall_components=overall_components,
+            accessible_positions=accessible_positions,
+            recombination_costs=recombination_costs,
+            transmission_vector=transmission_vector,
+            dp_peak_memory=dp_peak_memory,
+        )
+        if self._keep_reads:
+            phasing.all_reads = all_reads
+            phasing.partitioning = dp_table.get_optimal_partitioning()
+        return phasing
 
-            logger.debug("Chromosome %r finished", chromosome)
 
-    log_time_and_memory_usage(timers, show_phase_vcfs=show_phase_vcfs)
+class ChromosomeWriter:
+    """
+    Write the phasings of all families on a chromosome to the output VCF and the
+    optional recombination list, read list and list of changed genotypes.
+    Chromosomes must be written in the order of the input VCF.
+    """
+
+    def __init__(
+        self,
+        vcf_writer,
+        read_list,
+        recombination_list_filename,
+        gtchange_list_filename,
+        numeric_sample_ids,
+        distrust_genotypes,
+        timers,
+    ):
+        self._vcf_writer = vcf_writer
+        self._read_list = read_list
+        self._recombination_list_filename = recombination_list_filename
+        self._gtchange_list_filename = gtchange_list_filename
+        self._numeric_sample_ids = numeric_sample_ids
+        self._distrust_genotypes = distrust_genotypes
+        self._timers = timers
+
+    def write_unchanged(self, chromosome):
+        logger.info(
+            "Leaving chromosome %r unchanged (present in VCF but not requested by option --chromosome)",
+            chromosome,
+        )
+        with self._timers("write_vcf"):
+            self._vcf_writer.write(chromosome, dict(), dict())
+
+    def write(self, chromosome, phasings):
+        """
+        phasings -- list of (trios, FamilyPhasing) pairs, one for each family
+        """
+        # These two variables hold the phasing results for all samples
+        superreads: Dict[str, ReadSet] = dict()
+        components: Dict = dict()
+        for trios, phasing in phasings:
+            if self._recombination_list_filename:
+                n_recombinations = write_recombination_list(
+                    self._recombination_list_filename,
+                    chromosome,
+                    phasing.accessible_positions,
+                    phasing.overall_components,
+                    phasing.recombination_costs,
+                    phasing.transmission_vector,
+                    trios,
+                )
+                logger.info("Total no. of detected recombination events: %d", n_recombinations)
+
+            for sample, sample_superreads in phasing.superreads.items():
+                superreads[sample] = sample_superreads
+                # identical for all samples
+                components[sample] = phasing.overall_components
+
+            if self._read_list:
+                self._read_list.write(
+                    phasing.all_reads,
+                    phasing.partitioning,
+                    components,
+                    self._numeric_sample_ids,
+                )
+
+        with self._timers("write_vcf"):
+            logger.info("======== Writing VCF")
+            changed_genotypes = self._vcf_writer.write(chromosome, superreads, components)
+            logger.info("Done writing VCF")
+            if changed_genotypes:
+                assert self._distrust_genotypes
+                logger.info("Changed %d genotypes while writing VCF", len(changed_genotypes))
+
+        if self._gtchange_list_filename:
+            logger.info("Writing list of changed genotypes to %r", self._gtchange_list_filename)
+            write_changed_genotypes(self._gtchange_list_filename, changed_genotypes)
+
+
+def phase_chromosomes_parallel(
+    variant_tables,
+    family_list,
+    family_trios,
+    reader_args,
+    phaser_args,
+    threads,
+    estimated_units,
+    chromosome_writer,
+    timers,
+    instrumentation=False,
+):
+    """
+    Phase every family on every requested chromosome as a separate work unit in a pool
+    of worker processes. Variant tables are read while the workers phase, but at most
+    PARALLEL_LOOKAHEAD units per worker process (and at least one chromosome) are read and
+    not yet written at any time. Results are buffered and written in the order of the
+    input VCF, such that the output is the same as when phasing serially.
+
+    variant_tables -- iterable of (chromosome, table) pairs for all chromosomes in the VCF,
+        in which table is None for chromosomes that are not requested
+    estimated_units -- expected number of work units, which limits the number of worker
+        processes
+
+    Return the maximum memory used by a DP table, the realignment cache statistics and the
+    counters of the core algorithms (if instrumentation is enabled) of all workers.
+    """
+    processes = min(threads, estimated_units)
+    # threads not needed for running the workers compute large DP columns
+    dp_threads = max(1, threads // processes)
+    lookahead = PARALLEL_LOOKAHEAD * processes
+    logger.info(
+        "Phasing %d %s per chromosome using %d worker processes",
+        len(family_list),
+        plural_s("family", len(family_list)),
+        processes,
+    )
+    dp_peak_memory = 0
+    realignment_cache_stats: Counter = Counter()
+    core_counters: Dict[str, int] = dict()
+    # chromosomes read so far, for each of them the phasings of the families finished so
+    # far, and the number of units that have been read but not written
+    chromosomes: List[Tuple[str, bool]] = []
+    phasings: Dict[int, Dict[int, FamilyPhasing]] = defaultdict(dict)
+    next_chromosome = 0
+    buffered_units = 0
+    # results (or exceptions) of the units are passed from the pool to the main thread
+    results: "queue.Queue[Any]" = queue.Queue()
+    running_units = 0
+
+    def write_finished_chromosomes():
+        nonlocal next_chromosome, buffered_units
+        while next_chromosome < len(chromosomes):
+            chromosome, requested = chromosomes[next_chromosome]
+            if not requested:
+                chromosome_writer.write_unchanged(chromosome)
+            elif len(phasings[next_chromosome]) == len(family_list):
+                finished = phasings.pop(next_chromosome)
+                chromosome_writer.write(
+                    chromosome,
+                    [
+                        (family_trios[representative_sample], finished[family_index])
+                        for family_index, (representative_sample, _) in enumerate(family_list)
+                    ],
+                )
+                buffered_units -= len(family_list)
+                logger.debug("Chromosome %r finished", chromosome)
+            else:
+                break
+            next_chromosome += 1
+
+    tables = iter(variant_tables)
+    with Pool(
+        processes=processes,
+        initializer=_init_phase_worker,
+        initargs=(reader_args, phaser_args, dp_threads, instrumentation),
+    ) as pool:
+        while True:
+            # All families of a chromosome are submitted together, so that the earliest
+            # unwritten chromosome can always be finished
+            while tables is not None and buffered_units < lookahead:
+                try:
+                    chromosome, variant_table = next(tables)
+                except StopIteration:
+                    tables = None
+                    break
+                chromosome_index = len(chromosomes)
+                chromosomes.append((chromosome, variant_table is not None))
+                if variant_table is None:
+                    write_finished_chromosomes()
+                    continue
+                for family_index, (representative_sample, family) in enumerate(family_list):
+                    unit = (
+                        chromosome_index,
+                        family_index,
+                        variant_table,
+                        family,
+                        family_trios[representative_sample],
+                    )
+                    pool.apply_async(
+                        _phase_unit, (unit,), callback=results.put, error_callback=results.put
+                    )
+                    running_units += 1
+                    buffered_units += 1
+            if running_units == 0:
+                break
+            unit_result = results.get()
+            running_units -= 1
+            if isinstance(unit_result, BaseException):
+                raise unit_result
+            chromosome_index, family_index, phasing, elapsed, cache_stats, counters = unit_result
+            phasings[chromosome_index][family_index] = phasing
+            dp_peak_memory = max(dp_peak_memory, phasing.dp_peak_memory)
+            realignment_cache_stats.update(cache_stats)
+            for stage, seconds in elapsed.items():
+                timers.add(stage, seconds)
+            merge_instrumentation(core_counters, counters)
+            write_finished_chromosomes()
+    write_finished_chromosomes()
+    assert next_chromosome == len(chromosomes)
+    return dp_peak_memory, realignment_cache_stats, core_counters
+
+
+_phase_worker_state: Optional[FamilyPhaser] = None
+
+
+def _init_phase_worker(reader_args, phaser_args, dp_threads, instrumentation):
+    global _phase_worker_state
+    set_instrumentation_enabled(instrumentation)
+    # Each worker opens the input files itself as file handles cannot be shared. Worker
+    # processes cannot start processes themselves, so alleles are detected serially.
+    phased_input_reader = PhasedInputReader(**reader_args, threads=1)
+    phased_input_reader.read_vcfs()
+    _phase_worker_state = FamilyPhaser(phased_input_reader, threads=dp_threads, **phaser_args)
+
+
+def _phase_unit(unit):
+    chromosome_index, family_index, variant_table, family, trios = unit
+    assert _phase_worker_state is not None
+    phased_input_reader = _phase_worker_state._phased_input_reader
+    cache_stats_before = Counter(phased_input_reader.realignment_cache_stats)
+    reset_instrumentation()
+    timers = StageTimer()
+    logger.info("======== Working on chromosome %r", variant_table.chromosome)
+    phasing = _phase_worker_state.phase(variant_table, family, trios, timers)
+    cache_stats = Counter(phased_input_reader.realignment_cache_stats)
+    cache_stats.subtract(cache_stats_before)
+    counters = get_instrumentation()
+    return chromosome_index, family_index, phasing, timers.elapsed_times(), cache_stats, counters
 
 
 def compute_overall_components(
@@ -800,10 +1459,23 @@ def find_phaseable_variants(family, include_homozygous: bool, trios, variant_tab
     return homozygous_positions, phasable_variant_table
 
 
-def log_time_and_memory_usage(timers, show_phase_vcfs):
+def log_time_and_memory_usage(
+    timers, show_phase_vcfs, dp_peak_memory=0, realignment_cache_stats=None, background_time=0.0
+):
+    """
+    background_time -- part of the time of the stages that was spent in background threads
+        or worker processes, concurrently with the main thread
+    """
     total_time = timers.total()
     logger.info("\n== SUMMARY ==")
     log_memory_usage()
+    if dp_peak_memory > 0:
+        logger.info("Maximum memory usage of DP table columns: %.3f GB", dp_peak_memory / 1e9)
+    logger.debug(
+        "DP column buffers: %(acquired)d requested, %(reused)d reused, %(allocated)d allocated",
+        get_column_arena_stats(),
+    )
+    log_realignment_cache_stats(realignment_cache_stats)
     # fmt: off
     logger.info("Time spent reading BAM/CRAM:                 %6.1f s", timers.elapsed("read_bam"))
     logger.info("Time spent parsing VCF:                      %6.1f s", timers.elapsed("parse_vcf"))
@@ -813,7 +1485,9 @@ def log_time_and_memory_usage(timers, show_phase_vcfs):
     logger.info("Time spent phasing:                          %6.1f s", timers.elapsed("phase"))
     logger.info("Time spent writing VCF:                      %6.1f s", timers.elapsed("write_vcf"))
     logger.info("Time spent finding components:               %6.1f s", timers.elapsed("components"))
-    logger.info("Time spent on rest:                          %6.1f s", total_time - timers.sum())
+    if background_time > 0:
+        logger.info("Of which in background threads/processes:    %6.1f s", background_time)
+    logger.info("Time spent on rest:                          %6.1f s", max(0.0, total_time - timers.sum() + background_time))
     logger.info("Total elapsed time:                          %6.1f s", total_time)
     # fmt: on
 
@@ -979,8 +1653,33 @@ def add_arguments(parser):
         "HP tag (used by GATK ReadBackedPhasing) (default: %(default)s)")
     arg("--output-read-list", metavar="FILE", default=None, dest="read_list_filename",
         help="Write reads that have been used for phasing to FILE.")
-    arg("--algorithm", choices=("whatshap", "hapchat"), default="whatshap",
-        help="Phasing algorithm to use (default: %(default)s)")
+    arg("--algorithm", choices=("whatshap", "hapchat", "auto"), default="whatshap",
+        help="Phasing algorithm to use. 'auto' uses, for each family and chromosome, the "
+        "algorithm with the lowest running time predicted from the coverage of the variants "
+        "(hapchat only for single individuals) (default: %(default)s)")
+    arg("--threads", "-t", metavar="N", type=int, default=1,
+        help="Number of CPU cores to use for phasing. If there are several chromosomes or "
+        "families, they are phased in up to N worker processes, which share the cores. "
+        "Otherwise, alleles are detected in N worker processes and large columns of the "
+        "phasing DP table are computed on N threads. Compressed VCFs are read and written "
+        "with the same number of threads. The phasing does not depend on this setting "
+        "(default: %(default)s)")
+    arg("--dp-memory-limit", metavar="MB", type=int, default=None,
+        help="Memory available for storing columns of the phasing DP table. If given, as many "
+        "columns as fit are kept in memory to avoid recomputing them during the backtrace. "
+        "Results do not depend on this setting (default: keep every sqrt(n)-th column)")
+    arg("--timers-json", metavar="FILE", default=None,
+        help="Write the time spent in each stage and counters of the core algorithms (computed "
+        "and recomputed DP columns, column sizes and bytes, time per pass) as JSON to FILE")
+    arg("--read-cache", metavar="DIR", default=None,
+        help="Cache the reads and their detected alleles in DIR. Later runs (also of "
+        "'whatshap genotype' and 'whatshap haplotag') on the same input files, variants and "
+        "read selection options reuse them instead of detecting alleles again")
+    arg("--pipeline-depth", metavar="N", type=int, default=0,
+        help="When phasing chromosomes one after another, read up to N chromosomes ahead "
+        "while phasing and write phased chromosomes in the background. Larger values use "
+        "more memory. 0 reads, phases and writes strictly one after another. "
+        "Results do not depend on this setting (default: %(default)s)")
 
     arg = parser.add_argument_group("Input pre-processing, selection and filtering").add_argument
     arg("--merge-reads", dest="read_merging", default=False, action="store_true",
@@ -991,7 +1690,15 @@ def add_arguments(parser):
     arg("--internal-downsampling", metavar="COVERAGE", dest="max_coverage", default=15, type=int,
         help="Coverage reduction parameter in the internal core phasing algorithm. "
         "Higher values increase runtime *exponentially* while possibly improving phasing "
-        "quality marginally. Avoid using this in the normal case! (default: %(default)s)")
+        "quality marginally. Avoid using this in the normal case! At most 23, or "
+        f"{HapChatCore.MAX_COVERAGE} with --algorithm hapchat (default: %(default)s)")
+    arg("--coverage-budget", metavar="MB", type=int, default=None,
+        help="Instead of using the same coverage reduction parameter everywhere, choose it for "
+        f"each window of {COVERAGE_LIMIT_WINDOW} variants between {ADAPTIVE_MIN_COVERAGE} and "
+        f"{ADAPTIVE_MAX_COVERAGE} (for all samples of a family together) such that the phasing "
+        "DP table of a chromosome would need about MB megabytes if all its columns were stored. "
+        "Coverage is reduced least where it is highest, and more on chromosomes with many "
+        "variants. Runtime is roughly proportional to MB. Overrides --internal-downsampling.")
     arg("--mapping-quality", "--mapq", metavar="QUAL",
         default=20, type=int, help="Minimum mapping quality (default: %(default)s)")
     arg("--indels", dest="indels", default=False, action="store_true",
@@ -1005,6 +1712,15 @@ def add_arguments(parser):
     arg("--chromosome", dest="chromosomes", metavar="CHROMOSOME", default=[], action="append",
         help="Name of chromosome to phase. If not given, all chromosomes in the "
         "input VCF are phased. Can be used multiple times.")
+    arg("--region", metavar="REGION", default=None,
+        help="Phase only the variants in REGION (chrom:start-end, 1-based) and a margin around "
+        "it, and write only these variants. The outputs of adjacent regions can be joined with "
+        "'whatshap stitch' if the regions are adjacent. Results come close to phasing the "
+        "whole chromosome if the margin covers the reads at the region borders, but may "
+        "differ where reads are downsampled.")
+    arg("--region-margin", metavar="BP", type=int, default=None,
+        help="Size of the margin around --region (default: twice the longest span of a read "
+        "or read pair at the borders of the region)")
 
     arg = parser.add_argument_group(
         "Read merging",
@@ -1096,8 +1812,23 @@ def validate(args, parser):
         parser.error("Option --use-ped-samples cannot be used together with --samples")
     if len(args.phase_input_files) == 0 and not args.ped:
         parser.error("Not providing any PHASEINPUT files only allowed in --ped mode.")
-    if args.max_coverage > 23:
-        parser.error("Coverage downsampling parameter must not exceed 23.")
+    if args.threads < 1:
+        parser.error("The number of threads must be at least 1.")
+    if args.dp_memory_limit is not None and args.dp_memory_limit < 0:
+        parser.error("The DP memory limit must not be negative.")
+    if args.pipeline_depth < 0:
+        parser.error("The pipeline depth must not be negative.")
+    if args.coverage_budget is not None and args.coverage_budget < 0:
+        parser.error("The coverage budget must not be negative.")
+    if args.region is not None and args.chromosomes:
+        parser.error("Options --region and --chromosome cannot be used together")
+    if args.region_margin is not None and args.region is None:
+        parser.error("Option --region-margin can only be used together with --region")
+    if args.region_margin is not None and args.region_margin < 0:
+        parser.error("The region margin must not be negative.")
+    max_coverage_limit = HapChatCore.MAX_COVERAGE if args.algorithm == "hapchat" else 23
+    if args.max_coverage > max_coverage_limit:
+        parser.error(f"Coverage downsampling parameter must not exceed {max_coverage_limit}.")
     if args.max_coverage_was_used is not None:
         logger.warning(
             "The --max-coverage and -H options are no longer supported. "
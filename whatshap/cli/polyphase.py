@@ -14,33 +14,32 @@ import argparse
 
 from collections import namedtuple
 from copy import deepcopy
-from scipy.stats import binom_test
-from queue import Queue
-from multiprocessing import Pool
 
 from contextlib import ExitStack
 
 from whatshap import __version__
 from whatshap.core import (
+    BlockPhaser,
     Read,
     ReadSet,
     Genotype,
-    ClusterEditingSolver,
     NumericSampleIds,
     compute_polyploid_genotypes,
-    scoreReadsetLocal,
+    compute_linkage_based_block_starts,
+    set_instrumentation_enabled,
+    reset_instrumentation,
+    get_instrumentation,
 )
-from whatshap.cli import log_memory_usage, PhasedInputReader, CommandLineError
-from whatshap.polyphaseplots import draw_plots
-from whatshap.threading import (
-    run_threading,
-    get_local_cluster_consensus_withfrac,
-    get_position_map,
-    get_pos_to_clusters_map,
-    get_cluster_start_end_positions,
-    get_coverage,
-    get_coverage_absolute,
+from whatshap.cli import (
+    log_memory_usage,
+    PhasedInputReader,
+    CommandLineError,
+    write_timers_json,
 )
+from whatshap.polyphaseplots import draw_plots
+from whatshap.threading import get_position_map
+from whatshap.pipeline import BackgroundWorker, prefetch
+from whatshap.readscoreindexcache import ReadScoreIndexCache
 from whatshap.timer import StageTimer
 from whatshap.vcf import VcfReader, PhasedVcfWriter, PloidyError
 
@@ -55,6 +54,8 @@ PhasingParameter = namedtuple(
         "min_overlap",
         "ce_refinements",
         "block_cut_sensitivity",
+        "threading_beam_width",
+        "threading_memory_limit",
         "plot_clusters",
         "plot_threading",
         "threads",
@@ -103,7 +104,12 @@ def run_polyphase(
     plot_threading=False,
     ce_refinements=5,
     block_cut_sensitivity=4,
+    threading_beam_width=0,
+    threading_memory_limit=None,
     threads=1,
+    timers_json=None,
+    pipeline_depth=0,
+    score_index=None,
 ):
     """
     Run Polyploid Phasing.
@@ -118,8 +124,19 @@ def run_polyphase(
     mapping_quality -- discard reads below this mapping quality
     tag -- How to store phasing info in the VCF, can be 'PS' or 'HP'
     write_command_line_header -- whether to add a ##commandline header to the output VCF
+    threading_beam_width -- if positive, number of partial haplotype paths kept per variant in the threading stage
+    threading_memory_limit -- if given, memory (in MB) available for the DP table of the threading stage of each block
+    timers_json -- if given, name of a JSON file to which the time spent in each stage and the counters and timers of
+        the core algorithms are written
+    pipeline_depth -- read up to this many chromosomes ahead in a background thread and write phased chromosomes in
+        another one, such that reading, phasing and writing overlap. 0 (the default) disables this.
+    score_index -- if given, directory in which the overlaps and differences of all read pairs of each chromosome and
+        sample are stored. Later runs on the same reads compute the read similarities from them.
     """
     timers = StageTimer()
+    if timers_json:
+        reset_instrumentation()
+        set_instrumentation_enabled(True)
     logger.info(
         "This is WhatsHap (polyploid) %s running under Python %s",
         __version__,
@@ -153,6 +170,7 @@ def run_polyphase(
                     tag=tag,
                     ploidy=ploidy,
                     include_haploid_sets=include_haploid_sets,
+                    threads=threads,
                 )
             )
         except OSError as e:
@@ -160,7 +178,12 @@ def run_polyphase(
 
         vcf_reader = stack.enter_context(
             VcfReader(
-                variant_file, indels=indels, phases=True, genotype_likelihoods=False, ploidy=ploidy
+                variant_file,
+                indels=indels,
+                phases=True,
+                genotype_likelihoods=False,
+                ploidy=ploidy,
+                threads=threads,
             )
         )
 
@@ -179,6 +202,9 @@ def run_polyphase(
                     "Sample {!r} requested on command-line not found in VCF".format(sample)
                 )
 
+        # the calls of samples that are not phased do not need to be parsed
+        vcf_reader.subset_samples(samples)
+
         if block_cut_sensitivity < 0:
             logger.warning(
                 "Block cut sensitivity was set to negative value. Lowest value (0) is assumed instead."
@@ -191,6 +217,7 @@ def run_polyphase(
             block_cut_sensitivity = 5
 
         samples = frozenset(samples)
+        score_index_cache = ReadScoreIndexCache(score_index) if score_index else None
 
         read_list_file = None
         if read_list_filename:
@@ -205,157 +232,116 @@ def run_polyphase(
             min_overlap=min_overlap,
             ce_refinements=ce_refinements,
             block_cut_sensitivity=block_cut_sensitivity,
+            threading_beam_width=threading_beam_width,
+            threading_memory_limit=threading_memory_limit,
             plot_clusters=plot_clusters,
             plot_threading=plot_threading,
             threads=threads,
         )
 
-        timers.start("parse_vcf")
-        try:
-            for variant_table in vcf_reader:
+        # Stages run in the background threads are timed separately, as their times overlap
+        # with those of the main thread
+        read_timers = StageTimer() if pipeline_depth > 0 else timers
+        write_timers = StageTimer() if pipeline_depth > 0 else timers
+
+        def read_chromosomes():
+            for variant_table in read_timers.iterate("parse_vcf", vcf_reader):
                 chromosome = variant_table.chromosome
-                timers.stop("parse_vcf")
                 if (not chromosomes) or (chromosome in chromosomes):
                     logger.info("======== Working on chromosome %r", chromosome)
                 else:
-                    logger.info(
-                        "Leaving chromosome %r unchanged (present in VCF but not requested by option --chromosome)",
-                        chromosome,
-                    )
-                    with timers("write_vcf"):
-                        superreads, components = dict(), dict()
-                        vcf_writer.write(chromosome, superreads, components)
+                    yield chromosome, None
                     continue
-
-                # These two variables hold the phasing results for all samples
-                superreads, components, haploid_components = dict(), dict(), dict()
-
-                # Iterate over all samples to process
+                sample_inputs = []
                 for sample in samples:
-                    logger.info("---- Processing individual %s", sample)
-
-                    # Process inputs for this sample
-                    missing_genotypes = set()
-                    heterozygous = set()
-
-                    genotypes = variant_table.genotypes_of(sample)
-                    for index, gt in enumerate(genotypes):
-                        if gt.is_none():
-                            missing_genotypes.add(index)
-                        elif not gt.is_homozygous():
-                            heterozygous.add(index)
-                        else:
-                            assert gt.is_homozygous()
-                    to_discard = set(range(len(variant_table))).difference(heterozygous)
-                    phasable_variant_table = deepcopy(variant_table)
-                    # Remove calls to be discarded from variant table
-                    phasable_variant_table.remove_rows_by_index(to_discard)
-
-                    logger.info(
-                        "Number of variants skipped due to missing genotypes: %d",
-                        len(missing_genotypes),
-                    )
-                    logger.info(
-                        "Number of remaining heterozygous variants: %d", len(phasable_variant_table)
+                    readset, phasable_variant_table = read_sample(
+                        phased_input_reader,
+                        variant_table,
+                        sample,
+                        ploidy,
+                        verify_genotypes,
+                        min_overlap,
+                        read_timers,
                     )
+                    sample_inputs.append((sample, readset, phasable_variant_table))
+                yield chromosome, sample_inputs
+
+        def write_unchanged(chromosome):
+            with write_timers("write_vcf"):
+                vcf_writer.write(chromosome, dict(), dict())
+
+        def write_chromosome(chromosome, superreads, components, haploid_components):
+            with write_timers("write_vcf"):
+                logger.info("======== Writing VCF")
+                vcf_writer.write(
+                    chromosome,
+                    superreads,
+                    components,
+                    haploid_components if include_haploid_sets else None,
+                )
+                # TODO: Use genotype information to polish results
+                # assert len(changed_genotypes) == 0
+                logger.info("Done writing VCF")
+            logger.debug("Chromosome %r finished", chromosome)
 
-                    # Get the reads belonging to this sample
-                    timers.start("read_bam")
-                    readset, vcf_source_ids = phased_input_reader.read(
-                        chromosome, phasable_variant_table.variants, sample
-                    )
-                    readset.sort()
-                    timers.stop("read_bam")
-
-                    # Verify genotypes
-                    if verify_genotypes:
-                        timers.start("verify_genotypes")
-                        logger.info("Verify genotyping of %s", sample)
-                        positions = [v.position for v in phasable_variant_table.variants]
-                        computed_genotypes = [
-                            Genotype(gt)
-                            for gt in compute_polyploid_genotypes(readset, ploidy, positions)
-                        ]
-                        # skip all positions at which genotypes do not match
-                        given_genotypes = phasable_variant_table.genotypes_of(sample)
-                        matching_genotypes = []
-                        missing_genotypes = set()
-                        print(computed_genotypes, len(computed_genotypes))
-                        print(given_genotypes, len(given_genotypes))
-                        print(len(positions))
-                        for i, g in enumerate(given_genotypes):
-                            c_g = computed_genotypes[i]
-                            if (g == c_g) or (c_g is None):
-                                matching_genotypes.append(g)
-                            else:
-                                matching_genotypes.append(Genotype([]))
-                                missing_genotypes.add(i)
-                        phasable_variant_table.set_genotypes_of(sample, matching_genotypes)
-
-                        # Remove variants with deleted genotype
-                        phasable_variant_table.remove_rows_by_index(missing_genotypes)
+        try:
+            # The next chromosome is read and the previous one written while phasing
+            with BackgroundWorker(pipeline_depth) as writer:
+                for chromosome, sample_inputs in prefetch(read_chromosomes(), pipeline_depth):
+                    if sample_inputs is None:
                         logger.info(
-                            "Number of variants removed due to inconsistent genotypes: %d",
-                            len(missing_genotypes),
+                            "Leaving chromosome %r unchanged (present in VCF but not requested "
+                            "by option --chromosome)",
+                            chromosome,
                         )
-                        logger.info(
-                            "Number of remaining heterozygous variants: %d",
-                            len(phasable_variant_table),
+                        writer.submit(write_unchanged, chromosome)
+                        continue
+
+                    # These variables hold the phasing results for all samples
+                    superreads, components, haploid_components = dict(), dict(), dict()
+                    for sample, readset, phasable_variant_table in sample_inputs:
+                        index = None
+                        if score_index_cache is not None:
+                            with timers("read_scoring"):
+                                index = score_index_cache.get(readset, min_overlap, threads)
+
+                        # Run the actual phasing
+                        (
+                            sample_components,
+                            sample_haploid_components,
+                            sample_superreads,
+                        ) = phase_single_individual(
+                            readset,
+                            phasable_variant_table,
+                            sample,
+                            phasing_param,
+                            output,
+                            timers,
+                            index,
                         )
 
-                        # Re-read the readset to remove discarded variants
-                        readset, vcf_source_ids = phased_input_reader.read(
-                            chromosome, phasable_variant_table.variants, sample
-                        )
-                        readset.sort()
-                        timers.stop("verify_genotypes")
+                        # Collect results
+                        components[sample] = sample_components
+                        haploid_components[sample] = sample_haploid_components
+                        superreads[sample] = sample_superreads
 
-                    # Remove reads with insufficient variants
-                    readset = readset.subset(
-                        [i for i, read in enumerate(readset) if len(read) >= max(2, min_overlap)]
+                    writer.submit(
+                        write_chromosome, chromosome, superreads, components, haploid_components
                     )
-                    logger.info("Kept %d reads that cover at least two variants each", len(readset))
-
-                    # Adapt the variant table to the subset of reads
-                    phasable_variant_table.subset_rows_by_position(readset.get_positions())
-
-                    # Run the actual phasing
-                    (
-                        sample_components,
-                        sample_haploid_components,
-                        sample_superreads,
-                    ) = phase_single_individual(
-                        readset, phasable_variant_table, sample, phasing_param, output, timers
-                    )
-
-                    # Collect results
-                    components[sample] = sample_components
-                    haploid_components[sample] = sample_haploid_components
-                    superreads[sample] = sample_superreads
-
-                with timers("write_vcf"):
-                    logger.info("======== Writing VCF")
-                    vcf_writer.write(
-                        chromosome,
-                        superreads,
-                        components,
-                        haploid_components if include_haploid_sets else None,
-                    )
-                    # TODO: Use genotype information to polish results
-                    # assert len(changed_genotypes) == 0
-                    logger.info("Done writing VCF")
-                logger.debug("Chromosome %r finished", chromosome)
-                timers.start("parse_vcf")
-            timers.stop("parse_vcf")
         except PloidyError as e:
             raise CommandLineError(e)
+        background_time = 0.0
+        if pipeline_depth > 0:
+            background_time = read_timers.sum() + write_timers.sum()
+            timers.merge(read_timers)
+            timers.merge(write_timers)
 
     if read_list_file:
         read_list_file.close()
 
     logger.info("\n== SUMMARY ==")
 
-    log_memory_usage(include_children=(threads > 1))
+    log_memory_usage()
     logger.info("Time spent reading BAM/CRAM:                 %6.1f s", timers.elapsed("read_bam"))
     logger.info("Time spent parsing VCF:                      %6.1f s", timers.elapsed("parse_vcf"))
     if verify_genotypes:
@@ -366,38 +352,133 @@ def run_polyphase(
     logger.info(
         "Time spent detecting blocks:                 %6.1f s", timers.elapsed("detecting_blocks")
     )
-    if threads == 1:
-        logger.info(
-            "Time spent scoring reads:                    %6.1f s", timers.elapsed("read_scoring")
-        )
-        logger.info(
-            "Time spent solving cluster editing:          %6.1f s",
-            timers.elapsed("solve_clusterediting"),
-        )
-        logger.info(
-            "Time spent threading haplotypes:             %6.1f s", timers.elapsed("threading")
-        )
-    else:
-        """
-        TODO: The runtime measurement for the different stages does not properly for multithreading,
-        because the global timer is not visible from within the phase_single_block_mt method.
-        Workaround is to only report the total phasing time.
-        """
+    if score_index_cache is not None:
         logger.info(
-            "Time spent phasing blocks:                   %6.1f s", timers.elapsed("phase_blocks")
+            "Time spent indexing read pairs:              %6.1f s", timers.elapsed("read_scoring")
         )
+    # blocks are phased natively (read scoring, cluster editing and threading in one pass)
+    logger.info(
+        "Time spent phasing blocks:                   %6.1f s", timers.elapsed("phase_blocks")
+    )
     if plot_clusters or plot_threading:
         logger.info(
             "Time spent creating plots:                   %6.1f s", timers.elapsed("create_plots")
         )
     logger.info("Time spent writing VCF:                      %6.1f s", timers.elapsed("write_vcf"))
+    if background_time > 0:
+        logger.info("Of which in background threads:             %6.1f s", background_time)
     logger.info(
-        "Time spent on rest:                          %6.1f s", timers.total() - timers.sum()
+        "Time spent on rest:                          %6.1f s",
+        max(0.0, timers.total() - timers.sum() + background_time),
     )
     logger.info("Total elapsed time:                          %6.1f s", timers.total())
+    if timers_json:
+        set_instrumentation_enabled(False)
+        write_timers_json(timers_json, timers, get_instrumentation())
+
+
+def read_sample(
+    phased_input_reader, variant_table, sample, ploidy, verify_genotypes, min_overlap, timers
+):
+    """
+    Read the alignments of a sample on a chromosome, keeping only heterozygous variants
+    (with verified genotypes if verify_genotypes is set) and reads covering enough of them.
+
+    Return the read set and the table of the variants that can be phased.
+    """
+    logger.info("---- Processing individual %s", sample)
+    chromosome = variant_table.chromosome
+
+    # Process inputs for this sample
+    missing_genotypes = set()
+    heterozygous = set()
+
+    genotypes = variant_table.genotypes_of(sample)
+    for index, gt in enumerate(genotypes):
+        if gt.is_none():
+            missing_genotypes.add(index)
+        elif not gt.is_homozygous():
+            heterozygous.add(index)
+        else:
+            assert gt.is_homozygous()
+    to_discard = set(range(len(variant_table))).difference(heterozygous)
+    phasable_variant_table = deepcopy(variant_table)
+    # Remove calls to be discarded from variant table
+    phasable_variant_table.remove_rows_by_index(to_discard)
+
+    logger.info(
+        "Number of variants skipped due to missing genotypes: %d",
+        len(missing_genotypes),
+    )
+    logger.info("Number of remaining heterozygous variants: %d", len(phasable_variant_table))
+
+    # Get the reads belonging to this sample
+    timers.start("read_bam")
+    readset, vcf_source_ids = phased_input_reader.read(
+        chromosome, phasable_variant_table.variants, sample
+    )
+    readset.sort()
+    timers.stop("read_bam")
+
+    # Verify genotypes
+    if verify_genotypes:
+        timers.start("verify_genotypes")
+        logger.info("Verify genotyping of %s", sample)
+        positions = [v.position for v in phasable_variant_table.variants]
+        computed_genotypes = [
+            Genotype(gt) for gt in compute_polyploid_genotypes(readset, ploidy, positions)
+        ]
+        # skip all positions at which genotypes do not match
+        given_genotypes = phasable_variant_table.genotypes_of(sample)
+        matching_genotypes = []
+        missing_genotypes = set()
+        print(computed_genotypes, len(computed_genotypes))
+        print(given_genotypes, len(given_genotypes))
+        print(len(positions))
+        for i, g in enumerate(given_genotypes):
+            c_g = computed_genotypes[i]
+            if (g == c_g) or (c_g is None):
+                matching_genotypes.append(g)
+            else:
+                matching_genotypes.append(Genotype([]))
+                missing_genotypes.add(i)
+        phasable_variant_table.set_genotypes_of(sample, matching_genotypes)
 
+        # Remove variants with deleted genotype
+        phasable_variant_table.remove_rows_by_index(missing_genotypes)
+        logger.info(
+            "Number of variants removed due to inconsistent genotypes: %d",
+            len(missing_genotypes),
+        )
+        logger.info(
+            "Number of remaining heterozygous variants: %d",
+            len(phasable_variant_table),
+        )
+
+        # Re-read the readset to remove discarded variants
+        readset, vcf_source_ids = phased_input_reader.read(
+            chromosome, phasable_variant_table.variants, sample
+        )
+        readset.sort()
+        timers.stop("verify_genotypes")
+
+    # Remove reads with insufficient variants
+    readset = readset.subset(
+        [i for i, read in enumerate(readset) if len(read) >= max(2, min_overlap)]
+    )
+    logger.info("Kept %d reads that cover at least two variants each", len(readset))
 
-def phase_single_individual(readset, phasable_variant_table, sample, phasing_param, output, timers):
+    # Adapt the variant table to the subset of reads
+    phasable_variant_table.subset_rows_by_position(readset.get_positions())
+    return readset, phasable_variant_table
+
+
+def phase_single_individual(
+    readset, phasable_variant_table, sample, phasing_param, output, timers, score_index=None
+):
+    """
+    If score_index (a ReadScoreIndex of the readset) is given, the read similarities of each block are computed from it.
+    """
 
     # Compute the genotypes that belong to the variant table and create a list of all genotypes
     genotype_list = create_genotype_list(phasable_variant_table, sample)
@@ -415,11 +496,11 @@ def phase_single_individual(readset, phasable_variant_table, sample, phasing_par
         block_starts = [0]
     elif phasing_param.block_cut_sensitivity == 1:
         block_starts = compute_linkage_based_block_starts(
-            readset, index, phasing_param.ploidy, single_linkage=True
+            readset, phasing_param.ploidy, single_linkage=True
         )
     else:
         block_starts = compute_linkage_based_block_starts(
-            readset, index, phasing_param.ploidy, single_linkage=False
+            readset, phasing_param.ploidy, single_linkage=False
         )
 
     # Set block borders and split readset
@@ -455,91 +536,39 @@ def phase_single_individual(readset, phasable_variant_table, sample, phasing_par
         assert len(block_readset.get_positions()) == block_num_vars
         genotype_slices.append(genotype_list[block_start:block_end])
 
-    processed_non_singleton_blocks = 0
-    # use process pool for multiple threads
-    if phasing_param.threads == 1:
-        # for single-threading, process everything individually to minimize memory footprint
-        for block_id, block_readset in enumerate(block_readsets):
-            block_num_vars = ext_block_starts[block_id + 1] - ext_block_starts[block_id]
-            if block_num_vars > 1:
-                # Only print for non-singleton block
-                processed_non_singleton_blocks += 1
-                logger.info(
-                    "Processing block {} of {} with {} reads and {} variants.".format(
-                        processed_non_singleton_blocks,
-                        num_non_singleton_blocks,
-                        len(block_readset),
-                        block_num_vars,
-                    )
-                )
-
-            clustering, path, haplotypes, cut_positions, haploid_cuts = phase_single_block(
-                block_readset, genotype_slices[block_id], phasing_param, timers
-            )
-
-            blockwise_clustering.append(clustering)
-            blockwise_paths.append(path)
-            blockwise_haplotypes.append(haplotypes)
-            blockwise_cut_positions.append(cut_positions)
-            blockwise_haploid_cuts.append(haploid_cuts)
+    timers.start("phase_blocks")
+    logger.info(
+        "Phasing {} blocks on up to {} threads.".format(
+            num_non_singleton_blocks, phasing_param.threads
+        )
+    )
 
-    else:
-        # sort block readsets in descending order by number of reads
-        joblist = [(i, len(block_readsets[i])) for i in range(len(block_readsets))]
-        joblist.sort(key=lambda x: -x[1])
-
-        timers.start("phase_blocks")
-
-        # process large jobs first, 4/3-approximation for scheduling problem
-        with Pool(processes=phasing_param.threads) as pool:
-            """
-            TODO: Python's multiprocessing makes hard copies of the passed
-            arguments, which is not trivial for cython objects, especially when they
-            contain pointers to other cython objects. Any passed object must be
-            (de)serializable (in Python: pickle).
-            All other objects created in the main thread are also accessible by the
-            workers, but they are handled via the copy-on-write policy. This means,
-            that e.g. the large main readset is not hardcopied for every thread,
-            as long as it is not modified there. Since this would cause a massive
-            waste of memory, this must not be done and the main readset must
-            also never be passed as argument to the workers.
-            """
-            process_results = [
-                pool.apply_async(
-                    phase_single_block_mt,
-                    (
-                        block_readsets[block_id],
-                        genotype_slices[block_id],
-                        phasing_param,
-                        timers,
-                        block_id,
-                        job_id,
-                        num_non_singleton_blocks,
-                    ),
-                )
-                for job_id, (block_id, block_readset) in enumerate(joblist)
-            ]
-            blockwise_results = [res.get() for res in process_results]
-
-            # reorder results again
-            blockwise_results.sort(key=lambda x: x[-1])
-
-            # collect all blockwise results
-            for (
-                clustering,
-                path,
-                haplotypes,
-                cut_positions,
-                haploid_cuts,
-                block_id,
-            ) in blockwise_results:
-                blockwise_clustering.append(clustering)
-                blockwise_paths.append(path)
-                blockwise_haplotypes.append(haplotypes)
-                blockwise_cut_positions.append(cut_positions)
-                blockwise_haploid_cuts.append(haploid_cuts)
-
-        timers.stop("phase_blocks")
+    # worker threads phase the largest blocks first and share the (read-only) block readsets
+    phaser = BlockPhaser(
+        phasing_param.ploidy,
+        phasing_param.min_overlap,
+        phasing_param.ce_bundle_edges,
+        phasing_param.ce_refinements,
+        phasing_param.block_cut_sensitivity,
+        phasing_param.threading_beam_width,
+        (phasing_param.threading_memory_limit or 0) * 1024**2,
+        phasing_param.threads,
+    )
+    for (
+        clustering,
+        path,
+        haplotypes,
+        cut_positions,
+        haploid_cuts,
+    ) in phaser.phase_blocks(block_readsets, genotype_slices, score_index, ext_block_starts):
+        blockwise_clustering.append(clustering)
+        blockwise_paths.append(path)
+        blockwise_haplotypes.append(haplotypes)
+        blockwise_cut_positions.append(cut_positions)
+        blockwise_haploid_cuts.append(haploid_cuts)
+    del phaser
+
+    timers.stop("phase_blocks")
 
     # Aggregate blockwise results
     clustering, threading, haplotypes, cut_positions, haploid_cuts = aggregate_phasing_blocks(
@@ -671,145 +700,6 @@ def split_readset(readset, ext_block_starts, index):
     return block_readsets
 
 
-def phase_single_block(block_readset, genotype_slice, phasing_param, timers):
-    """
-    Takes as input data the reads from a single (pre-computed) block and the genotypes for all variants inside the block.
-    Also requires a ploidy and block cut sensitivity as parameters. Runs a two-phase algorithm to compute a phasing for
-    this isolated block. The phasing algorithm may create additional block cut, i.e. it may indicate where new phasing
-    blocks should start.
-
-    Output are four objects:
-
-    clustering -- A list of clusters, which were the result of the cluster editing step. A cluster is a list of read ids.
-    path -- A list with one entry per variant. Each entry contains the tuple of clusters, through which the haplotypes
-            have been threaded in the threading step.
-    haplotypes -- A list containing the haplotypes. A haplotype is a string over allele ids, one allele per variant.
-    cut_positions -- A list of variant positions, where the phasing blocks start. The positions do not refer to genome
-                     positions (in base pairs), but to the variant id inside this block. 0 is always contained, since a
-                     block needs to start at the beginning of the given input, but it can contain more positions.
-    """
-
-    block_num_vars = len(block_readset.get_positions())
-
-    # Check for singleton blocks and handle them differently (for efficiency reasons)
-    if block_num_vars == 1:
-
-        # construct trivial solution for singleton blocks, by basically using the genotype as phasing
-        allele_to_id = dict()
-        for allele in genotype_slice[0]:
-            if allele not in allele_to_id:
-                allele_to_id[allele] = len(allele_to_id)
-        clustering = [[] for _ in range(len(allele_to_id))]
-        for i, read in enumerate(block_readset):
-            clustering[allele_to_id[read[0].allele]].append(i)
-
-        path = [[]]
-        haplotypes = []
-        for allele in genotype_slice[0]:
-            for i in range(genotype_slice[0][allele]):
-                path[0].append(allele_to_id[allele])
-                haplotypes.append(str(allele))
-
-        return clustering, path, haplotypes, [0], [[0] for _ in range(phasing_param.ploidy)]
-
-    # Block is non-singleton here, so run the normal routine
-    # Phase I: Cluster Editing
-
-    # Compute similarity values for all read pairs
-    timers.start("read_scoring")
-    logger.debug("Computing similarities for read pairs ...")
-    similarities = scoreReadsetLocal(block_readset, phasing_param.min_overlap, phasing_param.ploidy)
-
-    # Run cluster editing
-    logger.debug(
-        "Solving cluster editing instance with {} nodes and {} edges ..".format(
-            len(block_readset), len(similarities)
-        )
-    )
-    timers.stop("read_scoring")
-    timers.start("solve_clusterediting")
-    solver = ClusterEditingSolver(similarities, phasing_param.ce_bundle_edges)
-    clustering = solver.run()
-    del solver
-
-    # Refine clusters by solving inconsistencies in consensus
-    runs_remaining = phasing_param.ce_refinements
-    last_inc_count = len(clustering) * (block_num_vars)  # worst case number
-    refine = True
-    while refine and runs_remaining > 0:
-        """
-        Inconsistencies are positions, whre a cluster has a very ambiguous consensus, indicating that it contains reads from
-        two or more haplotypes, which differ on some SNP variants
-        """
-        refine = False
-        runs_remaining -= 1
-        new_inc_count, seperated_reads = find_inconsistencies(
-            block_readset, clustering, phasing_param.ploidy
-        )
-        for (r0, r1) in seperated_reads:
-            similarities.set(r0, r1, -float("inf"))
-
-        if 0 < new_inc_count < last_inc_count:
-            logger.debug(
-                "{} inconsistent variants found. Refining clusters ..\r".format(new_inc_count)
-            )
-            solver = ClusterEditingSolver(similarities, phasing_param.ce_bundle_edges)
-            clustering = solver.run()
-            del solver
-
-    # Deallocate big datastructures, which are not needed anymore
-    del similarities
-
-    # Add trailing isolated nodes to single-ton clusters, if missing
-    nodes_in_c = sum([len(c) for c in clustering])
-    for i in range(nodes_in_c, len(block_readset)):
-        clustering.append([i])
-
-    timers.stop("solve_clusterediting")
-
-    # Phase II: Threading
-
-    # Assemble clusters to haplotypes
-    logger.debug("Threading haplotypes through {} clusters..\r".format(len(clustering)))
-    timers.start("threading")
-
-    # Add dynamic programming for finding the most likely subset of clusters
-    cut_positions, haploid_cuts, path, haplotypes = run_threading(
-        block_readset,
-        clustering,
-        phasing_param.ploidy,
-        genotype_slice,
-        phasing_param.block_cut_sensitivity,
-    )
-    timers.stop("threading")
-
-    # collect results from threading
-    return clustering, path, haplotypes, cut_positions, haploid_cuts
-
-
-def phase_single_block_mt(
-    block_readset, genotype_slice, phasing_param, timers, block_id, job_id, num_blocks
-):
-    """
-    Wrapper for the phase_single_block() function. Carries a block_id through to the results
-    and unpythonizes the given readset, because cython objects are very troublesome to hardcopy.
-    """
-    block_vars = len(block_readset.get_positions())
-    if block_vars > 1:
-        logger.info(
-            "Phasing block {} of {} with {} reads and {} variants.".format(
-                job_id + 1, num_blocks, len(block_readset), block_vars
-            )
-        )
-    clustering, path, haplotypes, cut_positions, haploid_cuts = phase_single_block(
-        block_readset, genotype_slice, phasing_param, timers
-    )
-    del block_readset
-    if block_vars > 1:
-        logger.info("Finished block {}.".format(job_id + 1))
-    return clustering, path, haplotypes, cut_positions, haploid_cuts, block_id
-
-
 def aggregate_phasing_blocks(
     block_starts,
     block_readsets,
@@ -857,148 +747,6 @@ def aggregate_phasing_blocks(
     return clustering, threading, haplotypes, cut_positions, haploid_cuts
 
 
-def find_inconsistencies(readset, clustering, ploidy):
-    # Returns the number of cluster positions with inconsistencies
-    # (counts position multiple times, if multiple clusters are inconsistent there)
-    # Also returns a list of read pairs, which need to be seperated
-    num_inconsistent_positions = 0
-    separated_pairs = []
-    exp_error = 0.05
-    p_val_threshold = 0.02
-
-    # Compute consensus and coverage
-    index, rev_index = get_position_map(readset)
-    num_vars = len(rev_index)
-
-    coverage = get_coverage(readset, clustering, index)
-    cov_map = get_pos_to_clusters_map(coverage, ploidy)
-    positions = get_cluster_start_end_positions(readset, clustering, index)
-    abs_coverage = get_coverage_absolute(readset, clustering, index)
-    consensus = get_local_cluster_consensus_withfrac(readset, clustering, cov_map, positions)
-
-    # Search for positions in clusters with ambivalent consensus
-    for pos in range(num_vars):
-        # print(str(pos)+" -> "+str(len(coverage[pos]))+" , "+str(len(consensus[pos])))
-        for c_id in coverage[pos]:
-            if c_id not in consensus[pos]:
-                continue
-            # do binomial hypothesis test, whether the deviations from majority allele is significant enough for splitting
-            abs_count = abs_coverage[pos][c_id]
-            abs_deviations = int(abs_count * (1 - consensus[pos][c_id][1]))
-            p_val = binom_test(abs_deviations, abs_count, exp_error, alternative="greater")
-            if p_val < p_val_threshold:
-                # print("   inconsistency in cluster "+str(c_id)+" at position"+str(pos)+" with coverage "+str(coverage[pos][c_id])+" and consensus "+str(consensus[pos][c_id]))
-                num_inconsistent_positions += 1
-                zero_reads = []
-                one_reads = []
-                for read in clustering[c_id]:
-                    for var in readset[read]:
-                        if index[var.position] == pos:
-                            if var.allele == 0:
-                                zero_reads.append(read)
-                            else:
-                                one_reads.append(read)
-                for r0 in zero_reads:
-                    for r1 in one_reads:
-                        separated_pairs.append((r0, r1))
-
-    return num_inconsistent_positions, separated_pairs
-
-
-def compute_linkage_based_block_starts(readset, pos_index, ploidy, single_linkage=False):
-    """
-    Based on the connectivity of the reads, we want to divide the phasing input, as non- or poorly connected
-    regions can be phased independently. This is done based on how pairs of variants are connected. There are
-    two modes how to decide whether two variants are connected:
-
-    single_linkage=True -- If there exists a read in the readset, which covers both variants, they are connected
-    single_linkage=False -- In order to connect two variants, we need at least reads from ploidy-1 different
-                            haplotypes. Two variants count as connected, if there sufficiently many reads covering
-                            both variants, with "sufficient" meaning, that the connecting reads have a chance of
-                            at least 98% that they cover at least ploidy-1 haplotypes.
-
-    First, only consecutive pairs are inspected. Then, this connectivity is made transitive, i.e. if the pair
-    (A,C) is connected, as well as the pair (B,C), then (A,B) is also connected. If the special case occurs, that
-    for three variants (in this order) A and C are connected, but neither is connected to variant B in between them,
-    then the variants are still divided as A|B|C, even though A and C are actually connected. This is because the
-    following steps require the splits to be intervals with no "holes" inside them.
-    """
-
-    num_vars = len(pos_index)
-
-    # special case
-    if num_vars == 0:
-        return []
-
-    # cut threshold
-    if ploidy == 2 or single_linkage:
-        cut_threshold = 1
-    else:
-        cut_threshold = ploidy * ploidy
-        for i in range(ploidy - 1, ploidy * ploidy):
-            # chance to cover at most ploidy-2 haplotypes with i reads
-            cut_threshold = i
-            if ploidy * pow((ploidy - 2) / ploidy, i) < 0.02:
-                cut_threshold = i
-                break
-    logger.debug("Cut position threshold: coverage >= {}".format(cut_threshold))
-
-    # start by looking at neighbouring
-    link_to_next = [0 for i in range(num_vars)]
-    starts = []
-    ends = []
-    for read in readset:
-        pos_list = [pos_index[var.position] for var in read]
-        starts.append(pos_list[0])
-        ends.append(pos_list[-1])
-        for i in range(len(pos_list) - 1):
-            if pos_list[i] + 1 == pos_list[i + 1]:
-                link_to_next[pos_list[i]] += 1
-
-    pos_clust = [0 for i in range(num_vars)]
-    for i in range(1, num_vars):
-        if link_to_next[i - 1] >= cut_threshold:
-            pos_clust[i] = pos_clust[i - 1]
-        else:
-            pos_clust[i] = pos_clust[i - 1] + 1
-    num_clust = pos_clust[-1] + 1
-
-    # find linkage between clusters
-    link_coverage = [dict() for i in range(num_clust)]
-    for i, (start, end) in enumerate(zip(starts, ends)):
-        covered_pos_clusts = set([pos_clust[pos_index[var.position]] for var in readset[i]])
-        for p1 in covered_pos_clusts:
-            for p2 in covered_pos_clusts:
-                if p2 not in link_coverage[p1]:
-                    link_coverage[p1][p2] = 0
-                link_coverage[p1][p2] += 1
-
-    # merge clusters
-    merged_clust = [-1 for i in range(num_clust)]
-    new_num_clust = 0
-    for i in range(num_clust):
-        if merged_clust[i] >= 0:
-            continue
-        q = Queue()
-        q.put(i)
-        merged_clust[i] = new_num_clust
-        while not q.empty():
-            cur = q.get()
-            for linked in link_coverage[cur]:
-                if merged_clust[linked] < 0 and link_coverage[cur][linked] >= cut_threshold:
-                    q.put(linked)
-                    merged_clust[linked] = new_num_clust
-        new_num_clust += 1
-
-    # determine cut positions
-    cuts = [0]
-    for i in range(1, num_vars):
-        if merged_clust[pos_clust[i]] != merged_clust[pos_clust[i - 1]]:
-            cuts.append(i)
-
-    return cuts
-
-
 def add_arguments(parser):
     arg = parser.add_argument
     # Positional argument
@@ -1131,6 +879,29 @@ def add_arguments(parser):
         default=4,
         help="Strategy to determine block borders. 0 yields the longest blocks with more switch errors, 5 has the shortest blocks with lowest switch error rate (default: %(default)s).",
     )
+    arg(
+        "--threading-beam-width",
+        metavar="WIDTH",
+        type=int,
+        default=0,
+        help="Number of partial haplotype paths kept per variant in the threading stage. Smaller values "
+        "are faster, but may yield a less optimal threading. 0 keeps all paths (default: %(default)s).",
+    )
+    arg(
+        "--threading-memory-limit",
+        metavar="MB",
+        type=int,
+        default=None,
+        help="Memory available for the DP table of the threading stage (per block). If given, the number "
+        "of partial haplotype paths per variant is limited accordingly (default: no limit).",
+    )
+    arg(
+        "--timers-json",
+        metavar="FILE",
+        default=None,
+        help="Write the time spent in each stage and counters of the core algorithms (cluster editing, "
+        "haplotype threading) as JSON to FILE.",
+    )
     arg(
         "--threads",
         "-t",
@@ -1139,6 +910,24 @@ def add_arguments(parser):
         default=1,
         help="Maximum number of CPU threads used (default: %(default)s).",
     )
+    arg(
+        "--score-index",
+        metavar="DIR",
+        default=None,
+        help="Store the overlaps and differences of all read pairs of each chromosome and sample "
+        "in DIR. Later runs on the same reads (for example with another ploidy or "
+        "--block-cut-sensitivity) compute the read similarities from them instead of comparing "
+        "the reads again. Results do not depend on this setting.",
+    )
+    arg(
+        "--pipeline-depth",
+        metavar="N",
+        type=int,
+        default=0,
+        help="Read up to N chromosomes ahead while phasing and write phased chromosomes in the "
+        "background. Larger values use more memory. 0 reads, phases and writes strictly one after "
+        "another. Results do not depend on this setting (default: %(default)s).",
+    )
 
     # more arguments, which are experimental or for debugging and should not be presented to the user
     arg(
@@ -1165,7 +954,12 @@ def add_arguments(parser):
 
 
 def validate(args, parser):
-    pass
+    if args.threading_beam_width < 0:
+        parser.error("--threading-beam-width must not be negative")
+    if args.threading_memory_limit is not None and args.threading_memory_limit <= 0:
+        parser.error("--threading-memory-limit must be positive")
+    if args.pipeline_depth < 0:
+        parser.error("--pipeline-depth must not be negative")
 
 
 def main(args):
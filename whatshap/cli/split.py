@@ -7,6 +7,8 @@ BAM mode is intended for unmapped BAMs (such as provided by PacBio).
 """
 import logging
 import os
+import queue
+import threading
 import pysam
 from collections import defaultdict, Counter
 import itertools
@@ -48,6 +50,10 @@ def add_arguments(parser):
         'and the haplotag list file.')
     arg('--read-lengths-histogram', default=None,
         help='Output file to write read lengths histogram to in tab separated format.')
+    arg('--threads', '-t', metavar='N', type=int, default=1,
+        help='Number of threads to use. With more than one thread, BAM input is decompressed '
+        'by multiple threads, and each output is written by its own thread, which also uses '
+        'multiple threads for compression (default: %(default)s).')
     arg('reads_file', metavar='READS', help='Input FASTQ/BAM file with reads (FASTQ can be gzipped)')
     arg('list_file', metavar='LIST',
         help='Tab-separated list with (at least) two columns <readname> and <haplotype> (can be gzipped). '
@@ -62,6 +68,8 @@ def validate(args, parser):
         parser.error(
             "Nothing to be done since neither --output-h1 nor --output-h2 nor --output-untagged are given."
         )
+    if args.threads < 1:
+        parser.error("Number of threads must be at least 1.")
 
 
 def select_reads_in_largest_phased_blocks(block_sizes, block_to_readnames):
@@ -257,13 +265,71 @@ def check_haplotag_list_information(haplotag_list, exit_stack):
     return haplo_list, has_chrom_info, line_parser
 
 
-def initialize_io_files(reads_file, output_h1, output_h2, output_untagged, exit_stack):
+class WriterThread:
+    """
+    Write records to an output in a separate thread. The records are passed on in batches, so
+    for most records, the reading thread only appends them to a list. Records are written in the
+    order in which they are passed.
+    """
+
+    BATCH_SIZE = 1000
+    # maximum number of batches waiting to be written
+    MAX_QUEUED_BATCHES = 16
+
+    def __init__(self, writer):
+        self._writer = writer
+        self._batch = []
+        self._queue = queue.Queue(maxsize=self.MAX_QUEUED_BATCHES)
+        self._error = None
+        self._thread = threading.Thread(target=self._run, daemon=True)
+        self._thread.start()
+
+    def write(self, record):
+        self._batch.append(record)
+        if len(self._batch) >= self.BATCH_SIZE:
+            self._queue.put(self._batch)
+            self._batch = []
+
+    def close(self):
+        """Write all remaining records and wait for the thread to finish"""
+        if self._batch:
+            self._queue.put(self._batch)
+            self._batch = []
+        self._queue.put(None)
+        self._thread.join()
+        if self._error is not None:
+            raise self._error
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def _run(self):
+        while True:
+            batch = self._queue.get()
+            if batch is None:
+                break
+            if self._error is not None:
+                # keep consuming, so the reading thread does not block
+                continue
+            try:
+                for record in batch:
+                    self._writer.write(record)
+            except Exception as e:
+                self._error = e
+
+
+def initialize_io_files(reads_file, output_h1, output_h2, output_untagged, exit_stack, threads=1):
     """
     :param reads_file:
     :param output_h1:
     :param output_h2:
     :param output_untagged:
     :param exit_stack:
+    :param threads: if larger than 1, the outputs are written by WriterThreads, and BAM input
+        and outputs are (de)compressed by multiple threads
     :return:
     """
     potential_fastq_extensions = ["fastq", "fastq.gz", "fastq.gzip" "fq", "fq.gz" "fq.gzip"]
@@ -291,20 +357,27 @@ def initialize_io_files(reads_file, output_h1, output_h2, output_untagged, exit_
             "Expecting BAM or FASTQ (gzipped)".format(input_format)
         )
 
+    # each output compresses with its share of the threads
+    outputs = [output_untagged, output_h1, output_h2]
+    output_threads = max(1, threads // max(1, sum(outfile is not None for outfile in outputs)))
     if input_format == "BAM":
         input_reader = exit_stack.enter_context(
             pysam.AlignmentFile(
                 reads_file,
                 mode="rb",
                 check_sq=False,  # I guess this is needed for unaligned PacBio native files
+                threads=threads,
             )
         )
         input_iter = _bam_iterator
         output_writers = dict()
-        for hap, outfile in enumerate([output_untagged, output_h1, output_h2]):
+        for hap, outfile in enumerate(outputs):
             output_writers[hap] = exit_stack.enter_context(
                 pysam.AlignmentFile(
-                    os.devnull if outfile is None else outfile, mode="wb", template=input_reader
+                    os.devnull if outfile is None else outfile,
+                    mode="wb",
+                    template=input_reader,
+                    threads=output_threads if outfile is not None else 1,
                 )
             )
     elif input_format == "FASTQ":
@@ -315,14 +388,21 @@ def initialize_io_files(reads_file, output_h1, output_h2, output_untagged, exit_
             input_mode = "w"
         input_iter = _fastq_string_iterator
         output_writers = dict()
-        for hap, outfile in enumerate([output_untagged, output_h1, output_h2]):
-            open_handle = exit_stack.enter_context(xopen(outfile, "w"))
-            if open_handle is None:
+        for hap, outfile in enumerate(outputs):
+            if outfile is None:
                 open_handle = exit_stack.enter_context(open(os.devnull, input_mode))
+            else:
+                # xopen compresses in a separate process (such as pigz)
+                open_handle = exit_stack.enter_context(xopen(outfile, "w"))
             output_writers[hap] = open_handle
     else:
         # and this means I overlooked something...
         raise ValueError("Unhandled file format for input reads: {}".format(input_format))
+    if threads > 1:
+        for hap, outfile in enumerate(outputs):
+            if outfile is not None:
+                # entered last, so the thread is finished before its output is closed
+                output_writers[hap] = exit_stack.enter_context(WriterThread(output_writers[hap]))
     return input_reader, input_iter, output_writers
 
 
@@ -348,6 +428,7 @@ def run_split(
     only_largest_block=False,
     discard_unknown_reads=False,
     read_lengths_histogram=None,
+    threads=1,
 ):
     if pigz_deprecated:
         logger.warning("Ignoring deprecated --pigz option")
@@ -395,8 +476,22 @@ def run_split(
 
         timers.stop("split-process-haplotag-list")
 
+        # A single lookup per read: with --discard-unknown-reads, untagged reads are included
+        # (with haplotype 0), so unknown reads are those not found. Lookups do not insert
+        # missing read names (as indexing the defaultdict would).
+        if discard_unknown_reads:
+            haplotypes = dict.fromkeys(known_reads, 0)
+            haplotypes.update(readname_to_haplotype)
+            del known_reads
+            unknown_haplotype = None
+        else:
+            haplotypes = readname_to_haplotype
+            unknown_haplotype = 0
+        del readname_to_haplotype
+        haplotype_of = haplotypes.get
+
         input_reader, input_iterator, output_writers = initialize_io_files(
-            reads_file, output_h1, output_h2, output_untagged, stack
+            reads_file, output_h1, output_h2, output_untagged, stack, threads
         )
 
         timers.stop("split-init")
@@ -420,10 +515,10 @@ def run_split(
 
         for read_name, read_length, record in input_iterator(input_reader):
             read_counter["total_reads"] += 1
-            if discard_unknown_reads and read_name not in known_reads:
+            read_haplotype = haplotype_of(read_name, unknown_haplotype)
+            if read_haplotype is None:
                 read_counter["unknown_reads"] += 1
                 continue
-            read_haplotype = readname_to_haplotype[read_name]
             if not process_haplotype[read_haplotype]:
                 read_counter["skipped_reads"] += 1
                 continue
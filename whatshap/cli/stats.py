@@ -1,13 +1,15 @@
 """
 Print phasing statistics of a single VCF file
 """
+import io
 import logging
-from collections import defaultdict
 from contextlib import ExitStack
 import dataclasses
+from multiprocessing import Pool
 from statistics import median
+from typing import Dict, Iterable, List, Optional, Tuple
 
-from ..vcf import VcfReader
+from ..vcf import VcfReader, VariantRow
 
 logger = logging.getLogger(__name__)
 
@@ -28,52 +30,62 @@ def add_arguments(parser):
     add("--chromosome", dest="chromosomes", metavar="CHROMOSOME", default=[], action="append",
         help="Name of chromosome to process. If not given, all chromosomes in the "
         "input VCF are considered. Can be used multiple times")
+    add("--threads", "-t", metavar="N", type=int, default=1,
+        help="Number of threads to use. If the VCF is indexed, chromosomes are processed in "
+        "parallel worker processes (default: %(default)s).")
     add("vcf", metavar="VCF", help="Phased VCF file")
 # fmt: on
 
 
 def validate(args, parser):
-    pass
+    if args.threads < 1:
+        parser.error("Number of threads must be at least 1.")
 
 
 class PhasedBlock:
+    """
+    Summary of a phased block, which is updated for every variant added to it, such that the
+    memory needed does not depend on the number of variants.
+    """
+
+    __slots__ = ("chromosome", "leftmost_position", "rightmost_position", "variant_count", "snvs")
+
     def __init__(self, chromosome=None):
-        self.phases = {}
-        self.leftmost_variant = None
-        self.rightmost_variant = None
         self.chromosome = chromosome
-
-    def add(self, variant, phase):
-        if len(self.phases) == 0:
-            self.leftmost_variant = variant
-            self.rightmost_variant = variant
+        self.leftmost_position = None
+        self.rightmost_position = None
+        self.variant_count = 0
+        self.snvs = 0
+
+    def add(self, variant):
+        if self.variant_count == 0:
+            self.leftmost_position = variant.position
+            self.rightmost_position = variant.position
         else:
-            if variant < self.leftmost_variant:
-                self.leftmost_variant = variant
-            if self.rightmost_variant < variant:
-                self.rightmost_variant = variant
-        self.phases[variant] = phase
+            self.leftmost_position = min(self.leftmost_position, variant.position)
+            self.rightmost_position = max(self.rightmost_position, variant.position)
+        self.variant_count += 1
+        self.snvs += int(variant.is_snv())
 
     def span(self):
         """Returns the length of the covered genomic region in bp."""
-        return self.rightmost_variant.position - self.leftmost_variant.position
-
-    def variants(self):
-        return list(sorted(self.phases.keys()))
+        return self.rightmost_position - self.leftmost_position
 
     def count_snvs(self):
-        return sum(int(variant.is_snv()) for variant in self.phases)
+        return self.snvs
 
     def __repr__(self):
-        return "PhasedBlock({})".format(str(self.phases))
+        return "PhasedBlock({}:{}-{}, {} variants)".format(
+            self.chromosome, self.leftmost_position, self.rightmost_position, self.variant_count
+        )
 
     def __len__(self):
-        return len(self.phases)
+        return self.variant_count
 
     def __lt__(self, other):
-        return (self.leftmost_variant, self.rightmost_variant) < (
-            other.leftmost_variant,
-            other.rightmost_variant,
+        return (self.leftmost_position, self.rightmost_position) < (
+            other.leftmost_position,
+            other.rightmost_position,
         )
 
 
@@ -100,6 +112,10 @@ class GtfWriter:
             file=self._file,
         )
 
+    def write_text(self, text):
+        """Write features that were formatted by another GtfWriter"""
+        self._file.write(text)
+
 
 @dataclasses.dataclass
 class DetailedStats:
@@ -137,19 +153,19 @@ def compute_ng50(blocks, chr_lengths):
             return float("nan")
 
     # Cut interleaved blocks to avoid inflating NG50 in this case
-    pos_sorted = sorted(blocks, key=lambda b: (b.chromosome, b.leftmost_variant.position))
+    pos_sorted = sorted(blocks, key=lambda b: (b.chromosome, b.leftmost_position))
     block_lengths = []
     for i, block in enumerate(pos_sorted):
         if len(block) < 2:
             continue
-        start, end = block.leftmost_variant.position, block.rightmost_variant.position
+        start, end = block.leftmost_position, block.rightmost_position
         if i + 1 < len(pos_sorted):
             next_block = pos_sorted[i + 1]
-            if (end > next_block.leftmost_variant.position) and (
+            if (end > next_block.leftmost_position) and (
                 block.chromosome == next_block.chromosome
             ):
-                # logger.warning('Blocks are interleaved, cutting first block: end=%s --> %s',  end, next_block.leftmost_variant.position)
-                end = next_block.leftmost_variant.position
+                # logger.warning('Blocks are interleaved, cutting first block: end=%s --> %s',  end, next_block.leftmost_position)
+                end = next_block.leftmost_position
         block_lengths.append(end - start)
     block_lengths.sort(reverse=True)
     s = 0
@@ -308,6 +324,7 @@ def run_stats(
     only_snvs=False,
     chromosomes=None,
     chr_lengths=None,
+    threads=1,
 ):
     gtfwriter = tsv_file = block_list_file = None
     with ExitStack() as stack:
@@ -319,7 +336,9 @@ def run_stats(
         if block_list:
             block_list_file = stack.enter_context(open(block_list, "w"))
 
-        vcf_reader = VcfReader(vcf, phases=True, indels=not only_snvs)
+        vcf_reader = stack.enter_context(
+            VcfReader(vcf, phases=True, indels=not only_snvs, threads=threads)
+        )
         if len(vcf_reader.samples) == 0:
             logger.error("Input VCF does not contain any sample")
             return 1
@@ -334,6 +353,8 @@ def run_stats(
         else:
             sample = vcf_reader.samples[0]
             logger.info("Reporting results for sample {}".format(sample))
+        # the calls of all other samples are not needed
+        vcf_reader.subset_samples([sample])
 
         if chr_lengths:
             chr_lengths = parse_chr_lengths(chr_lengths)
@@ -369,61 +390,23 @@ def run_stats(
         print("Phasing statistics for sample {} from file {}".format(sample, vcf))
         total_stats = PhasingStats()
         chromosome_count = 0
-        given_chromosomes = chromosomes
-        for variant_table in vcf_reader:
-            if given_chromosomes:
-                if variant_table.chromosome not in given_chromosomes:
-                    continue
+        if threads > 1:
+            indexed_chromosomes = vcf_reader.indexed_chromosomes()
+            if indexed_chromosomes is None:
+                logger.info("VCF has no index, chromosomes are processed one after another")
+        else:
+            indexed_chromosomes = None
+        if indexed_chromosomes is not None and len(indexed_chromosomes) > 1:
+            if chromosomes:
+                indexed_chromosomes = [c for c in indexed_chromosomes if c in chromosomes]
+            chromosome_results = chromosome_stats_parallel(
+                indexed_chromosomes, vcf, sample, only_snvs, gtfwriter, threads
+            )
+        else:
+            chromosome_results = chromosome_stats_serial(vcf_reader, sample, chromosomes, gtfwriter)
+        for chromosome, stats, blocks in chromosome_results:
             chromosome_count += 1
-            chromosome = variant_table.chromosome
-            stats = PhasingStats()
             print("---------------- Chromosome {} ----------------".format(chromosome))
-            genotypes = variant_table.genotypes_of(sample)
-            phases = variant_table.phases_of(sample)
-            assert len(genotypes) == len(phases) == len(variant_table.variants)
-            blocks = defaultdict(PhasedBlock)
-            prev_block_id = None
-            prev_block_fragment_start = None
-            prev_block_fragment_end = None
-            for variant, genotype, phase in zip(variant_table.variants, genotypes, phases):
-                stats.add_variants(1)
-                if genotype.is_homozygous():
-                    continue
-                stats.add_heterozygous_variants(1)
-                if variant.is_snv():
-                    stats.add_heterozygous_snvs(1)
-                if phase is None:
-                    stats.add_unphased()
-                else:
-                    # a phased variant
-                    blocks[phase.block_id].add(variant, phase)
-                    if gtfwriter:
-                        if prev_block_id is None:
-                            prev_block_fragment_start = variant.position
-                            prev_block_fragment_end = variant.position + 1
-                            prev_block_id = phase.block_id
-                        else:
-                            if prev_block_id != phase.block_id:
-                                gtfwriter.write(
-                                    chromosome,
-                                    prev_block_fragment_start,
-                                    prev_block_fragment_end,
-                                    prev_block_id,
-                                )
-                                prev_block_fragment_start = variant.position
-                                prev_block_id = phase.block_id
-                            prev_block_fragment_end = variant.position + 1
-
-            # Add chromosome information to each block. This is needed to
-            # sort blocks later when we compute NG50s
-            for block_id, block in blocks.items():
-                block.chromosome = chromosome
-
-            if gtfwriter and prev_block_id is not None:
-                gtfwriter.write(
-                    chromosome, prev_block_fragment_start, prev_block_fragment_end, prev_block_id
-                )
-
             if block_list_file:
                 block_ids = sorted(blocks.keys())
                 for block_id in block_ids:
@@ -431,14 +414,13 @@ def run_stats(
                         sample,
                         chromosome,
                         block_id,
-                        blocks[block_id].leftmost_variant.position + 1,
-                        blocks[block_id].rightmost_variant.position + 1,
+                        blocks[block_id].leftmost_position + 1,
+                        blocks[block_id].rightmost_position + 1,
                         len(blocks[block_id]),
                         sep="\t",
                         file=block_list_file,
                     )
 
-            stats.add_blocks(blocks.values())
             stats.print(chr_lengths)
             if tsv_file:
                 print(sample, chromosome, vcf, sep="\t", end="\t", file=tsv_file)
@@ -454,5 +436,122 @@ def run_stats(
                 print(*dataclasses.astuple(total_stats.get(chr_lengths)), sep="\t", file=tsv_file)
 
 
+def chromosome_stats(
+    chromosome: str, rows: Iterable[VariantRow], sample_index: int, gtfwriter=None
+) -> Tuple[PhasingStats, Dict[int, PhasedBlock]]:
+    """
+    Compute the statistics of a single chromosome in a single pass over its rows (as yielded by
+    VcfReader.stream) and write its blocks to the GTF writer, if given. Return the statistics
+    and the blocks by block id.
+    """
+    stats = PhasingStats()
+    blocks: Dict[int, PhasedBlock] = {}
+    prev_block_id = None
+    prev_block_fragment_start = None
+    prev_block_fragment_end = None
+    for variant, genotypes, phases, _ in rows:
+        stats.add_variants(1)
+        genotype = genotypes[sample_index]
+        phase = phases[sample_index]
+        if genotype.is_homozygous():
+            continue
+        stats.add_heterozygous_variants(1)
+        if variant.is_snv():
+            stats.add_heterozygous_snvs(1)
+        if phase is None:
+            stats.add_unphased()
+        else:
+            # a phased variant
+            block = blocks.get(phase.block_id)
+            if block is None:
+                # The chromosome is needed to sort blocks later when we compute NG50s
+                block = blocks[phase.block_id] = PhasedBlock(chromosome)
+            block.add(variant)
+            if gtfwriter:
+                if prev_block_id is None:
+                    prev_block_fragment_start = variant.position
+                    prev_block_fragment_end = variant.position + 1
+                    prev_block_id = phase.block_id
+                else:
+                    if prev_block_id != phase.block_id:
+                        gtfwriter.write(
+                            chromosome,
+                            prev_block_fragment_start,
+                            prev_block_fragment_end,
+                            prev_block_id,
+                        )
+                        prev_block_fragment_start = variant.position
+                        prev_block_id = phase.block_id
+                    prev_block_fragment_end = variant.position + 1
+
+    if gtfwriter and prev_block_id is not None:
+        gtfwriter.write(
+            chromosome, prev_block_fragment_start, prev_block_fragment_end, prev_block_id
+        )
+    stats.add_blocks(blocks.values())
+    return stats, blocks
+
+
+def chromosome_stats_serial(vcf_reader: VcfReader, sample: str, chromosomes, gtfwriter):
+    """Yield a tuple (chromosome, stats, blocks) for every chromosome in the order of the VCF"""
+    sample_index = vcf_reader.samples.index(sample)
+    for chromosome, rows in vcf_reader.stream():
+        if chromosomes and chromosome not in chromosomes:
+            continue
+        stats, blocks = chromosome_stats(chromosome, rows, sample_index, gtfwriter)
+        yield chromosome, stats, blocks
+
+
+def chromosome_stats_parallel(chromosomes: List[str], vcf, sample, only_snvs, gtfwriter, threads):
+    """
+    Same as chromosome_stats_serial, but the chromosomes (in the order of the index) are read
+    and processed by parallel worker processes. Results are yielded in order.
+    """
+    processes = min(threads, len(chromosomes))
+    logger.info("Processing %d chromosomes in %d worker processes", len(chromosomes), processes)
+    # for each chromosome, its result (or None if it has no records) once it has been finished
+    finished: Dict[int, Optional[Tuple[str, PhasingStats, Dict[int, PhasedBlock], str]]] = {}
+    next_chromosome = 0
+    with Pool(
+        processes=processes,
+        initializer=_init_stats_worker,
+        initargs=(vcf, sample, only_snvs, gtfwriter is not None),
+    ) as pool:
+        for index, result in pool.imap_unordered(_stats_unit, enumerate(chromosomes)):
+            finished[index] = result
+            while next_chromosome in finished:
+                result = finished.pop(next_chromosome)
+                next_chromosome += 1
+                if result is None:
+                    continue
+                chromosome, stats, blocks, gtf_text = result
+                if gtfwriter:
+                    gtfwriter.write_text(gtf_text)
+                yield chromosome, stats, blocks
+    assert next_chromosome == len(chromosomes)
+
+
+_stats_worker_state: Optional[Tuple[VcfReader, int, bool]] = None
+
+
+def _init_stats_worker(vcf, sample, only_snvs, write_gtf):
+    global _stats_worker_state
+    vcf_reader = VcfReader(vcf, phases=True, indels=not only_snvs)
+    vcf_reader.subset_samples([sample])
+    _stats_worker_state = (vcf_reader, vcf_reader.samples.index(sample), write_gtf)
+
+
+def _stats_unit(unit):
+    index, chromosome = unit
+    assert _stats_worker_state is not None
+    vcf_reader, sample_index, write_gtf = _stats_worker_state
+    for chrom, rows in vcf_reader.stream(chromosome):
+        gtf_text = io.StringIO()
+        gtfwriter = GtfWriter(gtf_text) if write_gtf else None
+        stats, blocks = chromosome_stats(chrom, rows, sample_index, gtfwriter)
+        return index, (chrom, stats, blocks, gtf_text.getvalue())
+    return index, None
+
+
 def main(args):
     run_stats(**vars(args))
@@ -0,0 +1,356 @@
+"""
+Join the phasings of adjacent regions computed by 'whatshap phase --region'
+
+Each input VCF (a "shard") contains the variants of a region of a chromosome and of a
+margin around it, phased independently of the other shards. For every variant, the call
+from the shard whose region contains it is written. Phased blocks of adjacent shards that
+share phased variants in the overlap of their windows are joined: the haplotypes of a
+block are swapped if they then agree with the other block at most of the shared variants.
+All calls of a joined block get the phase set (PS) of its leftmost variant, as a single
+run of 'whatshap phase' would assign it.
+
+The result is usually close to phasing the chromosomes in one run, but not guaranteed to
+be the same. Where the coverage exceeds --internal-downsampling (or a --coverage-budget),
+reads are selected among those of the shard only, which may give other reads than when
+selecting them on the whole chromosome, and thus a different phasing. Reads that extend
+beyond the margins are not seen by both shards either.
+
+The regions of the shards of a chromosome must be adjacent: variants between two regions
+would not be written, and this is therefore an error. Only diploid phasings stored in GT
+and PS tags are supported.
+"""
+import logging
+import sys
+from collections import Counter
+from dataclasses import dataclass
+from typing import Dict, Hashable, List, Optional, Tuple
+
+from pysam import VariantFile
+
+from whatshap import __version__
+from whatshap.cli import CommandLineError
+from whatshap.vcf import Shard, VcfError
+
+logger = logging.getLogger(__name__)
+
+# A phased block in a shard, identified by (shard index, sample, phase set)
+Block = Tuple[int, str, int]
+# Identifies a variant within a chromosome
+VariantKey = Tuple[int, str, Tuple[str, ...]]
+
+
+def add_arguments(parser):
+    add = parser.add_argument
+    add("-o", "--output", default=sys.stdout,
+        help="Output VCF file. Add .gz to the file name to get compressed output. "
+        "If omitted, use standard output.")
+    add("shards", nargs="+", metavar="VCF",
+        help="VCF files written by 'whatshap phase --region' (in any order)")
+
+
+class BlockJoiner:
+    """
+    Disjoint sets of blocks (union-find) that also track for each block whether its
+    haplotypes are swapped relative to the representative of its set
+    """
+
+    def __init__(self):
+        self._parent: Dict[Hashable, Hashable] = dict()
+        # whether a block is swapped relative to its parent
+        self._swapped: Dict[Hashable, bool] = dict()
+
+    def find(self, block: Hashable) -> Tuple[Hashable, bool]:
+        """Return the representative of the set of the block and whether it is swapped"""
+        path = []
+        swapped = False
+        while block in self._parent:
+            path.append(block)
+            swapped ^= self._swapped[block]
+            block = self._parent[block]
+        # Point all blocks on the path directly to the representative
+        path_swapped = swapped
+        for node in path:
+            node_swapped = self._swapped[node]
+            self._parent[node] = block
+            self._swapped[node] = path_swapped
+            path_swapped ^= node_swapped
+        return block, swapped
+
+    def join(self, block1: Hashable, block2: Hashable, swapped: bool) -> bool:
+        """
+        Join the sets of two blocks, where swapped tells whether the haplotypes of block2
+        are swapped relative to block1. Return False (and change nothing) if the blocks are
+        already in the same set with the opposite relation.
+        """
+        root1, swapped1 = self.find(block1)
+        root2, swapped2 = self.find(block2)
+        if root1 == root2:
+            return swapped1 ^ swapped2 == swapped
+        self._parent[root2] = root1
+        self._swapped[root2] = swapped1 ^ swapped2 ^ swapped
+        return True
+
+
+@dataclass
+class ShardInput:
+    path: str
+    shard: Shard
+    # Variants at positions in [start, end) are taken from this shard
+    start: int = 0
+    end: Optional[int] = None
+
+    def owns(self, position: int) -> bool:
+        return self.start <= position and (self.end is None or position < self.end)
+
+
+def read_shard(path: str) -> ShardInput:
+    try:
+        with VariantFile(path) as vcf:
+            values = [
+                record.value for record in vcf.header.records if record.key == Shard.HEADER_KEY
+            ]
+    except OSError as e:
+        raise CommandLineError(e)
+    if len(values) != 1:
+        raise CommandLineError(
+            "{!r} was not written by 'whatshap phase --region' (it has no {} header)".format(
+                path, Shard.HEADER_KEY
+            )
+        )
+    try:
+        return ShardInput(path, Shard.parse_header_value(values[0]))
+    except VcfError as e:
+        raise CommandLineError("{}: {}".format(path, e))
+
+
+def order_shards(shards: List[ShardInput], contigs: List[str]) -> List[ShardInput]:
+    """
+    Sort shards by chromosome (in the order of the contigs in the header) and position
+    and determine the range of positions taken from each shard. The regions of the shards
+    of a chromosome must neither overlap nor leave gaps.
+    """
+    contig_index = {contig: i for i, contig in enumerate(contigs)}
+    shards = sorted(
+        shards,
+        key=lambda s: (
+            contig_index.get(s.shard.chromosome, len(contig_index)),
+            s.shard.chromosome,
+            s.shard.start,
+        ),
+    )
+    for i, shard_input in enumerate(shards):
+        previous = shards[i - 1].shard if i > 0 else None
+        following = shards[i + 1].shard if i + 1 < len(shards) else None
+        shard = shard_input.shard
+        if previous is not None and previous.chromosome == shard.chromosome:
+            if previous.end is None or previous.end > shard.start:
+                raise CommandLineError(
+                    "The regions of shards {!r} and {!r} overlap".format(
+                        shards[i - 1].path, shard_input.path
+                    )
+                )
+            if previous.end < shard.start:
+                raise CommandLineError(
+                    "The variants at {}:{}-{} (between the regions of shards {!r} and {!r}) "
+                    "are not in any shard".format(
+                        shard.chromosome,
+                        previous.end + 1,
+                        shard.start,
+                        shards[i - 1].path,
+                        shard_input.path,
+                    )
+                )
+            shard_input.start = shard.start
+        elif shard.start > 0:
+            logger.warning(
+                "Shard %r starts at %s:%d, variants before it are not written",
+                shard_input.path,
+                shard.chromosome,
+                shard.start + 1,
+            )
+            shard_input.start = shard.start
+        if following is not None and following.chromosome == shard.chromosome:
+            shard_input.end = following.start
+        elif shard.end is not None:
+            logger.warning(
+                "Shard %r ends at %s:%d, variants after it are not written",
+                shard_input.path,
+                shard.chromosome,
+                shard.end,
+            )
+            shard_input.end = shard.end
+    return shards
+
+
+def phased_call(call) -> Optional[Tuple[int, Tuple[int, int]]]:
+    """Return phase set and genotype of a phased heterozygous call or None"""
+    gt = call.get("GT")
+    if not call.phased or gt is None or any(allele is None for allele in gt):
+        return None
+    if len(gt) != 2:
+        raise CommandLineError("Only diploid phasings can be stitched")
+    ps = call.get("PS")
+    if gt[0] == gt[1] or ps is None:
+        return None
+    return ps, gt
+
+
+def collect_blocks(shards: List[ShardInput], samples: List[str]):
+    """
+    Read all shards and join the blocks of adjacent shards on the same chromosome.
+
+    Return a BlockJoiner and a dict that maps each block with a variant taken from its
+    shard to the position of its first such variant.
+    """
+    joiner = BlockJoiner()
+    first_positions: Dict[Block, int] = dict()
+    # phased calls of the previous shard in the window of the current shard
+    previous_calls: Dict[str, Dict[VariantKey, Tuple[int, Tuple[int, int]]]] = dict()
+    n_joined = n_conflicts = 0
+    for index, shard_input in enumerate(shards):
+        shard = shard_input.shard
+        previous = shards[index - 1].shard if index > 0 else None
+        if previous is not None and previous.chromosome != shard.chromosome:
+            previous = None
+        following = shards[index + 1].shard if index + 1 < len(shards) else None
+        if following is not None and following.chromosome != shard.chromosome:
+            following = None
+        calls: Dict[str, Dict[VariantKey, Tuple[int, Tuple[int, int]]]] = {
+            sample: dict() for sample in samples
+        }
+        agreeing: Dict[str, Counter] = {sample: Counter() for sample in samples}
+        disagreeing: Dict[str, Counter] = {sample: Counter() for sample in samples}
+        with VariantFile(shard_input.path) as vcf:
+            if list(vcf.header.samples) != samples:
+                raise CommandLineError(
+                    "The samples in {!r} differ from those in {!r}".format(
+                        shard_input.path, shards[0].path
+                    )
+                )
+            for record in vcf:
+                if record.chrom != shard.chromosome:
+                    continue
+                position = record.start
+                key = (position, record.ref, record.alts)
+                in_previous = previous is not None and previous.in_window(
+                    shard.chromosome, position
+                )
+                in_following = following is not None and following.in_window(
+                    shard.chromosome, position
+                )
+                owned = shard_input.owns(position)
+                for sample in samples:
+                    phased = phased_call(record.samples[sample])
+                    if phased is None:
+                        continue
+                    ps, gt = phased
+                    if owned:
+                        first_positions.setdefault((index, sample, ps), position)
+                    if in_previous and key in previous_calls[sample]:
+                        previous_ps, previous_gt = previous_calls[sample][key]
+                        if previous_gt == gt:
+                            agreeing[sample][(previous_ps, ps)] += 1
+                        elif previous_gt == gt[::-1]:
+                            disagreeing[sample][(previous_ps, ps)] += 1
+                    if in_following:
+                        calls[sample][key] = phased
+
+        # Join blocks with the most shared variants first
+        for sample in samples:
+            pairs = set(agreeing[sample]) | set(disagreeing[sample])
+            for previous_ps, ps in sorted(
+                pairs,
+                key=lambda pair: (
+                    -(agreeing[sample][pair] + disagreeing[sample][pair]),
+                    pair,
+                ),
+            ):
+                n_agreeing = agreeing[sample][(previous_ps, ps)]
+                n_disagreeing = disagreeing[sample][(previous_ps, ps)]
+                if n_agreeing == n_disagreeing:
+                    continue
+                if joiner.join(
+                    (index - 1, sample, previous_ps),
+                    (index, sample, ps),
+                    n_disagreeing > n_agreeing,
+                ):
+                    n_joined += 1
+                else:
+                    n_conflicts += 1
+        previous_calls = calls
+    logger.info("Joined %d pairs of blocks of adjacent shards", n_joined)
+    if n_conflicts:
+        logger.warning(
+            "%d pairs of blocks could not be joined because they contradict other joins",
+            n_conflicts,
+        )
+    return joiner, first_positions
+
+
+def final_phase_sets(
+    joiner: BlockJoiner, first_positions: Dict[Block, int]
+) -> Dict[Block, Tuple[int, bool]]:
+    """
+    Return a dict that maps each block to its phase set in the output and whether its
+    haplotypes are swapped. The leftmost block of each joined set keeps its haplotypes.
+    """
+    leftmost: Dict[Hashable, Tuple[int, bool]] = dict()
+    for block, position in first_positions.items():
+        root, swapped = joiner.find(block)
+        if root not in leftmost or position < leftmost[root][0]:
+            leftmost[root] = (position, swapped)
+    result = dict()
+    for block in first_positions:
+        root, swapped = joiner.find(block)
+        position, root_swapped = leftmost[root]
+        result[block] = (position + 1, swapped ^ root_swapped)
+    return result
+
+
+def run_stitch(shard_paths: List[str], output=sys.stdout, write_command_line_header=True):
+    """
+    Join the VCFs written by 'whatshap phase --region' for adjacent regions and write the
+    result to output (a path or a file-like object)
+    """
+    shards = [read_shard(path) for path in shard_paths]
+    with VariantFile(shards[0].path) as vcf:
+        header = vcf.header.copy()
+    samples = list(header.samples)
+    shards = order_shards(shards, list(header.contigs))
+    logger.info("Stitching %d shards", len(shards))
+
+    joiner, first_positions = collect_blocks(shards, samples)
+    phase_sets = final_phase_sets(joiner, first_positions)
+
+    for record in header.records:
+        if record.key == Shard.HEADER_KEY:
+            record.remove()
+            break
+    if write_command_line_header:
+        command_line = "(whatshap {}) {}".format(__version__, " ".join(sys.argv[1:]))
+        header.add_meta("commandline", '"' + command_line.replace('"', "") + '"')
+    with VariantFile(output, mode="w", header=header) as writer:
+        for index, shard_input in enumerate(shards):
+            with VariantFile(shard_input.path) as vcf:
+                for record in vcf:
+                    if record.chrom != shard_input.shard.chromosome:
+                        continue
+                    if not shard_input.owns(record.start):
+                        continue
+                    for sample in samples:
+                        call = record.samples[sample]
+                        phased = phased_call(call)
+                        if phased is None:
+                            continue
+                        ps, gt = phased
+                        new_ps, swapped = phase_sets[(index, sample, ps)]
+                        if swapped:
+                            call["GT"] = gt[::-1]
+                        call["PS"] = new_ps
+                        call.phased = True
+                    record.translate(header)
+                    writer.write(record)
+
+
+def main(args):
+    run_stitch(args.shards, args.output)
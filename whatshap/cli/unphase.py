@@ -11,9 +11,12 @@ prints out the modified VCF to standard output. The modifications are:
 
 It is not an error if no phasing information was found.
 """
+import re
 import sys
 import logging
-from pysam import VariantFile
+
+from whatshap.core import VcfRewriter
+from whatshap.vcf import rewrite_vcf_text
 
 
 logger = logging.getLogger(__name__)
@@ -21,48 +24,45 @@ logger = logging.getLogger(__name__)
 TAGS_TO_REMOVE = frozenset(("HP", "PQ", "PS"))
 
 
+# fmt: off
 def add_arguments(parser):
     add = parser.add_argument
+    add("--threads", "-t", metavar="N", type=int, default=1,
+        help="Number of threads used to decompress the input and to rewrite the records "
+        "(default: %(default)s).")
     add("vcf", metavar="VCF", help='VCF file. Use "-" to read from standard input')
+# fmt: on
+
 
+def validate(args, parser):
+    if args.threads < 1:
+        parser.error("Number of threads must be at least 1.")
 
-def unphase_header(header):
-    for hr in header.records:
-        if hr.key == "phasing":
-            hr.remove()
-            break
 
-    for tag in TAGS_TO_REMOVE:
-        if tag in header.formats:
-            header.formats.remove_header(tag)
+def unphase_header(lines):
+    """Return the header lines without the phasing header and the removed FORMATs"""
+    format_re = re.compile("##FORMAT=<ID=([^,>]*)")
+    result = []
+    for line in lines:
+        if line.startswith("##phasing="):
+            continue
+        m = format_re.match(line)
+        if m and m.group(1) in TAGS_TO_REMOVE:
+            continue
+        result.append(line)
+    return result
 
 
-def run_unphase(vcf_path, outfile):
+def run_unphase(vcf_path, outfile, threads=1):
     """
     Read a VCF file, remove phasing information, and write the result to
-    outfile, which must be a file-like object.
+    outfile, which must be a path or a file-like object.
+
+    The records are rewritten in C++ without decoding them (see VcfRewriter).
     """
-    if vcf_path == "-":
-        reader = VariantFile(sys.stdin)
-    else:
-        reader = VariantFile(vcf_path)
-
-    unphase_header(reader.header)
-    with VariantFile(outfile, mode="w", header=reader.header) as writer:
-        for record in reader:
-            for tag in TAGS_TO_REMOVE:
-                if tag in record.format:
-                    del record.format[tag]
-            for call in record.samples.values():
-                if (
-                    call["GT"] is not None
-                    and call["GT"][0] is not None
-                    and call["GT"][1] is not None
-                ):
-                    call["GT"] = sorted(call["GT"])
-                call.phased = False
-            writer.write(record)
+    rewriter = VcfRewriter(TAGS_TO_REMOVE, threads)
+    rewrite_vcf_text(vcf_path, outfile, rewriter, unphase_header, threads=threads)
 
 
 def main(args):
-    run_unphase(args.vcf, sys.stdout)
+    run_unphase(args.vcf, sys.stdout, threads=args.threads)
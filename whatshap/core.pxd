@@ -1,6 +1,7 @@
 # cython: language_level=3
 
 from libcpp cimport bool
+from libcpp.memory cimport shared_ptr
 from libc.stdint cimport uint32_t, uint64_t
 from . cimport cpp
 
@@ -19,6 +20,26 @@ cdef class ReadSet:
 	cdef cpp.ReadSet *thisptr
 
 
+cdef class ReferenceSequence:
+	cdef shared_ptr[cpp.ReferenceSequence] thisptr
+
+
+cdef class AlleleDetector:
+	cdef cpp.AlleleDetector *thisptr
+
+
+cdef class PileupCounter:
+	cdef cpp.PileupCounter *thisptr
+
+
+cdef class ReadMerger:
+	cdef cpp.ReadMerger *thisptr
+
+
+cdef class VcfRewriter:
+	cdef cpp.VcfRewriter *thisptr
+
+
 cdef class Pedigree:
 	cdef cpp.Pedigree *thisptr
 	cdef NumericSampleIds numeric_sample_ids
@@ -26,6 +47,7 @@ cdef class Pedigree:
 
 cdef class PedigreeDPTable:
 	cdef cpp.PedigreeDPTable *thisptr
+	cdef ReadSet readset
 	cdef Pedigree pedigree
 
 
@@ -33,6 +55,10 @@ cdef class PhredGenotypeLikelihoods:
 	cdef cpp.PhredGenotypeLikelihoods *thisptr
 	
 	
+cdef class GeneticMap:
+	cdef cpp.GeneticMap *thisptr
+
+
 cdef class Genotype:
 	cdef cpp.Genotype *thisptr
 	cdef uint64_t index
@@ -41,6 +67,8 @@ cdef class Genotype:
 
 cdef class GenotypeDPTable:
 	cdef cpp.GenotypeDPTable *thisptr
+	cdef cpp.GenotypeDPTableDouble *double_ptr
+	cdef ReadSet readset
 	cdef Pedigree pedigree
 	cdef NumericSampleIds numeric_sample_ids
 
@@ -58,13 +86,24 @@ cdef class TriangleSparseMatrix:
 	cdef cpp.TriangleSparseMatrix *thisptr
 
 
+cdef class ReadScoreIndex:
+	cdef cpp.ReadScoreIndex *thisptr
+
+
 cdef class ReadScoring:
 	cdef cpp.ReadScoring *thisptr
 
 
+cdef class ThreadingPreprocessor:
+	cdef cpp.ThreadingPreprocessor *thisptr
+
+
 cdef class HaploThreader:
 	cdef cpp.HaploThreader *thisptr
 	
+cdef class BlockPhaser:
+	cdef cpp.BlockPhaser *thisptr
+
 cdef class SwitchFlipCalculator:
 	cdef cpp.SwitchFlipCalculator *thisptr
 	cdef uint32_t ploidy
@@ -1,5 +1,5 @@
 from collections import namedtuple
-from typing import Dict, Iterable, Optional, Tuple, List, Set, Sequence, Iterator
+from typing import Any, Dict, Iterable, Optional, Tuple, List, Set, Sequence, Iterator, Union
 
 Variant = namedtuple("Variant", "position allele quality")
 
@@ -51,6 +51,41 @@ class ReadSet:
     def sort(self) -> None: ...
     def subset(self, reads_to_select: Iterable[int]) -> ReadSet: ...
     def get_positions(self) -> List[int]: ...
+    def to_bytes(self) -> bytes: ...
+    @staticmethod
+    def from_bytes(data: bytes) -> ReadSet: ...
+
+class ReferenceSequence:
+    def __init__(self, sequence: Optional[str] = ...): ...
+    @staticmethod
+    def mapped(
+        path: str, length: int, offset: int, line_bases: int, line_width: int
+    ) -> ReferenceSequence: ...
+    def __len__(self) -> int: ...
+    def __getitem__(self, key: Union[int, slice]) -> str: ...
+    def is_mapped(self) -> bool: ...
+
+class AlleleDetector:
+    def __init__(
+        self,
+        variants: Sequence[Any],
+        reference: Union[str, ReferenceSequence],
+        overhang: int = ...,
+        use_affine: bool = ...,
+        gap_start: Optional[int] = ...,
+        gap_extend: Optional[int] = ...,
+        default_mismatch: Optional[int] = ...,
+    ): ...
+    def __len__(self) -> int: ...
+    def detect(
+        self,
+        read: Read,
+        cigartuples: Optional[List[Tuple[int, int]]],
+        query_sequence: Optional[str],
+        reference_start: int,
+        first: int = ...,
+    ) -> int: ...
+    def cache_stats(self) -> Dict[str, int]: ...
 
 class PedigreeDPTable:
     def __init__(
@@ -60,10 +95,22 @@ class PedigreeDPTable:
         pedigree: Pedigree,
         distrust_genotypes: bool = ...,
         positions: Optional[Iterable[int]] = ...,
+        threads: int = ...,
+        checkpoint_policy: str = ...,
+        memory_limit: int = ...,
+        incremental: bool = ...,
+        previous: Optional[PedigreeDPTable] = ...,
     ): ...
     def get_super_reads(self) -> Tuple[List[ReadSet], List[int]]: ...
+    def get_phased_column(
+        self, column_index: int
+    ) -> Tuple[int, int, List[Tuple[int, int, int]]]: ...
+    def phased_columns(self) -> Iterator[Tuple[int, int, List[Tuple[int, int, int]]]]: ...
     def get_optimal_cost(self) -> int: ...
     def get_optimal_partitioning(self) -> List[int]: ...
+    def get_peak_memory(self) -> int: ...
+    def get_checkpoint_policy(self) -> str: ...
+    def get_computed_column_count(self) -> int: ...
 
 class Pedigree:
     def __init__(self, numeric_sample_ids: NumericSampleIds): ...
@@ -91,6 +138,10 @@ class PhredGenotypeLikelihoods:
     def genotypes(self) -> List[Genotype]: ...
 
 def binomial_coefficient(n: int, k: int) -> int: ...
+def get_column_arena_stats() -> Dict[str, int]: ...
+def clear_column_arenas() -> None: ...
+def get_pedigree_topology_cache_size() -> int: ...
+def clear_pedigree_topology_cache() -> None: ...
 
 class Genotype:
     def __init__(self, alleles: List[int]): ...
@@ -115,17 +166,57 @@ class GenotypeDPTable:
         recombcost: int,
         pedigree: Pedigree,
         positions: Optional[Iterable[int]] = ...,
+        precision: str = ...,
+        checkpoint_policy: str = ...,
+        memory_limit: int = ...,
+        concurrent: bool = ...,
     ): ...
     def get_genotype_likelihoods(self, sample_id: int, pos: int) -> PhredGenotypeLikelihoods: ...
+    def get_checkpoint_policy(self) -> str: ...
 
 def compute_genotypes(
     readset: ReadSet, positions: Optional[Iterable[int]] = ...
 ) -> Tuple[List[Genotype], List[Tuple[float, float, float]]]: ...
+def compute_genotypes_batch(
+    readsets: Iterable[ReadSet], positions: Iterable[int], threads: int = ...
+) -> List[Tuple[List[Genotype], List[Tuple[float, float, float]]]]: ...
 def compute_polyploid_genotypes(
     readset: ReadSet, ploidy: int, positions: Optional[Iterable[int]] = ...
 ) -> List[List[int]]: ...
+def assign_read_haplotypes(
+    readset: ReadSet,
+    positions: Sequence[int],
+    phasesets: Sequence[int],
+    alleles: Sequence[int],
+    use_bx_tags: bool,
+    linked_read_cutoff: int,
+) -> Tuple[List[Tuple[str, int, int, int]], List[Tuple[str, int, int, int]], int]: ...
+
+class VcfRewriter:
+    def __init__(
+        self,
+        remove_tags: Iterable[str] = ...,
+        threads: int = ...,
+        phased_chromosomes_only: bool = ...,
+    ): ...
+    def set_phase(
+        self, chromosome: str, position: int, allele0: int, allele1: int, phase_set: int
+    ) -> None: ...
+    def rewrite(self, chunk: bytes) -> bytes: ...
+
+class ReadMerger:
+    def __init__(
+        self,
+        error_rate: float,
+        max_error_rate: float,
+        positive_threshold: float,
+        negative_threshold: float,
+    ): ...
+    def get_thresholds(self) -> Tuple[int, int]: ...
+    def merge(self, readset: ReadSet) -> Tuple[ReadSet, Dict[str, int]]: ...
 
 class HapChatCore:
+    MAX_COVERAGE: int
     def __init__(self, readset: ReadSet): ...
     def get_length(self) -> int: ...
     def get_super_reads(self) -> Tuple[List[ReadSet], List[int]]: ...
@@ -140,7 +231,7 @@ def readselection(
 ) -> Set[int]: ...
 
 class ClusterEditingSolver:
-    def __init__(self, m: TriangleSparseMatrix, bundle_edges: bool): ...
+    def __init__(self, m: TriangleSparseMatrix, bundle_edges: bool, threads: int = 1): ...
     def run(self) -> List[List[int]]: ...
 
 class TriangleSparseMatrix:
@@ -152,13 +243,54 @@ class TriangleSparseMatrix:
     def __iter__(self) -> Iterator[Tuple[int, int]]: ...
     def __len__(self) -> int: ...
 
+class ReadScoreIndex:
+    def __init__(self, readset: ReadSet, min_overlap: int, threads: int = 1): ...
+    def restrict(self, first_variant: int, end_variant: int) -> ReadScoreIndex: ...
+    def __len__(self) -> int: ...
+    def num_pairs(self) -> int: ...
+    def min_overlap(self) -> int: ...
+    def get_positions(self) -> List[int]: ...
+    def to_bytes(self) -> bytes: ...
+    @staticmethod
+    def from_bytes(data: bytes) -> ReadScoreIndex: ...
+    @staticmethod
+    def load(path: str) -> ReadScoreIndex: ...
+
 # class ReadScoring:
 #     def __init__(self): ...
-def scoreReadsetGlobal(readset: ReadSet, min_overlap: int, ploidy: int) -> TriangleSparseMatrix: ...
+def scoreReadsetGlobal(
+    readset: ReadSet, min_overlap: int, ploidy: int, threads: int = 1
+) -> TriangleSparseMatrix: ...
 def scoreReadsetLocal(
-    readset: ReadSet, ref_haplotypes: List[List[int]], min_overlap: int, ploidy: int
+    readset: ReadSet,
+    min_overlap: int,
+    ploidy: int,
+    ref_haplotypes: List[List[int]] = [],
+    threads: int = 1,
+) -> TriangleSparseMatrix: ...
+def scoreIndexGlobal(index: ReadScoreIndex, min_overlap: int) -> TriangleSparseMatrix: ...
+def scoreIndexLocal(
+    index: ReadScoreIndex,
+    min_overlap: int,
+    ploidy: int,
+    ref_haplotypes: List[List[int]] = [],
 ) -> TriangleSparseMatrix: ...
 
+class ThreadingPreprocessor:
+    def __init__(self, readset: ReadSet, clustering: List[List[int]], ploidy: int): ...
+    def get_num_positions(self) -> int: ...
+    def get_genome_positions(self) -> List[int]: ...
+    def get_cluster_start_end_positions(self) -> Dict[int, Tuple[int, int]]: ...
+    def get_cov_map(self) -> List[List[int]]: ...
+    def get_compressed_coverage(self) -> List[List[float]]: ...
+    def get_compressed_consensus(self) -> List[List[int]]: ...
+    def get_consensus_fraction(self) -> List[List[float]]: ...
+    def get_independent_starts(self) -> List[int]: ...
+    def get_similarity(self, pos: int, c1: int, c2: int) -> float: ...
+    def improve_path_on_multiswitches(self, path: List[List[int]]) -> List[List[int]]: ...
+    def improve_path_on_collapsedswitches(self, path: List[List[int]]) -> List[List[int]]: ...
+    def get_haplotypes(self, path: List[List[int]]) -> List[str]: ...
+
 class HaploThreader:
     def __init__(
         self,
@@ -167,6 +299,9 @@ class HaploThreader:
         affine_switch_cost: float,
         symmetry_optimization: bool,
         row_limit: int,
+        beam_width: int = 0,
+        max_memory: int = 0,
+        threads: int = 1,
     ): ...
     def computePathsBlockwise(
         self,
@@ -176,6 +311,9 @@ class HaploThreader:
         consensus: List[List[int]],
         genotypes: List[Dict[int, int]],
     ) -> List[List[int]]: ...
+    def computePathsPreprocessed(
+        self, preprocessor: ThreadingPreprocessor, genotypes: List[Dict[int, int]]
+    ) -> List[List[int]]: ...
     def computePaths(
         self,
         start: int,
@@ -186,8 +324,36 @@ class HaploThreader:
         genotypes: List[Dict[int, int]],
     ) -> List[List[int]]: ...
 
+class BlockPhaser:
+    def __init__(
+        self,
+        ploidy: int,
+        min_overlap: int,
+        bundle_edges: bool,
+        refinements: int,
+        block_cut_sensitivity: int,
+        beam_width: int = 0,
+        threading_memory: int = 0,
+        threads: int = 1,
+    ): ...
+    def phase_blocks(
+        self,
+        block_readsets: List[ReadSet],
+        genotype_slices: List[List[Dict[int, int]]],
+        index: Optional[ReadScoreIndex] = None,
+        block_starts: Optional[List[int]] = None,
+    ) -> List[Tuple[List[List[int]], List[List[int]], List[str], List[int], List[List[int]]]]: ...
+    def compute_cut_positions(
+        self, path: List[List[int]], num_clusters: int
+    ) -> Tuple[List[int], List[List[int]]]: ...
+
 class SwitchFlipCalculator:
-    def __init__(self, ploidy: int, switch_cost: int = ..., flip_cost: int = ...): ...
+    def __init__(
+        self, ploidy: int, switch_cost: int = ..., flip_cost: int = ..., threads: int = ...
+    ): ...
     def compute_switch_flips_poly(
         self, phasing0: Sequence[str], phasing1: Sequence[str]
     ) -> Tuple[float, float, List[int], List[List[int]], List[List[int]]]: ...
+    def compare_blocks(
+        self, phasings0: Sequence[Sequence[str]], phasings1: Sequence[Sequence[str]]
+    ) -> List[Tuple[float, float]]: ...
@@ -11,6 +11,7 @@ Wrappers for core C++ classes.
 from libcpp cimport bool
 from libcpp.string cimport string
 from libcpp.vector cimport vector
+from libcpp.memory cimport shared_ptr
 from libc.stdint cimport uint32_t, uint64_t
 from . cimport cpp
 
@@ -212,6 +213,11 @@ cdef class Read:
 		return self.thisptr.hasBXTag()
 
 
+def _readset_from_bytes(data):
+	# module-level function such that pickle can find it by name
+	return ReadSet.from_bytes(data)
+
+
 cdef class ReadSet:
 	def __cinit__(self):
 		self.thisptr = new cpp.ReadSet()
@@ -258,13 +264,38 @@ cdef class ReadSet:
 			assert False, 'Invalid key: {}'.format(key)
 		return read
 	
-	def __getstate__(self):
-		return ([read for read in self])
-	
-	def __setstate__(self, state):
-		self.thisptr = new cpp.ReadSet()
-		for read in state:
-			self.add(read)
+	def to_bytes(self):
+		"""Return a compact binary representation of this ReadSet (read ids are not included)"""
+		return self.thisptr.serialize()
+
+	@staticmethod
+	def from_bytes(bytes data):
+		"""Create a ReadSet from the output of to_bytes()"""
+		cdef cpp.ReadSet* readset = cpp.ReadSet.deserialize(data)
+		result = ReadSet()
+		del result.thisptr
+		result.thisptr = readset
+		return result
+
+	@staticmethod
+	def load(str path, int sample_id=-1):
+		"""
+		Create a ReadSet from a file containing the output of to_bytes(). The file is
+		memory-mapped while reading. If sample_id is not negative, it replaces the
+		sample ids of all reads.
+		"""
+		cdef string _path = path.encode('UTF-8')
+		cdef cpp.ReadSet* readset
+		with nogil:
+			readset = cpp.ReadSet.load(_path, sample_id)
+		result = ReadSet()
+		del result.thisptr
+		result.thisptr = readset
+		return result
+
+	def __reduce__(self):
+		# pickle as a single bytes object instead of one tuple per read
+		return (_readset_from_bytes, (self.to_bytes(),))
 
 	#def get_by_name(self, name):
 		#cdef string _name = name.encode('UTF-8')
@@ -280,7 +311,8 @@ cdef class ReadSet:
 		"""Sort contained reads by the position of the first variant they contain. Note that
 		this is not necessarily the variant with the lowest position, unless sort() has been
 		called on all contained reads. Ties are resolved by comparing the read name."""
-		self.thisptr.sort()
+		with nogil:
+			self.thisptr.sort()
 
 	def subset(self, reads_to_select):
 		# TODO: is there a way of avoiding to unecessarily creating/destroying a ReadSet object?
@@ -301,18 +333,270 @@ cdef class ReadSet:
 		return result
 
 
+CHECKPOINT_POLICIES = {
+	"auto": cpp.CHECKPOINT_AUTO,
+	"all": cpp.CHECKPOINT_ALL,
+	"sqrt": cpp.CHECKPOINT_SQRT,
+	"log": cpp.CHECKPOINT_LOG,
+}
+
+
+def _mapped_reference_sequence(path, length, offset, line_bases, line_width):
+	return ReferenceSequence.mapped(path, length, offset, line_bases, line_width)
+
+
+cdef class ReferenceSequence:
+	"""
+	A sequence of a reference genome (such as a chromosome), either held in memory or read
+	on demand from a memory-mapped FASTA file (see mapped()). Bases are in upper case.
+	Pickling a memory-mapped sequence only stores its location in the file.
+	"""
+	def __cinit__(self, str sequence = None):
+		if sequence is not None:
+			self.thisptr.reset(new cpp.ReferenceSequence(sequence.encode()))
+
+	@staticmethod
+	def mapped(str path, size_t length, uint64_t offset, size_t line_bases, size_t line_width):
+		"""
+		Map a record of an uncompressed FASTA file. The arguments after path are the
+		fields of its entry in the .fai index: length, offset, bases per line and bytes per line.
+		"""
+		cdef ReferenceSequence result = ReferenceSequence()
+		result.thisptr.reset(new cpp.ReferenceSequence(path.encode(), length, offset, line_bases, line_width))
+		return result
+
+	def __len__(self):
+		assert self.thisptr.get() != NULL
+		return self.thisptr.get().size()
+
+	def __getitem__(self, key):
+		"""Return the base at the given index or the bases in the given slice (as str)"""
+		assert self.thisptr.get() != NULL
+		cdef string result
+		cdef long n = self.thisptr.get().size()
+		if isinstance(key, slice):
+			start, stop, step = key.indices(n)
+			if step != 1:
+				raise ValueError("ReferenceSequence does not support slices with a step")
+		else:
+			start = key + n if key < 0 else key
+			if not 0 <= start < n:
+				raise IndexError("ReferenceSequence index out of range")
+			stop = start + 1
+		self.thisptr.get().append(start, stop, result)
+		return result.decode()
+
+	def is_mapped(self):
+		assert self.thisptr.get() != NULL
+		return self.thisptr.get().is_mapped()
+
+	def __reduce__(self):
+		assert self.thisptr.get() != NULL
+		cdef cpp.ReferenceSequence* sequence = self.thisptr.get()
+		if sequence.is_mapped():
+			return (_mapped_reference_sequence, (sequence.get_path().decode(), sequence.size(),
+				sequence.get_offset(), sequence.get_line_bases(), sequence.get_line_width()))
+		return (ReferenceSequence, (self[:],))
+
+
+cdef class AlleleDetector:
+	"""
+	Detect the alleles of variants in reads by realigning each read to both alleles
+	of every variant it covers. Works on the variants and the reference of one chromosome.
+	"""
+	def __cinit__(self, variants, reference, unsigned int overhang=10, bool use_affine=False, gap_start=None, gap_extend=None, default_mismatch=None):
+		"""
+		variants -- list of variants (VcfVariant objects), sorted by position
+		reference -- the reference sequence of the chromosome (str or ReferenceSequence)
+		overhang -- extend alignment by this many bases to left and right
+		use_affine -- if true, use affine gap costs for realignment
+		gap_start, gap_extend -- if use_affine is true, use these parameters for affine gap cost alignment
+		default_mismatch -- if use_affine is true, use this as mismatch cost
+		"""
+		cdef vector[int] positions
+		cdef vector[string] reference_alleles
+		cdef vector[string] alternative_alleles
+		cdef shared_ptr[cpp.ReferenceSequence] sequence
+		if isinstance(reference, ReferenceSequence):
+			sequence = (<ReferenceSequence>reference).thisptr
+			assert sequence.get() != NULL
+		else:
+			sequence.reset(new cpp.ReferenceSequence(reference.encode()))
+		if use_affine:
+			assert gap_start is not None
+			assert gap_extend is not None
+			assert default_mismatch is not None
+		else:
+			gap_start = gap_extend = default_mismatch = 0
+		for variant in variants:
+			positions.push_back(variant.position)
+			reference_alleles.push_back(variant.reference_allele.encode())
+			alternative_alleles.push_back(variant.alternative_allele.encode())
+		self.thisptr = new cpp.AlleleDetector(positions, reference_alleles, alternative_alleles,
+			sequence, overhang, use_affine, gap_start, gap_extend, default_mismatch)
+
+	def __dealloc__(self):
+		del self.thisptr
+
+	def __len__(self):
+		return self.thisptr.size()
+
+	def detect(self, Read read, cigartuples, str query_sequence, int reference_start, size_t first=0):
+		"""
+		Add the alleles of the variants (starting at index first) covered by an alignment
+		to read. The alignment is given by its CIGAR as a list of (operation, length) pairs
+		(AlignedSegment.cigartuples), its query sequence and reference start.
+
+		Return the number of variants added to read.
+		"""
+		assert read.thisptr != NULL
+		if not cigartuples or query_sequence is None:
+			return 0
+		return self.thisptr.detect(read.thisptr, reference_start, cigartuples, query_sequence.encode(), first)
+
+	def cache_stats(self):
+		"""
+		Return how many realignments were answered from the cache (hits) and how many
+		had to be computed (misses).
+		"""
+		cdef cpp.realignment_cache_stats_t stats = self.thisptr.get_cache_stats()
+		return {"hits": stats.hits, "misses": stats.misses}
+
+
+cdef class PileupCounter:
+	"""
+	Count the bases of alignments at each position of a region of a chromosome and find
+	the positions at which alternative bases are frequent (see find_snv_candidates)
+	"""
+	def __cinit__(self, int start, str reference, unsigned int min_base_quality=5):
+		"""
+		start -- position (0-based) of the first base of the region
+		reference -- reference sequence of the region
+		min_base_quality -- bases with lower quality are not counted
+		"""
+		self.thisptr = new cpp.PileupCounter(start, reference.encode(), min_base_quality)
+
+	def __dealloc__(self):
+		del self.thisptr
+
+	def add(self, str name, int reference_start, cigartuples, str query_sequence, bytes query_qualities, int mate_start=-1):
+		"""
+		Count the bases of an alignment, given by its name, reference start, CIGAR (as list of
+		(operation, length) pairs), query sequence and base qualities (bytes, empty if not
+		available). Alignments must be added in the order of their reference start.
+
+		mate_start -- reference start of the mate if the mate may overlap the alignment. If
+		    both mates are added, overlapping bases are counted only once.
+		"""
+		if not cigartuples or query_sequence is None:
+			return
+		self.thisptr.add(name.encode(), reference_start, cigartuples, query_sequence.encode(), query_qualities, mate_start)
+
+	def candidates(self, unsigned int min_absolute, double min_relative, bool multi_allelics=False):
+		"""
+		Return a list of (position, reference base, alternative bases) tuples for the positions
+		at which alternative bases occur at least min_absolute times and in a fraction of at
+		least min_relative of the alternative and reference bases. Alternative bases are
+		ordered by decreasing frequency. Unless multi_allelics is set, only the most frequent
+		alternative base is reported, and positions with two equally frequent ones are skipped.
+		"""
+		cdef vector[cpp.pileup_candidate_t] candidates
+		cdef cpp.pileup_candidate_t candidate
+		with nogil:
+			candidates = self.thisptr.get_candidates(min_absolute, min_relative, multi_allelics)
+		result = []
+		for candidate in candidates:
+			alternatives = candidate.alternatives.decode()
+			result.append((candidate.position, chr(candidate.reference), list(alternatives)))
+		return result
+
+	def count(self, int position, str base):
+		"""Return how often the given base (one of ACGTN) was counted at a position"""
+		return self.thisptr.get_count(position, ord(base))
+
+
+cdef class ReadMerger:
+	"""
+	Merge reads that likely come from the same haplotype into super reads
+	(see whatshap.merge.ReadMerger for the meaning of the parameters).
+	"""
+	def __cinit__(self, double error_rate, double max_error_rate, double positive_threshold, double negative_threshold):
+		self.thisptr = new cpp.ReadMerger(error_rate, max_error_rate, positive_threshold, negative_threshold)
+
+	def __dealloc__(self):
+		del self.thisptr
+
+	def get_thresholds(self):
+		"""
+		Return the minimum difference between matching and mismatching alleles of
+		a pair of reads to be merged, and vice versa to be kept apart.
+		"""
+		return self.thisptr.get_match_threshold(), self.thisptr.get_mismatch_threshold()
+
+	def merge(self, ReadSet readset):
+		"""
+		Return the merged reads as a new ReadSet and a dict with the number of edges
+		and connected components of the graphs of reads to be merged ("blue") and
+		to be kept apart ("notblue").
+		"""
+		cdef cpp.read_merging_stats_t stats
+		cdef cpp.ReadSet* merged
+		with nogil:
+			merged = self.thisptr.merge(readset.thisptr[0], &stats)
+		result = ReadSet()
+		del result.thisptr
+		result.thisptr = merged
+		return result, {
+			"blue_edges": stats.blue_edges,
+			"blue_components": stats.blue_components,
+			"notblue_edges": stats.notblue_edges,
+			"notblue_components": stats.notblue_components,
+		}
+
+
 cdef class PedigreeDPTable:
-	def __cinit__(self, ReadSet readset, recombcost, Pedigree pedigree, bool distrust_genotypes = False, positions = None):
+	def __cinit__(self, ReadSet readset, recombcost, Pedigree pedigree, bool distrust_genotypes = False, positions = None, unsigned int threads = 1, checkpoint_policy = "sqrt", size_t memory_limit = 0, bool incremental = False, PedigreeDPTable previous = None):
 		"""Build the DP table from the given read set which is assumed to be sorted;
 		that is, the variants in each read must be sorted by position and the reads
 		in the read set must also be sorted (by position of their left-most variant).
+
+		Large DP columns are processed using the given number of threads. The
+		result does not depend on the number of threads.
+
+		checkpoint_policy determines which DP columns are kept in memory for the
+		backtrace: "all", "sqrt" (every sqrt(n)-th column), "log" (O(log n) columns)
+		or "auto" (least recomputation within memory_limit bytes).
+
+		With incremental=True, the columns stored according to the checkpoint policy
+		are kept after the backtrace, such that the table can later be passed as
+		previous when the reads of the same pedigree change (e.g. because new reads
+		were added). Then, only the columns affected by the changed reads and the
+		following columns, until their costs agree with the previous table up to a
+		constant, are recomputed. The result is the same as without previous.
+		Afterwards, previous cannot be used as previous again.
 		"""
+		if checkpoint_policy not in CHECKPOINT_POLICIES:
+			raise ValueError("Unknown checkpoint policy: {}".format(checkpoint_policy))
 		cdef vector[unsigned int]* c_positions = NULL
 		if positions is not None:
 			c_positions = new vector[unsigned int]()
 			for pos in positions:
 				c_positions.push_back(pos)
-		self.thisptr = new cpp.PedigreeDPTable(readset.thisptr, recombcost, pedigree.thisptr, distrust_genotypes, c_positions)
+		cdef cpp.PedigreeDPTable* c_previous = NULL
+		if previous is not None:
+			c_previous = previous.thisptr
+		cdef vector[unsigned int] c_recombcost = recombcost
+		cdef cpp.checkpoint_policy_t c_policy = CHECKPOINT_POLICIES[checkpoint_policy]
+		cdef cpp.ReadSet* reads = readset.thisptr
+		cdef cpp.Pedigree* c_pedigree = pedigree.thisptr
+		cdef cpp.PedigreeDPTable* table
+		# The table is computed in the constructor, which does not access Python objects.
+		# The read set is modified (read ids are reassigned) and referenced by the table, so
+		# it must not be used by another thread meanwhile.
+		with nogil:
+			table = new cpp.PedigreeDPTable(reads, c_recombcost, c_pedigree, distrust_genotypes, c_positions, threads, c_policy, memory_limit, incremental, c_previous)
+		self.thisptr = table
+		self.readset = readset
 		self.pedigree = pedigree
 
 	def __dealloc__(self):
@@ -329,8 +613,9 @@ cdef class PedigreeDPTable:
 
 		for i in range(len(self.pedigree)):
 			read_sets.push_back(new cpp.ReadSet())
-		transmission_vector_ptr = new vector[unsigned int]()
-		self.thisptr.get_super_reads(read_sets, transmission_vector_ptr)
+		cdef vector[unsigned int]* transmission_vector_ptr = new vector[unsigned int]()
+		with nogil:
+			self.thisptr.get_super_reads(read_sets, transmission_vector_ptr)
 		
 		results = []
 		for i in range(read_sets.size()):
@@ -343,6 +628,30 @@ cdef class PedigreeDPTable:
 		del transmission_vector_ptr
 		return results, python_transmission_vector
 
+	def get_phased_column(self, size_t column_index):
+		"""Returns the optimal haplotypes at a single column as a triple
+		(position, transmission_value, alleles), where alleles contains one triple
+		(allele0, allele1, quality) per individual in the pedigree.
+		The same caveat regarding the ReadSet as for get_super_reads applies.
+		"""
+		if column_index >= self.thisptr.get_column_count():
+			raise IndexError("Column index out of range")
+		cdef unsigned int transmission_value = 0
+		cdef vector[cpp.phased_variant_t] alleles = self.thisptr.get_phased_column(column_index, &transmission_value)
+		return (
+			self.thisptr.get_position(column_index),
+			transmission_value,
+			[(a.allele0, a.allele1, a.quality) for a in alleles],
+		)
+
+	def phased_columns(self):
+		"""Yields the optimal haplotypes column by column (see get_phased_column) from left
+		to right. This gives the same alleles as get_super_reads, but computes them only when
+		requested, such that output for the first columns can be written before all haplotypes
+		are known to the caller."""
+		for column_index in range(self.thisptr.get_column_count()):
+			yield self.get_phased_column(column_index)
+
 	def get_optimal_cost(self):
 		"""Returns the cost resulting from solving the Minimum Error Correction (MEC) problem."""
 		return self.thisptr.get_optimal_score()
@@ -355,6 +664,22 @@ cdef class PedigreeDPTable:
 		del p
 		return result
 
+	def get_peak_memory(self):
+		"""Returns the maximum number of bytes used for storing DP columns at the same time."""
+		return self.thisptr.get_peak_memory()
+
+	def get_checkpoint_policy(self):
+		"""Returns the checkpoint policy that has been used (never "auto")."""
+		policy = self.thisptr.get_checkpoint_policy()
+		for name, value in CHECKPOINT_POLICIES.items():
+			if value == policy:
+				return name
+
+	def get_computed_column_count(self):
+		"""Returns the number of DP columns computed (including recomputations), not counting
+		columns reused from a previous table."""
+		return self.thisptr.get_computed_column_count()
+
 
 cdef class Pedigree:
 	def __cinit__(self, numeric_sample_ids):
@@ -444,9 +769,105 @@ cdef class PhredGenotypeLikelihoods:
 		return result
 	
 	
+cdef class GeneticMap:
+	"""
+	Genetic map of one chromosome, given as cumulative genetic distances (in cM) at
+	sorted positions. Recombination costs for a list of positions are computed in a
+	single pass, locating the positions in the map by binary search.
+	"""
+	def __cinit__(self, positions, cumulative_distances):
+		cdef vector[unsigned int] c_positions = positions
+		cdef vector[double] c_distances = cumulative_distances
+		self.thisptr = new cpp.GeneticMap(c_positions, c_distances)
+
+	def __dealloc__(self):
+		del self.thisptr
+
+	def __len__(self):
+		return self.thisptr.size()
+
+	def cumulative_distance(self, unsigned int position):
+		"""Return the (interpolated) cumulative genetic distance at position"""
+		return self.thisptr.get_cumulative_distance(position)
+
+	def recombination_costs(self, positions):
+		"""
+		Return a list of the phred-scaled recombination probabilities between consecutive
+		positions (the first entry is 0)
+		"""
+		cdef vector[unsigned int] c_positions = positions
+		cdef vector[unsigned int] costs
+		with nogil:
+			costs = self.thisptr.compute_recombination_costs(c_positions)
+		return costs
+
+
 def binomial_coefficient(int n, int k):
 	return cpp.binomial_coefficient(n, k)
 
+
+def get_column_arena_stats():
+	"""Returns statistics on the reuse of DP column buffers (in the calling thread) as a dict
+	with keys acquired, reused, allocated and retained_bytes."""
+	cdef cpp.column_arena_stats_t stats = cpp.get_column_arena_stats()
+	return dict(
+		acquired=stats.acquired,
+		reused=stats.reused,
+		allocated=stats.allocated,
+		retained_bytes=stats.retained_bytes,
+	)
+
+
+def clear_column_arenas():
+	"""Frees all DP column buffers kept for reuse (in the calling thread)."""
+	cpp.clear_column_arenas()
+
+
+def set_instrumentation_enabled(bint enabled):
+	"""Enables or disables the counters and timers of the core algorithms (in all threads of
+	this process). They are disabled by default."""
+	cpp.set_instrumentation_enabled(enabled)
+
+
+def is_instrumentation_enabled():
+	return cpp.is_instrumentation_enabled()
+
+
+def reset_instrumentation():
+	"""Sets all counters and timers of the core algorithms to zero."""
+	cpp.reset_instrumentation()
+
+
+def get_instrumentation():
+	"""Returns the counters and timers of the core algorithms (column counts, maximum column
+	sizes, bytes of the DP columns and times in nanoseconds of the DP tables, cluster editing
+	and haplotype threading) as a dict that maps names to values."""
+	return {
+		cpp.instrumentation_counter_name(i).decode(): cpp.get_instrumentation_counter(i)
+		for i in range(cpp.instrumentation_counter_count())
+	}
+
+
+def merge_instrumentation(total, counters):
+	"""Adds counters obtained from get_instrumentation() (for example in another process)
+	to the dict total. Counters holding maxima are merged by taking the maximum."""
+	for name, value in counters.items():
+		if "_max_" in name:
+			total[name] = max(total.get(name, 0), value)
+		else:
+			total[name] = total.get(name, 0) + value
+
+
+def get_pedigree_topology_cache_size():
+	"""Returns the number of distinct pedigree topologies (number of individuals and trio
+	relationships) for which pedigree partitions are cached and shared between DP tables."""
+	return cpp.get_pedigree_topology_cache_size()
+
+
+def clear_pedigree_topology_cache():
+	"""Removes all cached pedigree topologies. DP tables that still use them are not affected."""
+	cpp.clear_pedigree_topology_cache()
+
 			
 cdef class Genotype:
 	
@@ -514,26 +935,70 @@ def get_max_genotype_alleles():
 
 
 cdef class GenotypeDPTable:
-	def __cinit__(self, numeric_sample_ids, ReadSet readset, recombcost, Pedigree pedigree, positions = None):
+	def __cinit__(self, numeric_sample_ids, ReadSet readset, recombcost, Pedigree pedigree, positions = None, precision = "longdouble", checkpoint_policy = "sqrt", size_t memory_limit = 0, bool concurrent = False):
 		"""Build the DP table from the given read set which is assumed to be sorted;
 		that is, the variants in each read must be sorted by position and the reads
 		in the read set must also be sorted (by position of their left-most variant).
+
+		precision -- numeric type used by the forward-backward algorithm, either
+		"longdouble" (long double, most precise) or "double" (faster, likelihoods agree up to
+		rounding errors)
+
+		checkpoint_policy determines which columns of backward probabilities are kept
+		in memory for the forward pass: "all", "sqrt" (every sqrt(n)-th column), "log"
+		(O(log n) columns) or "auto" (least recomputation within memory_limit bytes).
+		The result does not depend on it.
+
+		concurrent -- if True, run the forward and the backward pass at the same time on
+		two threads, which meet in the middle (likelihoods agree up to rounding errors)
 		"""
+		if precision not in ("longdouble", "double"):
+			raise ValueError("precision must be 'longdouble' or 'double', not {!r}".format(precision))
+		if checkpoint_policy not in CHECKPOINT_POLICIES:
+			raise ValueError("Unknown checkpoint policy: {}".format(checkpoint_policy))
 		cdef vector[unsigned int]* c_positions = NULL
 		if positions is not None:
 			c_positions = new vector[unsigned int]()
 			for pos in positions:
 				c_positions.push_back(pos)
-		self.thisptr = new cpp.GenotypeDPTable(readset.thisptr, recombcost, pedigree.thisptr, c_positions)
+		cdef vector[unsigned int] c_recombcost = recombcost
+		cdef cpp.checkpoint_policy_t c_policy = CHECKPOINT_POLICIES[checkpoint_policy]
+		cdef cpp.ReadSet* reads = readset.thisptr
+		cdef cpp.Pedigree* c_pedigree = pedigree.thisptr
+		cdef cpp.GenotypeDPTable* table = NULL
+		cdef cpp.GenotypeDPTableDouble* double_table = NULL
+		cdef bool use_double = precision == "double"
+		# See PedigreeDPTable regarding the GIL and the read set
+		with nogil:
+			if use_double:
+				double_table = new cpp.GenotypeDPTableDouble(reads, c_recombcost, c_pedigree, c_positions, c_policy, memory_limit, concurrent)
+			else:
+				table = new cpp.GenotypeDPTable(reads, c_recombcost, c_pedigree, c_positions, c_policy, memory_limit, concurrent)
+		self.thisptr = table
+		self.double_ptr = double_table
+		self.readset = readset
 		self.pedigree = pedigree
 		self.numeric_sample_ids = numeric_sample_ids
 
 	def __dealloc__(self):
 		del self.thisptr
+		del self.double_ptr
 
 	def get_genotype_likelihoods(self, sample_id, unsigned int pos):
+		if self.double_ptr != NULL:
+			return PhredGenotypeLikelihoods(self.double_ptr.get_genotype_likelihoods(self.numeric_sample_ids[sample_id],pos))
 		return PhredGenotypeLikelihoods(self.thisptr.get_genotype_likelihoods(self.numeric_sample_ids[sample_id],pos))
 
+	def get_checkpoint_policy(self):
+		"""Returns the checkpoint policy that has been used (never "auto")."""
+		if self.double_ptr != NULL:
+			policy = self.double_ptr.get_checkpoint_policy()
+		else:
+			policy = self.thisptr.get_checkpoint_policy()
+		for name, value in CHECKPOINT_POLICIES.items():
+			if value == policy:
+				return name
+
 
 def compute_genotypes(ReadSet readset, positions = None):
 	cdef vector[cpp.Genotype]* genotypes_vector = new vector[cpp.Genotype]()
@@ -543,7 +1008,9 @@ def compute_genotypes(ReadSet readset, positions = None):
 		c_positions = new vector[unsigned int]()
 		for pos in positions:
 			c_positions.push_back(pos)
-	cpp.compute_genotypes(readset.thisptr[0], genotypes_vector, gl_vector, c_positions)
+	cdef cpp.ReadSet* reads = readset.thisptr
+	with nogil:
+		cpp.compute_genotypes(reads[0], genotypes_vector, gl_vector, c_positions)
 	# TODO: Inefficient
 	genotypes = [Genotype(genotype.as_vector()) for genotype in genotypes_vector[0]]
 	#genotypes = list(genotypes_vector[0])
@@ -553,6 +1020,134 @@ def compute_genotypes(ReadSet readset, positions = None):
 	return genotypes, gls
 
 
+def compute_genotypes_batch(readsets, positions, unsigned int threads = 1):
+	"""Genotype several read sets (e.g. one per sample) at the same positions, using
+	the given number of threads. Each read set must be sorted. Returns a list with
+	one (genotypes, gls) pair for each read set, as returned by compute_genotypes.
+	"""
+	cdef vector[cpp.ReadSet*] c_readsets
+	cdef ReadSet readset
+	for readset in readsets:
+		c_readsets.push_back(readset.thisptr)
+	cdef vector[unsigned int] c_positions = positions
+	cdef vector[double] gl_vector
+	cdef vector[cpp.Genotype] genotypes_vector
+	# The read sets are only read, but must not be modified by other threads meanwhile
+	with nogil:
+		cpp.compute_genotypes_batch(c_readsets, c_positions, &gl_vector, &genotypes_vector, threads)
+	cdef size_t n = c_positions.size()
+	cdef size_t i, j
+	results = []
+	for i in range(c_readsets.size()):
+		genotypes = [Genotype(genotypes_vector[i * n + j].as_vector()) for j in range(n)]
+		gls = [(gl_vector[(i * n + j) * 3], gl_vector[(i * n + j) * 3 + 1], gl_vector[(i * n + j) * 3 + 2]) for j in range(n)]
+		results.append((genotypes, gls))
+	return results
+
+
+def compare_diploid_blocks(phasings0, phasings1):
+	"""
+	Compare two diploid phasings of a number of blocks. Each phasing of a block is
+	given as a pair of haplotype strings with one character per allele (such as
+	"0110"). Return a list with one tuple (switches, switch_flip_switches,
+	switch_flip_flips, hamming, diff_genotypes) per block, as computed by
+	whatshap.cli.compare.compare_blocks.
+	"""
+	cdef vector[cpp.diploid_phasing_t] c_phasings0 = [(h0.encode(), h1.encode()) for h0, h1 in phasings0]
+	cdef vector[cpp.diploid_phasing_t] c_phasings1 = [(h0.encode(), h1.encode()) for h0, h1 in phasings1]
+	cdef vector[cpp.block_comparison_t] results
+	with nogil:
+		results = cpp.compare_diploid_blocks(c_phasings0, c_phasings1)
+	cdef size_t i
+	py_results = []
+	for i in range(results.size()):
+		py_results.append((
+			results[i].switches,
+			results[i].switch_flip_switches,
+			results[i].switch_flip_flips,
+			results[i].hamming,
+			results[i].diff_genotypes,
+		))
+	return py_results
+
+
+def assign_read_haplotypes(ReadSet readset, positions, phasesets, alleles, bint use_bx_tags, unsigned int linked_read_cutoff):
+	"""
+	Assign the reads to the haplotypes of a phased sample as 'whatshap haplotag' does, merging
+	reads with the same BX tag into read clouds (see readclouds.h). Variant i is at
+	positions[i] (sorted), in phase set phasesets[i] and has allele alleles[i] on haplotype 0.
+
+	Return a triple (read_haplotypes, clouds, n_multiple_phase_sets). read_haplotypes is a
+	list of (read name, haplotype, quality, phase set) tuples for all phased reads, clouds
+	is a list of (BX tag, reference start, haplotype, phase set) tuples for the read that
+	each phased cloud was built for, and n_multiple_phase_sets is the number of clouds with
+	variants in several phase sets.
+	"""
+	cdef vector[unsigned int] c_positions = positions
+	cdef vector[int] c_phasesets = phasesets
+	cdef vector[int] c_alleles = alleles
+	cdef vector[cpp.read_haplotype_t] read_haplotypes
+	cdef vector[cpp.read_cloud_t] clouds
+	cdef cpp.ReadSet* reads = readset.thisptr
+	cdef size_t n_multiple
+	with nogil:
+		n_multiple = cpp.assign_read_haplotypes(reads[0], c_positions, c_phasesets, c_alleles, use_bx_tags, linked_read_cutoff, &read_haplotypes, &clouds)
+	cdef cpp.Read* read
+	cdef size_t i
+	py_read_haplotypes = []
+	for i in range(read_haplotypes.size()):
+		read = reads.get(read_haplotypes[i].read_index)
+		py_read_haplotypes.append((
+			read.getName().decode('utf-8'),
+			read_haplotypes[i].haplotype,
+			read_haplotypes[i].quality,
+			read_haplotypes[i].phaseset,
+		))
+	py_clouds = []
+	for i in range(clouds.size()):
+		read = reads.get(clouds[i].read_index)
+		py_clouds.append((
+			read.getBXTag().decode('utf-8'),
+			read.getReferenceStart(),
+			clouds[i].haplotype,
+			clouds[i].phaseset,
+		))
+	return py_read_haplotypes, py_clouds, n_multiple
+
+
+cdef class VcfRewriter:
+	"""
+	Rewrite the genotype fields of VCF records in text form (see vcfrewriter.h): the values
+	of the FORMAT keys in remove_tags are dropped, all genotypes are unphased and the
+	phases given by set_phase() are applied to the first sample. If phased_chromosomes_only
+	is set, records on chromosomes without phases are dropped.
+	"""
+	def __cinit__(self, remove_tags=(), unsigned int threads=1, bool phased_chromosomes_only=False):
+		cdef vector[string] c_remove_tags = [tag.encode() for tag in remove_tags]
+		self.thisptr = new cpp.VcfRewriter(c_remove_tags, threads, phased_chromosomes_only)
+
+	def __dealloc__(self):
+		del self.thisptr
+
+	def set_phase(self, str chromosome, unsigned int position, int allele0, int allele1, int phase_set):
+		"""
+		Phase the first sample at the biallelic SNV at the given (0-based) position
+		as allele0|allele1 with the given phase set (if the alleles differ).
+		"""
+		self.thisptr.set_phase(chromosome.encode(), position, allele0, allele1, phase_set)
+
+	def rewrite(self, bytes chunk):
+		"""
+		Return the rewritten records of chunk, which must consist of complete lines.
+		Chunks must be given in the order of the file.
+		"""
+		cdef string c_chunk = chunk
+		cdef string result
+		with nogil:
+			self.thisptr.rewrite(c_chunk, &result)
+		return result
+
+
 def compute_polyploid_genotypes(ReadSet readset, ploidy, positions=None):
 	cdef vector[cpp.Genotype]* genotypes_vector = new vector[cpp.Genotype]()
 	cdef vector[unsigned int]* c_positions = NULL
@@ -560,15 +1155,27 @@ def compute_polyploid_genotypes(ReadSet readset, ploidy, positions=None):
 		c_positions = new vector[unsigned int]()
 		for pos in positions:
 			c_positions.push_back(pos)
-	cpp.compute_polyploid_genotypes(readset.thisptr[0], ploidy, genotypes_vector, c_positions)
+	cdef cpp.ReadSet* reads = readset.thisptr
+	cdef size_t c_ploidy = ploidy
+	with nogil:
+		cpp.compute_polyploid_genotypes(reads[0], c_ploidy, genotypes_vector, c_positions)
 	genotypes = list([ gt.as_vector() for gt in genotypes_vector[0] ])
 	del genotypes_vector
 	return genotypes
 
 
 cdef class HapChatCore:
+	# Largest column coverage that can be phased
+	MAX_COVERAGE = cpp.HAPCHAT_MAX_COVERAGE
+
 	def __cinit__(self, ReadSet readset):
-		self.thisptr = new cpp.HapChatCore(readset.thisptr)
+		cdef cpp.ReadSet* reads = readset.thisptr
+		cdef cpp.HapChatCore* core
+		# The problem is solved in the constructor, which does not access Python objects.
+		# Releasing the GIL allows solving several instances in parallel threads.
+		with nogil:
+			core = new cpp.HapChatCore(reads)
+		self.thisptr = core
 	def __dealloc__(self):
 		del self.thisptr
 	def get_length(self):
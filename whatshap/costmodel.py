@@ -0,0 +1,143 @@
+"""
+Predict the running times of the phasing algorithms (engines) for a phasing problem
+
+'whatshap phase --algorithm auto' uses these predictions to choose the faster engine for
+each family and chromosome. Both DP algorithms need time exponential in the coverage of a
+column: the WhatsHap DP (PedigreeDPTable) enumerates all 2^coverage bipartitions of the
+reads for each of the 4^trios transmission vectors, and HapChat enumerates the ways of
+correcting at most computeK(coverage) entries, which for its default error rate and
+significance level also grows like 2^coverage. They differ in the constant factors: the
+WhatsHap DP is faster at low coverage, but its columns no longer fit into the CPU caches at
+high coverage, where HapChat, which needs much less memory, becomes faster.
+
+The coefficients were measured with the C++ benchmarks in src/benchmarks/ (single thread).
+Predicted and actual times are logged, such that a coefficient can be recalibrated as
+actual time divided by the logged number of work units.
+"""
+from bisect import bisect_left, bisect_right
+from collections import Counter
+from dataclasses import dataclass
+from typing import Dict, List
+
+from whatshap.core import ReadSet
+
+
+@dataclass
+class ProblemFeatures:
+    """Properties of a phasing problem that determine the running time of the engines"""
+
+    # maps each coverage to the number of columns with that coverage
+    coverage_histogram: Dict[int, int]
+    individuals: int = 1
+    trios: int = 0
+
+    @property
+    def columns(self) -> int:
+        return sum(self.coverage_histogram.values())
+
+    @property
+    def max_coverage(self) -> int:
+        return max(self.coverage_histogram, default=0)
+
+
+def compute_features(
+    readset: ReadSet, positions: List[int], individuals: int = 1, trios: int = 0
+) -> ProblemFeatures:
+    """
+    Compute the features of phasing the reads at the given (sorted) positions. As in the DP
+    tables, a read covers all columns between its first and its last variant.
+    """
+    # coverage changes at the first and after the last column of each read
+    changes = [0] * (len(positions) + 1)
+    for read in readset:
+        first = bisect_left(positions, read[0].position)
+        last = bisect_right(positions, read[len(read) - 1].position)
+        if first < last:
+            changes[first] += 1
+            changes[last] -= 1
+    histogram: Counter = Counter()
+    coverage = 0
+    for change in changes[:-1]:
+        coverage += change
+        histogram[coverage] += 1
+    return ProblemFeatures(dict(histogram), individuals, trios)
+
+
+@dataclass
+class EnginePrediction:
+    engine: str
+    # work units (DP entries, weighted by their cost relative to cached ones and divided by
+    # the number of threads that compute their column)
+    units: float
+    seconds: float
+
+
+class CostModel:
+    # seconds per DP entry of the WhatsHap DP if a column fits into the CPU caches
+    WHATSHAP_SECONDS_PER_ENTRY = 6e-8
+    # columns with more entries than this are slowed down by memory accesses ...
+    WHATSHAP_CACHED_ENTRIES = 2 ** 16
+    # ... up to this factor (reached at four times the number of cached entries)
+    WHATSHAP_UNCACHED_FACTOR = 2.6
+    # seconds per 2^coverage for each column of HapChat
+    HAPCHAT_SECONDS_PER_UNIT = 1.2e-7
+    # overhead of a column (iterating over the reads, backtracing), for both engines
+    SECONDS_PER_COLUMN = 1e-6
+    # PedigreeDPTable gives each thread at least this many entries of a column
+    # (MIN_ROWS_PER_THREAD in pedigreedptable.cpp)
+    WHATSHAP_MIN_ENTRIES_PER_THREAD = 2 ** 12
+
+    def __init__(self, hapchat_max_coverage: int, threads: int = 1):
+        """
+        hapchat_max_coverage -- largest coverage that HapChat supports
+            (HapChatCore.MAX_COVERAGE)
+        threads -- number of threads of the WhatsHap DP (HapChat is single-threaded)
+        """
+        self._hapchat_max_coverage = hapchat_max_coverage
+        self._threads = threads
+
+    def whatshap_units(self, features: ProblemFeatures) -> float:
+        units = 0.0
+        for coverage, columns in features.coverage_histogram.items():
+            entries = 2 ** coverage * 4 ** features.trios
+            if entries <= self.WHATSHAP_CACHED_ENTRIES:
+                factor = 1.0
+            else:
+                # interpolate linearly in the logarithm of the number of entries
+                excess = min((entries // self.WHATSHAP_CACHED_ENTRIES).bit_length() - 1, 2)
+                factor = 1.0 + (self.WHATSHAP_UNCACHED_FACTOR - 1.0) * excess / 2
+            threads = max(1, min(self._threads, entries // self.WHATSHAP_MIN_ENTRIES_PER_THREAD))
+            units += columns * entries * factor / threads
+        return units
+
+    def hapchat_units(self, features: ProblemFeatures) -> float:
+        histogram = features.coverage_histogram
+        return float(sum(columns * 2 ** coverage for coverage, columns in histogram.items()))
+
+    def can_use_hapchat(self, features: ProblemFeatures, distrust_genotypes: bool) -> bool:
+        """HapChat phases a single individual and cannot change genotypes"""
+        return (
+            features.individuals == 1
+            and not distrust_genotypes
+            and features.max_coverage <= self._hapchat_max_coverage
+        )
+
+    def predict(
+        self, features: ProblemFeatures, distrust_genotypes: bool
+    ) -> List[EnginePrediction]:
+        """Return the predictions for all engines that can solve the problem"""
+        overhead = features.columns * self.SECONDS_PER_COLUMN
+        units = self.whatshap_units(features)
+        predictions = [
+            EnginePrediction(
+                "whatshap", units, overhead + units * self.WHATSHAP_SECONDS_PER_ENTRY
+            )
+        ]
+        if self.can_use_hapchat(features, distrust_genotypes):
+            units = self.hapchat_units(features)
+            predictions.append(
+                EnginePrediction(
+                    "hapchat", units, overhead + units * self.HAPCHAT_SECONDS_PER_UNIT
+                )
+            )
+        return predictions
@@ -9,6 +9,8 @@ from libcpp.vector cimport vector
 from libcpp.pair cimport pair
 from libc.stdint cimport uint32_t, uint64_t
 from libcpp.unordered_map cimport unordered_map
+from libcpp.unordered_set cimport unordered_set
+from libcpp.memory cimport shared_ptr
 
 
 cdef extern from "../src/read.h":
@@ -51,10 +53,15 @@ cdef extern from "../src/readset.h":
 		void add(Read*) except +
 		string toString() except +
 		int size() except +
-		void sort() except +
+		void sort() nogil except +
 		Read* get(int) except +
 		Read* getByName(string, int) except +
 		ReadSet* subset(IndexSet*) except +
+		string serialize() except +
+		@staticmethod
+		ReadSet* deserialize(string) except +
+		@staticmethod
+		ReadSet* load(string, int) nogil except +
 		# TODO: Check why adding "except +" here doesn't compile
 		vector[unsigned int]* get_positions()
 
@@ -72,14 +79,59 @@ cdef extern from "../src/pedigree.h":
 		unsigned int triple_count() except +
 
 
+cdef extern from "../src/pedigreecolumncostcomputer.h":
+	cdef cppclass phased_variant_t "PedigreeColumnCostComputer::phased_variant_t":
+		int allele0
+		int allele1
+		unsigned int quality
+
+
+cdef extern from "../src/checkpointpolicy.h":
+	ctypedef enum checkpoint_policy_t:
+		CHECKPOINT_AUTO
+		CHECKPOINT_ALL
+		CHECKPOINT_SQRT
+		CHECKPOINT_LOG
+
+
 cdef extern from "../src/pedigreedptable.h":
 	cdef cppclass PedigreeDPTable:
-		PedigreeDPTable(ReadSet*, vector[unsigned int], Pedigree* pedigree, bool distrust_genotypes, vector[unsigned int]* positions) except +
-		void get_super_reads(vector[ReadSet*]*, vector[unsigned int]* transmission_vector) except +
+		PedigreeDPTable(ReadSet*, vector[unsigned int], Pedigree* pedigree, bool distrust_genotypes, vector[unsigned int]* positions, unsigned int threads, checkpoint_policy_t checkpoint_policy, size_t memory_limit, bool incremental, PedigreeDPTable* previous) nogil except +
+		void get_super_reads(vector[ReadSet*]*, vector[unsigned int]* transmission_vector) nogil except +
+		unsigned int get_column_count()
+		unsigned int get_position(size_t column_index) except +
+		vector[phased_variant_t] get_phased_column(size_t column_index, unsigned int* transmission_value) except +
 		int get_optimal_score() except +
 		vector[bool]* get_optimal_partitioning()
+		checkpoint_policy_t get_checkpoint_policy()
+		size_t get_peak_memory()
+		size_t get_computed_column_count()
 		
 		
+cdef extern from "../src/columnarena.h":
+	ctypedef struct column_arena_stats_t:
+		size_t acquired
+		size_t reused
+		size_t allocated
+		size_t retained_bytes
+	cdef column_arena_stats_t get_column_arena_stats()
+	cdef void clear_column_arenas()
+
+
+cdef extern from "../src/instrumentation.h":
+	cdef void set_instrumentation_enabled(bool enabled)
+	cdef bool is_instrumentation_enabled()
+	cdef void reset_instrumentation()
+	cdef size_t instrumentation_counter_count()
+	cdef const char* instrumentation_counter_name(size_t counter) except +
+	cdef uint64_t get_instrumentation_counter(size_t counter) except +
+
+
+cdef extern from "../src/pedigreetopology.h":
+	cdef size_t get_pedigree_topology_cache_size()
+	cdef void clear_pedigree_topology_cache()
+
+
 cdef extern from "../src/binomial.h":
 	cdef int binomial_coefficient(int n, int k) except +
 		
@@ -105,9 +157,14 @@ cdef extern from "../src/genotype.h":
 
 
 cdef extern from "../src/genotypedptable.h":
-	cdef cppclass GenotypeDPTable:
-		GenotypeDPTable(ReadSet*, vector[unsigned int], Pedigree* pedigree, vector[unsigned int]* positions) except +
+	cdef cppclass GenotypeDPTable "GenotypeDPTable<long double>":
+		GenotypeDPTable(ReadSet*, vector[unsigned int], Pedigree* pedigree, vector[unsigned int]* positions, checkpoint_policy_t checkpoint_policy, size_t memory_limit, bool concurrent) nogil except +
+		vector[long double] get_genotype_likelihoods(unsigned int individual, unsigned int position) except +
+		checkpoint_policy_t get_checkpoint_policy()
+	cdef cppclass GenotypeDPTableDouble "GenotypeDPTable<double>":
+		GenotypeDPTableDouble(ReadSet*, vector[unsigned int], Pedigree* pedigree, vector[unsigned int]* positions, checkpoint_policy_t checkpoint_policy, size_t memory_limit, bool concurrent) nogil except +
 		vector[long double] get_genotype_likelihoods(unsigned int individual, unsigned int position) except +
+		checkpoint_policy_t get_checkpoint_policy()
 
 cdef extern from "../src/phredgenotypelikelihoods.h":
 	cdef cppclass PhredGenotypeLikelihoods:
@@ -122,6 +179,14 @@ cdef extern from "../src/phredgenotypelikelihoods.h":
 		void get_genotypes(vector[Genotype]&) except +
 
 
+cdef extern from "../src/geneticmap.h":
+	cdef cppclass GeneticMap:
+		GeneticMap(vector[unsigned int]&, vector[double]&) except +
+		size_t size()
+		double get_cumulative_distance(unsigned int) except +
+		vector[unsigned int] compute_recombination_costs(vector[unsigned int]&) nogil except +
+
+
 cdef extern from "../src/genotypedistribution.h":
 	cdef cppclass GenotypeDistribution:
 		GenotypeDistribution(double hom_ref_prob, double het_prob, double hom_alt_prob) except +
@@ -129,13 +194,15 @@ cdef extern from "../src/genotypedistribution.h":
 
 
 cdef extern from "../src/genotyper.h":
-	void compute_genotypes(ReadSet, vector[Genotype]* genotypes, vector[GenotypeDistribution]* genotype_likelihoods, vector[unsigned int]* positions)  except +
-	void compute_polyploid_genotypes(ReadSet, size_t ploidy, vector[Genotype]* genotypes, vector[unsigned int]* positions)  except +
+	void compute_genotypes(const ReadSet&, vector[Genotype]* genotypes, vector[GenotypeDistribution]* genotype_likelihoods, vector[unsigned int]* positions) nogil except +
+	void compute_genotypes_batch(vector[ReadSet*]& readsets, vector[unsigned int]& positions, vector[double]* genotype_likelihoods, vector[Genotype]* genotypes, unsigned int threads) nogil except +
+	void compute_polyploid_genotypes(const ReadSet&, size_t ploidy, vector[Genotype]* genotypes, vector[unsigned int]* positions) nogil except +
 
 
 cdef extern from "../src/hapchat/hapchatcore.cpp":
+	int HAPCHAT_MAX_COVERAGE "MAX_COVERAGE"
 	cdef cppclass HapChatCore:
-		HapChatCore(ReadSet*)
+		HapChatCore(ReadSet*) nogil except +
 		void get_super_reads(vector[ReadSet*]*)
 		vector[bool]* get_optimal_partitioning()
 		int get_length()
@@ -144,8 +211,8 @@ cdef extern from "../src/hapchat/hapchatcore.cpp":
 
 cdef extern from "../src/polyphase/clustereditingsolver.h":
 	cdef cppclass ClusterEditingSolver:
-		ClusterEditingSolver(TriangleSparseMatrix m, bool bundleEdges) except +
-		ClusterEditingSolution run() except +
+		ClusterEditingSolver(TriangleSparseMatrix m, bool bundleEdges, uint32_t threads) except +
+		ClusterEditingSolution run() nogil except +
 
 
 cdef extern from "../src/polyphase/clustereditingsolution.h":
@@ -168,32 +235,183 @@ cdef extern from "../src/polyphase/trianglesparsematrix.h":
 		vector[pair[uint32_t, uint32_t]] getEntries() except +
 
 
+cdef extern from "../src/polyphase/readscoreindex.h":
+	cdef cppclass ReadScoreIndex:
+		ReadScoreIndex(const ReadSet* readset, uint32_t minOverlap, uint32_t threads) nogil except +
+		ReadScoreIndex* restrictToVariants(uint32_t firstVariant, uint32_t endVariant) nogil except +
+		uint32_t getMinOverlap()
+		uint32_t getNumReads()
+		uint64_t getNumPairs()
+		const vector[uint32_t]& getPositions()
+		string serialize() except +
+		@staticmethod
+		ReadScoreIndex* deserialize(string) except +
+		@staticmethod
+		ReadScoreIndex* load(string) nogil except +
+
+
 cdef extern from "../src/polyphase/readscoring.h":
 	cdef cppclass ReadScoring:
 		ReadScoring() except +
-		void scoreReadsetGlobal(TriangleSparseMatrix* result, ReadSet* readset, uint32_t minOverlap,uint32_t ploidy) except +
-		void scoreReadsetLocal(TriangleSparseMatrix* result, ReadSet* readset, vector[vector[uint32_t]] refHaplotypes, uint32_t minOverlap, uint32_t ploidy) except +
+		void scoreReadsetGlobal(TriangleSparseMatrix* result, const ReadSet* readset, uint32_t minOverlap,uint32_t ploidy, uint32_t threads) nogil except +
+		void scoreReadsetLocal(TriangleSparseMatrix* result, const ReadSet* readset, vector[vector[uint32_t]]& refHaplotypes, uint32_t minOverlap, uint32_t ploidy, uint32_t threads) nogil except +
+		void scoreIndexGlobal(TriangleSparseMatrix* result, const ReadScoreIndex& index, uint32_t minOverlap) nogil except +
+		void scoreIndexLocal(TriangleSparseMatrix* result, const ReadScoreIndex& index, vector[vector[uint32_t]]& refHaplotypes, uint32_t minOverlap, uint32_t ploidy) nogil except +
+		vector[uint32_t] computeLinkageBasedBlockStarts(const ReadSet* readset, uint32_t ploidy, bool singleLinkage) nogil except +
+
 
+cdef extern from "../src/polyphase/threadingpreprocessor.h":
+	cdef cppclass ThreadingPreprocessor:
+		ThreadingPreprocessor(ReadSet* readset, vector[vector[uint32_t]]& clustering, uint32_t ploidy) nogil except +
+		uint32_t getNumPositions()
+		vector[uint32_t] getGenomePositions()
+		vector[uint32_t] getClusterStarts()
+		vector[uint32_t] getClusterEnds()
+		vector[vector[uint32_t]] getCovMap()
+		vector[vector[double]] getCompressedCoverage()
+		vector[vector[uint32_t]] getCompressedConsensus()
+		vector[vector[double]] getConsensusFraction()
+		vector[uint32_t] getIndependentStarts()
+		double getSimilarity(uint32_t pos, uint32_t c1, uint32_t c2)
+		vector[vector[uint32_t]] improvePathOnMultiswitches(vector[vector[uint32_t]]& path) except +
+		vector[vector[uint32_t]] improvePathOnCollapsedswitches(vector[vector[uint32_t]]& path) except +
+		vector[string] getHaplotypes(vector[vector[uint32_t]]& path) except +
 
 cdef extern from "../src/polyphase/haplothreader.h":
 	cdef cppclass HaploThreader:
-		HaploThreader(uint32_t ploidy, double switchCost, double affineSwitchCost, bool symmetryOptimization, uint32_t rowLimit) except +
+		HaploThreader(uint32_t ploidy, double switchCost, double affineSwitchCost, bool symmetryOptimization, uint32_t rowLimit, uint32_t beamWidth, uint64_t maxMemory, uint32_t threads) except +
 		vector[vector[uint32_t]] computePaths(uint32_t start, uint32_t end,
 					vector[vector[uint32_t]]& covMap,
                     vector[vector[double]]& coverage, 
                     vector[vector[uint32_t]]& consensus,
-                    vector[unordered_map[uint32_t, uint32_t]]& genotypes) except +
+                    vector[unordered_map[uint32_t, uint32_t]]& genotypes) nogil except +
 		vector[vector[uint32_t]] computePaths(vector[uint32_t]& blockStarts,
 					vector[vector[uint32_t]]& covMap,
                     vector[vector[double]]& coverage, 
                     vector[vector[uint32_t]]& consensus,
-                    vector[unordered_map[uint32_t, uint32_t]]& genotypes) except +
+                    vector[unordered_map[uint32_t, uint32_t]]& genotypes) nogil except +
+		vector[vector[uint32_t]] computePaths(ThreadingPreprocessor& preprocessor,
+                    vector[unordered_map[uint32_t, uint32_t]]& genotypes) nogil except +
 		
+cdef extern from "../src/polyphase/blockphaser.h":
+	cdef cppclass BlockPhasingResult:
+		vector[vector[uint32_t]] clustering
+		vector[vector[uint32_t]] path
+		vector[string] haplotypes
+		vector[uint32_t] cutPositions
+		vector[vector[uint32_t]] haploidCuts
+	cdef cppclass BlockPhaser:
+		BlockPhaser(uint32_t ploidy, uint32_t minOverlap, bool bundleEdges, uint32_t refinements, uint32_t blockCutSensitivity, uint32_t beamWidth, uint64_t threadingMemory, uint32_t threads) except +
+		vector[BlockPhasingResult] phaseBlocks(vector[ReadSet*]& blocks, vector[vector[unordered_map[uint32_t, uint32_t]]]& genotypes, const ReadScoreIndex* index, vector[uint32_t]& blockStarts) nogil except +
+		void computeCutPositions(vector[vector[uint32_t]]& path, uint32_t numClusters, vector[uint32_t]& cutPositions, vector[vector[uint32_t]]& haploidCuts) except +
+
 cdef extern from "../src/polyphase/switchflipcalculator.h":
 	cdef cppclass SwitchFlipCalculator:
-		SwitchFlipCalculator(uint32_t ploidy, double switchCost, double flipCost) except +
+		SwitchFlipCalculator(uint32_t ploidy, double switchCost, double flipCost, uint32_t threads) except +
 		pair[double, double] compare(vector[vector[uint32_t]]& phasing0,
                     vector[vector[uint32_t]]& phasing1,
                     vector[uint32_t]& switchesInColumn,
                     vector[vector[uint32_t]]& flippedHapsInColumn,
-                    vector[vector[uint32_t]]& permInColumn) except +
+                    vector[vector[uint32_t]]& permInColumn) nogil except +
+		vector[pair[double, double]] compareBlocks(vector[vector[vector[uint32_t]]]& phasings0,
+                    vector[vector[vector[uint32_t]]]& phasings1) nogil except +
+
+
+cdef extern from "../src/readselection.h":
+	ctypedef struct read_selection_round_t:
+		vector[unsigned int] covering_reads
+		vector[unsigned int] bridging_reads
+		size_t undecided
+	vector[unsigned int] select_reads(const ReadSet&, unsigned int, unordered_set[int]*, bool, vector[read_selection_round_t]*) nogil except +
+	vector[unsigned int] select_reads(const ReadSet&, const vector[unsigned int]&, unordered_set[int]*, bool, vector[read_selection_round_t]*) nogil except +
+	ctypedef struct coverage_limit_t:
+		unsigned int position
+		unsigned int max_coverage
+	size_t estimate_column_memory(unsigned int, unsigned int) nogil
+	vector[coverage_limit_t] choose_coverage_limits(const ReadSet&, unsigned int, unsigned int, unsigned int, size_t, unsigned int, size_t*) nogil except +
+
+
+cdef extern from "../src/readmerger.h":
+	ctypedef struct read_merging_stats_t:
+		size_t blue_edges
+		size_t blue_components
+		size_t notblue_edges
+		size_t notblue_components
+	cdef cppclass ReadMerger:
+		ReadMerger(double, double, double, double) except +
+		ReadSet* merge(ReadSet&, read_merging_stats_t*) nogil except +
+		int get_match_threshold()
+		int get_mismatch_threshold()
+
+
+cdef extern from "../src/phasingcomparison.h":
+	ctypedef struct block_comparison_t:
+		size_t switches
+		size_t switch_flip_switches
+		size_t switch_flip_flips
+		size_t hamming
+		size_t diff_genotypes
+	ctypedef pair[string, string] diploid_phasing_t
+	vector[block_comparison_t] compare_diploid_blocks(vector[diploid_phasing_t]&, vector[diploid_phasing_t]&) nogil except +
+
+
+cdef extern from "../src/readclouds.h":
+	ctypedef struct read_haplotype_t:
+		size_t read_index
+		int haplotype
+		long long quality
+		int phaseset
+	ctypedef struct read_cloud_t:
+		size_t read_index
+		int haplotype
+		int phaseset
+	size_t assign_read_haplotypes(const ReadSet&, vector[unsigned int]& positions, vector[int]& phasesets, vector[int]& alleles, bool use_bx_tags, unsigned int linked_read_cutoff, vector[read_haplotype_t]* read_haplotypes, vector[read_cloud_t]* clouds) nogil except +
+
+
+cdef extern from "../src/vcfrewriter.h":
+	cdef cppclass VcfRewriter:
+		VcfRewriter(vector[string]&, unsigned int, bool) except +
+		void set_phase(string&, unsigned int, int, int, int) except +
+		void rewrite(string&, string*) nogil except +
+
+
+cdef extern from "../src/editdistance.h":
+	cdef cppclass EditDistance:
+		EditDistance() except +
+		int compute(const char*, size_t, const char*, size_t, int) except +
+
+
+cdef extern from "../src/referencesequence.h":
+	cdef cppclass ReferenceSequence:
+		ReferenceSequence(string&) except +
+		ReferenceSequence(string&, size_t, uint64_t, size_t, size_t) except +
+		size_t size()
+		bool is_mapped()
+		void append(long, long, string&) except +
+		string& get_path()
+		uint64_t get_offset()
+		size_t get_line_bases()
+		size_t get_line_width()
+
+
+cdef extern from "../src/alleledetector.h":
+	ctypedef struct realignment_cache_stats_t:
+		size_t hits
+		size_t misses
+	cdef cppclass AlleleDetector:
+		AlleleDetector(vector[int]&, vector[string]&, vector[string]&, shared_ptr[ReferenceSequence], unsigned int, bool, int, int, int) except +
+		size_t detect(Read*, int, vector[pair[int,int]]&, string&, size_t) except +
+		size_t size()
+		realignment_cache_stats_t get_cache_stats()
+
+
+cdef extern from "../src/pileupcounter.h":
+	ctypedef struct pileup_candidate_t:
+		int position
+		char reference
+		string alternatives
+	cdef cppclass PileupCounter:
+		PileupCounter(int, string&, unsigned int) except +
+		void add(string&, int, vector[pair[int,int]]&, string&, string&, int) except +
+		vector[pileup_candidate_t] get_candidates(unsigned int, double, bool) nogil except +
+		unsigned int get_count(int, char) except +
@@ -9,6 +9,8 @@ from collections import Counter, OrderedDict, defaultdict
 from dataclasses import dataclass
 import logging
 
+from whatshap.core import GeneticMap
+
 logger = logging.getLogger(__name__)
 
 
@@ -172,6 +174,12 @@ class RecombinationCostComputer(ABC):
 class GeneticMapRecombinationCostComputer(RecombinationCostComputer):
     def __init__(self, genetic_map_path):
         self._genetic_map = self.load_genetic_map(genetic_map_path)
+        # Costs are computed by the native implementation, which gives the same
+        # results as recombination_cost_map()
+        self._native_map = GeneticMap(
+            [entry.position for entry in self._genetic_map],
+            [entry.cum_distance for entry in self._genetic_map],
+        )
 
     @staticmethod
     def load_genetic_map(filename):
@@ -213,7 +221,7 @@ class GeneticMapRecombinationCostComputer(RecombinationCostComputer):
         return genetic_map
 
     def compute(self, positions):
-        return recombination_cost_map(self._genetic_map, positions)
+        return self._native_map.recombination_costs(positions)
 
 
 class UniformRecombinationCostComputer(RecombinationCostComputer):
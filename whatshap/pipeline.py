@@ -0,0 +1,145 @@
+"""
+Run the stages of processing a sequence of chromosomes concurrently
+
+Reading the alignments of a chromosome is mostly I/O and allele detection, while
+phasing it is spent in the DP, which does not hold the GIL. With prefetch(), the next
+chromosome is read in a background thread while the current one is phased, and with a
+BackgroundWorker, the previous one is written meanwhile. Both use bounded queues such
+that only a limited number of chromosomes is held in memory at any time.
+"""
+import queue
+import threading
+from typing import Callable, Iterable, Iterator, Optional, TypeVar
+
+T = TypeVar("T")
+
+# How often (in seconds) a blocked background thread checks whether it should stop
+_POLL_INTERVAL = 0.1
+
+_END = object()
+
+
+def _put(items: queue.Queue, item, stop: threading.Event) -> bool:
+    """Put item into the queue unless stop is set first. Return whether it was put."""
+    while not stop.is_set():
+        try:
+            items.put(item, timeout=_POLL_INTERVAL)
+            return True
+        except queue.Full:
+            pass
+    return False
+
+
+def prefetch(iterable: Iterable[T], depth: int) -> Iterator[T]:
+    """
+    Iterate over iterable in a background thread, which stays up to depth items ahead of
+    the consumer. Exceptions raised while iterating are re-raised in the consumer. If the
+    consumer stops early, the background thread finishes its current item and stops.
+
+    depth -- maximum number of items waiting to be consumed. If 0, iterate in the
+        calling thread.
+    """
+    if depth <= 0:
+        yield from iterable
+        return
+    items: queue.Queue = queue.Queue(maxsize=depth)
+    stop = threading.Event()
+
+    def produce():
+        try:
+            for item in iterable:
+                if not _put(items, (item, None), stop):
+                    return
+            _put(items, (_END, None), stop)
+        except BaseException as e:
+            _put(items, (None, e), stop)
+
+    thread = threading.Thread(target=produce, name="whatshap-prefetch", daemon=True)
+    thread.start()
+    try:
+        while True:
+            item, exception = items.get()
+            if exception is not None:
+                raise exception
+            if item is _END:
+                return
+            yield item
+    finally:
+        stop.set()
+        thread.join()
+
+
+class BackgroundWorker:
+    """
+    Run functions one after another (in the order in which they were submitted) in a
+    background thread. Use as a context manager: on exit, all submitted functions are
+    run to completion. An exception raised by a submitted function is re-raised by the
+    next call to submit() or on exit, and no further functions are run.
+    """
+
+    def __init__(self, depth: int):
+        """
+        depth -- maximum number of submitted functions waiting to be run. If 0, functions
+            are run by submit() itself.
+        """
+        self._depth = depth
+        self._exception: Optional[BaseException] = None
+        self._thread: Optional[threading.Thread] = None
+        if depth > 0:
+            self._calls: queue.Queue = queue.Queue(maxsize=depth)
+            self._stop = threading.Event()
+            self._thread = threading.Thread(
+                target=self._run, name="whatshap-background-worker", daemon=True
+            )
+            self._thread.start()
+
+    def _run(self):
+        while not self._stop.is_set():
+            try:
+                call = self._calls.get(timeout=_POLL_INTERVAL)
+            except queue.Empty:
+                continue
+            if call is _END or self._stop.is_set():
+                return
+            function, args = call
+            try:
+                function(*args)
+            except BaseException as e:
+                self._exception = e
+                self._stop.set()
+                return
+
+    def _raise_if_failed(self):
+        if self._exception is not None:
+            exception, self._exception = self._exception, None
+            raise exception
+
+    def submit(self, function: Callable, *args) -> None:
+        if self._thread is None:
+            function(*args)
+            return
+        self._raise_if_failed()
+        if not _put(self._calls, (function, args), self._stop):
+            self._raise_if_failed()
+
+    def close(self) -> None:
+        """Wait until all submitted functions have been run"""
+        if self._thread is None:
+            return
+        _put(self._calls, _END, self._stop)
+        self._thread.join()
+        self._thread = None
+        self._raise_if_failed()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        if exc_type is not None and self._thread is not None:
+            # Do not run functions that depend on a failed stage, but wait for the one
+            # that is currently running
+            self._stop.set()
+            self._thread.join()
+            self._thread = None
+            return
+        self.close()
@@ -8,17 +8,20 @@ from libcpp.string cimport string
 from libcpp.vector cimport vector
 from libcpp.pair cimport pair
 from libcpp.unordered_map cimport unordered_map
-from libc.stdint cimport uint32_t
+from libc.stdint cimport uint32_t, uint64_t
 from . cimport cpp
 cimport cython
 
 
 cdef class ClusterEditingSolver:
-    def __cinit__(self, TriangleSparseMatrix m, bundleEdges):
-        self.thisptr = new cpp.ClusterEditingSolver(m.thisptr[0], bundleEdges)
+    def __cinit__(self, TriangleSparseMatrix m, bundleEdges, uint32_t threads = 1):
+        self.thisptr = new cpp.ClusterEditingSolver(m.thisptr[0], bundleEdges, threads)
         self.m = m
     def run(self):
-        cdef cpp.ClusterEditingSolution solution = self.thisptr.run()
+        cdef cpp.ClusterEditingSolution solution
+        # The solver does not access Python objects, and self.m keeps the matrix alive
+        with nogil:
+            solution = self.thisptr.run()
         clusters = []
         n_clusters = solution.getNumClusters()
         for i in range(n_clusters):
@@ -54,42 +57,239 @@ cdef class TriangleSparseMatrix:
         return self.thisptr.size()
 
 
+def _read_score_index_from_bytes(data):
+    # module-level function such that pickle can find it by name
+    return ReadScoreIndex.from_bytes(data)
+
+
+cdef _wrap_read_score_index(cpp.ReadScoreIndex* index):
+    cdef ReadScoreIndex result = ReadScoreIndex.__new__(ReadScoreIndex)
+    result.thisptr = index
+    return result
+
+
+cdef class ReadScoreIndex:
+    """
+    Overlaps and differences of all read pairs of a read set (sorted by position) that share at least
+    min_overlap variants. The similarity scores of the reads can be computed from it for any ploidy
+    and larger minimum overlap without scanning the reads again, and the index can be restricted to
+    the variants of a block or stored in a file that is memory-mapped by load().
+    """
+    def __cinit__(self):
+        self.thisptr = NULL
+
+    def __init__(self, ReadSet readset, uint32_t min_overlap, uint32_t threads = 1):
+        cdef cpp.ReadSet* reads = readset.thisptr
+        cdef cpp.ReadScoreIndex* index
+        with nogil:
+            index = new cpp.ReadScoreIndex(reads, min_overlap, threads)
+        self.thisptr = index
+
+    def __dealloc__(self):
+        del self.thisptr
+
+    def restrict(self, uint32_t first_variant, uint32_t end_variant):
+        """
+        Return the index of the block of variants first_variant, ..., end_variant-1 (by the rank of
+        their position), as split_readset in whatshap/cli/polyphase.py creates it for a block
+        """
+        cdef cpp.ReadScoreIndex* index
+        with nogil:
+            index = self.thisptr.restrictToVariants(first_variant, end_variant)
+        return _wrap_read_score_index(index)
+
+    def __len__(self):
+        return self.thisptr.getNumReads()
+
+    def num_pairs(self):
+        return self.thisptr.getNumPairs()
+
+    def min_overlap(self):
+        return self.thisptr.getMinOverlap()
+
+    def get_positions(self):
+        return self.thisptr.getPositions()
+
+    def to_bytes(self):
+        """Return a compact binary representation of this index"""
+        return self.thisptr.serialize()
+
+    @staticmethod
+    def from_bytes(bytes data):
+        """Create an index from the output of to_bytes()"""
+        return _wrap_read_score_index(cpp.ReadScoreIndex.deserialize(data))
+
+    @staticmethod
+    def load(str path):
+        """Create an index from a file containing the output of to_bytes(), which is memory-mapped while reading"""
+        cdef string _path = path.encode('UTF-8')
+        cdef cpp.ReadScoreIndex* index
+        with nogil:
+            index = cpp.ReadScoreIndex.load(_path)
+        return _wrap_read_score_index(index)
+
+    def __reduce__(self):
+        return (_read_score_index_from_bytes, (self.to_bytes(),))
+
+
 cdef class ReadScoring:
     def __cinit__(self):
         self.thisptr = new cpp.ReadScoring()
 
-    def scoreReadsetGlobal(self, ReadSet readset, uint32_t minOverlap, uint32_t ploidy):
+    def scoreReadsetGlobal(self, ReadSet readset, uint32_t minOverlap, uint32_t ploidy, uint32_t threads = 1):
         sim = TriangleSparseMatrix()
-        self.thisptr.scoreReadsetGlobal(sim.thisptr, readset.thisptr, minOverlap, ploidy)
+        cdef cpp.TriangleSparseMatrix* result = sim.thisptr
+        cdef cpp.ReadSet* reads = readset.thisptr
+        # The read set is only read, but must not be modified by other threads meanwhile
+        with nogil:
+            self.thisptr.scoreReadsetGlobal(result, reads, minOverlap, ploidy, threads)
         return sim
     
-    def scoreReadsetLocal(self, ReadSet readset, vector[vector[uint32_t]] refHaplotypes, uint32_t minOverlap, uint32_t ploidy):
+    def scoreReadsetLocal(self, ReadSet readset, vector[vector[uint32_t]] refHaplotypes, uint32_t minOverlap, uint32_t ploidy, uint32_t threads = 1):
+        sim = TriangleSparseMatrix()
+        cdef cpp.TriangleSparseMatrix* result = sim.thisptr
+        cdef cpp.ReadSet* reads = readset.thisptr
+        with nogil:
+            self.thisptr.scoreReadsetLocal(result, reads, refHaplotypes, minOverlap, ploidy, threads)
+        return sim
+
+    def scoreIndexGlobal(self, ReadScoreIndex index, uint32_t minOverlap):
         sim = TriangleSparseMatrix()
-        self.thisptr.scoreReadsetLocal(sim.thisptr, readset.thisptr, refHaplotypes, minOverlap, ploidy)
+        cdef cpp.TriangleSparseMatrix* result = sim.thisptr
+        cdef cpp.ReadScoreIndex* pairs = index.thisptr
+        with nogil:
+            self.thisptr.scoreIndexGlobal(result, pairs[0], minOverlap)
         return sim
+
+    def scoreIndexLocal(self, ReadScoreIndex index, vector[vector[uint32_t]] refHaplotypes, uint32_t minOverlap, uint32_t ploidy):
+        sim = TriangleSparseMatrix()
+        cdef cpp.TriangleSparseMatrix* result = sim.thisptr
+        cdef cpp.ReadScoreIndex* pairs = index.thisptr
+        with nogil:
+            self.thisptr.scoreIndexLocal(result, pairs[0], refHaplotypes, minOverlap, ploidy)
+        return sim
+
+    def computeLinkageBasedBlockStarts(self, ReadSet readset, uint32_t ploidy, bool singleLinkage = False):
+        cdef cpp.ReadSet* reads = readset.thisptr
+        cdef vector[uint32_t] starts
+        with nogil:
+            starts = self.thisptr.computeLinkageBasedBlockStarts(reads, ploidy, singleLinkage)
+        return starts
     
     
-def scoreReadsetGlobal(readset, minOverlap, ploidy):
+def scoreReadsetGlobal(readset, minOverlap, ploidy, threads = 1):
+    readscoring = ReadScoring()
+    sim = readscoring.scoreReadsetGlobal(readset, minOverlap, ploidy, threads)
+    del readscoring
+    return sim
+
+
+def scoreReadsetLocal(readset, minOverlap, ploidy, refHaplotypes = [], threads = 1):
+    readscoring = ReadScoring()
+    sim = readscoring.scoreReadsetLocal(readset, refHaplotypes, minOverlap, ploidy, threads)
+    del readscoring
+    return sim
+
+
+def scoreIndexGlobal(index, minOverlap):
     readscoring = ReadScoring()
-    sim = readscoring.scoreReadsetGlobal(readset, minOverlap, ploidy)
+    sim = readscoring.scoreIndexGlobal(index, minOverlap)
     del readscoring
     return sim
 
 
-def scoreReadsetLocal(readset, minOverlap, ploidy, refHaplotypes = []):
+def scoreIndexLocal(index, minOverlap, ploidy, refHaplotypes = []):
+    """Same as scoreReadsetLocal, but on a ReadScoreIndex of the read set"""
     readscoring = ReadScoring()
-    sim = readscoring.scoreReadsetLocal(readset, refHaplotypes, minOverlap, ploidy)
+    sim = readscoring.scoreIndexLocal(index, refHaplotypes, minOverlap, ploidy)
     del readscoring
     return sim
+
+
+def compute_linkage_based_block_starts(readset, ploidy, single_linkage = False):
+    """
+    Based on the connectivity of the reads, divide the variants of the readset (indexed by the rank of their
+    position) into intervals that can be phased independently and return the index of the first variant of
+    each interval. There are two modes how to decide whether two variants are connected:
+
+    single_linkage=True -- If there exists a read in the readset, which covers both variants, they are connected
+    single_linkage=False -- In order to connect two variants, we need at least reads from ploidy-1 different
+                            haplotypes. Two variants count as connected, if there sufficiently many reads covering
+                            both variants, with "sufficient" meaning, that the connecting reads have a chance of
+                            at least 98% that they cover at least ploidy-1 haplotypes.
+
+    First, only consecutive pairs are inspected. Then, this connectivity is made transitive, i.e. if the pair
+    (A,C) is connected, as well as the pair (B,C), then (A,B) is also connected. If the special case occurs, that
+    for three variants (in this order) A and C are connected, but neither is connected to variant B in between them,
+    then the variants are still divided as A|B|C, even though A and C are actually connected. This is because the
+    following steps require the splits to be intervals with no "holes" inside them.
+    """
+    readscoring = ReadScoring()
+    starts = readscoring.computeLinkageBasedBlockStarts(readset, ploidy, single_linkage)
+    del readscoring
+    return starts
     
     
+cdef class ThreadingPreprocessor:
+    def __cinit__(self, ReadSet readset, vector[vector[uint32_t]] clustering, uint32_t ploidy):
+        cdef cpp.ReadSet* reads = readset.thisptr
+        cdef cpp.ThreadingPreprocessor* pre
+        # All auxiliary data is computed in the constructor, which does not access Python objects
+        with nogil:
+            pre = new cpp.ThreadingPreprocessor(reads, clustering, ploidy)
+        self.thisptr = pre
+
+    def __dealloc__(self):
+        del self.thisptr
+
+    def get_num_positions(self):
+        return self.thisptr.getNumPositions()
+
+    def get_genome_positions(self):
+        return self.thisptr.getGenomePositions()
+
+    def get_cluster_start_end_positions(self):
+        starts = self.thisptr.getClusterStarts()
+        ends = self.thisptr.getClusterEnds()
+        return {c_id: (starts[c_id], ends[c_id]) for c_id in range(len(starts))}
+
+    def get_cov_map(self):
+        return self.thisptr.getCovMap()
+
+    def get_compressed_coverage(self):
+        return self.thisptr.getCompressedCoverage()
+
+    def get_compressed_consensus(self):
+        return self.thisptr.getCompressedConsensus()
+
+    def get_consensus_fraction(self):
+        return self.thisptr.getConsensusFraction()
+
+    def get_independent_starts(self):
+        return self.thisptr.getIndependentStarts()
+
+    def get_similarity(self, uint32_t pos, uint32_t c1, uint32_t c2):
+        return self.thisptr.getSimilarity(pos, c1, c2)
+
+    def improve_path_on_multiswitches(self, vector[vector[uint32_t]] path):
+        return self.thisptr.improvePathOnMultiswitches(path)
+
+    def improve_path_on_collapsedswitches(self, vector[vector[uint32_t]] path):
+        return self.thisptr.improvePathOnCollapsedswitches(path)
+
+    def get_haplotypes(self, vector[vector[uint32_t]] path):
+        return [hap.decode() for hap in self.thisptr.getHaplotypes(path)]
+
+
 cdef class HaploThreader:
-    def __cinit__(self, ploidy, switchCost, affineSwitchCost, symmetryOptimization, rowLimit):
-        self.thisptr = new cpp.HaploThreader(ploidy, switchCost, affineSwitchCost, symmetryOptimization, rowLimit)
+    def __cinit__(self, ploidy, switchCost, affineSwitchCost, symmetryOptimization, rowLimit, uint32_t beamWidth = 0, uint64_t maxMemory = 0, uint32_t threads = 1):
+        self.thisptr = new cpp.HaploThreader(ploidy, switchCost, affineSwitchCost, symmetryOptimization, rowLimit, beamWidth, maxMemory, threads)
         
     def computePathsBlockwise(self, vector[uint32_t]& blockStarts, vector[vector[uint32_t]]& covMap, vector[vector[double]]& coverage, vector[vector[uint32_t]]& consensus, vector[unordered_map[uint32_t, uint32_t]]& genotypes):
         cdef vector[vector[uint32_t]] path
-        path = self.thisptr.computePaths(blockStarts, covMap, coverage, consensus, genotypes)
+        # Phasing runs are computed on worker threads, which do not access Python objects
+        with nogil:
+            path = self.thisptr.computePaths(blockStarts, covMap, coverage, consensus, genotypes)
         
         # convert to python data structure
         py_path = []
@@ -104,9 +304,17 @@ cdef class HaploThreader:
         
         return py_path
 
+    def computePathsPreprocessed(self, ThreadingPreprocessor preprocessor, vector[unordered_map[uint32_t, uint32_t]]& genotypes):
+        cdef vector[vector[uint32_t]] path
+        cdef cpp.ThreadingPreprocessor* pre = preprocessor.thisptr
+        with nogil:
+            path = self.thisptr.computePaths(pre[0], genotypes)
+        return path
+
     def computePaths(self, uint32_t start, uint32_t end, vector[vector[uint32_t]]& covMap, vector[vector[double]]& coverage, vector[vector[uint32_t]]& consensus, vector[unordered_map[uint32_t, uint32_t]]& genotypes):
         cdef vector[vector[uint32_t]] path
-        path = self.thisptr.computePaths(start, end, covMap, coverage, consensus, genotypes)
+        with nogil:
+            path = self.thisptr.computePaths(start, end, covMap, coverage, consensus, genotypes)
         
         # convert to python data structure
         py_path = []
@@ -121,9 +329,66 @@ cdef class HaploThreader:
         
         return py_path
 
+cdef class BlockPhaser:
+    def __cinit__(self, uint32_t ploidy, uint32_t min_overlap, bool bundle_edges, uint32_t refinements, uint32_t block_cut_sensitivity, uint32_t beam_width = 0, uint64_t threading_memory = 0, uint32_t threads = 1):
+        self.thisptr = new cpp.BlockPhaser(ploidy, min_overlap, bundle_edges, refinements, block_cut_sensitivity, beam_width, threading_memory, threads)
+
+    def __dealloc__(self):
+        del self.thisptr
+
+    def phase_blocks(self, block_readsets, vector[vector[unordered_map[uint32_t, uint32_t]]] genotype_slices, ReadScoreIndex index = None, block_starts = None):
+        """
+        Phases every block readset with the genotypes of its variants. Returns, for every block, a tuple of clustering, path,
+        haplotypes, cut positions and haploid cut positions:
+
+        clustering -- A list of clusters, each a list of read ids inside the block.
+        path -- For every variant, the tuple of clusters through which the haplotypes are threaded.
+        haplotypes -- The haplotypes as strings over allele ids, one allele per variant.
+        cut positions -- The first variant (inside the block) of every phasing block, including 0.
+        haploid cut positions -- The cut positions of every haplotype.
+
+        If an index of the read set that the blocks were split from is given, the read pairs are scored from it. Then
+        block_starts must contain the first variant of every block, followed by the number of variants.
+        """
+        cdef vector[cpp.ReadSet*] blocks
+        cdef ReadSet readset
+        cdef vector[cpp.BlockPhasingResult] results
+        cdef cpp.ReadScoreIndex* pairs = NULL
+        cdef vector[uint32_t] starts
+        if index is not None:
+            pairs = index.thisptr
+            starts = block_starts
+        for readset in block_readsets:
+            blocks.push_back(readset.thisptr)
+        # Blocks are phased on worker threads, which only read the (unmodified) readsets and index
+        with nogil:
+            results = self.thisptr.phaseBlocks(blocks, genotype_slices, pairs, starts)
+
+        py_results = []
+        for i in range(results.size()):
+            py_results.append((
+                results[i].clustering,
+                results[i].path,
+                [hap.decode() for hap in results[i].haplotypes],
+                results[i].cutPositions,
+                results[i].haploidCuts,
+            ))
+        return py_results
+
+    def compute_cut_positions(self, vector[vector[uint32_t]] path, uint32_t num_clusters):
+        """
+        Return the cut positions and the haploid cut positions of the given threading path through
+        num_clusters clusters according to the block cut sensitivity.
+        """
+        cdef vector[uint32_t] cut_positions
+        cdef vector[vector[uint32_t]] haploid_cuts
+        self.thisptr.computeCutPositions(path, num_clusters, cut_positions, haploid_cuts)
+        return cut_positions, haploid_cuts
+
+
 cdef class SwitchFlipCalculator:
-    def __cinit__(self, ploidy, switch_cost=1, flip_cost=1):
-        self.thisptr = new cpp.SwitchFlipCalculator(ploidy, switch_cost, flip_cost)
+    def __cinit__(self, ploidy, switch_cost=1, flip_cost=1, threads=1):
+        self.thisptr = new cpp.SwitchFlipCalculator(ploidy, switch_cost, flip_cost, threads)
         self.ploidy = ploidy
     
     def compute_switch_flips_poly(self, phasing0, phasing1):
@@ -143,7 +408,10 @@ cdef class SwitchFlipCalculator:
         
         # run compare algorithm
         cdef pair[double, double] result
-        result = self.thisptr.compare(input0, input1, switches_in_column, flips_in_column, perm_in_column)
+        cdef vector[vector[uint32_t]] c_input0 = input0
+        cdef vector[vector[uint32_t]] c_input1 = input1
+        with nogil:
+            result = self.thisptr.compare(c_input0, c_input1, switches_in_column, flips_in_column, perm_in_column)
         
         backtracking_info = True
         if switches_in_column.size() == 0 or flips_in_column.size() == 0 or perm_in_column.size() == 0:
@@ -170,3 +438,28 @@ cdef class SwitchFlipCalculator:
                 py_perm_in_column.append(perm)
 
         return result.first, result.second, py_switches_in_column, py_flips_in_column, py_perm_in_column
+
+    def compare_blocks(self, phasings0, phasings1):
+        """
+        Compares several independent blocks at once, each given as a pair of haplotype-wise phasings
+        (as for compute_switch_flips_poly). The blocks are compared concurrently without holding
+        the GIL. Returns the number of switches and flips for every block.
+        """
+        assert len(phasings0) == len(phasings1)
+        cdef vector[vector[vector[uint32_t]]] input0
+        cdef vector[vector[vector[uint32_t]]] input1
+        cdef vector[vector[uint32_t]] block0
+        cdef vector[vector[uint32_t]] block1
+        for phasing0, phasing1 in zip(phasings0, phasings1):
+            assert len(phasing0) == len(phasing1) == self.ploidy
+            assert len(phasing0[0]) > 0
+            num_vars = len(phasing0[0])
+            block0 = [[int(phasing0[k][i]) for k in range(self.ploidy)] for i in range(num_vars)]
+            block1 = [[int(phasing1[k][i]) for k in range(self.ploidy)] for i in range(num_vars)]
+            input0.push_back(block0)
+            input1.push_back(block1)
+
+        cdef vector[pair[double, double]] results
+        with nogil:
+            results = self.thisptr.compareBlocks(input0, input1)
+        return [(results[i].first, results[i].second) for i in range(results.size())]
@@ -0,0 +1,64 @@
+"""
+Persistent on-disk cache of the ReadScoreIndex of each read set phased by polyphase
+
+Comparing all overlapping read pairs is the most expensive part of computing the read
+similarities. Since the overlaps and differences only depend on the reads, they can be
+stored once and reused by later runs that only change the ploidy, the block cut
+sensitivity or other phasing parameters. Entries are named after a hash of the read set
+and the minimum overlap and contain the output of ReadScoreIndex.to_bytes(), which is
+memory-mapped when loading.
+"""
+import hashlib
+import logging
+import os
+from tempfile import NamedTemporaryFile
+
+from .core import ReadSet, ReadScoreIndex
+
+logger = logging.getLogger(__name__)
+
+
+class ReadScoreIndexCache:
+    # Change this whenever the meaning of cached indices changes, such that older entries
+    # are no longer used
+    VERSION = 1
+
+    def __init__(self, directory: str):
+        """directory -- directory in which entries are stored (created if necessary)"""
+        os.makedirs(directory, exist_ok=True)
+        self._directory = directory
+        self.hits = 0
+        self.misses = 0
+
+    def _path(self, readset: ReadSet, min_overlap: int) -> str:
+        key = hashlib.sha256()
+        key.update(
+            "whatshap-score-index-cache {}\n{}\n".format(self.VERSION, min_overlap).encode()
+        )
+        key.update(readset.to_bytes())
+        return os.path.join(self._directory, key.hexdigest() + ".scoreindex")
+
+    def get(self, readset: ReadSet, min_overlap: int, threads: int = 1) -> ReadScoreIndex:
+        """
+        Return the index of the given (sorted) read set, loading it from the cache if possible
+        and computing and storing it otherwise
+        """
+        path = self._path(readset, min_overlap)
+        if os.path.exists(path):
+            try:
+                index = ReadScoreIndex.load(path)
+            except RuntimeError as e:
+                logger.warning("Ignoring unreadable score index cache entry %s: %s", path, e)
+            else:
+                logger.info("Using read pair overlaps from score index cache entry %s", path)
+                self.hits += 1
+                return index
+        self.misses += 1
+        index = ReadScoreIndex(readset, min_overlap, threads)
+        # Write to a temporary file first such that concurrent runs never see partial entries
+        with NamedTemporaryFile(
+            dir=self._directory, prefix=".", suffix=".tmp", delete=False
+        ) as f:
+            f.write(index.to_bytes())
+        os.replace(f.name, path)
+        return index
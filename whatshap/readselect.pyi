@@ -1,4 +1,4 @@
-from typing import Optional, Set
+from typing import List, Optional, Set, Tuple
 
 from whatshap.core import ReadSet
 
@@ -7,4 +7,13 @@ def readselection(
     max_cov: int,
     preferred_source_ids: Optional[Set[int]] = ...,
     bridging: bool = ...,
+    coverage_limits: Optional[List[Tuple[int, int]]] = ...,
 ) -> Set[int]: ...
+def choose_coverage_limits(
+    readset: ReadSet,
+    min_coverage: int,
+    max_coverage: int,
+    transmission_configurations: int,
+    memory_budget: int,
+    window_size: int,
+) -> Tuple[List[Tuple[int, int]], int]: ...
@@ -0,0 +1,100 @@
+"""
+Persistent on-disk cache of the ReadSets computed by ReadSetReader
+
+Allele detection is the most expensive step of reading a chromosome. Since the
+result only depends on the input files, the variants and the extraction parameters,
+it can be stored once and reused by later runs (of the same or another subcommand).
+Entries are named after a hash of everything they depend on and contain the output
+of ReadSet.to_bytes(), which is memory-mapped when loading.
+"""
+import hashlib
+import logging
+import os
+from tempfile import NamedTemporaryFile
+from typing import Dict, Iterable, List, Optional, Tuple
+
+from .core import ReadSet
+
+logger = logging.getLogger(__name__)
+
+
+class ReadSetCache:
+    # Change this whenever the meaning of cached ReadSets changes (for example, when allele
+    # detection is modified), such that older entries are no longer used
+    VERSION = 1
+
+    def __init__(
+        self,
+        directory: str,
+        paths: List[str],
+        reference: Optional[str],
+        parameters: Dict[str, object],
+    ):
+        """
+        directory -- directory in which entries are stored (created if necessary)
+        paths -- BAM/CRAM paths the reads are taken from
+        reference -- path to the reference FASTA (can be None)
+        parameters -- all other parameters that influence the result of allele detection
+        """
+        os.makedirs(directory, exist_ok=True)
+        self._directory = directory
+        base = hashlib.sha256()
+        base.update("whatshap-readset-cache {}\n".format(self.VERSION).encode())
+        for path in list(paths) + ([reference] if reference is not None else []):
+            base.update(self._file_identity(path).encode())
+        for name, value in sorted(parameters.items()):
+            base.update("{}={!r}\n".format(name, value).encode())
+        self._base = base
+        self.hits = 0
+        self.misses = 0
+
+    @staticmethod
+    def _file_identity(path: str) -> str:
+        """Files are identified by path, size and modification time instead of their contents"""
+        st = os.stat(path)
+        return "{}\t{}\t{}\n".format(os.path.abspath(path), st.st_size, st.st_mtime_ns)
+
+    def _path(
+        self,
+        chromosome: str,
+        variants: Iterable,
+        sample: Optional[str],
+        regions: Optional[List[Tuple[int, Optional[int]]]],
+    ) -> str:
+        key = self._base.copy()
+        key.update("{}\n{}\n{!r}\n".format(chromosome, sample, regions).encode())
+        for variant in variants:
+            key.update(
+                "{}\t{}\t{}\n".format(
+                    variant.position, variant.reference_allele, variant.alternative_allele
+                ).encode()
+            )
+        return os.path.join(self._directory, key.hexdigest() + ".readset")
+
+    def load(self, chromosome, variants, sample, regions, sample_id: int) -> Optional[ReadSet]:
+        """
+        Return the cached ReadSet for the given arguments of ReadSetReader.read() or None if
+        there is none. The sample ids of all reads are set to sample_id.
+        """
+        path = self._path(chromosome, variants, sample, regions)
+        if os.path.exists(path):
+            try:
+                readset = ReadSet.load(path, sample_id)
+            except RuntimeError as e:
+                logger.warning("Ignoring unreadable read cache entry %s: %s", path, e)
+            else:
+                logger.info("Using reads with detected alleles from read cache entry %s", path)
+                self.hits += 1
+                return readset
+        self.misses += 1
+        return None
+
+    def store(self, chromosome, variants, sample, regions, readset: ReadSet) -> None:
+        """Store a ReadSet returned by ReadSetReader.read() for the given arguments"""
+        path = self._path(chromosome, variants, sample, regions)
+        # Write to a temporary file first such that concurrent runs never see partial entries
+        with NamedTemporaryFile(
+            dir=self._directory, prefix=".", suffix=".tmp", delete=False
+        ) as f:
+            f.write(readset.to_bytes())
+        os.replace(f.name, path)
@@ -6,68 +6,6 @@ from .core import HaploThreader
 logger = logging.getLogger(__name__)
 
 
-def run_threading(readset, clustering, ploidy, genotypes, block_cut_sensitivity):
-    """
-    Main method for the threading stage of the polyploid phasing algorithm. Takes the following input:
-
-    readset -- The fragment matrix to phase
-    clustering -- A list of clusters. Each cluster is a list of read ids, indicating which reads it contains. Every read can
-                  only be present in one cluster.
-    ploidy -- Number of haplotypes to phase
-    block_cut_sensitivity -- Policy how conversative the block cuts have to be done. 0 is one phasing block no matter what, 5
-                             is very short blocks
-
-    For every variant, the threading algorithm finds a tuple of clusters through which the haplotypes can be threaded with
-    minimal cost. Costs arise when the positional coverage of a cluster does not match the number of haplotypes threaded through it
-    or when haplotypes switch the cluster on two consecutive positions.
-    """
-
-    # compute auxiliary data
-    index, rev_index = get_position_map(readset)
-    num_vars = len(rev_index)
-    positions = get_cluster_start_end_positions(readset, clustering, index)
-    coverage = get_coverage(readset, clustering, index)
-    cov_map = get_pos_to_clusters_map(coverage, ploidy)
-    consensus = get_local_cluster_consensus(readset, clustering, cov_map, positions)
-
-    # compute threading through the clusters
-    path = compute_threading_path(
-        readset, clustering, num_vars, coverage, cov_map, consensus, ploidy, genotypes
-    )
-
-    # we can look at the sequences again to use the most likely continuation, when two or more clusters switch at the same position
-    num_clusters = len(clustering)
-    c_to_c_global = compute_cluster_to_cluster_similarity(
-        readset, clustering, index, consensus, cov_map
-    )
-    path = improve_path_on_multiswitches(path, num_clusters, c_to_c_global)
-
-    # we can look at the sequences again to use the most likely continuation, when a haplotype leaves a collapsed cluster (currently inactive)
-    path = improve_path_on_collapsedswitches(path, num_clusters, c_to_c_global)
-
-    cut_positions, haploid_cuts = compute_cut_positions(path, block_cut_sensitivity, num_clusters)
-
-    logger.debug("Cut positions: {}".format(cut_positions))
-    for i in range(ploidy):
-        logger.debug("Cut positions on phase {}: {}".format(i, haploid_cuts[i]))
-
-    # compute haplotypes
-    haplotypes = []
-    for i in range(ploidy):
-        hap = ""
-        alleles_as_strings = []
-        for pos in range(len(path)):
-            c_id = path[pos][i]
-            allele = consensus[pos][c_id] if c_id in consensus[pos] else -1
-            if allele == -1:
-                alleles_as_strings.append("n")
-            else:
-                alleles_as_strings.append(str(allele))
-        haplotypes.append(hap.join(alleles_as_strings))
-
-    return (cut_positions, haploid_cuts, path, haplotypes)
-
-
 def compute_threading_path(
     readset,
     clustering,
@@ -79,6 +17,9 @@ def compute_threading_path(
     genotypes,
     switch_cost=32.0,
     affine_switch_cost=8.0,
+    beam_width=0,
+    memory_limit=0,
+    threads=1,
 ):
     """
     Runs the threading algorithm for the haplotypes using the given costs for switches. The normal switch cost is the
@@ -86,6 +27,14 @@ def compute_threading_path(
     is always cost 1.0). The affine switch cost is an additional offset for every position, where a switch occurs.
     These additional costs encourage the threading algorithm to summarize multiple switches on consecutive positions
     into one big switch.
+
+    If beam_width is positive, only the beam_width best tuples are kept for every variant. Candidate tuples are scored
+    in order of a lower bound on their cost, so most of them do not need to be compared against all predecessors. If
+    memory_limit (in bytes) is positive, the number of kept tuples is limited such that the DP table fits into it.
+    Scoring the candidates of a variant uses up to the given number of threads in this mode.
+
+    The threading is split at every variant that shares no cluster with its predecessor: all transitions into such a
+    variant switch every haplotype, so the parts before and after it can be threaded independently (and concurrently).
     """
 
     logger.debug("Computing threading paths ..")
@@ -107,107 +56,42 @@ def compute_threading_path(
         compressed_consensus.append(consensus_list)
 
     # run threader
-    threader = HaploThreader(
-        ploidy, switch_cost, affine_switch_cost, True, 16 * 2**ploidy if ploidy > 6 else 0
+    threader = create_haplothreader(
+        ploidy, switch_cost, affine_switch_cost, beam_width, memory_limit, threads
     )
+    block_starts = [0] + [
+        pos for pos in range(1, num_vars) if set(cov_map[pos]).isdisjoint(cov_map[pos - 1])
+    ]
     path = threader.computePathsBlockwise(
-        [0], cov_map, compressed_coverage, compressed_consensus, genotypes
+        block_starts, cov_map, compressed_coverage, compressed_consensus, genotypes
     )
     assert len(path) == num_vars
 
     return path
 
 
-def compute_cut_positions(path, block_cut_sensitivity, num_clusters):
+def create_haplothreader(
+    ploidy,
+    switch_cost=32.0,
+    affine_switch_cost=8.0,
+    beam_width=0,
+    memory_limit=0,
+    threads=1,
+):
     """
-    Takes a threading as input and computes on which positions a cut should be made according the cut sensitivity. The levels mean:
-
-    0 -- No cuts at all, even if regions are not connected by any reads
-    1 -- Only cut, when regions are not connected by any reads (is already done in advance, so nothing to do here)
-    2 -- Only cut, when regions are not connected by a sufficient number of reads (also lready done in advance)
-    3 -- Cut between two positions, if at least two haplotypes switch their cluster on this transition. In this case it is ambiguous,
-         how the haplotype are continued and we might get switch errors if we choose arbitrarily.
-    4 -- Additionally to 3, cut every time a haplotype leaves a collapsed region. Collapsed regions are positions, where multiple
-         haplotypes go through the same cluster. If one cluster leaves (e.g. due to decline in cluster coverage), we do not know
-         which to pick, so we are conservative here. Exception: If a cluster contains a set of multiple haplotypes since the start of
-         the current block and hap wants to leave, we do not need a cut, since it does not matter which haps leaves. Default option.
-    5 -- Cut every time a haplotype switches clusters. Most conservative, but also very short blocks.
-
-    The list of cut positions contains the first position of every block. Therefore, position 0 is always in the cut list. The second
-    return value is a list of cut positions for every haplotype individually.
+    Returns a HaploThreader with the given costs and limits (see compute_threading_path). For ploidies above 6, the number
+    of tuples per variant is limited to 16 * 2^ploidy.
     """
-
-    cut_positions = [0]
-    haploid_cut_positions = []
-
-    if len(path) == 0:
-        return cut_positions
-
-    ploidy = len(path[0])
-    haploid_cut_positions = [[0] for _ in range(ploidy)]
-
-    dissim_threshold = 1
-    rise_fall_dissim = 0
-    if block_cut_sensitivity >= 3:
-        if block_cut_sensitivity >= 5:
-            # cut every time a haplotype jumps
-            dissim_threshold = 1
-            rise_fall_dissim = ploidy + 1
-        elif block_cut_sensitivity == 4:
-            # cut for every multi-switch and for every rise-fall-ploidy change
-            dissim_threshold = 2
-            rise_fall_dissim = ploidy + 1
-        else:
-            # cut for every multi-jump
-            dissim_threshold = 2
-            rise_fall_dissim = 0
-
-    if block_cut_sensitivity >= 3:
-        copynrs = []
-        for i in range(0, len(path)):
-            copynr = defaultdict(int)
-            for j in range(0, ploidy):
-                if path[i][j] not in copynr:
-                    copynr[path[i][j]] = 0
-                copynr[path[i][j]] += 1
-            copynrs.append(copynr)
-
-        cpn_rising = [False for c_id in range(num_clusters)]
-
-        for i in range(1, len(path)):
-            dissim = 0
-            clusters_cut = set()
-            for j in range(0, ploidy):
-                old_c = path[i - 1][j]
-                new_c = path[i][j]
-                if old_c != new_c:
-                    clusters_cut.add(old_c)
-                    rise_fall = False
-                    # check if previous cluster went down from copy number >= 2 to a smaller one >= 1
-                    if copynrs[i - 1][old_c] > copynrs[i][old_c] >= 1:
-                        if cpn_rising[old_c]:
-                            rise_fall = True
-                    # check if new cluster went up from copy number >= 1 to a greater one >= 2
-                    if copynrs[i][new_c] > copynrs[i - 1][new_c] >= 1:
-                        cpn_rising[new_c] = True
-                    # check if one cluster has been rising and then falling in the current block
-                    if rise_fall:
-                        dissim += rise_fall_dissim
-
-                    # count general switches
-                    dissim += 1
-
-            # TODO: Avoid deep indentation by using functions
-            if dissim >= dissim_threshold:
-                cpn_rising = [False] * num_clusters
-                cut_positions.append(i)
-
-                # get all cut threads
-                threads_cut = [j for j in range(ploidy) if path[i - 1][j] in clusters_cut]
-                for thread in threads_cut:
-                    haploid_cut_positions[thread].append(i)
-
-    return cut_positions, haploid_cut_positions
+    return HaploThreader(
+        ploidy,
+        switch_cost,
+        affine_switch_cost,
+        True,
+        16 * 2**ploidy if ploidy > 6 else 0,
+        beam_width,
+        memory_limit,
+        threads,
+    )
 
 
 def compute_cluster_to_cluster_similarity(readset, clustering, index, consensus, cov_map):
@@ -252,7 +136,7 @@ def improve_path_on_multiswitches(path, num_clusters, cluster_sim):
     """
     Post processing step after the threading. If two or more haplotypes switch clusters on the same position, we could use
     the similarity scores between the clusters to find the most likely continuation of the switching haplotypes. See the
-    description of the compute_cut_positions method for more details about block cuts.
+    description of BlockPhaser::computeCutPositions for more details about block cuts.
     """
 
     if len(path) == 0:
@@ -308,7 +192,7 @@ def improve_path_on_collapsedswitches(path, num_clusters, cluster_sim):
     """
     Post processing step after the threading. If a haplotype leaves a cluster on a collapsed region, we could use the
     similarity scores between the clusters to find the most likely continuation of the switching haplotypes. See the
-    description of the compute_cut_positions method for more details about block cuts.
+    description of BlockPhaser::computeCutPositions for more details about block cuts.
     """
     if len(path) == 0:
         return []
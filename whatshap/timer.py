@@ -31,6 +31,19 @@ class StageTimer:
         """
         return self._elapsed[stage]
 
+    def elapsed_times(self):
+        """Return a dict that maps each stage to the total time spent in it"""
+        return dict(self._elapsed)
+
+    def add(self, stage, elapsed):
+        """Add time spent in a stage that was measured elsewhere (such as in another process)"""
+        self._elapsed[stage] += elapsed
+
+    def merge(self, other: "StageTimer"):
+        """Add the times of all stages measured by another timer (such as in another thread)"""
+        for stage, elapsed in other.elapsed_times().items():
+            self.add(stage, elapsed)
+
     def sum(self):
         """Return sum of all times"""
         return sum(self._elapsed.values())
@@ -9,6 +9,8 @@ import sys
 import pyfaidx
 from dataclasses import dataclass
 
+from .core import ReferenceSequence
+
 
 class FastaNotIndexedError(Exception):
     pass
@@ -62,6 +64,24 @@ def IndexedFasta(path):
     return f
 
 
+def reference_sequence(fasta: pyfaidx.Fasta, chromosome: str) -> ReferenceSequence:
+    """
+    Return the sequence of a chromosome in a FASTA file opened with IndexedFasta.
+    Uncompressed files are memory-mapped such that only the accessed parts are read,
+    compressed ones are read into memory.
+
+    Raise KeyError if the chromosome is not in the FASTA file.
+    """
+    record = fasta.faidx.index[chromosome]
+    with open(fasta.filename, "rb") as f:
+        compressed = f.read(2) == b"\x1f\x8b"
+    if compressed:
+        return ReferenceSequence(fasta[chromosome][:])
+    return ReferenceSequence.mapped(
+        fasta.filename, record.rlen, record.offset, record.lenc, record.lenb
+    )
+
+
 def plural_s(n: int) -> str:
     return "" if n == 1 else "s"
 
@@ -2,13 +2,16 @@
 Detect variants in reads.
 """
 import logging
+import math
+from bisect import bisect_left
 from collections import defaultdict, Counter
-from typing import Iterable, Iterator, List, Optional
+from itertools import islice
+from multiprocessing import Pool
+from typing import Dict, Iterable, Iterator, List, Optional, Tuple
 
-from .core import Read, ReadSet, NumericSampleIds
+from .core import Read, ReadSet, NumericSampleIds, AlleleDetector, ReferenceSequence
 from .bam import SampleBamReader, MultiBamReader, BamReader
-from .align import edit_distance, edit_distance_affine_gap
-from ._variants import _iterate_cigar
+from .readsetcache import ReadSetCache
 
 
 logger = logging.getLogger(__name__)
@@ -39,6 +42,8 @@ class ReadSetReader:
         gap_start: int = 10,
         gap_extend: int = 7,
         default_mismatch: int = 15,
+        threads: int = 1,
+        cache_dir: Optional[str] = None,
     ):
         """
         paths -- list of BAM paths
@@ -48,6 +53,10 @@ class ReadSetReader:
         overhang -- extend alignment by this many bases to left and right
         affine -- use affine gap costs
         gap_start, gap_extend, default_mismatch -- parameters for affine gap cost alignment
+        threads -- number of worker processes used for detecting alleles. If larger than 1,
+            each chromosome is split into windows that are processed in parallel.
+        cache_dir -- directory of a ReadSetCache. If given, ReadSets are taken from and
+            stored in this cache.
         """
         self._mapq_threshold = mapq_threshold
         self._numeric_sample_ids = numeric_sample_ids
@@ -57,6 +66,26 @@ class ReadSetReader:
         self._default_mismatch = default_mismatch
         self._overhang = overhang
         self._paths = paths
+        self._threads = threads
+        # arguments for opening the same files in worker processes
+        self._worker_args = dict(
+            paths=paths,
+            reference=reference,
+            numeric_sample_ids=numeric_sample_ids,
+            mapq_threshold=mapq_threshold,
+            overhang=overhang,
+            affine=affine,
+            gap_start=gap_start,
+            gap_extend=gap_extend,
+            default_mismatch=default_mismatch,
+        )
+        # realignments answered from (hits) and not found in (misses) the AlleleDetector caches
+        self._realignment_cache_stats: Counter = Counter(hits=0, misses=0)
+        self._cache: Optional[ReadSetCache] = None
+        if cache_dir is not None:
+            parameters = dict(self._worker_args)
+            del parameters["paths"], parameters["reference"], parameters["numeric_sample_ids"]
+            self._cache = ReadSetCache(cache_dir, paths, reference, parameters)
         self._reader: BamReader
         if len(paths) == 1:
             self._reader = SampleBamReader(paths[0], reference=reference)
@@ -67,6 +96,11 @@ class ReadSetReader:
     def n_paths(self):
         return len(self._paths)
 
+    @property
+    def realignment_cache_stats(self) -> Dict[str, int]:
+        """Cache statistics of all realignments done so far (see AlleleDetector.cache_stats())"""
+        return dict(self._realignment_cache_stats)
+
     def read(self, chromosome, variants, sample, reference, regions=None) -> ReadSet:
         """
         Detect alleles and return a ReadSet object containing reads representing
@@ -83,7 +117,8 @@ class ReadSetReader:
         variants -- list of vcf.VcfVariant objects
         sample -- name of sample to work on. If None, read group information is
             ignored and all reads in the file are used.
-        reference -- reference sequence of the given chromosome (or None)
+        reference -- reference sequence of the given chromosome as ReferenceSequence or str
+            (or None)
         regions -- list of start,end tuples (end can be None)
         """
         # Since variants are identified by position, positions must be unique.
@@ -92,10 +127,23 @@ class ReadSetReader:
             pos, count = varposc.most_common()[0]
             assert count == 1, "Position {} occurs more than once in variant list.".format(pos)
 
-        alignments = self._usable_alignments(chromosome, sample, regions)
-        reads = self._alignments_to_reads(alignments, variants, sample, reference)
+        if self._cache is not None:
+            numeric_sample_id = 0 if sample is None else self._numeric_sample_ids[sample]
+            readset = self._cache.load(chromosome, variants, sample, regions, numeric_sample_id)
+            if readset is not None:
+                return readset
+
+        if self._threads > 1:
+            reads = self._parallel_alignments_to_reads(
+                chromosome, variants, sample, reference, regions
+            )
+        else:
+            alignments = self._usable_alignments(chromosome, sample, regions)
+            reads = self._alignments_to_reads(alignments, variants, sample, reference)
         grouped_reads = self._group_paired_reads(reads)
         readset = self._make_readset_from_grouped_reads(grouped_reads)
+        if self._cache is not None:
+            self._cache.store(chromosome, variants, sample, regions, readset)
         return readset
 
     @staticmethod
@@ -151,6 +199,89 @@ class ReadSetReader:
     def has_reference(self, chromosome):
         return self._reader.has_reference(chromosome)
 
+    def longest_template_span(self, chromosome, positions, max_alignments=1000) -> int:
+        """
+        Return the longest reference span of a template (a single read, or a read pair if
+        both mates map to the chromosome) among the first max_alignments usable alignments
+        overlapping each of the given positions, or 0 if there are none. Reads of all
+        samples are considered.
+        """
+        longest = 0
+        for position in positions:
+            alignments = self._usable_alignments(chromosome, None, [(position, position + 1)])
+            for alignment in islice(alignments, max_alignments):
+                bam_alignment = alignment.bam_alignment
+                span = bam_alignment.reference_end - bam_alignment.reference_start
+                if bam_alignment.is_paired and bam_alignment.next_reference_id == (
+                    bam_alignment.reference_id
+                ):
+                    span = max(span, abs(bam_alignment.template_length))
+                longest = max(longest, span)
+        return longest
+
+    # Minimum number of variants in the windows processed by a worker process
+    MIN_WINDOW_VARIANTS = 1000
+
+    @classmethod
+    def _extraction_windows(cls, variants, threads, regions=None):
+        """
+        Split the regions into windows containing about equally many variants, such that
+        there are a few windows per worker process (given by threads).
+
+        Return a list of (start, end, is_first) tuples. Each alignment belongs to the
+        window it starts in, except that the first window of a region (is_first is True)
+        also receives alignments that start before the region, but overlap it. Thus, every
+        alignment fetched for a region is assigned to exactly one of its windows.
+        """
+        if regions is None:
+            regions = [(0, None)]
+        positions = [variant.position for variant in variants]
+        windows = []
+        for start, end in regions:
+            first = bisect_left(positions, start)
+            last = len(positions) if end is None else bisect_left(positions, end)
+            window_variants = max(
+                cls.MIN_WINDOW_VARIANTS, math.ceil((last - first) / (4 * threads))
+            )
+            boundaries = [start]
+            for i in range(first + window_variants, last, window_variants):
+                if positions[i] > boundaries[-1]:
+                    boundaries.append(positions[i])
+            boundaries.append(end)
+            for i in range(len(boundaries) - 1):
+                windows.append((boundaries[i], boundaries[i + 1], i == 0))
+        return windows
+
+    def _parallel_alignments_to_reads(self, chromosome, variants, sample, reference, regions=None):
+        """
+        Convert the usable alignments in the given regions to Read objects using
+        multiple worker processes, which each work on one window at a time.
+
+        Return a list of the Read objects, in the same order as _alignments_to_reads()
+        produces them.
+        """
+        # Look up the sample id here such that ids are assigned in the same order as
+        # in the serial case
+        numeric_sample_id = 0 if sample is None else self._numeric_sample_ids[sample]
+        # A memory-mapped reference is pickled as its location in the FASTA file
+        reference = self._reference_sequence(reference)
+        windows = self._extraction_windows(variants, self._threads, regions)
+        logger.debug(
+            "Detecting alleles in %d windows using %d processes", len(windows), self._threads
+        )
+        initargs = (self._worker_args, chromosome, variants, sample, numeric_sample_id, reference)
+        with Pool(
+            processes=min(self._threads, len(windows)),
+            initializer=_init_extraction_worker,
+            initargs=initargs,
+        ) as pool:
+            # imap returns the windows in order, which makes the result deterministic
+            result = []
+            for reads, cache_stats in pool.imap(_extract_window, windows):
+                result.extend(reads)
+                self._realignment_cache_stats.update(cache_stats)
+            return result
+
     def _alignments_to_reads(self, alignments, variants, sample, reference):
         """
         Convert BAM alignments to Read objects.
@@ -161,14 +292,57 @@ class ReadSetReader:
         """
         # FIXME hard-coded zero
         numeric_sample_id = 0 if sample is None else self._numeric_sample_ids[sample]
+        reference = self._reference_sequence(reference)
+        detector = self._allele_detector(variants, reference)
+        yield from self._detect_reads(
+            alignments, variants, self._normalize(variants, reference), numeric_sample_id, detector
+        )
+        if detector is not None:
+            self._realignment_cache_stats.update(detector.cache_stats())
+
+    @staticmethod
+    def _reference_sequence(reference):
+        """
+        Return the reference (None, a ReferenceSequence or a str-like object such as a
+        pyfaidx.FastaRecord) as a ReferenceSequence
+        """
+        if reference is None or isinstance(reference, ReferenceSequence):
+            return reference
+        return ReferenceSequence(reference[:])
+
+    @staticmethod
+    def _normalize(variants, reference):
+        """Return the variants as needed for detecting alleles with or without reference"""
         if reference is not None:
-            # Copy the pyfaidx.FastaRecord into a str for faster access
-            reference = reference[:]
-            normalized_variants = variants
-        else:
-            normalized_variants = [variant.normalized() for variant in variants]
+            return variants
+        return [variant.normalized() for variant in variants]
 
-        i = 0  # index into variants
+    def _allele_detector(self, variants, reference):
+        """
+        Return the AlleleDetector used to realign reads to the given variants or None
+        if reference is None
+        """
+        if reference is None:
+            return None
+        return AlleleDetector(
+            variants,
+            reference,
+            self._overhang,
+            self._use_affine,
+            self._gap_start,
+            self._gap_extend,
+            self._default_mismatch,
+        )
+
+    def _detect_reads(
+        self, alignments, variants, normalized_variants, numeric_sample_id, detector, first=0
+    ):
+        """
+        Yield Read objects for the given alignments (see _alignments_to_reads()).
+        Alleles are detected by realignment if detector (an AlleleDetector for the given
+        variants) is not None. All variants before index first are ignored.
+        """
+        i = first  # index into variants
         for alignment in alignments:
             # Skip variants that are to the left of this read
             while (
@@ -190,22 +364,14 @@ class ReadSetReader:
                 barcode,
             )
 
-            if reference is None:
-                detected = self.detect_alleles(normalized_variants, i, alignment.bam_alignment)
+            bam_read = alignment.bam_alignment
+            if detector is None:
+                for j, allele, quality in self.detect_alleles(normalized_variants, i, bam_read):
+                    read.add_variant(variants[j].position, allele, quality)
             else:
-                detected = self.detect_alleles_by_alignment(
-                    variants,
-                    i,
-                    alignment.bam_alignment,
-                    reference,
-                    self._overhang,
-                    self._use_affine,
-                    self._gap_start,
-                    self._gap_extend,
-                    self._default_mismatch,
+                detector.detect(
+                    read, bam_read.cigartuples, bam_read.query_sequence, bam_read.reference_start, i
                 )
-            for j, allele, quality in detected:
-                read.add_variant(variants[j].position, allele, quality)
             if read:  # At least one variant covered and detected
                 yield read
 
@@ -353,219 +519,6 @@ class ReadSetReader:
                 logger.error("Unsupported CIGAR operation: %d", cigar_op)
                 raise ValueError("Unsupported CIGAR operation: {}".format(cigar_op))
 
-    @staticmethod
-    def split_cigar(cigar, i, consumed):
-        """
-        Split a CIGAR into two parts. i and consumed describe the split position.
-        i is the element of the cigar list that should be split, and consumed says
-        at how many operations to split within that element.
-
-        The CIGAR is given as a list of (operation, length) pairs.
-
-        i -- split at this index in cigar list
-        consumed -- how many cigar ops at cigar[i] are to the *left* of the
-            split position
-
-        Return a tuple (left, right).
-
-        Example:
-        Assume the cigar is 3M 1D 6M 2I 4M.
-        With i == 2 and consumed == 5, the cigar is split into
-        3M 1D 5M and 1M 2I 4M.
-        """
-        middle_op, middle_length = cigar[i]
-        assert consumed <= middle_length
-        if consumed > 0:
-            left = cigar[:i] + [(middle_op, consumed)]
-        else:
-            left = cigar[:i]
-        if consumed < middle_length:
-            right = [(middle_op, middle_length - consumed)] + cigar[i + 1 :]
-        else:
-            right = cigar[i + 1 :]
-        return left, right
-
-    @staticmethod
-    def cigar_prefix_length(cigar, reference_bases):
-        """
-        Given a prefix of length reference_bases relative to the reference, how
-        long is the prefix of the read? In other words: If reference_bases on
-        the reference are consumed, how many bases on the query does that
-        correspond to?
-
-        If the position is within or at the end of an insertion (which do not
-        consume bases on the reference), then the number of bases up to the
-        beginning of the insertion is reported.
-
-        Return a pair (reference_bases, query_bases) where the value for
-        reference_bases may be smaller than the requested one if the CIGAR does
-        not cover enough reference bases.
-
-        Reference skips (N operators) are treated as the end of the read. That
-        is, no positions beyond a reference skip are reported.
-        """
-        ref_pos = 0
-        query_pos = 0
-        for op, length in cigar:
-            if op in (0, 7, 8):  # M, X, =
-                ref_pos += length
-                query_pos += length
-                if ref_pos >= reference_bases:
-                    return (reference_bases, query_pos + reference_bases - ref_pos)
-            elif op == 2:  # D
-                ref_pos += length
-                if ref_pos >= reference_bases:
-                    return (reference_bases, query_pos)
-            elif op == 1:  # I
-                query_pos += length
-            elif op == 4 or op == 5:  # soft or hard clipping
-                pass
-            elif op == 3:  # N
-                # Always stop at reference skips
-                return (reference_bases, query_pos)
-            else:
-                assert False, "unknown CIGAR operator"
-        assert ref_pos < reference_bases
-        return (ref_pos, query_pos)
-
-    @staticmethod
-    def realign(
-        variant,
-        bam_read,
-        cigartuples,
-        i,
-        consumed,
-        query_pos,
-        reference,
-        overhang,
-        use_affine,
-        gap_start,
-        gap_extend,
-        default_mismatch,
-    ):
-        """
-        Realign a read to the two alleles of a single variant.
-        i and consumed describe where to split the cigar into a part before the
-        variant position and into a part starting at the variant position, see split_cigar().
-
-        variant -- VcfVariant
-        bam_read -- the AlignedSegment
-        cigartuples -- the AlignedSegment.cigartuples property (accessing it is expensive, so re-use it)
-        i, consumed -- see split_cigar method
-        query_pos -- index of the query base that is at the variant position
-        reference -- the reference as a str-like object (full chromosome)
-        overhang -- extend alignment by this many bases to left and right
-        use_affine -- if true, use affine gap costs for realignment
-        gap_start, gap_extend -- if affine_gap=true, use these parameters for affine gap cost alignment
-        default_mismatch -- if affine_gap=true, use this as mismatch cost in case no base qualities are in bam
-        """
-        # Do not process symbolic alleles like <DEL>, <DUP>, etc.
-        if variant.alternative_allele.startswith("<"):
-            return None, None
-
-        left_cigar, right_cigar = ReadSetReader.split_cigar(cigartuples, i, consumed)
-
-        left_ref_bases, left_query_bases = ReadSetReader.cigar_prefix_length(
-            left_cigar[::-1], overhang
-        )
-        right_ref_bases, right_query_bases = ReadSetReader.cigar_prefix_length(
-            right_cigar, len(variant.reference_allele) + overhang
-        )
-
-        assert variant.position - left_ref_bases >= 0
-        assert variant.position + right_ref_bases <= len(reference)
-
-        query = bam_read.query_sequence[
-            query_pos - left_query_bases : query_pos + right_query_bases
-        ]
-        ref = reference[variant.position - left_ref_bases : variant.position + right_ref_bases]
-        alt = (
-            reference[variant.position - left_ref_bases : variant.position]
-            + variant.alternative_allele
-            + reference[
-                variant.position
-                + len(variant.reference_allele) : variant.position
-                + right_ref_bases
-            ]
-        )
-
-        if use_affine:
-            assert gap_start is not None
-            assert gap_extend is not None
-            assert default_mismatch is not None
-
-            # get base qualities if present (to be used as mismatch costs)
-            base_qualities = [default_mismatch] * len(query)
-            # if bam_read.query_qualities != None:
-            #    base_qualities = bam_read.query_qualities[query_pos-left_query_bases:query_pos+right_query_bases]
-
-            # compute edit dist. with affine gap costs using base qual. as mismatch cost
-            distance_ref = edit_distance_affine_gap(
-                query, ref, base_qualities, gap_start, gap_extend
-            )
-            distance_alt = edit_distance_affine_gap(
-                query, alt, base_qualities, gap_start, gap_extend
-            )
-            base_qual_score = abs(distance_ref - distance_alt)
-        else:
-            base_qual_score = 30
-            distance_ref = edit_distance(query, ref)
-            distance_alt = edit_distance(query, alt)
-
-        if distance_ref < distance_alt:
-            return 0, base_qual_score  # detected REF
-        elif distance_ref > distance_alt:
-            return 1, base_qual_score  # detected ALT
-        else:
-            return None, None  # cannot decide
-
-    @staticmethod
-    def detect_alleles_by_alignment(
-        variants,
-        j,
-        bam_read,
-        reference,
-        overhang=10,
-        use_affine=False,
-        gap_start=None,
-        gap_extend=None,
-        default_mismatch=None,
-    ):
-        """
-        Detect which alleles the given bam_read covers. Detect the correct
-        alleles of the variants that are covered by the given bam_read.
-
-        Yield tuples (position, allele, quality).
-
-        variants -- list of variants (VcfVariant objects)
-        j -- index of the first variant (in the variants list) to check
-        """
-        # Accessing bam_read.cigartuples is expensive, do it only once
-        cigartuples = bam_read.cigartuples
-
-        # For the same reason, the following check is here instad of
-        # in the _usable_alignments method
-        if not cigartuples:
-            return
-
-        for index, i, consumed, query_pos in _iterate_cigar(variants, j, bam_read, cigartuples):
-            allele, quality = ReadSetReader.realign(
-                variants[index],
-                bam_read,
-                cigartuples,
-                i,
-                consumed,
-                query_pos,
-                reference,
-                overhang,
-                use_affine,
-                gap_start,
-                gap_extend,
-                default_mismatch,
-            )
-            if allele in (0, 1):
-                yield (index, allele, quality)  # TODO quality???
-
     def __enter__(self):
         return self
 
@@ -576,6 +529,62 @@ class ReadSetReader:
         self._reader.close()
 
 
+# State of a worker process used by ReadSetReader._parallel_alignments_to_reads
+_worker_state = None
+
+
+def _init_extraction_worker(
+    reader_args, chromosome, variants, sample, numeric_sample_id, reference
+):
+    global _worker_state
+    # Each worker opens the alignment files itself as file handles cannot be shared
+    readset_reader = ReadSetReader(**reader_args)
+    normalized_variants = ReadSetReader._normalize(variants, reference)
+    _worker_state = (
+        readset_reader,
+        chromosome,
+        variants,
+        normalized_variants,
+        [variant.position for variant in normalized_variants],
+        sample,
+        numeric_sample_id,
+        readset_reader._allele_detector(variants, reference),
+    )
+
+
+def _extract_window(window) -> Tuple[List[Read], Dict[str, int]]:
+    (
+        readset_reader,
+        chromosome,
+        variants,
+        normalized_variants,
+        positions,
+        sample,
+        numeric_sample_id,
+        detector,
+    ) = _worker_state
+    start, end, is_first = window
+    cache_stats = detector.cache_stats() if detector is not None else {}
+    alignments = readset_reader._usable_alignments(chromosome, sample, [(start, end)])
+    if is_first:
+        first = 0
+    else:
+        # alignments start within the window, so earlier variants cannot be covered
+        alignments = (a for a in alignments if a.bam_alignment.reference_start >= start)
+        first = bisect_left(positions, start)
+    reads = list(
+        readset_reader._detect_reads(
+            alignments, variants, normalized_variants, numeric_sample_id, detector, first
+        )
+    )
+    if detector is not None:
+        # the detector is shared by all windows of this worker
+        cache_stats = {
+            key: value - cache_stats[key] for key, value in detector.cache_stats().items()
+        }
+    return reads, cache_stats
+
+
 def merge_two_reads(read1: Read, read2: Read) -> Read:
     """
     Merge two reads *that belong to the same haplotype* (such as the two
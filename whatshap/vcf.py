@@ -2,17 +2,32 @@
 Functions for reading VCFs.
 """
 import os
+import re
 import sys
 import math
 import logging
 import itertools
+from contextlib import ExitStack
 from dataclasses import dataclass
 from abc import ABC, abstractmethod
 from os import PathLike
-from typing import List, Sequence, Dict, Tuple, Iterable, Optional, Union, TextIO, Iterator
+from typing import (
+    Callable,
+    List,
+    Sequence,
+    Dict,
+    Tuple,
+    Iterable,
+    Optional,
+    Set,
+    Union,
+    TextIO,
+    Iterator,
+)
 
 from pysam import VariantFile, VariantHeader, VariantRecord
 from pysam.libcbcf import VariantRecordSample
+from xopen import xopen
 
 from .core import (
     Read,
@@ -21,6 +36,7 @@ from .core import (
     Genotype,
     binomial_coefficient,
     get_max_genotype_ploidy,
+    VcfRewriter,
 )
 from .utils import warn_once
 
@@ -335,6 +351,16 @@ class VariantTable:
                 yield read
 
 
+# A row of a VariantTable: the variant and the genotype, phase and genotype likelihoods of every
+# sample
+VariantRow = Tuple[
+    VcfVariant,
+    List[Genotype],
+    List[Optional[VariantCallPhase]],
+    List[Optional[GenotypeLikelihoods]],
+]
+
+
 class MixedPhasingError(Exception):
     pass
 
@@ -352,6 +378,7 @@ class VcfReader:
         genotype_likelihoods: bool = False,
         ignore_genotypes: bool = False,
         ploidy: int = None,
+        threads: int = 1,
     ):
         """
         path -- Path to VCF file
@@ -360,10 +387,11 @@ class VcfReader:
         ignore_genotypes -- In case of genotyping algorithm, no genotypes may be given in
                                 vcf, so ignore all genotypes
         ploidy -- Ploidy of the samples
+        threads -- Number of threads used by htslib to decompress BGZF-compressed files
         """
         # TODO Always include deletions since they can 'overlap' other variants
         self._indels = indels
-        self._vcf_reader = VariantFile(os.fspath(path))
+        self._vcf_reader = VariantFile(os.fspath(path), threads=threads)
         self._path = path
         self._phases = phases
         self._genotype_likelihoods = genotype_likelihoods
@@ -387,6 +415,21 @@ class VcfReader:
     def path(self) -> str:
         return self._vcf_reader.filename.decode()
 
+    def subset_samples(self, samples: Iterable[str]) -> None:
+        """
+        Parse only the calls of the given samples, which must be in the VCF. htslib skips the
+        calls of all other samples without decoding them, and the VariantTables returned from
+        now on only contain the given samples (in the order of the VCF). Must be called before
+        reading any records.
+        """
+        wanted = set(samples)
+        subset = [sample for sample in self.samples if sample in wanted]
+        if len(subset) == len(self.samples):
+            return
+        self._vcf_reader.subset_samples(subset)
+        self.samples = subset
+        logger.debug("Parsing the calls of %d of the samples in the VCF file.", len(subset))
+
     def _fetch(self, chromosome: str, start: int = 0, end: Optional[int] = None):
         try:
             records = self._vcf_reader.fetch(chromosome, start=start, stop=end)
@@ -429,8 +472,53 @@ class VcfReader:
 
         Multi-ALT sites are skipped.
         """
-        for chromosome, records in itertools.groupby(self._vcf_reader, lambda record: record.chrom):
-            yield self._process_single_chromosome(chromosome, records)
+        for chromosome, rows in self.stream():
+            yield self._table_from_rows(chromosome, rows)
+
+    def tables(
+        self, include: Callable[[str], bool]
+    ) -> Iterator[Tuple[str, Optional[VariantTable]]]:
+        """
+        Yield a tuple (chromosome, table) for each chromosome, in which table is the
+        VariantTable of the chromosome if include(chromosome) is true and None otherwise.
+        The records of excluded chromosomes are skipped without parsing them.
+        """
+        for chromosome, records in itertools.groupby(self._vcf_reader, lambda r: r.chrom):
+            if include(chromosome):
+                yield chromosome, self._table_from_rows(
+                    chromosome, self._parse_records(chromosome, records)
+                )
+            else:
+                for _ in records:
+                    pass
+                yield chromosome, None
+
+    def stream(
+        self, chromosome: Optional[str] = None
+    ) -> Iterator[Tuple[str, Iterator[VariantRow]]]:
+        """
+        Yield a tuple (chromosome, rows) for each chromosome, in which rows is an iterator over
+        the rows a VariantTable would contain, each a tuple (variant, genotypes, phases,
+        genotype_likelihoods) with one entry per sample. No VariantTable is built, so only the
+        current record is kept in memory. The rows of a chromosome must be consumed before
+        advancing to the next one.
+
+        If a chromosome is given, only its records are read, which requires an index. Nothing
+        is yielded if it has no records.
+        """
+        records = self._vcf_reader if chromosome is None else self._fetch(chromosome)
+        for chrom, chrom_records in itertools.groupby(records, lambda record: record.chrom):
+            yield chrom, self._parse_records(chrom, chrom_records)
+
+    def indexed_chromosomes(self) -> Optional[List[str]]:
+        """
+        Return the chromosomes listed in the index of the VCF (in the order of the index) or
+        None if it has no index.
+        """
+        index = getattr(self._vcf_reader, "index", None)
+        if index is None:
+            return None
+        return list(index.keys())
 
     @staticmethod
     def _extract_HP_phase(call) -> Optional[VariantCallPhase]:
@@ -456,11 +544,19 @@ class VcfReader:
         return VariantCallPhase(block_id=block_id, phase=phase, quality=call.get("PQ", None))
 
     def _process_single_chromosome(self, chromosome: str, records) -> VariantTable:
+        return self._table_from_rows(chromosome, self._parse_records(chromosome, records))
+
+    def _table_from_rows(self, chromosome: str, rows: Iterable[VariantRow]) -> VariantTable:
+        table = VariantTable(chromosome, self.samples)
+        for variant, genotypes, phases, genotype_likelihoods in rows:
+            table.add_variant(variant, genotypes, phases, genotype_likelihoods)
+        return table
+
+    def _parse_records(self, chromosome: str, records) -> Iterator[VariantRow]:
         phase_detected = None
         n_snvs = 0
         n_other = 0
         n_multi = 0
-        table = VariantTable(chromosome, self.samples)
         prev_position = None
         for record in records:
             if not record.alts:
@@ -494,9 +590,10 @@ class VcfReader:
 
             # Read phasing information (allow GT/PS or HP phase information, but not both),
             # if requested
+            calls = list(record.samples.values())
             if self._phases:
                 phases = []
-                for call in record.samples.values():
+                for call in calls:
                     phase = None
                     for extract_phase, phase_name in [
                         (self._extract_HP_phase, "HP"),
@@ -531,12 +628,12 @@ class VcfReader:
                                 )
                     phases.append(phase)
             else:
-                phases = [None] * len(record.samples)
+                phases = [None] * len(calls)
 
             # Read genotype likelihoods, if requested
             if self._genotype_likelihoods:
                 genotype_likelihoods: List[Optional[GenotypeLikelihoods]] = []
-                for call in record.samples.values():
+                for call in calls:
                     GL = call.get("GL", None)
                     PL = call.get("PL", None)
                     # Prefer GLs (floats) over PLs (ints) if both should be present
@@ -548,11 +645,11 @@ class VcfReader:
                     else:
                         genotype_likelihoods.append(None)
             else:
-                genotype_likelihoods = [None] * len(record.samples)
+                genotype_likelihoods = [None] * len(calls)
 
             if not self._ignore_genotypes:
                 # check for ploidy consistency and limits
-                genotype_lists = [call.get("GT", None) for call in record.samples.values()]
+                genotype_lists = [call.get("GT", None) for call in calls]
                 for geno in genotype_lists:
                     if geno is None or None in geno:
                         continue
@@ -574,14 +671,13 @@ class VcfReader:
                 genotypes = [Genotype([]) for _ in self.samples]
                 phases = [None] * len(self.samples)
             variant = VcfVariant(position=pos, reference_allele=ref, alternative_allele=alt)
-            table.add_variant(variant, genotypes, phases, genotype_likelihoods)
+            yield variant, genotypes, phases, genotype_likelihoods
 
         logger.debug(
             "Parsed %s SNVs and %s non-SNVs. Also skipped %s multi-ALTs.", n_snvs, n_other, n_multi
         )
 
         # TODO remove overlapping variants
-        return table
 
 
 def remove_overlapping_calls(calls):
@@ -688,7 +784,7 @@ def augment_header(header: VariantHeader, contigs: List[str], formats: List[str]
         header.add_line(h.line())
 
 
-def missing_headers(path: str) -> Tuple[List[str], List[str], List[str]]:
+def missing_headers(path: str, threads: int = 1) -> Tuple[List[str], List[str], List[str]]:
     """
     Find contigs, FORMATs and INFOs that are used within the body of a VCF file, but are
     not listed in the header or that have an incorrect type.
@@ -700,8 +796,10 @@ def missing_headers(path: str) -> Tuple[List[str], List[str], List[str]]:
     try to write a VCF record to it that uses contigs, INFOs or FORMATs that
     are missing from the header. See also
     <https://github.com/pysam-developers/pysam/issues/771>
+
+    threads -- Number of threads used by htslib to decompress the file
     """
-    with VariantFile(path) as variant_file:
+    with VariantFile(path, threads=threads) as variant_file:
         header = variant_file.header.copy()
         # Check for FORMATs that do not have the expected type
         incorrect_formats = []
@@ -773,6 +871,173 @@ def missing_headers(path: str) -> Tuple[List[str], List[str], List[str]]:
     return (missing_contigs, incorrect_formats + missing_formats, missing_infos)
 
 
+# htslib adds this header line if it is missing, so pysam always writes it
+PASS_FILTER_HEADER = '##FILTER=<ID=PASS,Description="All filters passed">'
+
+BCF_MAGIC = b"BCF\2"
+
+# The CHROM column of every record in a chunk of VCF text
+CHROM_RE = re.compile(rb"^([^\t\n]*)\t", re.MULTILINE)
+
+
+def _needs_htslib(header: List[str]) -> bool:
+    """
+    Return whether records of a VCF with the given header lines must be decoded with pysam
+    to be written as pysam would write them. htslib reformats Float values of INFO and
+    FORMAT fields (such as "-0.50" as "-0.5"), and it adds the contig header lines that
+    are missing.
+    """
+    has_contigs = False
+    for line in header:
+        if line.startswith(("##INFO=<", "##FORMAT=<")) and "Type=Float" in line:
+            return True
+        if line.startswith("##contig=<"):
+            has_contigs = True
+    return not has_contigs
+
+
+def _undeclared_contigs(path: str, threads: int) -> List[str]:
+    """Return the contigs used by records of a VCF that are not declared in its header"""
+    with VariantFile(path, threads=threads) as reader:
+        declared = set(reader.header.contigs)
+        contigs = []
+        for record in reader:
+            if record.contig not in declared:
+                declared.add(record.contig)
+                contigs.append(record.contig)
+    return contigs
+
+
+def rewrite_vcf_text(
+    in_path: str,
+    output,
+    rewriter: VcfRewriter,
+    edit_header: Callable[[List[str]], List[str]],
+    threads: int = 1,
+    chunk_size: int = 4 * 1024 * 1024,
+) -> None:
+    """
+    Stream a VCF file to output without decoding its records, which is much faster than
+    reading and writing them with pysam if only some genotype fields need to be changed.
+    The output is meant to be the same as if the file had been written with pysam: the
+    PASS filter header is added and QUAL values are formatted by the rewriter as htslib
+    does. Other values are copied verbatim, so the records are decoded with pysam instead
+    if the header declares Float INFO or FORMAT fields (which htslib reformats) or no
+    contigs (whose header lines are then added).
+
+    Limits: The records are not checked against the header, apart from their contigs.
+    Contigs missing from a header that declares others are only reported, and INFO and
+    FORMAT fields missing from the header are not added. Input from stdin is always
+    streamed, as it cannot be read twice.
+
+    in_path -- Path to the input VCF (plain, gzip or BGZF compressed) or BCF. Use "-" for
+        stdin (VCF only). Since the rewriter needs text, BCF records are decoded with pysam.
+    output -- Path or open file-like object to which the uncompressed VCF is written.
+    rewriter -- Rewrites the records (in chunks of about chunk_size bytes).
+    edit_header -- Called with the list of header lines (without newlines, the last one is
+        the #CHROM line) and returns the header lines to write.
+    threads -- Number of threads used to decompress the input and to rewrite the records
+    """
+    with ExitStack() as stack:
+        # xopen decompresses in a separate process (such as pigz)
+        in_file = stack.enter_context(xopen(in_path, "rb", threads=threads))
+        if isinstance(output, (str, PathLike)):
+            out_file = stack.enter_context(open(output, "wb"))
+        else:
+            output.flush()
+            out_file = getattr(output, "buffer", output)
+
+        start = in_file.read(len(BCF_MAGIC))
+        if start == BCF_MAGIC:
+            if in_path == "-":
+                raise VcfError("Cannot read BCF from standard input, please provide a VCF")
+            use_pysam = True
+        else:
+            header, chunks = _read_vcf_text(in_file, start, in_path, chunk_size)
+            use_pysam = in_path != "-" and _needs_htslib(header)
+        declared_contigs: Optional[Set[bytes]] = None
+        if use_pysam:
+            in_file.close()
+            reader = stack.enter_context(VariantFile(in_path, threads=threads))
+            if not reader.header.contigs:
+                for contig in _undeclared_contigs(in_path, threads):
+                    reader.header.contigs.add(contig)
+            header = str(reader.header).rstrip("\n").split("\n")
+            chunks = _record_text_chunks(reader, chunk_size)
+        else:
+            declared_contigs = {
+                line[len("##contig=<ID=") :].split(",")[0].rstrip(">").encode()
+                for line in header
+                if line.startswith("##contig=<ID=")
+            }
+        if not any(line.startswith("##FILTER=<ID=PASS,") for line in header):
+            header.insert(1 if header[0].startswith("##fileformat=") else 0, PASS_FILTER_HEADER)
+        out_file.write("".join(line + "\n" for line in edit_header(header)).encode())
+
+        for chunk in chunks:
+            if declared_contigs is not None:
+                for contig in set(CHROM_RE.findall(chunk)) - declared_contigs:
+                    logger.warning(
+                        "Contig %r is not declared in the header of %r, which is copied as is",
+                        contig.decode(),
+                        in_path,
+                    )
+                    declared_contigs.add(contig)
+            out_file.write(rewriter.rewrite(chunk))
+        out_file.flush()
+
+
+def _read_vcf_text(
+    in_file, start: bytes, in_path: str, chunk_size: int
+) -> Tuple[List[str], Iterator[bytes]]:
+    """
+    Read the header of an uncompressed VCF stream whose first bytes (start) were already
+    read. Return the header lines and an iterator over chunks of complete record lines.
+    """
+    header: List[str] = []
+    while not header or not header[-1].startswith("#CHROM"):
+        if b"\n" in start:
+            line, _, start = start.partition(b"\n")
+            line += b"\n"
+        else:
+            line = start + in_file.readline()
+            start = b""
+        if not line.startswith(b"#"):
+            raise VcfError("VCF header of {!r} does not end with a #CHROM line".format(in_path))
+        header.append(line.decode().rstrip("\r\n"))
+
+    def chunks():
+        rest = start
+        while True:
+            data = in_file.read(chunk_size)
+            if not data:
+                break
+            data = rest + data
+            end = data.rfind(b"\n") + 1
+            rest = data[end:]
+            yield data[:end]
+        if rest:
+            yield rest + b"\n"
+
+    return header, chunks()
+
+
+def _record_text_chunks(reader: VariantFile, chunk_size: int) -> Iterator[bytes]:
+    """Yield the records of reader as VCF text in chunks of about chunk_size bytes"""
+    lines = []
+    size = 0
+    for record in reader:
+        line = str(record)
+        lines.append(line)
+        size += len(line)
+        if size >= chunk_size:
+            yield "".join(lines).encode()
+            lines = []
+            size = 0
+    if lines:
+        yield "".join(lines).encode()
+
+
 @dataclass
 class GenotypeChange:
     sample: str
@@ -782,6 +1047,66 @@ class GenotypeChange:
     new_gt: Genotype
 
 
+@dataclass
+class Shard:
+    """
+    A region of a chromosome that is phased on its own (whatshap phase --region). The
+    variants in a window that extends the region (the core) on both sides are phased, such
+    that the phasings of adjacent shards overlap and can be joined by whatshap stitch.
+    Coordinates are 0-based, and ends are exclusive (None means the end of the chromosome).
+    """
+
+    chromosome: str
+    start: int
+    end: Optional[int]
+    window_start: int
+    window_end: Optional[int]
+
+    # Key of the VCF header line that records the shard in the output of whatshap phase
+    HEADER_KEY = "whatshap_shard"
+
+    def in_window(self, chromosome: str, position: int) -> bool:
+        return (
+            chromosome == self.chromosome
+            and self.window_start <= position
+            and (self.window_end is None or position < self.window_end)
+        )
+
+    def header_value(self) -> str:
+        """
+        >>> Shard("chr1", 1000, 2000, 500, None).header_value()
+        'chr1:1001-2000;window=501-'
+        """
+        return "{}:{}-{};window={}-{}".format(
+            self.chromosome,
+            self.start + 1,
+            "" if self.end is None else self.end,
+            self.window_start + 1,
+            "" if self.window_end is None else self.window_end,
+        )
+
+    @staticmethod
+    def parse_header_value(value: str) -> "Shard":
+        """
+        >>> Shard.parse_header_value("chr1:1001-2000;window=501-")
+        Shard(chromosome='chr1', start=1000, end=2000, window_start=500, window_end=None)
+        """
+        try:
+            region, window = value.rsplit(";window=", maxsplit=1)
+            chromosome, core = region.rsplit(":", maxsplit=1)
+            start, end = core.split("-")
+            window_start, window_end = window.split("-")
+            return Shard(
+                chromosome,
+                int(start) - 1,
+                int(end) if end else None,
+                int(window_start) - 1,
+                int(window_end) if window_end else None,
+            )
+        except ValueError:
+            raise VcfError("Invalid {} header value {!r}".format(Shard.HEADER_KEY, value))
+
+
 class VcfAugmenter(ABC):
     def __init__(
         self,
@@ -789,6 +1114,8 @@ class VcfAugmenter(ABC):
         command_line: Optional[str],
         out_file: TextIO = sys.stdout,
         include_haploid_phase_sets: bool = False,
+        threads: int = 1,
+        shard: Optional[Shard] = None,
     ):
         """
         in_path -- Path to input VCF, used as template.
@@ -797,10 +1124,14 @@ class VcfAugmenter(ABC):
         out_file -- Open file-like object to which VCF is written.
         tag -- which type of tag to write, either 'PS' or 'HP'. 'PS' is standardized;
             'HP' is compatible with GATK’s ReadBackedPhasing.
+        threads -- Number of threads used by htslib to decompress the input and to compress
+            the output (if it is written BGZF-compressed)
+        shard -- If given, only the records within the window of the shard are written, and
+            the shard is recorded in the header
         """
         # TODO This is slow because it reads in the entire VCF one extra time
         logger.debug("Reading the input VCF to find possibly missing headers")
-        contigs, formats, infos = missing_headers(in_path)
+        contigs, formats, infos = missing_headers(in_path, threads=threads)
         logger.debug("Missing contigs: %s", contigs)
         logger.debug("Missing formats: %s", formats)
         logger.debug("Missing infos: %s", infos)
@@ -809,13 +1140,18 @@ class VcfAugmenter(ABC):
             formats.append("HS")
         # We repair the header (adding missing contigs, formats, infos) of the *input* VCF because
         # we will modify the records that we read, and these are associated with the input file.
-        self._reader = VariantFile(in_path)
+        self._reader = VariantFile(in_path, threads=threads)
         augment_header(self._reader.header, contigs, formats, infos)
         if command_line is not None:
             command_line = '"' + command_line.replace('"', "") + '"'
             self._reader.header.add_meta("commandline", command_line)
+        self._shard = shard
+        if shard is not None:
+            self._reader.header.add_meta(Shard.HEADER_KEY, shard.header_value())
         self.setup_header(self._reader.header)
-        self._writer = VariantFile(out_file, mode="w", header=self._reader.header)
+        self._writer = VariantFile(
+            out_file, mode="w", header=self._reader.header, threads=threads
+        )
         self._unprocessed_record: Optional[VariantRecord] = None
         self._reader_iter = iter(self._reader)
 
@@ -842,7 +1178,13 @@ class VcfAugmenter(ABC):
             self._writer.write(record)
 
     def _iterrecords(self, chromosome: str) -> Iterable[VariantRecord]:
-        """Yield all records for the target chromosome"""
+        """Yield all records for the target chromosome (within the shard, if there is one)"""
+        records = self._chromosome_records(chromosome)
+        if self._shard is None:
+            return records
+        return (record for record in records if self._shard.in_window(chromosome, record.start))
+
+    def _chromosome_records(self, chromosome: str) -> Iterable[VariantRecord]:
         n = 0
         if self._unprocessed_record is not None:
             assert self._unprocessed_record.chrom == chromosome
@@ -883,6 +1225,8 @@ class PhasedVcfWriter(VcfAugmenter):
         ploidy: int = 2,
         include_haploid_sets: bool = False,
         indels: bool = False,
+        threads: int = 1,
+        shard: Optional[Shard] = None,
     ):
         """
         in_path -- Path to input VCF, used as template.
@@ -891,12 +1235,14 @@ class PhasedVcfWriter(VcfAugmenter):
         out_file -- Open file-like object to which VCF is written.
         tag -- which type of tag to write, either 'PS' or 'HP'. 'PS' is standardized;
             'HP' is compatible with GATK’s ReadBackedPhasing.
+        threads -- Number of threads used for BGZF (de)compression
+        shard -- If given, only the records within the window of the shard are written
         """
         if tag not in ("HP", "PS"):
             raise ValueError('Tag must be either "HP" or "PS"')
         self.tag = tag
         self.ploidy = ploidy
-        super().__init__(in_path, command_line, out_file, include_haploid_sets)
+        super().__init__(in_path, command_line, out_file, include_haploid_sets, threads, shard)
         self._phase_tag_found_warned = False
         self._set_phasing_tags = self._set_HP if tag == "HP" else self._set_PS
         self._indels = indels
@@ -990,9 +1336,27 @@ class PhasedVcfWriter(VcfAugmenter):
                     sample_phases[sample][variants[0].position] = phasing
                     sample_genotypes[sample][variants[0].position] = Genotype(list(phasing))
 
+        # positions at which at least one sample is phased
+        phased_positions = set()
+        for sample in sample_superreads:
+            components = sample_components[sample]
+            phased_positions.update(pos for pos in sample_phases[sample] if pos in components)
+        # everything needed to update the calls of one sample
+        targets = [
+            (
+                sample,
+                sample_components[sample],
+                sample_haploid_components[sample] if sample_haploid_components else None,
+                sample_phases[sample],
+                sample_genotypes[sample],
+            )
+            for sample in sample_superreads
+        ]
+        target_samples = list(sample_superreads)
+
         prev_pos = None
         for record in self._record_modifier(chromosome):
-            self._remove_existing_phasing(record, list(sample_superreads))
+            self._remove_existing_phasing(record, target_samples)
             pos = record.start
             if not record.alts:
                 continue
@@ -1006,25 +1370,13 @@ class PhasedVcfWriter(VcfAugmenter):
             if not self._indels and is_indel:
                 continue
 
-            # Determine whether the variant is phased in any sample
-            for sample in self.samples:
-                if sample in sample_superreads:
-                    components = sample_components[sample]
-                    phases = sample_phases[sample]
-                    if pos in components and pos in phases:
-                        break
-            else:
+            # Skip variants that are not phased in any sample
+            if pos not in phased_positions:
                 continue
 
             # Set phase tag for all target samples
-            for sample in sample_superreads:
+            for sample, components, haploid_components, phases, genotypes in targets:
                 call: VariantRecordSample = record.samples[sample]
-                components = sample_components[sample]
-                haploid_components = (
-                    sample_haploid_components[sample] if sample_haploid_components else None
-                )
-                phases = sample_phases[sample]
-                genotypes = sample_genotypes[sample]
 
                 if (
                     self.tag in call
@@ -1073,9 +1425,14 @@ class PhasedVcfWriter(VcfAugmenter):
                 call = record.samples[sample]
                 if "GT" not in call:
                     continue
-                call.phased = False
-                if call["GT"] is not None and all(allele is not None for allele in call["GT"]):
-                    call["GT"] = sorted(call["GT"])
+                if call.phased:
+                    call.phased = False
+                # only write the genotype back if its alleles are not sorted already
+                gt = call["GT"]
+                if gt is not None and all(allele is not None for allele in gt):
+                    sorted_gt = sorted(gt)
+                    if list(gt) != sorted_gt:
+                        call["GT"] = sorted_gt
 
 
 def genotype_code(gt: Optional[Tuple[Optional[int], ...]]) -> Genotype:
@@ -1101,13 +1458,20 @@ class GenotypeVcfWriter(VcfAugmenter):
     multi-sample VCFs.
     """
 
-    def __init__(self, in_path: str, command_line: Optional[str], out_file: TextIO = sys.stdout):
+    def __init__(
+        self,
+        in_path: str,
+        command_line: Optional[str],
+        out_file: TextIO = sys.stdout,
+        threads: int = 1,
+    ):
         """
         in_path -- Path to input VCF, used as template.
         command_line -- A string that will be added as a VCF header entry.
         out_file -- Open file-like object to which VCF is written.
+        threads -- Number of threads used for BGZF (de)compression
         """
-        super().__init__(in_path, command_line, out_file)
+        super().__init__(in_path, command_line, out_file, threads=threads)
 
     def setup_header(self, header: VariantHeader):
         """Called by baseclass constructor"""